@@ -416,7 +416,7 @@ uuid_archive_make_write_path(
 }
 
 int
-uuid_archive_make_read_path(
+uuid_archive_find_read_path(
         const serve_state_t state,
         unsigned char *path,
         size_t size,
@@ -434,7 +434,7 @@ uuid_archive_make_read_path(
                      ((const unsigned char *) run_uuid)[1],
                      ej_uuid_unparse(run_uuid, NULL), name);
   if (len >= size - 4) {
-    err("uuid_archive_make_read_path: archive path is too long");
+    err("uuid_archive_find_read_path: archive path is too long");
     return -1;
   }
   if ((gzip_preferred & ZIP)) {
@@ -458,10 +458,24 @@ uuid_archive_make_read_path(
   }
 
   path[len] = 0;
-  err("uuid_archive_make_read_path: no entry %s", path);
   return -1;
 }
 
+int
+uuid_archive_make_read_path(
+        const serve_state_t state,
+        unsigned char *path,
+        size_t size,
+        const ruint32_t run_uuid[4],
+        const unsigned char *name,
+        int gzip_preferred)
+{
+  int ret = uuid_archive_find_read_path(state, path, size, run_uuid, name,
+                                        gzip_preferred);
+  if (ret < 0) err("uuid_archive_make_read_path: no entry %s", path);
+  return ret;
+}
+
 int
 uuid_archive_dir_prepare(
         const serve_state_t state,
@@ -491,6 +505,7 @@ uuid_archive_dir_prepare(
     unlink(path2);
     snprintf(path2, sizeof(path2), "%s/%s.zip", path, name);
     unlink(path2);
+    serve_forget_packed_artifact(state, run_uuid, name);
   }
 
   return 0;
@@ -535,6 +550,7 @@ uuid_archive_remove(
   unlink(path);
   snprintf(path, sizeof(path), "%s/%s.zip", base, DFLT_R_UUID_SOURCE);
   unlink(path);
+  serve_forget_packed_artifact(state, run_uuid, DFLT_R_UUID_SOURCE);
 
   return 0;
 }
@@ -65,6 +65,16 @@ uuid_archive_make_read_path(
         const ruint32_t run_uuid[4],
         const unsigned char *name,
         int gzip_preferred);
+/* the same as uuid_archive_make_read_path, but no error is reported
+   if the file does not exist */
+int
+uuid_archive_find_read_path(
+        const serve_state_t state,
+        unsigned char *path,
+        size_t size,
+        const ruint32_t run_uuid[4],
+        const unsigned char *name,
+        int gzip_preferred);
 int
 uuid_archive_dir_prepare(
         const serve_state_t state,
@@ -0,0 +1,1156 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "audit_log.h"
+#include "errlog.h"
+#include "pathutl.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <limits.h>
+
+#define INDEX_NAME "index"
+#define NEW_INDEX_NAME "index.new"
+#define RECORD_MAGIC "EjAL"
+#define IMPORT_MAGIC "EjAI"           /* the imported legacy audit log */
+
+enum
+{
+  MAX_SEGMENT_SIZE = 64 * 1024 * 1024,
+  MAX_PENDING_SIZE = 1024 * 1024, /* flush earlier, if more is queued */
+  MAX_ENTRY_SIZE = 16 * 1024 * 1024,
+  COMP_SYNC_SIZE = 4 * 1024 * 1024, /* sync the copies in smaller parts */
+};
+
+/* the entry header in a segment, followed by the text */
+struct audit_log_record
+{
+  unsigned char magic[4];
+  int run_id;
+  ruint32_t run_uuid[4];
+  ruint32_t size;
+  ruint32_t crc;                /* crc32 of the text */
+};
+
+/* index operations */
+enum
+{
+  OP_ENTRY = 0,                 /* the entry is written to the segment */
+  OP_REMOVE,                    /* the entries of the run are forgotten */
+  OP_MOVE,                      /* the entries move from `segment' to `run_id' */
+  OP_MOVE_END,                  /* the preceding moves are done at once */
+  OP_IMPORT,                    /* the imported entry is written */
+  OP_COMPACT,                   /* the segments before `segment' are garbage */
+};
+
+/* the index file record, the structure size is 40 bytes */
+struct audit_log_index_record
+{
+  int run_id;
+  ruint32_t op;
+  ruint32_t run_uuid[4];
+  int segment;
+  ruint32_t size;
+  long long offset;             /* the offset of the record header */
+};
+
+struct audit_log_chunk
+{
+  ruint32_t run_uuid[4];
+  int segment;
+  ruint32_t size;
+  long long offset;
+  int op;                       /* OP_ENTRY or OP_IMPORT */
+};
+
+struct audit_log_run
+{
+  int u, a;
+  struct audit_log_chunk *v;
+};
+
+struct audit_log_state
+{
+  unsigned char *dir;
+  int sync_flag;
+
+  int index_fd;
+  int cur_segment;
+  int seg_fd;                   /* the segment being appended to */
+  long long seg_size;
+
+  // the entries not yet written, the offsets of the OP_ENTRY records
+  // are relative to the beginning of the buffer
+  unsigned char *buf;
+  size_t buf_u, buf_a;
+  int pend_u, pend_a;
+  struct audit_log_index_record *pend;
+
+  // the index, loaded at the first read
+  int loaded;
+  int run_a;
+  struct audit_log_run *runs;
+  int move_u, move_a;
+  struct audit_log_index_record *moves;
+
+  // the segments opened for reading
+  int read_a;
+  int *read_fds;
+
+  // the compaction in progress, see audit_log_compact_start
+  int compacting;
+  int comp_first;               /* the first new segment */
+  int comp_out_seg;             /* the new segment being written */
+  int comp_out_fd;
+  int comp_new_fd;              /* index.new */
+  long long comp_out_size;
+  long long comp_unsynced;      /* written since the last fdatasync */
+  long long comp_live_size;
+  long long comp_total_size;
+  int comp_u, comp_pos;
+  struct audit_log_comp_chunk *comp;
+  unsigned char *comp_data;
+};
+
+static int
+full_pread(int fd, void *buf, size_t size, long long offset)
+{
+  unsigned char *p = (unsigned char *) buf;
+  ssize_t r;
+
+  while (size > 0) {
+    if ((r = pread(fd, p, size, offset)) <= 0) {
+      if (r < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += r; size -= r; offset += r;
+  }
+  return 0;
+}
+
+static int
+full_write(int fd, const void *buf, size_t size)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  ssize_t w;
+
+  while (size > 0) {
+    if ((w = write(fd, p, size)) <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += w; size -= w;
+  }
+  return 0;
+}
+
+static void
+make_segment_path(
+        const struct audit_log_state *al,
+        unsigned char *path,
+        size_t size,
+        int segment)
+{
+  snprintf(path, size, "%s/%06d.seg", al->dir, segment);
+}
+
+/* the segment written by the compaction, it is renamed to .seg
+   when the compacted index is in place */
+static void
+make_tmp_segment_path(
+        const struct audit_log_state *al,
+        unsigned char *path,
+        size_t size,
+        int segment)
+{
+  snprintf(path, size, "%s/%06d.tmp", al->dir, segment);
+}
+
+static void
+sync_dir(const unsigned char *dir)
+{
+  int fd;
+
+  if ((fd = open(dir, O_RDONLY)) < 0) return;
+  fsync(fd);
+  close(fd);
+}
+
+static int
+find_last_segment(const unsigned char *dir)
+{
+  DIR *d;
+  struct dirent *dd;
+  int num, n, last = 0;
+
+  if (!(d = opendir(dir))) return 0;
+  while ((dd = readdir(d))) {
+    if (sscanf(dd->d_name, "%d%n", &num, &n) == 1
+        && !strcmp(dd->d_name + n, ".seg") && num > last)
+      last = num;
+  }
+  closedir(d);
+  return last;
+}
+
+/* the compaction writes index.new, then the new segments NNNNNN.tmp,
+   and renames index.new to index, then the new segments are renamed
+   to .seg and the old ones are removed. If index.new exists, the
+   compaction is rolled back, otherwise the OP_COMPACT record at the
+   beginning of the index tells which segments are garbage. */
+static int
+finish_compaction(struct audit_log_state *al, int rollback_flag)
+{
+  struct audit_log_index_record ir;
+  DIR *d;
+  struct dirent *dd;
+  int num, n, first = 0;
+  path_t path, seg_path;
+
+  if (!rollback_flag && al->index_fd >= 0
+      && full_pread(al->index_fd, &ir, sizeof(ir), 0) >= 0
+      && ir.op == OP_COMPACT)
+    first = ir.segment;
+
+  if (!(d = opendir(al->dir))) {
+    err("audit_log: cannot open %s: %s", al->dir, os_ErrorMsg());
+    return -1;
+  }
+  while ((dd = readdir(d))) {
+    if (sscanf(dd->d_name, "%d%n", &num, &n) != 1 || num <= 0) continue;
+    if (!strcmp(dd->d_name + n, ".tmp")) {
+      make_tmp_segment_path(al, path, sizeof(path), num);
+      if (first > 0 && num >= first) {
+        make_segment_path(al, seg_path, sizeof(seg_path), num);
+        if (rename(path, seg_path) < 0) {
+          err("audit_log: rename %s failed: %s", path, os_ErrorMsg());
+          closedir(d);
+          return -1;
+        }
+      } else {
+        unlink(path);
+      }
+    } else if (!strcmp(dd->d_name + n, ".seg") && num < first) {
+      make_segment_path(al, path, sizeof(path), num);
+      unlink(path);
+    }
+  }
+  closedir(d);
+  if (rollback_flag) {
+    snprintf(path, sizeof(path), "%s/%s", al->dir, NEW_INDEX_NAME);
+    unlink(path);
+  }
+  sync_dir(al->dir);
+  return 0;
+}
+
+static int
+open_segment(struct audit_log_state *al, int segment)
+{
+  path_t path;
+  struct stat stb;
+
+  make_segment_path(al, path, sizeof(path), segment);
+  if ((al->seg_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644)) < 0) {
+    err("audit_log: cannot open %s: %s", path, os_ErrorMsg());
+    return -1;
+  }
+  if (fstat(al->seg_fd, &stb) < 0) {
+    err("audit_log: fstat %s failed: %s", path, os_ErrorMsg());
+    close(al->seg_fd); al->seg_fd = -1;
+    return -1;
+  }
+  al->cur_segment = segment;
+  al->seg_size = stb.st_size;
+  return 0;
+}
+
+/* adds the entries of the current segment written after the last
+   indexed one to the index, and cuts off the torn tail */
+static int
+recover_segment(struct audit_log_state *al)
+{
+  struct stat stb;
+  struct audit_log_index_record ir;
+  struct audit_log_record rec;
+  long long pos, start = 0;
+  unsigned char *data = 0;
+  int count = 0;
+
+  if (fstat(al->index_fd, &stb) < 0) return -1;
+  for (pos = stb.st_size - (long long) sizeof(ir); pos >= 0;
+       pos -= sizeof(ir)) {
+    if (full_pread(al->index_fd, &ir, sizeof(ir), pos) < 0) return -1;
+    if (ir.op != OP_ENTRY && ir.op != OP_IMPORT) continue;
+    if (ir.segment == al->cur_segment)
+      start = ir.offset + sizeof(rec) + ir.size;
+    break;
+  }
+
+  for (pos = start; pos + (long long) sizeof(rec) <= al->seg_size; ) {
+    if (full_pread(al->seg_fd, &rec, sizeof(rec), pos) < 0) break;
+    if ((memcmp(rec.magic, RECORD_MAGIC, 4) != 0
+         && memcmp(rec.magic, IMPORT_MAGIC, 4) != 0)
+        || rec.run_id < 0 || rec.size > MAX_ENTRY_SIZE
+        || pos + (long long) sizeof(rec) + rec.size > al->seg_size)
+      break;
+    data = xrealloc(data, rec.size + 1);
+    if (full_pread(al->seg_fd, data, rec.size, pos + sizeof(rec)) < 0) break;
+    if (crc32(0, data, rec.size) != rec.crc) break;
+    memset(&ir, 0, sizeof(ir));
+    ir.run_id = rec.run_id;
+    ir.op = memcmp(rec.magic, IMPORT_MAGIC, 4)?OP_ENTRY:OP_IMPORT;
+    memcpy(ir.run_uuid, rec.run_uuid, sizeof(ir.run_uuid));
+    ir.segment = al->cur_segment;
+    ir.size = rec.size;
+    ir.offset = pos;
+    if (full_write(al->index_fd, &ir, sizeof(ir)) < 0) {
+      xfree(data);
+      return -1;
+    }
+    pos += sizeof(rec) + rec.size;
+    ++count;
+  }
+  xfree(data);
+  if (count > 0) {
+    info("audit_log: %s: %d entries recovered", al->dir, count);
+  }
+  if (pos < al->seg_size) {
+    info("audit_log: %s: %lld bytes of segment %d are dropped", al->dir,
+         al->seg_size - pos, al->cur_segment);
+    if (ftruncate(al->seg_fd, pos) < 0) return -1;
+    al->seg_size = pos;
+  }
+  return 0;
+}
+
+struct audit_log_state *
+audit_log_open(const unsigned char *dir, int sync_flag)
+{
+  struct audit_log_state *al = 0;
+  path_t path;
+  struct stat stb;
+  int segment;
+
+  if (!dir || !*dir) return 0;
+  if (os_MakeDirPath(dir, 0775) < 0) {
+    err("audit_log: cannot create %s: %s", dir, os_ErrorMsg());
+    return 0;
+  }
+
+  XCALLOC(al, 1);
+  al->dir = xstrdup(dir);
+  al->sync_flag = sync_flag;
+  al->index_fd = -1;
+  al->seg_fd = -1;
+  al->comp_out_fd = -1;
+  al->comp_new_fd = -1;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, NEW_INDEX_NAME);
+  if (access(path, F_OK) >= 0) {
+    info("audit_log: %s: interrupted compaction is rolled back", dir);
+    if (finish_compaction(al, 1) < 0) goto fail;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", dir, INDEX_NAME);
+  if ((al->index_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644)) < 0) {
+    err("audit_log: cannot open %s: %s", path, os_ErrorMsg());
+    goto fail;
+  }
+  if (fstat(al->index_fd, &stb) < 0) {
+    err("audit_log: fstat %s failed: %s", path, os_ErrorMsg());
+    goto fail;
+  }
+  if (stb.st_size % sizeof(struct audit_log_index_record) != 0) {
+    // a torn index record
+    if (ftruncate(al->index_fd, stb.st_size - stb.st_size % sizeof(struct audit_log_index_record)) < 0) {
+      err("audit_log: ftruncate %s failed: %s", path, os_ErrorMsg());
+      goto fail;
+    }
+  }
+  if (finish_compaction(al, 0) < 0) goto fail;
+
+  if ((segment = find_last_segment(dir)) <= 0) segment = 1;
+  if (open_segment(al, segment) < 0) goto fail;
+  if (recover_segment(al) < 0) {
+    err("audit_log: %s: recovery failed: %s", dir, os_ErrorMsg());
+    goto fail;
+  }
+  return al;
+
+ fail:
+  return audit_log_close(al);
+}
+
+static void abort_compaction(struct audit_log_state *al);
+
+static void
+free_runs(struct audit_log_state *al)
+{
+  int i;
+
+  for (i = 0; i < al->run_a; ++i)
+    xfree(al->runs[i].v);
+  xfree(al->runs);
+  al->runs = 0;
+  al->run_a = 0;
+}
+
+struct audit_log_state *
+audit_log_close(struct audit_log_state *al)
+{
+  int i;
+
+  if (!al) return 0;
+  audit_log_flush(al);
+  if (al->compacting) abort_compaction(al);
+  xfree(al->comp_data);
+  if (al->index_fd >= 0) close(al->index_fd);
+  if (al->seg_fd >= 0) close(al->seg_fd);
+  for (i = 0; i < al->read_a; ++i) {
+    if (al->read_fds[i] >= 0) close(al->read_fds[i]);
+  }
+  xfree(al->read_fds);
+  free_runs(al);
+  xfree(al->moves);
+  xfree(al->buf);
+  xfree(al->pend);
+  xfree(al->dir);
+  memset(al, 0, sizeof(*al));
+  xfree(al);
+  return 0;
+}
+
+static struct audit_log_index_record *
+add_pending(struct audit_log_state *al, int op, int run_id)
+{
+  struct audit_log_index_record *ir;
+
+  if (al->pend_u == al->pend_a) {
+    if (!(al->pend_a *= 2)) al->pend_a = 64;
+    XREALLOC(al->pend, al->pend_a);
+  }
+  ir = &al->pend[al->pend_u++];
+  memset(ir, 0, sizeof(*ir));
+  ir->op = op;
+  ir->run_id = run_id;
+  return ir;
+}
+
+static void
+queue_entry(
+        struct audit_log_state *al,
+        int op,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        const unsigned char *text,
+        size_t size)
+{
+  struct audit_log_record rec;
+  struct audit_log_index_record *ir;
+
+  memset(&rec, 0, sizeof(rec));
+  memcpy(rec.magic, (op == OP_IMPORT)?IMPORT_MAGIC:RECORD_MAGIC, 4);
+  rec.run_id = run_id;
+  if (run_uuid) memcpy(rec.run_uuid, run_uuid, sizeof(rec.run_uuid));
+  rec.size = size;
+  rec.crc = crc32(0, text, size);
+
+  if (al->buf_u + sizeof(rec) + size > al->buf_a) {
+    if (!al->buf_a) al->buf_a = 16384;
+    while (al->buf_u + sizeof(rec) + size > al->buf_a) al->buf_a *= 2;
+    al->buf = xrealloc(al->buf, al->buf_a);
+  }
+
+  ir = add_pending(al, op, run_id);
+  memcpy(ir->run_uuid, rec.run_uuid, sizeof(ir->run_uuid));
+  ir->size = size;
+  ir->offset = al->buf_u;
+
+  memcpy(al->buf + al->buf_u, &rec, sizeof(rec));
+  memcpy(al->buf + al->buf_u + sizeof(rec), text, size);
+  al->buf_u += sizeof(rec) + size;
+}
+
+void
+audit_log_append(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        const unsigned char *text,
+        size_t size)
+{
+  if (!al || run_id < 0 || size > MAX_ENTRY_SIZE) return;
+
+  queue_entry(al, OP_ENTRY, run_id, run_uuid, text, size);
+  // the entry must be on the disk, when the event is reported
+  if (al->sync_flag || al->buf_u >= MAX_PENDING_SIZE) audit_log_flush(al);
+}
+
+int
+audit_log_import(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        const unsigned char *text,
+        size_t size)
+{
+  if (!al || run_id < 0 || size > MAX_ENTRY_SIZE) return -1;
+
+  queue_entry(al, OP_IMPORT, run_id, run_uuid, text, size);
+  if (al->buf_u >= MAX_PENDING_SIZE) audit_log_flush(al);
+  return 0;
+}
+
+static struct audit_log_run *
+get_run(struct audit_log_state *al, int run_id)
+{
+  int new_a;
+  struct audit_log_run *new_runs;
+
+  if (run_id >= al->run_a) {
+    if (!(new_a = al->run_a)) new_a = 1024;
+    while (run_id >= new_a) new_a *= 2;
+    XCALLOC(new_runs, new_a);
+    if (al->run_a > 0)
+      memcpy(new_runs, al->runs, al->run_a * sizeof(new_runs[0]));
+    xfree(al->runs);
+    al->runs = new_runs;
+    al->run_a = new_a;
+  }
+  return &al->runs[run_id];
+}
+
+static void
+apply_moves(struct audit_log_state *al)
+{
+  struct audit_log_run *saved;
+  struct audit_log_run *r;
+  int i;
+
+  if (al->move_u <= 0) return;
+  XCALLOC(saved, al->move_u);
+  for (i = 0; i < al->move_u; ++i) {
+    r = get_run(al, al->moves[i].segment);
+    saved[i] = *r;
+    memset(r, 0, sizeof(*r));
+  }
+  for (i = 0; i < al->move_u; ++i) {
+    r = get_run(al, al->moves[i].run_id);
+    xfree(r->v);
+    *r = saved[i];
+  }
+  xfree(saved);
+  al->move_u = 0;
+}
+
+static void
+apply_record(struct audit_log_state *al, const struct audit_log_index_record *ir)
+{
+  struct audit_log_run *r;
+  struct audit_log_chunk *c;
+
+  if (ir->run_id < 0) return;
+  switch (ir->op) {
+  case OP_ENTRY:
+  case OP_IMPORT:
+    r = get_run(al, ir->run_id);
+    if (r->u == r->a) {
+      if (!(r->a *= 2)) r->a = 4;
+      XREALLOC(r->v, r->a);
+    }
+    c = &r->v[r->u++];
+    memcpy(c->run_uuid, ir->run_uuid, sizeof(c->run_uuid));
+    c->segment = ir->segment;
+    c->size = ir->size;
+    c->offset = ir->offset;
+    c->op = ir->op;
+    break;
+  case OP_REMOVE:
+    if (ir->run_id < al->run_a) al->runs[ir->run_id].u = 0;
+    break;
+  case OP_MOVE:
+    if (ir->segment < 0) break;
+    if (al->move_u == al->move_a) {
+      if (!(al->move_a *= 2)) al->move_a = 16;
+      XREALLOC(al->moves, al->move_a);
+    }
+    al->moves[al->move_u++] = *ir;
+    break;
+  case OP_MOVE_END:
+    apply_moves(al);
+    break;
+  }
+}
+
+static int
+do_flush(struct audit_log_state *al, int sync_flag)
+{
+  int i, retval = 0;
+  struct audit_log_index_record *ir;
+
+  if (!al->pend_u) return 0;
+
+  if (al->buf_u > 0) {
+    // the numbers after the current segment are taken by the compaction
+    if (!al->compacting && al->seg_size > 0
+        && al->seg_size + al->buf_u > MAX_SEGMENT_SIZE) {
+      // the entries flushed earlier without the sync
+      if (sync_flag) fdatasync(al->seg_fd);
+      close(al->seg_fd); al->seg_fd = -1;
+      if (open_segment(al, al->cur_segment + 1) < 0) goto fail;
+    }
+    if (full_write(al->seg_fd, al->buf, al->buf_u) < 0) {
+      err("audit_log: %s: segment write failed: %s", al->dir, os_ErrorMsg());
+      // the partial write is cut off on the next open
+      goto fail;
+    }
+    if (sync_flag && fdatasync(al->seg_fd) < 0) {
+      err("audit_log: %s: fdatasync failed: %s", al->dir, os_ErrorMsg());
+      retval = -1;
+    }
+  }
+  for (i = 0; i < al->pend_u; ++i) {
+    ir = &al->pend[i];
+    if (ir->op != OP_ENTRY && ir->op != OP_IMPORT) continue;
+    ir->segment = al->cur_segment;
+    ir->offset += al->seg_size;
+  }
+  al->seg_size += al->buf_u;
+  if (full_write(al->index_fd, al->pend, al->pend_u * sizeof(al->pend[0])) < 0) {
+    err("audit_log: %s: index write failed: %s", al->dir, os_ErrorMsg());
+    // the entries are recovered from the segment on the next open
+    retval = -1;
+  } else if (sync_flag && fdatasync(al->index_fd) < 0) {
+    err("audit_log: %s: fdatasync failed: %s", al->dir, os_ErrorMsg());
+    retval = -1;
+  }
+  if (al->loaded) {
+    for (i = 0; i < al->pend_u; ++i)
+      apply_record(al, &al->pend[i]);
+  }
+  al->buf_u = 0;
+  al->pend_u = 0;
+  return retval;
+
+ fail:
+  // do not let the queue grow without bound
+  err("audit_log: %s: %d records are lost", al->dir, al->pend_u);
+  al->buf_u = 0;
+  al->pend_u = 0;
+  return -1;
+}
+
+int
+audit_log_flush(struct audit_log_state *al)
+{
+  if (!al) return 0;
+  return do_flush(al, al->sync_flag);
+}
+
+int
+audit_log_sync(struct audit_log_state *al)
+{
+  if (!al) return -1;
+  if (!al->pend_u) {
+    if (fdatasync(al->seg_fd) < 0 || fdatasync(al->index_fd) < 0) {
+      err("audit_log: %s: fdatasync failed: %s", al->dir, os_ErrorMsg());
+      return -1;
+    }
+    return 0;
+  }
+  return do_flush(al, 1);
+}
+
+static int
+load_index(struct audit_log_state *al)
+{
+  struct stat stb;
+  struct audit_log_index_record *recs = 0;
+  size_t count, i;
+
+  if (al->loaded) return 0;
+  if (fstat(al->index_fd, &stb) < 0) {
+    err("audit_log: %s: fstat failed: %s", al->dir, os_ErrorMsg());
+    return -1;
+  }
+  count = stb.st_size / sizeof(recs[0]);
+  if (count > 0) {
+    XCALLOC(recs, count);
+    if (full_pread(al->index_fd, recs, count * sizeof(recs[0]), 0) < 0) {
+      err("audit_log: %s: index read failed: %s", al->dir, os_ErrorMsg());
+      xfree(recs);
+      return -1;
+    }
+    for (i = 0; i < count; ++i)
+      apply_record(al, &recs[i]);
+    xfree(recs);
+  }
+  al->loaded = 1;
+  return 0;
+}
+
+static int
+get_read_fd(struct audit_log_state *al, int segment)
+{
+  path_t path;
+  int new_a, i;
+
+  if (segment <= 0) return -1;
+  if (segment >= al->read_a) {
+    if (!(new_a = al->read_a)) new_a = 16;
+    while (segment >= new_a) new_a *= 2;
+    XREALLOC(al->read_fds, new_a);
+    for (i = al->read_a; i < new_a; ++i) al->read_fds[i] = -1;
+    al->read_a = new_a;
+  }
+  if (al->read_fds[segment] < 0) {
+    make_segment_path(al, path, sizeof(path), segment);
+    if ((al->read_fds[segment] = open(path, O_RDONLY)) < 0) {
+      err("audit_log: cannot open %s: %s", path, os_ErrorMsg());
+    }
+  }
+  return al->read_fds[segment];
+}
+
+/* reads the record header and the text of the chunk to *p_data */
+static int
+read_chunk(
+        struct audit_log_state *al,
+        const struct audit_log_chunk *c,
+        struct audit_log_record *rec,
+        unsigned char **p_data)
+{
+  int fd;
+
+  if ((fd = get_read_fd(al, c->segment)) < 0) return -1;
+  *p_data = xrealloc(*p_data, c->size + 1);
+  if (full_pread(fd, rec, sizeof(*rec), c->offset) < 0
+      || memcmp(rec->magic,
+                (c->op == OP_IMPORT)?IMPORT_MAGIC:RECORD_MAGIC, 4) != 0
+      || rec->size != c->size
+      || full_pread(fd, *p_data, c->size, c->offset + sizeof(*rec)) < 0
+      || crc32(0, *p_data, c->size) != rec->crc) {
+    err("audit_log: %s: invalid entry at %d:%lld", al->dir, c->segment,
+        c->offset);
+    return -1;
+  }
+  return 0;
+}
+
+int
+audit_log_read(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        FILE *out)
+{
+  struct audit_log_run *r;
+  struct audit_log_chunk *c;
+  struct audit_log_record rec;
+  unsigned char *data = 0;
+  int i, pass, count = 0;
+  ruint32_t zero_uuid[4] = { 0, 0, 0, 0 };
+
+  if (!al || run_id < 0) return -1;
+  if (!run_uuid) run_uuid = zero_uuid;
+  audit_log_flush(al);
+  if (load_index(al) < 0) return -1;
+  if (run_id >= al->run_a) return 0;
+  r = &al->runs[run_id];
+  // the imported legacy log precedes the entries written to the store
+  for (pass = 0; pass < 2; ++pass) {
+    for (i = 0; i < r->u; ++i) {
+      c = &r->v[i];
+      if ((c->op == OP_IMPORT) != !pass) continue;
+      // the entries of another run with the same number
+      if (memcmp(c->run_uuid, run_uuid, sizeof(c->run_uuid)) != 0) continue;
+      if (read_chunk(al, c, &rec, &data) < 0) goto fail;
+      fwrite(data, 1, c->size, out);
+      ++count;
+    }
+  }
+  xfree(data);
+  return count;
+
+ fail:
+  xfree(data);
+  return -1;
+}
+
+int
+audit_log_is_imported(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4])
+{
+  struct audit_log_run *r;
+  int i;
+  ruint32_t zero_uuid[4] = { 0, 0, 0, 0 };
+
+  if (!al || run_id < 0) return 0;
+  if (!run_uuid) run_uuid = zero_uuid;
+  if (load_index(al) < 0 || run_id >= al->run_a) return 0;
+  r = &al->runs[run_id];
+  for (i = 0; i < r->u; ++i) {
+    if (r->v[i].op == OP_IMPORT
+        && !memcmp(r->v[i].run_uuid, run_uuid, sizeof(r->v[i].run_uuid)))
+      return 1;
+  }
+  return 0;
+}
+
+void
+audit_log_remove(struct audit_log_state *al, int run_id)
+{
+  if (!al || run_id < 0) return;
+  add_pending(al, OP_REMOVE, run_id);
+}
+
+void
+audit_log_renumber(
+        struct audit_log_state *al,
+        int count,
+        const int *from,
+        const int *to)
+{
+  struct audit_log_index_record *ir;
+  int i;
+
+  if (!al || count <= 0) return;
+  for (i = 0; i < count; ++i) {
+    if (from[i] < 0 || to[i] < 0 || from[i] == to[i]) continue;
+    ir = add_pending(al, OP_MOVE, to[i]);
+    ir->segment = from[i];
+  }
+  add_pending(al, OP_MOVE_END, 0);
+}
+
+static long long
+get_total_size(const struct audit_log_state *al)
+{
+  DIR *d;
+  struct dirent *dd;
+  int num, n;
+  path_t path;
+  struct stat stb;
+  long long total = 0;
+
+  if (!(d = opendir(al->dir))) return 0;
+  while ((dd = readdir(d))) {
+    if (sscanf(dd->d_name, "%d%n", &num, &n) != 1
+        || strcmp(dd->d_name + n, ".seg") != 0)
+      continue;
+    make_segment_path(al, path, sizeof(path), num);
+    if (stat(path, &stb) >= 0) total += stb.st_size;
+  }
+  closedir(d);
+  return total;
+}
+
+static int
+open_tmp_segment(struct audit_log_state *al, int segment)
+{
+  path_t path;
+  int fd;
+
+  make_tmp_segment_path(al, path, sizeof(path), segment);
+  if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    err("audit_log: cannot create %s: %s", path, os_ErrorMsg());
+  }
+  return fd;
+}
+
+/* the live chunk at the start of the compaction and its new place */
+struct audit_log_comp_chunk
+{
+  struct audit_log_chunk c;
+  int new_segment;
+  long long new_offset;
+};
+
+static int
+comp_chunk_sort_func(const void *p1, const void *p2)
+{
+  const struct audit_log_comp_chunk *c1 = p1, *c2 = p2;
+
+  if (c1->c.segment != c2->c.segment)
+    return (c1->c.segment < c2->c.segment)?-1:1;
+  if (c1->c.offset != c2->c.offset)
+    return (c1->c.offset < c2->c.offset)?-1:1;
+  return 0;
+}
+
+static void
+abort_compaction(struct audit_log_state *al)
+{
+  if (al->comp_out_fd >= 0) close(al->comp_out_fd);
+  if (al->comp_new_fd >= 0) close(al->comp_new_fd);
+  al->comp_out_fd = -1;
+  al->comp_new_fd = -1;
+  finish_compaction(al, 1);
+  xfree(al->comp);
+  al->comp = 0;
+  al->comp_u = al->comp_pos = 0;
+  al->compacting = 0;
+}
+
+/* copies the chunk to the segment being compacted to */
+static int
+copy_chunk(
+        struct audit_log_state *al,
+        const struct audit_log_chunk *c,
+        int *p_segment,
+        long long *p_offset)
+{
+  struct audit_log_record rec;
+
+  if (read_chunk(al, c, &rec, &al->comp_data) < 0) return -1;
+  if (al->comp_out_size > 0
+      && al->comp_out_size + sizeof(rec) + c->size > MAX_SEGMENT_SIZE) {
+    if (fdatasync(al->comp_out_fd) < 0) goto write_fail;
+    close(al->comp_out_fd);
+    if ((al->comp_out_fd = open_tmp_segment(al, ++al->comp_out_seg)) < 0)
+      return -1;
+    al->comp_out_size = 0;
+    al->comp_unsynced = 0;
+  }
+  if (full_write(al->comp_out_fd, &rec, sizeof(rec)) < 0
+      || full_write(al->comp_out_fd, al->comp_data, c->size) < 0)
+    goto write_fail;
+  *p_segment = al->comp_out_seg;
+  *p_offset = al->comp_out_size;
+  al->comp_out_size += sizeof(rec) + c->size;
+  // otherwise the commit step would sync the whole segment at once
+  al->comp_unsynced += sizeof(rec) + c->size;
+  if (al->comp_unsynced >= COMP_SYNC_SIZE) {
+    if (fdatasync(al->comp_out_fd) < 0) goto write_fail;
+    al->comp_unsynced = 0;
+  }
+  return 0;
+
+ write_fail:
+  err("audit_log: %s: compaction write failed: %s", al->dir, os_ErrorMsg());
+  return -1;
+}
+
+int
+audit_log_compact_start(struct audit_log_state *al, int force_flag)
+{
+  long long live_size = 0, total_size;
+  int i, j;
+  path_t new_path;
+  struct audit_log_comp_chunk *cc;
+
+  if (!al) return -1;
+  if (al->compacting) return 0;
+  if (audit_log_flush(al) < 0) return -1;
+  if (load_index(al) < 0) return -1;
+  for (i = 0; i < al->run_a; ++i)
+    for (j = 0; j < al->runs[i].u; ++j)
+      live_size += sizeof(struct audit_log_record) + al->runs[i].v[j].size;
+  total_size = get_total_size(al);
+  if (!force_flag && total_size <= 2 * live_size) return 0;
+
+  snprintf(new_path, sizeof(new_path), "%s/%s", al->dir, NEW_INDEX_NAME);
+  // index.new must be on the disk before any new segment
+  if ((al->comp_new_fd = open(new_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    err("audit_log: cannot create %s: %s", new_path, os_ErrorMsg());
+    return -1;
+  }
+  sync_dir(al->dir);
+
+  al->compacting = 1;
+  al->comp_first = al->comp_out_seg = al->cur_segment + 1;
+  al->comp_out_size = 0;
+  al->comp_unsynced = 0;
+  al->comp_live_size = live_size;
+  al->comp_total_size = total_size;
+  if ((al->comp_out_fd = open_tmp_segment(al, al->comp_out_seg)) < 0) {
+    abort_compaction(al);
+    return -1;
+  }
+
+  // the chunks are copied in the order of the old segments
+  al->comp_u = al->comp_pos = 0;
+  for (i = 0; i < al->run_a; ++i)
+    al->comp_u += al->runs[i].u;
+  XCALLOC(al->comp, al->comp_u + 1);
+  cc = al->comp;
+  for (i = 0; i < al->run_a; ++i) {
+    for (j = 0; j < al->runs[i].u; ++j, ++cc) {
+      cc->c = al->runs[i].v[j];
+      cc->new_segment = -1;
+    }
+  }
+  qsort(al->comp, al->comp_u, sizeof(al->comp[0]), comp_chunk_sort_func);
+  return 1;
+}
+
+int
+audit_log_is_compacting(const struct audit_log_state *al)
+{
+  return al && al->compacting;
+}
+
+/* the entries may be appended, removed and moved since the start,
+   so the new index is built from the current one: the chunks already
+   copied get their new places, the chunks appended since the start
+   are copied now */
+static int
+commit_compaction(struct audit_log_state *al)
+{
+  struct audit_log_index_record *recs = 0, *ir;
+  struct audit_log_comp_chunk key, *cc;
+  struct audit_log_chunk *c;
+  int i, j, rec_u = 0, rec_a = 0, segment;
+  long long offset;
+  path_t new_path, index_path;
+
+  if (audit_log_flush(al) < 0) return -1;
+
+  rec_a = 64;
+  XCALLOC(recs, rec_a);
+  recs[rec_u].op = OP_COMPACT;
+  recs[rec_u].segment = al->comp_first;
+  ++rec_u;
+  for (i = 0; i < al->run_a; ++i) {
+    for (j = 0; j < al->runs[i].u; ++j) {
+      c = &al->runs[i].v[j];
+      memset(&key, 0, sizeof(key));
+      key.c.segment = c->segment;
+      key.c.offset = c->offset;
+      cc = bsearch(&key, al->comp, al->comp_u, sizeof(al->comp[0]),
+                   comp_chunk_sort_func);
+      if (cc && cc->new_segment > 0) {
+        segment = cc->new_segment;
+        offset = cc->new_offset;
+      } else if (copy_chunk(al, c, &segment, &offset) < 0) {
+        goto fail;
+      }
+      if (rec_u == rec_a) {
+        rec_a *= 2;
+        XREALLOC(recs, rec_a);
+      }
+      ir = &recs[rec_u++];
+      memset(ir, 0, sizeof(*ir));
+      ir->run_id = i;
+      ir->op = c->op;
+      memcpy(ir->run_uuid, c->run_uuid, sizeof(ir->run_uuid));
+      ir->segment = segment;
+      ir->size = c->size;
+      ir->offset = offset;
+    }
+  }
+  if (fdatasync(al->comp_out_fd) < 0) goto write_fail;
+  close(al->comp_out_fd); al->comp_out_fd = -1;
+  if (full_write(al->comp_new_fd, recs, rec_u * sizeof(recs[0])) < 0
+      || fdatasync(al->comp_new_fd) < 0)
+    goto write_fail;
+  close(al->comp_new_fd); al->comp_new_fd = -1;
+
+  // the commit point
+  snprintf(new_path, sizeof(new_path), "%s/%s", al->dir, NEW_INDEX_NAME);
+  snprintf(index_path, sizeof(index_path), "%s/%s", al->dir, INDEX_NAME);
+  if (rename(new_path, index_path) < 0) {
+    err("audit_log: rename %s failed: %s", new_path, os_ErrorMsg());
+    goto fail;
+  }
+  sync_dir(al->dir);
+  al->compacting = 0;
+  xfree(al->comp); al->comp = 0;
+  al->comp_u = al->comp_pos = 0;
+
+  // the old segments are garbage now
+  for (i = 0; i < al->read_a; ++i) {
+    if (al->read_fds[i] >= 0) close(al->read_fds[i]);
+    al->read_fds[i] = -1;
+  }
+  close(al->index_fd);
+  if ((al->index_fd = open(index_path, O_RDWR | O_APPEND)) < 0) {
+    err("audit_log: cannot open %s: %s", index_path, os_ErrorMsg());
+    // the store is unusable until reopened
+    xfree(recs);
+    return -1;
+  }
+  if (finish_compaction(al, 0) < 0) {
+    xfree(recs);
+    return -1;
+  }
+  close(al->seg_fd); al->seg_fd = -1;
+  if (open_segment(al, al->comp_out_seg) < 0) {
+    xfree(recs);
+    return -1;
+  }
+  free_runs(al);
+  for (i = 0; i < rec_u; ++i)
+    apply_record(al, &recs[i]);
+
+  info("audit_log: %s: compacted, %lld of %lld bytes are live", al->dir,
+       al->comp_live_size, al->comp_total_size);
+  xfree(recs);
+  return 0;
+
+ write_fail:
+  err("audit_log: %s: compaction write failed: %s", al->dir, os_ErrorMsg());
+ fail:
+  xfree(recs);
+  abort_compaction(al);
+  return -1;
+}
+
+int
+audit_log_compact_step(struct audit_log_state *al, int *p_count, int max_count)
+{
+  struct audit_log_comp_chunk *cc;
+
+  if (!al || !al->compacting) return 0;
+  while (al->comp_pos < al->comp_u && *p_count < max_count) {
+    cc = &al->comp[al->comp_pos++];
+    if (copy_chunk(al, &cc->c, &cc->new_segment, &cc->new_offset) < 0) {
+      abort_compaction(al);
+      return -1;
+    }
+    ++(*p_count);
+  }
+  if (al->comp_pos < al->comp_u) return 1;
+  if (commit_compaction(al) < 0) return -1;
+  return 0;
+}
+
+int
+audit_log_compact(struct audit_log_state *al, int force_flag)
+{
+  int r, count = 0;
+
+  if ((r = audit_log_compact_start(al, force_flag)) <= 0) return r;
+  while ((r = audit_log_compact_step(al, &count, INT_MAX)) > 0);
+  return (r < 0)?-1:1;
+}
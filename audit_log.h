@@ -0,0 +1,122 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __AUDIT_LOG_H__
+#define __AUDIT_LOG_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "ej_types.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * The audit log store of a contest. The entries are collected in the
+ * memory and appended to the segment files NNNNNN.seg by
+ * audit_log_flush, which the server calls once per main loop
+ * iteration. The index file is the log of the entries written to the
+ * segments and of the run removals and renumberings, it is loaded only
+ * when an audit log is read. The space of the removed entries is
+ * reclaimed by audit_log_compact.
+ *
+ * The store assumes a single writing process.
+ */
+
+struct audit_log_state;
+
+/* opens the store in the directory, the directory is created if
+   necessary, if sync_flag is set, every entry is written and synced
+   to the disk by audit_log_append itself */
+struct audit_log_state *
+audit_log_open(const unsigned char *dir, int sync_flag);
+
+/* flushes the pending entries and closes the store */
+struct audit_log_state *audit_log_close(struct audit_log_state *al);
+
+/* queues the entry of the run */
+void
+audit_log_append(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        const unsigned char *text,
+        size_t size);
+
+/* queues the legacy audit log of the run (the file written before
+   the store was used), it is read before the other entries of the run,
+   returns -1, if the log is too big */
+int
+audit_log_import(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        const unsigned char *text,
+        size_t size);
+
+/* checks, that the legacy audit log of the run is imported, the
+   pending entries are not taken into account */
+int
+audit_log_is_imported(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4]);
+
+/* writes the pending entries, returns -1 on error */
+int audit_log_flush(struct audit_log_state *al);
+
+/* writes the pending entries and syncs the store regardless of
+   sync_flag, returns -1 on error */
+int audit_log_sync(struct audit_log_state *al);
+
+/* copies the live entries to the new segments and removes the old
+   ones, if more than half of the store is garbage or force_flag is
+   set, the store is consistent if the process crashes at any point,
+   returns 1, if compacted, 0, if not necessary, -1 on error */
+int audit_log_compact(struct audit_log_state *al, int force_flag);
+
+/* the same compaction done by steps, the store is used as usual
+   between the steps: audit_log_compact_start returns 1, if the
+   compaction is started, 0, if it is not necessary or is running,
+   audit_log_compact_step copies up to max_count - *p_count entries,
+   returns 1, if there is more to do, 0, when the compaction is done,
+   -1 on error, then the compaction is rolled back */
+int audit_log_compact_start(struct audit_log_state *al, int force_flag);
+int
+audit_log_compact_step(struct audit_log_state *al, int *p_count, int max_count);
+int audit_log_is_compacting(const struct audit_log_state *al);
+
+/* writes all the entries of the run with the given uuid to out,
+   returns the number of the entries, or -1 on error */
+int
+audit_log_read(
+        struct audit_log_state *al,
+        int run_id,
+        const ruint32_t run_uuid[4],
+        FILE *out);
+
+/* forgets the entries of the run, the imported ones too */
+void audit_log_remove(struct audit_log_state *al, int run_id);
+
+/* moves the entries of the runs from[i] to the runs to[i], all the
+   moves are done at once, the entries of the runs, which are moved
+   and are not the targets, are forgotten */
+void
+audit_log_renumber(
+        struct audit_log_state *al,
+        int count,
+        const int *from,
+        const int *to);
+
+#endif /* __AUDIT_LOG_H__ */
@@ -151,6 +151,7 @@ void checker_OK(void) LIBCHECKER_ATTRIB((noreturn));
 void *xmalloc(size_t size);
 void *xcalloc(size_t nmemb, size_t size);
 void *xrealloc(void *ptr, size_t size);
+void xfree(void *ptr);
 char *xstrdup(const char *str);
 
 void checker_corr_close(void);
@@ -167,6 +168,28 @@ int  checker_read_buf(int, const char *, int,
 char *checker_read_buf_2(int ind, const char *name, int eof_error_flag,
                          char *sbuf, size_t ssz, char **pdbuf, size_t *pdsz);
 
+/* token of a memory mapped input file, see mapped_input.c */
+struct checker_mapped_token
+{
+  const char *data;             /* not \0-terminated */
+  size_t len;
+  int bad_char;                 /* index of the first control char or -1 */
+};
+
+FILE *checker_mapped_fopen(const char *path);
+int checker_mapped_next_token(FILE *f, struct checker_mapped_token *tok);
+char *checker_mapped_copy_token(const struct checker_mapped_token *tok,
+                                char *sbuf, size_t ssz,
+                                char **pdbuf, size_t *pdsz);
+
+/* strtol and friends for base 10 with the fast path for short numbers */
+long checker_strtol(const char *str, char **p_end);
+unsigned long checker_strtoul(const char *str, char **p_end);
+long long checker_strtoll(const char *str, char **p_end);
+unsigned long long checker_strtoull(const char *str, char **p_end);
+double checker_strtod(const char *str, char **p_end);
+long double checker_strtold(const char *str, char **p_end);
+
 void checker_in_open(const char *path);
 void checker_out_open(const char *path);
 void checker_corr_open(const char *path);
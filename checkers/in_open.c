@@ -30,7 +30,7 @@ checker_in_open(const char *path)
   if (f_arr[0]) fclose(f_arr[0]);
   f_arr[0] = 0;
 
-  if (!(f_in = fopen(path, "r")))
+  if (!(f_in = checker_mapped_fopen(path)))
     fatal_CF(_("%s: cannot open %s for reading"), gettext(f_arr_names[0]), path);
   f_arr[0] = f_in;
 }
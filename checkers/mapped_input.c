@@ -0,0 +1,303 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "checker_internal.h"
+
+/*
+ * Memory mapped input files.
+ *
+ * A mapped file is opened as a stdio cookie stream, which reads
+ * from the mapping, so any code may use f_in, f_out, f_corr as usual.
+ * The token reading functions bypass stdio and scan the mapping
+ * directly. On the first token after the stdio reading the stdio buffer
+ * is dropped, and after that the token functions just move the position
+ * of the cookie. stdio has nothing buffered, so its next read or seek
+ * goes to the cookie and continues at the end of the last token, and
+ * both ways of reading may be mixed freely.
+ *
+ * fopencookie is available in glibc only, so on other systems the
+ * files are opened with fopen as before.
+ */
+
+#if defined __GLIBC__ && !defined __MINGW32__
+
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct mapped_file
+{
+  FILE *f;
+  const unsigned char *data;
+  size_t size;
+  size_t pos;
+  int token_mode;               /* the stdio buffer is empty */
+};
+
+enum { MAX_MAPPED_FILES = 8 };
+static struct mapped_file *mapped_files[MAX_MAPPED_FILES];
+
+static ssize_t
+mapped_read(void *cookie, char *buf, size_t size)
+{
+  struct mapped_file *mf = (struct mapped_file *) cookie;
+
+  mf->token_mode = 0;
+  if (size > mf->size - mf->pos) size = mf->size - mf->pos;
+  memcpy(buf, mf->data + mf->pos, size);
+  mf->pos += size;
+  return size;
+}
+
+static int
+mapped_seek(void *cookie, off64_t *poffset, int whence)
+{
+  struct mapped_file *mf = (struct mapped_file *) cookie;
+  off64_t pos;
+
+  mf->token_mode = 0;
+  switch (whence) {
+  case SEEK_SET: pos = *poffset; break;
+  case SEEK_CUR: pos = mf->pos + *poffset; break;
+  case SEEK_END: pos = mf->size + *poffset; break;
+  default:
+    errno = EINVAL;
+    return -1;
+  }
+  if (pos < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  // like with regular files seeking past the end is allowed
+  mf->pos = pos;
+  if (mf->pos > mf->size) mf->pos = mf->size;
+  *poffset = pos;
+  return 0;
+}
+
+static int
+mapped_close(void *cookie)
+{
+  struct mapped_file *mf = (struct mapped_file *) cookie;
+  int i;
+
+  for (i = 0; i < MAX_MAPPED_FILES; ++i) {
+    if (mapped_files[i] == mf) mapped_files[i] = 0;
+  }
+  munmap((void*) mf->data, mf->size);
+  xfree(mf);
+  return 0;
+}
+
+static const cookie_io_functions_t mapped_funcs =
+{
+  mapped_read,
+  NULL,
+  mapped_seek,
+  mapped_close,
+};
+
+FILE *
+checker_mapped_fopen(const char *path)
+{
+  int fd, i;
+  struct stat stb;
+  void *data;
+  struct mapped_file *mf;
+  FILE *f;
+
+  if (getenv("EJ_CHECKER_NO_MMAP")) return fopen(path, "r");
+
+  for (i = 0; i < MAX_MAPPED_FILES && mapped_files[i]; ++i);
+  if (i == MAX_MAPPED_FILES) return fopen(path, "r");
+
+  if ((fd = open(path, O_RDONLY, 0)) < 0) return NULL;
+  // empty files, pipes, devices are not mapped
+  if (fstat(fd, &stb) < 0 || !S_ISREG(stb.st_mode) || stb.st_size <= 0
+      || (off_t) (size_t) stb.st_size != stb.st_size) {
+    close(fd);
+    return fopen(path, "r");
+  }
+  data = mmap(NULL, stb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return fopen(path, "r");
+  madvise(data, stb.st_size, MADV_SEQUENTIAL);
+
+  mf = (struct mapped_file *) xcalloc(1, sizeof(*mf));
+  mf->data = (const unsigned char *) data;
+  mf->size = stb.st_size;
+  if (!(f = fopencookie(mf, "r", mapped_funcs))) {
+    munmap(data, stb.st_size);
+    xfree(mf);
+    return fopen(path, "r");
+  }
+  mf->f = f;
+  mapped_files[i] = mf;
+  return f;
+}
+
+static inline struct mapped_file *
+mapped_find(FILE *f)
+{
+  int i;
+
+  if (!f) return 0;
+  for (i = 0; i < MAX_MAPPED_FILES; ++i) {
+    if (mapped_files[i] && mapped_files[i]->f == f) return mapped_files[i];
+  }
+  return 0;
+}
+
+/*
+ * finds the end of the token starting at p: the first space character,
+ * or e. The first control character is stored to *p_bad.
+ * All the bytes <= ' ' and >= 0x80 are checked with isspace, so the
+ * result is the same in any locale; only the other bytes are skipped
+ * 16 at a time.
+ */
+static inline const unsigned char *
+scan_token(const unsigned char *p, const unsigned char *e,
+           const unsigned char **p_bad)
+{
+#if defined __SSE2__
+  const __m128i lim = _mm_set1_epi8(' ' + 1);
+  __m128i v;
+  int mask;
+
+  while (e - p >= 16) {
+    v = _mm_loadu_si128((const __m128i *) p);
+    // signed comparison: both the bytes <= ' ' and >= 0x80 are marked
+    if (!(mask = _mm_movemask_epi8(_mm_cmplt_epi8(v, lim)))) {
+      p += 16;
+      continue;
+    }
+    p += __builtin_ctz(mask);
+    if (isspace(*p)) return p;
+    if (*p < ' ' && !*p_bad) *p_bad = p;
+    ++p;
+  }
+#endif
+  for (; p < e && !isspace(*p); ++p) {
+    if (*p < ' ' && !*p_bad) *p_bad = p;
+  }
+  return p;
+}
+
+/* drops the stdio buffer, so the cookie position is the position
+   of the stream, this is done once when the token reading starts,
+   stdio sees the moves of the cookie position on its next read */
+static int
+mapped_enter_token_mode(struct mapped_file *mf)
+{
+  off_t pos;
+
+  // the logical position, the data buffered or pushed back is counted
+  if ((pos = ftello(mf->f)) < 0) return -1;
+  // the seek leaves the buffer, if the position is inside it,
+  // the flush gives the buffered data back to the cookie
+  if (fseeko(mf->f, pos, SEEK_SET) < 0 || fflush(mf->f) < 0) return -1;
+  if (pos > mf->size) pos = mf->size;
+  mf->pos = pos;
+  mf->token_mode = 1;
+  return 0;
+}
+
+int
+checker_mapped_next_token(FILE *f, struct checker_mapped_token *tok)
+{
+  struct mapped_file *mf;
+  const unsigned char *p, *q, *e, *bad = 0;
+
+  if (!(mf = mapped_find(f))) return -1;
+  if (!mf->token_mode && mapped_enter_token_mode(mf) < 0) return -1;
+
+  p = mf->data + mf->pos;
+  e = mf->data + mf->size;
+  while (p < e && isspace(*p)) ++p;
+  if (p == e) {
+    mf->pos = mf->size;
+    // set the EOF indicator as the stdio reading would do
+    getc(f);
+    return 0;
+  }
+  q = scan_token(p, e, &bad);
+  tok->data = (const char *) p;
+  tok->len = q - p;
+  tok->bad_char = bad ? bad - p : -1;
+  mf->pos = q - mf->data;
+  if (q == e) getc(f);
+  return 1;
+}
+
+#else
+
+FILE *
+checker_mapped_fopen(const char *path)
+{
+  return fopen(path, "r");
+}
+
+int
+checker_mapped_next_token(FILE *f, struct checker_mapped_token *tok)
+{
+  return -1;
+}
+
+#endif
+
+/* copies the token to the static buffer, if it fits, or else to the
+   dynamic buffer like checker_read_buf_2 does */
+char *
+checker_mapped_copy_token(
+        const struct checker_mapped_token *tok,
+        char *sbuf,
+        size_t ssz,
+        char **pdbuf,
+        size_t *pdsz)
+{
+  char *dbuf;
+  size_t dsz;
+
+  if (sbuf && tok->len < ssz) {
+    memcpy(sbuf, tok->data, tok->len);
+    sbuf[tok->len] = 0;
+    return sbuf;
+  }
+
+  dbuf = *pdbuf;
+  dsz = *pdsz;
+  if (!dbuf || !dsz) {
+    dsz = 32;
+    while (tok->len >= dsz) dsz *= 2;
+    dbuf = (char *) xmalloc(dsz);
+  } else if (tok->len >= dsz) {
+    while (tok->len >= dsz) dsz *= 2;
+    dbuf = (char*) xrealloc(dbuf, dsz);
+  }
+  memcpy(dbuf, tok->data, tok->len);
+  dbuf[tok->len] = 0;
+  *pdbuf = dbuf;
+  *pdsz = dsz;
+  return dbuf;
+}
@@ -42,6 +42,34 @@ checker_read_buf_2(
   int c, i = 0;
   char *dbuf = 0;
   size_t dsz = 0;
+  struct checker_mapped_token tok;
+
+  if ((c = checker_mapped_next_token(f_arr[ind], &tok)) >= 0) {
+    if (!c) {
+      if (eof_error_flag) fatal_read(ind, _("Unexpected EOF"));
+      return 0;
+    }
+    if (sbuf && ssz > 1) {
+      if (tok.bad_char >= 0 && tok.bad_char + 1 < ssz) {
+        fatal_read(ind, _("Invalid control character %d"),
+                   (unsigned char) tok.data[tok.bad_char]);
+      }
+      if (tok.len >= ssz && (!pdbuf || !pdsz)) {
+        fatal_read(ind, _("Input element is too long"));
+      }
+    } else {
+      if (!tok.bad_char) {
+        fatal_read(ind, _("Invalid control character %d"),
+                   (unsigned char) tok.data[0]);
+      }
+      if (!pdbuf || !pdsz) fatal_CF(_("Invalid arguments"));
+    }
+    if (tok.bad_char >= 0) {
+      fatal_read(ind, _("Invalid control character %d"),
+                 (unsigned char) tok.data[tok.bad_char]);
+    }
+    return checker_mapped_copy_token(&tok, sbuf, ssz, pdbuf, pdsz);
+  }
 
   c = getc(f_arr[ind]);
   while (isspace(c)) c = getc(f_arr[ind]);
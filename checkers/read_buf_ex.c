@@ -44,6 +44,34 @@ checker_read_buf_ex(
   int c, i = 0;
   char *dbuf = 0;
   size_t dsz = 0;
+  struct checker_mapped_token tok;
+
+  if ((c = checker_mapped_next_token(f, &tok)) >= 0) {
+    if (!c) {
+      if (eof_error_flag) error_func(_("%s: unexpected EOF"), name);
+      return 0;
+    }
+    if (sbuf && ssz > 1) {
+      if (tok.bad_char >= 0 && tok.bad_char + 1 < ssz) {
+        error_func(_("%s: invalid control character %d"), name,
+                   (unsigned char) tok.data[tok.bad_char]);
+      }
+      if (tok.len >= ssz && (!pdbuf || !pdsz)) {
+        error_func(_("%s: input element is too long"), name);
+      }
+    } else {
+      if (!tok.bad_char) {
+        error_func(_("%s: invalid control character %d"), name,
+                   (unsigned char) tok.data[0]);
+      }
+      if (!pdbuf || !pdsz) error_func(_("%s: invalid arguments"), name);
+    }
+    if (tok.bad_char >= 0) {
+      error_func(_("%s: invalid control character %d"), name,
+                 (unsigned char) tok.data[tok.bad_char]);
+    }
+    return checker_mapped_copy_token(&tok, sbuf, ssz, pdbuf, pdsz);
+  }
 
   c = getc(f);
   while (isspace(c)) c = getc(f);
@@ -39,7 +39,7 @@ checker_read_double(
     fatal_read(ind, _("%s: no double value"), name);
   }
   errno = 0;
-  x = strtod(vb, &ep);
+  x = checker_strtod(vb, &ep);
   if (*ep) {
     fatal_read(ind, _("%s: cannot parse double value"), name);
   }
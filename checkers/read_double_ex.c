@@ -43,7 +43,7 @@ checker_read_double_ex(
   if (!vbuf) return -1;
   if (!*vbuf) error_func(_("%s: no double value"), name);
   errno = 0;
-  val = strtod(vbuf, &eptr);
+  val = checker_strtod(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse double value"), name);
   if (errno) error_func(_("%s: double value is out of range"), name);
   free(dbuf); dbuf = 0;
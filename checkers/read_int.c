@@ -39,7 +39,7 @@ checker_read_int(
     fatal_read(ind, _("%s: no int32 value"), name);
   }
   errno = 0;
-  x = strtol(vb, &ep, 10);
+  x = checker_strtol(vb, &ep);
   if (*ep) {
     fatal_read(ind, _("%s: cannot parse int32 value"), name);
   }
@@ -43,7 +43,7 @@ checker_read_int_ex(
   if (!vbuf) return -1;
   if (!*vbuf) error_func(_("%s: no int32 value"), name);
   errno = 0;
-  val = strtol(vbuf, &eptr, 10);
+  val = checker_strtol(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse int32 value"), name);
   if (errno) error_func(_("%s: int32 value is out of range"), name);
   free(dbuf); dbuf = 0;
@@ -39,7 +39,7 @@ checker_read_long_double(
     fatal_read(ind, _("%s: no long double value"), name);
   }
   errno = 0;
-  x = strtold(vb, &ep);
+  x = checker_strtold(vb, &ep);
   if (*ep) {
     fatal_read(ind, _("%s: cannot parse long double value"), name);
   }
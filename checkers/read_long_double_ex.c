@@ -43,7 +43,7 @@ checker_read_long_double_ex(
   if (!vbuf) return -1;
   if (!*vbuf) error_func(_("%s: no long double value"), name);
   errno = 0;
-  val = strtold(vbuf, &eptr);
+  val = checker_strtold(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse long double value"), name);
   if (errno) error_func(_("%s: long double value is out of range"), name);
   free(dbuf); dbuf = 0;
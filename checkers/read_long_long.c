@@ -39,7 +39,7 @@ checker_read_long_long(
     fatal_read(ind, _("%s: no int64 value"), name);
   }
   errno = 0;
-  x = strtoll(vb, &ep, 10);
+  x = checker_strtoll(vb, &ep);
   if (*ep) fatal_read(ind, _("%s: cannot parse int64 value"), name);
   if (errno) fatal_read(ind, _("%s: int64 value is out of range"), name);
   *p_val = x;
@@ -43,7 +43,7 @@ checker_read_long_long_ex(
   if (!vbuf) return -1;
   if (!*vbuf) error_func(_("%s: no int64 value"), name);
   errno = 0;
-  val = strtoll(vbuf, &eptr, 10);
+  val = checker_strtoll(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse int64 value"), name);
   if (errno) error_func(_("%s: int64 value is out of range"), name);
   free(dbuf); dbuf = 0;
@@ -43,7 +43,7 @@ checker_read_unsigned_int(
     fatal_read(ind, _("%s: `-' before uint32 value"), name);
   }
   errno = 0;
-  x = strtoul(vb, &ep, 10);
+  x = checker_strtoul(vb, &ep);
   if (*ep) {
     fatal_read(ind, _("%s: cannot parse uint32 value"), name);
   }
@@ -44,7 +44,7 @@ checker_read_unsigned_int_ex(
   if (!*vbuf) error_func(_("%s: no uint32 value"), name);
   if (vbuf[0] == '-') error_func(_("%s: `-' before uint32 value"), name);
   errno = 0;
-  val = strtoul(vbuf, &eptr, 10);
+  val = checker_strtoul(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse uint32 value"), name);
   if (errno) error_func(_("%s: uint32 value is out of range"), name);
   free(dbuf); dbuf = 0;
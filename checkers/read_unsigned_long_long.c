@@ -42,7 +42,7 @@ checker_read_unsigned_long_long(
     fatal_read(ind, _("%s: `-' before uint64 value"), name);
   }
   errno = 0;
-  x = strtoull(vb, &ep, 10);
+  x = checker_strtoull(vb, &ep);
   if (*ep) {
     fatal_read(ind, _("%s: cannot parse uint64 value"), name);
   }
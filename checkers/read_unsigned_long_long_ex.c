@@ -44,7 +44,7 @@ checker_read_unsigned_long_long_ex(
   if (!*vbuf) error_func(_("%s: no uint64 value"), name);
   if (vbuf[0] == '-') error_func(_("%s: `-' before uint64 value"), name);
   errno = 0;
-  val = strtoull(vbuf, &eptr, 10);
+  val = checker_strtoull(vbuf, &eptr);
   if (*eptr) error_func(_("%s: cannot parse uint64 value"), name);
   if (errno) error_func(_("%s: uint64 value is out of range"), name);
   free(dbuf); dbuf = 0;
@@ -0,0 +1,220 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "checker_internal.h"
+
+#include <float.h>
+#include <limits.h>
+#include <locale.h>
+
+/*
+ * The numbers are almost always short and well-formed, so they are
+ * converted here directly. Everything else (too many digits, garbage
+ * after the number, hex floats, inf, etc) goes to the C library,
+ * so the result, *p_end and errno are always the same as of strtol
+ * and friends with base 10.
+ */
+
+/* parses [sign]digits up to \0, the absolute value is at most
+   max_value (max_value + 1 for negative numbers) */
+static int
+parse_int(
+        const char *str,
+        int allow_minus,
+        unsigned long long max_value,
+        int *p_neg,
+        unsigned long long *p_val,
+        char **p_end)
+{
+  const unsigned char *s = (const unsigned char *) str, *b;
+  unsigned long long v = 0;
+
+  *p_neg = 0;
+  if (*s == '-') {
+    if (!allow_minus) return 0;
+    *p_neg = 1;
+    ++s;
+  } else if (*s == '+') {
+    ++s;
+  }
+  b = s;
+  // 19 decimal digits always fit into 64 bits
+  while (*s >= '0' && *s <= '9' && s - b < 19) v = v * 10 + (*s++ - '0');
+  if (s == b || *s || v - *p_neg > max_value) return 0;
+  *p_val = v;
+  if (p_end) *p_end = (char*) s;
+  return 1;
+}
+
+long
+checker_strtol(const char *str, char **p_end)
+{
+  int neg;
+  unsigned long long v;
+
+  if (!parse_int(str, 1, LONG_MAX, &neg, &v, p_end))
+    return strtol(str, p_end, 10);
+  return neg ? (long) -v : (long) v;
+}
+
+unsigned long
+checker_strtoul(const char *str, char **p_end)
+{
+  int neg;
+  unsigned long long v;
+
+  if (!parse_int(str, 0, ULONG_MAX, &neg, &v, p_end))
+    return strtoul(str, p_end, 10);
+  return v;
+}
+
+long long
+checker_strtoll(const char *str, char **p_end)
+{
+  int neg;
+  unsigned long long v;
+
+  if (!parse_int(str, 1, LLONG_MAX, &neg, &v, p_end))
+    return strtoll(str, p_end, 10);
+  return neg ? (long long) -v : (long long) v;
+}
+
+unsigned long long
+checker_strtoull(const char *str, char **p_end)
+{
+  int neg;
+  unsigned long long v;
+
+  if (!parse_int(str, 0, ULLONG_MAX, &neg, &v, p_end))
+    return strtoull(str, p_end, 10);
+  return v;
+}
+
+/*
+ * parses [sign]digits[.digits][(e|E)[sign]digits] up to \0,
+ * the mantissa is at most 19 significant digits
+ */
+static int
+parse_float(
+        const char *str,
+        int *p_neg,
+        unsigned long long *p_mant,
+        int *p_exp,
+        char **p_end)
+{
+  const unsigned char *s = (const unsigned char *) str;
+  unsigned long long m = 0;
+  int digits = 0, sig = 0, frac = 0, exp = 0, eneg = 0, edigits = 0;
+  const struct lconv *lc;
+
+  *p_neg = 0;
+  if (*s == '-') {
+    *p_neg = 1;
+    ++s;
+  } else if (*s == '+') {
+    ++s;
+  }
+  for (; *s >= '0' && *s <= '9'; ++s, ++digits) {
+    if (!sig && *s == '0') continue;
+    if (++sig > 19) return 0;
+    m = m * 10 + (*s - '0');
+  }
+  if (*s == '.') {
+    lc = localeconv();
+    if (lc->decimal_point[0] != '.' || lc->decimal_point[1]) return 0;
+    for (++s; *s >= '0' && *s <= '9'; ++s, ++digits, ++frac) {
+      if (!sig && *s == '0') continue;
+      if (++sig > 19) return 0;
+      m = m * 10 + (*s - '0');
+    }
+  }
+  if (!digits) return 0;
+  if (*s == 'e' || *s == 'E') {
+    ++s;
+    if (*s == '-') {
+      eneg = 1;
+      ++s;
+    } else if (*s == '+') {
+      ++s;
+    }
+    for (; *s >= '0' && *s <= '9'; ++s) {
+      if (++edigits > 4) return 0;
+      exp = exp * 10 + (*s - '0');
+    }
+    if (!edigits) return 0;
+    if (eneg) exp = -exp;
+  }
+  if (*s) return 0;
+  *p_mant = m;
+  *p_exp = exp - frac;
+  if (p_end) *p_end = (char*) s;
+  return 1;
+}
+
+double
+checker_strtod(const char *str, char **p_end)
+{
+#if defined FLT_EVAL_METHOD && FLT_EVAL_METHOD == 0
+  static const double pow10[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  int neg, exp;
+  unsigned long long m;
+  double v;
+
+  /*
+   * both the mantissa and the power of 10 are exact doubles,
+   * so a single multiplication or division gives the correctly
+   * rounded result
+   */
+  if (parse_float(str, &neg, &m, &exp, p_end)
+      && m <= (1ULL << 53) && exp >= -22 && exp <= 22) {
+    v = (double) m;
+    if (exp >= 0) v *= pow10[exp];
+    else v /= pow10[-exp];
+    return neg ? -v : v;
+  }
+#endif
+  return strtod(str, p_end);
+}
+
+long double
+checker_strtold(const char *str, char **p_end)
+{
+#if defined LDBL_MANT_DIG && LDBL_MANT_DIG == 64
+  static const long double pow10[] =
+  {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L,
+    1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L,
+    1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+  };
+  int neg, exp;
+  unsigned long long m;
+  long double v;
+
+  // 19 digits and 5^27 fit into the 64 bit mantissa
+  if (parse_float(str, &neg, &m, &exp, p_end) && exp >= -27 && exp <= 27) {
+    v = (long double) m;
+    if (exp >= 0) v *= pow10[exp];
+    else v /= pow10[-exp];
+    return neg ? -v : v;
+  }
+#endif
+  return strtold(str, p_end);
+}
@@ -23,6 +23,7 @@
 #include "ejudge_cfg.h"
 #include "contests.h"
 #include "runlog.h"
+#include "runlog_reader.h"
 #include "xml_utils.h"
 #include "compat.h"
 
@@ -34,6 +35,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 static const unsigned char *program_name = "";
 static const unsigned char *ejudge_xml_path = 0;
@@ -135,9 +137,11 @@ main(int argc, char *argv[])
 {
   int i = 1;
   char *eptr = 0;
-  int total_runs, run_id;
+  int total_runs, run_id, r;
   struct run_entry re;
   struct run_header rh;
+  struct runlog_reader rr;
+  unsigned char src_path[PATH_MAX];
 
   program_name = os_GetBasename(argv[0]);
 
@@ -200,15 +204,37 @@ main(int argc, char *argv[])
   if (contests_get(contest_id, &cnts) < 0 || !cnts)
     die("cannot load contest %d", contest_id);
 
-  if (!(src_runlog = run_init(0)))
-    die("cannot open the source runlog");
   if (!(dst_runlog = run_init(0)))
     die("cannot open the destination runlog");
+  if (run_open(dst_runlog, config, cnts, 0, dst_plugin_name, 0, 0, 0, 0) < 0)
+    die("cannot open the destination runlog");
 
+  // the binary runlog file is read in place, the older formats
+  // are loaded by the plugin
+  memset(&rr, 0, sizeof(rr));
+  rr.fd = -1;
+  if (!strcmp(src_plugin_name, "file") && cnts->root_dir) {
+    snprintf(src_path, sizeof(src_path), "%s/var/run.log", cnts->root_dir);
+    if ((r = runlog_reader_open(&rr, src_path)) < 0 && r != -EINVAL)
+      die("cannot open %s: %s", src_path, strerror(-r));
+  }
+
+  if (rr.data) {
+    if (run_put_header(dst_runlog, rr.header) < 0)
+      die("failed to insert the header");
+    for (run_id = 0; run_id < rr.run_count; run_id++) {
+      if (rr.runs[run_id].status == RUN_EMPTY) continue;
+      if (run_put_entry(dst_runlog, &rr.runs[run_id]) > 0)
+        die("failed to insert entry %d", run_id);
+    }
+    runlog_reader_close(&rr);
+    return 0;
+  }
+
+  if (!(src_runlog = run_init(0)))
+    die("cannot open the source runlog");
   if (run_open(src_runlog, config, cnts, 0, src_plugin_name, RUN_LOG_NOINDEX, 0, 0, 0) < 0)
     die("cannot open the source runlog");
-  if (run_open(dst_runlog, config, cnts, 0, dst_plugin_name, 0, 0, 0, 0) < 0)
-    die("cannot open the destination runlog");
 
   run_get_header(src_runlog, &rh);
   if (run_put_header(dst_runlog, &rh) < 0)
@@ -0,0 +1,74 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __CPU_SLOTS_H__
+#define __CPU_SLOTS_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The per-host table of CPU slots. Each slot is a set of CPUs,
+ * a process testing a submission holds exactly one slot and
+ * is bound to its CPUs. Slots are locked with fcntl locks on
+ * files in the slot directory, so the locks are released
+ * automatically when the process terminates.
+ */
+
+struct cpu_slot
+{
+  int cpu_count;
+  int *cpus;
+};
+
+struct cpu_slot_table
+{
+  unsigned char *dir;
+  unsigned char *host;
+  int slot_count;
+  struct cpu_slot *slots;
+  struct cpu_slot all;  // the CPUs available when the table was created
+
+  int cur_slot;     // the slot held by this process, or -1
+  int cur_fd;       // the lock file descriptor of cur_slot
+  int last_slot;    // the slot held last time, tried first
+};
+
+/*
+ * creates the slot table, either from the explicit specification
+ * "CPUS;CPUS;...", where CPUS is a list of CPU numbers and ranges
+ * like "0-3,8-11", or by splitting the CPUs available to this process
+ * into slots of 'cpus_per_slot' CPUs each.
+ */
+struct cpu_slot_table *
+cpu_slot_table_create(
+        const unsigned char *dir,
+        const unsigned char *host,
+        const unsigned char *spec,
+        int cpus_per_slot);
+struct cpu_slot_table *
+cpu_slot_table_free(struct cpu_slot_table *tab);
+
+/* tries to lock a free slot and binds the process to its CPUs,
+   returns the slot number, or -1, if all slots are busy */
+int cpu_slot_acquire(struct cpu_slot_table *tab);
+void cpu_slot_release(struct cpu_slot_table *tab);
+
+const unsigned char *
+cpu_slot_unparse(
+        unsigned char *buf,
+        int size,
+        const struct cpu_slot_table *tab,
+        int slot);
+
+#endif /* __CPU_SLOTS_H__ */
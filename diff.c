@@ -15,6 +15,8 @@
  * GNU General Public License for more details.
  */
 
+#include "config.h"
+
 #include "diff.h"
 
 #include "runlog.h"
@@ -26,29 +28,263 @@
 #include "misctext.h"
 #include "mime_type.h"
 #include "prepare_dflt.h"
+#include "similarity_index.h"
+#include "text_diff.h"
+#include "run_pack.h"
+#include "sha.h"
+#include "compat.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_exec.h"
 
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 
+/* the same as the `-uBb' options of the external diff */
+#define DIFF_FLAGS (TEXT_DIFF_IGNORE_SPACE | TEXT_DIFF_IGNORE_BLANK_LINES)
+
+/* the output of the external diff is truncated to this size */
+#define MAX_EXTERNAL_DIFF_SIZE (1024 * 1024)
+
+static const char diff_style[] =
+  ".diff { font-family: monospace; border-collapse: collapse; }\n"
+  ".diff td { white-space: pre; padding: 0 4px; vertical-align: top; }\n"
+  ".diff_hunk { color: #808080; background-color: #f0f0f0; }\n"
+  ".diff_num { color: #808080; text-align: right; }\n"
+  ".diff_del { background-color: #ffe0e0; }\n"
+  ".diff_ins { background-color: #e0ffe0; }\n"
+  ".diff_chg { background-color: #ffffd0; }\n"
+  ".diff_empty { background-color: #f8f8f8; }\n";
+
+static void
+write_diff_page(
+        FILE *fout,
+        int mode,
+        const unsigned char *title1,
+        const unsigned char *title2,
+        const unsigned char *diff_txt,
+        size_t diff_len)
+{
+  if (mode == TEXT_DIFF_UNIFIED) {
+    fprintf(fout, "Content-type: text/plain\n\n");
+    if (diff_len > 0) {
+      fprintf(fout, "--- %s\n+++ %s\n", title1, title2);
+      fwrite(diff_txt, 1, diff_len, fout);
+    }
+    return;
+  }
+
+  fprintf(fout, "Content-type: text/html; charset=%s\n\n", EJUDGE_CHARSET);
+  fprintf(fout,
+          "<html><head>\n"
+          "<meta http-equiv=\"Content-Type\" content=\"text/html; charset=%s\"/>\n"
+          "<title>%s / %s</title>\n"
+          "<style type=\"text/css\">\n%s</style>\n"
+          "</head><body>\n"
+          "<h2>--- %s<br/>+++ %s</h2>\n",
+          EJUDGE_CHARSET, title1, title2, diff_style, title1, title2);
+  if (diff_len > 0) {
+    fwrite(diff_txt, 1, diff_len, fout);
+  } else {
+    fprintf(fout, "<p>The texts are identical.</p>\n");
+  }
+  fprintf(fout, "</body></html>\n");
+}
+
+static const unsigned char *
+get_cached_diff(
+        serve_state_t state,
+        const void *sha1_1,
+        const void *sha1_2,
+        int mode,
+        size_t *p_size)
+{
+  if (!state->diff_cache)
+    state->diff_cache = text_diff_cache_create(0, 0);
+  return text_diff_cache_get(state->diff_cache, sha1_1, sha1_2, mode,
+                             DIFF_FLAGS, p_size);
+}
+
+/*
+ * The texts too large for the in-process diff are compared by the
+ * external diff program (the diff_path global option) in diff_work_dir,
+ * its output is truncated to MAX_EXTERNAL_DIFF_SIZE. Returns -1, if
+ * the external diff is not available.
+ */
+static int
+run_external_diff(
+        serve_state_t state,
+        FILE *out_f,
+        int mode,
+        const unsigned char *text1,
+        size_t size1,
+        const unsigned char *text2,
+        size_t size2)
+{
+  const struct section_global_data *global = state->global;
+  path_t path1, path2, path3;
+  tpTask tsk = 0;
+  char *diff_txt = 0, *p, *q;
+  size_t diff_len = 0;
+  int retval = -1, truncated = 0, i;
+  struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
+
+  if (!global->diff_path[0] || !global->diff_work_dir[0]) return -1;
+
+  snprintf(path1, sizeof(path1), "%s/d1-%d", global->diff_work_dir, getpid());
+  snprintf(path2, sizeof(path2), "%s/d2-%d", global->diff_work_dir, getpid());
+  snprintf(path3, sizeof(path3), "%s/diff-%d", global->diff_work_dir, getpid());
+  if (generic_write_file(text1, size1, 0, 0, path1, "") < 0) goto cleanup;
+  if (generic_write_file(text2, size2, 0, 0, path2, "") < 0) goto cleanup;
+
+  if (!(tsk = task_New())) goto cleanup;
+  task_AddArg(tsk, global->diff_path);
+  task_AddArg(tsk, "-uBb");
+  task_AddArg(tsk, path1);
+  task_AddArg(tsk, path2);
+  task_SetPathAsArg0(tsk);
+  task_ClearEnv(tsk);
+  task_SetMaxTime(tsk, 10);
+  task_SetMaxFileSize(tsk, MAX_EXTERNAL_DIFF_SIZE + 1);
+  task_SetRedir(tsk, 1, TSR_FILE, path3, O_WRONLY|O_CREAT|O_TRUNC, 0777);
+  if (task_Start(tsk) < 0) goto cleanup;
+  task_Wait(tsk);
+  if (generic_read_file(&diff_txt, 0, &diff_len, 0, 0, path3, 0) < 0)
+    goto cleanup;
+
+  // the file headers are written by the caller
+  p = diff_txt;
+  if (diff_len >= 4 && !strncmp(p, "--- ", 4)) {
+    for (i = 0; i < 2 && (q = memchr(p, '\n', diff_txt + diff_len - p)); ++i)
+      p = q + 1;
+  }
+  diff_len -= p - diff_txt;
+  if (diff_len > MAX_EXTERNAL_DIFF_SIZE) {
+    diff_len = MAX_EXTERNAL_DIFF_SIZE;
+    truncated = 1;
+  }
+
+  if (mode == TEXT_DIFF_UNIFIED) {
+    fwrite(p, 1, diff_len, out_f);
+    if (truncated) fprintf(out_f, "\n[the output is truncated]\n");
+  } else if (diff_len > 0) {
+    fprintf(out_f, "<pre class=\"diff\">%s</pre>\n",
+            html_armor_buf_bin(&ab, p, diff_len));
+    if (truncated) fprintf(out_f, "<p>The output is truncated.</p>\n");
+  }
+  retval = 0;
+
+ cleanup:
+  if (tsk) task_Delete(tsk);
+  unlink(path1);
+  unlink(path2);
+  unlink(path3);
+  xfree(diff_txt);
+  html_armor_free(&ab);
+  return retval;
+}
+
+int
+serve_write_text_diff(
+        serve_state_t state,
+        FILE *fout,
+        int mode,
+        const unsigned char *title1,
+        const unsigned char *title2,
+        const void *sha1_1,
+        const unsigned char *text1,
+        size_t size1,
+        const void *sha1_2,
+        const unsigned char *text2,
+        size_t size2)
+{
+  const unsigned char *diff_txt;
+  char *out_txt = 0;
+  size_t diff_len = 0, out_len = 0;
+  FILE *out_f;
+  int r;
+
+  if (mode < 0 || mode >= TEXT_DIFF_MODE_LAST) return -1;
+
+  if ((diff_txt = get_cached_diff(state, sha1_1, sha1_2, mode, &diff_len))) {
+    write_diff_page(fout, mode, title1, title2, diff_txt, diff_len);
+    return 0;
+  }
+
+  out_f = open_memstream(&out_txt, &out_len);
+  r = text_diff(out_f, text1, size1, text2, size2, mode, DIFF_FLAGS,
+                TEXT_DIFF_DEFAULT_CONTEXT);
+  if (r == TEXT_DIFF_TOO_LARGE
+      && run_external_diff(state, out_f, mode, text1, size1,
+                           text2, size2) < 0) {
+    if (mode == TEXT_DIFF_UNIFIED) {
+      fprintf(out_f, "[the texts are too large to compare]\n");
+    } else {
+      fprintf(out_f, "<p>The texts are too large to compare.</p>\n");
+    }
+  } else if (r < 0 && r != TEXT_DIFF_TOO_LARGE) {
+    close_memstream(out_f);
+    xfree(out_txt);
+    return -1;
+  }
+  close_memstream(out_f); out_f = 0;
+
+  write_diff_page(fout, mode, title1, title2, out_txt, out_len);
+  text_diff_cache_put(state->diff_cache, sha1_1, sha1_2, mode, DIFF_FLAGS,
+                      out_txt, out_len);
+  return 0;
+}
+
+static int
+is_sha1_set(const ruint32_t *sha1)
+{
+  return sha1[0] || sha1[1] || sha1[2] || sha1[3] || sha1[4];
+}
+
+/* reads the source, the text is converted to the unix line endings */
+static int
+read_run_source(
+        const serve_state_t state,
+        const struct run_entry *re,
+        char **p_txt,
+        size_t *p_len,
+        ruint32_t sha1[5])
+{
+  if (serve_read_run_artifact(state, re, RUN_PACK_SOURCE, p_txt, p_len) < 0)
+    return -1;
+  if (is_sha1_set(re->sha1)) {
+    memcpy(sha1, re->sha1, sizeof(re->sha1));
+  } else {
+    sha_buffer(*p_txt, *p_len, sha1);
+  }
+  *p_len = dos2unix_buf(*p_txt, *p_len);
+  return 0;
+}
+
 int
-compare_runs(const serve_state_t state, FILE *fout, int run_id1, int run_id2)
+compare_runs(
+        const serve_state_t state,
+        FILE *fout,
+        int run_id1,
+        int run_id2,
+        int mode)
 {
   struct run_entry info1, info2;
   int errcode = -SRV_ERR_SYSTEM_ERROR;
-  unsigned char *tmpfile1 = 0, *tmpfile2 = 0, *tmpfile3 = 0;
-  unsigned char par1[64], par2[64];
-  int flags1, flags2;
-  path_t arch_path1, arch_path2;
-  tpTask tsk = 0;
-  char *diff_txt = 0;
+  char *file_txt1 = 0, *file_txt2 = 0;
+  size_t file_len1 = 0, file_len2 = 0;
+  const unsigned char *diff_txt;
   size_t diff_len = 0;
-  char *file_txt = 0;
-  size_t file_len = 0;
+  ruint32_t sha1_1[5], sha1_2[5];
+  unsigned char title1[64], title2[64];
   const struct section_problem_data *prob1 = NULL, *prob2 = NULL;
 
+  if (mode < 0 || mode >= TEXT_DIFF_MODE_LAST) {
+    errcode = -SRV_ERR_BAD_RUN_ID;
+    goto cleanup;
+  }
+
   // refuse to do stupid things
   if (run_id1 == run_id2) {
     errcode = -SRV_ERR_BAD_RUN_ID;
@@ -116,75 +352,154 @@ compare_runs(const serve_state_t state, FILE *fout, int run_id1, int run_id2)
     goto cleanup;
   }
 
-  // compose temporary paths for the files
-  snprintf(par1, sizeof(par1), "d1-%06d", run_id1);
-  tmpfile1 = alloca(strlen(state->global->diff_work_dir) + 65);
-  sprintf(tmpfile1, "%s/%s", state->global->diff_work_dir, par1);
-  snprintf(par2, sizeof(par2), "d2-%06d", run_id2);
-  tmpfile2 = alloca(strlen(state->global->diff_work_dir) + 65);
-  sprintf(tmpfile2, "%s/%s", state->global->diff_work_dir, par2);
-  tmpfile3 = alloca(strlen(state->global->diff_work_dir) + 65);
-  sprintf(tmpfile3, "%s/diff", state->global->diff_work_dir);
+  snprintf(title1, sizeof(title1), "run %d", run_id1);
+  snprintf(title2, sizeof(title2), "run %d", run_id2);
 
-  // copy files to temporary location
-  if ((flags1 = serve_make_source_read_path(state, arch_path1, sizeof(arch_path1), &info1)) < 0) {
-    goto cleanup;
+  // the sources are not read at all, if the result is cached
+  if (is_sha1_set(info1.sha1) && is_sha1_set(info2.sha1)
+      && (diff_txt = get_cached_diff(state, info1.sha1, info2.sha1, mode,
+                                     &diff_len))) {
+    write_diff_page(fout, mode, title1, title2, diff_txt, diff_len);
+    return 0;
   }
 
-  if (generic_read_file(&file_txt, 0, &file_len, flags1, 0, arch_path1, "") < 0)
+  if (read_run_source(state, &info1, &file_txt1, &file_len1, sha1_1) < 0)
     goto cleanup;
-  file_len = dos2unix_buf(file_txt, file_len);
-  if (generic_write_file(file_txt, file_len, 0, 0, tmpfile1, "") < 0)
+  if (read_run_source(state, &info2, &file_txt2, &file_len2, sha1_2) < 0)
     goto cleanup;
-  xfree(file_txt); file_txt = 0; file_len = 0;
 
-  if ((flags2 = serve_make_source_read_path(state, arch_path2, sizeof(arch_path2), &info2)) < 0) {
+  if (serve_write_text_diff(state, fout, mode, title1, title2,
+                            sha1_1, file_txt1, file_len1,
+                            sha1_2, file_txt2, file_len2) < 0)
     goto cleanup;
+
+  xfree(file_txt1);
+  xfree(file_txt2);
+  return 0;
+
+ cleanup:
+  xfree(file_txt1);
+  xfree(file_txt2);
+  return errcode;
+}
+
+/* returns 1, if the run is indexed, 0, if it is never indexed,
+   -1, if its source may appear later (an empty run) */
+static int
+is_similarity_indexable(const serve_state_t state, const struct run_entry *re)
+{
+  const struct section_problem_data *prob;
+  const struct section_language_data *lang;
+
+  if (re->status == RUN_EMPTY) return -1;
+  if (!run_is_source_available(re->status)) return 0;
+  if (re->prob_id <= 0 || re->prob_id > state->max_prob
+      || !(prob = state->probs[re->prob_id]))
+    return 0;
+  if (prob->type == 0) {
+    if (re->lang_id <= 0 || re->lang_id > state->max_lang
+        || !(lang = state->langs[re->lang_id]) || lang->binary)
+      return 0;
+  } else if (re->mime_type != MIME_TYPE_TEXT) {
+    return 0;
   }
-  if (generic_read_file(&file_txt, 0, &file_len, flags2, 0, arch_path2, "") < 0)
-    goto cleanup;
-  file_len = dos2unix_buf(file_txt, file_len);
-  if (generic_write_file(file_txt, file_len, 0, 0, tmpfile2, "") < 0)
-    goto cleanup;
-  xfree(file_txt); file_txt = 0; file_len = 0;
+  return 1;
+}
 
-  fprintf(fout, "Content-type: text/plain\n\n");
-  fflush(fout);
+static void
+add_pending_run(struct similarity_index *idx, int run_id)
+{
+  if (idx->pending_u == idx->pending_a) {
+    if (!(idx->pending_a *= 2)) idx->pending_a = 16;
+    XREALLOC(idx->pending, idx->pending_a);
+  }
+  idx->pending[idx->pending_u++] = run_id;
+}
 
-  if (!(tsk = task_New())) goto cleanup;
-  task_AddArg(tsk, state->global->diff_path);
-  task_AddArg(tsk, "-uBb");
-  task_AddArg(tsk, par1);
-  task_AddArg(tsk, par2);
-  task_SetPathAsArg0(tsk);
-  task_ClearEnv(tsk);
-  task_SetWorkingDir(tsk, state->global->diff_work_dir);
-  task_SetRedir(tsk, 1, TSR_FILE, tmpfile3, O_WRONLY|O_CREAT|O_TRUNC, 0777);
-  if (task_Start(tsk) < 0) goto cleanup;
-  task_Wait(tsk);
-  task_Delete(tsk);
-  tsk = 0;
+/* returns 1, if the run is added, 0, if it is never indexed,
+   -1, if it should be looked at again */
+static int
+index_run(serve_state_t state, struct similarity_index *idx, int run_id)
+{
+  struct run_entry re;
+  char *src_txt = 0;
+  size_t src_len = 0;
+  int r;
 
-  if (generic_read_file(&diff_txt, 0, &diff_len, 0, 0, tmpfile3, 0) < 0) {
-    goto cleanup;
+  if (similarity_index_contains(idx, run_id)) return 1;
+  if (run_get_entry(state->runlog_state, run_id, &re) < 0) return 0;
+  if ((r = is_similarity_indexable(state, &re)) <= 0) return r;
+  if (serve_read_run_artifact(state, &re, RUN_PACK_SOURCE,
+                              &src_txt, &src_len) < 0)
+    return -1;
+  similarity_index_add(idx, run_id, re.prob_id, re.user_id, src_txt, src_len);
+  xfree(src_txt);
+  return 1;
+}
+
+int
+serve_update_similarity_index(serve_state_t state)
+{
+  struct similarity_index *idx;
+  int total_runs, run_id, i, j, count = 0;
+
+  if (!state->similarity_index)
+    state->similarity_index = similarity_index_create(0, 0);
+  idx = state->similarity_index;
+
+  // the runs skipped before
+  for (i = 0, j = 0; i < idx->pending_u; ++i) {
+    if (index_run(state, idx, idx->pending[i]) < 0) {
+      idx->pending[j++] = idx->pending[i];
+    } else {
+      ++count;
+    }
   }
+  idx->pending_u = j;
 
-  if (fwrite(diff_txt, 1, diff_len, fout) != diff_len) {
-    goto cleanup;
+  total_runs = run_get_total(state->runlog_state);
+  for (run_id = idx->next_run_id; run_id < total_runs; ++run_id) {
+    if ((i = index_run(state, idx, run_id)) < 0) {
+      add_pending_run(idx, run_id);
+    } else if (i > 0) {
+      ++count;
+    }
   }
+  idx->next_run_id = total_runs;
+  return count;
+}
 
-  xfree(diff_txt);
-  unlink(tmpfile1);
-  unlink(tmpfile2);
-  unlink(tmpfile3);
-  return 0;
+void
+serve_similarity_index_add_run(
+        serve_state_t state,
+        int run_id,
+        const unsigned char *text,
+        size_t size)
+{
+  struct similarity_index *idx = state->similarity_index;
+  struct run_entry re;
 
- cleanup:
-  if (tsk) task_Delete(tsk);
-  if (tmpfile1) unlink(tmpfile1);
-  if (tmpfile2) unlink(tmpfile2);
-  if (tmpfile3) unlink(tmpfile3);
-  if (diff_txt) xfree(diff_txt);
-  xfree(file_txt);
-  return errcode;
+  if (!idx || similarity_index_contains(idx, run_id)) return;
+  if (run_get_entry(state->runlog_state, run_id, &re) < 0) return;
+  if (is_similarity_indexable(state, &re) <= 0) return;
+  similarity_index_add(idx, run_id, re.prob_id, re.user_id, text, size);
+}
+
+void
+serve_invalidate_similarity_index(serve_state_t state, int run_id)
+{
+  struct similarity_index *idx = state->similarity_index;
+  int i;
+
+  if (!idx) return;
+  if (run_id < 0) {
+    state->similarity_index = similarity_index_free(idx);
+    return;
+  }
+  similarity_index_remove(idx, run_id);
+  if (run_id >= idx->next_run_id) return;
+  for (i = 0; i < idx->pending_u; ++i)
+    if (idx->pending[i] == run_id)
+      return;
+  add_pending_run(idx, run_id);
 }
@@ -22,6 +22,40 @@
 
 #include <stdio.h>
 
-int compare_runs(const serve_state_t, FILE *fout, int run_id1, int run_id2);
+/* mode is one of TEXT_DIFF_* output modes */
+int compare_runs(const serve_state_t, FILE *fout, int run_id1, int run_id2,
+                 int mode);
+
+/* writes the page with the difference of the two texts, the result
+   is cached in the contest state by the SHA1 digests of the texts */
+int
+serve_write_text_diff(
+        serve_state_t state,
+        FILE *fout,
+        int mode,
+        const unsigned char *title1,
+        const unsigned char *title2,
+        const void *sha1_1,
+        const unsigned char *text1,
+        size_t size1,
+        const void *sha1_2,
+        const unsigned char *text2,
+        size_t size2);
+
+/* adds the runs submitted since the last call to the similarity index,
+   and the runs skipped or invalidated before */
+int serve_update_similarity_index(serve_state_t state);
+
+/* adds the just submitted run, if the similarity index is built */
+void
+serve_similarity_index_add_run(
+        serve_state_t state,
+        int run_id,
+        const unsigned char *text,
+        size_t size);
+
+/* the run is changed or removed (run_id < 0 drops the whole index,
+   when the runs are renumbered or the run log is reset) */
+void serve_invalidate_similarity_index(serve_state_t state, int run_id);
 
 #endif /* __DIFF_H__ */
@@ -0,0 +1,1262 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The load generator for ej-contests. The `gen' command creates a self
+ * contained installation in a directory: ejudge.xml with the sockets
+ * and the logs inside the directory, the user database of the xml
+ * plugin, the contest XML, serve.cfg and the runlog, the clarlog and
+ * the team_extra store filled with the synthetic data. The `run'
+ * command starts ej-users and ej-contests on this installation, replays
+ * the mix of the requests through the new-server protocol at the given
+ * rate and reports the latency percentiles for each kind of request.
+ *
+ * The load is closed-loop: each client process sends its requests one
+ * at a time over one connection on a fixed schedule, so a slow server
+ * delays the following requests instead of receiving them concurrently.
+ * The latency is measured from the scheduled time of the request, not
+ * from the time it was actually sent, so the waiting for the previous
+ * requests is counted and does not hide the slow responses.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+#include "ej_limits.h"
+#include "version.h"
+
+#include "ejudge_cfg.h"
+#include "contests.h"
+#include "prepare.h"
+#include "runlog.h"
+#include "clarlog.h"
+#include "team_extra.h"
+#include "serve_state.h"
+#include "new-server.h"
+#include "new_server_clnt.h"
+#include "new_server_proto.h"
+#include "xml_utils.h"
+#include "compat.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pwd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+
+#define BENCH_ADMIN_LOGIN "bench_admin"
+#define BENCH_PASSWORD    "bench"
+
+static const unsigned char *program_name = "";
+
+static void
+die(const char *format, ...)
+  __attribute__((format(printf, 1, 2), noreturn));
+static void
+die(const char *format, ...)
+{
+  va_list args;
+  char buf[1024];
+
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  fprintf(stderr, "%s: fatal: %s\n", program_name, buf);
+  exit(1);
+}
+
+static void write_help(void) __attribute__((noreturn));
+static void
+write_help(void)
+{
+  printf("%s: Ejudge contest server load generator\n"
+         "Usage: %s gen [OPTIONS] DIR\n"
+         "       %s run [OPTIONS] DIR\n"
+         "  gen creates the synthetic contest in DIR, OPTIONS:\n"
+         "    -i ID     the contest id (1)\n"
+         "    -u USERS  the number of the participants (100)\n"
+         "    -p PROBS  the number of the problems (10)\n"
+         "    -r RUNS   the number of the runs (10000)\n"
+         "    -c CLARS  the number of the clarifications (100)\n"
+         "    -S SEED   the random seed (1)\n"
+         "  run replays the requests against the contest in DIR, OPTIONS:\n"
+         "    -R RATE   the target request rate per second (50)\n"
+         "    -t SECS   the duration of the measurement (30)\n"
+         "    -j PROCS  the number of the client processes (8)\n"
+         "    -s SESS   the participant sessions per process (16)\n"
+         "    -m MIX    the request weights, NAME=WEIGHT,...\n"
+         "              (login=1,main=10,submit=2,standings=3,runs=3)\n"
+         "    -B DIR    the directory of ej-users and ej-contests\n"
+         "    -x        use the servers already running on DIR\n"
+         "    -S SEED   the random seed (1)\n",
+         program_name, program_name, program_name);
+  exit(0);
+}
+static void write_version(void) __attribute__((noreturn));
+static void
+write_version(void)
+{
+  printf("%s %s, compiled %s\n", program_name, compile_version, compile_date);
+  exit(0);
+}
+
+static int
+parse_int_arg(const char *opt, const char *str, int min_val, int max_val)
+{
+  char *eptr = 0;
+  long val;
+
+  if (!str) die("argument expected for `%s'", opt);
+  errno = 0;
+  val = strtol(str, &eptr, 10);
+  if (!*str || *eptr || errno || val < min_val || val > max_val)
+    die("invalid argument for `%s'", opt);
+  return val;
+}
+
+static long long
+get_usec(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/* the state of the random number generator, the data are reproducible
+   for the same seed */
+static unsigned rand_seed = 1;
+
+static int
+rand_int(int max_val)
+{
+  return rand_r(&rand_seed) % max_val;
+}
+
+static void
+make_dir_or_die(const unsigned char *path)
+{
+  if (mkdir(path, 0755) < 0 && errno != EEXIST)
+    die("cannot create directory %s: %s", path, os_ErrorMsg());
+}
+
+static FILE *
+open_file_or_die(const unsigned char *path)
+{
+  FILE *f;
+
+  if (!(f = fopen(path, "w"))) die("cannot open %s: %s", path, os_ErrorMsg());
+  return f;
+}
+
+static void
+close_file_or_die(FILE *f, const unsigned char *path)
+{
+  if (ferror(f) || fclose(f) < 0) die("write error on %s", path);
+}
+
+static void
+get_problem_name(unsigned char *buf, size_t size, int prob_id)
+{
+  if (prob_id <= 26) snprintf(buf, size, "%c", 'A' + prob_id - 1);
+  else snprintf(buf, size, "P%d", prob_id);
+}
+
+/* the parameters of the generated contest, saved to DIR/bench.cfg */
+struct bench_config
+{
+  int contest_id;
+  int user_count;
+  int prob_count;
+  int run_count;
+  int clar_count;
+};
+
+static void
+write_bench_config(const unsigned char *dir, const struct bench_config *bc)
+{
+  path_t path;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/bench.cfg", dir);
+  f = open_file_or_die(path);
+  fprintf(f, "contest_id = %d\nusers = %d\nproblems = %d\nruns = %d\n"
+          "clars = %d\n", bc->contest_id, bc->user_count, bc->prob_count,
+          bc->run_count, bc->clar_count);
+  close_file_or_die(f, path);
+}
+
+static void
+read_bench_config(const unsigned char *dir, struct bench_config *bc)
+{
+  path_t path;
+  FILE *f;
+  char name[64];
+  int val;
+
+  memset(bc, 0, sizeof(*bc));
+  snprintf(path, sizeof(path), "%s/bench.cfg", dir);
+  if (!(f = fopen(path, "r")))
+    die("cannot open %s, run `%s gen' first", path, program_name);
+  while (fscanf(f, "%63s = %d", name, &val) == 2) {
+    if (!strcmp(name, "contest_id")) bc->contest_id = val;
+    else if (!strcmp(name, "users")) bc->user_count = val;
+    else if (!strcmp(name, "problems")) bc->prob_count = val;
+    else if (!strcmp(name, "runs")) bc->run_count = val;
+    else if (!strcmp(name, "clars")) bc->clar_count = val;
+  }
+  fclose(f);
+  if (bc->contest_id <= 0 || bc->user_count <= 0 || bc->prob_count <= 0)
+    die("%s is invalid", path);
+}
+
+static void
+write_ejudge_xml(const unsigned char *dir)
+{
+  path_t path;
+  FILE *f;
+  struct passwd *pw;
+
+  if (!(pw = getpwuid(getuid()))) die("cannot get the system user name");
+
+  snprintf(path, sizeof(path), "%s/ejudge.xml", dir);
+  f = open_file_or_die(path);
+  fprintf(f, "<?xml version=\"1.0\" encoding=\"%s\" ?>\n", EJUDGE_CHARSET);
+  fprintf(f, "<!-- Generated by ej-bench, version %s -->\n", compile_version);
+  fprintf(f,
+          "<config>\n"
+          "  <socket_path>%s/userlist-socket</socket_path>\n"
+          "  <super_serve_socket>%s/super-serve-socket</super_serve_socket>\n"
+          "  <new_server_socket>%s/new-server-socket</new_server_socket>\n"
+          "  <contests_dir>%s/contests</contests_dir>\n"
+          "  <contests_home_dir>%s</contests_home_dir>\n"
+          "  <userdb_file>%s/users.xml</userdb_file>\n"
+          "  <var_dir>%s/var</var_dir>\n"
+          "  <userlist_log>ej-users.log</userlist_log>\n"
+          "  <new_server_log>ej-contests.log</new_server_log>\n"
+          "  <email_program>/bin/true</email_program>\n"
+          "  <register_url>http://localhost/cgi-bin/register</register_url>\n"
+          "  <register_email>ejudge@localhost</register_email>\n"
+          "  <charset>%s</charset>\n",
+          dir, dir, dir, dir, dir, dir, dir, EJUDGE_CHARSET);
+  fprintf(f,
+          "  <user_map>\n"
+          "    <map system_user=\"%s\" ejudge_user=\"%s\"/>\n"
+          "  </user_map>\n", pw->pw_name, BENCH_ADMIN_LOGIN);
+  fprintf(f,
+          "  <caps>\n"
+          "    <cap login=\"%s\">\n"
+          "      MASTER_LOGIN,\n"
+          "      JUDGE_LOGIN,\n"
+          "      LIST_USERS,\n"
+          "      GET_USER,\n"
+          "      EDIT_USER,\n"
+          "      PRIV_EDIT_USER,\n"
+          "      DUMP_USERS,\n"
+          "      CONTROL_CONTEST,\n"
+          "    </cap>\n"
+          "  </caps>\n", BENCH_ADMIN_LOGIN);
+  fprintf(f,
+          "  <plugins>\n"
+          "    <plugin type=\"nsdb\" name=\"files\">\n"
+          "      <config>\n"
+          "        <data_dir>%s/new-serve-db</data_dir>\n"
+          "      </config>\n"
+          "    </plugin>\n"
+          "  </plugins>\n"
+          "</config>\n", dir);
+  close_file_or_die(f, path);
+}
+
+/* the admin is the user 1, the participants are the users 2.. */
+static void
+write_users_xml(const unsigned char *dir, const struct bench_config *bc)
+{
+  path_t path;
+  FILE *f;
+  int i;
+  unsigned char date_buf[64];
+
+  // the users, which have never logged in, are removed by ej-users
+  snprintf(date_buf, sizeof(date_buf), "%s", xml_unparse_date(time(0)));
+
+  snprintf(path, sizeof(path), "%s/users.xml", dir);
+  f = open_file_or_die(path);
+  fprintf(f, "<?xml version=\"1.0\" encoding=\"%s\" ?>\n", EJUDGE_CHARSET);
+  fprintf(f, "<userlist member_serial=\"1\" name=\"bench\">\n");
+  fprintf(f,
+          "  <user id=\"1\" never_clean=\"yes\" registered=\"%s\""
+          " last_login=\"%s\">\n"
+          "    <login public=\"no\">%s</login>\n"
+          "    <password method=\"plain\">%s</password>\n"
+          "    <name>Bench administrator</name>\n"
+          "    <contests>\n"
+          "      <contest id=\"%d\" status=\"ok\"/>\n"
+          "    </contests>\n"
+          "  </user>\n", date_buf, date_buf, BENCH_ADMIN_LOGIN, BENCH_PASSWORD,
+          bc->contest_id);
+  for (i = 0; i < bc->user_count; ++i) {
+    fprintf(f,
+            "  <user id=\"%d\" registered=\"%s\" last_login=\"%s\">\n"
+            "    <login public=\"no\">user%d</login>\n"
+            "    <password method=\"plain\">%s</password>\n"
+            "    <name>Participant %d</name>\n"
+            "    <contests>\n"
+            "      <contest id=\"%d\" status=\"ok\"/>\n"
+            "    </contests>\n"
+            "  </user>\n", i + 2, date_buf, date_buf, i + 1, BENCH_PASSWORD,
+            i + 1, bc->contest_id);
+  }
+  fprintf(f, "</userlist>\n");
+  close_file_or_die(f, path);
+}
+
+static void
+write_contest_xml(const unsigned char *dir, const struct bench_config *bc)
+{
+  path_t path;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/contests/%06d.xml", dir, bc->contest_id);
+  f = open_file_or_die(path);
+  fprintf(f, "<?xml version=\"1.0\" encoding=\"%s\" ?>\n", EJUDGE_CHARSET);
+  fprintf(f,
+          "<contest id=\"%d\" disable_team_password=\"yes\" managed=\"yes\">\n"
+          "  <name>Bench contest</name>\n"
+          "  <register_access default=\"allow\" />\n"
+          "  <users_access default=\"allow\" />\n"
+          "  <team_access default=\"allow\" />\n"
+          "  <judge_access default=\"allow\" />\n"
+          "  <master_access default=\"allow\" />\n"
+          "  <serve_control_access default=\"allow\" />\n"
+          "  <caps>\n"
+          "    <cap login=\"%s\">MASTER_SET,</cap>\n"
+          "  </caps>\n"
+          "  <client_flags>\n"
+          "    IGNORE_TIME_SKEW,\n"
+          "  </client_flags>\n"
+          "  <root_dir>%s/%06d</root_dir>\n"
+          "</contest>\n", bc->contest_id, BENCH_ADMIN_LOGIN,
+          dir, bc->contest_id);
+  close_file_or_die(f, path);
+}
+
+static void
+write_serve_cfg(const unsigned char *path, const unsigned char *dir,
+                const unsigned char *root_dir, const struct bench_config *bc)
+{
+  FILE *f;
+  int i;
+  unsigned char name[64];
+
+  f = open_file_or_die(path);
+  fprintf(f, "# Generated by ej-bench, version %s\n\n", compile_version);
+  fprintf(f,
+          "contest_id = %d\n"
+          "root_dir = \"%s\"\n"
+          "contests_dir = \"%s/contests\"\n"
+          "advanced_layout\n"
+          "\n"
+          "contest_time = 0\n"
+          "score_system = \"acm\"\n"
+          "ignore_duplicated_runs\n"
+          "compile_dir = \"%s/compile\"\n"
+          "\n"
+          "[language]\n"
+          "id = 1\n"
+          "short_name = \"gcc\"\n"
+          "long_name = \"GNU C\"\n"
+          "src_sfx = \".c\"\n"
+          "\n", bc->contest_id, root_dir, dir, root_dir);
+  for (i = 1; i <= bc->prob_count; ++i) {
+    get_problem_name(name, sizeof(name), i);
+    fprintf(f,
+            "[problem]\n"
+            "id = %d\n"
+            "short_name = \"%s\"\n"
+            "long_name = \"Problem %s\"\n"
+            "\n", i, name, name);
+  }
+  close_file_or_die(f, path);
+}
+
+/* the statuses of the generated runs with their weights */
+static const int gen_statuses[][2] =
+{
+  { RUN_OK, 30 },
+  { RUN_WRONG_ANSWER_ERR, 35 },
+  { RUN_TIME_LIMIT_ERR, 10 },
+  { RUN_RUN_TIME_ERR, 10 },
+  { RUN_COMPILE_ERR, 10 },
+  { RUN_PRESENTATION_ERR, 5 },
+  { 0, 0 },
+};
+
+static int
+gen_status(void)
+{
+  int total = 0, i, r;
+
+  for (i = 0; gen_statuses[i][1]; ++i) total += gen_statuses[i][1];
+  r = rand_int(total);
+  for (i = 0; r >= gen_statuses[i][1]; ++i) r -= gen_statuses[i][1];
+  return gen_statuses[i][0];
+}
+
+static void
+gen_contest_data(
+        const unsigned char *dir,
+        const struct bench_config *bc,
+        const unsigned char *config_path)
+{
+  const struct contest_desc *cnts = 0;
+  serve_state_t state;
+  time_t cur_time, start_time, t;
+  ej_ip_t ip;
+  int i, run_id, user_id, prob_id, status, clar_id, from, to;
+  unsigned char subj[128], text[256], path[PATH_MAX];
+  size_t text_len;
+
+  snprintf(path, sizeof(path), "%s/ejudge.xml", dir);
+  if (!(ejudge_config = ejudge_cfg_parse(path))) die("cannot parse %s", path);
+  if (contests_set_directory(ejudge_config->contests_dir) < 0)
+    die("contests directory is invalid");
+  if (contests_get(bc->contest_id, &cnts) < 0 || !cnts)
+    die("cannot read contest XML for contest %d", bc->contest_id);
+
+  cur_time = time(0);
+  state = serve_state_init(bc->contest_id);
+  state->config_path = xstrdup(config_path);
+  state->current_time = cur_time;
+  state->load_time = cur_time;
+  if (prepare(state, state->config_path, 0, PREPARE_SERVE, "", 1, 0, 0) < 0)
+    die("failed to load the configuration file %s", config_path);
+  if (create_dirs(state, PREPARE_SERVE) < 0)
+    die("failed to create the contest directories");
+
+  memset(&ip, 0, sizeof(ip));
+  ip.u.v4.addr = htonl(0x7f000001);
+
+  // the runs are spread over the last 3 hours of the contest
+  start_time = cur_time - 3 * 60 * 60;
+  state->runlog_state = run_init(0);
+  if (run_open(state->runlog_state, ejudge_config, cnts, state->global, 0, 0,
+               0, 0, 0) < 0)
+    die("failed to open the runlog");
+  if (run_start_contest(state->runlog_state, start_time) < 0)
+    die("failed to start the contest");
+  for (i = 0; i < bc->run_count; ++i) {
+    t = start_time + (long long) (cur_time - start_time - 60) * i
+      / bc->run_count;
+    user_id = 2 + rand_int(bc->user_count);
+    prob_id = 1 + rand_int(bc->prob_count);
+    run_id = run_add_record(state->runlog_state, t, 0, 100 + rand_int(4000),
+                            0, 0, &ip, 0, 0, user_id, prob_id, 1, 0, 0, 0,
+                            0, 0);
+    if (run_id < 0) die("failed to add a run");
+    status = gen_status();
+    if (run_change_status(state->runlog_state, run_id, status,
+                          status == RUN_OK || status == RUN_COMPILE_ERR
+                          ?0:1 + rand_int(20), 0, -1, 0) < 0)
+      die("failed to set the run status");
+  }
+  runlog_commit(state->runlog_state);
+
+  state->clarlog_state = clar_init();
+  if (clar_open(state->clarlog_state, ejudge_config, cnts, state->global,
+                0, 0) < 0)
+    die("failed to open the clarlog");
+  // every fourth clar is the answer to all the participants
+  for (i = 0; i < bc->clar_count; ++i) {
+    t = start_time + (long long) (cur_time - start_time - 60) * i
+      / bc->clar_count;
+    from = 2 + rand_int(bc->user_count);
+    to = 0;
+    if (i % 4 == 3) from = 0;
+    snprintf(subj, sizeof(subj), "Question %d", i + 1);
+    text_len = snprintf(text, sizeof(text), "Subject: %s\n\n%s\n", subj,
+                        from > 0?"Is the input data correct?"
+                        :"The input data is correct.");
+    clar_id = clar_add_record(state->clarlog_state, t, 0, text_len, &ip, 0,
+                              from, to, 0, 0, 0, 0, 0, 0, 0, 1, NULL, subj);
+    if (clar_id < 0) die("failed to add a clar");
+    if (clar_add_text(state->clarlog_state, clar_id, text, text_len) < 0)
+      die("failed to write the clar text");
+  }
+
+  // the participants have read the half of the answers
+  state->team_extra_state = team_extra_init();
+  team_extra_set_dir(state->team_extra_state, state->global->team_extra_dir);
+  for (i = 0; i < bc->clar_count; ++i) {
+    if (i % 4 != 3) continue;
+    for (user_id = 2; user_id < bc->user_count + 2; ++user_id) {
+      if (rand_int(2)) continue;
+      team_extra_set_clar_status(state->team_extra_state, user_id, i);
+    }
+  }
+  team_extra_flush(state->team_extra_state);
+}
+
+static int
+cmd_gen(int argc, char *argv[])
+{
+  int i = 0;
+  struct bench_config bc;
+  const unsigned char *dir_arg = 0;
+  unsigned char dir[PATH_MAX], path[PATH_MAX], root_dir[PATH_MAX];
+
+  memset(&bc, 0, sizeof(bc));
+  bc.contest_id = 1;
+  bc.user_count = 100;
+  bc.prob_count = 10;
+  bc.run_count = 10000;
+  bc.clar_count = 100;
+
+  while (i < argc) {
+    if (!strcmp(argv[i], "-i")) {
+      bc.contest_id = parse_int_arg(argv[i], argv[i + 1], 1, EJ_MAX_CONTEST_ID);
+      i += 2;
+    } else if (!strcmp(argv[i], "-u")) {
+      bc.user_count = parse_int_arg(argv[i], argv[i + 1], 1, 1000000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-p")) {
+      bc.prob_count = parse_int_arg(argv[i], argv[i + 1], 1, 1000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-r")) {
+      bc.run_count = parse_int_arg(argv[i], argv[i + 1], 0, EJ_MAX_RUN_ID);
+      i += 2;
+    } else if (!strcmp(argv[i], "-c")) {
+      bc.clar_count = parse_int_arg(argv[i], argv[i + 1], 0, 1000000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-S")) {
+      rand_seed = parse_int_arg(argv[i], argv[i + 1], 0, INT_MAX);
+      i += 2;
+    } else if (argv[i][0] == '-') {
+      die("invalid option `%s'", argv[i]);
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) die("directory is expected");
+  dir_arg = argv[i++];
+  if (i < argc) die("extra parameters");
+
+  make_dir_or_die(dir_arg);
+  if (!realpath(dir_arg, dir)) die("invalid directory %s", dir_arg);
+  snprintf(path, sizeof(path), "%s/contests", dir);
+  make_dir_or_die(path);
+  snprintf(path, sizeof(path), "%s/var", dir);
+  make_dir_or_die(path);
+  snprintf(root_dir, sizeof(root_dir), "%s/%06d", dir, bc.contest_id);
+  make_dir_or_die(root_dir);
+  snprintf(path, sizeof(path), "%s/conf", root_dir);
+  make_dir_or_die(path);
+
+  write_ejudge_xml(dir);
+  write_users_xml(dir, &bc);
+  write_contest_xml(dir, &bc);
+  snprintf(path, sizeof(path), "%s/conf/serve.cfg", root_dir);
+  write_serve_cfg(path, dir, root_dir, &bc);
+  gen_contest_data(dir, &bc, path);
+  write_bench_config(dir, &bc);
+
+  printf("%s: contest %d with %d users, %d problems, %d runs, %d clars "
+         "created in %s\n", program_name, bc.contest_id, bc.user_count,
+         bc.prob_count, bc.run_count, bc.clar_count, dir);
+  return 0;
+}
+
+/* the kinds of the replayed requests */
+enum
+{
+  BENCH_LOGIN,
+  BENCH_MAIN,
+  BENCH_SUBMIT,
+  BENCH_STANDINGS,
+  BENCH_RUNS,
+
+  BENCH_LAST
+};
+
+static const unsigned char * const bench_names[BENCH_LAST] =
+{
+  [BENCH_LOGIN] = "login",
+  [BENCH_MAIN] = "main",
+  [BENCH_SUBMIT] = "submit",
+  [BENCH_STANDINGS] = "standings",
+  [BENCH_RUNS] = "runs",
+};
+
+static int bench_weights[BENCH_LAST] =
+{
+  [BENCH_LOGIN] = 1,
+  [BENCH_MAIN] = 10,
+  [BENCH_SUBMIT] = 2,
+  [BENCH_STANDINGS] = 3,
+  [BENCH_RUNS] = 3,
+};
+
+/* the filters of the judge run list */
+static const unsigned char * const bench_filters[] =
+{
+  "",
+  "status == OK",
+  "status == WA && prob == \"A\"",
+  "uid == 2 || uid == 3",
+  "lang == \"gcc\" && status != CE",
+  0,
+};
+
+static void
+parse_mix(const unsigned char *str)
+{
+  const unsigned char *s = str;
+  unsigned char name[64];
+  int weight, n, i;
+
+  memset(bench_weights, 0, sizeof(bench_weights));
+  while (*s) {
+    if (sscanf(s, "%63[a-z]=%d%n", name, &weight, &n) != 2 || weight < 0)
+      die("invalid request mix `%s'", str);
+    for (i = 0; i < BENCH_LAST; ++i)
+      if (!strcmp(bench_names[i], name))
+        break;
+    if (i == BENCH_LAST) die("invalid request kind `%s'", name);
+    bench_weights[i] = weight;
+    s += n;
+    if (*s == ',') ++s;
+  }
+}
+
+/* the result of a request, sent by the client processes to the parent */
+struct bench_record
+{
+  int kind;
+  int error;
+  int late;
+  int size;
+  long long usec;
+};
+
+struct bench_session
+{
+  int user_id;
+  ej_cookie_t session_id;
+  ej_cookie_t client_key;
+};
+
+struct bench_request
+{
+  int param_u;
+  unsigned char *names[16];
+  size_t sizes[16];
+  unsigned char *values[16];
+};
+
+static void
+add_param(struct bench_request *rq, const unsigned char *name,
+          const unsigned char *value)
+{
+  ASSERT(rq->param_u < 16);
+  rq->names[rq->param_u] = (unsigned char*) name;
+  rq->sizes[rq->param_u] = strlen(value);
+  rq->values[rq->param_u] = (unsigned char*) value;
+  ++rq->param_u;
+}
+
+/* performs the request as the CGI program new-client or new-master,
+   the reply is returned in p_reply */
+static int
+send_request(
+        new_server_conn_t conn,
+        int priv_mode,
+        const struct bench_session *ss,
+        struct bench_request *rq,
+        unsigned char **p_reply,
+        size_t *p_size)
+{
+  unsigned char script_path[64], script_filename[128], script_name[128];
+  unsigned char cookie[128];
+  unsigned char *args[2], *envs[8];
+  int env_u = 0;
+
+  snprintf(script_path, sizeof(script_path), "/cgi-bin/%s",
+           priv_mode?"new-master":"new-client");
+  snprintf(script_filename, sizeof(script_filename), "SCRIPT_FILENAME=%s",
+           script_path);
+  snprintf(script_name, sizeof(script_name), "SCRIPT_NAME=%s", script_path);
+  args[0] = script_path;
+  args[1] = 0;
+  envs[env_u++] = script_filename;
+  envs[env_u++] = script_name;
+  envs[env_u++] = "REMOTE_ADDR=127.0.0.1";
+  envs[env_u++] = "HTTP_HOST=localhost";
+  envs[env_u++] = "REQUEST_METHOD=POST";
+  if (ss && ss->client_key) {
+    snprintf(cookie, sizeof(cookie), "HTTP_COOKIE=EJSID=%016llx",
+             ss->client_key);
+    envs[env_u++] = cookie;
+  }
+  envs[env_u] = 0;
+
+  *p_reply = 0;
+  *p_size = 0;
+  return new_server_clnt_http_request(conn, 0, -1, args, envs, rq->param_u,
+                                      rq->names, rq->sizes, rq->values,
+                                      p_reply, p_size);
+}
+
+static int
+do_login(
+        new_server_conn_t conn,
+        int contest_id,
+        int priv_mode,
+        struct bench_session *ss,
+        size_t *p_size)
+{
+  struct bench_request rq;
+  unsigned char cnts_buf[64], action_buf[64], login_buf[64];
+  unsigned char *reply = 0, *s;
+  size_t size = 0;
+  int r;
+
+  memset(&rq, 0, sizeof(rq));
+  snprintf(cnts_buf, sizeof(cnts_buf), "%d", contest_id);
+  snprintf(action_buf, sizeof(action_buf), "%d", NEW_SRV_ACTION_LOGIN);
+  if (priv_mode) snprintf(login_buf, sizeof(login_buf), "%s", BENCH_ADMIN_LOGIN);
+  else snprintf(login_buf, sizeof(login_buf), "user%d", ss->user_id - 1);
+  add_param(&rq, "contest_id", cnts_buf);
+  add_param(&rq, "action", action_buf);
+  add_param(&rq, "login", login_buf);
+  add_param(&rq, "password", BENCH_PASSWORD);
+  ss->session_id = 0;
+  ss->client_key = 0;
+  if ((r = send_request(conn, priv_mode, 0, &rq, &reply, &size)) < 0)
+    return r;
+  *p_size = size;
+
+  // the successful login is the redirect with the new session
+  r = -1;
+  for (s = reply; s && (s = strstr(s, "SID=")); s += 4)
+    if (s > reply && (s[-1] == '?' || s[-1] == '&'))
+      break;
+  if (s && sscanf(s + 4, "%llx", &ss->session_id) == 1 && ss->session_id) {
+    if ((s = strstr(reply, "EJSID=")))
+      sscanf(s + 6, "%llx", &ss->client_key);
+    r = 0;
+  }
+  xfree(reply);
+  return r;
+}
+
+static int
+do_request(
+        new_server_conn_t conn,
+        const struct bench_config *bc,
+        int kind,
+        struct bench_session *ss,
+        struct bench_session *admin_ss,
+        int serial,
+        size_t *p_size)
+{
+  struct bench_request rq;
+  unsigned char sid_buf[64], action_buf[64], prob_buf[64], src_buf[256];
+  unsigned char *reply = 0;
+  size_t size = 0;
+  int r, priv_mode = 0, i;
+
+  if (kind == BENCH_LOGIN)
+    return do_login(conn, bc->contest_id, 0, ss, p_size);
+
+  memset(&rq, 0, sizeof(rq));
+  if (kind == BENCH_RUNS) {
+    priv_mode = 1;
+    ss = admin_ss;
+  }
+  snprintf(sid_buf, sizeof(sid_buf), "%016llx", ss->session_id);
+  add_param(&rq, "SID", sid_buf);
+
+  switch (kind) {
+  case BENCH_MAIN:
+    snprintf(action_buf, sizeof(action_buf), "%d", NEW_SRV_ACTION_MAIN_PAGE);
+    add_param(&rq, "action", action_buf);
+    break;
+  case BENCH_SUBMIT:
+    snprintf(action_buf, sizeof(action_buf), "%d", NEW_SRV_ACTION_SUBMIT_RUN);
+    snprintf(prob_buf, sizeof(prob_buf), "%d", 1 + rand_int(bc->prob_count));
+    // the sources differ, so they are not rejected as duplicates
+    snprintf(src_buf, sizeof(src_buf),
+             "/* %d %d %lld */\nint main(void) { return 0; }\n",
+             ss->user_id, serial, get_usec());
+    add_param(&rq, "action", action_buf);
+    add_param(&rq, "prob_id", prob_buf);
+    add_param(&rq, "lang_id", "1");
+    add_param(&rq, "file", src_buf);
+    break;
+  case BENCH_STANDINGS:
+    snprintf(action_buf, sizeof(action_buf), "%d", NEW_SRV_ACTION_STANDINGS);
+    add_param(&rq, "action", action_buf);
+    break;
+  case BENCH_RUNS:
+    snprintf(action_buf, sizeof(action_buf), "%d", NEW_SRV_ACTION_MAIN_PAGE);
+    add_param(&rq, "action", action_buf);
+    for (i = 0; bench_filters[i]; ++i);
+    add_param(&rq, "filter_expr", bench_filters[rand_int(i)]);
+    break;
+  default:
+    abort();
+  }
+
+  if ((r = send_request(conn, priv_mode, ss, &rq, &reply, &size)) < 0)
+    return r;
+  *p_size = size;
+  r = 0;
+  if (!reply || !size) r = -1;
+  xfree(reply);
+  return r;
+}
+
+static int
+pick_kind(void)
+{
+  int total = 0, i, r;
+
+  for (i = 0; i < BENCH_LAST; ++i) total += bench_weights[i];
+  r = rand_int(total);
+  for (i = 0; r >= bench_weights[i]; ++i) r -= bench_weights[i];
+  return i;
+}
+
+static void
+send_record(int fd, int kind, int error, int late, size_t size,
+            long long usec)
+{
+  struct bench_record rec;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.kind = kind;
+  rec.error = error;
+  rec.late = late;
+  rec.size = size;
+  rec.usec = usec;
+  if (write(fd, &rec, sizeof(rec)) != sizeof(rec))
+    die("write to the result pipe failed");
+}
+
+/* the client process `proc' of `proc_count', it sends the requests
+   at rate / proc_count per second from start_usec until end_usec,
+   the next request is sent after the reply to the previous one, the
+   latency is counted from the scheduled time */
+static void
+run_client(
+        int out_fd,
+        const struct bench_config *bc,
+        int proc,
+        int proc_count,
+        int sess_count,
+        int rate,
+        long long start_usec,
+        long long end_usec)
+{
+  new_server_conn_t conn = 0;
+  struct bench_session *sess = 0, admin_ss;
+  long long t1, t2, sched;
+  int i, r, kind, serial;
+  size_t size;
+
+  if ((r = new_server_clnt_open(ejudge_config->new_server_socket, &conn)) < 0)
+    die("cannot connect to %s: %d", ejudge_config->new_server_socket, -r);
+
+  // the participants of this process are proc + 2, proc + 2 + proc_count...
+  XCALLOC(sess, sess_count);
+  for (i = 0; i < sess_count; ++i) {
+    sess[i].user_id = 2 + (proc + i * proc_count) % bc->user_count;
+    t1 = get_usec();
+    r = do_login(conn, bc->contest_id, 0, &sess[i], &size);
+    send_record(out_fd, BENCH_LOGIN, r < 0, 0, size, get_usec() - t1);
+  }
+  memset(&admin_ss, 0, sizeof(admin_ss));
+  admin_ss.user_id = 1;
+  t1 = get_usec();
+  r = do_login(conn, bc->contest_id, 1, &admin_ss, &size);
+  send_record(out_fd, BENCH_LOGIN, r < 0, 0, size, get_usec() - t1);
+
+  // the processes send their requests evenly shifted
+  for (serial = 0; ; ++serial) {
+    sched = start_usec + (long long) (serial * proc_count + proc) * 1000000LL
+      / rate;
+    if (sched >= end_usec) break;
+    if ((t1 = get_usec()) < sched) {
+      usleep(sched - t1);
+      t1 = get_usec();
+    }
+    kind = pick_kind();
+    i = rand_int(sess_count);
+    size = 0;
+    r = do_request(conn, bc, kind, &sess[i], &admin_ss, serial, &size);
+    t2 = get_usec();
+    // the server did not keep up, if the request is sent 10 ms late
+    send_record(out_fd, kind, r < 0, t1 - sched > 10000, size, t2 - sched);
+    if (r == -NEW_SRV_ERR_READ_ERROR || r == -NEW_SRV_ERR_WRITE_ERROR
+        || r == -NEW_SRV_ERR_NOT_CONNECTED) {
+      die("client %d: connection to the server lost", proc);
+    }
+  }
+  new_server_clnt_close(conn);
+}
+
+static int
+sort_usec_func(const void *v1, const void *v2)
+{
+  long long t1 = *(const long long*) v1;
+  long long t2 = *(const long long*) v2;
+
+  if (t1 < t2) return -1;
+  if (t1 > t2) return 1;
+  return 0;
+}
+
+struct bench_stat
+{
+  int count, error_count, late_count;
+  long long total_size;
+  int usec_u, usec_a;
+  long long *usec;
+};
+
+static double
+get_percentile(const struct bench_stat *st, double p)
+{
+  int i;
+
+  if (st->usec_u <= 0) return 0.0;
+  i = (int) (p * st->usec_u / 100.0);
+  if (i >= st->usec_u) i = st->usec_u - 1;
+  return st->usec[i] / 1000.0;
+}
+
+static void
+write_stat_line(const unsigned char *name, struct bench_stat *st)
+{
+  long long total = 0;
+  int i;
+
+  if (!st->count) return;
+  if (st->usec_u > 1) qsort(st->usec, st->usec_u, sizeof(st->usec[0]),
+                            sort_usec_func);
+  for (i = 0; i < st->usec_u; ++i) total += st->usec[i];
+  printf("%-10s %7d %6d %8lld %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+         name, st->count, st->error_count,
+         st->total_size / st->count,
+         st->usec_u > 0 ? total / 1000.0 / st->usec_u : 0.0,
+         get_percentile(st, 50), get_percentile(st, 90),
+         get_percentile(st, 99), get_percentile(st, 99.9),
+         st->usec_u > 0 ? st->usec[st->usec_u - 1] / 1000.0 : 0.0);
+}
+
+static pid_t
+start_server(
+        const unsigned char *bin_dir,
+        const unsigned char *prog,
+        const unsigned char *arg,
+        const unsigned char *xml_path,
+        const unsigned char *out_path)
+{
+  unsigned char path[PATH_MAX];
+  pid_t pid;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/%s", bin_dir, prog);
+  if ((pid = fork()) < 0) die("fork failed: %s", os_ErrorMsg());
+  if (!pid) {
+    if ((fd = open(out_path, O_WRONLY | O_CREAT | O_APPEND, 0644)) >= 0) {
+      dup2(fd, 1);
+      dup2(fd, 2);
+      close(fd);
+    }
+    if (arg) execl(path, path, arg, xml_path, NULL);
+    else execl(path, path, xml_path, NULL);
+    fprintf(stderr, "%s: exec of %s failed: %s\n", program_name, path,
+            os_ErrorMsg());
+    _exit(1);
+  }
+  return pid;
+}
+
+/* waits until the socket appears, returns -1 if the server has exited */
+static int
+wait_socket(pid_t pid, const unsigned char *path)
+{
+  struct stat stb;
+  int i;
+
+  for (i = 0; i < 100; ++i) {
+    if (stat(path, &stb) >= 0 && S_ISSOCK(stb.st_mode)) return 0;
+    if (pid > 0 && waitpid(pid, 0, WNOHANG) == pid) return -1;
+    usleep(100000);
+  }
+  return -1;
+}
+
+static void
+stop_server(pid_t pid)
+{
+  if (pid <= 0) return;
+  kill(pid, SIGTERM);
+  waitpid(pid, 0, 0);
+}
+
+static int
+cmd_run(int argc, char *argv[])
+{
+  int i = 0, rate = 50, duration = 30, proc_count = 8, sess_count = 16;
+  int use_running = 0, status, r, done_count, n;
+  const unsigned char *bin_dir = 0, *dir_arg;
+  unsigned char dir[PATH_MAX], path[PATH_MAX], out_path[PATH_MAX];
+  struct bench_config bc;
+  struct bench_stat stats[BENCH_LAST + 1], *st;
+  struct bench_record rec;
+  pid_t users_pid = 0, contests_pid = 0, *pids = 0;
+  int pfd[2];
+  long long start_usec, end_usec, finish_usec;
+  struct stat stb;
+
+#if defined EJUDGE_SERVER_BIN_PATH
+  bin_dir = EJUDGE_SERVER_BIN_PATH;
+#endif
+
+  while (i < argc) {
+    if (!strcmp(argv[i], "-R")) {
+      rate = parse_int_arg(argv[i], argv[i + 1], 1, 1000000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-t")) {
+      duration = parse_int_arg(argv[i], argv[i + 1], 1, 86400);
+      i += 2;
+    } else if (!strcmp(argv[i], "-j")) {
+      proc_count = parse_int_arg(argv[i], argv[i + 1], 1, 1000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-s")) {
+      sess_count = parse_int_arg(argv[i], argv[i + 1], 1, 100000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-m")) {
+      if (i + 1 >= argc) die("argument expected for `-m'");
+      parse_mix(argv[i + 1]);
+      i += 2;
+    } else if (!strcmp(argv[i], "-B")) {
+      if (i + 1 >= argc) die("argument expected for `-B'");
+      bin_dir = argv[i + 1];
+      i += 2;
+    } else if (!strcmp(argv[i], "-S")) {
+      rand_seed = parse_int_arg(argv[i], argv[i + 1], 0, INT_MAX);
+      i += 2;
+    } else if (!strcmp(argv[i], "-x")) {
+      use_running = 1;
+      i++;
+    } else if (argv[i][0] == '-') {
+      die("invalid option `%s'", argv[i]);
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) die("directory is expected");
+  dir_arg = argv[i++];
+  if (i < argc) die("extra parameters");
+  for (i = 0, r = 0; i < BENCH_LAST; ++i) r += bench_weights[i];
+  if (r <= 0) die("the request mix is empty");
+
+  if (!realpath(dir_arg, dir)) die("invalid directory %s", dir_arg);
+  read_bench_config(dir, &bc);
+  snprintf(path, sizeof(path), "%s/ejudge.xml", dir);
+  if (!(ejudge_config = ejudge_cfg_parse(path))) die("cannot parse %s", path);
+  if (!ejudge_config->new_server_socket) die("<new_server_socket> is not set");
+
+  if (!use_running) {
+    if (!bin_dir) die("the server binary directory is not specified");
+    snprintf(out_path, sizeof(out_path), "%s/var/servers.out", dir);
+    unlink(ejudge_config->socket_path);
+    unlink(ejudge_config->new_server_socket);
+    snprintf(path, sizeof(path), "%s/new-serve-db", dir);
+    if (stat(path, &stb) < 0) {
+      snprintf(path, sizeof(path), "%s/ejudge.xml", dir);
+      contests_pid = start_server(bin_dir, "ej-contests", "--create", path,
+                                  out_path);
+      if (waitpid(contests_pid, &status, 0) != contests_pid
+          || !WIFEXITED(status) || WEXITSTATUS(status))
+        die("ej-contests --create failed, see %s", out_path);
+      contests_pid = 0;
+    }
+    snprintf(path, sizeof(path), "%s/ejudge.xml", dir);
+    users_pid = start_server(bin_dir, "ej-users", 0, path, out_path);
+    if (wait_socket(users_pid, ejudge_config->socket_path) < 0) {
+      stop_server(users_pid);
+      die("ej-users failed to start, see %s", out_path);
+    }
+    contests_pid = start_server(bin_dir, "ej-contests", 0, path, out_path);
+    if (wait_socket(contests_pid, ejudge_config->new_server_socket) < 0) {
+      stop_server(contests_pid);
+      stop_server(users_pid);
+      die("ej-contests failed to start, see %s", out_path);
+    }
+  }
+
+  if (pipe(pfd) < 0) die("pipe failed: %s", os_ErrorMsg());
+  XCALLOC(pids, proc_count);
+  // the time for the logins before the measurement
+  start_usec = get_usec() + 2000000LL;
+  end_usec = start_usec + duration * 1000000LL;
+  for (i = 0; i < proc_count; ++i) {
+    if ((pids[i] = fork()) < 0) die("fork failed: %s", os_ErrorMsg());
+    if (!pids[i]) {
+      close(pfd[0]);
+      rand_seed += i * 7919;
+      run_client(pfd[1], &bc, i, proc_count, sess_count, rate, start_usec,
+                 end_usec);
+      _exit(0);
+    }
+  }
+  close(pfd[1]);
+
+  memset(stats, 0, sizeof(stats));
+  while ((n = read(pfd[0], &rec, sizeof(rec))) == sizeof(rec)) {
+    if (rec.kind < 0 || rec.kind >= BENCH_LAST) continue;
+    st = &stats[rec.kind];
+    ++st->count;
+    st->total_size += rec.size;
+    if (rec.late) ++st->late_count;
+    if (rec.error) {
+      ++st->error_count;
+      continue;
+    }
+    if (st->usec_u == st->usec_a) {
+      if (!(st->usec_a *= 2)) st->usec_a = 1024;
+      XREALLOC(st->usec, st->usec_a);
+    }
+    st->usec[st->usec_u++] = rec.usec;
+  }
+  finish_usec = get_usec();
+  close(pfd[0]);
+
+  for (i = 0, done_count = 0; i < proc_count; ++i) {
+    if (waitpid(pids[i], &status, 0) == pids[i] && WIFEXITED(status)
+        && !WEXITSTATUS(status))
+      ++done_count;
+  }
+  stop_server(contests_pid);
+  stop_server(users_pid);
+
+  printf("%-10s %7s %6s %8s %8s %8s %8s %8s %8s %8s\n",
+         "request", "count", "errors", "bytes", "mean,ms", "p50", "p90",
+         "p99", "p99.9", "max");
+  st = &stats[BENCH_LAST];
+  for (i = 0; i < BENCH_LAST; ++i) {
+    write_stat_line(bench_names[i], &stats[i]);
+    st->count += stats[i].count;
+    st->error_count += stats[i].error_count;
+    st->late_count += stats[i].late_count;
+  }
+  if (finish_usec < start_usec) finish_usec = start_usec + 1;
+  printf("\n%d requests, %d errors, %.1f requests/s (target %d), "
+         "%d sent late\n", st->count, st->error_count,
+         (st->count - stats[BENCH_LOGIN].count) * 1000000.0
+         / (finish_usec - start_usec), rate, st->late_count);
+  if (done_count != proc_count)
+    fprintf(stderr, "%s: %d client processes failed\n", program_name,
+            proc_count - done_count);
+  return done_count != proc_count;
+}
+
+int
+main(int argc, char *argv[])
+{
+  program_name = os_GetBasename(argv[0]);
+  logger_set_level(-1, LOG_WARNING);
+
+  if (argc <= 1) die("not enough parameters");
+  if (!strcmp(argv[1], "--help")) {
+    write_help();
+  } else if (!strcmp(argv[1], "--version")) {
+    write_version();
+  } else if (!strcmp(argv[1], "gen")) {
+    return cmd_gen(argc - 2, argv + 2);
+  } else if (!strcmp(argv[1], "run")) {
+    return cmd_run(argc - 2, argv + 2);
+  }
+  die("invalid command `%s'", argv[1]);
+}
+
+/* force linking of certain functions that may be needed by plugins */
+static void *forced_link_table[] __attribute__((unused));
+static void *forced_link_table[] =
+{
+  xml_parse_ip,
+  xml_parse_date,
+  xml_parse_int,
+  xml_parse_ip_mask,
+  xml_parse_bool,
+  xml_unparse_text,
+  xml_unparse_bool,
+  xml_unparse_ip,
+  xml_unparse_date,
+  xml_unparse_ip_mask,
+  xml_err_get_elem_name,
+  xml_err_get_attr_name,
+  xml_err,
+  xml_err_a,
+  xml_err_attrs,
+  xml_err_nested_elems,
+  xml_err_attr_not_allowed,
+  xml_err_elem_not_allowed,
+  xml_err_elem_redefined,
+  xml_err_top_level,
+  xml_err_top_level_s,
+  xml_err_attr_invalid,
+  xml_err_elem_undefined,
+  xml_err_elem_undefined_s,
+  xml_err_attr_undefined,
+  xml_err_attr_undefined_s,
+  xml_err_elem_invalid,
+  xml_err_elem_empty,
+  xml_leaf_elem,
+  xml_empty_text,
+  xml_empty_text_c,
+  xml_attr_bool,
+  xml_attr_bool_byte,
+  xml_attr_int,
+  xml_attr_date,
+  close_memstream,
+};
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
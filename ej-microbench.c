@@ -0,0 +1,987 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The microbenchmarks of the separate subsystems. Each benchmark runs
+ * the old and the new code path on the same input for the given number
+ * of iterations and prints the best and the average time of one
+ * iteration for each of them. The whole server load is measured by
+ * ej-bench. runlogcrash is not a benchmark, but the crash consistency
+ * check of the runlog writes.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+#include "version.h"
+
+#include "userlist.h"
+#include "expat_iface.h"
+#include "xml_utils.h"
+#include "fileutl.h"
+#include "run_pack.h"
+#include "super_run_packet.h"
+#include "similarity_index.h"
+#include "runlog.h"
+#include "prepare.h"
+#include "team_extra.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+#include "reuse_osdeps.h"
+#include "reuse_exec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fcntl.h>
+
+static const unsigned char *program_name = "";
+
+static void
+die(const char *format, ...)
+  __attribute__((format(printf, 1, 2), noreturn));
+static void
+die(const char *format, ...)
+{
+  va_list args;
+  char buf[1024];
+
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  fprintf(stderr, "%s: fatal: %s\n", program_name, buf);
+  exit(1);
+}
+
+static int
+parse_int_arg(const char *opt, const char *str, int min_val, int max_val)
+{
+  char *eptr = 0;
+  long val;
+
+  if (!str) die("argument expected for `%s'", opt);
+  errno = 0;
+  val = strtol(str, &eptr, 10);
+  if (!*str || *eptr || errno || val < min_val || val > max_val)
+    die("invalid argument for `%s'", opt);
+  return val;
+}
+
+static long long
+get_usec(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static unsigned char *
+read_file_or_die(const unsigned char *path, size_t *p_size)
+{
+  char *text = 0;
+  size_t size = 0;
+
+  if (generic_read_file(&text, 0, &size, 0, 0, path, 0) < 0)
+    die("cannot read `%s'", path);
+  if (p_size) *p_size = size;
+  return (unsigned char*) text;
+}
+
+/* the timing of one code path */
+struct bench_timer
+{
+  const unsigned char *name;
+  int count;
+  long long total_usec;
+  long long min_usec;
+  long long start_usec;
+};
+
+static void
+timer_start(struct bench_timer *bt)
+{
+  bt->start_usec = get_usec();
+}
+
+static void
+timer_stop(struct bench_timer *bt)
+{
+  long long usec = get_usec() - bt->start_usec;
+
+  if (!bt->count || usec < bt->min_usec) bt->min_usec = usec;
+  bt->total_usec += usec;
+  bt->count++;
+}
+
+static void
+write_timers_header(void)
+{
+  printf("%-24s %8s %12s %12s\n", "variant", "count", "min,us", "avg,us");
+}
+
+static void
+write_timer(const struct bench_timer *bt)
+{
+  if (!bt->count) return;
+  printf("%-24s %8d %12lld %12lld\n", bt->name, bt->count, bt->min_usec,
+         bt->total_usec / bt->count);
+}
+
+/* parses the options common to all the benchmarks, returns the index
+   of the first argument */
+static int
+parse_common_args(int argc, char *argv[], int *p_iter_count)
+{
+  int i = 0;
+
+  while (i < argc) {
+    if (!strcmp(argv[i], "-n")) {
+      *p_iter_count = parse_int_arg("-n", argv[i + 1], 1, 1000000);
+      i += 2;
+    } else if (!strcmp(argv[i], "--")) {
+      ++i;
+      break;
+    } else if (argv[i][0] == '-') {
+      die("invalid option `%s'", argv[i]);
+    } else {
+      break;
+    }
+  }
+  return i;
+}
+
+/* the userlist XML (for example, users.xml of the xml plugin or the
+   reply of LIST_ALL_USERS) parsed on the heap and in an arena */
+static int
+bench_userlist(int argc, char *argv[])
+{
+  int iter_count = 20, i;
+  unsigned char *text;
+  struct bench_timer heap_t = { "heap" }, arena_t = { "arena" };
+  struct userlist_list *lst;
+  struct xml_arena *arena;
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 1 != argc) die("userlist: FILE expected");
+  text = read_file_or_die(argv[i], 0);
+
+  for (i = 0; i < iter_count; ++i) {
+    timer_start(&heap_t);
+    if (!(lst = userlist_parse_str(text))) die("userlist: parse error");
+    userlist_free(&lst->b);
+    timer_stop(&heap_t);
+
+    timer_start(&arena_t);
+    arena = xml_arena_create();
+    if (!(lst = userlist_parse_str_arena(text, arena)))
+      die("userlist: parse error");
+    xml_arena_free(arena);
+    timer_stop(&arena_t);
+  }
+
+  write_timers_header();
+  write_timer(&heap_t);
+  write_timer(&arena_t);
+  xfree(text);
+  return 0;
+}
+
+/* the run artifacts stored as the separate files (the uuid archive)
+   and in the pack store, the artifacts are generated in DIR */
+static int
+bench_runpack(int argc, char *argv[])
+{
+  int iter_count = 5, i, j, count, size;
+  unsigned char path[PATH_MAX], pack_dir[PATH_MAX];
+  const unsigned char *dir;
+  unsigned char *data;
+  char *text;
+  size_t text_size;
+  ruint32_t run_uuid[4];
+  struct bench_timer files_t = { "files" }, pack_t = { "pack" };
+  struct bench_timer compact_t = { "pack compaction" };
+  struct run_pack_state *rp;
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 3 != argc) die("runpack: DIR COUNT SIZE expected");
+  count = parse_int_arg("COUNT", argv[i + 1], 1, 10000000);
+  size = parse_int_arg("SIZE", argv[i + 2], 1, 100000000);
+  dir = argv[i];
+  if (mkdir(dir, 0777) < 0 && errno != EEXIST)
+    die("cannot create `%s'", dir);
+  snprintf(pack_dir, sizeof(pack_dir), "%s/pack", dir);
+  if (!(rp = run_pack_open(pack_dir, 1))) die("cannot open the pack store");
+
+  data = xmalloc(size);
+  for (j = 0; j < count; ++j) {
+    memset(data, 'a' + j % 26, size);
+    memset(run_uuid, 0, sizeof(run_uuid));
+    run_uuid[0] = j;
+    snprintf(path, sizeof(path), "%s/%02x", dir, j & 0xff);
+    mkdir(path, 0777);
+    snprintf(path, sizeof(path), "%s/%02x/%d", dir, j & 0xff, j);
+    if (generic_write_file(data, size, 0, 0, path, 0) < 0)
+      die("cannot write `%s'", path);
+    if (run_pack_put(rp, run_uuid, RUN_PACK_SOURCE, data, size, 0) < 0)
+      die("runpack: put failed");
+    // the replaced reports are the garbage for the compaction
+    if (run_pack_put(rp, run_uuid, RUN_PACK_REPORT, data, size, 0) < 0
+        || run_pack_put(rp, run_uuid, RUN_PACK_REPORT, data, size, 0) < 0)
+      die("runpack: put failed");
+  }
+  run_pack_sync(rp);
+  run_pack_close(rp);
+
+  for (i = 0; i < iter_count; ++i) {
+    timer_start(&files_t);
+    for (j = 0; j < count; ++j) {
+      snprintf(path, sizeof(path), "%s/%02x/%d", dir, j & 0xff, j);
+      text = 0;
+      if (generic_read_file(&text, 0, &text_size, 0, 0, path, 0) < 0)
+        die("cannot read `%s'", path);
+      xfree(text);
+    }
+    timer_stop(&files_t);
+
+    // the store is opened for each iteration, as in the request
+    timer_start(&pack_t);
+    if (!(rp = run_pack_open(pack_dir, 0))) die("cannot open the pack store");
+    for (j = 0; j < count; ++j) {
+      memset(run_uuid, 0, sizeof(run_uuid));
+      run_uuid[0] = j;
+      if (run_pack_get(rp, run_uuid, RUN_PACK_SOURCE, &text, &text_size) != 1)
+        die("runpack: get failed");
+      xfree(text);
+    }
+    run_pack_close(rp);
+    timer_stop(&pack_t);
+  }
+
+  if (!(rp = run_pack_open(pack_dir, 1))) die("cannot open the pack store");
+  timer_start(&compact_t);
+  if (run_pack_compact(rp) < 0) die("runpack: compaction failed");
+  timer_stop(&compact_t);
+  run_pack_close(rp);
+
+  write_timers_header();
+  write_timer(&files_t);
+  write_timer(&pack_t);
+  write_timer(&compact_t);
+  xfree(data);
+  return 0;
+}
+
+/* the run request packet (a text packet from the run queue) written
+   and parsed in the text and in the binary form */
+static int
+bench_runpacket(int argc, char *argv[])
+{
+  int iter_count = 10000, i;
+  unsigned char *text;
+  size_t text_size, out_size = 0;
+  char *out = 0;
+  FILE *out_f;
+  struct bench_timer text_t = { "text" }, bin_t = { "binary" };
+  struct super_run_in_packet *srp, *srp2;
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 1 != argc) die("runpacket: FILE expected");
+  text = read_file_or_die(argv[i], &text_size);
+  if (!(srp = super_run_in_packet_parse_cfg_str(argv[i], text, text_size)))
+    die("runpacket: parse error");
+
+  for (i = 0; i < iter_count; ++i) {
+    timer_start(&text_t);
+    out_f = open_memstream(&out, &out_size);
+    super_run_in_packet_unparse_cfg(out_f, srp);
+    fclose(out_f);
+    if (!(srp2 = super_run_in_packet_parse_cfg_str("", out, out_size)))
+      die("runpacket: parse error");
+    super_run_in_packet_free(srp2);
+    xfree(out); out = 0;
+    timer_stop(&text_t);
+
+    timer_start(&bin_t);
+    if (super_run_in_packet_write_bin(srp, &out_size, (void**) &out) < 0)
+      die("runpacket: write error");
+    if (!(srp2 = super_run_in_packet_parse_cfg_str("", out, out_size)))
+      die("runpacket: parse error");
+    super_run_in_packet_free(srp2);
+    xfree(out); out = 0;
+    timer_stop(&bin_t);
+  }
+
+  write_timers_header();
+  write_timer(&text_t);
+  write_timer(&bin_t);
+  super_run_in_packet_free(srp);
+  xfree(text);
+  return 0;
+}
+
+/* the number of the common elements of two sorted arrays */
+static int
+count_common(const unsigned *a, int na, const unsigned *b, int nb)
+{
+  int i = 0, j = 0, count = 0;
+
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (a[i] > b[j]) {
+      ++j;
+    } else {
+      ++count; ++i; ++j;
+    }
+  }
+  return count;
+}
+
+/* the sources (all of one problem) are added to the similarity index
+   one by one, as on the submission, and the most similar runs are
+   found for each of them with the index and by the comparison of the
+   fingerprints of all the pairs */
+static int
+bench_similarity(int argc, char *argv[])
+{
+  int iter_count = 3, i, j, k, first, file_count, total = 0;
+  unsigned char **texts;
+  size_t *sizes;
+  unsigned **fps;
+  int *fp_counts;
+  struct bench_timer add_t = { "index: add all" };
+  struct bench_timer index_t = { "index: top for all" };
+  struct bench_timer pairs_t = { "pairwise: top for all" };
+  struct similarity_index *idx;
+  struct similarity_match matches[10];
+
+  first = parse_common_args(argc, argv, &iter_count);
+  if ((file_count = argc - first) < 2) die("similarity: FILES expected");
+  XCALLOC(texts, file_count);
+  XCALLOC(sizes, file_count);
+  XCALLOC(fps, file_count);
+  XCALLOC(fp_counts, file_count);
+  for (j = 0; j < file_count; ++j)
+    texts[j] = read_file_or_die(argv[first + j], &sizes[j]);
+
+  for (i = 0; i < iter_count; ++i) {
+    idx = similarity_index_create(0, 0);
+    timer_start(&add_t);
+    for (j = 0; j < file_count; ++j)
+      similarity_index_add(idx, j, 1, j, texts[j], sizes[j]);
+    timer_stop(&add_t);
+
+    timer_start(&index_t);
+    for (j = 0; j < file_count; ++j)
+      total += similarity_index_top(idx, j, 0, 10, matches);
+    timer_stop(&index_t);
+    similarity_index_free(idx);
+
+    // the fingerprints of each source are computed once
+    timer_start(&pairs_t);
+    for (j = 0; j < file_count; ++j)
+      fp_counts[j] = similarity_fingerprint(texts[j], sizes[j],
+                                            SIMILARITY_DEFAULT_KGRAM,
+                                            SIMILARITY_DEFAULT_WINDOW,
+                                            &fps[j]);
+    for (j = 0; j < file_count; ++j)
+      for (k = 0; k < file_count; ++k)
+        if (j != k)
+          total += count_common(fps[j], fp_counts[j], fps[k], fp_counts[k]);
+    timer_stop(&pairs_t);
+    for (j = 0; j < file_count; ++j) {
+      xfree(fps[j]); fps[j] = 0;
+    }
+  }
+
+  write_timers_header();
+  write_timer(&add_t);
+  write_timer(&index_t);
+  write_timer(&pairs_t);
+  for (j = 0; j < file_count; ++j)
+    xfree(texts[j]);
+  xfree(texts);
+  xfree(sizes);
+  xfree(fps);
+  xfree(fp_counts);
+  return total < 0;
+}
+
+static void
+spawn_task(const unsigned char *path)
+{
+  tpTask tsk = task_New();
+
+  task_AddArg(tsk, path);
+  task_SetPathAsArg0(tsk);
+  task_SetRedir(tsk, 0, TSR_FILE, "/dev/null", TSK_READ);
+  task_SetRedir(tsk, 1, TSR_FILE, "/dev/null", TSK_WRITE, TSK_FULL_RW);
+  task_SetMaxTimeMillis(tsk, 10000);
+  task_SetVMSize(tsk, 256 * 1024 * 1024);
+  task_DisableCoreDump(tsk);
+  if (task_Start(tsk) < 0) die("spawn: cannot start `%s'", path);
+  task_Wait(tsk);
+  if (task_IsAbnormal(tsk)) die("spawn: `%s' failed", path);
+  task_Delete(tsk);
+}
+
+/* the start of a tested program by task_Start with fork() and with
+   clone(CLONE_VM | CLONE_VFORK), the process size is increased by
+   SIZE megabytes of touched memory to be like ej-super-run with the
+   loaded tests */
+static int
+bench_spawn(int argc, char *argv[])
+{
+  int iter_count = 200, i, size;
+  const unsigned char *path = "/bin/true";
+  unsigned char *mem;
+  struct bench_timer fork_t = { "fork" }, clone_t = { "clone" };
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 1 != argc && i + 2 != argc) die("spawn: SIZE [PROGRAM] expected");
+  size = parse_int_arg("SIZE", argv[i], 0, 65536);
+  if (i + 2 == argc) path = argv[i + 1];
+  mem = xmalloc((size_t) size * 1024 * 1024 + 1);
+  memset(mem, 1, (size_t) size * 1024 * 1024 + 1);
+
+  for (i = 0; i < iter_count; ++i) {
+    task_SetForkMode(1);
+    timer_start(&fork_t);
+    spawn_task(path);
+    timer_stop(&fork_t);
+
+    task_SetForkMode(0);
+    timer_start(&clone_t);
+    spawn_task(path);
+    timer_stop(&clone_t);
+  }
+
+  write_timers_header();
+  write_timer(&fork_t);
+  write_timer(&clone_t);
+  xfree(mem);
+  return 0;
+}
+
+/* the sequence checkers of the checker library */
+static const struct checker_seq_info
+{
+  const unsigned char *name;
+  const unsigned char *label;
+  int kind;                     /* 0 - int, 1 - long long, 2 - double */
+} checker_seqs[] =
+{
+  { "cmp_int_seq", "int", 0 },
+  { "cmp_unsigned_int_seq", "uint", 0 },
+  { "cmp_long_long_seq", "llong", 1 },
+  { "cmp_unsigned_long_long_seq", "ullong", 1 },
+  { "cmp_double_seq", "double", 2 },
+  { "cmp_long_double_seq", "ldouble", 2 },
+
+  { 0 },
+};
+
+/* writes about SIZE megabytes of the numbers of the given kind,
+   the same pseudorandom sequence for the same kind */
+static void
+make_checker_file(const unsigned char *path, int kind, int size)
+{
+  FILE *f;
+  unsigned long long x = 12345 + kind;
+  long long total = (long long) size * 1024 * 1024;
+  int n = 0;
+
+  if (!(f = fopen(path, "w"))) die("cannot create `%s'", path);
+  while (ftell(f) < total) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    switch (kind) {
+    case 0:
+      fprintf(f, "%u", (unsigned) (x >> 33));
+      break;
+    case 1:
+      fprintf(f, "%llu", x >> 1);
+      break;
+    default:
+      fprintf(f, "%.9f", (double) (x >> 11) / 1e9);
+      break;
+    }
+    putc((++n % 10)?' ':'\n', f);
+  }
+  putc('\n', f);
+  if (ferror(f) || fclose(f) < 0) die("write error on `%s'", path);
+}
+
+static void
+run_checker(const unsigned char *path, const unsigned char *dir, int kind,
+            int mmap_flag)
+{
+  unsigned char in_path[PATH_MAX], out_path[PATH_MAX], corr_path[PATH_MAX];
+  tpTask tsk = task_New();
+
+  snprintf(in_path, sizeof(in_path), "%s/input", dir);
+  snprintf(out_path, sizeof(out_path), "%s/%d.out", dir, kind);
+  snprintf(corr_path, sizeof(corr_path), "%s/%d.corr", dir, kind);
+  task_AddArg(tsk, path);
+  task_AddArg(tsk, in_path);
+  task_AddArg(tsk, out_path);
+  task_AddArg(tsk, corr_path);
+  task_SetPathAsArg0(tsk);
+  if (mmap_flag) {
+    task_PutEnv(tsk, "EJ_CHECKER_NO_MMAP");
+  } else {
+    task_SetEnv(tsk, "EJ_CHECKER_NO_MMAP", "1");
+  }
+  task_SetEnv(tsk, "EPS", "1e-6");
+  task_SetRedir(tsk, 0, TSR_FILE, "/dev/null", TSK_READ);
+  task_SetRedir(tsk, 1, TSR_FILE, "/dev/null", TSK_WRITE, TSK_FULL_RW);
+  task_SetRedir(tsk, 2, TSR_FILE, "/dev/null", TSK_WRITE, TSK_FULL_RW);
+  task_DisableCoreDump(tsk);
+  if (task_Start(tsk) < 0) die("checkers: cannot start `%s'", path);
+  task_Wait(tsk);
+  // the output is the same as the correct answer, so it must be accepted
+  if (task_IsAbnormal(tsk))
+    die("checkers: `%s' has not accepted the answer", path);
+  task_Delete(tsk);
+}
+
+/* the cmp_*_seq checkers on the output of SIZE megabytes, the input
+   files are read through the mapping and through stdio, when
+   EJ_CHECKER_NO_MMAP is set */
+static int
+bench_checkers(int argc, char *argv[])
+{
+  int iter_count = 5, i, j, k, size;
+  const unsigned char *dir, *checker_dir;
+  unsigned char path[PATH_MAX], path2[PATH_MAX];
+  struct bench_timer *mmap_ts, *stdio_ts;
+  FILE *f;
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 3 != argc) die("checkers: DIR SIZE CHECKERDIR expected");
+  dir = argv[i];
+  size = parse_int_arg("SIZE", argv[i + 1], 1, 4096);
+  checker_dir = argv[i + 2];
+  if (os_MakeDirPath(dir, 0755) < 0) die("cannot create `%s'", dir);
+
+  snprintf(path, sizeof(path), "%s/input", dir);
+  if (!(f = fopen(path, "w"))) die("cannot create `%s'", path);
+  fclose(f);
+  for (k = 0; k < 3; ++k) {
+    snprintf(path, sizeof(path), "%s/%d.out", dir, k);
+    snprintf(path2, sizeof(path2), "%s/%d.corr", dir, k);
+    make_checker_file(path, k, size);
+    make_checker_file(path2, k, size);
+  }
+
+  for (j = 0; checker_seqs[j].name; ++j);
+  XCALLOC(mmap_ts, j);
+  XCALLOC(stdio_ts, j);
+  for (i = 0; i < iter_count; ++i) {
+    for (j = 0; checker_seqs[j].name; ++j) {
+      snprintf(path, sizeof(path), "%s/%s", checker_dir,
+               checker_seqs[j].name);
+      snprintf(path2, sizeof(path2), "%s mmap", checker_seqs[j].label);
+      if (!mmap_ts[j].name) mmap_ts[j].name = xstrdup(path2);
+      timer_start(&mmap_ts[j]);
+      run_checker(path, dir, checker_seqs[j].kind, 1);
+      timer_stop(&mmap_ts[j]);
+
+      snprintf(path2, sizeof(path2), "%s stdio", checker_seqs[j].label);
+      if (!stdio_ts[j].name) stdio_ts[j].name = xstrdup(path2);
+      timer_start(&stdio_ts[j]);
+      run_checker(path, dir, checker_seqs[j].kind, 0);
+      timer_stop(&stdio_ts[j]);
+    }
+  }
+
+  write_timers_header();
+  for (j = 0; checker_seqs[j].name; ++j) {
+    write_timer(&mmap_ts[j]);
+    write_timer(&stdio_ts[j]);
+    xfree((unsigned char*) mmap_ts[j].name);
+    xfree((unsigned char*) stdio_ts[j].name);
+  }
+  xfree(mmap_ts);
+  xfree(stdio_ts);
+  return 0;
+}
+
+/* the last batch of runlogcrash, which has changed the run: the batch
+   k adds one run and changes every other run, so each batch is written
+   by many separate writes */
+static int
+crash_last_batch(int run_id, int init_runs, int batch)
+{
+  int first = (run_id < init_runs)?1:run_id - init_runs + 1;
+
+  if (batch < first) return 0;
+  if ((run_id + batch) % 2) --batch;
+  if (batch < first) return 0;
+  return batch;
+}
+
+static runlog_state_t
+crash_open_runlog(const struct section_global_data *global, int flags)
+{
+  runlog_state_t rl = run_init(0);
+
+  if (run_open(rl, 0, 0, global, 0, flags, 0, 0, 0) < 0)
+    return run_destroy(rl);
+  return rl;
+}
+
+/* the writing process of runlogcrash, reports each committed batch
+   to the pipe */
+static void
+crash_writer(
+        const struct section_global_data *global,
+        int init_runs,
+        int fd) __attribute__((noreturn));
+static void
+crash_writer(
+        const struct section_global_data *global,
+        int init_runs,
+        int fd)
+{
+  runlog_state_t rl;
+  int batch, run_id, total;
+  time_t t;
+
+  if (!(rl = crash_open_runlog(global, 0))) _exit(1);
+  // the new runs are appended after the initial ones
+  t = run_get_start_time(rl) + 1;
+  for (batch = 1; ; ++batch) {
+    if (run_add_record(rl, t, batch, 1, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0,
+                       0) < 0)
+      _exit(1);
+    total = run_get_total(rl);
+    for (run_id = batch % 2; run_id < total; run_id += 2) {
+      if (run_change_status(rl, run_id, RUN_OK, batch, 0, batch % 100, 0) < 0)
+        _exit(1);
+    }
+    if (runlog_commit(rl) < 0) _exit(1);
+    if (write(fd, &batch, sizeof(batch)) != sizeof(batch)) _exit(1);
+  }
+}
+
+/* checks the runlog after the writer was killed in the batch after
+   the last reported one, *p_partial is set, if the batch is found
+   written in part */
+static int
+crash_check(
+        const struct section_global_data *global,
+        int init_runs,
+        int batch,
+        int *p_partial)
+{
+  runlog_state_t rl;
+  struct run_entry re;
+  int total, run_id, b1, b2, errors = 0, old_count = 0, new_count = 0;
+
+  if (!(rl = crash_open_runlog(global, RUN_LOG_READONLY))) {
+    printf("the runlog cannot be opened\n");
+    return 1;
+  }
+  total = run_get_total(rl);
+  if (total != init_runs + batch && total != init_runs + batch + 1) {
+    printf("%d runs instead of %d\n", total, init_runs + batch);
+    ++errors;
+  }
+  for (run_id = 0; run_id < total && errors < 10; ++run_id) {
+    if (run_get_entry(rl, run_id, &re) < 0 || re.run_id != run_id) {
+      printf("run %d: invalid entry\n", run_id);
+      ++errors;
+      continue;
+    }
+    b1 = crash_last_batch(run_id, init_runs, batch);
+    b2 = crash_last_batch(run_id, init_runs, batch + 1);
+    // an entry is written either before or after the batch
+    if ((re.test != b1 && re.test != b2)
+        || (re.test > 0 && re.score != re.test % 100)) {
+      printf("run %d: test %d, score %d, expected test %d or %d\n",
+             run_id, re.test, re.score, b1, b2);
+      ++errors;
+    }
+    if (b1 != b2 && re.test == b1) ++old_count;
+    if (b1 != b2 && re.test == b2) ++new_count;
+  }
+  *p_partial = (old_count > 0 && new_count > 0);
+  run_destroy(rl);
+  return errors;
+}
+
+/* not a benchmark: the runlog writer is killed at random points in
+   the batch commits, then the runlog is checked to contain every
+   committed batch and the in-flight one either complete or partial
+   at the entry level, without torn entries */
+static int
+bench_runlogcrash(int argc, char *argv[])
+{
+  int iter_count = 50, i, init_runs, batch, b, pfd[2], status, errors = 0;
+  int partial, partial_count = 0;
+  unsigned char path[PATH_MAX];
+  struct section_global_data *global;
+  runlog_state_t rl;
+  time_t t;
+  pid_t pid;
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 2 != argc) die("runlogcrash: DIR RUNS expected");
+  init_runs = parse_int_arg("RUNS", argv[i + 1], 1, 1000000);
+  if (mkdir(argv[i], 0777) < 0 && errno != EEXIST)
+    die("cannot create `%s'", argv[i]);
+  snprintf(path, sizeof(path), "%s/run.log", argv[i]);
+  XCALLOC(global, 1);
+  snprintf(global->run_log_file, sizeof(global->run_log_file), "%s", path);
+  srand(getpid());
+
+  for (i = 0; i < iter_count; ++i) {
+    if (!(rl = crash_open_runlog(global, RUN_LOG_CREATE)))
+      die("cannot create `%s'", path);
+    t = time(0);
+    if (run_start_contest(rl, t) < 0) die("runlogcrash: cannot start");
+    for (b = 0; b < init_runs; ++b) {
+      if (run_add_record(rl, t, b, 1, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0,
+                         0) < 0
+          || run_change_status(rl, b, RUN_OK, 0, 0, 0, 0) < 0)
+        die("runlogcrash: cannot add a run");
+    }
+    runlog_commit(rl);
+    run_destroy(rl);
+
+    if (pipe(pfd) < 0) die("pipe failed");
+    if ((pid = fork()) < 0) die("fork failed");
+    if (!pid) {
+      close(pfd[0]);
+      crash_writer(global, init_runs, pfd[1]);
+    }
+    close(pfd[1]);
+    // a random point after the first batch
+    while (read(pfd[0], &b, sizeof(b)) != sizeof(b)) {
+      if (waitpid(pid, &status, WNOHANG) == pid) die("the writer failed");
+    }
+    usleep(rand() % 100000);
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    batch = b;
+    while (read(pfd[0], &b, sizeof(b)) == sizeof(b)) batch = b;
+    close(pfd[0]);
+
+    if ((b = crash_check(global, init_runs, batch, &partial)) > 0) {
+      printf("iteration %d: killed after batch %d: FAILED\n", i + 1, batch);
+      errors += b;
+    }
+    partial_count += partial;
+  }
+
+  printf("%d iterations, %d killed in the middle of a batch, %s\n",
+         iter_count, partial_count, errors?"FAILED":"ok");
+  xfree(global);
+  return errors > 0;
+}
+
+/* the clar read flags of USERS users written after each read as the
+   per-user XML files (as the old team_extra_flush did, but in one flat
+   directory) and in the team_extra store, and loaded back, the files
+   are created in DIR, each iteration is one broadcast clar read by all
+   the users */
+static int
+bench_teamextra(int argc, char *argv[])
+{
+  int iter_count = 10, i, j, user_count, clar_id;
+  unsigned char xml_dir[PATH_MAX], store_dir[PATH_MAX], path[PATH_MAX];
+  const unsigned char *dir;
+  struct team_extra *tes, *te;
+  team_extra_state_t state;
+  FILE *f;
+  struct bench_timer xml_t = { "xml write" }, store_t = { "store write" };
+  struct bench_timer xml_load_t = { "xml load" };
+  struct bench_timer store_load_t = { "store load" };
+
+  i = parse_common_args(argc, argv, &iter_count);
+  if (i + 2 != argc) die("teamextra: DIR USERS expected");
+  user_count = parse_int_arg("USERS", argv[i + 1], 1, 1000000);
+  dir = argv[i];
+  snprintf(xml_dir, sizeof(xml_dir), "%s/xml", dir);
+  snprintf(store_dir, sizeof(store_dir), "%s/store", dir);
+  if ((mkdir(dir, 0777) < 0 && errno != EEXIST)
+      || (mkdir(xml_dir, 0777) < 0 && errno != EEXIST))
+    die("cannot create `%s'", xml_dir);
+  snprintf(path, sizeof(path), "%s/team_extra.bin", store_dir);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/team_extra.journal", store_dir);
+  unlink(path);
+
+  XCALLOC(tes, user_count + 1);
+  for (j = 1; j <= user_count; ++j) {
+    te = &tes[j];
+    te->user_id = j;
+    te->clar_map_size = 128;
+    while (te->clar_map_size <= iter_count) te->clar_map_size *= 2;
+    te->clar_map_alloc = te->clar_map_size / (CHAR_BIT * sizeof(long));
+    XCALLOC(te->clar_map, te->clar_map_alloc);
+  }
+  state = team_extra_init();
+  if (team_extra_set_dir(state, store_dir) < 0)
+    die("cannot open the store in `%s'", store_dir);
+
+  for (clar_id = 0; clar_id < iter_count; ++clar_id) {
+    timer_start(&xml_t);
+    for (j = 1; j <= user_count; ++j) {
+      te = &tes[j];
+      te->clar_map[clar_id / (CHAR_BIT * sizeof(long))]
+        |= 1UL << clar_id % (CHAR_BIT * sizeof(long));
+      snprintf(path, sizeof(path), "%s/%06d.xml", xml_dir, j);
+      if (!(f = fopen(path, "w"))) die("cannot create `%s'", path);
+      team_extra_unparse_xml(f, te);
+      fclose(f);
+    }
+    timer_stop(&xml_t);
+
+    timer_start(&store_t);
+    for (j = 1; j <= user_count; ++j) {
+      if (team_extra_set_clar_status(state, j, clar_id) < 0
+          || team_extra_flush(state) < 0)
+        die("teamextra: store write failed");
+    }
+    timer_stop(&store_t);
+  }
+  team_extra_destroy(state);
+
+  for (i = 0; i < iter_count; ++i) {
+    timer_start(&xml_load_t);
+    for (j = 1; j <= user_count; ++j) {
+      snprintf(path, sizeof(path), "%s/%06d.xml", xml_dir, j);
+      if (team_extra_parse_xml(path, &te) < 0)
+        die("cannot parse `%s'", path);
+      xfree(te->clar_map);
+      xfree(te);
+    }
+    timer_stop(&xml_load_t);
+
+    timer_start(&store_load_t);
+    state = team_extra_init();
+    if (team_extra_set_dir(state, store_dir) < 0)
+      die("cannot open the store in `%s'", store_dir);
+    if (!team_extra_get_entry(state, user_count)
+        || !team_extra_get_clar_status(state, user_count, iter_count - 1))
+      die("teamextra: the store is not consistent");
+    team_extra_destroy(state);
+    timer_stop(&store_load_t);
+  }
+
+  write_timers_header();
+  write_timer(&xml_t);
+  write_timer(&store_t);
+  write_timer(&xml_load_t);
+  write_timer(&store_load_t);
+  for (j = 1; j <= user_count; ++j)
+    xfree(tes[j].clar_map);
+  xfree(tes);
+  return 0;
+}
+
+struct bench_info
+{
+  const unsigned char *name;
+  const unsigned char *args;
+  const unsigned char *descr;
+  int (*func)(int argc, char *argv[]);
+};
+
+static const struct bench_info benchmarks[] =
+{
+  { "userlist", "FILE", "userlist XML parsing on the heap and in an arena",
+    bench_userlist },
+  { "runpack", "DIR COUNT SIZE",
+    "run artifacts in the separate files and in the pack store",
+    bench_runpack },
+  { "runpacket", "FILE",
+    "run request packets in the text and the binary form", bench_runpacket },
+  { "similarity", "FILES...",
+    "similar sources with the index and by all the pairs", bench_similarity },
+  { "spawn", "SIZE [PROGRAM]",
+    "task start with fork and clone in a process of SIZE MB", bench_spawn },
+  { "checkers", "DIR SIZE CHKDIR",
+    "cmp_*_seq checkers on SIZE MB with mmap and with stdio",
+    bench_checkers },
+  { "runlogcrash", "DIR RUNS",
+    "runlog consistency after the writer is killed in a commit",
+    bench_runlogcrash },
+  { "teamextra", "DIR USERS",
+    "clar read flags in the per-user XML files and in the store",
+    bench_teamextra },
+
+  { 0 },
+};
+
+static void write_help(void) __attribute__((noreturn));
+static void
+write_help(void)
+{
+  int i;
+
+  printf("%s: Ejudge microbenchmarks\n"
+         "Usage: %s BENCHMARK [-n ITERATIONS] ARGS...\n"
+         "Benchmarks:\n",
+         program_name, program_name);
+  for (i = 0; benchmarks[i].name; ++i)
+    printf("  %-12s %-16s %s\n", benchmarks[i].name, benchmarks[i].args,
+           benchmarks[i].descr);
+  exit(0);
+}
+static void write_version(void) __attribute__((noreturn));
+static void
+write_version(void)
+{
+  printf("%s %s, compiled %s\n", program_name, compile_version, compile_date);
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  program_name = os_GetBasename(argv[0]);
+  logger_set_level(-1, LOG_WARNING);
+
+  if (argc <= 1) die("not enough parameters");
+  if (!strcmp(argv[1], "--help")) write_help();
+  if (!strcmp(argv[1], "--version")) write_version();
+  for (i = 0; benchmarks[i].name; ++i) {
+    if (!strcmp(argv[1], benchmarks[i].name))
+      return (*benchmarks[i].func)(argc - 2, argv + 2);
+  }
+  die("invalid benchmark `%s'", argv[1]);
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
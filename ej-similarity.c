@@ -0,0 +1,302 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+#include "ej_limits.h"
+#include "version.h"
+
+#include "ejudge_cfg.h"
+#include "contests.h"
+#include "prepare.h"
+#include "runlog.h"
+#include "serve_state.h"
+#include "diff.h"
+#include "similarity_index.h"
+#include "xml_utils.h"
+#include "compat.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+
+static const unsigned char *program_name = "";
+static const unsigned char *ejudge_xml_path = 0;
+
+static void
+die(const char *format, ...)
+  __attribute__((format(printf, 1, 2), noreturn));
+static void
+die(const char *format, ...)
+{
+  va_list args;
+  char buf[1024];
+
+  va_start(args, format);
+  vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  fprintf(stderr, "%s: fatal: %s\n", program_name, buf);
+  exit(1);
+}
+
+static void write_help(void) __attribute__((noreturn));
+static void
+write_help(void)
+{
+  printf("%s: Ejudge source similarity search\n"
+         "Usage: %s [OPTIONS] CONTEST-ID\n"
+         "  OPTIONS:\n"
+         "    --help    write this message and exit\n"
+         "    --version report version and exit\n"
+         "    -f CFG    specify the ejudge configuration file\n"
+         "    -p PROB   process only the problem PROB (short name)\n"
+         "    -r RUN    list the runs most similar to the run RUN\n"
+         "    -n COUNT  the number of runs to list for -r (20)\n"
+         "    -t SCORE  the minimal score of the pair of runs (50)\n"
+         "    -s        compare the runs of the same user as well\n"
+         "    -k TOKENS the length of the k-grams (%d)\n"
+         "    -w WIDTH  the winnowing window width (%d)\n",
+         program_name, program_name,
+         SIMILARITY_DEFAULT_KGRAM, SIMILARITY_DEFAULT_WINDOW);
+  exit(0);
+}
+static void write_version(void) __attribute__((noreturn));
+static void
+write_version(void)
+{
+  printf("%s %s, compiled %s\n", program_name, compile_version, compile_date);
+  exit(0);
+}
+
+static int
+parse_int_arg(const char *opt, const char *str, int min_val, int max_val)
+{
+  char *eptr = 0;
+  long val;
+
+  if (!str) die("argument expected for `%s'", opt);
+  errno = 0;
+  val = strtol(str, &eptr, 10);
+  if (!*str || *eptr || errno || val < min_val || val > max_val)
+    die("invalid argument for `%s'", opt);
+  return val;
+}
+
+static void
+write_match(serve_state_t state, const struct similarity_match *m)
+{
+  struct run_entry re1, re2;
+
+  if (run_get_entry(state->runlog_state, m->run_id1, &re1) < 0) return;
+  if (run_get_entry(state->runlog_state, m->run_id2, &re2) < 0) return;
+  printf("%s\t%d\t%d\t%d\t%d\t%d\t%d\n",
+         state->probs[re1.prob_id]->short_name,
+         m->run_id1, re1.user_id, m->run_id2, re2.user_id,
+         m->score, m->shared);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i = 1, contest_id, prob_id, match_u, j;
+  int run_id = -1, count = 20, threshold = 50, same_user = 0;
+  int kgram = 0, window = 0;
+  const unsigned char *prob_name = 0;
+  const struct contest_desc *cnts = 0;
+  const unsigned char *conf_dir;
+  unsigned char config_path[PATH_MAX];
+  serve_state_t state;
+  struct similarity_match *matches = 0;
+  time_t start_time;
+
+  program_name = os_GetBasename(argv[0]);
+  logger_set_level(-1, LOG_WARNING);
+
+  if (argc <= 1) die("not enough parameters");
+  if (!strcmp(argv[1], "--help")) {
+    write_help();
+  } else if (!strcmp(argv[1], "--version")) {
+    write_version();
+  }
+
+  while (i < argc) {
+    if (!strcmp(argv[i], "-f")) {
+      if (i + 1 >= argc) die("argument expected for `-f'");
+      ejudge_xml_path = argv[i + 1];
+      i += 2;
+    } else if (!strcmp(argv[i], "-p")) {
+      if (i + 1 >= argc) die("argument expected for `-p'");
+      prob_name = argv[i + 1];
+      i += 2;
+    } else if (!strcmp(argv[i], "-r")) {
+      run_id = parse_int_arg(argv[i], argv[i + 1], 0, EJ_MAX_RUN_ID);
+      i += 2;
+    } else if (!strcmp(argv[i], "-n")) {
+      count = parse_int_arg(argv[i], argv[i + 1], 1, 100000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-t")) {
+      threshold = parse_int_arg(argv[i], argv[i + 1], 0, 100);
+      i += 2;
+    } else if (!strcmp(argv[i], "-k")) {
+      kgram = parse_int_arg(argv[i], argv[i + 1], 1, 1000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-w")) {
+      window = parse_int_arg(argv[i], argv[i + 1], 1, 1000);
+      i += 2;
+    } else if (!strcmp(argv[i], "-s")) {
+      same_user = 1;
+      i++;
+    } else if (!strcmp(argv[i], "--")) {
+      i++;
+      break;
+    } else if (argv[i][0] == '-') {
+      die("invalid option `%s'", argv[i]);
+    } else {
+      break;
+    }
+  }
+  if (i >= argc) die("contest-id is expected");
+  contest_id = parse_int_arg("contest-id", argv[i++], 1, EJ_MAX_CONTEST_ID);
+  if (i < argc) die("extra parameters");
+
+#if defined EJUDGE_XML_PATH
+  if (!ejudge_xml_path) ejudge_xml_path = EJUDGE_XML_PATH;
+#endif /* EJUDGE_XML_PATH */
+  if (!ejudge_xml_path) die("ejudge.xml path is not specified");
+  if (!(ejudge_config = ejudge_cfg_parse(ejudge_xml_path))) return 1;
+  if (!ejudge_config->contests_dir) die("<contests_dir> tag is not set!");
+  if (contests_set_directory(ejudge_config->contests_dir) < 0)
+    die("contests directory is invalid");
+
+  if (contests_get(contest_id, &cnts) < 0 || !cnts)
+    die("cannot read contest XML for contest %d", contest_id);
+  if (cnts->conf_dir && os_IsAbsolutePath(cnts->conf_dir)) {
+    snprintf(config_path, sizeof(config_path), "%s/serve.cfg", cnts->conf_dir);
+  } else {
+    if (!cnts->root_dir) die("contest %d root_dir is not set", contest_id);
+    if (!(conf_dir = cnts->conf_dir)) conf_dir = "conf";
+    snprintf(config_path, sizeof(config_path),
+             "%s/%s/serve.cfg", cnts->root_dir, conf_dir);
+  }
+
+  state = serve_state_init(contest_id);
+  state->config_path = xstrdup(config_path);
+  state->current_time = time(0);
+  state->load_time = state->current_time;
+  if (prepare(state, state->config_path, 0, PREPARE_SERVE, "", 1, 0, 0) < 0)
+    die("failed to load the configuration file %s", config_path);
+  state->runlog_state = run_init(0);
+  if (run_open(state->runlog_state, ejudge_config, cnts, state->global, 0,
+               RUN_LOG_READONLY | RUN_LOG_NOINDEX, 0, 0, 0) < 0)
+    die("failed to open the runlog");
+
+  prob_id = 0;
+  if (prob_name) {
+    for (prob_id = 1; prob_id <= state->max_prob; ++prob_id) {
+      if (state->probs[prob_id]
+          && !strcmp(state->probs[prob_id]->short_name, prob_name))
+        break;
+    }
+    if (prob_id > state->max_prob) die("problem %s is undefined", prob_name);
+  }
+
+  start_time = time(0);
+  state->similarity_index = similarity_index_create(kgram, window);
+  j = serve_update_similarity_index(state);
+  fprintf(stderr, "%s: %d runs indexed in %ld s\n", program_name, j,
+          (long) (time(0) - start_time));
+
+  if (run_id >= 0) {
+    XCALLOC(matches, count);
+    match_u = similarity_index_top(state->similarity_index, run_id,
+                                   same_user, count, matches);
+    if (match_u < 0) die("run %d is not indexed", run_id);
+    for (j = 0; j < match_u; ++j)
+      write_match(state, &matches[j]);
+    xfree(matches);
+    return 0;
+  }
+
+  for (i = 1; i <= state->max_prob; ++i) {
+    if (!state->probs[i] || (prob_id > 0 && i != prob_id)) continue;
+    match_u = similarity_index_pairs(state->similarity_index, i, same_user,
+                                     threshold, &matches);
+    for (j = 0; j < match_u; ++j)
+      write_match(state, &matches[j]);
+    xfree(matches); matches = 0;
+  }
+
+  return 0;
+}
+
+/* force linking of certain functions that may be needed by plugins */
+static void *forced_link_table[] __attribute__((unused));
+static void *forced_link_table[] =
+{
+  xml_parse_ip,
+  xml_parse_date,
+  xml_parse_int,
+  xml_parse_ip_mask,
+  xml_parse_bool,
+  xml_unparse_text,
+  xml_unparse_bool,
+  xml_unparse_ip,
+  xml_unparse_date,
+  xml_unparse_ip_mask,
+  xml_err_get_elem_name,
+  xml_err_get_attr_name,
+  xml_err,
+  xml_err_a,
+  xml_err_attrs,
+  xml_err_nested_elems,
+  xml_err_attr_not_allowed,
+  xml_err_elem_not_allowed,
+  xml_err_elem_redefined,
+  xml_err_top_level,
+  xml_err_top_level_s,
+  xml_err_attr_invalid,
+  xml_err_elem_undefined,
+  xml_err_elem_undefined_s,
+  xml_err_attr_undefined,
+  xml_err_attr_undefined_s,
+  xml_err_elem_invalid,
+  xml_err_elem_empty,
+  xml_leaf_elem,
+  xml_empty_text,
+  xml_empty_text_c,
+  xml_attr_bool,
+  xml_attr_bool_byte,
+  xml_attr_int,
+  xml_attr_date,
+  //xml_elem_ip_mask,
+  close_memstream,
+};
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
@@ -32,9 +32,13 @@
 #include "ej_process.h"
 #include "xml_utils.h"
 #include "ej_uuid.h"
+#include "super_run_sched.h"
+#include "cpu_slots.h"
+#include "misctext.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_osdeps.h"
+#include "reuse_exec.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -45,6 +49,7 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <signal.h>
 
 struct ignored_problem_info
@@ -63,6 +68,8 @@ static unsigned char super_run_spool_path[PATH_MAX];
 static unsigned char super_run_exe_path[PATH_MAX];
 static unsigned char super_run_conf_path[PATH_MAX];
 static unsigned char super_run_log_path[PATH_MAX];
+static unsigned char super_run_sched_path[PATH_MAX];
+static unsigned char super_run_slots_path[PATH_MAX];
 static int utf8_mode = 0;
 static struct serve_state serve_state;
 static int restart_flag = 0;
@@ -75,6 +82,8 @@ static struct ignored_problem_info *ignored_problems = NULL;
 
 static unsigned char **host_names = NULL;
 static unsigned char *mirror_dir = NULL;
+static struct super_run_sched *sched = NULL;
+static struct cpu_slot_table *cpu_slots = NULL;
 
 static void
 fatal(const char *format, ...)
@@ -193,7 +202,9 @@ handle_packet(
     goto cleanup;
   }
 
-  fprintf(stderr, "packet: <<%.*s>>\n", (int) srp_z, srp_b);
+  if (!super_run_in_packet_is_bin(srp_b, srp_z)) {
+    fprintf(stderr, "packet: <<%.*s>>\n", (int) srp_z, srp_b);
+  }
 
   srp = super_run_in_packet_parse_cfg_str(pkt_name, srp_b, srp_z);
   if (!srp) {
@@ -233,13 +244,19 @@ handle_packet(
   report_path[0] = 0;
   full_report_path[0] = 0;
 
+  if (cpu_slots && cpu_slots->cur_slot >= 0) {
+    unsigned char cpu_buf[256];
+    info("packet %s: running on slot %d (CPUs %s)", pkt_name,
+         cpu_slots->cur_slot,
+         cpu_slot_unparse(cpu_buf, sizeof(cpu_buf), cpu_slots,
+                          cpu_slots->cur_slot));
+  }
+
   if (srpp->type_val == PROB_TYPE_TESTS) {
-    //cr_serialize_lock(state);
     run_inverse_testing(state, srp, &reply_pkt,
                         pkt_name, super_run_exe_path,
                         report_path, sizeof(report_path),
                         utf8_mode);
-    //cr_serialize_unlock(state);
   } else {
     if (!srpp->type_val) {
       tst = find_abstract_tester(state, arch);
@@ -283,7 +300,6 @@ handle_packet(
       ej_uuid_parse(srgp->run_uuid, reply_pkt.uuid);
     }
 
-    //if (cr_serialize_lock(state) < 0) return -1;
     run_tests(ejudge_config, state, tst, srp, &reply_pkt,
               srgp->accepting_mode,
               srpp->accept_partial, srgp->variant,
@@ -291,7 +307,6 @@ handle_packet(
               report_path, full_report_path,
               srgp->user_spelling,
               srpp->spelling, mirror_dir, utf8_mode);
-    //if (cr_serialize_unlock(state) < 0) return -1;
   }
 
   if (srgp->reply_report_dir && srgp->reply_report_dir[0]) {
@@ -389,14 +404,6 @@ do_loop(
 
   if (global->sleep_time <= 0) global->sleep_time = 1000;
 
-  /*
-  if (state->global->cr_serialization_key > 0) {
-    if (cr_serialize_init(state) < 0) {
-      err("cr_serialize_init() failed");
-      return -1;
-    }
-  }
-  */
   interrupt_init();
   interrupt_disable();
 
@@ -412,8 +419,22 @@ do_loop(
     }
     if (restart_flag) break;
 
+    // a packet is taken only when a CPU slot is available, the slot
+    // is kept while the spool is empty, so an idle worker does not
+    // lock and rebind on each scan, it is released after a packet
+    if (cpu_slots && cpu_slot_acquire(cpu_slots) < 0) {
+      interrupt_enable();
+      os_Sleep(global->sleep_time);
+      interrupt_disable();
+      continue;
+    }
+
     pkt_name[0] = 0;
-    r = scan_dir(super_run_spool_path, pkt_name, sizeof(pkt_name));
+    if (sched) {
+      r = super_run_sched_next(sched, pkt_name, sizeof(pkt_name));
+    } else {
+      r = scan_dir(super_run_spool_path, pkt_name, sizeof(pkt_name));
+    }
     if (r < 0) {
       err("scan_dir failed for %s, waiting...", super_run_spool_path);
 
@@ -431,8 +452,13 @@ do_loop(
     }
 
     r = handle_packet(state, pkt_name);
+    cpu_slot_release(cpu_slots);
     if (!r) {
-      scan_dir_add_ignored(super_run_spool_path, pkt_name);
+      if (sched) {
+        super_run_sched_ignore(sched, pkt_name);
+      } else {
+        scan_dir_add_ignored(super_run_spool_path, pkt_name);
+      }
     }
   }
 
@@ -456,7 +482,8 @@ write_help(void)
          "    -i CNTS:PROB ignore specified problem\n"
          "    -p DIR       specify alternate name for super-run directory\n"
          "    -a           write log file to an alternate location\n"
-         "    -m DIR       specify a directory for file mirroring",
+         "    -m DIR       specify a directory for file mirroring\n"
+         "    -w N         run N worker processes (invoker mode)",
          program_name, program_name);
   exit(0);
 }
@@ -476,8 +503,13 @@ create_directories(void)
            super_run_path, "queue");
   snprintf(super_run_exe_path, sizeof(super_run_exe_path), "%s/var/%s",
            super_run_path, "exe");
+  snprintf(super_run_sched_path, sizeof(super_run_sched_path), "%s/var/%s",
+           super_run_path, SUPER_RUN_SCHED_STAT_DIR);
+  snprintf(super_run_slots_path, sizeof(super_run_slots_path), "%s/var/%s",
+           super_run_path, "slots");
   os_MakeDirPath(super_run_spool_path, 0777);
   os_MakeDirPath(super_run_exe_path, 0777);
+  os_MakeDirPath(super_run_sched_path, 0777);
   make_all_dir(super_run_spool_path, 0777);
 }
 
@@ -852,6 +884,96 @@ remove_if_upgrade_needed(const unsigned char *path)
   }
 }
 
+/* the body of a worker process in the invoker mode */
+static int
+run_worker(serve_state_t state, int worker_num)
+{
+  int retval = 0;
+
+  // each worker prefers its own slot
+  if (cpu_slots) cpu_slots->last_slot = worker_num % cpu_slots->slot_count;
+
+  if (create_working_directories(state) < 0) {
+    return 1;
+  }
+  sched = super_run_sched_create(ejudge_config, host_names,
+                                 super_run_spool_path, super_run_sched_path);
+  info("worker %d started", worker_num);
+  if (do_loop(state) < 0) {
+    retval = 1;
+  }
+  sched = super_run_sched_free(sched);
+  cpu_slots = cpu_slot_table_free(cpu_slots);
+  remove_working_directory(state);
+  info("worker %d finished", worker_num);
+  return retval;
+}
+
+/* the invoker mode: start the workers and restart them, if they die */
+static int
+run_invoker(serve_state_t state, int worker_count)
+{
+  int *pids = NULL;
+  time_t *start_times = NULL;
+  int i, pid, status;
+  time_t cur_time;
+
+  XCALLOC(pids, worker_count);
+  XCALLOC(start_times, worker_count);
+
+  interrupt_init();
+  interrupt_disable();
+
+  while (1) {
+    if (interrupt_get_status() || interrupt_restart_requested()) break;
+
+    cur_time = time(NULL);
+    for (i = 0; i < worker_count; ++i) {
+      if (pids[i] > 0) continue;
+      // do not restart a crashing worker too often
+      if (start_times[i] > 0 && start_times[i] + 10 > cur_time) continue;
+      start_times[i] = cur_time;
+      if ((pid = fork()) < 0) {
+        err("fork failed: %s", os_ErrorMsg());
+        continue;
+      }
+      if (!pid) {
+        _exit(run_worker(state, i));
+      }
+      pids[i] = pid;
+      info("worker %d started as process %d", i, pid);
+    }
+
+    interrupt_enable();
+    os_Sleep(1000);
+    interrupt_disable();
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (i = 0; i < worker_count && pids[i] != pid; ++i);
+      if (i >= worker_count) continue;
+      pids[i] = 0;
+      if (WIFSIGNALED(status)) {
+        err("worker %d (process %d) terminated by signal %d",
+            i, pid, WTERMSIG(status));
+      } else {
+        info("worker %d (process %d) exited with code %d",
+             i, pid, WEXITSTATUS(status));
+      }
+    }
+  }
+
+  for (i = 0; i < worker_count; ++i) {
+    if (pids[i] > 0) kill(pids[i], SIGTERM);
+  }
+  for (i = 0; i < worker_count; ++i) {
+    if (pids[i] > 0) waitpid(pids[i], &status, 0);
+  }
+
+  xfree(pids);
+  xfree(start_times);
+  return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -865,6 +987,11 @@ main(int argc, char *argv[])
   int retval = 0;
   int daemon_mode = 0, restart_mode = 0, alternate_log_mode = 0;
   const unsigned char *user = NULL, *group = NULL, *workdir = NULL;
+  int worker_count = 0, cpus_per_slot = 0, n;
+  const unsigned char *cpu_slots_spec = NULL;
+  const unsigned char *cgroup_root = NULL;
+  const unsigned char *cgroup_memory_max = NULL;
+  size_t cgroup_memory_size = 0;
 
   signal(SIGPIPE, SIG_IGN);
 
@@ -924,6 +1051,14 @@ main(int argc, char *argv[])
       argv_restart[argc_restart++] = argv[cur_arg];
       argv_restart[argc_restart++] = argv[cur_arg + 1];
       cur_arg += 2;
+    } else if (!strcmp(argv[cur_arg], "-w")) {
+      if (cur_arg + 1 >= argc) fatal("argument expected for -w");
+      if (sscanf(argv[cur_arg + 1], "%d%n", &worker_count, &n) != 1
+          || argv[cur_arg + 1][n] || worker_count <= 0 || worker_count > 128)
+        fatal("invalid argument for -w: '%s'", argv[cur_arg + 1]);
+      argv_restart[argc_restart++] = argv[cur_arg];
+      argv_restart[argc_restart++] = argv[cur_arg + 1];
+      cur_arg += 2;
     } else if (!strcmp(argv[cur_arg], "-i")) {
       if (cur_arg + 1 >= argc) fatal("argument expected for -i");
       if (parse_ignored_problem(argv[cur_arg + 1], &ignored_problems[ignored_problems_count++]) < 0) {
@@ -974,6 +1109,16 @@ main(int argc, char *argv[])
   if (parallelism <= 0 || parallelism > 128) {
     fatal("invalid value of parallelism host option");
   }
+  if (worker_count <= 0) {
+    worker_count = ejudge_cfg_get_host_option_int(ejudge_config, host_names, "invoker_workers", 1, 0);
+    if (worker_count <= 0 || worker_count > 128) {
+      fatal("invalid value of invoker_workers host option");
+    }
+  }
+  cpus_per_slot = ejudge_cfg_get_host_option_int(ejudge_config, host_names, "cpus_per_slot", 0, -1);
+  if (cpus_per_slot < 0) {
+    fatal("invalid value of cpus_per_slot host option");
+  }
 
   if ((pid_count = start_find_all_processes("ej-super-run", &pids)) < 0) {
     fatal("cannot get the list of processes");
@@ -1050,20 +1195,66 @@ main(int argc, char *argv[])
     }
   }
 
+  fprintf(stderr, "%s %s, compiled %s\n", program_name, compile_version, compile_date);
+
+  cpu_slots_spec = ejudge_cfg_get_host_option(ejudge_config, host_names, "cpu_slots");
+  if ((cpu_slots_spec && *cpu_slots_spec) || cpus_per_slot > 0) {
+    if (!(cpu_slots = cpu_slot_table_create(super_run_slots_path, os_NodeName(),
+                                            cpu_slots_spec, cpus_per_slot))) {
+      retval = 1;
+      goto cleanup;
+    }
+    info("%d CPU slots are available on this host", cpu_slots->slot_count);
+  }
+
+  cgroup_root = ejudge_cfg_get_host_option(ejudge_config, host_names, "cgroup_root");
+  if (cgroup_root && *cgroup_root) {
+    if (task_SetCgroupRoot(cgroup_root) < 0) {
+      err("cgroup %s is not usable, /proc polling is used", cgroup_root);
+    } else {
+      info("tested programs run in cgroups under %s", cgroup_root);
+    }
+    // the memory.max of the cgroups is not derived from max_vm_size,
+    // it also counts the page cache and ends with an OOM kill
+    cgroup_memory_max = ejudge_cfg_get_host_option(ejudge_config, host_names, "cgroup_memory_max");
+    if (cgroup_memory_max && *cgroup_memory_max) {
+      if (size_str_to_size_t(cgroup_memory_max, &cgroup_memory_size) < 0) {
+        err("invalid cgroup_memory_max %s", cgroup_memory_max);
+      } else {
+        task_SetCgroupMemoryLimit(cgroup_memory_size);
+        info("memory of each tested program is limited to %s", cgroup_memory_max);
+      }
+    }
+  }
+
+  if (worker_count > 1) {
+    if (run_invoker(state, worker_count) < 0) {
+      retval = 1;
+    }
+    cpu_slots = cpu_slot_table_free(cpu_slots);
+    if (interrupt_restart_requested()) start_restart();
+    return retval;
+  }
+
   if (create_working_directories(state) < 0) {
     retval = 1;
     goto cleanup;
   }
 
-  fprintf(stderr, "%s %s, compiled %s\n", program_name, compile_version, compile_date);
+  sched = super_run_sched_create(ejudge_config, host_names,
+                                 super_run_spool_path, super_run_sched_path);
 
   if (do_loop(state) < 0) {
     retval = 1;
   }
 
+  sched = super_run_sched_free(sched);
+  cpu_slots = cpu_slot_table_free(cpu_slots);
   if (interrupt_restart_requested()) start_restart();
 
 cleanup:
+  sched = super_run_sched_free(sched);
+  cpu_slots = cpu_slot_table_free(cpu_slots);
   remove_working_directory(state);
   return retval;
 }
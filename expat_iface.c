@@ -1,7 +1,7 @@
 /* -*- mode: c -*- */
 /* $Id: expat_iface.c 6500 2011-10-29 14:03:52Z cher $ */
 
-/* Copyright (C) 2002-2011 Alexander Chernov <cher@ejudge.ru> */
+/* Copyright (C) 2002-2013 Alexander Chernov <cher@ejudge.ru> */
 
 /*
  * This program is free software; you can redistribute it and/or modify
@@ -25,6 +25,7 @@
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
+#include "reuse_mempage.h"
 
 #include <expat.h>
 
@@ -52,6 +53,19 @@ struct tag_list
   struct xml_tree *tree;
 };
 
+/*
+ * The memory of a whole document. The element and attribute names
+ * of the generic nodes are stored once per arena.
+ */
+struct xml_arena
+{
+  tPageDesc *mem;
+  char *empty_str;
+  size_t name_size;             // power of 2
+  size_t name_used;
+  char **names;
+};
+
 struct parser_data
 {
   int nest;
@@ -60,11 +74,13 @@ struct parser_data
   int verbatim_nest;
   int skip_stop;
   struct tag_list *tag_stack;
+  struct tag_list *free_tags;   // released tag_list entries with buffers
   int err_cntr;
   struct xml_tree *tree;
   const struct xml_parse_spec *spec;
   iconv_t conv_hnd;
   FILE *log_f;
+  struct xml_arena *arena;      // NULL, if the tree is on the heap
 };
 
 #if CONF_ICONV_NEEDS_CONST - 0 == 1
@@ -272,23 +288,188 @@ convert_utf8_to_local(iconv_t hnd,
   }
 }
 
+struct xml_arena *
+xml_arena_create(void)
+{
+  struct xml_arena *arena;
+
+  XCALLOC(arena, 1);
+  arena->mem = pgCreate(65536);
+  arena->empty_str = pgStrdup(arena->mem, "");
+  return arena;
+}
+
+struct xml_arena *
+xml_arena_free(struct xml_arena *arena)
+{
+  if (!arena) return 0;
+  pgDestroy(arena->mem);
+  xfree(arena->names);
+  xfree(arena);
+  return 0;
+}
+
+void *
+xml_arena_alloc(struct xml_arena *arena, size_t size)
+{
+  if (!size) size = 1;
+  return pgCalloc(arena->mem, 1, size);
+}
+
+char *
+xml_arena_strdup(struct xml_arena *arena, const char *str)
+{
+  if (!str || !*str) return arena->empty_str;
+  return pgStrdup(arena->mem, str);
+}
+
+static unsigned
+name_hash(const unsigned char *str)
+{
+  unsigned h = 0;
+
+  for (; *str; ++str) h = h * 31 + *str;
+  return h;
+}
+
+/* returns the only copy of the name in the arena */
+static char *
+arena_intern(struct xml_arena *arena, const char *str)
+{
+  size_t i, new_size;
+  char **new_names;
+
+  if (arena->name_used * 2 >= arena->name_size) {
+    new_size = arena->name_size * 2;
+    if (!new_size) new_size = 64;
+    XCALLOC(new_names, new_size);
+    for (i = 0; i < arena->name_size; ++i) {
+      const char *s = arena->names[i];
+      size_t j;
+      if (!s) continue;
+      for (j = name_hash(s) & (new_size - 1); new_names[j];
+           j = (j + 1) & (new_size - 1));
+      new_names[j] = arena->names[i];
+    }
+    xfree(arena->names);
+    arena->names = new_names;
+    arena->name_size = new_size;
+  }
+
+  for (i = name_hash(str) & (arena->name_size - 1); arena->names[i];
+       i = (i + 1) & (arena->name_size - 1)) {
+    if (!strcmp(arena->names[i], str)) return arena->names[i];
+  }
+  arena->names[i] = pgStrdup(arena->mem, str);
+  arena->name_used++;
+  return arena->names[i];
+}
+
+static char *
+pd_strdup(struct parser_data *pd, const unsigned char *str, size_t len)
+{
+  if (!pd->arena) return xmemdup(str, len);
+  if (!len) return pd->arena->empty_str;
+  return pgMemdup(pd->arena->mem, str, len);
+}
+
+static char *
+pd_name(struct parser_data *pd, const unsigned char *str)
+{
+  if (!pd->arena) return xstrdup(str);
+  return arena_intern(pd->arena, str);
+}
+
+static struct xml_tree *
+pd_elem_alloc(struct parser_data *pd, int tag, int generic_flag)
+{
+  size_t size = sizeof(struct xml_tree);
+
+  if (!pd->arena) {
+    if (generic_flag)
+      return xcalloc(1, sizeof(struct xml_tree) + sizeof(char*));
+    if (pd->spec->elem_alloc)
+      return (struct xml_tree*) (*pd->spec->elem_alloc)(tag);
+    return xml_elem_alloc(tag, pd->spec->elem_sizes);
+  }
+  if (generic_flag) size += sizeof(char*);
+  else if (pd->spec->elem_sizes && pd->spec->elem_sizes[tag])
+    size = pd->spec->elem_sizes[tag];
+  return (struct xml_tree*) pgCalloc(pd->arena->mem, 1, size);
+}
+
+static struct xml_attr *
+pd_attr_alloc(struct parser_data *pd, int tag, int generic_flag)
+{
+  size_t size = sizeof(struct xml_attr);
+
+  if (!pd->arena) {
+    if (generic_flag)
+      return xcalloc(1, sizeof(struct xml_attr) + sizeof(char*));
+    if (pd->spec->attr_alloc)
+      return (struct xml_attr*) (*pd->spec->attr_alloc)(tag);
+    return xml_attr_alloc(tag, pd->spec->attr_sizes);
+  }
+  if (generic_flag) size += sizeof(char*);
+  else if (pd->spec->attr_sizes && pd->spec->attr_sizes[tag])
+    size = pd->spec->attr_sizes[tag];
+  return (struct xml_attr*) pgCalloc(pd->arena->mem, 1, size);
+}
+
 static unsigned char *
-convert_utf8_to_local_heap(iconv_t hnd, const unsigned char *str)
+convert_utf8_to_local_heap(struct parser_data *pd, const unsigned char *str)
 {
   size_t inlen, buflen, convlen;
   unsigned char *buf = 0;
+  const unsigned char *p;
 
   if (!str) str = "";
-  if (!*str) return xstrdup("");
+  if (!*str) return pd_strdup(pd, "", 0);
+
+  // the plain ASCII text is the same in every local charset
+  for (p = str; *p && *p < 0x80; ++p);
+  inlen = (p - str) + strlen(p);
+  if (!*p) return pd_strdup(pd, str, inlen);
 
-  inlen = strlen(str);
   // be very pessimistic about the string size :-(
   buflen = 4 * inlen + 16;
   buf = alloca(buflen);
-  convlen = convert_utf8_to_local(hnd, str, inlen, buf, buflen);
+  convlen = convert_utf8_to_local(pd->conv_hnd, str, inlen, buf, buflen);
   ASSERT(convlen < buflen);
   buf[convlen] = 0;
-  return xstrdup(buf);
+  return pd_strdup(pd, buf, convlen);
+}
+
+static struct tag_list *
+tag_list_get(struct parser_data *pd)
+{
+  struct tag_list *tl;
+
+  if (!(tl = pd->free_tags)) return (struct tag_list*) xcalloc(1, sizeof(*tl));
+  pd->free_tags = tl->next;
+  tl->next = 0;
+  tl->itag = 0;
+  tl->tree = 0;
+  tl->u = 0;
+  if (tl->str) tl->str[0] = 0;
+  return tl;
+}
+
+static void
+free_tag_lists(struct parser_data *pd)
+{
+  struct tag_list *tl;
+
+  while ((tl = pd->tag_stack)) {
+    pd->tag_stack = tl->next;
+    xfree(tl->str);
+    xfree(tl);
+  }
+  while ((tl = pd->free_tags)) {
+    pd->free_tags = tl->next;
+    xfree(tl->str);
+    xfree(tl);
+  }
 }
 
 static int
@@ -369,10 +550,7 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
 
   if (pd->verbatim && pd->spec->text_elem > 0
       && (tl = pd->tag_stack) && tl->str && *tl->str) {
-    if (pd->spec->elem_alloc)
-      new_node = (struct xml_tree*)(*pd->spec->elem_alloc)(pd->spec->text_elem);
-    else
-      new_node = xml_elem_alloc(pd->spec->text_elem, pd->spec->elem_sizes);
+    new_node = pd_elem_alloc(pd, pd->spec->text_elem, 0);
 
     new_node->tag = pd->spec->text_elem;
     new_node->line = XML_GetCurrentLineNumber(p);
@@ -386,7 +564,7 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
     } else {
       parent_node->first_down = parent_node->last_down = new_node;
     }
-    new_node->text = convert_utf8_to_local_heap(pd->conv_hnd, tl->str);
+    new_node->text = convert_utf8_to_local_heap(pd, tl->str);
     tl->u = 0;
     tl->str[0] = 0;
     //free(tl->str); tl->str = 0;
@@ -419,18 +597,13 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
     }
   }
 
-  if (generic_flag)
-    new_node = (struct xml_tree*) xcalloc(1, sizeof(struct xml_tree) + sizeof(char*));
-  else if (pd->spec->elem_alloc)
-    new_node = (struct xml_tree*) (*pd->spec->elem_alloc)(itag);
-  else
-    new_node = xml_elem_alloc(itag, pd->spec->elem_sizes);
+  new_node = pd_elem_alloc(pd, itag, generic_flag);
 
   new_node->tag = itag;
   new_node->line = XML_GetCurrentLineNumber(p);
   new_node->column = XML_GetCurrentColumnNumber(p);
   if (generic_flag) {
-    new_node->name[0] = xstrdup(cur_tag);
+    new_node->name[0] = pd_name(pd, cur_tag);
   }
   if (pd->tag_stack) {
     parent_node = pd->tag_stack->tree;
@@ -449,7 +622,7 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
   while (*atts) {
     /* it is safe to preserve the attribute name in the UTF-8 */
     cur_attr = (const unsigned char*) atts[0];
-    cur_val = convert_utf8_to_local_heap(pd->conv_hnd, atts[1]);
+    cur_val = convert_utf8_to_local_heap(pd, atts[1]);
 
     generic_flag = 0;
     if (pd->verbatim) {
@@ -462,7 +635,8 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
         parse_err(pd, "unknown attribute <%s> at line %ld", cur_attr, (long) XML_GetCurrentLineNumber(p));
         pd->err_cntr++;
         atts += 2;
-        xfree(cur_val); cur_val = 0;
+        if (!pd->arena) xfree(cur_val);
+        cur_val = 0;
         continue;
       }
     } else {
@@ -476,25 +650,21 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
           parse_err(pd, "unknown attribute <%s> at line %ld", cur_attr, (long) XML_GetCurrentLineNumber(p));
           pd->err_cntr++;
           atts += 2;
-          xfree(cur_val); cur_val = 0;
+          if (!pd->arena) xfree(cur_val);
+          cur_val = 0;
           continue;
         }
       }
     }
 
-    if (generic_flag)
-      new_attr = (struct xml_attr*) xcalloc(1, sizeof(struct xml_attr) + sizeof(char*));
-    else if (pd->spec->attr_alloc)
-      new_attr = (struct xml_attr*) (*pd->spec->attr_alloc)(iattr);
-    else
-      new_attr = xml_attr_alloc(iattr, pd->spec->attr_sizes);
+    new_attr = pd_attr_alloc(pd, iattr, generic_flag);
 
     new_attr->tag = iattr;
     new_attr->text = cur_val;
     new_attr->line = XML_GetCurrentLineNumber(p);
     new_attr->column = XML_GetCurrentColumnNumber(p);
     if (generic_flag) {
-      new_attr->name[0] = xstrdup(cur_attr);
+      new_attr->name[0] = pd_name(pd, cur_attr);
     }
     if (!new_node->first) {
       new_node->first = new_node->last = new_attr;
@@ -506,7 +676,7 @@ start_hnd(void *data, const XML_Char *name, const XML_Char **atts)
     atts += 2;
   }
 
-  tl = (struct tag_list*) xcalloc(1, sizeof(*tl));
+  tl = tag_list_get(pd);
   tl->itag = itag;
   tl->next = pd->tag_stack;
   tl->tree = new_node;
@@ -544,9 +714,10 @@ end_hnd(void *data, const XML_Char *name)
   tl = pd->tag_stack;
   pd->tag_stack = tl->next;
   pd->nest--;
-  tl->tree->text = convert_utf8_to_local_heap(pd->conv_hnd, tl->str);
-  free(tl->str); tl->str = 0;
-  free(tl);
+  tl->tree->text = convert_utf8_to_local_heap(pd, tl->str);
+  // keep the text buffer for the next element
+  tl->next = pd->free_tags;
+  pd->free_tags = tl;
 
   if (pd->verbatim) pd->verbatim_nest--;
   if (pd->verbatim && pd->verbatim_nest < 0) {
@@ -573,10 +744,12 @@ chardata_hnd(void *data, const XML_Char *s, int len)
     }
   }
   
-  if (!pd->tag_stack->a) pd->tag_stack->a = 32;
-  while (pd->tag_stack->u + len >= pd->tag_stack->a)
-    pd->tag_stack->a *= 2;
-  pd->tag_stack->str = (char*) xrealloc(pd->tag_stack->str, pd->tag_stack->a);
+  if (!pd->tag_stack->str || pd->tag_stack->u + len >= pd->tag_stack->a) {
+    if (!pd->tag_stack->a) pd->tag_stack->a = 32;
+    while (pd->tag_stack->u + len >= pd->tag_stack->a)
+      pd->tag_stack->a *= 2;
+    pd->tag_stack->str = (char*) xrealloc(pd->tag_stack->str, pd->tag_stack->a);
+  }
   memmove(pd->tag_stack->str + pd->tag_stack->u, s, len);
   pd->tag_stack->u += len;
   pd->tag_stack->str[pd->tag_stack->u] = 0;
@@ -633,56 +806,69 @@ xml_skipped_entity_handler(
   pd->tag_stack->str[pd->tag_stack->u] = 0;
 }
 
-struct xml_tree *
-xml_build_tree(FILE *log_f, char const *path, const struct xml_parse_spec *spec)
+static XML_Parser
+create_parser(struct parser_data *data)
 {
-  XML_Parser p = 0;
-  FILE *f = 0;
-  char buf[512];
-  int len;
-  iconv_t conv_hnd = 0;
-  struct parser_data data;
-
-  memset(&data, 0, sizeof(data));
-  data.log_f = log_f;
-  ASSERT(path);
-  ASSERT(spec);
-
-  if (!(conv_hnd = iconv_open(EJUDGE_CHARSET, "UTF-8"))) {
-    parse_err(&data, "no conversion is possible from UTF-8 to %s", EJUDGE_CHARSET);
-    goto cleanup_and_exit;
-  }
+  XML_Parser p;
+  iconv_t conv_hnd;
 
-  if (!(f = fopen(path, "r"))) {
-    parse_err(&data, "cannot open input file `%s'", path);
-    goto cleanup_and_exit;
+  if ((conv_hnd = iconv_open(EJUDGE_CHARSET, "UTF-8")) == (iconv_t) -1) {
+    parse_err(data, "no conversion is possible from UTF-8 to %s", EJUDGE_CHARSET);
+    return 0;
   }
-
   if (!(p = XML_ParserCreate(NULL))) {
-    parse_err(&data, "cannot create an XML parser");
-    goto cleanup_and_exit;
+    parse_err(data, "cannot create an XML parser");
+    iconv_close(conv_hnd);
+    return 0;
   }
 
   XML_SetUnknownEncodingHandler(p, encoding_hnd, NULL);
   XML_SetStartElementHandler(p, start_hnd);
   XML_SetEndElementHandler(p, end_hnd);
   XML_SetCharacterDataHandler(p, chardata_hnd);
-  XML_SetUserData(p, &data);
+  XML_SetUserData(p, data);
   XML_UseParserAsHandlerArg(p);
-  if (spec->unparse_entity) {
+  if (data->spec->unparse_entity) {
     //XML_SetDefaultHandler(p, xml_default_handler);
     XML_UseForeignDTD(p, 1);
     XML_SetSkippedEntityHandler(p, xml_skipped_entity_handler);
   }
+  data->conv_hnd = conv_hnd;
+  return p;
+}
 
+/* parses the file `f', `path' is used for the diagnostics only */
+static struct xml_tree *
+build_tree_file(
+        FILE *log_f,
+        FILE *f,
+        const unsigned char *path,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena)
+{
+  XML_Parser p = 0;
+  char buf[16384];
+  size_t len;
+  struct parser_data data;
+
+  memset(&data, 0, sizeof(data));
+  data.log_f = log_f;
   data.spec = spec;
-  data.conv_hnd = conv_hnd;
+  data.arena = arena;
+
+  if (!(p = create_parser(&data))) goto cleanup_and_exit;
 
-  while (fgets(buf, sizeof(buf), f)) {
-    len = strlen(buf);
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
     if (XML_Parse(p, buf, len, 0) == XML_STATUS_ERROR) {
-      parse_err(&data, "%s: %ld: parse error: %s", path, (long) XML_GetCurrentLineNumber(p),
-                XML_ErrorString(XML_GetErrorCode(p)));
+      if (path) {
+        parse_err(&data, "%s: %ld: parse error: %s", path,
+                  (long) XML_GetCurrentLineNumber(p),
+                  XML_ErrorString(XML_GetErrorCode(p)));
+      } else {
+        parse_err(&data, "%ld: parse error: %s",
+                  (long) XML_GetCurrentLineNumber(p),
+                  XML_ErrorString(XML_GetErrorCode(p)));
+      }
       goto cleanup_and_exit;
     }
   }
@@ -694,58 +880,38 @@ xml_build_tree(FILE *log_f, char const *path, const struct xml_parse_spec *spec)
   if (data.err_cntr) goto cleanup_and_exit;
 
   XML_ParserFree(p);
-  fclose(f);
-  iconv_close(conv_hnd);
+  iconv_close(data.conv_hnd);
+  free_tag_lists(&data);
   return data.tree;
 
  cleanup_and_exit:
-  if (conv_hnd) iconv_close(conv_hnd);
-  if (p) XML_ParserFree(p);
-  if (f) fclose(f);
-  if (data.tree) xml_tree_free(data.tree, spec);
+  if (p) {
+    XML_ParserFree(p);
+    iconv_close(data.conv_hnd);
+  }
+  free_tag_lists(&data);
+  if (data.tree && !arena) xml_tree_free(data.tree, spec);
   return 0;
 }
 
-struct xml_tree *
-xml_build_tree_str(FILE *log_f, char const *str, const struct xml_parse_spec *spec)
+static struct xml_tree *
+build_tree_str(
+        FILE *log_f,
+        char const *str,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena)
 {
   XML_Parser p = 0;
-  int len;
-  iconv_t conv_hnd = 0;
   struct parser_data data;
 
   memset(&data, 0, sizeof(data));
   data.log_f = log_f;
-  ASSERT(str);
-  ASSERT(spec);
-  len = strlen(str);
-
-  if (!(conv_hnd = iconv_open(EJUDGE_CHARSET, "UTF-8"))) {
-    parse_err(&data, "no conversion is possible from UTF-8 to %s", EJUDGE_CHARSET);
-    goto cleanup_and_exit;
-  }
-
-  if (!(p = XML_ParserCreate(NULL))) {
-    parse_err(&data, "cannot create an XML parser");
-    goto cleanup_and_exit;
-  }
-
-  XML_SetUnknownEncodingHandler(p, encoding_hnd, NULL);
-  XML_SetStartElementHandler(p, start_hnd);
-  XML_SetEndElementHandler(p, end_hnd);
-  XML_SetCharacterDataHandler(p, chardata_hnd);
-  XML_SetUserData(p, &data);
-  XML_UseParserAsHandlerArg(p);
-  if (spec->unparse_entity) {
-    //XML_SetDefaultHandler(p, xml_default_handler);
-    XML_UseForeignDTD(p, 1);
-    XML_SetSkippedEntityHandler(p, xml_skipped_entity_handler);
-  }
-
   data.spec = spec;
-  data.conv_hnd = conv_hnd;
+  data.arena = arena;
+
+  if (!(p = create_parser(&data))) goto cleanup_and_exit;
 
-  if (XML_Parse(p, str, len, 0) == XML_STATUS_ERROR) {
+  if (XML_Parse(p, str, strlen(str), 0) == XML_STATUS_ERROR) {
     parse_err(&data, "%ld: parse error: %s", (long) XML_GetCurrentLineNumber(p),
               XML_ErrorString(XML_GetErrorCode(p)));
     goto cleanup_and_exit;
@@ -753,80 +919,80 @@ xml_build_tree_str(FILE *log_f, char const *str, const struct xml_parse_spec *sp
   if (data.err_cntr) goto cleanup_and_exit;
 
   XML_ParserFree(p);
-  iconv_close(conv_hnd);
+  iconv_close(data.conv_hnd);
+  free_tag_lists(&data);
   return data.tree;
 
  cleanup_and_exit:
-  if (conv_hnd) iconv_close(conv_hnd);
-  if (p) XML_ParserFree(p);
-  if (data.tree) xml_tree_free(data.tree, spec);
+  if (p) {
+    XML_ParserFree(p);
+    iconv_close(data.conv_hnd);
+  }
+  free_tag_lists(&data);
+  if (data.tree && !arena) xml_tree_free(data.tree, spec);
   return 0;
 }
 
 struct xml_tree *
-xml_build_tree_file(FILE *log_f, FILE *f, const struct xml_parse_spec *spec)
+xml_build_tree(FILE *log_f, char const *path, const struct xml_parse_spec *spec)
 {
-  XML_Parser p = 0;
-  char buf[512];
-  int len;
-  iconv_t conv_hnd = 0;
-  struct parser_data data;
-
-  memset(&data, 0, sizeof(data));
-  data.log_f = log_f;
-  ASSERT(spec);
+  return xml_build_tree_arena(log_f, path, spec, NULL);
+}
 
-  if (!(conv_hnd = iconv_open(EJUDGE_CHARSET, "UTF-8"))) {
-    parse_err(&data, "no conversion is possible from UTF-8 to %s", EJUDGE_CHARSET);
-    goto cleanup_and_exit;
-  }
+struct xml_tree *
+xml_build_tree_arena(
+        FILE *log_f,
+        char const *path,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena)
+{
+  FILE *f = 0;
+  struct xml_tree *tree;
 
-  if (!(p = XML_ParserCreate(NULL))) {
-    parse_err(&data, "cannot create an XML parser");
-    goto cleanup_and_exit;
-  }
+  ASSERT(path);
+  ASSERT(spec);
 
-  XML_SetUnknownEncodingHandler(p, encoding_hnd, NULL);
-  XML_SetStartElementHandler(p, start_hnd);
-  XML_SetEndElementHandler(p, end_hnd);
-  XML_SetCharacterDataHandler(p, chardata_hnd);
-  XML_SetUserData(p, &data);
-  XML_UseParserAsHandlerArg(p);
-  if (spec->unparse_entity) {
-    //XML_SetDefaultHandler(p, xml_default_handler);
-    XML_UseForeignDTD(p, 1);
-    XML_SetSkippedEntityHandler(p, xml_skipped_entity_handler);
+  if (!(f = fopen(path, "r"))) {
+    struct parser_data data;
+    memset(&data, 0, sizeof(data));
+    data.log_f = log_f;
+    parse_err(&data, "cannot open input file `%s'", path);
+    return 0;
   }
+  tree = build_tree_file(log_f, f, path, spec, arena);
+  fclose(f);
+  return tree;
+}
 
-  data.spec = spec;
-  data.conv_hnd = conv_hnd;
+struct xml_tree *
+xml_build_tree_str(FILE *log_f, char const *str, const struct xml_parse_spec *spec)
+{
+  ASSERT(str);
+  ASSERT(spec);
+  return build_tree_str(log_f, str, spec, NULL);
+}
 
-  while (fgets(buf, sizeof(buf), f)) {
-    len = strlen(buf);
-    if (XML_Parse(p, buf, len, 0) == XML_STATUS_ERROR) {
-      parse_err(&data, "%ld: parse error: %s", (long) XML_GetCurrentLineNumber(p),
-                XML_ErrorString(XML_GetErrorCode(p)));
-      goto cleanup_and_exit;
-    }
-  }
+struct xml_tree *
+xml_build_tree_str_arena(
+        FILE *log_f,
+        char const *str,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena)
+{
+  ASSERT(str);
+  ASSERT(spec);
+  return build_tree_str(log_f, str, spec, arena);
+}
 
-  if (ferror(f)) {
-    parse_err(&data, "input error");
-    goto cleanup_and_exit;
-  }
-  if (data.err_cntr) goto cleanup_and_exit;
+struct xml_tree *
+xml_build_tree_file(FILE *log_f, FILE *f, const struct xml_parse_spec *spec)
+{
+  struct xml_tree *tree;
 
-  XML_ParserFree(p);
+  ASSERT(spec);
+  tree = build_tree_file(log_f, f, NULL, spec, NULL);
   fclose(f);
-  iconv_close(conv_hnd);
-  return data.tree;
-
- cleanup_and_exit:
-  if (conv_hnd) iconv_close(conv_hnd);
-  if (p) XML_ParserFree(p);
-  if (f) fclose(f);
-  if (data.tree) xml_tree_free(data.tree, spec);
-  return 0;
+  return tree;
 }
 
 void
@@ -1159,19 +1325,14 @@ xml_parse_text(
         int root_node,
         const struct xml_parse_spec *spec)
 {
-  XML_Parser p = 0;
   int len, text_len, xml_header_len, elem_len;
-  iconv_t conv_hnd = 0;
-  struct parser_data data;
   unsigned char xml_header[1024];
   unsigned char *buf = NULL;
+  struct xml_tree *tree;
 
   if (!text) return NULL;
   if (!spec || !spec->elem_map || !spec->elem_map[root_node]) return NULL;
 
-  memset(&data, 0, sizeof(data));
-  data.log_f = log_f;
-
   text_len = strlen(text);
   snprintf(xml_header, sizeof(xml_header), "<?xml version=\"1.0\" encoding=\"%s\"?>\n", EJUDGE_CHARSET);
   xml_header_len = strlen(xml_header);
@@ -1179,51 +1340,10 @@ xml_parse_text(
   len = 1024 + text_len + xml_header_len + elem_len * 2;
   buf = (unsigned char*) xmalloc(len * sizeof(buf[0]));
   sprintf(buf, "%s<%s>%s</%s>", xml_header, spec->elem_map[root_node], text, spec->elem_map[root_node]);
-  len = strlen(buf);
 
-  if (!(conv_hnd = iconv_open(EJUDGE_CHARSET, "UTF-8"))) {
-    parse_err(&data, "no conversion is possible from UTF-8 to %s", EJUDGE_CHARSET);
-    goto cleanup_and_exit;
-  }
-
-  if (!(p = XML_ParserCreate(NULL))) {
-    parse_err(&data, "cannot create an XML parser");
-    goto cleanup_and_exit;
-  }
-
-  XML_SetUnknownEncodingHandler(p, encoding_hnd, NULL);
-  XML_SetStartElementHandler(p, start_hnd);
-  XML_SetEndElementHandler(p, end_hnd);
-  XML_SetCharacterDataHandler(p, chardata_hnd);
-  XML_SetUserData(p, &data);
-  XML_UseParserAsHandlerArg(p);
-  if (spec->unparse_entity) {
-    //XML_SetDefaultHandler(p, xml_default_handler);
-    XML_UseForeignDTD(p, 1);
-    XML_SetSkippedEntityHandler(p, xml_skipped_entity_handler);
-  }
-
-  data.spec = spec;
-  data.conv_hnd = conv_hnd;
-
-  if (XML_Parse(p, buf, len, 0) == XML_STATUS_ERROR) {
-    parse_err(&data, "%ld: parse error: %s", (long) XML_GetCurrentLineNumber(p),
-              XML_ErrorString(XML_GetErrorCode(p)));
-    goto cleanup_and_exit;
-  }
-  if (data.err_cntr) goto cleanup_and_exit;
-
-  xfree(buf); buf = NULL;
-  XML_ParserFree(p);
-  iconv_close(conv_hnd);
-  return data.tree;
-
-cleanup_and_exit:
+  tree = build_tree_str(log_f, buf, spec, NULL);
   xfree(buf);
-  if (conv_hnd) iconv_close(conv_hnd);
-  if (p) XML_ParserFree(p);
-  if (data.tree) xml_tree_free(data.tree, spec);
-  return 0;
+  return tree;
 }
 
 /*
@@ -4,7 +4,7 @@
 #ifndef __EXPAT_IFACE_H__
 #define __EXPAT_IFACE_H__ 1
 
-/* Copyright (C) 2002-2011 Alexander Chernov <cher@ejudge.ru> */
+/* Copyright (C) 2002-2013 Alexander Chernov <cher@ejudge.ru> */
 
 /*
  * This program is free software; you can redistribute it and/or modify
@@ -69,6 +69,35 @@ xml_build_tree_str(FILE *log_f, char const *str, const struct xml_parse_spec *sp
 struct xml_tree *
 xml_build_tree_file(FILE *log_f, FILE *f, const struct xml_parse_spec *spec);
 
+/*
+ * The whole document may be built in an arena: all the nodes, attributes
+ * and texts are allocated in it, and the names of the generic nodes
+ * are shared. The spec->elem_alloc, attr_alloc, elem_free, attr_free
+ * are not used, the sizes are taken from spec->elem_sizes, attr_sizes.
+ * Such a tree must not be freed with xml_tree_free, and the texts must
+ * not be moved out of it. The tree is released with the arena.
+ */
+struct xml_arena;
+
+struct xml_arena *xml_arena_create(void);
+struct xml_arena *xml_arena_free(struct xml_arena *arena);
+/* the memory is zero-filled and released with the arena */
+void *xml_arena_alloc(struct xml_arena *arena, size_t size);
+char *xml_arena_strdup(struct xml_arena *arena, const char *str);
+
+struct xml_tree *
+xml_build_tree_arena(
+        FILE *log_f,
+        char const *path,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena);
+struct xml_tree *
+xml_build_tree_str_arena(
+        FILE *log_f,
+        char const *str,
+        const struct xml_parse_spec *spec,
+        struct xml_arena *arena);
+
 struct xml_tree *
 xml_tree_free(struct xml_tree *tree, const struct xml_parse_spec *spec);
 void xml_tree_free_attrs(struct xml_tree *tree,
@@ -25,6 +25,9 @@
 int   scan_dir(char const *dir, char *result, size_t res_size);
 void  scan_dir_add_ignored(const unsigned char *dir,
                            const unsigned char *filename);
+/* the priority encoded in the first character of a packet name,
+   0 for the names of other format */
+int   scan_dir_get_priority(const unsigned char *name);
 
 int get_file_list(const char *partial_path, strarray_t *files);
 
@@ -25,6 +25,7 @@
 #include "archive_paths.h"
 #include "ej_uuid.h"
 #include "prepare_dflt.h"
+#include "run_pack.h"
 
 #include "reuse_logger.h"
 #include "reuse_mempage.h"
@@ -128,8 +129,10 @@ is_missing_source(
     return 0;
 
   if (re->store_flags == 1) {
-    if ((src_flags = uuid_archive_make_read_path(cs, src_path, sizeof(src_path),
-                                                 re->run_uuid, DFLT_R_UUID_SOURCE, 0)) < 0)
+    if ((src_flags = uuid_archive_find_read_path(cs, src_path, sizeof(src_path),
+                                                 re->run_uuid, DFLT_R_UUID_SOURCE, 0)) < 0
+        && !run_pack_exists(serve_get_run_pack(cs, 0), re->run_uuid,
+                            RUN_PACK_SOURCE))
       return 1;
   } else {
     if ((src_flags = archive_make_read_path(cs, src_path, sizeof(src_path),
@@ -9,6 +9,7 @@ extern "C" {
 #include "ejudge_cfg.h"
 #include "contests.h"
 #include "runlog.h"
+#include "runlog_reader.h"
 #include "xml_utils.h"
 #include "misctext.h"
 #include "fileutl.h"
@@ -40,6 +41,7 @@ static struct ejudge_cfg *config = nullptr;
 static int contest_id = 0;
 static const struct contest_desc *cnts = nullptr;
 static runlog_state_t runlog = nullptr;
+static struct runlog_reader reader = {};
 
 static void
 die(const char *format, ...)
@@ -109,6 +111,25 @@ make_hier_path(unsigned char *buf, size_t size,
   return snprintf(CSTR(buf), size, "%s", CSTR(tb));
 }
 
+/* the runs are read from the runlog file in place, if it is given,
+   or from the database */
+static int
+get_total_runs()
+{
+    if (reader.data) return reader.run_count;
+    return run_get_total(runlog);
+}
+
+static void
+get_run(int run_id, struct run_entry *pre)
+{
+    if (reader.data) {
+        *pre = reader.runs[run_id];
+    } else if (run_get_entry(runlog, run_id, pre) < 0) {
+        die("cannot get run entry %d", run_id);
+    }
+}
+
 string
 make_path(int contest_id, const char *dir, int run_id)
 {
@@ -167,7 +188,7 @@ main(int argc, char *argv[])
 {
     program_name = argv[0];
 
-    if (argc != 2) die("wrong number of arguments");
+    if (argc != 2 && argc != 3) die("wrong number of arguments");
 
     config = ejudge_cfg_parse(EJUDGE_XML_PATH);
     if (!config) die("invalid configuration file");
@@ -180,22 +201,25 @@ main(int argc, char *argv[])
     }
     if (contests_get(contest_id, &cnts) < 0 || !cnts) die("invalid contest_id");
 
-    runlog = run_init(0);
-    if (!runlog) die("failed to initialize runlog");
+    if (argc == 3) {
+        int r = runlog_reader_open(&reader, USTR(argv[2]));
+        if (r < 0) die("cannot open %s: %s", argv[2], strerror(-r));
+    } else {
+        runlog = run_init(0);
+        if (!runlog) die("failed to initialize runlog");
 
-    if (run_open(runlog, config, cnts, 0, USTR("mysql"), 0, 0, 0, 0) < 0)
-        die("cannot open the runlog");
+        if (run_open(runlog, config, cnts, 0, USTR("mysql"), 0, 0, 0, 0) < 0)
+            die("cannot open the runlog");
+    }
 
-    int total_runs = run_get_total(runlog);
+    int total_runs = get_total_runs();
 
     map<string, set<int> > shamap;
     vector<string> dbshas(total_runs);
 
     for (int run_id = 0; run_id < total_runs; ++run_id) {
         struct run_entry re = {};
-        if (run_get_entry(runlog, run_id, &re) < 0) {
-            die("cannot get run entry %d", run_id);
-        }
+        get_run(run_id, &re);
         if (re.status == RUN_EMPTY || re.status == RUN_VIRTUAL_START || re.status == RUN_VIRTUAL_STOP) continue;
         if (re.sha1[0] == 0 && re.sha1[1] == 0 && re.sha1[2] == 0 && re.sha1[3] == 0 && re.sha1[4] == 0) {
             die("sha1 is NULL for %d", run_id);
@@ -260,9 +284,7 @@ main(int argc, char *argv[])
     for (int run_id = 0; run_id < total_runs; ++run_id) {
         restore_run_id[run_id] = -1;
         struct run_entry re = {};
-        if (run_get_entry(runlog, run_id, &re) < 0) {
-            die("cannot get run entry %d", run_id);
-        }
+        get_run(run_id, &re);
         if (re.status == RUN_EMPTY || re.status == RUN_VIRTUAL_START
             || re.status == RUN_VIRTUAL_STOP) continue;
         if (dbshas[run_id] == flshas[run_id]) continue;
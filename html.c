@@ -41,6 +41,7 @@
 #include "charsets.h"
 #include "compat.h"
 #include "filter_eval.h"
+#include "stand_timeline.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -237,33 +238,25 @@ calc_kirov_score(
   }
 }
 
+/* decides, what is shown in the test and score cells of the run table */
 void
-write_html_run_status(
+get_run_status_cells(
         const serve_state_t state,
-        FILE *f,
-        time_t start_time,
         const struct run_entry *pe,
         int user_mode, /* works for separate_user_score */
         int priv_level,
-        int attempts,
-        int disq_attempts,
-        int prev_successes,
-        const unsigned char *td_class,
         int disable_failed,
-        int enable_js_status_menu,
-        int run_fields)
+        int *p_status,
+        int *p_test_cell,
+        int *p_test,
+        int *p_score_cell,
+        int *p_score)
 {
   const struct section_global_data *global = state->global;
-  unsigned char status_str[128], score_str[128];
-  struct section_problem_data *pr = 0;
-  int need_extra_col = 0;
-  unsigned char cl[128] = { 0 };
   int status, score, test;
+  int need_extra_col = 0;
   int separate_user_score = 0;
-
-  if (td_class && *td_class) {
-    snprintf(cl, sizeof(cl), " class=\"%s\"", td_class);
-  }
+  int test_cell = RUN_CELL_NA, score_cell = RUN_CELL_NA;
 
   separate_user_score = global->separate_user_score > 0 && state->online_view_judge_score <= 0;
   if (separate_user_score > 0 && pe->is_saved && user_mode) {
@@ -275,18 +268,9 @@ write_html_run_status(
     score = pe->score;
     test = pe->test;
   }
-
-  if (pe->prob_id > 0 && pe->prob_id <= state->max_prob && state->probs)
-    pr = state->probs[pe->prob_id];
-  run_status_str(status, status_str, sizeof(status_str),
-                 pr?pr->type:0, pr?pr->scoring_checker:0);
-  if (run_fields & (1 << RUN_VIEW_STATUS)) {
-    if (enable_js_status_menu) {
-      fprintf(f, "<td%s><a href=\"javascript:ej_stat(%d)\">%s</a><div class=\"ej_dd\" id=\"ej_dd_%d\"></div></td>", cl, pe->run_id, status_str, pe->run_id);
-    } else {
-      fprintf(f, "<td%s>%s</td>", cl, status_str);
-    }
-  }
+  *p_status = status;
+  *p_test = test;
+  *p_score = score;
 
   if (global->score_system == SCORE_KIROV
       || global->score_system == SCORE_OLYMPIAD
@@ -294,31 +278,21 @@ write_html_run_status(
     need_extra_col = 1;
 
   if (status >= RUN_PSEUDO_FIRST && status <= RUN_PSEUDO_LAST) {
-    if (run_fields & (1 << RUN_VIEW_TEST)) {
-        fprintf(f, "<td%s>&nbsp;</td>", cl);
-      }
-    if (need_extra_col && run_fields & (1 << RUN_VIEW_SCORE)) {
-      fprintf(f, "<td%s>&nbsp;</td>", cl);
-    }
-    return;
+    test_cell = RUN_CELL_EMPTY;
+    score_cell = RUN_CELL_EMPTY;
+    goto done;
   } else if (status < 0 || status > RUN_MAX_STATUS) {
-    if (run_fields & (1 << RUN_VIEW_TEST)) {
-      fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-    }
-    if (need_extra_col && run_fields & (1 << RUN_VIEW_SCORE)) {
-      fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-    }
-    return;
+    goto done;
   }
 
   switch (status) {
   case RUN_CHECK_FAILED:
     if (priv_level > 0) break;
-    goto dona;
+    goto done;
   case RUN_OK:
     if (global->score_system == SCORE_KIROV
         || global->score_system == SCORE_OLYMPIAD) break;
-    goto dona;
+    goto done;
     //case RUN_ACCEPTED:
     //case RUN_PENDING_REVIEW:
   case RUN_IGNORED:
@@ -327,114 +301,135 @@ write_html_run_status(
   case RUN_COMPILE_ERR:
   case RUN_STYLE_ERR:
   case RUN_REJECTED:
-  dona:
-    if (run_fields & (1 << RUN_VIEW_TEST)) {
-      fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
+    goto done;
+  }
+
+  if (global->score_system == SCORE_ACM
+      || global->score_system == SCORE_MOSCOW) {
+    if (pe->passed_mode > 0) {
+      // if passed_mode is set, in 'test' the number of ok tests is stored
+      // add +1 for compatibility, until the legend is updated
+      ++test;
     }
-    if (need_extra_col && run_fields & (1 << RUN_VIEW_SCORE)) {
-      fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
+    if (global->score_system == SCORE_ACM && disable_failed) {
+      test_cell = RUN_CELL_EMPTY;
+    } else if (status == RUN_OK || status == RUN_ACCEPTED || status == RUN_PENDING_REVIEW || test <= 0
+               || global->disable_failed_test_view > 0) {
+      test_cell = RUN_CELL_NA;
+    } else {
+      test_cell = RUN_CELL_VALUE;
     }
-    return;
+    *p_test = test;
+    if (global->score_system == SCORE_MOSCOW) score_cell = RUN_CELL_VALUE;
+    goto done;
   }
 
-  if (global->score_system == SCORE_ACM) {
-    if (run_fields & (1 << RUN_VIEW_TEST)) {
-      if (pe->passed_mode > 0) {
-        // if passed_mode is set, in 'test' the number of ok tests is stored
-        // add +1 for compatibility, until the legend is updated
-        ++test;
-      }
-      if (!disable_failed) {
-        if (status == RUN_OK || status == RUN_ACCEPTED || status == RUN_PENDING_REVIEW || test <= 0
-            || global->disable_failed_test_view > 0) {
-          fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-        } else {
-          fprintf(f, "<td%s>%d</td>", cl, test);
-        }
-      } else {
-        fprintf(f, "<td%s>&nbsp;</td>", cl);
-      }
+  if (global->score_system == SCORE_OLYMPIAD && pe->passed_mode <= 0
+      && (status == RUN_RUN_TIME_ERR
+          || status == RUN_TIME_LIMIT_ERR
+          || status == RUN_PRESENTATION_ERR
+          || status == RUN_WRONG_ANSWER_ERR
+          || status == RUN_MEM_LIMIT_ERR
+          || status == RUN_SECURITY_ERR
+          || status == RUN_WALL_TIME_LIMIT_ERR)) {
+    // we have to guess what to report: the count of passed tests
+    // or the number of the first failed test, do like ACM
+    if (test > 0) test_cell = RUN_CELL_FAILED_TEST;
+  } else if (pe->passed_mode > 0) {
+    // always report the count of passed tests
+    if (test >= 0) test_cell = RUN_CELL_VALUE;
+  } else {
+    if (test > 0) {
+      test_cell = RUN_CELL_VALUE;
+      *p_test = test - 1;
     }
-    return;
   }
 
-  if (global->score_system == SCORE_MOSCOW) {
-    if (run_fields & (1 << RUN_VIEW_TEST)) {
-      if (pe->passed_mode > 0) {
-        // if passed_mode is set, in 'test' the number of ok tests is stored
-        // add +1 for compatibility, until the legend is updated
-        ++test;
-      }
-      if (status == RUN_OK || status == RUN_ACCEPTED || status == RUN_PENDING_REVIEW || test <= 0
-          || global->disable_failed_test_view > 0) {
-        fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-      } else {
-        fprintf(f, "<td%s>%d</td>", cl, test);
-      }
-    }
-    if (run_fields & (1 << RUN_VIEW_SCORE)) {
-      if (status == RUN_OK) {
-        fprintf(f, "<td%s><b>%d</b></td>", cl, score);
-      } else {
-        fprintf(f, "<td%s>%d</td>", cl, score);
-      }
-    }
-    return;
+  if (score >= 0 && pe->prob_id > 0 && pe->prob_id <= state->max_prob
+      && state->probs && state->probs[pe->prob_id])
+    score_cell = RUN_CELL_VALUE;
+
+done:
+  if (!need_extra_col) score_cell = RUN_CELL_NONE;
+  *p_test_cell = test_cell;
+  *p_score_cell = score_cell;
+}
+
+static void
+write_html_run_cell(FILE *f, const unsigned char *cl, int cell, int value)
+{
+  switch (cell) {
+  case RUN_CELL_EMPTY:
+    fprintf(f, "<td%s>&nbsp;</td>", cl);
+    break;
+  case RUN_CELL_NA:
+    fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
+    break;
+  case RUN_CELL_VALUE:
+    fprintf(f, "<td%s>%d</td>", cl, value);
+    break;
+  case RUN_CELL_FAILED_TEST:
+    fprintf(f, "<td%s><i>%d</i></td>", cl, value);
+    break;
   }
+}
 
-  if (run_fields & (1 << RUN_VIEW_TEST)) {
-    if (global->score_system == SCORE_OLYMPIAD) {
-      if (pe->passed_mode > 0) {
-        // always report the count of passed tests
-        if (test < 0) {
-          fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-        } else {
-          fprintf(f, "<td%s>%d</td>", cl, test);
-        }
-      } else {
-        // we have to guess what to report: the count of passed tests
-        // or the number of the first failed test...
-        if (status == RUN_RUN_TIME_ERR
-            || status == RUN_TIME_LIMIT_ERR
-            || status == RUN_PRESENTATION_ERR
-            || status == RUN_WRONG_ANSWER_ERR
-            || status == RUN_MEM_LIMIT_ERR
-            || status == RUN_SECURITY_ERR
-            || status == RUN_WALL_TIME_LIMIT_ERR) {
-          // do like ACM
-          if (test <= 0) {
-            fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-          } else {
-            fprintf(f, "<td%s><i>%d</i></td>", cl, test);
-          }
-        } else {
-          if (test <= 0) {
-            fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-          } else {
-            fprintf(f, "<td%s>%d</td>", cl, test - 1);
-          }
-        }
-      }
+void
+write_html_run_status(
+        const serve_state_t state,
+        FILE *f,
+        time_t start_time,
+        const struct run_entry *pe,
+        int user_mode, /* works for separate_user_score */
+        int priv_level,
+        int attempts,
+        int disq_attempts,
+        int prev_successes,
+        const unsigned char *td_class,
+        int disable_failed,
+        int enable_js_status_menu,
+        int run_fields)
+{
+  const struct section_global_data *global = state->global;
+  unsigned char status_str[128], score_str[128];
+  struct section_problem_data *pr = 0;
+  unsigned char cl[128] = { 0 };
+  int status, score, test, test_cell, score_cell;
+  int separate_user_score = 0;
+
+  if (td_class && *td_class) {
+    snprintf(cl, sizeof(cl), " class=\"%s\"", td_class);
+  }
+
+  separate_user_score = global->separate_user_score > 0 && state->online_view_judge_score <= 0;
+  get_run_status_cells(state, pe, user_mode, priv_level, disable_failed,
+                       &status, &test_cell, &test, &score_cell, &score);
+
+  if (pe->prob_id > 0 && pe->prob_id <= state->max_prob && state->probs)
+    pr = state->probs[pe->prob_id];
+  run_status_str(status, status_str, sizeof(status_str),
+                 pr?pr->type:0, pr?pr->scoring_checker:0);
+  if (run_fields & (1 << RUN_VIEW_STATUS)) {
+    if (enable_js_status_menu) {
+      fprintf(f, "<td%s><a href=\"javascript:ej_stat(%d)\">%s</a><div class=\"ej_dd\" id=\"ej_dd_%d\"></div></td>", cl, pe->run_id, status_str, pe->run_id);
     } else {
-      if (pe->passed_mode > 0) {
-        if (test < 0) {
-          fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-        } else {
-          fprintf(f, "<td%s>%d</td>", cl, test);
-        }
-      } else {
-        if (test <= 0) {
-          fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
-        } else {
-          fprintf(f, "<td%s>%d</td>", cl, test - 1);
-        }
-      }
+      fprintf(f, "<td%s>%s</td>", cl, status_str);
     }
   }
 
+  if (run_fields & (1 << RUN_VIEW_TEST)) {
+    write_html_run_cell(f, cl, test_cell, test);
+  }
+
   if (run_fields & (1 << RUN_VIEW_SCORE)) {
-    if (score < 0 || !pr) {
-      fprintf(f, "<td%s>%s</td>", cl, _("N/A"));
+    if (score_cell != RUN_CELL_VALUE) {
+      write_html_run_cell(f, cl, score_cell, score);
+    } else if (global->score_system == SCORE_MOSCOW) {
+      if (status == RUN_OK) {
+        fprintf(f, "<td%s><b>%d</b></td>", cl, score);
+      } else {
+        fprintf(f, "<td%s>%d</td>", cl, score);
+      }
     } else {
       calc_kirov_score(score_str, sizeof(score_str),
                        start_time, separate_user_score, user_mode,
@@ -555,6 +550,37 @@ write_text_run_status(
   }
 }
 
+void
+get_user_run_attempts(
+        const serve_state_t state,
+        const struct run_entry *pe,
+        const struct section_problem_data *prob,
+        int status,
+        int *p_attempts,
+        int *p_disq_attempts,
+        int *p_prev_successes)
+{
+  const struct section_global_data *global = state->global;
+  int attempts = 0, disq_attempts = 0, prev_successes = RUN_TOO_MANY;
+
+  if (global->score_system == SCORE_KIROV && !pe->is_hidden)
+    run_get_attempts(state->runlog_state, pe->run_id, &attempts,
+                     &disq_attempts, prob->ignore_compile_errors);
+
+  if (global->score_system == SCORE_KIROV
+      && status == RUN_OK
+      && !pe->is_hidden
+      && prob->score_bonus_total > 0) {
+    if ((prev_successes = run_get_prev_successes(state->runlog_state,
+                                                 pe->run_id)) < 0)
+      prev_successes = RUN_TOO_MANY;
+  }
+
+  *p_attempts = attempts;
+  *p_disq_attempts = disq_attempts;
+  *p_prev_successes = prev_successes;
+}
+
 void
 new_write_user_runs(
         const serve_state_t state,
@@ -672,19 +698,8 @@ new_write_user_runs(
         status = RUN_ACCEPTED;
     }
 
-    attempts = 0; disq_attempts = 0;
-    if (global->score_system == SCORE_KIROV && !re.is_hidden)
-      run_get_attempts(state->runlog_state, i, &attempts, &disq_attempts,
-                       cur_prob->ignore_compile_errors);
-
-    prev_successes = RUN_TOO_MANY;
-    if (global->score_system == SCORE_KIROV
-        && status == RUN_OK
-        && !re.is_hidden
-        && cur_prob && cur_prob->score_bonus_total > 0) {
-      if ((prev_successes = run_get_prev_successes(state->runlog_state, i)) < 0)
-        prev_successes = RUN_TOO_MANY;
-    }
+    get_user_run_attempts(state, &re, cur_prob, status,
+                          &attempts, &disq_attempts, &prev_successes);
 
     run_kind_str = "";
     if (re.is_imported) run_kind_str = "*";
@@ -807,6 +822,19 @@ team_clar_flags(const serve_state_t state, int user_id, int clar_id, int flags,
   return clar_flags_html(state->clarlog_state, flags, from, to, 0, 0);
 }
 
+int
+is_clar_visible_to_user(
+        const struct clar_entry_v1 *pclar,
+        int user_id,
+        time_t start_time)
+{
+  if (pclar->id < 0) return 0;
+  if (pclar->from > 0 && pclar->from != user_id) return 0;
+  if (pclar->to > 0 && pclar->to != user_id) return 0;
+  if (start_time <= 0 && pclar->hide_flag) return 0;
+  return 1;
+}
+
 int
 serve_count_unread_clars(const serve_state_t state, int user_id,
                          time_t start_time)
@@ -876,10 +904,7 @@ new_write_user_clars(const serve_state_t state, FILE *f, int uid,
        i--) {
     if (clar_get_record(state->clarlog_state, i, &clar) < 0)
       continue;
-    if (clar.id < 0) continue;
-    if (clar.from > 0 && clar.from != uid) continue;
-    if (clar.to > 0 && clar.to != uid) continue;
-    if (start_time <= 0 && clar.hide_flag) continue;
+    if (!is_clar_visible_to_user(&clar, uid, start_time)) continue;
     showed++;
 
     psubj = clar_get_subject(state->clarlog_state, i);
@@ -1419,6 +1444,8 @@ do_write_kirov_standings(
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
   struct filter_env env;
   int separate_user_score = 0;
+  int run_count;
+  const int *tl_runs = 0;
 
   memset(&env, 0, sizeof(env));
 
@@ -1481,6 +1508,7 @@ do_write_kirov_standings(
   /* download all runs in the whole */
   r_tot = run_get_total(state->runlog_state);
   runs = run_get_entries_ptr(state->runlog_state);
+  run_count = r_tot;
 
   /* prune participants, which did not send any solution */
   /* t_runs - 1, if the participant should remain */
@@ -1622,12 +1650,30 @@ do_write_kirov_standings(
     env.rid = 0;
   }
 
-  for (k = 0; k < r_tot; k++) {
+  if (global->is_virtual
+      && !(user_filter && user_filter->stand_run_tree)) {
+    /* take the runs in the order of the virtual time, and only those
+       before the moment of the contest of the user */
+    time_t ustart, udur = -1;
+
+    if (user_id > 0) {
+      udur = 0;
+      ustart = run_get_virtual_start_time(state->runlog_state, user_id);
+      if (ustart > 0 && cur_time > ustart) udur = cur_time - ustart;
+      if (udur > run_get_duration(state->runlog_state))
+        udur = run_get_duration(state->runlog_state);
+    }
+    run_count = stand_timeline_get_runs(state, udur, &tl_runs);
+  }
+
+  for (i = 0; i < run_count; i++) {
     int tind;
     int pind;
     int score, run_score, run_tests, run_status;
-    const struct run_entry *pe = &runs[k];
+    const struct run_entry *pe;
 
+    k = tl_runs ? tl_runs[i] : i;
+    pe = &runs[k];
     if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP
         || pe->status == RUN_EMPTY) continue;
     if (pe->user_id <= 0 || pe->user_id >= t_max) continue;
@@ -1655,7 +1701,7 @@ do_write_kirov_standings(
      */
 
     // ignore future runs when not in privileged mode
-    if (!client_flag || user_id > 0) {
+    if (!tl_runs && (!client_flag || user_id > 0)) {
       run_time = pe->time;
       if (run_time < start_time) run_time = start_time;
       if (stop_time && run_time > stop_time) run_time = stop_time;
@@ -2956,6 +3002,9 @@ do_write_moscow_standings(
   int last_success_run = -1;
   int last_submit_run = -1;
   struct teamdb_export u_info;
+  int cell_count;
+  const struct stand_timeline_key *tl_keys = 0;
+  const struct stand_timeline_cell *tl_cells = 0;
   const struct team_extra *u_extra;
   path_t stand_tmp;             /* temporary file path */
   path_t stand_path;            /* final path for a standings page */
@@ -3154,107 +3203,144 @@ do_write_moscow_standings(
     env.rid = 0;
   }
 
-  for (i = 0; i < r_tot; i++) {
-    const struct run_entry *pe = &runs[i];
-    time_t run_time = pe->time;
-    int up_ind;
-
-    if (pe->is_hidden) continue;
-    if (pe->status > RUN_MAX_STATUS && pe->status < RUN_TRANSIENT_FIRST) continue;
-    if (pe->status > RUN_TRANSIENT_LAST) continue;
-    if (pe->user_id <= 0 || pe->user_id >= u_max || (u = u_rev[pe->user_id]) < 0) continue;
-    if (pe->prob_id <= 0 || pe->prob_id > state->max_prob) continue;
-    if ((p = p_rev[pe->prob_id]) < 0) continue;
-    if (user_filter && user_filter->stand_run_tree) {
-      env.rid = i;
-      if (filter_tree_bool_eval(&env, user_filter->stand_run_tree) <= 0)
-        continue;
+  if (global->is_virtual
+      && !(user_filter && user_filter->stand_run_tree)
+      && stand_timeline_is_supported(state)) {
+    /* take the cells at the moment of the contest from the timeline */
+    cell_count = stand_timeline_get(state, STAND_TIMELINE_MOSCOW,
+                                    user_id > 0 ? current_dur : -1,
+                                    &tl_keys, &tl_cells);
+    for (i = 0; i < cell_count; i++) {
+      const struct stand_timeline_cell *pc = &tl_cells[i];
+      int cell_user_id = tl_keys[i].user_id;
+      int up_ind;
+
+      if (!pc->calc && !pc->flags && !pc->total_att) continue;
+      if (cell_user_id >= u_max || (u = u_rev[cell_user_id]) < 0) continue;
+      if ((p = p_rev[tl_keys[i].prob_id]) < 0) continue;
+      up_ind = (u << row_sh) + p;
+
+      if ((pc->flags & STAND_CELL_TRANS)) up_trans[up_ind] = 1;
+      if ((pc->flags & STAND_CELL_CF)) up_cf[up_ind] = 1;
+      up_totatt[up_ind] = pc->total_att;
+      p_att[p] += pc->total_att;
+      if (pc->calc > 0 || pc->score > 0) {
+        ustart = run_get_virtual_start_time(state->runlog_state, cell_user_id);
+        udur = pc->ok_dur;
+        if (udur > contest_dur) udur = contest_dur;
+        up_att[up_ind] = pc->att;
+        up_pen[up_ind] = sec_to_min(global->rounding_mode, udur);
+        up_time[up_ind] = ustart + pc->ok_dur;
+        up_score[up_ind] = pc->score;
+      }
+      if (pc->calc > 0) {
+        up_solved[up_ind] = 1;
+        p_succ[p]++;
+      }
     }
-    prob = state->probs[pe->prob_id];
-    up_ind = (u << row_sh) + p;
+  } else {
+    for (i = 0; i < r_tot; i++) {
+      const struct run_entry *pe = &runs[i];
+      time_t run_time = pe->time;
+      int up_ind;
+
+      if (pe->is_hidden) continue;
+      if (pe->status > RUN_MAX_STATUS && pe->status < RUN_TRANSIENT_FIRST) continue;
+      if (pe->status > RUN_TRANSIENT_LAST) continue;
+      if (pe->user_id <= 0 || pe->user_id >= u_max || (u = u_rev[pe->user_id]) < 0) continue;
+      if (pe->prob_id <= 0 || pe->prob_id > state->max_prob) continue;
+      if ((p = p_rev[pe->prob_id]) < 0) continue;
+      if (user_filter && user_filter->stand_run_tree) {
+        env.rid = i;
+        if (filter_tree_bool_eval(&env, user_filter->stand_run_tree) <= 0)
+          continue;
+      }
+      prob = state->probs[pe->prob_id];
+      up_ind = (u << row_sh) + p;
 
-    if (up_solved[up_ind]) continue;
-    if (pe->status >= RUN_TRANSIENT_FIRST && pe->status <= RUN_TRANSIENT_LAST) {
-      up_trans[up_ind] = 1;
-      continue;
-    }
-    if (pe->status == RUN_PENDING) {
-      up_trans[up_ind] = 1;
-      continue;
-    }
-    ustart = start_time;
-    if (global->is_virtual) {
-      // filter "future" virtual runs
-      ustart = run_get_virtual_start_time(state->runlog_state, pe->user_id);
-      if (run_time < ustart) run_time = ustart;
-      udur = run_time - ustart;
-      if (udur > contest_dur) udur = contest_dur;
-      if (user_id > 0 && udur > current_dur) continue;
-    } else if (client_flag != 1 || user_id) {
-      // filter future real runs for unprivileged standings
-      if (run_time < start_time) run_time = start_time;
-      udur = run_time - start_time;
-      if (current_dur > 0 && udur > current_dur) continue;
-      if (global->stand_ignore_after > 0
-          && pe->time >= global->stand_ignore_after)
+      if (up_solved[up_ind]) continue;
+      if (pe->status >= RUN_TRANSIENT_FIRST && pe->status <= RUN_TRANSIENT_LAST) {
+        up_trans[up_ind] = 1;
         continue;
-    } else {
-      if (run_time < start_time) run_time = start_time;
-      udur = run_time - start_time;
-    }
-
-    if (pe->status == RUN_OK) {
-      up_solved[up_ind] = 1;
-      up_att[up_ind] = up_totatt[up_ind];
-      up_pen[up_ind] = sec_to_min(global->rounding_mode, udur);
-      up_time[up_ind] = run_time;
-      up_totatt[up_ind]++;
-      up_score[up_ind] = prob->full_score;
-      if (prob->variable_full_score) up_score[up_ind] = pe->score;
-      p_att[p]++;
-      p_succ[p]++;
-      if (!global->is_virtual) {
-        last_success_run = i;
-        last_success_time = pe->time;
-        last_success_start = ustart;
-        last_submit_run = i;
-        last_submit_time = pe->time;
-        last_submit_start = ustart;
       }
-    } else if (run_is_failed_attempt(pe->status)) {
-      if (pe->score > up_score[up_ind]) {
+      if (pe->status == RUN_PENDING) {
+        up_trans[up_ind] = 1;
+        continue;
+      }
+      ustart = start_time;
+      if (global->is_virtual) {
+        // filter "future" virtual runs
+        ustart = run_get_virtual_start_time(state->runlog_state, pe->user_id);
+        if (run_time < ustart) run_time = ustart;
+        udur = run_time - ustart;
+        if (udur > contest_dur) udur = contest_dur;
+        if (user_id > 0 && udur > current_dur) continue;
+      } else if (client_flag != 1 || user_id) {
+        // filter future real runs for unprivileged standings
+        if (run_time < start_time) run_time = start_time;
+        udur = run_time - start_time;
+        if (current_dur > 0 && udur > current_dur) continue;
+        if (global->stand_ignore_after > 0
+            && pe->time >= global->stand_ignore_after)
+          continue;
+      } else {
+        if (run_time < start_time) run_time = start_time;
+        udur = run_time - start_time;
+      }
+
+      if (pe->status == RUN_OK) {
+        up_solved[up_ind] = 1;
         up_att[up_ind] = up_totatt[up_ind];
         up_pen[up_ind] = sec_to_min(global->rounding_mode, udur);
         up_time[up_ind] = run_time;
-        up_score[up_ind] = pe->score;
-      }
-      up_totatt[up_ind]++;
-      p_att[p]++;
-      if (!global->is_virtual) {
-        last_submit_run = i;
-        last_submit_time = pe->time;
-        last_submit_start = ustart;
-      }
-    } else if ((pe->status == RUN_COMPILE_ERR
-                || pe->status == RUN_STYLE_ERR
-                || pe->status == RUN_REJECTED)
-               && !prob->ignore_compile_errors) {
-      up_totatt[up_ind]++;
-      p_att[p]++;
-      if (!global->is_virtual) {
-        last_submit_run = i;
-        last_submit_time = pe->time;
-        last_submit_start = ustart;
+        up_totatt[up_ind]++;
+        up_score[up_ind] = prob->full_score;
+        if (prob->variable_full_score) up_score[up_ind] = pe->score;
+        p_att[p]++;
+        p_succ[p]++;
+        if (!global->is_virtual) {
+          last_success_run = i;
+          last_success_time = pe->time;
+          last_success_start = ustart;
+          last_submit_run = i;
+          last_submit_time = pe->time;
+          last_submit_start = ustart;
+        }
+      } else if (run_is_failed_attempt(pe->status)) {
+        if (pe->score > up_score[up_ind]) {
+          up_att[up_ind] = up_totatt[up_ind];
+          up_pen[up_ind] = sec_to_min(global->rounding_mode, udur);
+          up_time[up_ind] = run_time;
+          up_score[up_ind] = pe->score;
+        }
+        up_totatt[up_ind]++;
+        p_att[p]++;
+        if (!global->is_virtual) {
+          last_submit_run = i;
+          last_submit_time = pe->time;
+          last_submit_start = ustart;
+        }
+      } else if ((pe->status == RUN_COMPILE_ERR
+                  || pe->status == RUN_STYLE_ERR
+                  || pe->status == RUN_REJECTED)
+                 && !prob->ignore_compile_errors) {
+        up_totatt[up_ind]++;
+        p_att[p]++;
+        if (!global->is_virtual) {
+          last_submit_run = i;
+          last_submit_time = pe->time;
+          last_submit_start = ustart;
+        }
+      } else if (pe->status == RUN_COMPILE_ERR
+                 || pe->status == RUN_STYLE_ERR
+                 || pe->status == RUN_REJECTED) {
+        // silently ignore compilation error
+      } else if (pe->status == RUN_CHECK_FAILED) {
+        up_cf[up_ind] = 1;
+      } else {
+        // FIXME: do some checking
+        // silently ignore such run
       }
-    } else if (pe->status == RUN_COMPILE_ERR
-               || pe->status == RUN_STYLE_ERR
-               || pe->status == RUN_REJECTED) {
-      // silently ignore compilation error
-    } else if (pe->status == RUN_CHECK_FAILED) {
-      up_cf[up_ind] = 1;
-    } else {
-      // FIXME: do some checking
-      // silently ignore such run
     }
   }
 
@@ -3905,6 +3991,9 @@ do_write_standings(
   unsigned char *cf_flag = 0;
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
   struct filter_env env;
+  int cell_count;
+  const struct stand_timeline_key *tl_keys = 0;
+  const struct stand_timeline_cell *tl_cells = 0;
 
   memset(&env, 0, sizeof(env));
 
@@ -4060,94 +4149,138 @@ do_write_standings(
     env.rid = 0;
   }
 
-  /* now scan runs log */
-  for (k = 0; k < r_tot; k++) {
-    pe = &runs[k];
-    run_time = pe->time;
-    if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP
-        || pe->status == RUN_EMPTY) continue;
-    if (pe->user_id <= 0 || pe->user_id >= t_max || t_rev[pe->user_id] < 0) continue;
-    if (pe->prob_id <= 0 || pe->prob_id > state->max_prob || p_rev[pe->prob_id] < 0)
-      continue;
-    if (!state->probs[pe->prob_id] || state->probs[pe->prob_id]->hidden) continue;
-    if (pe->is_hidden) continue;
-    if (user_filter && user_filter->stand_run_tree) {
-      env.rid = k;
-      if (filter_tree_bool_eval(&env, user_filter->stand_run_tree) <= 0)
-        continue;
+  if (global->is_virtual
+      && !(user_filter && user_filter->stand_run_tree)
+      && stand_timeline_is_supported(state)) {
+    /* take the cells at the moment of the contest from the timeline */
+    cell_count = stand_timeline_get(state, STAND_TIMELINE_ACM,
+                                    user_id > 0 ? current_dur : -1,
+                                    &tl_keys, &tl_cells);
+    for (k = 0; k < cell_count; k++) {
+      const struct stand_timeline_cell *pc = &tl_cells[k];
+      int cell_user_id = tl_keys[k].user_id;
+      int cell_prob_id = tl_keys[k].prob_id;
+
+      if (!pc->calc && !pc->flags) continue;
+      if (cell_user_id >= t_max || t_rev[cell_user_id] < 0) continue;
+      if (p_rev[cell_prob_id] < 0) continue;
+      prob = state->probs[cell_prob_id];
+      tt = t_rev[cell_user_id];
+      pp = p_rev[cell_prob_id];
+      up_ind = (tt << row_sh) + pp;
+
+      calc[up_ind] = pc->calc;
+      if (pc->calc > 0) {
+        t_pen[tt] += prob->acm_run_penalty * (pc->calc - 1);
+        t_prob[tt]++;
+        succ_att[pp]++;
+        tot_att[pp] += pc->calc;
+        ok_time[up_ind] = sec_to_min(global->rounding_mode, pc->ok_dur);
+        if (!global->ignore_success_time) t_pen[tt] += ok_time[up_ind];
+        if (pc->ok_run > last_success_run) {
+          last_success_run = pc->ok_run;
+          last_success_time = runs[pc->ok_run].time;
+          last_success_start = run_get_virtual_start_time(state->runlog_state,
+                                                          cell_user_id);
+        }
+      } else {
+        tot_att[pp] -= pc->calc;
+      }
+      if ((pc->flags & STAND_CELL_DISQ)) disq_flag[up_ind] = 1;
+      if ((pc->flags & STAND_CELL_PR)) pr_flag[up_ind] = 1;
+      if ((pc->flags & STAND_CELL_TRANS)) trans_flag[up_ind] = 1;
+      if ((pc->flags & STAND_CELL_CF)) cf_flag[up_ind] = 1;
     }
-    prob = state->probs[pe->prob_id];
-
-    if (global->is_virtual) {
-      // filter "future" virtual runs
-      tstart = run_get_virtual_start_time(state->runlog_state, pe->user_id);
-      ASSERT(run_time >= tstart);
-      tdur = run_time - tstart;
-      ASSERT(tdur <= contest_dur);
-      if (user_id > 0 && tdur > current_dur) continue;
-    } else {
-      // for a regular contest --- filter future runs for
-      // unprivileged standings
-      // client_flag == 1 && user_id == 0 --- privileged standings
-      if (client_flag != 1 || user_id) {
-        if (run_time < start_time) run_time = start_time;
-        if (current_dur > 0 && run_time - start_time > current_dur) continue;
-        if (global->stand_ignore_after > 0
-            && pe->time >= global->stand_ignore_after)
+  } else {
+    /* now scan runs log */
+    for (k = 0; k < r_tot; k++) {
+      pe = &runs[k];
+      run_time = pe->time;
+      if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP
+          || pe->status == RUN_EMPTY) continue;
+      if (pe->user_id <= 0 || pe->user_id >= t_max || t_rev[pe->user_id] < 0) continue;
+      if (pe->prob_id <= 0 || pe->prob_id > state->max_prob || p_rev[pe->prob_id] < 0)
+        continue;
+      if (!state->probs[pe->prob_id] || state->probs[pe->prob_id]->hidden) continue;
+      if (pe->is_hidden) continue;
+      if (user_filter && user_filter->stand_run_tree) {
+        env.rid = k;
+        if (filter_tree_bool_eval(&env, user_filter->stand_run_tree) <= 0)
           continue;
       }
-    }
-    tt = t_rev[pe->user_id];
-    pp = p_rev[pe->prob_id];
-    up_ind = (tt << row_sh) + pp;
+      prob = state->probs[pe->prob_id];
 
-    if (pe->status == RUN_OK) {
-      /* program accepted */
-      if (calc[up_ind] > 0) continue;
-
-      last_success_run = k;
-      t_pen[tt] += state->probs[pe->prob_id]->acm_run_penalty * - calc[up_ind];
-      calc[up_ind] = 1 - calc[up_ind];
-      t_prob[tt]++;
-      succ_att[pp]++;
-      tot_att[pp]++;
       if (global->is_virtual) {
-        ok_time[up_ind] = sec_to_min(global->rounding_mode, tdur);
-        if (!global->ignore_success_time) t_pen[tt] += ok_time[up_ind];
-        last_success_time = run_time;
-        last_success_start = tstart;
+        // filter "future" virtual runs
+        tstart = run_get_virtual_start_time(state->runlog_state, pe->user_id);
+        ASSERT(run_time >= tstart);
+        tdur = run_time - tstart;
+        ASSERT(tdur <= contest_dur);
+        if (user_id > 0 && tdur > current_dur) continue;
       } else {
-        if (run_time < start_time) run_time = start_time;
-        ok_time[up_ind] = sec_to_min(global->rounding_mode, run_time - start_time);
-        if (!global->ignore_success_time) t_pen[tt] += ok_time[up_ind];
-        last_success_time = run_time;
-        last_success_start = start_time;
-      }
-    } else if ((pe->status == RUN_COMPILE_ERR
-                || pe->status == RUN_STYLE_ERR
-                || pe->status == RUN_REJECTED)
-               && !prob->ignore_compile_errors) {
-      if (calc[up_ind] <= 0) {
-        calc[up_ind]--;
-        tot_att[pp]++;
+        // for a regular contest --- filter future runs for
+        // unprivileged standings
+        // client_flag == 1 && user_id == 0 --- privileged standings
+        if (client_flag != 1 || user_id) {
+          if (run_time < start_time) run_time = start_time;
+          if (current_dur > 0 && run_time - start_time > current_dur) continue;
+          if (global->stand_ignore_after > 0
+              && pe->time >= global->stand_ignore_after)
+            continue;
+        }
       }
-    } else if (run_is_failed_attempt(pe->status)) {
-      /* some error */
-      if (calc[up_ind] <= 0) {
-        calc[up_ind]--;
+      tt = t_rev[pe->user_id];
+      pp = p_rev[pe->prob_id];
+      up_ind = (tt << row_sh) + pp;
+
+      if (pe->status == RUN_OK) {
+        /* program accepted */
+        if (calc[up_ind] > 0) continue;
+
+        last_success_run = k;
+        t_pen[tt] += state->probs[pe->prob_id]->acm_run_penalty * - calc[up_ind];
+        calc[up_ind] = 1 - calc[up_ind];
+        t_prob[tt]++;
+        succ_att[pp]++;
         tot_att[pp]++;
+        if (global->is_virtual) {
+          ok_time[up_ind] = sec_to_min(global->rounding_mode, tdur);
+          if (!global->ignore_success_time) t_pen[tt] += ok_time[up_ind];
+          last_success_time = run_time;
+          last_success_start = tstart;
+        } else {
+          if (run_time < start_time) run_time = start_time;
+          ok_time[up_ind] = sec_to_min(global->rounding_mode, run_time - start_time);
+          if (!global->ignore_success_time) t_pen[tt] += ok_time[up_ind];
+          last_success_time = run_time;
+          last_success_start = start_time;
+        }
+      } else if ((pe->status == RUN_COMPILE_ERR
+                  || pe->status == RUN_STYLE_ERR
+                  || pe->status == RUN_REJECTED)
+                 && !prob->ignore_compile_errors) {
+        if (calc[up_ind] <= 0) {
+          calc[up_ind]--;
+          tot_att[pp]++;
+        }
+      } else if (run_is_failed_attempt(pe->status)) {
+        /* some error */
+        if (calc[up_ind] <= 0) {
+          calc[up_ind]--;
+          tot_att[pp]++;
+        }
+      } else if (pe->status == RUN_DISQUALIFIED) {
+        disq_flag[up_ind] = 1;
+      } else if (pe->status == RUN_PENDING_REVIEW) {
+        pr_flag[up_ind] = 1;
+      } else if (pe->status == RUN_PENDING || pe->status == RUN_ACCEPTED) {
+        trans_flag[up_ind] = 1;
+      } else if (pe->status >= RUN_TRANSIENT_FIRST
+                 && pe->status <= RUN_TRANSIENT_LAST) {
+        trans_flag[up_ind] = 1;
+      } else if (pe->status == RUN_CHECK_FAILED) {
+        cf_flag[up_ind] = 1;
       }
-    } else if (pe->status == RUN_DISQUALIFIED) {
-      disq_flag[up_ind] = 1;
-    } else if (pe->status == RUN_PENDING_REVIEW) {
-      pr_flag[up_ind] = 1;
-    } else if (pe->status == RUN_PENDING || pe->status == RUN_ACCEPTED) {
-      trans_flag[up_ind] = 1;
-    } else if (pe->status >= RUN_TRANSIENT_FIRST
-               && pe->status <= RUN_TRANSIENT_LAST) {
-      trans_flag[up_ind] = 1;
-    } else if (pe->status == RUN_CHECK_FAILED) {
-      cf_flag[up_ind] = 1;
     }
   }
 
@@ -60,6 +60,17 @@ void new_write_user_runs(const serve_state_t, FILE *f, int uid,
                          unsigned char const *extra_args,
                          const unsigned char *table_class);
 
+/* the attempts before the run, as counted in the run table of the user */
+void
+get_user_run_attempts(
+        const serve_state_t state,
+        const struct run_entry *pe,
+        const struct section_problem_data *prob,
+        int status,
+        int *p_attempts,
+        int *p_disq_attempts,
+        int *p_prev_successes);
+
 void new_write_user_clars(const serve_state_t,
                           FILE *f, int uid, unsigned int show_flags,
                           int action, ej_cookie_t sid,
@@ -67,6 +78,10 @@ void new_write_user_clars(const serve_state_t,
                           unsigned char const *hidden_vars,
                           unsigned char const *extra_args,
                           const unsigned char *table_class);
+struct clar_entry_v1;
+/* the same filter as in the clar table of the participant */
+int is_clar_visible_to_user(const struct clar_entry_v1 *pclar, int user_id,
+                            time_t start_time);
 
 void write_standings_header(const serve_state_t state,
                             const struct contest_desc * cnts,
@@ -135,6 +150,10 @@ void html_reset_clar_filter(serve_state_t, int user_id, ej_cookie_t session_id);
 
 void write_runs_dump(const serve_state_t, FILE *f, const unsigned char *,
                      unsigned char const *charset);
+void write_runs_dump_header(FILE *f, const unsigned char *url,
+                            unsigned char const *charset);
+void write_runs_dump_range(const serve_state_t state, FILE *f, int first_run,
+                           int last_run);
 struct run_entry;
 struct section_problem_data;
 struct penalty_info;
@@ -153,6 +172,28 @@ calc_kirov_score(
         int prev_successes,
         int *p_date_penalty,
         int format);
+/* the kinds of the test and score cells of the run table */
+enum
+{
+  RUN_CELL_NONE,                /* no cell for the score system */
+  RUN_CELL_EMPTY,               /* an empty cell */
+  RUN_CELL_NA,                  /* N/A */
+  RUN_CELL_VALUE,               /* the value is shown */
+  RUN_CELL_FAILED_TEST,         /* the failed test in olympiad contests */
+};
+
+void
+get_run_status_cells(
+        const serve_state_t,
+        const struct run_entry *pe,
+        int user_mode,
+        int priv_level,
+        int disable_failed,
+        int *p_status,
+        int *p_test_cell,
+        int *p_test,
+        int *p_score_cell,
+        int *p_score);
 void
 write_html_run_status(
         const serve_state_t,
@@ -42,6 +42,7 @@
 #include "errlog.h"
 #include "serve_state.h"
 #include "mime_type.h"
+#include "text_diff.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -409,6 +410,7 @@ write_xml_testing_report(
     ACTION_VIEW_TEST_ERROR,
     ACTION_VIEW_TEST_CHECKER,
     ACTION_VIEW_TEST_INFO,
+    0,
   };
 
   if (class1 && *class1) {
@@ -753,6 +755,15 @@ write_xml_testing_report(
       closing_a = "";
     }
     fprintf(f, "&nbsp;%sF%s", opening_a, closing_a);
+    // program output compared with the correct answer
+    if (!user_mode && actions_vector[6] > 0 && r->archive_available
+        && t->output_available && r->correct_available) {
+      html_hyperref(opening_a, sizeof(opening_a), sid, self_url, extra_args,
+                    "action=%d&run_id=%d&test_num=%d&diff_mode=%d",
+                    actions_vector[6], r->run_id, t->num,
+                    TEXT_DIFF_SIDE_BY_SIDE_HTML);
+      fprintf(f, "&nbsp;%sD</a>", opening_a);
+    }
     fprintf(f, "</td>");
     fprintf(f, "</tr>\n");
   }
@@ -873,17 +884,9 @@ html_reset_clar_filter(
 
 
 void
-write_runs_dump(const serve_state_t state, FILE *f, const unsigned char *url,
-                unsigned char const *charset)
+write_runs_dump_header(FILE *f, const unsigned char *url,
+                       unsigned char const *charset)
 {
-  int total_runs, i, j;
-  struct run_entry re;
-  struct tm *pts;
-  time_t start_time, dur;
-  unsigned char *s;
-  unsigned char statstr[128];
-  time_t tmp_time;
-
   if (url && *url) {
     fprintf(f, "Content-type: text/plain; charset=%s\n\n", charset);
   }
@@ -902,10 +905,34 @@ write_runs_dump(const serve_state_t state, FILE *f, const unsigned char *url,
           ";Stat_Short;Status;Score;Score_Adj;Test"
           ";Import_Flag;Hidden_Flag;RO_Flag;Locale_Id;Pages;Judge_Id"
           "\n");
+}
+
+void
+write_runs_dump(const serve_state_t state, FILE *f, const unsigned char *url,
+                unsigned char const *charset)
+{
+  write_runs_dump_header(f, url, charset);
+  write_runs_dump_range(state, f, 0, run_get_total(state->runlog_state));
+}
+
+/* writes the runs [first_run, last_run) without the header */
+void
+write_runs_dump_range(const serve_state_t state, FILE *f, int first_run,
+                      int last_run)
+{
+  int total_runs, i, j;
+  struct run_entry re;
+  struct tm *pts;
+  time_t start_time, dur;
+  unsigned char *s;
+  unsigned char statstr[128];
+  time_t tmp_time;
 
   total_runs = run_get_total(state->runlog_state);
+  if (last_run > total_runs) last_run = total_runs;
+  if (first_run < 0) first_run = 0;
   start_time = run_get_start_time(state->runlog_state);
-  for (i = 0; i < total_runs; i++) {
+  for (i = first_run; i < last_run; i++) {
     if (run_get_entry(state->runlog_state, i, &re) < 0) {
       fprintf(f, "%d;Cannot read entry!\n", i);
       continue;
@@ -20,9 +20,11 @@
 #include "misctext.h"
 #include "xml_utils.h"
 #include "charsets.h"
+#include "ej_byteorder.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
+#include "reuse_integral.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -463,3 +465,250 @@ meta_parse_string(
 
     return 0;
 }
+
+/*
+ * The binary encoding of the structure fields.
+ *
+ * The section header is the number of fields and the hash of the field
+ * names and types, then for each field follow: the name length, the name
+ * with \0, the field type, the value length, the value. All the integers
+ * are 32 bit LE (see ej_byteorder.h). The numeric values are stored in
+ * the host format, the strings with \0, the string lists as the number
+ * of the strings followed by the strings. NULL strings and lists have
+ * the zero length.
+ *
+ * If the hash of the section is the same as of the reader,
+ * the fields are taken by their position, otherwise by their names,
+ * and the unknown fields are ignored.
+ */
+
+unsigned
+meta_get_bin_hash(const struct meta_methods *mth)
+{
+  // the hashes of the recently used structures
+  static struct
+  {
+    const struct meta_methods *mth;
+    unsigned hash;
+  } cache[8];
+  static int cache_u;
+
+  unsigned h = 2166136261U;
+  const unsigned char *s;
+  int field_id, i;
+  int v[2];
+
+  for (i = 0; i < cache_u; ++i) {
+    if (cache[i].mth == mth) return cache[i].hash;
+  }
+
+  for (field_id = 1; field_id < mth->last_tag; ++field_id) {
+    if ((s = (const unsigned char*) mth->get_name(field_id))) {
+      for (; *s; ++s) h = (h ^ *s) * 16777619U;
+    }
+    v[0] = mth->get_type(field_id);
+    v[1] = mth->get_size(field_id);
+    for (i = 0; i < (int) sizeof(v); ++i)
+      h = (h ^ ((const unsigned char *) v)[i]) * 16777619U;
+  }
+  if (cache_u < (int) (sizeof(cache) / sizeof(cache[0]))) {
+    cache[cache_u].mth = mth;
+    cache[cache_u].hash = h;
+    ++cache_u;
+  }
+  return h;
+}
+
+static void
+bin_write_32(FILE *out_f, int v)
+{
+  rint32_t x = cvt_host_to_bin_32(v);
+  fwrite(&x, sizeof(x), 1, out_f);
+}
+
+void
+meta_unparse_bin(FILE *out_f, const struct meta_methods *mth, const void *ptr)
+{
+  int field_id, ft, fz, len, i;
+  const void *fp;
+  const char *fn;
+
+  bin_write_32(out_f, mth->last_tag - 1);
+  bin_write_32(out_f, meta_get_bin_hash(mth));
+  for (field_id = 1; field_id < mth->last_tag; ++field_id) {
+    ft = mth->get_type(field_id);
+    fz = mth->get_size(field_id);
+    fp = mth->get_ptr(ptr, field_id);
+    fn = mth->get_name(field_id);
+    if (!fn) fn = "";
+    len = strlen(fn) + 1;
+    bin_write_32(out_f, len);
+    fwrite(fn, 1, len, out_f);
+    bin_write_32(out_f, ft);
+    if (!fp) {
+      bin_write_32(out_f, 0);
+      continue;
+    }
+    switch (ft) {
+    case 't':                   /* time_t */
+    case 'b':                   /* ejbytebool_t */
+    case 'B':                   /* ejintbool_t */
+    case 'z':                   /* ejintsize_t */
+    case 'i':                   /* int type */
+    case 'Z':                   /* size_t */
+      bin_write_32(out_f, fz);
+      fwrite(fp, 1, fz, out_f);
+      break;
+    case 'S':                   /* path_t */
+      len = strlen((const char *) fp) + 1;
+      bin_write_32(out_f, len);
+      fwrite(fp, 1, len, out_f);
+      break;
+    case 's':                   /* char * type */
+      {
+        const char *s = *(const char **) fp;
+        len = 0;
+        if (s) len = strlen(s) + 1;
+        bin_write_32(out_f, len);
+        if (s) fwrite(s, 1, len, out_f);
+      }
+      break;
+    case 'x':                   /* ejstrlist_t */
+    case 'X':                   /* ejenvlist_t */
+      {
+        const char **p = *(const char ***) fp;
+        if (!p) {
+          bin_write_32(out_f, 0);
+          break;
+        }
+        len = sizeof(rint32_t);
+        for (i = 0; p[i]; ++i) len += strlen(p[i]) + 1;
+        bin_write_32(out_f, len);
+        bin_write_32(out_f, i);
+        for (i = 0; p[i]; ++i) fwrite(p[i], 1, strlen(p[i]) + 1, out_f);
+      }
+      break;
+    default:
+      abort();
+    }
+  }
+}
+
+static int
+bin_read_32(const unsigned char **pp, const unsigned char *end, int *pv)
+{
+  rint32_t x;
+
+  if (end - *pp < (int) sizeof(x)) return -1;
+  memcpy(&x, *pp, sizeof(x));
+  *pp += sizeof(x);
+  *pv = cvt_bin_to_host_32(x);
+  return 0;
+}
+
+/* checks, that [str, str + len) is a \0-terminated string */
+static int
+bin_is_str(const unsigned char *str, int len)
+{
+  return len > 0 && !str[len - 1] && strlen((const char *) str) == len - 1;
+}
+
+int
+meta_parse_bin(
+        const struct meta_methods *mth,
+        void *ptr,
+        const unsigned char *data,
+        size_t size,
+        size_t *p_used)
+{
+  const unsigned char *p = data, *end = data + size, *name, *v;
+  int field_count, hash, k, name_len, ft, len, field_id, count, i;
+  int same_schema;
+  void *fp;
+
+  if (bin_read_32(&p, end, &field_count) < 0 || field_count < 0) return -1;
+  if (bin_read_32(&p, end, &hash) < 0) return -1;
+  same_schema = ((unsigned) hash == meta_get_bin_hash(mth)
+                 && field_count == mth->last_tag - 1);
+
+  for (k = 0; k < field_count; ++k) {
+    if (bin_read_32(&p, end, &name_len) < 0) return -1;
+    if (name_len <= 0 || end - p < name_len) return -1;
+    name = p;
+    p += name_len;
+    if (bin_read_32(&p, end, &ft) < 0) return -1;
+    if (bin_read_32(&p, end, &len) < 0) return -1;
+    if (len < 0 || end - p < len) return -1;
+    v = p;
+    p += len;
+
+    if (same_schema) {
+      field_id = k + 1;
+      if (mth->get_type(field_id) != ft) return -1;
+    } else {
+      if (!bin_is_str(name, name_len)) return -1;
+      field_id = mth->lookup_field((const char *) name);
+      if (field_id <= 0 || field_id >= mth->last_tag) continue;
+      if (mth->get_type(field_id) != ft) continue;
+    }
+    if (!(fp = mth->get_ptr_nc(ptr, field_id))) continue;
+    if (!len) continue;
+
+    switch (ft) {
+    case 't':                   /* time_t */
+    case 'b':                   /* ejbytebool_t */
+    case 'B':                   /* ejintbool_t */
+    case 'z':                   /* ejintsize_t */
+    case 'i':                   /* int type */
+    case 'Z':                   /* size_t */
+      if (len != mth->get_size(field_id)) {
+        if (same_schema) return -1;
+        continue;
+      }
+      memcpy(fp, v, len);
+      break;
+    case 'S':                   /* path_t */
+      if (!bin_is_str(v, len)) return -1;
+      if (len > mth->get_size(field_id)) return -1;
+      memcpy(fp, v, len);
+      break;
+    case 's':                   /* char * type */
+      if (!bin_is_str(v, len)) return -1;
+      xfree(*(char **) fp);
+      *(char **) fp = xmemdup((const char *) v, len - 1);
+      break;
+    case 'x':                   /* ejstrlist_t */
+    case 'X':                   /* ejenvlist_t */
+      {
+        const unsigned char *q = v, *qe = v + len;
+        char **strs = NULL;
+
+        if (bin_read_32(&q, qe, &count) < 0 || count < 0 || count > len)
+          return -1;
+        XCALLOC(strs, count + 1);
+        for (i = 0; i < count; ++i) {
+          const unsigned char *z = memchr(q, 0, qe - q);
+          if (!z) break;
+          strs[i] = xmemdup((const char *) q, z - q);
+          q = z + 1;
+        }
+        if (i < count || q != qe) {
+          for (i = 0; strs[i]; ++i) xfree(strs[i]);
+          xfree(strs);
+          return -1;
+        }
+        if (*(char ***) fp) {
+          for (i = 0; (*(char ***) fp)[i]; ++i) xfree((*(char ***) fp)[i]);
+          xfree(*(char ***) fp);
+        }
+        *(char ***) fp = strs;
+      }
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (p_used) *p_used = p - data;
+  return 0;
+}
@@ -82,4 +82,20 @@ meta_unparse_cfg(
         const void *ptr,
         const void *default_ptr);
 
+/* the binary encoding of the fields, used for the spool packets */
+unsigned
+meta_get_bin_hash(const struct meta_methods *mth);
+void
+meta_unparse_bin(
+        FILE *out_f,
+        const struct meta_methods *mth,
+        const void *ptr);
+int
+meta_parse_bin(
+        const struct meta_methods *mth,
+        void *ptr,
+        const unsigned char *data,
+        size_t size,
+        size_t *p_used);
+
 #endif /* __META_GENERIC_H__ */
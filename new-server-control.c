@@ -36,7 +36,8 @@
 
 /*
  * usage: ej-contests-control COMMAND CONFIG
- *   COMMAND is one of `stop', `restart', `status'
+ *   COMMAND is one of `stop', `restart', `status', `stats',
+ *   `stats-enable', `stats-disable', `stats-reset'
  */
 
 static const unsigned char *program_name = "";
@@ -86,6 +87,10 @@ write_help(void)
          "  COMMAND:\n"
          "    stop      stop the ej-contests\n"
          "    restart   restart the ej-contests\n"
+         "    stats     write the performance statistics\n"
+         "    stats-enable  start collecting the performance statistics\n"
+         "    stats-disable stop collecting the performance statistics\n"
+         "    stats-reset   reset the performance statistics\n"
          /*"    status    report the ej-contests status\n"*/,
          program_name, program_name);
   exit(0);
@@ -110,6 +115,8 @@ main(int argc, char *argv[])
   int pid;
   int signum = 0;
   const unsigned char *signame = "";
+  unsigned char *stats_text = 0;
+  size_t stats_size = 0;
 
   program_name = os_GetBasename(argv[0]);
   if (argc < 2) startup_error("not enough parameters");
@@ -153,6 +160,14 @@ main(int argc, char *argv[])
     cmd = NEW_SRV_CMD_RESTART;
     signum = START_RESTART;
     signame = "HUP";
+  } else if (!strcmp(command, "stats")) {
+    cmd = NEW_SRV_CMD_GET_STATS;
+  } else if (!strcmp(command, "stats-enable")) {
+    cmd = NEW_SRV_CMD_ENABLE_STATS;
+  } else if (!strcmp(command, "stats-disable")) {
+    cmd = NEW_SRV_CMD_DISABLE_STATS;
+  } else if (!strcmp(command, "stats-reset")) {
+    cmd = NEW_SRV_CMD_RESET_STATS;
   } else {
     startup_error("invalid command");
   }
@@ -176,6 +191,14 @@ main(int argc, char *argv[])
   if (r == -NEW_SRV_ERR_CONNECT_FAILED) op_error("ej-contests is not running");
   if (r < 0) op_error("%s", ns_strerror(-r));
 
+  if (cmd == NEW_SRV_CMD_GET_STATS) {
+    r = new_server_clnt_get_stats(conn, &stats_text, &stats_size);
+    if (r < 0) op_error("%s", ns_strerror(-r));
+    fwrite(stats_text, 1, stats_size, stdout);
+    xfree(stats_text);
+    return 0;
+  }
+
   r = new_server_clnt_control(conn, cmd);
   if (r < 0) op_error("%s", ns_strerror(-r));
 
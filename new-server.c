@@ -31,6 +31,7 @@
 #include "l10n.h"
 #include "pathutl.h"
 #include "userlist.h"
+#include "xml_utils.h"
 #include "compat.h"
 
 #include "reuse_xalloc.h"
@@ -151,6 +152,59 @@ nsdb_get_examiner_count(int contest_id, int prob_id)
   return nsdb_default->iface->get_examiner_count(nsdb_default->data, contest_id, prob_id);
 }
 
+/* validated cookies are trusted without asking userlist-server for
+   this number of seconds */
+#define NS_COOKIE_CACHE_TTL 10
+
+static struct session_info **session_hash;
+static size_t session_hash_size, session_count;
+
+static size_t
+session_hash_index(ej_cookie_t session_id)
+{
+  return (size_t) (session_id % session_hash_size);
+}
+
+static void
+session_hash_add(struct session_info *p)
+{
+  struct session_info **new_hash, *q;
+  size_t new_size, i, j;
+
+  if (session_count >= session_hash_size) {
+    if (!(new_size = session_hash_size * 2)) new_size = 1024;
+    XCALLOC(new_hash, new_size);
+    for (i = 0; i < session_hash_size; ++i) {
+      while ((q = session_hash[i])) {
+        session_hash[i] = q->hash_next;
+        j = (size_t) (q->_session_id % new_size);
+        q->hash_next = new_hash[j];
+        new_hash[j] = q;
+      }
+    }
+    xfree(session_hash);
+    session_hash = new_hash;
+    session_hash_size = new_size;
+  }
+  i = session_hash_index(p->_session_id);
+  p->hash_next = session_hash[i];
+  session_hash[i] = p;
+  ++session_count;
+}
+
+static struct session_info *
+find_session(ej_cookie_t session_id, ej_cookie_t client_key)
+{
+  struct session_info *p;
+
+  if (!session_hash_size) return NULL;
+  for (p = session_hash[session_hash_index(session_id)]; p; p = p->hash_next) {
+    if (p->_session_id == session_id && p->_client_key == client_key)
+      return p;
+  }
+  return NULL;
+}
+
 struct session_info *
 ns_get_session(
         ej_cookie_t session_id,
@@ -160,9 +214,7 @@ ns_get_session(
   struct session_info *p;
 
   if (!cur_time) cur_time = time(0);
-  for (p = session_first; p; p = p->next) {
-    if (p->_session_id == session_id && p->_client_key == client_key) break;
-  }
+  p = find_session(session_id, client_key);
   if (!p) {
     XCALLOC(p, 1);
     p->_session_id = session_id;
@@ -175,6 +227,7 @@ ns_get_session(
     } else {
       session_first = session_last = p;
     }
+    session_hash_add(p);
   } else if (p != session_first) {
     // move the session to the head of the list
     p->prev->next = p->next;
@@ -191,9 +244,19 @@ ns_get_session(
   return p;
 }
 
+static void
+drop_cached_cookie(struct session_info *p)
+{
+  p->cookie_cmd = 0;
+  xfree(p->cookie_login); p->cookie_login = 0;
+  xfree(p->cookie_name); p->cookie_name = 0;
+}
+
 static void
 do_remove_session(struct session_info *p)
 {
+  struct session_info **pp;
+
   if (!p) return;
 
   if (!p->prev) {
@@ -206,7 +269,16 @@ do_remove_session(struct session_info *p)
   } else {
     p->next->prev = p->prev;
   }
+  for (pp = &session_hash[session_hash_index(p->_session_id)]; *pp;
+       pp = &(*pp)->hash_next) {
+    if (*pp == p) {
+      *pp = p->hash_next;
+      --session_count;
+      break;
+    }
+  }
   // cleanup p
+  drop_cached_cookie(p);
   userlist_free(&p->user_info->b);
   xfree(p);
 }
@@ -214,10 +286,13 @@ do_remove_session(struct session_info *p)
 void
 ns_remove_session(ej_cookie_t session_id)
 {
-  struct session_info *p;
+  struct session_info *p = 0;
 
-  for (p = session_first; p; p = p->next) {
-    if (p->_session_id == session_id) break;
+  if (session_hash_size > 0) {
+    for (p = session_hash[session_hash_index(session_id)]; p;
+         p = p->hash_next) {
+      if (p->_session_id == session_id) break;
+    }
   }
   do_remove_session(p);
 }
@@ -235,6 +310,82 @@ new_server_remove_expired_sessions(time_t cur_time)
   }
 }
 
+/* returns 0 and fills the request, if there is a fresh reply for 'cmd' */
+int
+ns_get_cached_cookie(
+        struct http_request_info *phr,
+        int cmd,
+        time_t cur_time)
+{
+  struct session_info *p;
+
+  if (!(p = find_session(phr->session_id, phr->client_key))) return -1;
+  if (p->cookie_cmd != cmd) return -1;
+  if (cur_time >= p->cookie_check_time + NS_COOKIE_CACHE_TTL
+      || cur_time < p->cookie_check_time) {
+    drop_cached_cookie(p);
+    return -1;
+  }
+  if (p->cookie_ssl_flag != phr->ssl_flag
+      || ipv6cmp(&p->cookie_ip, &phr->ip) != 0)
+    return -1;
+
+  phr->user_id = p->cookie_user_id;
+  phr->contest_id = p->cookie_contest_id;
+  phr->locale_id = p->cookie_locale_id;
+  phr->role = p->cookie_role;
+  xfree(phr->login); phr->login = 0;
+  if (p->cookie_login) phr->login = xstrdup(p->cookie_login);
+  xfree(phr->name); phr->name = 0;
+  if (p->cookie_name) phr->name = xstrdup(p->cookie_name);
+  return 0;
+}
+
+void
+ns_set_cached_cookie(
+        struct http_request_info *phr,
+        int cmd,
+        time_t cur_time)
+{
+  struct session_info *p;
+
+  p = ns_get_session(phr->session_id, phr->client_key, cur_time);
+  drop_cached_cookie(p);
+  p->cookie_cmd = cmd;
+  p->cookie_check_time = cur_time;
+  p->cookie_ip = phr->ip;
+  p->cookie_ssl_flag = phr->ssl_flag;
+  p->cookie_user_id = phr->user_id;
+  p->cookie_contest_id = phr->contest_id;
+  p->cookie_locale_id = phr->locale_id;
+  p->cookie_role = phr->role;
+  if (phr->login) p->cookie_login = xstrdup(phr->login);
+  if (phr->name) p->cookie_name = xstrdup(phr->name);
+}
+
+void
+ns_drop_cached_cookie(ej_cookie_t session_id)
+{
+  struct session_info *p;
+
+  if (!session_hash_size) return;
+  for (p = session_hash[session_hash_index(session_id)]; p; p = p->hash_next) {
+    if (p->_session_id == session_id) drop_cached_cookie(p);
+  }
+}
+
+/* userlist-server notified, that the users of the contest were changed */
+void
+ns_drop_cached_cookies(int contest_id)
+{
+  struct session_info *p;
+
+  for (p = session_first; p; p = p->next) {
+    if (p->cookie_cmd && (contest_id <= 0 || p->cookie_contest_id == contest_id))
+      drop_cached_cookie(p);
+  }
+}
+
 static void
 startup_error(const char *format, ...)
 {
@@ -293,6 +444,7 @@ cmd_http_request(struct server_framework_state *state,
   size_t out_size = 0;
   FILE *out_f = 0;
   struct http_request_info hr;
+  long long start_usec;
 
   memset(&hr, 0, sizeof(hr));
   hr.id = p->id;
@@ -318,11 +470,12 @@ cmd_http_request(struct server_framework_state *state,
   if (pkt_size < in_size)
     return nsf_err_packet_too_small(state, p, pkt_size, in_size);
 
-  XALLOCAZ(args, pkt->arg_num);
-  XALLOCAZ(envs, pkt->env_num);
-  XALLOCAZ(param_names, pkt->param_num);
-  XALLOCAZ(params, pkt->param_num);
-  XALLOCAZ(my_param_sizes, pkt->param_num);
+  args = ns_arena_calloc(&hr, pkt->arg_num, sizeof(args[0]));
+  envs = ns_arena_calloc(&hr, pkt->env_num, sizeof(envs[0]));
+  param_names = ns_arena_calloc(&hr, pkt->param_num, sizeof(param_names[0]));
+  params = ns_arena_calloc(&hr, pkt->param_num, sizeof(params[0]));
+  my_param_sizes = ns_arena_calloc(&hr, pkt->param_num,
+                                   sizeof(my_param_sizes[0]));
 
   bptr = (unsigned long) pkt;
   bptr += sizeof(*pkt);
@@ -336,41 +489,59 @@ cmd_http_request(struct server_framework_state *state,
   bptr += pkt->param_num * sizeof(ej_size_t);
 
   for (i = 0; i < pkt->arg_num; i++) {
-    if (arg_sizes[i] > MAX_PARAM_SIZE) return nsf_err_protocol_error(state, p);
+    if (arg_sizes[i] > MAX_PARAM_SIZE) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
     in_size += arg_sizes[i] + 1;
   }
   for (i = 0; i < pkt->env_num; i++) {
-    if (env_sizes[i] > MAX_PARAM_SIZE) return nsf_err_protocol_error(state, p);
+    if (env_sizes[i] > MAX_PARAM_SIZE) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
     in_size += env_sizes[i] + 1;
   }
   for (i = 0; i < pkt->param_num; i++) {
-    if (param_name_sizes[i] > MAX_PARAM_SIZE)
-      return nsf_err_protocol_error(state, p);
-    if (param_sizes[i] > MAX_PARAM_SIZE)
-      return nsf_err_protocol_error(state, p);
+    if (param_name_sizes[i] > MAX_PARAM_SIZE) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
+    if (param_sizes[i] > MAX_PARAM_SIZE) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
     in_size += param_name_sizes[i] + 1;
     in_size += param_sizes[i] + 1;
   }
-  if (pkt_size != in_size)
-    return nsf_err_bad_packet_length(state, p, pkt_size, in_size);
+  if (pkt_size != in_size) {
+    nsf_err_bad_packet_length(state, p, pkt_size, in_size);
+    goto cleanup;
+  }
 
   for (i = 0; i < pkt->arg_num; i++) {
     args[i] = (const unsigned char*) bptr;
     bptr += arg_sizes[i] + 1;
-    if (strlen(args[i]) != arg_sizes[i])
-      return nsf_err_protocol_error(state, p);
+    if (strlen(args[i]) != arg_sizes[i]) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
   }
   for (i = 0; i < pkt->env_num; i++) {
     envs[i] = (const unsigned char*) bptr;
     bptr += env_sizes[i] + 1;
-    if (strlen(envs[i]) != env_sizes[i])
-      return nsf_err_protocol_error(state, p);
+    if (strlen(envs[i]) != env_sizes[i]) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
   }
   for (i = 0; i < pkt->param_num; i++) {
     param_names[i] = (const unsigned char*) bptr;
     bptr += param_name_sizes[i] + 1;
-    if (strlen(param_names[i]) != param_name_sizes[i])
-      return nsf_err_protocol_error(state, p);
+    if (strlen(param_names[i]) != param_name_sizes[i]) {
+      nsf_err_protocol_error(state, p);
+      goto cleanup;
+    }
     params[i] = (const unsigned char *) bptr;
     my_param_sizes[i] = param_sizes[i];
     bptr += param_sizes[i] + 1;
@@ -401,6 +572,14 @@ cmd_http_request(struct server_framework_state *state,
     goto cleanup;
   }
 
+  if (hr.out_source) {
+    nsf_new_autoclose_source(state, p, out_txt, out_size, hr.out_source);
+    hr.out_source = 0;
+    info("HTTP_REQUEST -> OK, %zu+", out_size);
+    nsf_send_reply(state, p, NEW_SRV_RPL_OK);
+    goto cleanup;
+  }
+
   if (!out_txt || !*out_txt) {
     xfree(out_txt); out_txt = 0;
     if (hr.allow_empty_output) {
@@ -420,11 +599,29 @@ cmd_http_request(struct server_framework_state *state,
   nsf_send_reply(state, p, NEW_SRV_RPL_OK);
 
  cleanup:
+  if (ns_stats_enabled) {
+    start_usec = hr.timestamp1.tv_sec * 1000000LL + hr.timestamp1.tv_usec;
+    ns_stats_add_request(hr.action, hr.contest_id,
+                         ns_stats_get_usec() - start_usec, out_size);
+  }
+  if (hr.out_source) hr.out_source->destroy(hr.out_source);
   xfree(hr.login);
   xfree(hr.name);
-  xfree(hr.name_arm);
-  xfree(hr.script_part);
-  xfree(hr.body_attr);
+  ns_arena_release(&hr);
+}
+
+static void
+write_arena_stats(void)
+{
+  char *stat_t = 0;
+  size_t stat_z = 0;
+  FILE *stat_f;
+
+  if (!(stat_f = open_memstream(&stat_t, &stat_z))) return;
+  ns_arena_write_stats(stat_f);
+  close_memstream(stat_f); stat_f = 0;
+  info("request memory usage:\n%s", stat_t);
+  xfree(stat_t);
 }
 
 static int
@@ -481,6 +678,52 @@ cmd_control(struct server_framework_state *state,
   raise(sig);
 }
 
+static void
+cmd_stats(struct server_framework_state *state,
+          struct client_state *p,
+          size_t pkt_size,
+          const struct new_server_prot_packet *pkt)
+{
+  char *stat_t = 0;
+  size_t stat_z = 0;
+  FILE *stat_f;
+
+  if (pkt_size != sizeof(*pkt))
+    return nsf_err_bad_packet_length(state, p, pkt_size, sizeof(*pkt));
+
+  if (check_restart_permissions(p) <= 0) {
+    nsf_close_client_fds(p);
+    return nsf_send_reply(state, p, -NEW_SRV_ERR_PERMISSION_DENIED);
+  }
+
+  switch (pkt->id) {
+  case NEW_SRV_CMD_GET_STATS:
+    if (p->client_fds[0] < 0) return nsf_err_protocol_error(state, p);
+    stat_f = open_memstream(&stat_t, &stat_z);
+    ns_stats_write(stat_f, 0);
+    close_memstream(stat_f); stat_f = 0;
+    nsf_new_autoclose(state, p, stat_t, stat_z);
+    info("GET_STATS -> OK, %zu", stat_z);
+    nsf_send_reply(state, p, NEW_SRV_RPL_OK);
+    return;
+  case NEW_SRV_CMD_ENABLE_STATS:
+    ns_stats_enable(state, 1);
+    break;
+  case NEW_SRV_CMD_DISABLE_STATS:
+    ns_stats_enable(state, 0);
+    break;
+  case NEW_SRV_CMD_RESET_STATS:
+    ns_stats_reset();
+    info("performance statistics are reset");
+    break;
+  default:
+    return nsf_err_invalid_command(state, p, pkt->id);
+  }
+
+  // like the other control commands, the connection is just closed
+  p->state = STATE_DISCONNECT;
+}
+
 typedef void handler_t(struct server_framework_state *state,
                        struct client_state *p,
                        size_t pkt_size,
@@ -491,6 +734,10 @@ static handler_t *handlers[NEW_SRV_CMD_LAST] =
   [NEW_SRV_CMD_HTTP_REQUEST] = cmd_http_request,
   [NEW_SRV_CMD_STOP] = cmd_control,
   [NEW_SRV_CMD_RESTART] = cmd_control,
+  [NEW_SRV_CMD_GET_STATS] = cmd_stats,
+  [NEW_SRV_CMD_ENABLE_STATS] = cmd_stats,
+  [NEW_SRV_CMD_DISABLE_STATS] = cmd_stats,
+  [NEW_SRV_CMD_RESET_STATS] = cmd_stats,
 };
 
 static void
@@ -638,6 +885,7 @@ main(int argc, char *argv[])
   int restart_flag = 0;
   char **argv_restart = 0;
   int pid;
+  int stats_flag = 0;
 
   time(&server_start_time);
   start_set_self_args(argc, argv);
@@ -657,6 +905,10 @@ main(int argc, char *argv[])
     } else if (!strcmp(argv[i], "--create")) {
       create_flag = 1;
       i++;
+    } else if (!strcmp(argv[i], "-S")) {
+      stats_flag = 1;
+      argv_restart[j++] = argv[i];
+      i++;
     } else if (!strcmp(argv[i], "-u")) {
       if (++i >= argc) startup_error("invalid usage");
       user = argv[i++];
@@ -758,8 +1010,10 @@ main(int argc, char *argv[])
 
   if (!(state = nsf_init(&params, 0))) return 1;
   if (nsf_prepare(state) < 0) return 1;
+  if (stats_flag) ns_stats_enable(state, 1);
   nsf_main_loop(state);
   restart_flag = nsf_is_restart_requested(state);
+  write_arena_stats();
   ns_unload_contests();
   nsf_cleanup(state);
   nsdb_default->iface->close(nsdb_default->data);
@@ -35,6 +35,7 @@ struct session_info
 {
   struct session_info *next;
   struct session_info *prev;
+  struct session_info *hash_next;
   ej_cookie_t _session_id;
   ej_cookie_t _client_key;
   time_t expire_time;
@@ -44,10 +45,23 @@ struct session_info
   int user_viewed_section;
 
   struct userlist_user *user_info;
+
+  // the last cookie validation reply of userlist-server
+  int cookie_cmd;               // 0, if nothing is cached
+  time_t cookie_check_time;
+  ej_ip_t cookie_ip;
+  int cookie_ssl_flag;
+  int cookie_user_id;
+  int cookie_contest_id;
+  int cookie_locale_id;
+  int cookie_role;
+  unsigned char *cookie_login;
+  unsigned char *cookie_name;
 };
 
 struct server_framework_state;
 struct client_state;
+struct nsf_write_source;
 
 struct http_request_info
 {
@@ -98,9 +112,14 @@ struct http_request_info
   int protocol_reply;
   int allow_empty_output;
   int no_reply;
+  // the output continues with the data from this source
+  struct nsf_write_source *out_source;
 
   struct timeval timestamp1;
   struct timeval timestamp2;
+
+  // the memory released at the end of the request, see ns_arena_alloc
+  struct tPageDesc *mem;
 };
 
 void
@@ -397,6 +416,11 @@ enum
   NEW_SRV_ACTION_PRIV_EDIT_RUN_ACTION,
   NEW_SRV_ACTION_PING,
   NEW_SRV_ACTION_SUBMIT_RUN_BATCH,
+  NEW_SRV_ACTION_SIMILAR_RUNS,
+  NEW_SRV_ACTION_VIEW_TEST_DIFF,
+  NEW_SRV_ACTION_PACK_RUNS,
+  NEW_SRV_ACTION_JSON_USER_EVENTS,
+  NEW_SRV_ACTION_SERVER_STATS,
 
   NEW_SRV_ACTION_LAST,
 };
@@ -539,9 +563,77 @@ ns_get_session(
 
 void ns_remove_session(ej_cookie_t session_id);
 
+/* cached replies of ULS_PRIV_GET_COOKIE/ULS_TEAM_GET_COOKIE */
+int ns_get_cached_cookie(
+        struct http_request_info *phr,
+        int cmd,
+        time_t cur_time);
+void ns_set_cached_cookie(
+        struct http_request_info *phr,
+        int cmd,
+        time_t cur_time);
+void ns_drop_cached_cookie(ej_cookie_t session_id);
+void ns_drop_cached_cookies(int contest_id);
+
 void ns_unload_contests(void);
 
 int  ns_loop_callback(struct server_framework_state *state);
+
+/* new_server_events.c: the changes of the runs and the clars of the user
+   after the runlog change `run_serial' and the clar `clar_total' are
+   written in JSON to fout (if not NULL), their number is returned */
+int
+ns_write_user_events(
+        FILE *fout,
+        const serve_state_t cs,
+        int user_id,
+        int run_serial,
+        int clar_total);
+/* parks the request until the changes or the deadline,
+   returns -1, if the request cannot wait, or the user waits
+   in too many requests already */
+int
+ns_wait_user_events(
+        struct http_request_info *phr,
+        int run_serial,
+        int clar_total,
+        time_t deadline);
+/* replies to the waiters with the changes or the deadline passed */
+void ns_check_event_waiters(time_t cur_time);
+
+/* new_server_stats.c: the performance statistics, nothing is
+   collected (and the clock should not be read) while
+   ns_stats_enabled is 0 */
+enum
+{
+  NS_STATS_PHASE_JOBS,          /* the background jobs */
+  NS_STATS_PHASE_PACKETS,       /* the compile and run packets */
+  NS_STATS_PHASE_COMMIT,        /* the runlog and audit log flush */
+
+  NS_STATS_PHASE_LAST
+};
+enum
+{
+  NS_STATS_PACKET_COMPILE,
+  NS_STATS_PACKET_RUN,
+
+  NS_STATS_PACKET_LAST
+};
+extern int ns_stats_enabled;
+long long ns_stats_get_usec(void);
+void ns_stats_enable(struct server_framework_state *state, int enable);
+void ns_stats_reset(void);
+void
+ns_stats_add_request(
+        int action,
+        int contest_id,
+        long long usec,
+        size_t out_size);
+void ns_stats_add_packet(int kind, long long usec);
+void ns_stats_add_phase(int phase, long long usec);
+/* writes the statistics report as the plain text, if contest_id > 0,
+   only the statistics of the contest are written */
+void ns_stats_write(FILE *out_f, int contest_id);
 void ns_post_select_callback(struct server_framework_state *state);
 
 unsigned char *
@@ -698,7 +790,7 @@ const unsigned char *ns_unparse_role(int role);
 
 void
 ns_write_tests(const serve_state_t cs, FILE *fout, FILE *log_f,
-               int action, int run_id, int test_num);
+               int action, int run_id, int test_num, int diff_mode);
 
 int
 ns_write_passwords(FILE *fout, FILE *log_f,
@@ -840,6 +932,23 @@ ns_cgi_param_int_opt_2(
         int *p_val,
         int *p_set_flag);
 
+/* the per-request memory: it is released all at once after the reply
+   is sent, so the returned pointers must not be freed */
+void *ns_arena_alloc(struct http_request_info *phr, size_t size);
+void *ns_arena_calloc(struct http_request_info *phr, size_t nelem, size_t size);
+unsigned char *ns_arena_strdup(
+        struct http_request_info *phr,
+        const unsigned char *str);
+const unsigned char *ns_arena_armor(
+        struct http_request_info *phr,
+        const unsigned char *str);
+/* called at the end of the request */
+void ns_arena_release(struct http_request_info *phr);
+/* writes the memory usage statistics per action */
+void ns_arena_write_stats(FILE *out_f);
+/* the symbolic name of the action or NULL */
+const unsigned char *ns_get_action_name(int action);
+
 struct server_framework_state;
 int ns_open_ul_connection(struct server_framework_state *state);
 
@@ -48,4 +48,10 @@ int new_server_clnt_http_request(
 
 int new_server_clnt_control(new_server_conn_t conn, int cmd);
 
+/* the performance statistics report of the server */
+int new_server_clnt_get_stats(
+        new_server_conn_t conn,
+        unsigned char **p_text,
+        size_t *p_size);
+
 #endif /* __NEW_SERVER_CLNT_H__ */
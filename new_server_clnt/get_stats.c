@@ -0,0 +1,103 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "ej_types.h"
+#include "new_server_clnt/new_server_clnt_priv.h"
+#include "new_server_proto.h"
+#include "errlog.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_osdeps.h"
+
+#include <unistd.h>
+
+/* the server writes the statistics report to the passed pipe and
+   closes it, the report is returned in *p_text */
+int
+new_server_clnt_get_stats(
+        new_server_conn_t conn,
+        unsigned char **p_text,
+        size_t *p_size)
+{
+  struct new_server_prot_packet *out = 0;
+  struct new_server_prot_packet *in = 0;
+  void *void_in = 0;
+  size_t in_size = 0, text_a = 0, text_u = 0;
+  int data_fd[2] = { -1, -1 }, pass_fd[2];
+  int errcode, r;
+  unsigned char *text = 0;
+  unsigned char buf[4096];
+
+  if (pipe(data_fd) < 0) {
+    err("new_server_clnt_get_stats: pipe() failed: %s", os_ErrorMsg());
+    return -NEW_SRV_ERR_SYSTEM_ERROR;
+  }
+  pass_fd[0] = data_fd[1];
+  pass_fd[1] = data_fd[1];
+  if ((errcode = new_server_clnt_pass_fd(conn, 2, pass_fd)) < 0)
+    goto failed;
+  close(data_fd[1]); data_fd[1] = -1;
+
+  out = alloca(sizeof(*out));
+  memset(out, 0, sizeof(*out));
+  out->magic = NEW_SERVER_PROT_PACKET_MAGIC;
+  out->id = NEW_SRV_CMD_GET_STATS;
+  if ((errcode = new_server_clnt_send_packet(conn, sizeof(*out), out)) < 0)
+    goto failed;
+  if ((errcode = new_server_clnt_recv_packet(conn, &in_size, &void_in)) < 0)
+    goto failed;
+  errcode = -NEW_SRV_ERR_PROTOCOL_ERROR;
+  if (in_size != sizeof(*in)) goto failed;
+  in = (struct new_server_prot_packet*) void_in;
+  if (in->magic != NEW_SERVER_PROT_PACKET_MAGIC) goto failed;
+  if ((errcode = in->id) < 0) goto failed;
+
+  text_a = 8192;
+  text = xmalloc(text_a);
+  while ((r = read(data_fd[0], buf, sizeof(buf))) > 0) {
+    if (text_u + r >= text_a) {
+      while (text_u + r >= text_a) text_a *= 2;
+      text = xrealloc(text, text_a);
+    }
+    memcpy(text + text_u, buf, r);
+    text_u += r;
+  }
+  text[text_u] = 0;
+  if (r < 0) {
+    err("new_server_clnt_get_stats: read() failed: %s", os_ErrorMsg());
+    errcode = -NEW_SRV_ERR_READ_ERROR;
+    goto failed;
+  }
+
+  *p_text = text; text = 0;
+  if (p_size) *p_size = text_u;
+  errcode = NEW_SRV_RPL_OK;
+
+ failed:
+  if (data_fd[0] >= 0) close(data_fd[0]);
+  if (data_fd[1] >= 0) close(data_fd[1]);
+  xfree(text);
+  xfree(void_in);
+  return errcode;
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make -C .."
+ *  c-font-lock-extra-types: ("\\sw+_t" "FILE")
+ * End:
+ */
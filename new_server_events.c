@@ -0,0 +1,299 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "new-server.h"
+#include "server_framework.h"
+#include "serve_state.h"
+#include "prepare.h"
+#include "runlog.h"
+#include "clarlog.h"
+#include "compat.h"
+#include "html.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The participants waiting for the changes of their runs and
+ * clarifications. A waiter keeps the output descriptors of the CGI
+ * request, the reply is written to them, when a relevant change
+ * happens or the waiting time is over. The waiter remembers the runlog
+ * change serial and the number of the clarifications it has seen, so
+ * the waiters of the contests without changes are skipped by two
+ * integer comparisons.
+ */
+
+enum
+{
+  MAX_EVENT_WAITERS = 10000,
+  MAX_EVENT_WAITERS_PER_USER = 8,
+  MAX_EVENT_CHANGES = 1024,
+};
+
+struct event_waiter
+{
+  struct event_waiter *next, *prev;
+  struct server_framework_state *fw_state;
+  int contest_id;
+  int user_id;
+  int run_serial;
+  int clar_total;
+  time_t deadline;
+  int client_fds[2];
+};
+
+static struct event_waiter *first_waiter, *last_waiter;
+static int waiter_count;
+
+/* writes the run as in new_write_user_runs, returns 0,
+   if the run is not shown to the user, fout may be NULL */
+static int
+write_user_run(FILE *fout, const serve_state_t cs, int user_id, int run_id,
+               time_t start_time, int count)
+{
+  const struct section_global_data *global = cs->global;
+  const struct section_problem_data *prob;
+  struct run_entry re;
+  int status, score, test, test_cell, score_cell, separate_user_score;
+  int attempts, disq_attempts, prev_successes;
+  unsigned char stat_str[128];
+
+  if (run_get_entry(cs->runlog_state, run_id, &re) < 0) return 0;
+  if (re.status == RUN_VIRTUAL_START || re.status == RUN_VIRTUAL_STOP
+      || re.status == RUN_EMPTY)
+    return 0;
+  if (re.user_id != user_id) return 0;
+  if (re.prob_id <= 0 || re.prob_id > cs->max_prob || !cs->probs
+      || !(prob = cs->probs[re.prob_id]))
+    return 0;
+  if (!fout) return 1;
+
+  // the same cells, as write_html_run_status fills for the user
+  get_run_status_cells(cs, &re, 1 /* user_mode */, 0, 0,
+                       &status, &test_cell, &test, &score_cell, &score);
+  run_status_str(status, stat_str, sizeof(stat_str),
+                 prob->type, prob->scoring_checker);
+
+  fprintf(fout, "%s\n    { \"run_id\": %d, \"status\": %d, \"status_str\": \"%s\"",
+          count > 0?",":"", run_id, status, stat_str);
+  if (test_cell == RUN_CELL_VALUE || test_cell == RUN_CELL_FAILED_TEST)
+    fprintf(fout, ", \"test\": %d", test);
+  if (score_cell == RUN_CELL_VALUE) {
+    if (global->score_system != SCORE_MOSCOW) {
+      separate_user_score = global->separate_user_score > 0
+        && cs->online_view_judge_score <= 0;
+      get_user_run_attempts(cs, &re, prob, status,
+                            &attempts, &disq_attempts, &prev_successes);
+      score = calc_kirov_score(0, 0, start_time, separate_user_score, 1,
+                               &re, prob, attempts, disq_attempts,
+                               prev_successes, 0, 0);
+    }
+    fprintf(fout, ", \"score\": %d", score);
+  }
+  fprintf(fout, " }");
+  return 1;
+}
+
+int
+ns_write_user_events(
+        FILE *fout,
+        const serve_state_t cs,
+        int user_id,
+        int run_serial,
+        int clar_total)
+{
+  const struct section_global_data *global = cs->global;
+  int cur_serial, cur_clar_total, run_count = 0, clar_count = 0;
+  int change_count = 0, i, j;
+  int changes[MAX_EVENT_CHANGES];
+  struct clar_entry_v1 clar;
+  time_t start_time;
+
+  cur_serial = run_get_change_serial(cs->runlog_state);
+  cur_clar_total = clar_get_total(cs->clarlog_state);
+  if (run_serial >= 0) {
+    change_count = run_get_changes(cs->runlog_state, run_serial,
+                                   MAX_EVENT_CHANGES, changes);
+  }
+  if (run_serial < 0 || change_count < 0 || clar_total < 0
+      || clar_total > cur_clar_total) {
+    // the client must reload the full state
+    if (!fout) return 1;
+    fprintf(fout, "{\n  \"run_serial\": %d,\n  \"clar_total\": %d,\n"
+            "  \"reset\": 1\n}\n", cur_serial, cur_clar_total);
+    return 1;
+  }
+
+  start_time = run_get_start_time(cs->runlog_state);
+  if (global->is_virtual)
+    start_time = run_get_virtual_start_time(cs->runlog_state, user_id);
+
+  if (fout)
+    fprintf(fout, "{\n  \"run_serial\": %d,\n  \"clar_total\": %d,\n"
+            "  \"runs\": [", cur_serial, cur_clar_total);
+  for (i = 0; i < change_count; ++i) {
+    // a run may change several times, report it once
+    for (j = 0; j < i && changes[j] != changes[i]; ++j);
+    if (j < i) continue;
+    run_count += write_user_run(fout, cs, user_id, changes[i], start_time,
+                                run_count);
+  }
+  if (fout)
+    fprintf(fout, "%s],\n  \"clars\": [", run_count > 0?"\n  ":"");
+
+  for (i = clar_total; i < cur_clar_total; ++i) {
+    if (clar_get_record(cs->clarlog_state, i, &clar) < 0) continue;
+    if (!is_clar_visible_to_user(&clar, user_id, start_time)) continue;
+    if (fout) fprintf(fout, "%s %d", clar_count > 0?",":"", clar.id);
+    ++clar_count;
+  }
+  if (fout) fprintf(fout, " ]\n}\n");
+
+  return run_count + clar_count;
+}
+
+static struct event_waiter *
+remove_waiter(struct event_waiter *w)
+{
+  struct event_waiter *next = w->next;
+
+  if (w->prev) w->prev->next = w->next;
+  else first_waiter = w->next;
+  if (w->next) w->next->prev = w->prev;
+  else last_waiter = w->prev;
+  --waiter_count;
+  if (w->client_fds[0] >= 0) close(w->client_fds[0]);
+  if (w->client_fds[1] >= 0) close(w->client_fds[1]);
+  xfree(w);
+  return next;
+}
+
+int
+ns_wait_user_events(
+        struct http_request_info *phr,
+        int run_serial,
+        int clar_total,
+        time_t deadline)
+{
+  struct client_state *p = phr->client_state;
+  struct event_waiter *w;
+  int user_count = 0;
+
+  if (!p || p->client_fds[0] < 0 || waiter_count >= MAX_EVENT_WAITERS)
+    return -1;
+  // several tabs of a browser are fine, but one user must not
+  // take all the slots
+  for (w = first_waiter; w; w = w->next) {
+    if (w->contest_id == phr->contest_id && w->user_id == phr->user_id
+        && ++user_count >= MAX_EVENT_WAITERS_PER_USER)
+      return -1;
+  }
+
+  XCALLOC(w, 1);
+  w->fw_state = phr->fw_state;
+  w->contest_id = phr->contest_id;
+  w->user_id = phr->user_id;
+  w->run_serial = run_serial;
+  w->clar_total = clar_total;
+  w->deadline = deadline;
+  w->client_fds[0] = p->client_fds[0];
+  w->client_fds[1] = p->client_fds[1];
+  p->client_fds[0] = -1;
+  p->client_fds[1] = -1;
+
+  w->prev = last_waiter;
+  if (last_waiter) last_waiter->next = w;
+  else first_waiter = w;
+  last_waiter = w;
+  ++waiter_count;
+
+  // the reply is written later, now just complete the request
+  phr->allow_empty_output = 1;
+  return 0;
+}
+
+static void
+reply_waiter(struct event_waiter *w, const serve_state_t cs)
+{
+  char *out_t = 0;
+  size_t out_z = 0;
+  FILE *out_f;
+
+  out_f = open_memstream(&out_t, &out_z);
+  fprintf(out_f, "Content-type: text/plain; charset=%s\n"
+          "Cache-Control: no-cache\n\n", EJUDGE_CHARSET);
+  if (cs) {
+    ns_write_user_events(out_f, cs, w->user_id, w->run_serial, w->clar_total);
+  } else {
+    // the contest is unloaded
+    fprintf(out_f, "{\n  \"run_serial\": -1,\n  \"clar_total\": -1,\n"
+            "  \"reset\": 1\n}\n");
+  }
+  close_memstream(out_f); out_f = 0;
+  nsf_new_autoclose_fds(w->fw_state, w->client_fds, out_t, out_z);
+}
+
+void
+ns_check_event_waiters(time_t cur_time)
+{
+  struct event_waiter *w;
+  struct contest_extra *extra;
+  serve_state_t cs;
+  int serial, clar_total;
+
+  for (w = first_waiter; w; ) {
+    cs = 0;
+    if ((extra = ns_try_contest_extra(w->contest_id)))
+      cs = extra->serve_state;
+    if (!cs) {
+      reply_waiter(w, 0);
+      w = remove_waiter(w);
+      continue;
+    }
+    serial = run_get_change_serial(cs->runlog_state);
+    clar_total = clar_get_total(cs->clarlog_state);
+    if (w->run_serial == serial && w->clar_total == clar_total
+        && w->deadline > cur_time) {
+      w = w->next;
+      continue;
+    }
+    if (w->deadline > cur_time
+        && !ns_write_user_events(0, cs, w->user_id, w->run_serial,
+                                 w->clar_total)) {
+      // the changes do not concern the user
+      w->run_serial = serial;
+      w->clar_total = clar_total;
+      w = w->next;
+      continue;
+    }
+    reply_waiter(w, cs);
+    w = remove_waiter(w);
+  }
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
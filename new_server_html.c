@@ -48,6 +48,8 @@
 #include "clarlog.h"
 #include "team_extra.h"
 #include "diff.h"
+#include "similarity_index.h"
+#include "run_pack.h"
 #include "protocol.h"
 #include "printing.h"
 #include "sformat.h"
@@ -59,6 +61,7 @@
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
 #include "reuse_osdeps.h"
+#include "reuse_mempage.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -450,9 +453,11 @@ ns_loop_callback(struct server_framework_state *state)
   int contest_id, i, eind;
   strarray_t files;
   int count = 0;
+  long long t1 = 0, t2 = 0;
 
   memset(&files, 0, sizeof(files));
 
+  if (ns_stats_enabled) t1 = ns_stats_get_usec();
   if (job_first) {
     if (job_first->contest_id > 0) {
       e = ns_try_contest_extra(job_first->contest_id);
@@ -462,6 +467,10 @@ ns_loop_callback(struct server_framework_state *state)
       ns_remove_job(job_first);
     }
   }
+  if (ns_stats_enabled) {
+    t2 = ns_stats_get_usec();
+    ns_stats_add_phase(NS_STATS_PHASE_JOBS, t2 - t1);
+  }
 
   for (eind = 0; eind < extra_u; eind++) {
     e = extras[eind];
@@ -483,10 +492,15 @@ ns_loop_callback(struct server_framework_state *state)
       if (files.u <= 0) continue;
       for (int j = 0; j < files.u && count < MAX_WORK_BATCH; ++j) {
         ++count;
+        if (ns_stats_enabled) t1 = ns_stats_get_usec();
         serve_read_compile_packet(ejudge_config, cs, cnts,
                                   cs->compile_dirs[i].status_dir,
                                   cs->compile_dirs[i].report_dir,
                                   files.v[j]);
+        if (ns_stats_enabled) {
+          ns_stats_add_packet(NS_STATS_PACKET_COMPILE,
+                              ns_stats_get_usec() - t1);
+        }
       }
       e->last_access_time = cur_time;
       xstrarrayfree(&files);
@@ -498,11 +512,15 @@ ns_loop_callback(struct server_framework_state *state)
         continue;
       for (int j = 0; j < files.u && count < MAX_WORK_BATCH; ++j) {
         ++count;
+        if (ns_stats_enabled) t1 = ns_stats_get_usec();
         serve_read_run_packet(ejudge_config, cs, cnts,
                               cs->run_dirs[i].status_dir,
                               cs->run_dirs[i].report_dir,
                               cs->run_dirs[i].full_report_dir,
                               files.v[j]);
+        if (ns_stats_enabled) {
+          ns_stats_add_packet(NS_STATS_PACKET_RUN, ns_stats_get_usec() - t1);
+        }
       }
       e->last_access_time = cur_time;
       xstrarrayfree(&files);
@@ -511,6 +529,21 @@ ns_loop_callback(struct server_framework_state *state)
     if (cs->pending_xml_import && !serve_count_transient_runs(cs))
       handle_pending_xml_import(cnts, cs);
   }
+  if (ns_stats_enabled) {
+    t1 = ns_stats_get_usec();
+    // the contest events and the log updates are counted as packets
+    if (t2 > 0) ns_stats_add_phase(NS_STATS_PHASE_PACKETS, t1 - t2);
+  }
+
+  // the changes made by the requests and the packets above
+  for (eind = 0; eind < extra_u; eind++) {
+    if (!(cs = extras[eind]->serve_state)) continue;
+    runlog_commit(cs->runlog_state);
+    serve_flush_audit_log(cs);
+  }
+  ns_check_event_waiters(cur_time);
+  if (ns_stats_enabled && t1 > 0)
+    ns_stats_add_phase(NS_STATS_PHASE_COMMIT, ns_stats_get_usec() - t1);
 
   ns_unload_expired_contests(cur_time);
   xstrarrayfree(&files);
@@ -719,6 +752,7 @@ ul_conn_callback(struct server_framework_state *state,
         break;
       } else {
         info("userlist-server notification: %d", contest_id);
+        ns_drop_cached_cookies(contest_id);
         if (e->serve_state && e->serve_state->teamdb_state)
           teamdb_set_update_flag(e->serve_state->teamdb_state);
         if (userlist_clnt_bytes_available(ul_conn) <= 0) break;
@@ -738,6 +772,7 @@ ul_notification_callback(void *user_data, int contest_id)
     err("userlist-server notification: %d - no such contest", contest_id);
   } else {
     info("userlist-server notification: %d", contest_id);
+    ns_drop_cached_cookies(contest_id);
     if (e->serve_state && e->serve_state->teamdb_state)
       teamdb_set_update_flag(e->serve_state->teamdb_state);
   }
@@ -1875,11 +1910,11 @@ priv_user_operation(FILE *fout,
       FAIL(NEW_SRV_ERR_INV_STATUS);
     if (opcaps_check(phr->caps, OPCAP_EDIT_REG) < 0)
       FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
-    if (!(t_extra = team_extra_get_entry(cs->team_extra_state, user_id)))
-      FAIL(NEW_SRV_ERR_DISK_READ_ERROR);
-    if (t_extra->status == new_status) goto cleanup;
-    team_extra_set_status(cs->team_extra_state, user_id, new_status);
-    team_extra_flush(cs->team_extra_state);
+    t_extra = team_extra_get_entry(cs->team_extra_state, user_id);
+    if ((t_extra?t_extra->status:0) == new_status) goto cleanup;
+    if (team_extra_set_status(cs->team_extra_state, user_id, new_status) < 0
+        || team_extra_flush(cs->team_extra_state) < 0)
+      FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
     break;
   }
 
@@ -1927,9 +1962,11 @@ priv_user_issue_warning(
     cmt_txt[cmt_len] = 0;
   }
 
-  team_extra_append_warning(cs->team_extra_state, user_id, phr->user_id,
-                            &phr->ip, cs->current_time, warn_txt, cmt_txt);
-  team_extra_flush(cs->team_extra_state);
+  if (team_extra_append_warning(cs->team_extra_state, user_id, phr->user_id,
+                                &phr->ip, cs->current_time, warn_txt,
+                                cmt_txt) < 0
+      || team_extra_flush(cs->team_extra_state) < 0)
+    FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
 
  cleanup:
   xfree(warn_txt);
@@ -2100,8 +2137,10 @@ priv_user_disqualify(
     goto cleanup;
   }
 
-  team_extra_set_disq_comment(cs->team_extra_state, user_id, warn_txt);
-  team_extra_flush(cs->team_extra_state);
+  if (team_extra_set_disq_comment(cs->team_extra_state, user_id,
+                                  warn_txt) < 0
+      || team_extra_flush(cs->team_extra_state) < 0)
+    FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
 
  cleanup:
   xfree(warn_txt);
@@ -2501,6 +2540,7 @@ priv_change_language(FILE *fout,
                                     new_locale_id)) < 0) {
     ns_error(log_f, NEW_SRV_ERR_SESSION_UPDATE_FAILED, userlist_strerror(-r));
   }
+  ns_drop_cached_cookie(phr->session_id);
   return 0;
 
  invalid_param:
@@ -2969,6 +3009,7 @@ priv_submit_run(FILE *fout,
     ns_error(log_f, NEW_SRV_ERR_DISK_WRITE_ERROR);
     goto cleanup;
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
 
   if (prob->type == PROB_TYPE_STANDARD) {
     // automatically tested programs
@@ -3782,6 +3823,7 @@ priv_clear_run(FILE *fout, FILE *log_f,
     FAIL(NEW_SRV_ERR_INV_RUN_ID);
   if (run_clear_entry(cs->runlog_state, run_id) < 0)
     FAIL(NEW_SRV_ERR_RUNLOG_UPDATE_FAILED);
+  serve_invalidate_similarity_index(cs, run_id);
 
   if (re.store_flags == 1) {
     uuid_archive_remove(cs, re.run_uuid);
@@ -4044,6 +4086,8 @@ priv_edit_run(FILE *fout, FILE *log_f,
 
   if (run_set_entry(cs->runlog_state, run_id, ne_mask, &ne) < 0)
     FAIL(NEW_SRV_ERR_RUNLOG_UPDATE_FAILED);
+  if ((ne_mask & (RE_USER_ID | RE_PROB_ID | RE_LANG_ID)))
+    serve_invalidate_similarity_index(cs, run_id);
 
   serve_audit_log(cs, run_id, &re, phr->user_id, &phr->ip, phr->ssl_flag,
                   audit_cmd, "ok", -1,
@@ -4708,6 +4752,7 @@ priv_new_run(FILE *fout,
     goto cleanup;
   }
   run_set_entry(cs->runlog_state, run_id, re_flags, &re);
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
 
   serve_audit_log(cs, run_id, NULL, phr->user_id, &phr->ip, phr->ssl_flag,
                   "priv-new-run", "ok", RUN_PENDING, NULL);
@@ -5027,7 +5072,7 @@ priv_diff_page(FILE *fout,
 {
   const serve_state_t cs = extra->serve_state;
   const unsigned char *s;
-  int run_id1, run_id2, n, total_runs;
+  int run_id1, run_id2, n, total_runs, diff_mode = 0;
   int retval = 0;
 
   total_runs = run_get_total(cs->runlog_state);
@@ -5037,10 +5082,12 @@ priv_diff_page(FILE *fout,
   if (n < 0 || sscanf(s, "%d%n", &run_id2, &n) != 1 || s[n]
       || run_id2 < 0 || run_id2 >= total_runs)
     FAIL(NEW_SRV_ERR_INV_RUN_TO_COMPARE);
+  if (ns_cgi_param_int_opt(phr, "diff_mode", &diff_mode, 0) < 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
   if (opcaps_check(phr->caps, OPCAP_VIEW_SOURCE) < 0)
     FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
 
-  if (compare_runs(cs, fout, run_id1, run_id2) < 0)
+  if (compare_runs(cs, fout, run_id1, run_id2, diff_mode) < 0)
     FAIL(NEW_SRV_ERR_RUN_COMPARE_FAILED);
 
  cleanup:
@@ -5050,6 +5097,145 @@ priv_diff_page(FILE *fout,
   return -1;
 }
 
+/*
+ * The runs similar to the given run (run_id), or all the pairs of
+ * similar runs of the problem (prob_id) with score >= threshold.
+ */
+static int
+priv_similar_runs_page(
+        FILE *fout,
+        FILE *log_f,
+        struct http_request_info *phr,
+        const struct contest_desc *cnts,
+        struct contest_extra *extra)
+{
+  serve_state_t cs = extra->serve_state;
+  struct similarity_match *matches = 0;
+  struct run_entry re1, re2;
+  const unsigned char *login1, *login2;
+  int run_id = -1, prob_id = 0, threshold = 0, count = 0, same_user = 0;
+  int match_u, i;
+  int retval = 0;
+
+  if (opcaps_check(phr->caps, OPCAP_VIEW_SOURCE) < 0)
+    FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
+  if (ns_cgi_param_int_opt(phr, "run_id", &run_id, -1) < 0)
+    FAIL(NEW_SRV_ERR_INV_RUN_ID);
+  if (ns_cgi_param_int_opt(phr, "prob_id", &prob_id, 0) < 0)
+    FAIL(NEW_SRV_ERR_INV_PROB_ID);
+  if (ns_cgi_param_int_opt(phr, "threshold", &threshold, 50) < 0
+      || threshold < 0 || threshold > 100)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+  if (ns_cgi_param_int_opt(phr, "count", &count, 20) < 0 || count <= 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+  if (ns_cgi_param_int_opt(phr, "same_user", &same_user, 0) < 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+  if (run_id < 0 && prob_id <= 0) FAIL(NEW_SRV_ERR_INV_PARAM);
+  if (run_id >= run_get_total(cs->runlog_state))
+    FAIL(NEW_SRV_ERR_INV_RUN_ID);
+  if (run_id < 0 && (prob_id > cs->max_prob || !cs->probs[prob_id]))
+    FAIL(NEW_SRV_ERR_INV_PROB_ID);
+
+  serve_update_similarity_index(cs);
+  if (run_id >= 0) {
+    XCALLOC(matches, count);
+    if ((match_u = similarity_index_top(cs->similarity_index, run_id,
+                                        same_user, count, matches)) < 0)
+      FAIL(NEW_SRV_ERR_INV_RUN_ID);
+  } else {
+    match_u = similarity_index_pairs(cs->similarity_index, prob_id,
+                                     same_user, threshold, &matches);
+  }
+
+  fprintf(fout, "Content-type: text/plain\n\n");
+  fprintf(fout, "# run_id1\tlogin1\trun_id2\tlogin2\tscore\tshared\n");
+  for (i = 0; i < match_u; ++i) {
+    if (run_get_entry(cs->runlog_state, matches[i].run_id1, &re1) < 0
+        || run_get_entry(cs->runlog_state, matches[i].run_id2, &re2) < 0)
+      continue;
+    // the user may be removed from the contest
+    if (!(login1 = teamdb_get_login(cs->teamdb_state, re1.user_id)))
+      login1 = "";
+    if (!(login2 = teamdb_get_login(cs->teamdb_state, re2.user_id)))
+      login2 = "";
+    fprintf(fout, "%d\t%s\t%d\t%s\t%d\t%d\n",
+            matches[i].run_id1, login1, matches[i].run_id2, login2,
+            matches[i].score, matches[i].shared);
+  }
+
+ cleanup:
+  xfree(matches);
+  return retval;
+}
+
+/*
+ * Schedules the job, which moves the artifacts of the judged runs to
+ * the pack store and the audit logs to the audit log store, and
+ * compacts the stores, if there is much garbage, compact=1 forces
+ * the compaction. The progress is shown on the job list.
+ */
+static int
+priv_pack_runs(
+        FILE *fout,
+        FILE *log_f,
+        struct http_request_info *phr,
+        const struct contest_desc *cnts,
+        struct contest_extra *extra)
+{
+  serve_state_t cs = extra->serve_state;
+  int compact_flag = 0;
+  int retval = 0;
+  struct server_framework_job *job;
+
+  if (opcaps_check(phr->caps, OPCAP_CONTROL_CONTEST) < 0)
+    FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
+  if (ns_cgi_param_int_opt(phr, "compact", &compact_flag, 0) < 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+
+  if (cs->pack_runs_job) {
+    fprintf(fout, "Content-type: text/plain\n\n");
+    fprintf(fout, "Packing is already in progress\n");
+    goto cleanup;
+  }
+  if (!(job = serve_pack_runs(cnts, cs, compact_flag)))
+    FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
+  ns_add_job(job);
+  fprintf(fout, "Content-type: text/plain\n\n");
+  fprintf(fout, "Packing scheduled\n");
+
+ cleanup:
+  return retval;
+}
+
+/*
+ * The performance statistics of the server, they are collected
+ * while enabled by ej-contests-control or the -S option. The whole
+ * report requires the global CONTROL_CONTEST capability, otherwise
+ * only the statistics of the current contest are shown.
+ */
+static int
+priv_server_stats_page(
+        FILE *fout,
+        FILE *log_f,
+        struct http_request_info *phr,
+        const struct contest_desc *cnts,
+        struct contest_extra *extra)
+{
+  int retval = 0, contest_id = 0;
+
+  if (opcaps_check(phr->dbcaps, OPCAP_CONTROL_CONTEST) < 0) {
+    if (opcaps_check(phr->caps, OPCAP_CONTROL_CONTEST) < 0)
+      FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
+    contest_id = cnts->id;
+  }
+
+  fprintf(fout, "Content-type: text/plain; charset=%s\n\n", EJUDGE_CHARSET);
+  ns_stats_write(fout, contest_id);
+
+ cleanup:
+  return retval;
+}
+
 static int
 priv_user_detail_page(FILE *fout,
                       FILE *log_f,
@@ -5262,6 +5448,7 @@ priv_view_users_page(
 {
   int r;
   unsigned char *xml_text = 0;
+  struct xml_arena *users_arena = 0;
   struct userlist_list *users = 0;
   const struct userlist_user *u = 0;
   const struct userlist_contest *uc = 0;
@@ -5286,10 +5473,14 @@ priv_view_users_page(
     return ns_html_err_internal_error(fout, phr, 1,
                                       "list_all_users failed: %s",
                                       userlist_strerror(-r));
-  users = userlist_parse_str(xml_text);
+  // the list is only shown, so it is built in an arena and freed at once
+  users_arena = xml_arena_create();
+  users = userlist_parse_str_arena(xml_text, users_arena);
   xfree(xml_text); xml_text = 0;
-  if (!users)
+  if (!users) {
+    xml_arena_free(users_arena);
     return ns_html_err_internal_error(fout, phr, 1, "XML parsing failed");
+  }
 
   if (users->user_map_size > 0) {
     XCALLOC(run_counts, users->user_map_size);
@@ -5490,7 +5681,7 @@ priv_view_users_page(
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
   l10n_setlocale(0);
 
-  if (users) userlist_free(&users->b);
+  xml_arena_free(users_arena);
   html_armor_free(&ab);
   xfree(run_counts);
   xfree(run_sizes);
@@ -5766,12 +5957,11 @@ priv_download_source(
 {
   serve_state_t cs = extra->serve_state;
   const struct section_global_data *global = cs->global;
-  int run_id, n, src_flags, no_disp = 0, x;
+  int run_id, n, no_disp = 0, x;
   const unsigned char *s;
   const struct section_problem_data *prob = 0;
   const struct section_language_data *lang = 0;
   struct run_entry re;
-  path_t src_path;
   char *run_text = 0;
   size_t run_size = 0;
   int retval = 0;
@@ -5793,11 +5983,9 @@ priv_download_source(
       || (re.status > RUN_MAX_STATUS && re.status < RUN_TRANSIENT_FIRST))
     FAIL(NEW_SRV_ERR_SOURCE_UNAVAILABLE);
 
-  if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                              &run_text, &run_size) < 0)
     FAIL(NEW_SRV_ERR_SOURCE_NONEXISTANT);
-  }
-  if (generic_read_file(&run_text, 0, &run_size, src_flags, 0, src_path, 0)<0)
-    FAIL(NEW_SRV_ERR_DISK_READ_ERROR);
 
   if (prob->type > 0) {
     content_type = mime_type_get_type(re.mime_type);
@@ -6020,7 +6208,7 @@ priv_view_test(FILE *fout,
                struct contest_extra *extra)
 {
   const serve_state_t cs = extra->serve_state;
-  int run_id, test_num, n, retval = 0;
+  int run_id, test_num, n, retval = 0, diff_mode = 0;
   const unsigned char *s = 0;
 
   // run_id, test_num
@@ -6030,13 +6218,15 @@ priv_view_test(FILE *fout,
     ns_html_err_inv_param(fout, phr, 1, "cannot parse test_num");
     return -1;
   }
+  if (ns_cgi_param_int_opt(phr, "diff_mode", &diff_mode, 0) < 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
 
   if (opcaps_check(phr->caps, OPCAP_VIEW_REPORT) < 0)
     FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
 
   if (test_num <= 0) FAIL(NEW_SRV_ERR_INV_TEST);
 
-  ns_write_tests(cs, fout, log_f, phr->action, run_id, test_num);
+  ns_write_tests(cs, fout, log_f, phr->action, run_id, test_num, diff_mode);
 
  cleanup:
   return retval;
@@ -6104,7 +6294,7 @@ priv_upload_runlog_csv_2(
   char *log_text = 0;
   size_t log_size = 0;
   FILE *ff = 0;
-  unsigned char *ss = 0;
+  const unsigned char *ss = 0;
   int import_mode = -1;
 
   if (opcaps_check(phr->caps, OPCAP_IMPORT_XML_RUNS) < 0)
@@ -6156,13 +6346,12 @@ priv_upload_runlog_csv_2(
           ns_aref(bb, sizeof(bb), phr, NEW_SRV_ACTION_MAIN_PAGE, 0),
           _("Main page"));
 
-  ss = html_armor_string_dup(log_text);
+  ss = ns_arena_armor(phr, log_text);
   fprintf(fout, "<hr/><pre>");
   if (r < 0) fprintf(fout, "<font color=\"red\">");
   fprintf(fout, "%s", ss);
   if (r < 0) fprintf(fout, "</font>");
   fprintf(fout, "</pre>\n");
-  xfree(ss); ss = 0;
   xfree(log_text); log_text = 0;
 
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
@@ -6171,7 +6360,6 @@ priv_upload_runlog_csv_2(
  cleanup:
   if (ff) fclose(ff);
   xfree(log_text);
-  xfree(ss);
   return retval;
 }
 
@@ -6223,7 +6411,7 @@ priv_upload_runlog_xml_2(
   char *log_text = 0;
   size_t log_size = 0;
   FILE *ff = 0;
-  unsigned char *ss = 0;
+  const unsigned char *ss = 0;
 
   if (phr->role < USER_ROLE_ADMIN
       || opcaps_check(phr->caps, OPCAP_IMPORT_XML_RUNS) < 0)
@@ -6256,11 +6444,10 @@ priv_upload_runlog_xml_2(
           ns_aref(bb, sizeof(bb), phr, NEW_SRV_ACTION_MAIN_PAGE, 0),
           _("Main page"));
 
-  ss = html_armor_string_dup(log_text);
+  ss = ns_arena_armor(phr, log_text);
   fprintf(fout, "<hr/><pre>");
   fprintf(fout, "%s", ss);
   fprintf(fout, "</pre>\n");
-  xfree(ss); ss = 0;
   xfree(log_text); log_text = 0;
 
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
@@ -6269,7 +6456,6 @@ priv_upload_runlog_xml_2(
  cleanup:
   if (ff) fclose(ff);
   xfree(log_text);
-  xfree(ss);
   return retval;
 }
 
@@ -7204,7 +7390,7 @@ priv_print_user_exam_protocol(
   size_t log_size = 0;
   FILE *ff = 0;
   unsigned char bb[1024];
-  unsigned char *ss = 0;
+  const unsigned char *ss = 0;
   int locale_id = 0;
   int use_user_printer = 0;
   int full_report = 0;
@@ -7248,13 +7434,12 @@ priv_print_user_exam_protocol(
           ns_aref(bb, sizeof(bb), phr, NEW_SRV_ACTION_MAIN_PAGE, 0),
           _("Main page"));
 
-  ss = html_armor_string_dup(log_text);
+  ss = ns_arena_armor(phr, log_text);
   fprintf(fout, "<hr/><pre>");
   if (r < 0) fprintf(fout, "<font color=\"red\">");
   fprintf(fout, "%s", ss);
   if (r < 0) fprintf(fout, "</font>");
   fprintf(fout, "</pre>\n");
-  xfree(ss); ss = 0;
   xfree(log_text); log_text = 0;
 
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
@@ -7262,7 +7447,6 @@ priv_print_user_exam_protocol(
 
  cleanup:
   if (ff) fclose(ff);
-  xfree(ss);
   xfree(log_text);
   return retval;
 }
@@ -7281,7 +7465,7 @@ priv_print_users_exam_protocol(
   size_t log_size = 0;
   FILE *ff = 0;
   unsigned char bb[1024];
-  unsigned char *ss = 0;
+  const unsigned char *ss = 0;
   int locale_id = 0, i, x, n;
   intarray_t uset;
   const unsigned char *s;
@@ -7351,13 +7535,12 @@ priv_print_users_exam_protocol(
           ns_aref(bb, sizeof(bb), phr, NEW_SRV_ACTION_MAIN_PAGE, 0),
           _("Main page"));
 
-  ss = html_armor_string_dup(log_text);
+  ss = ns_arena_armor(phr, log_text);
   fprintf(fout, "<hr/><pre>");
   if (r < 0) fprintf(fout, "<font color=\"red\">");
   fprintf(fout, "%s", ss);
   if (r < 0) fprintf(fout, "</font>");
   fprintf(fout, "</pre>\n");
-  xfree(ss); ss = 0;
   xfree(log_text); log_text = 0;
 
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
@@ -7366,7 +7549,6 @@ priv_print_users_exam_protocol(
  cleanup:
   if (ff) fclose(ff);
   xfree(uset.v);
-  xfree(ss);
   xfree(log_text);
   return retval;
 }
@@ -7385,7 +7567,7 @@ priv_print_problem_exam_protocol(
   size_t log_size = 0;
   FILE *ff = 0;
   unsigned char bb[1024];
-  unsigned char *ss = 0;
+  const unsigned char *ss = 0;
   int locale_id = 0;
   int prob_id;
 
@@ -7417,13 +7599,12 @@ priv_print_problem_exam_protocol(
           ns_aref(bb, sizeof(bb), phr, NEW_SRV_ACTION_MAIN_PAGE, 0),
           _("Main page"));
 
-  ss = html_armor_string_dup(log_text);
+  ss = ns_arena_armor(phr, log_text);
   fprintf(fout, "<hr/><pre>");
   if (r < 0) fprintf(fout, "<font color=\"red\">");
   fprintf(fout, "%s", ss);
   if (r < 0) fprintf(fout, "</font>");
   fprintf(fout, "</pre>\n");
-  xfree(ss); ss = 0;
   xfree(log_text); log_text = 0;
 
   ns_footer(fout, extra->footer_txt, extra->copyright_txt, phr->locale_id);
@@ -7431,7 +7612,6 @@ priv_print_problem_exam_protocol(
 
  cleanup:
   if (ff) fclose(ff);
-  xfree(ss);
   xfree(log_text);
   return retval;
 }
@@ -7893,6 +8073,10 @@ static action_handler2_t priv_actions_table_2[NEW_SRV_ACTION_LAST] =
   [NEW_SRV_ACTION_PRIV_EDIT_RUN_PAGE] = priv_edit_run_page,
   [NEW_SRV_ACTION_PING] = ping_page,
   [NEW_SRV_ACTION_SUBMIT_RUN_BATCH] = priv_submit_run_batch_page,
+  [NEW_SRV_ACTION_SIMILAR_RUNS] = priv_similar_runs_page,
+  [NEW_SRV_ACTION_VIEW_TEST_DIFF] = priv_view_test,
+  [NEW_SRV_ACTION_PACK_RUNS] = priv_pack_runs,
+  [NEW_SRV_ACTION_SERVER_STATS] = priv_server_stats_page,
 };
 
 static void
@@ -8572,6 +8756,9 @@ priv_main_page(FILE *fout,
     fprintf(fout, "<li>%s%s</a></li>\n",
             ns_aref(hbuf, sizeof(hbuf), phr, NEW_SRV_ACTION_ADMIN_CONTEST_SETTINGS, 0),
             _("Contest settings"));
+    fprintf(fout, "<li>%s%s</a></li>\n",
+            ns_aref(hbuf, sizeof(hbuf), phr, NEW_SRV_ACTION_SERVER_STATS, 0),
+            _("Server performance statistics"));
   }
   if (cnts->problems_url) {
     fprintf(fout, "<li><a href=\"%s\" target=_blank>%s</a>\n",
@@ -9401,6 +9588,10 @@ static action_handler_t actions_table[NEW_SRV_ACTION_LAST] =
   [NEW_SRV_ACTION_PRIV_EDIT_RUN_ACTION] = priv_generic_operation, ///
   [NEW_SRV_ACTION_PING] = priv_generic_page,
   [NEW_SRV_ACTION_SUBMIT_RUN_BATCH] = priv_generic_page,
+  [NEW_SRV_ACTION_SIMILAR_RUNS] = priv_generic_page,
+  [NEW_SRV_ACTION_VIEW_TEST_DIFF] = priv_generic_page,
+  [NEW_SRV_ACTION_PACK_RUNS] = priv_generic_page,
+  [NEW_SRV_ACTION_SERVER_STATS] = priv_generic_page,
 };
 
 static unsigned char *
@@ -9455,24 +9646,27 @@ privileged_entry_point(
   // validate cookie
   if (ns_open_ul_connection(phr->fw_state) < 0)
     return ns_html_err_ul_server_down(fout, phr, 1, 0);
-  if ((r = userlist_clnt_get_cookie(ul_conn, ULS_PRIV_GET_COOKIE,
-                                    &phr->ip, phr->ssl_flag,
-                                    phr->session_id,
-                                    phr->client_key,
-                                    &phr->user_id, &phr->contest_id,
-                                    &phr->locale_id, 0, &phr->role, 0, 0, 0,
-                                    &phr->login, &phr->name)) < 0) {
-    switch (-r) {
-    case ULS_ERR_NO_COOKIE:
-      return ns_html_err_inv_session(fout, phr, 1,
-                                     "priv_login failed: %s",
-                                     userlist_strerror(-r));
-    case ULS_ERR_DISCONNECT:
-      return ns_html_err_ul_server_down(fout, phr, 1, 0);
-    default:
-      return ns_html_err_internal_error(fout, phr, 1, "priv_login failed: %s",
-                                        userlist_strerror(-r));
+  if (ns_get_cached_cookie(phr, ULS_PRIV_GET_COOKIE, cur_time) < 0) {
+    if ((r = userlist_clnt_get_cookie(ul_conn, ULS_PRIV_GET_COOKIE,
+                                      &phr->ip, phr->ssl_flag,
+                                      phr->session_id,
+                                      phr->client_key,
+                                      &phr->user_id, &phr->contest_id,
+                                      &phr->locale_id, 0, &phr->role, 0, 0, 0,
+                                      &phr->login, &phr->name)) < 0) {
+      switch (-r) {
+      case ULS_ERR_NO_COOKIE:
+        return ns_html_err_inv_session(fout, phr, 1,
+                                       "priv_login failed: %s",
+                                       userlist_strerror(-r));
+      case ULS_ERR_DISCONNECT:
+        return ns_html_err_ul_server_down(fout, phr, 1, 0);
+      default:
+        return ns_html_err_internal_error(fout, phr, 1, "priv_login failed: %s",
+                                          userlist_strerror(-r));
+      }
     }
+    ns_set_cached_cookie(phr, ULS_PRIV_GET_COOKIE, cur_time);
   }
 
   if (phr->contest_id < 0 || contests_get(phr->contest_id, &cnts) < 0 || !cnts)
@@ -9529,9 +9723,9 @@ privileged_entry_point(
   }
 
   if (phr->name && *phr->name) {
-    phr->name_arm = html_armor_string_dup(phr->name);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->name);
   } else {
-    phr->name_arm = html_armor_string_dup(phr->login);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->login);
   }
   if (extra->contest_arm) xfree(extra->contest_arm);
   if (phr->locale_id == 0 && cnts->name_en) {
@@ -9649,6 +9843,7 @@ unpriv_load_html_style(struct http_request_info *phr,
            "<script type=\"text/javascript\">\n"
            "  var SID=\"%016llx\";\n"
            "  var NEW_SRV_ACTION_JSON_USER_STATE=%d;\n"
+           "  var NEW_SRV_ACTION_JSON_USER_EVENTS=%d;\n"
            "  var NEW_SRV_ACTION_VIEW_PROBLEM_SUMMARY=%d;\n"
            "  var self_url=\"%s\";\n"
            "  var script_name=\"%s\";\n"
@@ -9659,14 +9854,15 @@ unpriv_load_html_style(struct http_request_info *phr,
            "  var testingCompleted = \"%s\";\n"
            "  var waitingTooLong = \"%s\";\n"
            "</script>\n", phr->session_id, NEW_SRV_ACTION_JSON_USER_STATE,
+           NEW_SRV_ACTION_JSON_USER_EVENTS,
            NEW_SRV_ACTION_VIEW_PROBLEM_SUMMARY,
            phr->self_url, phr->script_name, state_json_txt,
            _("STATUS UPDATE FAILED!"), _("TESTING IN PROGRESS..."),
            _("TESTING COMPLETED"), _("REFRESH PAGE MANUALLY!"));
   xfree(state_json_txt); state_json_txt = 0;
-  phr->script_part = xstrdup(bb);
+  phr->script_part = ns_arena_strdup(phr, bb);
   snprintf(bb, sizeof(bb), " onload=\"startClock()\"");
-  phr->body_attr = xstrdup(bb);
+  phr->body_attr = ns_arena_strdup(phr, bb);
 #endif
 }
 
@@ -10283,6 +10479,7 @@ unpriv_change_language(FILE *fout,
                                     new_locale_id)) < 0) {
     fprintf(log_f, "set_cookie failed: %s", userlist_strerror(-r));
   }
+  ns_drop_cached_cookie(phr->session_id);
 
   //done:
   close_memstream(log_f); log_f = 0;
@@ -10927,6 +11124,7 @@ ns_submit_run(
     run_undo_add_record(cs->runlog_state, run_id);
     FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
   if (p_run_id) *p_run_id = run_id;
 
   if (accept_immediately) {
@@ -11545,6 +11743,7 @@ unpriv_submit_run(FILE *fout,
                                             run_size, NULL, 0, 0);
 
   }
+
   if (arch_flags < 0) {
     run_undo_add_record(cs->runlog_state, run_id);
     ns_error(log_f, NEW_SRV_ERR_DISK_WRITE_ERROR);
@@ -11556,6 +11755,7 @@ unpriv_submit_run(FILE *fout,
     ns_error(log_f, NEW_SRV_ERR_DISK_WRITE_ERROR);
     goto done;
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
 
   if (prob->type == PROB_TYPE_STANDARD) {
     if (prob->disable_auto_testing > 0
@@ -12190,7 +12390,7 @@ unpriv_view_source(FILE *fout,
 {
   serve_state_t cs = extra->serve_state;
   const struct section_global_data *global = cs->global;
-  int run_id, src_flags;
+  int run_id;
   char *log_txt = 0;
   size_t log_len = 0;
   FILE *log_f = 0;
@@ -12199,7 +12399,6 @@ unpriv_view_source(FILE *fout,
   const struct section_problem_data *prob = 0;
   char *run_text = 0;
   size_t run_size = 0;
-  path_t src_path;
 
   if (unpriv_parse_run_id(fout, phr, cnts, extra, &run_id, &re) < 0)
     goto cleanup;
@@ -12229,14 +12428,11 @@ unpriv_view_source(FILE *fout,
     goto done;
   }
 
-  if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                              &run_text, &run_size) < 0) {
     ns_error(log_f, NEW_SRV_ERR_SOURCE_NONEXISTANT);
     goto done;
   }
-  if (generic_read_file(&run_text, 0, &run_size, src_flags, 0, src_path, 0)<0) {
-    ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-    goto done;
-  }
 
   if (prob->type > 0) {
     fprintf(fout, "Content-type: %s\n", mime_type_get_type(re.mime_type));
@@ -12359,7 +12555,7 @@ unpriv_view_test(FILE *fout,
     goto done;
   }    
 
-  ns_write_tests(cs, fout, log_f, phr->action, run_id, test_num);
+  ns_write_tests(cs, fout, log_f, phr->action, run_id, test_num, 0);
 
  done:;
   close_memstream(log_f); log_f = 0;
@@ -12480,12 +12676,8 @@ unpriv_view_report(FILE *fout,
     goto done;
   }
 
-  flags = serve_make_xml_report_read_path(cs, rep_path, sizeof(rep_path), &re);
-  if (flags >= 0) {
-    if (generic_read_file(&rep_text, 0, &rep_size, flags, 0, rep_path, 0) < 0) {
-      ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-      goto done;
-    }
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_XML_REPORT,
+                              &rep_text, &rep_size) >= 0) {
     content_type = get_content_type(rep_text, &rep_start);
     if (content_type != CONTENT_TYPE_XML
         && re.status != RUN_COMPILE_ERR
@@ -12508,19 +12700,19 @@ unpriv_view_report(FILE *fout,
     if (user_mode) {
       flags = archive_make_read_path(cs, rep_path, sizeof(rep_path),
                                      global->team_report_archive_dir, run_id, 0, 1);
-    } else {
-      flags = serve_make_report_read_path(cs, rep_path, sizeof(rep_path), &re);
-      
-    }
-    if (flags < 0) {
+      if (flags < 0) {
+        ns_error(log_f, NEW_SRV_ERR_REPORT_NONEXISTANT);
+        goto done;
+      }
+      if (generic_read_file(&rep_text,0,&rep_size,flags,0,rep_path, 0) < 0) {
+        ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
+        goto done;
+      }
+    } else if (serve_read_run_artifact(cs, &re, RUN_PACK_REPORT,
+                                       &rep_text, &rep_size) < 0) {
       ns_error(log_f, NEW_SRV_ERR_REPORT_NONEXISTANT);
       goto done;
     }
-
-    if (generic_read_file(&rep_text,0,&rep_size,flags,0,rep_path, 0) < 0) {
-      ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-      goto done;
-    }
     content_type = get_content_type(rep_text, &rep_start);
   }
 
@@ -12652,9 +12844,7 @@ unpriv_view_clar(FILE *fout,
                                           cs->current_time);
   }
 
-  if ((ce.from > 0 && ce.from != phr->user_id)
-      || (ce.to > 0 && ce.to != phr->user_id)
-      || (start_time <= 0 && ce.hide_flag)) {
+  if (!is_clar_visible_to_user(&ce, phr->user_id, start_time)) {
     ns_error(log_f, NEW_SRV_ERR_PERMISSION_DENIED);
     goto done;
   }
@@ -13380,8 +13570,6 @@ get_last_source(serve_state_t cs, int user_id, int prob_id)
 {
   int total_runs = run_get_total(cs->runlog_state), run_id;
   struct run_entry re;
-  int src_flag = 0;
-  path_t src_path;
   char *src_txt = 0;
   size_t src_len = 0;
   unsigned char *s;
@@ -13394,9 +13582,7 @@ get_last_source(serve_state_t cs, int user_id, int prob_id)
   }
   if (run_id < 0) return 0;
 
-  if ((src_flag = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0)
-    return 0;
-  if (generic_read_file(&src_txt, 0, &src_len, src_flag, 0, src_path, 0) < 0)
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE, &src_txt, &src_len) < 0)
     return 0;
 
   s = src_txt;
@@ -14861,6 +15047,35 @@ unpriv_json_user_state(
   do_json_user_state(fout, cs, phr->user_id, need_reload_check);
 }
 
+/* replies with the changes of the user runs and clars, if there are
+   none, waits for them up to `timeout' seconds */
+static void
+unpriv_json_user_events(
+        FILE *fout,
+        struct http_request_info *phr,
+        const struct contest_desc *cnts,
+        struct contest_extra *extra)
+{
+  const serve_state_t cs = extra->serve_state;
+  int run_serial = -1, clar_total = -1, timeout = 30;
+
+  ns_cgi_param_int_opt(phr, "run_serial", &run_serial, -1);
+  ns_cgi_param_int_opt(phr, "clar_total", &clar_total, -1);
+  ns_cgi_param_int_opt(phr, "timeout", &timeout, 30);
+  if (timeout < 0) timeout = 0;
+  if (timeout > 60) timeout = 60;
+
+  if (timeout > 0
+      && !ns_write_user_events(0, cs, phr->user_id, run_serial, clar_total)
+      && ns_wait_user_events(phr, run_serial, clar_total,
+                             cs->current_time + timeout) >= 0)
+    return;
+
+  fprintf(fout, "Content-type: text/plain; charset=%s\n"
+          "Cache-Control: no-cache\n\n", EJUDGE_CHARSET);
+  ns_write_user_events(fout, cs, phr->user_id, run_serial, clar_total);
+}
+
 static void
 unpriv_xml_update_answer(
         FILE *fout,
@@ -14997,6 +15212,7 @@ unpriv_xml_update_answer(
     if (new_flag) run_undo_add_record(cs->runlog_state, run_id);
     FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
 
   memset(&nv, 0, sizeof(nv));
   nv.size = run_size;
@@ -15237,6 +15453,7 @@ static action_handler_t user_actions_table[NEW_SRV_ACTION_LAST] =
   [NEW_SRV_ACTION_VIRTUAL_START] = unpriv_command,
   [NEW_SRV_ACTION_VIRTUAL_STOP] = unpriv_command,
   [NEW_SRV_ACTION_JSON_USER_STATE] = unpriv_json_user_state,
+  [NEW_SRV_ACTION_JSON_USER_EVENTS] = unpriv_json_user_events,
   [NEW_SRV_ACTION_UPDATE_ANSWER] = unpriv_xml_update_answer,
   [NEW_SRV_ACTION_GET_FILE] = unpriv_get_file,
 };
@@ -15276,31 +15493,34 @@ unprivileged_entry_point(
   // validate cookie
   if (ns_open_ul_connection(phr->fw_state) < 0)
     return ns_html_err_ul_server_down(fout, phr, 0, 0);
-  if ((r = userlist_clnt_get_cookie(ul_conn, ULS_TEAM_GET_COOKIE,
-                                    &phr->ip, phr->ssl_flag,
-                                    phr->session_id,
-                                    phr->client_key,
-                                    &phr->user_id, &phr->contest_id,
-                                    &phr->locale_id, 0, &phr->role, 0, 0, 0,
-                                    &phr->login, &phr->name)) < 0) {
-    if (r < 0 && orig_locale_id < 0 && cnts && cnts->default_locale_num >= 0) {
-      phr->locale_id = cnts->default_locale_num;
-    }
-    switch (-r) {
-    case ULS_ERR_NO_COOKIE:
-    case ULS_ERR_CANNOT_PARTICIPATE:
-    case ULS_ERR_NOT_REGISTERED:
-      return ns_html_err_inv_session(fout, phr, 0,
-                                     "get_cookie failed: %s",
-                                     userlist_strerror(-r));
-    case ULS_ERR_INCOMPLETE_REG:
-      return ns_html_err_registration_incomplete(fout, phr);
-    case ULS_ERR_DISCONNECT:
-      return ns_html_err_ul_server_down(fout, phr, 0, 0);
-    default:
-      return ns_html_err_internal_error(fout, phr, 0, "get_cookie failed: %s",
-                                        userlist_strerror(-r));
+  if (ns_get_cached_cookie(phr, ULS_TEAM_GET_COOKIE, cur_time) < 0) {
+    if ((r = userlist_clnt_get_cookie(ul_conn, ULS_TEAM_GET_COOKIE,
+                                      &phr->ip, phr->ssl_flag,
+                                      phr->session_id,
+                                      phr->client_key,
+                                      &phr->user_id, &phr->contest_id,
+                                      &phr->locale_id, 0, &phr->role, 0, 0, 0,
+                                      &phr->login, &phr->name)) < 0) {
+      if (r < 0 && orig_locale_id < 0 && cnts && cnts->default_locale_num >= 0) {
+        phr->locale_id = cnts->default_locale_num;
+      }
+      switch (-r) {
+      case ULS_ERR_NO_COOKIE:
+      case ULS_ERR_CANNOT_PARTICIPATE:
+      case ULS_ERR_NOT_REGISTERED:
+        return ns_html_err_inv_session(fout, phr, 0,
+                                       "get_cookie failed: %s",
+                                       userlist_strerror(-r));
+      case ULS_ERR_INCOMPLETE_REG:
+        return ns_html_err_registration_incomplete(fout, phr);
+      case ULS_ERR_DISCONNECT:
+        return ns_html_err_ul_server_down(fout, phr, 0, 0);
+      default:
+        return ns_html_err_internal_error(fout, phr, 0, "get_cookie failed: %s",
+                                          userlist_strerror(-r));
+      }
     }
+    ns_set_cached_cookie(phr, ULS_TEAM_GET_COOKIE, cur_time);
   }
 
   if (phr->contest_id < 0 || contests_get(phr->contest_id, &cnts) < 0 || !cnts){
@@ -15337,9 +15557,9 @@ unprivileged_entry_point(
   //if (!extra->footer_txt) extra->footer_txt = ns_fancy_footer;
 
   if (phr->name && *phr->name) {
-    phr->name_arm = html_armor_string_dup(phr->name);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->name);
   } else {
-    phr->name_arm = html_armor_string_dup(phr->login);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->login);
   }
   if (extra->contest_arm) xfree(extra->contest_arm);
   if (phr->locale_id == 0 && cnts->name_en) {
@@ -15722,8 +15942,118 @@ static const unsigned char * const symbolic_action_table[NEW_SRV_ACTION_LAST] =
   [NEW_SRV_ACTION_PRIV_EDIT_RUN_ACTION] = "PRIV_EDIT_RUN_ACTION",
   [NEW_SRV_ACTION_PING] = "PING",
   [NEW_SRV_ACTION_SUBMIT_RUN_BATCH] = "SUBMIT_RUN_BATCH",
+  [NEW_SRV_ACTION_SIMILAR_RUNS] = "SIMILAR_RUNS",
+  [NEW_SRV_ACTION_VIEW_TEST_DIFF] = "VIEW_TEST_DIFF",
+  [NEW_SRV_ACTION_PACK_RUNS] = "PACK_RUNS",
+  [NEW_SRV_ACTION_JSON_USER_EVENTS] = "JSON_USER_EVENTS",
+  [NEW_SRV_ACTION_SERVER_STATS] = "SERVER_STATS",
 };
 
+/*
+ * The per-request memory.
+ *
+ * The short-lived data of the page generation is allocated in
+ * a memory pool, which is created on demand and destroyed at once
+ * at the end of cmd_http_request, so nothing needs to be freed
+ * and the long-living server heap is not fragmented.
+ */
+
+enum { NS_ARENA_PAGE_SIZE = 16384 };
+
+struct ns_arena_stat
+{
+  long long requests;
+  long long allocs;
+  long long total_size;
+  size_t max_size;
+};
+static struct ns_arena_stat arena_stats[NEW_SRV_ACTION_LAST];
+
+void *
+ns_arena_alloc(struct http_request_info *phr, size_t size)
+{
+  if (!phr->mem) phr->mem = pgCreate(NS_ARENA_PAGE_SIZE);
+  if (!size) size = 1;
+  return pgMalloc(phr->mem, size);
+}
+
+void *
+ns_arena_calloc(struct http_request_info *phr, size_t nelem, size_t size)
+{
+  if (!phr->mem) phr->mem = pgCreate(NS_ARENA_PAGE_SIZE);
+  if (!nelem || !size) nelem = size = 1;
+  return pgCalloc(phr->mem, nelem, size);
+}
+
+unsigned char *
+ns_arena_strdup(struct http_request_info *phr, const unsigned char *str)
+{
+  if (!phr->mem) phr->mem = pgCreate(NS_ARENA_PAGE_SIZE);
+  return (unsigned char*) pgStrdup(phr->mem, (const char*) str);
+}
+
+const unsigned char *
+ns_arena_armor(struct http_request_info *phr, const unsigned char *str)
+{
+  size_t len;
+  unsigned char *out;
+
+  if (!str) str = "";
+  if (!html_armor_needed(str, &len)) return str;
+  out = (unsigned char*) ns_arena_alloc(phr, len + 1);
+  html_armor_text(str, strlen(str), out);
+  return out;
+}
+
+void
+ns_arena_release(struct http_request_info *phr)
+{
+  struct ns_arena_stat *st = 0;
+  size_t used;
+
+  // the action comes from the client, it may be out of range
+  if (phr->action >= 0 && phr->action < NEW_SRV_ACTION_LAST) {
+    st = &arena_stats[phr->action];
+    st->requests++;
+  }
+  if (!phr->mem) return;
+  if (st) {
+    used = pgUsedSize(phr->mem);
+    st->allocs += pgAllocCount(phr->mem);
+    st->total_size += used;
+    if (used > st->max_size) st->max_size = used;
+  }
+  pgDestroy(phr->mem);
+  phr->mem = 0;
+}
+
+void
+ns_arena_write_stats(FILE *out_f)
+{
+  int i;
+  const struct ns_arena_stat *st;
+  const unsigned char *name;
+
+  fprintf(out_f, "%-32s %10s %12s %12s %10s\n",
+          "action", "requests", "allocs", "avg bytes", "max bytes");
+  for (i = 0; i < NEW_SRV_ACTION_LAST; ++i) {
+    st = &arena_stats[i];
+    if (!st->requests) continue;
+    if (!(name = symbolic_action_table[i])) name = "";
+    if (!i) name = "NONE";
+    fprintf(out_f, "%-32s %10lld %12lld %12lld %10zu\n",
+            name, st->requests, st->allocs,
+            st->total_size / st->requests, st->max_size);
+  }
+}
+
+const unsigned char *
+ns_get_action_name(int action)
+{
+  if (action < 0 || action >= NEW_SRV_ACTION_LAST) return 0;
+  return symbolic_action_table[action];
+}
+
 static void
 parse_cookie(struct http_request_info *phr)
 {
@@ -49,7 +49,10 @@
 #include "run_packet.h"
 #include "prepare_dflt.h"
 #include "super_run_packet.h"
+#include "super_run_sched.h"
 #include "ej_uuid.h"
+#include "diff.h"
+#include "run_pack.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -1385,13 +1388,12 @@ ns_write_priv_source(const serve_state_t state,
                      struct contest_extra *extra,
                      int run_id)
 {
-  path_t src_path;
   struct run_entry info;
   char *src_text = 0; //, *html_text;
   //unsigned char *numb_txt;
   size_t src_len; //, html_len, numb_len;
   time_t start_time;
-  int variant, src_flags;
+  int variant;
   unsigned char filtbuf1[128];
   unsigned char filtbuf2[256];
   unsigned char filtbuf3[512];
@@ -1408,8 +1410,6 @@ ns_write_priv_source(const serve_state_t state,
   const unsigned char *run_charset = 0;
   int charset_id = 0;
   const unsigned char *cl = 0;
-  int txt_flags = 0;
-  path_t txt_path = { 0 };
   char *txt_text = 0;
   size_t txt_size = 0;
 
@@ -1427,8 +1427,8 @@ ns_write_priv_source(const serve_state_t state,
     return;
   }
 
-  src_flags = serve_make_source_read_path(state, src_path, sizeof(src_path), &info);
-  if (src_flags < 0) {
+  if (serve_read_run_artifact(state, &info, RUN_PACK_SOURCE,
+                              &src_text, &src_len) < 0) {
     ns_error(log_f, NEW_SRV_ERR_SOURCE_NONEXISTANT);
     return;
   }
@@ -1802,7 +1802,7 @@ ns_write_priv_source(const serve_state_t state,
   } else if (lang && lang->binary) {
     fprintf(f, "<p>The submission is binary and thus is not shown.</p>\n");
   } else if (!info.is_imported) {
-    if (src_flags < 0 || generic_read_file(&src_text, 0, &src_len, src_flags, 0, src_path, "") < 0) {
+    if (!src_text) {
       fprintf(f, "<big><font color=\"red\">Cannot read source text!</font></big>\n");
     } else {
       if (run_charset && (charset_id = charset_get_id(run_charset)) > 0) {
@@ -1841,13 +1841,10 @@ ns_write_priv_source(const serve_state_t state,
   }
 
     /* try to load text description of the archive */
-  txt_flags = serve_make_report_read_path(state, txt_path, sizeof(txt_path), &info);
-  if (txt_flags >= 0) {
-    if (generic_read_file(&txt_text, 0, &txt_size, txt_flags, 0,
-                          txt_path, 0) >= 0) {
-      fprintf(f, "<h2>%s</h2>\n<pre>%s</pre>\n", "Style checker output", ARMOR(txt_text));
-      xfree(txt_text); txt_text = 0; txt_size = 0;
-    }
+  if (serve_read_run_artifact(state, &info, RUN_PACK_REPORT,
+                              &txt_text, &txt_size) >= 0) {
+    fprintf(f, "<h2>%s</h2>\n<pre>%s</pre>\n", "Style checker output", ARMOR(txt_text));
+    xfree(txt_text); txt_text = 0; txt_size = 0;
   }
 
   fprintf(f, "<h2>%s</h2>\n", _("Send a message about this run"));
@@ -1877,6 +1874,7 @@ ns_write_priv_source(const serve_state_t state,
   fprintf(f, "</tr></table>\n");
   fprintf(f, "</form>\n");
 
+  xfree(src_text);
   html_armor_free(&ab);
 }
 
@@ -1907,6 +1905,7 @@ ns_write_priv_report(const serve_state_t cs,
     NEW_SRV_ACTION_VIEW_TEST_ERROR,
     NEW_SRV_ACTION_VIEW_TEST_CHECKER,
     NEW_SRV_ACTION_VIEW_TEST_INFO,
+    NEW_SRV_ACTION_VIEW_TEST_DIFF,
   };
 
   if (run_id < 0 || run_id >= run_get_total(cs->runlog_state)
@@ -1936,28 +1935,26 @@ ns_write_priv_report(const serve_state_t cs,
     }
   }
 
-  rep_flag = serve_make_xml_report_read_path(cs, rep_path, sizeof(rep_path), &re);
-  if (rep_flag >= 0) {
-    if (generic_read_file(&rep_text, 0, &rep_len, rep_flag, 0, rep_path, 0)<0){
-      ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-      goto done;
-    }
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_XML_REPORT,
+                              &rep_text, &rep_len) >= 0) {
     content_type = get_content_type(rep_text, &start_ptr);
   } else {
     if (user_mode) {
       rep_flag = archive_make_read_path(cs, rep_path, sizeof(rep_path),
                                         global->team_report_archive_dir, run_id, 0, 1);
-    } else {
-      rep_flag = serve_make_report_read_path(cs, rep_path, sizeof(rep_path), &re);
-    }
-    if (rep_flag < 0) {
+      if (rep_flag < 0) {
+        ns_error(log_f, NEW_SRV_ERR_REPORT_NONEXISTANT);
+        goto done;
+      }
+      if (generic_read_file(&rep_text, 0, &rep_len, rep_flag, 0, rep_path, 0)<0){
+        ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
+        goto done;
+      }
+    } else if (serve_read_run_artifact(cs, &re, RUN_PACK_REPORT,
+                                       &rep_text, &rep_len) < 0) {
       ns_error(log_f, NEW_SRV_ERR_REPORT_NONEXISTANT);
       goto done;
     }
-    if (generic_read_file(&rep_text, 0, &rep_len, rep_flag, 0, rep_path, 0)<0){
-      ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-      goto done;
-    }
     content_type = get_content_type(rep_text, &start_ptr);
   }
 
@@ -2032,9 +2029,6 @@ ns_write_audit_log(const serve_state_t cs,
                    int run_id)
 {
   struct run_entry re;
-  int rep_flag;
-  path_t audit_log_path;
-  struct stat stb;
   char *audit_text = 0;
   size_t audit_text_size = 0;
   char *audit_html = 0;
@@ -2045,21 +2039,10 @@ ns_write_audit_log(const serve_state_t cs,
     goto done;
   }
 
-  if ((rep_flag = serve_make_audit_read_path(cs, audit_log_path, sizeof(audit_log_path), &re)) < 0) {
+  if (serve_read_audit_log(cs, &re, &audit_text, &audit_text_size) < 0) {
     ns_error(log_f, NEW_SRV_ERR_AUDIT_LOG_NONEXISTANT);
     goto done;
   }
-  if (lstat(audit_log_path, &stb) < 0
-      || !S_ISREG(stb.st_mode)) {
-    ns_error(log_f, NEW_SRV_ERR_AUDIT_LOG_NONEXISTANT);
-    goto done;
-  }
-
-  if (generic_read_file(&audit_text, 0, &audit_text_size, 0, 0, audit_log_path,
-                        0) < 0) {
-    ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-    goto done;
-  }
   audit_html = html_armor_string_dup(audit_text);
 
   ns_header(f, extra->header_txt, 0, 0, 0, 0, phr->locale_id, cnts,
@@ -3507,6 +3490,8 @@ ns_priv_edit_run_action(
   if (!mask) goto cleanup;
   if (run_set_entry(cs->runlog_state, run_id, mask, &new_info) < 0)
     FAIL(NEW_SRV_ERR_RUNLOG_UPDATE_FAILED);
+  if ((mask & (RE_USER_ID | RE_PROB_ID | RE_LANG_ID)))
+    serve_invalidate_similarity_index(cs, run_id);
 
   serve_audit_log(cs, run_id, &info, phr->user_id, &phr->ip, phr->ssl_flag,
                   "edit-run", "ok", -1,
@@ -3522,10 +3507,9 @@ cleanup:;
   return retval;
 }
 
-static void
-write_from_contest_dir(
+static int
+read_from_contest_dir(
         FILE *log_f,
-        FILE *fout,
         int flag1,
         int flag2,
         int test_num,
@@ -3537,19 +3521,20 @@ write_from_contest_dir(
         const unsigned char *suffix,
         const unsigned char *pattern,
         int has_digest,
-        const unsigned char *digest_ptr)
+        const unsigned char *digest_ptr,
+        int *p_good_digest,
+        char **p_bytes,
+        size_t *p_size)
 {
   path_t path1;
   path_t path2;
   path_t path3;
   unsigned char cur_digest[32];
-  int good_digest_flag = 0;
-  char *file_bytes = 0;
-  size_t file_size = 0;
 
+  *p_good_digest = 0;
   if (!flag1 || !flag2) {
     ns_error(log_f, NEW_SRV_ERR_TEST_NONEXISTANT);
-    goto done;
+    return -1;
   }
 
   if (pattern[0]) {
@@ -3572,15 +3557,44 @@ write_from_contest_dir(
   if (has_digest && digest_ptr) {
     if (filehash_get(path1, cur_digest) < 0) {
       ns_error(log_f, NEW_SRV_ERR_CHECKSUMMING_FAILED);
-      goto done;
+      return -1;
     }
-    good_digest_flag = digest_is_equal(DIGEST_SHA1, digest_ptr, cur_digest);
+    *p_good_digest = digest_is_equal(DIGEST_SHA1, digest_ptr, cur_digest);
   }
 
-  if (generic_read_file(&file_bytes, 0, &file_size, 0, 0, path1, 0) < 0) {
+  if (generic_read_file(p_bytes, 0, p_size, 0, 0, path1, 0) < 0) {
     ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-    goto done;
+    return -1;
   }
+  return 0;
+}
+
+static void
+write_from_contest_dir(
+        FILE *log_f,
+        FILE *fout,
+        int flag1,
+        int flag2,
+        int test_num,
+        int variant,
+        const struct section_global_data *global,
+        const struct section_problem_data *prb,
+        const unsigned char *entry,
+        const unsigned char *dir,
+        const unsigned char *suffix,
+        const unsigned char *pattern,
+        int has_digest,
+        const unsigned char *digest_ptr)
+{
+  int good_digest_flag = 0;
+  char *file_bytes = 0;
+  size_t file_size = 0;
+
+  if (read_from_contest_dir(log_f, flag1, flag2, test_num, variant, global,
+                            prb, entry, dir, suffix, pattern, has_digest,
+                            digest_ptr, &good_digest_flag,
+                            &file_bytes, &file_size) < 0)
+    goto done;
 
   fprintf(fout, "Content-type: text/plain\n\n");
   if (!good_digest_flag) {
@@ -3601,26 +3615,25 @@ write_from_contest_dir(
     xfree(file_bytes);
 }
 
-static void
-write_from_archive(
+static int
+read_from_archive(
         const serve_state_t cs,
         FILE *log_f,
-        FILE *fout,
         int flag,
         int test_num,
         const struct run_entry *re,
-        const unsigned char *suffix)
+        const unsigned char *suffix,
+        unsigned char **p_text,
+        long *p_size)
 {
   full_archive_t far = 0;
   unsigned char fnbuf[64];
   int rep_flag = 0, arch_flags = 0;
   path_t arch_path;
-  long arch_raw_size = 0;
-  unsigned char *text = 0;
 
   if (!flag) {
     ns_error(log_f, NEW_SRV_ERR_TEST_UNAVAILABLE);
-    goto done;
+    return -1;
   }
 
   snprintf(fnbuf, sizeof(fnbuf), "%06d%s", test_num, suffix);
@@ -3628,15 +3641,34 @@ write_from_archive(
   rep_flag = serve_make_full_report_read_path(cs, arch_path, sizeof(arch_path), re);
   if (rep_flag < 0 || !(far = full_archive_open_read(arch_path))) {
     ns_error(log_f, NEW_SRV_ERR_TEST_NONEXISTANT);
-    goto done;
+    return -1;
   }
 
-  rep_flag = full_archive_find_file(far, fnbuf, &arch_raw_size,
-                                    &arch_flags, &text);
+  rep_flag = full_archive_find_file(far, fnbuf, p_size, &arch_flags, p_text);
+  full_archive_close(far);
   if (rep_flag <= 0) {
     ns_error(log_f, NEW_SRV_ERR_TEST_NONEXISTANT);
-    goto done;
+    return -1;
   }
+  return 0;
+}
+
+static void
+write_from_archive(
+        const serve_state_t cs,
+        FILE *log_f,
+        FILE *fout,
+        int flag,
+        int test_num,
+        const struct run_entry *re,
+        const unsigned char *suffix)
+{
+  long arch_raw_size = 0;
+  unsigned char *text = 0;
+
+  if (read_from_archive(cs, log_f, flag, test_num, re, suffix,
+                        &text, &arch_raw_size) < 0)
+    goto done;
 
   fprintf(fout, "Content-type: text/plain\n\n");
   if (arch_raw_size > 0) {
@@ -3647,16 +3679,61 @@ write_from_archive(
   }
 
  done:
-  full_archive_close(far);
   xfree(text);
 }
 
+/* the program output compared with the correct answer */
+static void
+write_test_diff(
+        const serve_state_t cs,
+        FILE *log_f,
+        FILE *fout,
+        int diff_mode,
+        int test_num,
+        const struct run_entry *re,
+        const struct section_problem_data *prb,
+        testing_report_xml_t r)
+{
+  const struct testing_report_test *t = r->tests[test_num - 1];
+  int good_digest_flag = 0;
+  char *corr_bytes = 0;
+  size_t corr_size = 0;
+  unsigned char *out_bytes = 0;
+  long out_size = 0;
+  unsigned char corr_sha1[20], out_sha1[20];
+  unsigned char title1[64], title2[64];
+
+  if (read_from_contest_dir(log_f, prb->use_corr, r->correct_available,
+                            test_num, r->variant, cs->global, prb,
+                            DFLT_P_CORR_DIR, prb->corr_dir, prb->corr_sfx,
+                            prb->corr_pat, t->has_correct_digest,
+                            t->correct_digest, &good_digest_flag,
+                            &corr_bytes, &corr_size) < 0)
+    goto done;
+  if (read_from_archive(cs, log_f, t->output_available, test_num, re, ".o",
+                        &out_bytes, &out_size) < 0)
+    goto done;
+
+  sha_buffer(corr_bytes, corr_size, corr_sha1);
+  sha_buffer(out_bytes, out_size, out_sha1);
+  snprintf(title1, sizeof(title1), "test %d answer", test_num);
+  snprintf(title2, sizeof(title2), "test %d output", test_num);
+  if (serve_write_text_diff(cs, fout, diff_mode, title1, title2,
+                            corr_sha1, corr_bytes, corr_size,
+                            out_sha1, out_bytes, out_size) < 0) {
+    ns_error(log_f, NEW_SRV_ERR_RUN_COMPARE_FAILED);
+    goto done;
+  }
+
+ done:
+  xfree(corr_bytes);
+  xfree(out_bytes);
+}
+
 void
 ns_write_tests(const serve_state_t cs, FILE *fout, FILE *log_f,
-               int action, int run_id, int test_num)
+               int action, int run_id, int test_num, int diff_mode)
 {
-  int rep_flag;
-  path_t rep_path;
   char *rep_text = 0;
   size_t rep_len = 0;
   const unsigned char *start_ptr = 0;
@@ -3671,16 +3748,13 @@ ns_write_tests(const serve_state_t cs, FILE *fout, FILE *log_f,
     goto done;
   }
 
-  if ((rep_flag = serve_make_xml_report_read_path(cs, rep_path, sizeof(rep_path), &re)) < 0
-      && (rep_flag = serve_make_report_read_path(cs, rep_path, sizeof(rep_path), &re)) < 0) {
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_XML_REPORT,
+                              &rep_text, &rep_len) < 0
+      && serve_read_run_artifact(cs, &re, RUN_PACK_REPORT,
+                                 &rep_text, &rep_len) < 0) {
     ns_error(log_f, NEW_SRV_ERR_REPORT_NONEXISTANT);
     goto done;
   }
-
-  if (generic_read_file(&rep_text, 0, &rep_len, rep_flag,0,rep_path, "") < 0) {
-    ns_error(log_f, NEW_SRV_ERR_DISK_READ_ERROR);
-    goto done;
-  }
   if (get_content_type(rep_text, &start_ptr) != CONTENT_TYPE_XML) {
     // we expect the master log in XML format
     ns_error(log_f, NEW_SRV_ERR_REPORT_UNAVAILABLE);
@@ -3757,6 +3831,10 @@ ns_write_tests(const serve_state_t cs, FILE *fout, FILE *log_f,
   case NEW_SRV_ACTION_VIEW_TEST_CHECKER:
     write_from_archive(cs, log_f, fout, t->checker_output_available, test_num, &re, ".c");
     goto done;
+
+  case NEW_SRV_ACTION_VIEW_TEST_DIFF:
+    write_test_diff(cs, log_f, fout, diff_mode, test_num, &re, prb, r);
+    goto done;
   }
 
  done:
@@ -4531,7 +4609,7 @@ ns_user_info_page(FILE *fout, FILE *log_f,
     fprintf(fout, "<p>%s:<br>\n",
             _("Disqualification explanation"));
     fprintf(fout, "<p><textarea name=\"disq_comment\" rows=\"5\" cols=\"60\">");
-    if (u_extra->disq_comment) {
+    if (u_extra && u_extra->disq_comment) {
       fprintf(fout, "%s", ARMOR(u_extra->disq_comment));
     }
     fprintf(fout, "</textarea></p>\n");
@@ -5295,6 +5373,7 @@ do_add_row(
     fprintf(log_f, _("Cannot write run row %d\n"), row);
     return -1;
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
   run_set_entry(cs->runlog_state, run_id, RE_STATUS | RE_TEST | RE_SCORE, re);
 
   serve_audit_log(cs, run_id, NULL, phr->user_id, &phr->ip, phr->ssl_flag,
@@ -6044,9 +6123,8 @@ get_source(
         const struct section_problem_data *prob,
         int variant)
 {
-  int src_flag = 0, i, n;
+  int i, n;
   char *eptr = 0;
-  path_t src_path = { 0 };
   char *src_txt = 0;
   size_t src_len = 0;
   unsigned char *s = 0, *val = 0;
@@ -6074,9 +6152,7 @@ get_source(
     break;
   }
 
-  if ((src_flag = serve_make_source_read_path(cs, src_path, sizeof(src_path), re)) < 0)
-    goto cleanup;
-  if (generic_read_file(&src_txt, 0, &src_len, src_flag, 0, src_path, 0) < 0)
+  if (serve_read_run_artifact(cs, re, RUN_PACK_SOURCE, &src_txt, &src_len) < 0)
     goto cleanup;
   s = src_txt;
   while (src_len > 0 && isspace(s[src_len])) src_len--;
@@ -6139,8 +6215,6 @@ ns_get_checker_comment(
         int run_id,
         int need_html_armor)
 {
-  int rep_flag;
-  path_t rep_path;
   unsigned char *str = 0;
   char *rep_txt = 0;
   size_t rep_len = 0;
@@ -6152,9 +6226,8 @@ ns_get_checker_comment(
   if (run_get_entry(cs->runlog_state, run_id, &re) < 0)
     goto cleanup;
 
-  if ((rep_flag = serve_make_xml_report_read_path(cs, rep_path, sizeof(rep_path), &re)) < 0)
-    goto cleanup;
-  if (generic_read_file(&rep_txt, 0, &rep_len, rep_flag, 0, rep_path, 0) < 0)
+  if (serve_read_run_artifact(cs, &re, RUN_PACK_XML_REPORT,
+                              &rep_txt, &rep_len) < 0)
     goto cleanup;
   if (get_content_type(rep_txt, &start_ptr) != CONTENT_TYPE_XML)
     goto cleanup;
@@ -6187,8 +6260,6 @@ static int get_accepting_passed_tests(
         int run_id,
         const struct run_entry *re)
 {
-  int rep_flag;
-  path_t rep_path;
   char *rep_txt = 0;
   size_t rep_len = 0;
   testing_report_xml_t rep_xml = 0;
@@ -6228,9 +6299,8 @@ static int get_accepting_passed_tests(
   }
 
   r = 0;
-  if ((rep_flag = serve_make_xml_report_read_path(cs, rep_path, sizeof(rep_path), re)) < 0)
-    goto cleanup;
-  if (generic_read_file(&rep_txt, 0, &rep_len, rep_flag, 0, rep_path, 0) < 0)
+  if (serve_read_run_artifact(cs, re, RUN_PACK_XML_REPORT,
+                              &rep_txt, &rep_len) < 0)
     goto cleanup;
   if (get_content_type(rep_txt, &start_ptr) != CONTENT_TYPE_XML)
     goto cleanup;
@@ -7984,6 +8054,91 @@ scan_run_queue(
   qsort(vec->v, vec->u, sizeof(vec->v[0]), scan_run_sort_func);
 }
         
+static void
+write_sched_stats(
+        FILE *fout,
+        const unsigned char *sched_dir,
+        int contest_id)
+{
+  DIR *d = 0;
+  struct dirent *dd;
+  path_t path;
+  struct super_run_sched_stat *stat = NULL;
+  const struct super_run_sched_contest_stat *cs;
+  const unsigned char *cl = " class=\"b1\"";
+  int i, count = 0;
+  time_t cur_time = time(0);
+  double avg_wait;
+
+  if (!(d = opendir(sched_dir))) return;
+  while ((dd = readdir(d))) {
+    if (!strcmp(dd->d_name, ".") || !strcmp(dd->d_name, "..")) continue;
+    if (strlen(dd->d_name) > 4
+        && !strcmp(dd->d_name + strlen(dd->d_name) - 4, ".tmp")) continue;
+    // the state shared by the schedulers of a host
+    if (strlen(dd->d_name) > 6
+        && !strcmp(dd->d_name + strlen(dd->d_name) - 6, ".state")) continue;
+    snprintf(path, sizeof(path), "%s/%s", sched_dir, dd->d_name);
+    if (!(stat = super_run_sched_stat_read(path))) continue;
+
+    if (!count++) {
+      fprintf(fout, "<h3>%s</h3>\n", _("Testing queue statistics"));
+    }
+    fprintf(fout, "<p>%s %s, pid %d, %s %s (%ld s ago). %s: %d (%s: %d), %s: %lld (%s: %lld), %s: %d%%</p>\n",
+            _("Host"), stat->host, stat->pid,
+            _("updated"), xml_unparse_date(stat->update_time),
+            (long) (cur_time - stat->update_time),
+            _("Queued"), stat->queued, _("rejudge"), stat->queued_rejudge,
+            _("Dispatched"), stat->dispatched,
+            _("rejudge"), stat->dispatched_rejudge,
+            _("Rejudge share limit"), stat->rejudge_share);
+    fprintf(fout, "<table%s>\n", cl);
+    fprintf(fout,
+            "<tr>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "<th%s>%s</th>"
+            "</tr>\n",
+            cl, "ContestId",
+            cl, _("Weight"),
+            cl, _("Queued"),
+            cl, _("Queued rejudge"),
+            cl, _("Oldest wait (s)"),
+            cl, _("Dispatched"),
+            cl, _("Dispatched rejudge"),
+            cl, _("Average wait (s)"),
+            cl, _("Max wait (s)"));
+    for (i = 0; i < stat->contest_u; ++i) {
+      cs = &stat->contests[i];
+      avg_wait = 0.0;
+      if (cs->dispatched > 0) avg_wait = (double) cs->total_wait / cs->dispatched;
+      if (cs->contest_id == contest_id) {
+        fprintf(fout, "<tr><td%s><b>%d</b></td>", cl, cs->contest_id);
+      } else {
+        fprintf(fout, "<tr><td%s>%d</td>", cl, cs->contest_id);
+      }
+      fprintf(fout, "<td%s>%d</td>", cl, cs->weight);
+      fprintf(fout, "<td%s>%d</td>", cl, cs->queued);
+      fprintf(fout, "<td%s>%d</td>", cl, cs->queued_rejudge);
+      fprintf(fout, "<td%s>%d</td>", cl, cs->oldest_wait);
+      fprintf(fout, "<td%s>%lld</td>", cl, cs->dispatched);
+      fprintf(fout, "<td%s>%lld</td>", cl, cs->dispatched_rejudge);
+      fprintf(fout, "<td%s>%.1f</td>", cl, avg_wait);
+      fprintf(fout, "<td%s>%d</td>", cl, cs->max_wait);
+      fprintf(fout, "</tr>\n");
+    }
+    fprintf(fout, "</table>\n");
+    stat = super_run_sched_stat_free(stat);
+  }
+  closedir(d);
+}
+
 int
 ns_write_testing_queue(
         FILE *fout,
@@ -8002,14 +8157,18 @@ ns_write_testing_queue(
   unsigned char hbuf[1024];
   const unsigned char *arch;
   unsigned char run_queue_dir[PATH_MAX];
+  unsigned char sched_dir[PATH_MAX];
   const unsigned char *queue_dir = NULL;
 
   memset(&vec, 0, sizeof(vec));
+  sched_dir[0] = 0;
   if(cnts && cnts->run_managed) {
     if (global->super_run_dir && global->super_run_dir[0]) {
       snprintf(run_queue_dir, sizeof(run_queue_dir), "%s/var/queue", global->super_run_dir);
+      snprintf(sched_dir, sizeof(sched_dir), "%s/var/%s", global->super_run_dir, SUPER_RUN_SCHED_STAT_DIR);
     } else {
       snprintf(run_queue_dir, sizeof(run_queue_dir), "%s/super-run/var/queue", EJUDGE_CONTESTS_HOME_DIR);
+      snprintf(sched_dir, sizeof(sched_dir), "%s/super-run/var/%s", EJUDGE_CONTESTS_HOME_DIR, SUPER_RUN_SCHED_STAT_DIR);
     }
     queue_dir = run_queue_dir;
   } else {
@@ -8127,6 +8286,10 @@ ns_write_testing_queue(
           ns_url(hbuf, sizeof(hbuf), phr, NEW_SRV_ACTION_TESTING_DOWN_ALL, 0));
   fprintf(fout, "</tr></table>\n");
 
+  if (sched_dir[0]) {
+    write_sched_stats(fout, sched_dir, cnts->id);
+  }
+
   for (i = 0; i < vec.u; ++i) {
     xfree(vec.v[i].entry_name);
     super_run_in_packet_free(vec.v[i].packet);
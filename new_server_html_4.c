@@ -44,11 +44,16 @@
 #include "errlog.h"
 #include "prepare_dflt.h"
 #include "ej_uuid.h"
+#include "diff.h"
+#include "server_framework.h"
+#include "runs_columnar.h"
+#include "run_pack.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <errno.h>
 #include <ctype.h>
 #include <sys/types.h>
@@ -202,6 +207,23 @@ cmd_logout(
   return 0;
 }
 
+// run dump formats
+enum
+{
+  RUN_DUMP_MASTER_CSV,          /* write_master_run_csv for the runs */
+  RUN_DUMP_ALL_CSV,             /* write_runs_dump_range */
+  RUN_DUMP_COLUMNAR,            /* see runs_columnar.h */
+};
+
+static void
+run_dump_start(
+        FILE *fout,
+        struct http_request_info *phr,
+        const serve_state_t cs,
+        int format,
+        int *runs,
+        int run_count);
+
 static int
 cmd_dump_runs(
         FILE *fout,
@@ -235,7 +257,9 @@ cmd_dump_runs(
     break;
 
   case NEW_SRV_ACTION_VIEW_RUNS_DUMP:
-    write_runs_dump(cs, fout, 0, 0);
+    write_runs_dump_header(fout, 0, 0);
+    run_dump_start(fout, phr, cs, RUN_DUMP_ALL_CSV, 0,
+                   run_get_total(cs->runlog_state));
     break;
   default:
     abort();
@@ -643,26 +667,25 @@ cmd_run_operation(
     retval = ns_write_user_run_status(cs, fout, run_id);
     break;
   case NEW_SRV_ACTION_DUMP_SOURCE:
-    src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re);
-    if (src_flags < 0) FAIL(NEW_SRV_ERR_SOURCE_NONEXISTANT);
-    if (generic_read_file(&src_text, 0, &src_len, src_flags,0,src_path, "") < 0)
-      FAIL(NEW_SRV_ERR_DISK_READ_ERROR);
+    if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                &src_text, &src_len) < 0)
+      FAIL(NEW_SRV_ERR_SOURCE_NONEXISTANT);
     if (fwrite(src_text, 1, src_len, fout) != src_len)
       FAIL(NEW_SRV_ERR_WRITE_ERROR);
     break;
   case NEW_SRV_ACTION_DUMP_REPORT:
     if (!run_is_report_available(re.status))
       FAIL(NEW_SRV_ERR_REPORT_UNAVAILABLE);
-    src_flags = serve_make_xml_report_read_path(cs, src_path, sizeof(src_path), &re);
-    if (src_flags < 0) {
+    if (serve_read_run_artifact(cs, &re, RUN_PACK_XML_REPORT,
+                                &src_text, &src_len) < 0) {
       src_flags = archive_make_read_path(cs, src_path, sizeof(src_path),
                                          global->report_archive_dir,
                                          run_id, 0, 1);
+      if (src_flags < 0)
+        FAIL(NEW_SRV_ERR_REPORT_NONEXISTANT);
+      if (generic_read_file(&src_text, 0, &src_len, src_flags,0,src_path, "") < 0)
+        FAIL(NEW_SRV_ERR_DISK_READ_ERROR);
     }
-    if (src_flags < 0)
-      FAIL(NEW_SRV_ERR_REPORT_NONEXISTANT);
-    if (generic_read_file(&src_text, 0, &src_len, src_flags,0,src_path, "") < 0)
-      FAIL(NEW_SRV_ERR_DISK_READ_ERROR);
     if (fwrite(src_text, 1, src_len, fout) != src_len)
       FAIL(NEW_SRV_ERR_WRITE_ERROR);
     break;
@@ -1091,6 +1114,7 @@ cmd_submit_run(
     run_undo_add_record(cs->runlog_state, run_id);
     FAIL(NEW_SRV_ERR_DISK_WRITE_ERROR);
   }
+  serve_similarity_index_add_run(cs, run_id, run_text, run_size);
 
   if (prob->type == PROB_TYPE_STANDARD) {
     if (prob->disable_auto_testing > 0
@@ -1374,29 +1398,18 @@ write_csv_record(
   putc('\n', fout);
 }
 
-static int
-do_dump_master_runs(
+/* writes the CSV record of the run rid for do_dump_master_runs */
+static void
+write_master_run_csv(
         FILE *fout,
-        struct http_request_info *phr,
-        const struct contest_desc *cnts,
-        struct contest_extra *extra,
-        int first_run_set,
-        int first_run,
-        int last_run_set,
-        int last_run,
-        unsigned char const *filter_expr)
+        const serve_state_t cs,
+        time_t rhead_start_time,
+        int rid)
 {
-  struct user_filter_info *u = 0;
-  struct filter_env env;
-  int i, r;
-  int *match_idx = 0;
-  int match_tot = 0;
-  int transient_tot = 0;
-  int *list_idx = 0;
-  int list_tot = 0;
   unsigned char statstr[64];
-  int rid, attempts, disq_attempts, prev_successes;
+  int attempts, disq_attempts, prev_successes;
   time_t run_time, start_time;
+  const struct run_entry *rentries = run_get_entries_ptr(cs->runlog_state);
   const struct run_entry *pe;
   unsigned char dur_str[128];
   int duration, dur_sec, dur_min, dur_hour, user_flags, variant;
@@ -1413,12 +1426,670 @@ do_dump_master_runs(
   unsigned char lang_id_buf[128], judge_id_buf[128], pages_buf[128];
   unsigned char locale_id_buf[128], sha1_buf[256], base_score_buf[128];
   const unsigned char *csv_rec[F_TOTAL_FIELDS];
-
-  const serve_state_t cs = extra->serve_state;
   const struct section_global_data *global = cs->global;
   const struct section_problem_data *prob = 0;
   const struct section_language_data *lang = 0;
 
+  memset(csv_rec, 0, sizeof(csv_rec));
+
+  pe = &rentries[rid];
+  snprintf(run_id_buf, sizeof(run_id_buf), "%d", rid);
+  csv_rec[F_RUN_ID] = run_id_buf;
+  if (!run_is_valid_status(pe->status)) {
+    snprintf(statstr, sizeof(statstr), "%d", pe->status);
+    csv_rec[F_STATUS_SHORT] = statstr;
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  }
+
+  run_status_to_str_short(statstr, sizeof(statstr), pe->status);
+  csv_rec[F_STATUS_SHORT] = statstr;
+
+  if (pe->status == RUN_EMPTY) {
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  }
+
+  snprintf(run_date_buf, sizeof(run_date_buf), "%s",
+           xml_unparse_date(pe->time));
+  csv_rec[F_TIME] = run_date_buf;
+  snprintf(nsec_buf, sizeof(nsec_buf), "%d", pe->nsec);
+  csv_rec[F_NSEC] = nsec_buf;
+  run_time = pe->time;
+  if (global->is_virtual) {
+    start_time = run_get_virtual_start_time(cs->runlog_state, pe->user_id);
+  } else {
+    start_time = rhead_start_time;
+  }
+  if (run_time < start_time) {
+    dur_str[0] = 0;
+  } else {
+    duration = run_time - start_time;
+    dur_sec = duration % 60; duration /= 60;
+    dur_min = duration % 60; duration /= 60;
+    dur_hour = duration % 24; duration /= 24;
+    if (duration > 0) {
+      snprintf(dur_str, sizeof(dur_str), "%d %02d:%02d:%02d",
+               duration, dur_hour, dur_min, dur_sec);
+    } else {
+      snprintf(dur_str, sizeof(dur_str), "%02d:%02d:%02d",
+               dur_hour, dur_min, dur_sec);
+    }
+  }
+  csv_rec[F_DURATION] = dur_str;
+
+  snprintf(user_id_buf, sizeof(user_id_buf), "%d", pe->user_id);
+  csv_rec[F_USER_ID] = user_id_buf;
+  if ((user_login = teamdb_get_login(cs->teamdb_state, pe->user_id))) {
+    user_flags = teamdb_get_flags(cs->teamdb_state, pe->user_id);
+    if ((user_flags & TEAM_BANNED)) csv_rec[F_IS_USER_BANNED] = "1";
+    if ((user_flags & TEAM_INVISIBLE)) csv_rec[F_IS_USER_INVISIBLE] = "1";
+    if ((user_flags & TEAM_LOCKED)) csv_rec[F_IS_USER_LOCKED] = "1";
+    if ((user_flags & TEAM_INCOMPLETE)) csv_rec[F_IS_USER_INCOMPLETE] = "1";
+    if ((user_flags & TEAM_DISQUALIFIED)) csv_rec[F_IS_USER_DISQUALIFIED]="1";
+  } else {
+    user_login = "";
+  }
+  csv_rec[F_USER_LOGIN] = user_login;
+
+  snprintf(ip_buf, sizeof(ip_buf), "%s", xml_unparse_ip(pe->a.ip));
+  csv_rec[F_IP] = ip_buf;
+  if (pe->ipv6_flag) csv_rec[F_IS_IPV6] = "1";
+  if (pe->ssl_flag) csv_rec[F_IS_SSL] = "1";
+
+  if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP) {
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  }
+
+  if (pe->is_hidden) csv_rec[F_IS_HIDDEN] = "1";
+  if (pe->is_imported) csv_rec[F_IS_IMPORTED] = "1";
+  if (pe->is_readonly) csv_rec[F_IS_READONLY] = "1";
+  snprintf(sha1_buf, sizeof(sha1_buf), "%s", unparse_sha1(pe->sha1));
+  csv_rec[F_SHA1] = sha1_buf;
+  if (pe->locale_id >= 0) {
+    snprintf(locale_id_buf, sizeof(locale_id_buf), "%d", pe->locale_id);
+    csv_rec[F_LOCALE_ID] = locale_id_buf;
+  }
+  if (pe->pages > 0) {
+    snprintf(pages_buf, sizeof(pages_buf), "%d", pe->pages);
+    csv_rec[F_PAGES] = pages_buf;
+  }
+  if (pe->judge_id > 0) {
+    snprintf(judge_id_buf, sizeof(judge_id_buf), "%d", pe->judge_id);
+    csv_rec[F_JUDGE_ID] = judge_id_buf;
+  }
+
+  snprintf(prob_id_buf, sizeof(prob_id_buf), "%d", pe->prob_id);
+  csv_rec[F_PROB_ID] = prob_id_buf;
+
+  if (pe->prob_id > 0 && pe->prob_id <= cs->max_prob
+      && (prob = cs->probs[pe->prob_id])) {
+    csv_rec[F_PROB_SHORT_NAME] = prob->short_name;
+    if (prob->variant_num > 0) {
+      snprintf(db_variant_buf, sizeof(db_variant_buf), "%d", pe->variant);
+      variant = find_variant(cs, pe->user_id, pe->prob_id, 0);
+      if (variant < 0) variant = 0;
+      snprintf(variant_buf, sizeof(variant_buf), "%d", variant);
+      csv_rec[F_VARIANT] = variant_buf;
+      csv_rec[F_VARIANT_DB] = db_variant_buf;
+    }
+  }
+
+  snprintf(lang_id_buf, sizeof(lang_id_buf), "%d", pe->lang_id);
+  csv_rec[F_LANG_ID] = lang_id_buf;
+
+  if (pe->lang_id > 0 && pe->lang_id <= cs->max_lang
+      && (lang = cs->langs[pe->lang_id])) {
+    csv_rec[F_LANG_SHORT_NAME] = lang->short_name;
+    csv_rec[F_SOURCE_SUFFIX] = lang->src_sfx;
+  } else if (!pe->lang_id) {
+    csv_rec[F_MIME_TYPE] = mime_type_get_type(pe->mime_type);
+    csv_rec[F_SOURCE_SUFFIX] = mime_type_get_suffix(pe->mime_type);
+  }
+
+  if (global->score_system == SCORE_ACM) {
+    if (has_failed_test_num[pe->status]) {
+      snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
+      if (pe->passed_mode > 0) {
+        csv_rec[F_PASSED_TESTS] = failed_test_buf;
+      } else {
+        csv_rec[F_FAILED_TEST] = failed_test_buf;
+      }
+    }
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  } else if (global->score_system == SCORE_MOSCOW) {
+    if (has_failed_test_num[pe->status]) {
+      snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
+      if (pe->passed_mode > 0) {
+        csv_rec[F_PASSED_TESTS] = failed_test_buf;
+      } else {
+        csv_rec[F_FAILED_TEST] = failed_test_buf;
+      }
+    }
+    snprintf(score_buf, sizeof(score_buf), "%d", pe->score);
+    csv_rec[F_TOTAL_SCORE] = score_buf;
+    csv_rec[F_BASE_SCORE] = score_buf;
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  } else if (global->score_system == SCORE_OLYMPIAD) {
+    if (pe->passed_mode > 0 && pe->test >= 0) {
+      snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
+      csv_rec[F_PASSED_TESTS] = passed_tests_buf;        
+    } else {
+      if (has_failed_test_num[pe->status]) {
+        snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
+        csv_rec[F_FAILED_TEST] = failed_test_buf;
+      }
+      if (has_passed_tests[pe->status]) {
+        snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
+        csv_rec[F_PASSED_TESTS] = passed_tests_buf;
+      }
+    }
+    if (has_olympiad_score[pe->status]) {
+      snprintf(score_buf, sizeof(score_buf), "%d", pe->score);
+      csv_rec[F_TOTAL_SCORE] = score_buf;
+      csv_rec[F_BASE_SCORE] = score_buf;
+    }
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  } else if (global->score_system == SCORE_KIROV) {
+    if (!has_kirov_score[pe->status]) {
+      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+      return;
+    }
+
+    if (pe->passed_mode > 0) {
+      snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
+    } else {
+      snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test - 1);
+    }
+    csv_rec[F_PASSED_TESTS] = passed_tests_buf;
+
+    prev_successes = RUN_TOO_MANY;
+    score_bonus = 0;
+    if (pe->status == RUN_OK && !pe->is_hidden
+        && prob && prob->score_bonus_total > 0) {
+      if ((prev_successes = run_get_prev_successes(cs->runlog_state, rid))<0)
+        prev_successes = RUN_TOO_MANY;
+      if (prev_successes != RUN_TOO_MANY) {
+        snprintf(prev_successes_buf, sizeof(prev_successes_buf),
+                 "%d", prev_successes);
+        csv_rec[F_PREV_SUCCESSES] = prev_successes_buf;
+      }
+      if (prev_successes >= 0 && prev_successes < prob->score_bonus_total)
+        score_bonus = prob->score_bonus_val[prev_successes];
+      snprintf(score_bonus_buf, sizeof(score_bonus_buf), "%d", score_bonus);
+      csv_rec[F_SUCCESS_BONUS] = score_bonus_buf;
+    }
+
+    attempts = 0; disq_attempts = 0;
+    if (global->score_system == SCORE_KIROV && !pe->is_hidden) {
+      run_get_attempts(cs->runlog_state, rid, &attempts, &disq_attempts,
+                       global->ignore_compile_errors);
+    }
+
+    orig_score = pe->score;
+    if (pe->status == RUN_OK && prob && !prob->variable_full_score)
+      orig_score = prob->full_score;
+    snprintf(base_score_buf, sizeof(base_score_buf), "%d", orig_score);
+    csv_rec[F_BASE_SCORE] = base_score_buf;
+    score = calc_kirov_score(0, 0, start_time, 0, 0, pe, prob, attempts, disq_attempts,
+                             prev_successes, &date_penalty, 0);
+    snprintf(score_buf, sizeof(score_buf), "%d", score);
+    csv_rec[F_TOTAL_SCORE] = score_buf;
+    if (attempts > 0) {
+      snprintf(attempts_buf, sizeof(attempts_buf), "%d", attempts);
+      csv_rec[F_PREV_ATTEMPTS] = attempts_buf;
+    }
+    if (attempts * prob->run_penalty != 0) {
+      snprintf(attempts_penalty_buf, sizeof(attempts_penalty_buf),
+               "%d", attempts * prob->run_penalty);
+      csv_rec[F_ATTEMPT_PENALTY] = attempts_penalty_buf;
+    }
+    if (disq_attempts > 0) {
+      snprintf(disq_attempts_buf, sizeof(disq_attempts_buf),
+               "%d", disq_attempts);
+      csv_rec[F_PREV_DISQUAL] = disq_attempts_buf;
+    }
+    if (disq_attempts * prob->disqualified_penalty != 0) {
+      snprintf(disq_attempts_penalty_buf, sizeof(disq_attempts_penalty_buf),
+               "%d", disq_attempts * prob->disqualified_penalty);
+      csv_rec[F_DISQUAL_PENALTY] = disq_attempts_penalty_buf;
+    }
+    if (date_penalty != 0) {
+      snprintf(date_penalty_buf, sizeof(date_penalty_buf),
+               "%d", date_penalty);
+      csv_rec[F_TIME_PENALTY] = date_penalty_buf;
+    }
+    if (pe->score_adj != 0) {
+      snprintf(score_adj_buf, sizeof(score_adj_buf), "%d", pe->score_adj);
+      csv_rec[F_SCORE_ADJUSTMENT] = score_adj_buf;
+    }
+    write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
+    return;
+  } else {
+    abort();
+  }
+}
+
+/*
+ * The large run dumps are not generated entirely in memory, but
+ * are written chunk by chunk as the client connection accepts the data
+ * (see nsf_new_autoclose_source). The set of the runs is selected
+ * when the request is processed, and the contest state is looked up
+ * again for each chunk, since the contest may be reloaded meanwhile.
+ */
+enum
+{
+  RUN_DUMP_CHUNK = 1024,        /* runs in one chunk of the CSV output */
+};
+
+struct run_dump_source
+{
+  struct nsf_write_source b;
+  int contest_id;
+  int format;
+  int *runs;                    /* for RUN_DUMP_ALL_CSV NULL */
+  int run_count;
+  int pos;                      /* the next run or the next part */
+};
+
+// columns of the columnar dump
+enum
+{
+  RC_RUN_ID,
+  RC_TIME,
+  RC_NSEC,
+  RC_USER_ID,
+  RC_PROB_ID,
+  RC_LANG_ID,
+  RC_STATUS,
+  RC_SCORE,
+  RC_SCORE_ADJ,
+  RC_TEST,
+  RC_PASSED_MODE,
+  RC_SIZE,
+  RC_VARIANT,
+  RC_IS_HIDDEN,
+  RC_IS_IMPORTED,
+  RC_IS_READONLY,
+  RC_JUDGE_ID,
+  RC_LOCALE_ID,
+
+  RC_TOTAL_COLUMNS,
+};
+static const struct runs_columnar_column columnar_columns[RC_TOTAL_COLUMNS] =
+{
+  [RC_RUN_ID] = { "run_id", RUNS_COLUMNAR_INT, 4 },
+  [RC_TIME] = { "time", RUNS_COLUMNAR_INT, 8 },
+  [RC_NSEC] = { "nsec", RUNS_COLUMNAR_INT, 4 },
+  [RC_USER_ID] = { "user_id", RUNS_COLUMNAR_INT, 4 },
+  [RC_PROB_ID] = { "prob_id", RUNS_COLUMNAR_INT, 4 },
+  [RC_LANG_ID] = { "lang_id", RUNS_COLUMNAR_INT, 4 },
+  [RC_STATUS] = { "status", RUNS_COLUMNAR_UINT, 1 },
+  [RC_SCORE] = { "score", RUNS_COLUMNAR_INT, 4 },
+  [RC_SCORE_ADJ] = { "score_adj", RUNS_COLUMNAR_INT, 4 },
+  [RC_TEST] = { "test", RUNS_COLUMNAR_INT, 2 },
+  [RC_PASSED_MODE] = { "passed_mode", RUNS_COLUMNAR_INT, 1 },
+  [RC_SIZE] = { "size", RUNS_COLUMNAR_UINT, 4 },
+  [RC_VARIANT] = { "variant", RUNS_COLUMNAR_UINT, 1 },
+  [RC_IS_HIDDEN] = { "is_hidden", RUNS_COLUMNAR_UINT, 1 },
+  [RC_IS_IMPORTED] = { "is_imported", RUNS_COLUMNAR_UINT, 1 },
+  [RC_IS_READONLY] = { "is_readonly", RUNS_COLUMNAR_UINT, 1 },
+  [RC_JUDGE_ID] = { "judge_id", RUNS_COLUMNAR_UINT, 2 },
+  [RC_LOCALE_ID] = { "locale_id", RUNS_COLUMNAR_INT, 2 },
+};
+
+// dictionaries of the columnar dump
+enum
+{
+  RD_USER_LOGIN,
+  RD_PROB_SHORT_NAME,
+  RD_LANG_SHORT_NAME,
+
+  RD_TOTAL_DICTS,
+};
+static const unsigned char * const columnar_dicts[RD_TOTAL_DICTS] =
+{
+  [RD_USER_LOGIN] = "user_login",
+  [RD_PROB_SHORT_NAME] = "prob_short_name",
+  [RD_LANG_SHORT_NAME] = "lang_short_name",
+};
+
+static long long
+columnar_value(const struct run_entry *pe, int rid, int col)
+{
+  if (col == RC_RUN_ID) return rid;
+  if (!pe) return col == RC_STATUS ? RUN_EMPTY : 0;
+  switch (col) {
+  case RC_TIME:        return pe->time;
+  case RC_NSEC:        return pe->nsec;
+  case RC_USER_ID:     return pe->user_id;
+  case RC_PROB_ID:     return pe->prob_id;
+  case RC_LANG_ID:     return pe->lang_id;
+  case RC_STATUS:      return pe->status;
+  case RC_SCORE:       return pe->score;
+  case RC_SCORE_ADJ:   return pe->score_adj;
+  case RC_TEST:        return pe->test;
+  case RC_PASSED_MODE: return pe->passed_mode;
+  case RC_SIZE:        return pe->size;
+  case RC_VARIANT:     return pe->variant;
+  case RC_IS_HIDDEN:   return pe->is_hidden;
+  case RC_IS_IMPORTED: return pe->is_imported;
+  case RC_IS_READONLY: return pe->is_readonly;
+  case RC_JUDGE_ID:    return pe->judge_id;
+  case RC_LOCALE_ID:   return pe->locale_id;
+  default:
+    abort();
+  }
+}
+
+/* the numbers are stored little-endian regardless of the host */
+static void
+put_le(unsigned char *p, unsigned long long v, int width)
+{
+  int j;
+
+  for (j = 0; j < width; ++j, v >>= 8) p[j] = v & 0xff;
+}
+
+#define PUT_LE(buf, type, field, v) \
+  put_le((buf) + offsetof(type, field), (v), sizeof(((type*) 0)->field))
+
+static void
+write_columnar_padding(FILE *f, size_t size)
+{
+  static const unsigned char zeros[8];
+
+  if ((size % 8)) fwrite(zeros, 1, 8 - size % 8, f);
+}
+
+static void
+write_columnar_header(
+        FILE *f,
+        const serve_state_t cs,
+        const struct run_dump_source *src)
+{
+  unsigned char hdr[sizeof(struct runs_columnar_header)];
+  unsigned char col[sizeof(struct runs_columnar_column)];
+  int i;
+
+  memset(hdr, 0, sizeof(hdr));
+  memcpy(hdr, RUNS_COLUMNAR_MAGIC, strlen(RUNS_COLUMNAR_MAGIC));
+  PUT_LE(hdr, struct runs_columnar_header, version, RUNS_COLUMNAR_VERSION);
+  PUT_LE(hdr, struct runs_columnar_header, header_size, sizeof(hdr));
+  PUT_LE(hdr, struct runs_columnar_header, run_count, src->run_count);
+  PUT_LE(hdr, struct runs_columnar_header, column_count, RC_TOTAL_COLUMNS);
+  PUT_LE(hdr, struct runs_columnar_header, dict_count, RD_TOTAL_DICTS);
+  PUT_LE(hdr, struct runs_columnar_header, start_time,
+         run_get_start_time(cs->runlog_state));
+  PUT_LE(hdr, struct runs_columnar_header, export_time, time(0));
+  fwrite(hdr, sizeof(hdr), 1, f);
+
+  for (i = 0; i < RC_TOTAL_COLUMNS; ++i) {
+    memset(col, 0, sizeof(col));
+    memcpy(col, columnar_columns[i].name, sizeof(columnar_columns[i].name));
+    PUT_LE(col, struct runs_columnar_column, type, columnar_columns[i].type);
+    PUT_LE(col, struct runs_columnar_column, width, columnar_columns[i].width);
+    fwrite(col, sizeof(col), 1, f);
+  }
+}
+
+static void
+write_columnar_column(
+        FILE *f,
+        const serve_state_t cs,
+        const struct run_dump_source *src,
+        int col)
+{
+  const struct run_entry *rentries = run_get_entries_ptr(cs->runlog_state);
+  int rtotal = run_get_total(cs->runlog_state);
+  int width = columnar_columns[col].width;
+  size_t size = (size_t) src->run_count * width;
+  unsigned char *buf, *p;
+  long long v;
+  int i, rid;
+
+  p = buf = (unsigned char*) xmalloc(size + 1);
+  for (i = 0; i < src->run_count; ++i, p += width) {
+    rid = src->runs[i];
+    v = columnar_value(rid < rtotal ? &rentries[rid] : 0, rid, col);
+    put_le(p, v, width);
+  }
+  fwrite(buf, 1, size, f);
+  write_columnar_padding(f, size);
+  xfree(buf);
+}
+
+static int
+int_sort_func(const void *p1, const void *p2)
+{
+  int v1 = *(const int*) p1, v2 = *(const int*) p2;
+  if (v1 < v2) return -1;
+  return v1 > v2;
+}
+
+static void
+write_columnar_dict(
+        FILE *f,
+        const serve_state_t cs,
+        const struct run_dump_source *src,
+        int dict)
+{
+  const struct run_entry *rentries = run_get_entries_ptr(cs->runlog_state);
+  int rtotal = run_get_total(cs->runlog_state);
+  int *ids = 0;
+  const unsigned char **strs = 0;
+  int id_count = 0, count = 0, i, rid;
+  unsigned char dh[sizeof(struct runs_columnar_dict)];
+  unsigned char de[sizeof(struct runs_columnar_dict_entry)];
+  size_t size = 0;
+
+  switch (dict) {
+  case RD_USER_LOGIN:
+    // the users, who have runs in the dump
+    XCALLOC(ids, src->run_count + 1);
+    for (i = 0; i < src->run_count; ++i) {
+      if ((rid = src->runs[i]) < rtotal) ids[id_count++] = rentries[rid].user_id;
+    }
+    qsort(ids, id_count, sizeof(ids[0]), int_sort_func);
+    XCALLOC(strs, id_count + 1);
+    for (i = 0; i < id_count; ++i) {
+      if (i > 0 && ids[i] == ids[i - 1]) continue;
+      if (!(strs[count] = teamdb_get_login(cs->teamdb_state, ids[i])))
+        continue;
+      ids[count++] = ids[i];
+    }
+    break;
+  case RD_PROB_SHORT_NAME:
+    XCALLOC(ids, cs->max_prob + 1);
+    XCALLOC(strs, cs->max_prob + 1);
+    for (i = 1; i <= cs->max_prob; ++i) {
+      if (!cs->probs[i]) continue;
+      ids[count] = i;
+      strs[count++] = cs->probs[i]->short_name;
+    }
+    break;
+  case RD_LANG_SHORT_NAME:
+    XCALLOC(ids, cs->max_lang + 1);
+    XCALLOC(strs, cs->max_lang + 1);
+    for (i = 1; i <= cs->max_lang; ++i) {
+      if (!cs->langs[i]) continue;
+      ids[count] = i;
+      strs[count++] = cs->langs[i]->short_name;
+    }
+    break;
+  default:
+    abort();
+  }
+
+  for (i = 0; i < count; ++i) size += strlen(strs[i]) + 1;
+  memset(dh, 0, sizeof(dh));
+  snprintf(dh, sizeof(((struct runs_columnar_dict*) 0)->name), "%s",
+           columnar_dicts[dict]);
+  PUT_LE(dh, struct runs_columnar_dict, count, count);
+  PUT_LE(dh, struct runs_columnar_dict, size, size);
+  fwrite(dh, sizeof(dh), 1, f);
+  size = 0;
+  for (i = 0; i < count; ++i) {
+    PUT_LE(de, struct runs_columnar_dict_entry, id, ids[i]);
+    PUT_LE(de, struct runs_columnar_dict_entry, offset, size);
+    fwrite(de, sizeof(de), 1, f);
+    size += strlen(strs[i]) + 1;
+  }
+  for (i = 0; i < count; ++i) fwrite(strs[i], 1, strlen(strs[i]) + 1, f);
+  write_columnar_padding(f, size);
+
+  xfree(ids);
+  xfree(strs);
+}
+
+/* writes the next part of the dump, returns 0 if there is no more data */
+static int
+write_run_dump_part(
+        FILE *f,
+        const serve_state_t cs,
+        struct run_dump_source *src)
+{
+  int i, rtotal, last;
+  time_t start_time;
+
+  switch (src->format) {
+  case RUN_DUMP_MASTER_CSV:
+    if (src->pos >= src->run_count) return 0;
+    rtotal = run_get_total(cs->runlog_state);
+    start_time = run_get_start_time(cs->runlog_state);
+    for (i = 0; i < RUN_DUMP_CHUNK && src->pos < src->run_count; ++i) {
+      if (src->runs[src->pos] < rtotal)
+        write_master_run_csv(f, cs, start_time, src->runs[src->pos]);
+      src->pos++;
+    }
+    return 1;
+
+  case RUN_DUMP_ALL_CSV:
+    if (src->pos >= src->run_count) return 0;
+    last = src->pos + RUN_DUMP_CHUNK;
+    if (last > src->run_count) last = src->run_count;
+    write_runs_dump_range(cs, f, src->pos, last);
+    src->pos = last;
+    return 1;
+
+  case RUN_DUMP_COLUMNAR:
+    if (src->pos == 0) {
+      write_columnar_header(f, cs, src);
+    } else if (src->pos <= RC_TOTAL_COLUMNS) {
+      write_columnar_column(f, cs, src, src->pos - 1);
+    } else if (src->pos <= RC_TOTAL_COLUMNS + RD_TOTAL_DICTS) {
+      write_columnar_dict(f, cs, src, src->pos - RC_TOTAL_COLUMNS - 1);
+    } else {
+      return 0;
+    }
+    src->pos++;
+    return 1;
+
+  default:
+    abort();
+  }
+}
+
+static int
+run_dump_next_chunk(
+        struct nsf_write_source *b,
+        unsigned char **p_buf,
+        int *p_len)
+{
+  struct run_dump_source *src = (struct run_dump_source*) b;
+  const struct contest_extra *extra;
+  char *txt = 0;
+  size_t size = 0;
+  FILE *f;
+  int r;
+
+  if (!(extra = ns_try_contest_extra(src->contest_id))
+      || !extra->serve_state) {
+    err("run_dump_next_chunk: contest %d is not loaded", src->contest_id);
+    return -1;
+  }
+  if (!(f = open_memstream(&txt, &size))) return -1;
+  r = write_run_dump_part(f, extra->serve_state, src);
+  close_memstream(f);
+  *p_buf = txt;
+  *p_len = size;
+  return r;
+}
+
+static void
+run_dump_destroy(struct nsf_write_source *b)
+{
+  struct run_dump_source *src = (struct run_dump_source*) b;
+
+  xfree(src->runs);
+  xfree(src);
+}
+
+/* takes the ownership of runs */
+static struct run_dump_source *
+run_dump_source_new(int contest_id, int format, int *runs, int run_count)
+{
+  struct run_dump_source *src;
+
+  XCALLOC(src, 1);
+  src->b.next_chunk = run_dump_next_chunk;
+  src->b.destroy = run_dump_destroy;
+  src->contest_id = contest_id;
+  src->format = format;
+  src->runs = runs;
+  src->run_count = run_count;
+  return src;
+}
+
+/* writes the small dumps immediately and streams the large ones */
+static void
+run_dump_start(
+        FILE *fout,
+        struct http_request_info *phr,
+        const serve_state_t cs,
+        int format,
+        int *runs,
+        int run_count)
+{
+  struct run_dump_source *src;
+
+  src = run_dump_source_new(phr->contest_id, format, runs, run_count);
+  if (run_count > RUN_DUMP_CHUNK) {
+    phr->out_source = &src->b;
+    return;
+  }
+  while (write_run_dump_part(fout, cs, src));
+  run_dump_destroy(&src->b);
+}
+
+static int
+do_dump_master_runs(
+        FILE *fout,
+        struct http_request_info *phr,
+        const struct contest_desc *cnts,
+        struct contest_extra *extra,
+        int first_run_set,
+        int first_run,
+        int last_run_set,
+        int last_run,
+        unsigned char const *filter_expr,
+        int format)
+{
+  struct user_filter_info *u = 0;
+  struct filter_env env;
+  int i, r;
+  int *match_idx = 0;
+  int match_tot = 0;
+  int transient_tot = 0;
+  int *list_idx = 0;
+  int list_tot = 0;
+
+  const serve_state_t cs = extra->serve_state;
+
   filter_expr_nerrs = 0;
   u = user_filter_info_allocate(cs, phr->user_id, phr->session_id);
   if (u->prev_filter_expr) xfree(u->prev_filter_expr);
@@ -1461,8 +2132,7 @@ do_dump_master_runs(
   env.cur_time = time(0);
   env.rentries = run_get_entries_ptr(cs->runlog_state);
 
-  match_idx = alloca((env.rtotal + 1) * sizeof(match_idx[0]));
-  memset(match_idx, 0, (env.rtotal + 1) * sizeof(match_idx[0]));
+  XCALLOC(match_idx, env.rtotal + 1);
   match_tot = 0;
   transient_tot = 0;
 
@@ -1483,11 +2153,11 @@ do_dump_master_runs(
   }
   env.mem = filter_tree_delete(env.mem);
   if (u->error_msgs) {
+    xfree(match_idx);
     return -NEW_SRV_ERR_INV_FILTER_EXPR;
   }
 
-  list_idx = alloca((env.rtotal + 1) * sizeof(list_idx[0]));
-  memset(list_idx, 0, (env.rtotal + 1) * sizeof(list_idx[0]));
+  XCALLOC(list_idx, env.rtotal + 1);
   list_tot = 0;
 
   if (!first_run_set) {
@@ -1539,253 +2209,9 @@ do_dump_master_runs(
     for (i = first_run; i >= last_run; i--)
       list_idx[list_tot++] = match_idx[i];
   }
+  xfree(match_idx);
 
-  for (i = 0; i < list_tot; i++) {
-    memset(csv_rec, 0, sizeof(csv_rec));
-
-    rid = list_idx[i];
-    ASSERT(rid >= 0 && rid < env.rtotal);
-    pe = &env.rentries[rid];
-    snprintf(run_id_buf, sizeof(run_id_buf), "%d", rid);
-    csv_rec[F_RUN_ID] = run_id_buf;
-    if (!run_is_valid_status(pe->status)) {
-      snprintf(statstr, sizeof(statstr), "%d", pe->status);
-      csv_rec[F_STATUS_SHORT] = statstr;
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    }
-
-    run_status_to_str_short(statstr, sizeof(statstr), pe->status);
-    csv_rec[F_STATUS_SHORT] = statstr;
-
-    if (pe->status == RUN_EMPTY) {
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    }
-
-    snprintf(run_date_buf, sizeof(run_date_buf), "%s",
-             xml_unparse_date(pe->time));
-    csv_rec[F_TIME] = run_date_buf;
-    snprintf(nsec_buf, sizeof(nsec_buf), "%d", pe->nsec);
-    csv_rec[F_NSEC] = nsec_buf;
-    run_time = pe->time;
-    if (global->is_virtual) {
-      start_time = run_get_virtual_start_time(cs->runlog_state, pe->user_id);
-    } else {
-      start_time = env.rhead.start_time;
-    }
-    if (run_time < start_time) {
-      dur_str[0] = 0;
-    } else {
-      duration = run_time - start_time;
-      dur_sec = duration % 60; duration /= 60;
-      dur_min = duration % 60; duration /= 60;
-      dur_hour = duration % 24; duration /= 24;
-      if (duration > 0) {
-        snprintf(dur_str, sizeof(dur_str), "%d %02d:%02d:%02d",
-                 duration, dur_hour, dur_min, dur_sec);
-      } else {
-        snprintf(dur_str, sizeof(dur_str), "%02d:%02d:%02d",
-                 dur_hour, dur_min, dur_sec);
-      }
-    }
-    csv_rec[F_DURATION] = dur_str;
-
-    snprintf(user_id_buf, sizeof(user_id_buf), "%d", pe->user_id);
-    csv_rec[F_USER_ID] = user_id_buf;
-    if ((user_login = teamdb_get_login(cs->teamdb_state, pe->user_id))) {
-      user_flags = teamdb_get_flags(cs->teamdb_state, pe->user_id);
-      if ((user_flags & TEAM_BANNED)) csv_rec[F_IS_USER_BANNED] = "1";
-      if ((user_flags & TEAM_INVISIBLE)) csv_rec[F_IS_USER_INVISIBLE] = "1";
-      if ((user_flags & TEAM_LOCKED)) csv_rec[F_IS_USER_LOCKED] = "1";
-      if ((user_flags & TEAM_INCOMPLETE)) csv_rec[F_IS_USER_INCOMPLETE] = "1";
-      if ((user_flags & TEAM_DISQUALIFIED)) csv_rec[F_IS_USER_DISQUALIFIED]="1";
-    } else {
-      user_login = "";
-    }
-    csv_rec[F_USER_LOGIN] = user_login;
-
-    snprintf(ip_buf, sizeof(ip_buf), "%s", xml_unparse_ip(pe->a.ip));
-    csv_rec[F_IP] = ip_buf;
-    if (pe->ipv6_flag) csv_rec[F_IS_IPV6] = "1";
-    if (pe->ssl_flag) csv_rec[F_IS_SSL] = "1";
-
-    if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP) {
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    }
-
-    if (pe->is_hidden) csv_rec[F_IS_HIDDEN] = "1";
-    if (pe->is_imported) csv_rec[F_IS_IMPORTED] = "1";
-    if (pe->is_readonly) csv_rec[F_IS_READONLY] = "1";
-    snprintf(sha1_buf, sizeof(sha1_buf), "%s", unparse_sha1(pe->sha1));
-    csv_rec[F_SHA1] = sha1_buf;
-    if (pe->locale_id >= 0) {
-      snprintf(locale_id_buf, sizeof(locale_id_buf), "%d", pe->locale_id);
-      csv_rec[F_LOCALE_ID] = locale_id_buf;
-    }
-    if (pe->pages > 0) {
-      snprintf(pages_buf, sizeof(pages_buf), "%d", pe->pages);
-      csv_rec[F_PAGES] = pages_buf;
-    }
-    if (pe->judge_id > 0) {
-      snprintf(judge_id_buf, sizeof(judge_id_buf), "%d", pe->judge_id);
-      csv_rec[F_JUDGE_ID] = judge_id_buf;
-    }
-
-    snprintf(prob_id_buf, sizeof(prob_id_buf), "%d", pe->prob_id);
-    csv_rec[F_PROB_ID] = prob_id_buf;
-
-    if (pe->prob_id > 0 && pe->prob_id <= cs->max_prob
-        && (prob = cs->probs[pe->prob_id])) {
-      csv_rec[F_PROB_SHORT_NAME] = prob->short_name;
-      if (prob->variant_num > 0) {
-        snprintf(db_variant_buf, sizeof(db_variant_buf), "%d", pe->variant);
-        variant = find_variant(cs, pe->user_id, pe->prob_id, 0);
-        if (variant < 0) variant = 0;
-        snprintf(variant_buf, sizeof(variant_buf), "%d", variant);
-        csv_rec[F_VARIANT] = variant_buf;
-        csv_rec[F_VARIANT_DB] = db_variant_buf;
-      }
-    }
-
-    snprintf(lang_id_buf, sizeof(lang_id_buf), "%d", pe->lang_id);
-    csv_rec[F_LANG_ID] = lang_id_buf;
-
-    if (pe->lang_id > 0 && pe->lang_id <= cs->max_lang
-        && (lang = cs->langs[pe->lang_id])) {
-      csv_rec[F_LANG_SHORT_NAME] = lang->short_name;
-      csv_rec[F_SOURCE_SUFFIX] = lang->src_sfx;
-    } else if (!pe->lang_id) {
-      csv_rec[F_MIME_TYPE] = mime_type_get_type(pe->mime_type);
-      csv_rec[F_SOURCE_SUFFIX] = mime_type_get_suffix(pe->mime_type);
-    }
-
-    if (global->score_system == SCORE_ACM) {
-      if (has_failed_test_num[pe->status]) {
-        snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
-        if (pe->passed_mode > 0) {
-          csv_rec[F_PASSED_TESTS] = failed_test_buf;
-        } else {
-          csv_rec[F_FAILED_TEST] = failed_test_buf;
-        }
-      }
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    } else if (global->score_system == SCORE_MOSCOW) {
-      if (has_failed_test_num[pe->status]) {
-        snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
-        if (pe->passed_mode > 0) {
-          csv_rec[F_PASSED_TESTS] = failed_test_buf;
-        } else {
-          csv_rec[F_FAILED_TEST] = failed_test_buf;
-        }
-      }
-      snprintf(score_buf, sizeof(score_buf), "%d", pe->score);
-      csv_rec[F_TOTAL_SCORE] = score_buf;
-      csv_rec[F_BASE_SCORE] = score_buf;
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    } else if (global->score_system == SCORE_OLYMPIAD) {
-      if (pe->passed_mode > 0 && pe->test >= 0) {
-        snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
-        csv_rec[F_PASSED_TESTS] = passed_tests_buf;        
-      } else {
-        if (has_failed_test_num[pe->status]) {
-          snprintf(failed_test_buf, sizeof(failed_test_buf), "%d", pe->test);
-          csv_rec[F_FAILED_TEST] = failed_test_buf;
-        }
-        if (has_passed_tests[pe->status]) {
-          snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
-          csv_rec[F_PASSED_TESTS] = passed_tests_buf;
-        }
-      }
-      if (has_olympiad_score[pe->status]) {
-        snprintf(score_buf, sizeof(score_buf), "%d", pe->score);
-        csv_rec[F_TOTAL_SCORE] = score_buf;
-        csv_rec[F_BASE_SCORE] = score_buf;
-      }
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    } else if (global->score_system == SCORE_KIROV) {
-      if (!has_kirov_score[pe->status]) {
-        write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-        continue;
-      }
-
-      if (pe->passed_mode > 0) {
-        snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test);
-      } else {
-        snprintf(passed_tests_buf, sizeof(passed_tests_buf), "%d", pe->test - 1);
-      }
-      csv_rec[F_PASSED_TESTS] = passed_tests_buf;
-
-      prev_successes = RUN_TOO_MANY;
-      score_bonus = 0;
-      if (pe->status == RUN_OK && !pe->is_hidden
-          && prob && prob->score_bonus_total > 0) {
-        if ((prev_successes = run_get_prev_successes(cs->runlog_state, rid))<0)
-          prev_successes = RUN_TOO_MANY;
-        if (prev_successes != RUN_TOO_MANY) {
-          snprintf(prev_successes_buf, sizeof(prev_successes_buf),
-                   "%d", prev_successes);
-          csv_rec[F_PREV_SUCCESSES] = prev_successes_buf;
-        }
-        if (prev_successes >= 0 && prev_successes < prob->score_bonus_total)
-          score_bonus = prob->score_bonus_val[prev_successes];
-        snprintf(score_bonus_buf, sizeof(score_bonus_buf), "%d", score_bonus);
-        csv_rec[F_SUCCESS_BONUS] = score_bonus_buf;
-      }
-
-      attempts = 0; disq_attempts = 0;
-      if (global->score_system == SCORE_KIROV && !pe->is_hidden) {
-        run_get_attempts(cs->runlog_state, rid, &attempts, &disq_attempts,
-                         global->ignore_compile_errors);
-      }
-
-      orig_score = pe->score;
-      if (pe->status == RUN_OK && !prob->variable_full_score)
-        orig_score = prob->full_score;
-      snprintf(base_score_buf, sizeof(base_score_buf), "%d", orig_score);
-      csv_rec[F_BASE_SCORE] = base_score_buf;
-      score = calc_kirov_score(0, 0, start_time, 0, 0, pe, prob, attempts, disq_attempts,
-                               prev_successes, &date_penalty, 0);
-      snprintf(score_buf, sizeof(score_buf), "%d", score);
-      csv_rec[F_TOTAL_SCORE] = score_buf;
-      if (attempts > 0) {
-        snprintf(attempts_buf, sizeof(attempts_buf), "%d", attempts);
-        csv_rec[F_PREV_ATTEMPTS] = attempts_buf;
-      }
-      if (attempts * prob->run_penalty != 0) {
-        snprintf(attempts_penalty_buf, sizeof(attempts_penalty_buf),
-                 "%d", attempts * prob->run_penalty);
-        csv_rec[F_ATTEMPT_PENALTY] = attempts_penalty_buf;
-      }
-      if (disq_attempts > 0) {
-        snprintf(disq_attempts_buf, sizeof(disq_attempts_buf),
-                 "%d", disq_attempts);
-        csv_rec[F_PREV_DISQUAL] = disq_attempts_buf;
-      }
-      if (disq_attempts * prob->disqualified_penalty != 0) {
-        snprintf(disq_attempts_penalty_buf, sizeof(disq_attempts_penalty_buf),
-                 "%d", disq_attempts * prob->disqualified_penalty);
-        csv_rec[F_DISQUAL_PENALTY] = disq_attempts_penalty_buf;
-      }
-      if (date_penalty != 0) {
-        snprintf(date_penalty_buf, sizeof(date_penalty_buf),
-                 "%d", date_penalty);
-        csv_rec[F_TIME_PENALTY] = date_penalty_buf;
-      }
-      if (pe->score_adj != 0) {
-        snprintf(score_adj_buf, sizeof(score_adj_buf), "%d", pe->score_adj);
-        csv_rec[F_SCORE_ADJUSTMENT] = score_adj_buf;
-      }
-      write_csv_record(fout, F_TOTAL_FIELDS, csv_rec);
-      continue;
-    } else {
-      abort();
-    }
-  }
+  run_dump_start(fout, phr, cs, format, list_idx, list_tot);
   return 0;
 }
 
@@ -1798,6 +2224,8 @@ cmd_dump_master_runs(
 {
   int retval = 0, first_run_set = 0, first_run = 0, last_run_set = 0, last_run = 0;
   const unsigned char *filter_expr = 0;
+  const unsigned char *s = 0;
+  int format = RUN_DUMP_MASTER_CSV;
 
   if (phr->role != USER_ROLE_ADMIN && phr->role != USER_ROLE_JUDGE)
     FAIL(NEW_SRV_ERR_PERMISSION_DENIED);
@@ -1812,8 +2240,19 @@ cmd_dump_master_runs(
   if (ns_cgi_param_int_opt_2(phr, "last_run", &last_run, &last_run_set) < 0)
     FAIL(NEW_SRV_ERR_INV_PARAM);
 
+  if (ns_cgi_param(phr, "format", &s) < 0)
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+  if (!s || !*s || !strcmp(s, "csv")) {
+    format = RUN_DUMP_MASTER_CSV;
+  } else if (!strcmp(s, "columnar")) {
+    format = RUN_DUMP_COLUMNAR;
+  } else {
+    FAIL(NEW_SRV_ERR_INV_PARAM);
+  }
+
   retval = do_dump_master_runs(fout, phr, cnts, extra,
-                               first_run_set, first_run, last_run_set, last_run, filter_expr);
+                               first_run_set, first_run, last_run_set, last_run,
+                               filter_expr, format);
 
  cleanup:
   return retval;
@@ -2095,9 +2534,9 @@ new_server_cmd_handler(FILE *fout, struct http_request_info *phr)
   }
 
   if (phr->name && *phr->name) {
-    phr->name_arm = html_armor_string_dup(phr->name);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->name);
   } else {
-    phr->name_arm = html_armor_string_dup(phr->login);
+    phr->name_arm = (unsigned char*) ns_arena_armor(phr, phr->login);
   }
   if (extra->contest_arm) xfree(extra->contest_arm);
   if (phr->locale_id == 0 && cnts->name_en) {
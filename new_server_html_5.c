@@ -982,6 +982,7 @@ change_locale(FILE *fout, struct http_request_info *phr)
                                phr->client_key,
                                phr->locale_id);
     }
+    ns_drop_cached_cookie(phr->session_id);
 
     fprintf(fout, "Location: %s?SID=%016llx", phr->self_url, phr->session_id);
     if (next_action > 0) fprintf(fout, "&action=%d", next_action);
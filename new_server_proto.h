@@ -37,6 +37,10 @@ enum
   NEW_SRV_CMD_STOP,
   NEW_SRV_CMD_RESTART,
   NEW_SRV_CMD_HTTP_REQUEST,
+  NEW_SRV_CMD_GET_STATS,
+  NEW_SRV_CMD_ENABLE_STATS,
+  NEW_SRV_CMD_DISABLE_STATS,
+  NEW_SRV_CMD_RESET_STATS,
 
   NEW_SRV_CMD_LAST,
 };
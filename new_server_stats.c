@@ -0,0 +1,384 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "new-server.h"
+#include "server_framework.h"
+#include "errlog.h"
+#include "xml_utils.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+/*
+ * The performance statistics of the server. The latencies are kept in
+ * the log-linear histograms: the values below 2 * HIST_SUB_COUNT
+ * microseconds are exact, each next power of two is split into
+ * HIST_SUB_COUNT buckets, so the relative error of a percentile is
+ * below 1 / HIST_SUB_COUNT at any scale and a histogram has a fixed
+ * size. The histograms are allocated on the first use, the actions
+ * and the contests never requested cost nothing. The contest id comes
+ * from the request, so only the contests loaded by the server get a
+ * histogram, their number is bounded by the server configuration.
+ *
+ * While the statistics are disabled, the callers do not even read
+ * the clock, ns_stats_enabled is checked first.
+ */
+
+enum
+{
+  HIST_SUB_BITS = 4,
+  HIST_SUB_COUNT = 1 << HIST_SUB_BITS,
+  HIST_MAX_BITS = 36,           /* about 19 hours */
+  HIST_BUCKETS = (HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT,
+};
+
+struct ns_stats_hist
+{
+  long long count;
+  long long total;
+  long long max_value;
+  long long out_total;          /* the output size */
+  long long out_max;
+  unsigned counts[HIST_BUCKETS];
+};
+
+struct ns_stats_contest
+{
+  int contest_id;
+  struct ns_stats_hist hist;
+};
+
+int ns_stats_enabled;
+
+static time_t stats_start_time;
+static struct server_framework_loop_stats loop_stats;
+static long long phase_usec[NS_STATS_PHASE_LAST];
+static long long phase_max_usec[NS_STATS_PHASE_LAST];
+static struct ns_stats_hist *action_hists[NEW_SRV_ACTION_LAST];
+static struct ns_stats_hist *packet_hists[NS_STATS_PACKET_LAST];
+static int contest_u, contest_a;
+static struct ns_stats_contest **contest_stats; /* sorted by contest_id */
+
+static const unsigned char * const framework_phase_names[NSF_PHASE_LAST] =
+{
+  [NSF_PHASE_LOOP_START] = "loop start",
+  [NSF_PHASE_POLL] = "poll wait",
+  [NSF_PHASE_WATCHES] = "watches",
+  [NSF_PHASE_IO] = "connection i/o",
+  [NSF_PHASE_COMMANDS] = "commands",
+};
+static const unsigned char * const phase_names[NS_STATS_PHASE_LAST] =
+{
+  [NS_STATS_PHASE_JOBS] = "jobs",
+  [NS_STATS_PHASE_PACKETS] = "packets",
+  [NS_STATS_PHASE_COMMIT] = "commit",
+};
+static const unsigned char * const packet_names[NS_STATS_PACKET_LAST] =
+{
+  [NS_STATS_PACKET_COMPILE] = "compile",
+  [NS_STATS_PACKET_RUN] = "run",
+};
+
+long long
+ns_stats_get_usec(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static int
+hist_index(long long value)
+{
+  int bits = 0, shift, index;
+
+  if (value < 0) value = 0;
+  if (value < 2 * HIST_SUB_COUNT) return value;
+  while ((value >> bits) > 1) ++bits;
+  shift = bits - HIST_SUB_BITS;
+  index = shift * HIST_SUB_COUNT + (int) (value >> shift);
+  if (index >= HIST_BUCKETS) index = HIST_BUCKETS - 1;
+  return index;
+}
+
+/* the highest value, which falls into the bucket */
+static long long
+hist_value(int index)
+{
+  int shift;
+
+  if (index < 2 * HIST_SUB_COUNT) return index;
+  shift = index / HIST_SUB_COUNT - 1;
+  return ((long long) (index % HIST_SUB_COUNT + HIST_SUB_COUNT + 1) << shift)
+    - 1;
+}
+
+static void
+hist_add(struct ns_stats_hist *h, long long value, long long out_size)
+{
+  if (value < 0) value = 0;
+  h->count++;
+  h->total += value;
+  if (value > h->max_value) h->max_value = value;
+  h->out_total += out_size;
+  if (out_size > h->out_max) h->out_max = out_size;
+  h->counts[hist_index(value)]++;
+}
+
+static long long
+hist_percentile(const struct ns_stats_hist *h, double p)
+{
+  long long rank, seen = 0;
+  int i;
+
+  if (h->count <= 0) return 0;
+  rank = (long long) (p * h->count / 100.0 + 0.5);
+  if (rank < 1) rank = 1;
+  for (i = 0; i < HIST_BUCKETS; ++i) {
+    seen += h->counts[i];
+    if (seen >= rank) break;
+  }
+  if (i >= HIST_BUCKETS) return h->max_value;
+  if (hist_value(i) > h->max_value) return h->max_value;
+  return hist_value(i);
+}
+
+static struct ns_stats_hist *
+get_contest_hist(int contest_id)
+{
+  int l = 0, r = contest_u, m;
+  struct ns_stats_contest *c;
+
+  while (l < r) {
+    m = (l + r) / 2;
+    if (contest_stats[m]->contest_id == contest_id)
+      return &contest_stats[m]->hist;
+    if (contest_stats[m]->contest_id < contest_id) l = m + 1;
+    else r = m;
+  }
+
+  if (contest_u == contest_a) {
+    if (!(contest_a *= 2)) contest_a = 16;
+    XREALLOC(contest_stats, contest_a);
+  }
+  if (l < contest_u)
+    memmove(&contest_stats[l + 1], &contest_stats[l],
+            (contest_u - l) * sizeof(contest_stats[0]));
+  XCALLOC(c, 1);
+  c->contest_id = contest_id;
+  contest_stats[l] = c;
+  ++contest_u;
+  return &c->hist;
+}
+
+void
+ns_stats_add_request(
+        int action,
+        int contest_id,
+        long long usec,
+        size_t out_size)
+{
+  if (!ns_stats_enabled) return;
+  if (action < 0 || action >= NEW_SRV_ACTION_LAST) action = 0;
+  if (!action_hists[action]) XCALLOC(action_hists[action], 1);
+  hist_add(action_hists[action], usec, out_size);
+  if (contest_id > 0 && ns_try_contest_extra(contest_id))
+    hist_add(get_contest_hist(contest_id), usec, out_size);
+}
+
+void
+ns_stats_add_packet(int kind, long long usec)
+{
+  if (!ns_stats_enabled) return;
+  if (kind < 0 || kind >= NS_STATS_PACKET_LAST) return;
+  if (!packet_hists[kind]) XCALLOC(packet_hists[kind], 1);
+  hist_add(packet_hists[kind], usec, 0);
+}
+
+void
+ns_stats_add_phase(int phase, long long usec)
+{
+  if (!ns_stats_enabled) return;
+  if (phase < 0 || phase >= NS_STATS_PHASE_LAST) return;
+  if (usec < 0) usec = 0;
+  phase_usec[phase] += usec;
+  if (usec > phase_max_usec[phase]) phase_max_usec[phase] = usec;
+}
+
+void
+ns_stats_reset(void)
+{
+  int i;
+
+  for (i = 0; i < NEW_SRV_ACTION_LAST; ++i) {
+    xfree(action_hists[i]); action_hists[i] = 0;
+  }
+  for (i = 0; i < NS_STATS_PACKET_LAST; ++i) {
+    xfree(packet_hists[i]); packet_hists[i] = 0;
+  }
+  for (i = 0; i < contest_u; ++i)
+    xfree(contest_stats[i]);
+  xfree(contest_stats); contest_stats = 0;
+  contest_u = contest_a = 0;
+  memset(&loop_stats, 0, sizeof(loop_stats));
+  memset(phase_usec, 0, sizeof(phase_usec));
+  memset(phase_max_usec, 0, sizeof(phase_max_usec));
+  stats_start_time = time(0);
+}
+
+void
+ns_stats_enable(struct server_framework_state *state, int enable)
+{
+  if (enable && !ns_stats_enabled) {
+    ns_stats_reset();
+    nsf_set_loop_stats(state, &loop_stats);
+    ns_stats_enabled = 1;
+    info("performance statistics are enabled");
+  } else if (!enable && ns_stats_enabled) {
+    nsf_set_loop_stats(state, 0);
+    ns_stats_enabled = 0;
+    info("performance statistics are disabled");
+  }
+}
+
+static void
+write_hist_header(FILE *out_f, const unsigned char *title)
+{
+  fprintf(out_f, "%-32s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+          title, "count", "mean,us", "p50", "p90", "p99", "p99.9", "max",
+          "avg bytes", "max bytes");
+}
+
+static void
+write_hist_line(
+        FILE *out_f,
+        const unsigned char *name,
+        const struct ns_stats_hist *h)
+{
+  if (!h || h->count <= 0) return;
+  fprintf(out_f,
+          "%-32s %10lld %10lld %10lld %10lld %10lld %10lld %10lld %10lld %10lld\n",
+          name, h->count, h->total / h->count,
+          hist_percentile(h, 50), hist_percentile(h, 90),
+          hist_percentile(h, 99), hist_percentile(h, 99.9), h->max_value,
+          h->out_total / h->count, h->out_max);
+}
+
+static void
+write_phase_line(
+        FILE *out_f,
+        const unsigned char *name,
+        long long total_usec,
+        long long max_usec,
+        long long elapsed_usec)
+{
+  fprintf(out_f, "%-32s %12lld %10lld %10lld %7.2f\n", name,
+          total_usec / 1000,
+          loop_stats.iterations > 0 ? total_usec / loop_stats.iterations : 0,
+          max_usec,
+          elapsed_usec > 0 ? total_usec * 100.0 / elapsed_usec : 0.0);
+}
+
+static void
+write_contest_stats(FILE *out_f, int contest_id)
+{
+  unsigned char buf[64];
+  int i;
+
+  fprintf(out_f, "\n");
+  write_hist_header(out_f, "contest");
+  for (i = 0; i < contest_u; ++i) {
+    if (contest_id > 0 && contest_stats[i]->contest_id != contest_id)
+      continue;
+    snprintf(buf, sizeof(buf), "%d", contest_stats[i]->contest_id);
+    write_hist_line(out_f, buf, &contest_stats[i]->hist);
+  }
+}
+
+void
+ns_stats_write(FILE *out_f, int contest_id)
+{
+  time_t cur_time = time(0);
+  long long elapsed_usec;
+  const unsigned char *name;
+  unsigned char buf[64];
+  int i;
+
+  if (!ns_stats_enabled) {
+    fprintf(out_f, "performance statistics are disabled\n");
+  } else if (contest_id > 0) {
+    fprintf(out_f, "performance statistics since %s, %ld s\n",
+            xml_unparse_date(stats_start_time),
+            (long) (cur_time - stats_start_time));
+    write_contest_stats(out_f, contest_id);
+    return;
+  } else {
+    fprintf(out_f, "performance statistics since %s, %ld s\n",
+            xml_unparse_date(stats_start_time),
+            (long) (cur_time - stats_start_time));
+    elapsed_usec = (cur_time - stats_start_time) * 1000000LL;
+
+    fprintf(out_f, "\n%-32s %12s %10s %10s %7s\n",
+            "loop phase", "total,ms", "avg,us", "max,us", "%");
+    fprintf(out_f, "%-32s %12lld\n", "iterations", loop_stats.iterations);
+    for (i = 0; i < NSF_PHASE_LAST; ++i) {
+      write_phase_line(out_f, framework_phase_names[i],
+                       loop_stats.total_usec[i], loop_stats.max_usec[i],
+                       elapsed_usec);
+      if (i != NSF_PHASE_LOOP_START) continue;
+      // the parts of the loop start callback
+      for (int j = 0; j < NS_STATS_PHASE_LAST; ++j) {
+        snprintf(buf, sizeof(buf), "  %s", phase_names[j]);
+        write_phase_line(out_f, buf, phase_usec[j], phase_max_usec[j],
+                         elapsed_usec);
+      }
+    }
+
+    fprintf(out_f, "\n");
+    write_hist_header(out_f, "action");
+    for (i = 0; i < NEW_SRV_ACTION_LAST; ++i) {
+      if (!action_hists[i]) continue;
+      if (!(name = ns_get_action_name(i)) || !i) name = "NONE";
+      write_hist_line(out_f, name, action_hists[i]);
+    }
+
+    write_contest_stats(out_f, 0);
+
+    fprintf(out_f, "\n");
+    write_hist_header(out_f, "packet");
+    for (i = 0; i < NS_STATS_PACKET_LAST; ++i)
+      write_hist_line(out_f, packet_names[i], packet_hists[i]);
+  }
+
+  fprintf(out_f, "\n");
+  ns_arena_write_stats(out_f);
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
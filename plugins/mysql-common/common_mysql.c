@@ -426,6 +426,7 @@ do_query(
 
   // reconnected
   info("reconnected to MySQL daemon");
+  state->reconnect_count++;
   if (state->charset) {
     snprintf(buf, sizeof(buf), "SET NAMES '%s' ;", state->charset);
     buflen = strlen(buf);
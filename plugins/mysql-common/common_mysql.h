@@ -54,6 +54,8 @@ struct common_mysql_state
   unsigned long *lengths;
   int row_count;
   int field_count;
+  // incremented each time the connection is reestablished
+  int reconnect_count;
 };
 
 #endif /* EJUDGE_SKIP_MYSQL */
@@ -203,3 +203,6 @@ change_status_4_func(
         struct rldb_plugin_cnts *cdata,
         int run_id,
         int new_status);
+
+static int
+commit_func(struct rldb_plugin_cnts *cdata);
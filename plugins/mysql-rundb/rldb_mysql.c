@@ -55,15 +55,55 @@ struct rldb_mysql_state
   struct common_mysql_state *md;
 };
 
+enum { STATUS_PARAM_COUNT = 14 };
+
+struct status_params
+{
+  int status;
+  int test_num;
+  int score;
+  int judge_id;
+  int passed_mode;
+  int is_marked;
+  int is_saved;
+  int saved_status;
+  int saved_score;
+  int saved_test;
+  MYSQL_TIME last_change_time;
+  int last_change_nsec;
+  int contest_id;
+  int run_id;
+};
+
 struct rldb_mysql_cnts
 {
   struct rldb_mysql_state *plugin_state;
   struct runlog_state *rl_state;
   int contest_id;
+
+  // prepared statements and the connection they belong to,
+  // identified by common_mysql_state::reconnect_count
+  int stmt_reconnect_count;
+  MYSQL_STMT *status_stmt;
+  // the parameters bound to status_stmt
+  struct status_params status_params;
+
+  // the runs with status changes not yet written to the database
+  int *pending_runs;
+  int pending_u, pending_a;
+  unsigned char *pending_map;
+  int pending_map_a;
 };
 
 #include "methods.inc.c"
 
+static int
+do_commit(struct rldb_mysql_cnts *cs);
+static void
+drop_pending(struct rldb_mysql_cnts *cs);
+static void
+shift_pending(struct rldb_mysql_cnts *cs, int run_id);
+
 /* plugin entry point */
 struct rldb_plugin_iface plugin_rldb_mysql =
 {
@@ -110,6 +150,7 @@ struct rldb_plugin_iface plugin_rldb_mysql =
   check_func,
   change_status_3_func,
   change_status_4_func,
+  commit_func,
 };
 
 static struct common_plugin_data *
@@ -365,37 +406,200 @@ expand_runs(struct runlog_state *rls, int run_id)
   rls->run_u = run_id + 1;
 }
 
+static MYSQL_STMT *
+prepare_stmt(struct common_mysql_state *md, const unsigned char *cmd)
+{
+  MYSQL_STMT *stmt;
+
+  if (md->show_queries) {
+    fprintf(stderr, "mysql (prepare): %s\n", cmd);
+  }
+  if (!(stmt = mysql_stmt_init(md->conn))) {
+    err("mysql_stmt_init failed");
+    return 0;
+  }
+  if (mysql_stmt_prepare(stmt, cmd, strlen(cmd))) {
+    err("database error: %s", mysql_stmt_error(stmt));
+    mysql_stmt_close(stmt);
+    return 0;
+  }
+  return stmt;
+}
+
+static void
+close_statements(struct rldb_mysql_cnts *cs)
+{
+  if (cs->status_stmt) mysql_stmt_close(cs->status_stmt);
+  cs->status_stmt = 0;
+}
+
+static time_t
+mysql_time_to_time(const MYSQL_TIME *mt)
+{
+  struct tm tt;
+  time_t t;
+
+  if (!mt->year && !mt->month && !mt->day && !mt->hour && !mt->minute
+      && !mt->second)
+    return 0;
+  // the same conversion as for the text result, see parse_spec
+  memset(&tt, 0, sizeof(tt));
+  tt.tm_year = mt->year - 1900;
+  tt.tm_mon = mt->month - 1;
+  tt.tm_mday = mt->day;
+  tt.tm_hour = mt->hour;
+  tt.tm_min = mt->minute;
+  tt.tm_sec = mt->second;
+  tt.tm_isdst = -1;
+  if ((t = mktime(&tt)) == (time_t) -1 || t < 0) t = 0;
+  return t;
+}
+
+static void
+time_to_mysql_time(time_t t, MYSQL_TIME *mt)
+{
+  struct tm *ptm = localtime(&t);
+
+  memset(mt, 0, sizeof(*mt));
+  mt->year = ptm->tm_year + 1900;
+  mt->month = ptm->tm_mon + 1;
+  mt->day = ptm->tm_mday;
+  mt->hour = ptm->tm_hour;
+  mt->minute = ptm->tm_min;
+  mt->second = ptm->tm_sec;
+  mt->time_type = MYSQL_TIMESTAMP_DATETIME;
+}
+
+#define DEFAULT_IP "127.0.0.127"
+
+/* the longest string column is VARCHAR(128) */
+enum { RUNS_STR_SIZE = 256 };
+
+/* the result buffers for the binary protocol, the integer columns
+   are fetched directly into struct run_entry_internal */
+struct runs_bind
+{
+  MYSQL_BIND bind[RUNS_ROW_WIDTH];
+  unsigned long lengths[RUNS_ROW_WIDTH];
+  my_bool is_null[RUNS_ROW_WIDTH];
+  MYSQL_TIME times[RUNS_ROW_WIDTH];
+  unsigned char strs[RUNS_ROW_WIDTH][RUNS_STR_SIZE];
+};
+
+static void
+bind_runs_result(struct runs_bind *rb, struct run_entry_internal *ri)
+{
+  int i;
+  MYSQL_BIND *b;
+
+  memset(rb, 0, sizeof(*rb));
+  for (i = 0; i < RUNS_ROW_WIDTH; ++i) {
+    b = &rb->bind[i];
+    b->length = &rb->lengths[i];
+    b->is_null = &rb->is_null[i];
+    switch (runs_spec[i].format) {
+    case 'd':
+    case 'b':
+      b->buffer_type = MYSQL_TYPE_LONG;
+      b->buffer = XPDEREF(int, ri, runs_spec[i].offset);
+      break;
+    case 't':
+      b->buffer_type = MYSQL_TYPE_TIMESTAMP;
+      b->buffer = &rb->times[i];
+      break;
+    case 's':
+    case 'I':
+      b->buffer_type = MYSQL_TYPE_STRING;
+      b->buffer = rb->strs[i];
+      b->buffer_length = RUNS_STR_SIZE - 1;
+      break;
+    default:
+      err("unhandled format %d", runs_spec[i].format);
+      abort();
+    }
+  }
+}
+
+/* converts the non-integer columns of the fetched row */
+static void
+unbind_runs_result(struct runs_bind *rb, struct run_entry_internal *ri)
+{
+  int i;
+  unsigned char *s;
+
+  for (i = 0; i < RUNS_ROW_WIDTH; ++i) {
+    switch (runs_spec[i].format) {
+    case 'd':
+    case 'b':
+      if (rb->is_null[i]) *XPDEREF(int, ri, runs_spec[i].offset) = 0;
+      break;
+    case 't':
+      *XPDEREF(time_t, ri, runs_spec[i].offset) = 0;
+      if (!rb->is_null[i])
+        *XPDEREF(time_t, ri, runs_spec[i].offset) = mysql_time_to_time(&rb->times[i]);
+      break;
+    case 's':
+      s = 0;
+      if (!rb->is_null[i]) {
+        s = rb->strs[i];
+        s[rb->lengths[i]] = 0;
+      }
+      *XPDEREF(unsigned char *, ri, runs_spec[i].offset) = s;
+      break;
+    case 'I':
+      s = rb->strs[i];
+      s[rb->lengths[i]] = 0;
+      if (rb->is_null[i]
+          || xml_parse_ipv6_2(s, XPDEREF(ej_ip_t, ri, runs_spec[i].offset)) < 0)
+        xml_parse_ipv6_2(DEFAULT_IP, XPDEREF(ej_ip_t, ri, runs_spec[i].offset));
+      break;
+    }
+  }
+}
+
 static int
 load_runs(struct rldb_mysql_cnts *cs)
 {
   struct rldb_mysql_state *state = cs->plugin_state;
-  struct common_mysql_iface *mi = state->mi;
   struct common_mysql_state *md = state->md;
   struct runlog_state *rls = cs->rl_state;
   struct run_entry_internal ri;
   struct run_entry *re;
-  int i, mime_type;
+  int mime_type, r, count = 0, contest_id = cs->contest_id;
   ruint32_t sha1[5];
   ruint32_t run_uuid[4];
-
-  memset(&ri, 0, sizeof(ri));
-  if (mi->fquery(md, RUNS_ROW_WIDTH,
-                 "SELECT * FROM %sruns WHERE contest_id=%d ORDER BY run_id ;",
-                 md->table_prefix, cs->contest_id) < 0)
+  unsigned char cmd[1024];
+  MYSQL_STMT *stmt = 0;
+  MYSQL_BIND param;
+  struct runs_bind *rb = 0;
+
+  snprintf(cmd, sizeof(cmd),
+           "SELECT * FROM %sruns WHERE contest_id = ? ORDER BY run_id ;",
+           md->table_prefix);
+  if (!(stmt = prepare_stmt(md, cmd))) goto fail;
+  if (mysql_stmt_field_count(stmt) != RUNS_ROW_WIDTH) {
+    err("wrong database format: field_count == %d, must be %d",
+        (int) mysql_stmt_field_count(stmt), RUNS_ROW_WIDTH);
     goto fail;
-  if (!md->row_count) {
-    mi->free_res(md);
-    return 0;
   }
-  for (i = 0; i < md->row_count; i++) {
-    memset(&ri, 0, sizeof(ri));
+  memset(&param, 0, sizeof(param));
+  param.buffer_type = MYSQL_TYPE_LONG;
+  param.buffer = &contest_id;
+  if (mysql_stmt_bind_param(stmt, &param)) goto stmt_fail;
+
+  XCALLOC(rb, 1);
+  memset(&ri, 0, sizeof(ri));
+  bind_runs_result(rb, &ri);
+  if (mysql_stmt_bind_result(stmt, rb->bind)) goto stmt_fail;
+  if (mysql_stmt_execute(stmt)) goto stmt_fail;
+
+  // the rows are not buffered, but fetched from the server as we go
+  while (!(r = mysql_stmt_fetch(stmt))) {
+    unbind_runs_result(rb, &ri);
     memset(sha1, 0, sizeof(sha1));
     memset(run_uuid, 0, sizeof(run_uuid));
-    if (mi->next_row(md) < 0) goto fail;
     mime_type = 0;
-    if (mi->parse_spec(md, md->field_count, md->row, md->lengths,
-                       RUNS_ROW_WIDTH, runs_spec, &ri) < 0)
-      goto fail;
+    ++count;
     if (ri.run_id < 0) db_error_inv_value_fail(md, "run_id");
     if (ri.size < 0) db_error_inv_value_fail(md, "size");
     /* FIXME: check ordering on create_time/create_nsec */
@@ -404,10 +608,6 @@ load_runs(struct rldb_mysql_cnts *cs)
     if (!run_is_valid_status(ri.status))
       db_error_inv_value_fail(md, "status");
     if (ri.status == RUN_EMPTY) {
-      xfree(ri.hash); ri.hash = 0;
-      xfree(ri.mime_type); ri.mime_type = 0;
-      xfree(ri.run_uuid); ri.run_uuid = 0;
-
       expand_runs(rls, ri.run_id);
       re = &rls->runs[ri.run_id];
       memset(re, 0, sizeof(*re));
@@ -428,12 +628,8 @@ load_runs(struct rldb_mysql_cnts *cs)
       uuid_parse(ri.run_uuid, (void*) run_uuid);
 #endif
     }
-    //if (ri.ip_version != 4) db_error_inv_value_fail(md, "ip_version");
     if (ri.mime_type && (mime_type = mime_type_parse(ri.mime_type)) < 0)
       db_error_inv_value_fail(md, "mime_type");
-    xfree(ri.hash); ri.hash = 0;
-    xfree(ri.mime_type); ri.mime_type = 0;
-    xfree(ri.run_uuid); ri.run_uuid = 0;
 
     expand_runs(rls, ri.run_id);
     re = &rls->runs[ri.run_id];
@@ -461,15 +657,6 @@ load_runs(struct rldb_mysql_cnts *cs)
     re->pages = ri.pages;
     re->ssl_flag = ri.ssl_flag;
     re->mime_type = mime_type;
-    /*
-    re->is_examinable = ri.is_examinable;
-    re->examiners[0] = ri.examiners0;
-    re->examiners[1] = ri.examiners1;
-    re->examiners[2] = ri.examiners2;
-    re->exam_score[0] = ri.exam_score0;
-    re->exam_score[1] = ri.exam_score1;
-    re->exam_score[2] = ri.exam_score2;
-    */
     re->is_marked = ri.is_marked;
     re->is_saved = ri.is_saved;
     re->saved_status = ri.saved_status;
@@ -479,13 +666,23 @@ load_runs(struct rldb_mysql_cnts *cs)
     re->eoln_type = ri.eoln_type;
     re->store_flags = ri.store_flags;
   }
-  return 1;
+  if (r == MYSQL_DATA_TRUNCATED) {
+    err("load_runs: data truncated in row %d", count + 1);
+    goto fail;
+  }
+  if (r != MYSQL_NO_DATA) goto stmt_fail;
+
+  mysql_stmt_close(stmt);
+  xfree(rb);
+  return count > 0;
+
+ stmt_fail:
+  err("database error: %s", mysql_stmt_error(stmt));
+  goto fail;
 
  fail:
-  xfree(ri.hash);
-  xfree(ri.mime_type);
-  xfree(ri.run_uuid);
-  mi->free_res(md);
+  if (stmt) mysql_stmt_close(stmt);
+  xfree(rb);
   return -1;
 }
 
@@ -540,6 +737,10 @@ close_func(struct rldb_plugin_cnts *cdata)
   struct runlog_state *rls = cs->rl_state;
 
   rls = cs->rl_state;
+  if (rls && rls->runs) do_commit(cs);
+  close_statements(cs);
+  xfree(cs->pending_runs);
+  xfree(cs->pending_map);
   if (rls) {
     xfree(rls->runs); rls->runs = 0;
     rls->run_a = rls->run_u = 0;
@@ -569,6 +770,7 @@ reset_func(
   FILE *cmd_f = 0;
   struct timeval curtime;
 
+  drop_pending(cs);
   rls->run_u = 0;
   if (rls->run_a > 0) {
     memset(rls->runs, 0, sizeof(rls->runs[0]) * rls->run_a);
@@ -623,6 +825,7 @@ set_runlog_func(
   mi->simple_fquery(md, "DELETE FROM %sruns WHERE contest_id = %d ;",
                     md->table_prefix, cs->contest_id);
 
+  drop_pending(cs);
   rls->run_u = 0;
   if (rls->run_a > 0) {
     memset(rls->runs, 0, sizeof(rls->runs[0]) * rls->run_a);
@@ -791,6 +994,8 @@ get_insert_run_id(
             (rls->run_u - run_id - 1) * sizeof(rls->runs[0]));
     for (i = run_id + 1; i < rls->run_u; ++i)
       rls->runs[i].run_id = i;
+    // the pending changes move with the runs
+    shift_pending(cs, run_id);
     if (mi->simple_fquery(md, "UPDATE %sruns SET run_id = run_id + 1 WHERE contest_id = %d AND run_id >= %d ORDER BY run_id DESC;", md->table_prefix, cs->contest_id, run_id) < 0)
       goto fail;
   }
@@ -1139,6 +1344,185 @@ do_update_entry(
   return -1;
 }
 
+/*
+ * The status changes (the testing results) are not written to the
+ * database immediately, but are collected and written in a single
+ * transaction by commit_func, which is called once per the main loop
+ * iteration and when the runlog is closed.
+ */
+
+static int
+prepare_status_stmt(struct rldb_mysql_cnts *cs)
+{
+  struct common_mysql_state *md = cs->plugin_state->md;
+  struct status_params *sp = &cs->status_params;
+  MYSQL_BIND bind[STATUS_PARAM_COUNT];
+  int *ints[STATUS_PARAM_COUNT] =
+  {
+    &sp->status, &sp->test_num, &sp->score, &sp->judge_id, &sp->passed_mode,
+    &sp->is_marked, &sp->is_saved, &sp->saved_status, &sp->saved_score,
+    &sp->saved_test, 0, &sp->last_change_nsec, &sp->contest_id, &sp->run_id,
+  };
+  unsigned char cmd[1024];
+  int i;
+
+  // the connection might be reestablished by common_mysql, and
+  // the new MYSQL object might get the address of the old one
+  if (cs->status_stmt && cs->stmt_reconnect_count == md->reconnect_count)
+    return 0;
+  close_statements(cs);
+
+  snprintf(cmd, sizeof(cmd),
+           "UPDATE %sruns SET status = ?, test_num = ?, score = ?, judge_id = ?, passed_mode = ?, is_marked = ?, is_saved = ?, saved_status = ?, saved_score = ?, saved_test = ?, last_change_time = ?, last_change_nsec = ? WHERE contest_id = ? AND run_id = ? ;",
+           md->table_prefix);
+  if (!(cs->status_stmt = prepare_stmt(md, cmd))) return -1;
+
+  memset(bind, 0, sizeof(bind));
+  for (i = 0; i < STATUS_PARAM_COUNT; ++i) {
+    bind[i].buffer_type = MYSQL_TYPE_LONG;
+    bind[i].buffer = ints[i];
+  }
+  bind[10].buffer_type = MYSQL_TYPE_TIMESTAMP;
+  bind[10].buffer = &sp->last_change_time;
+  if (mysql_stmt_bind_param(cs->status_stmt, bind)) {
+    err("database error: %s", mysql_stmt_error(cs->status_stmt));
+    close_statements(cs);
+    return -1;
+  }
+  cs->stmt_reconnect_count = md->reconnect_count;
+  return 0;
+}
+
+static int
+do_commit(struct rldb_mysql_cnts *cs)
+{
+  struct rldb_mysql_state *state = cs->plugin_state;
+  struct common_mysql_iface *mi = state->mi;
+  struct common_mysql_state *md = state->md;
+  struct runlog_state *rls = cs->rl_state;
+  struct status_params *sp = &cs->status_params;
+  const struct run_entry *re;
+  struct timeval curtime;
+  int i, run_id, reconnect_count;
+
+  if (cs->pending_u <= 0) return 0;
+
+  if (mi->simple_fquery(md, "START TRANSACTION ;") < 0) return -1;
+  reconnect_count = md->reconnect_count;
+  if (prepare_status_stmt(cs) < 0) goto fail;
+
+  gettimeofday(&curtime, 0);
+  time_to_mysql_time(curtime.tv_sec, &sp->last_change_time);
+  sp->last_change_nsec = curtime.tv_usec * 1000;
+  sp->contest_id = cs->contest_id;
+  for (i = 0; i < cs->pending_u; ++i) {
+    run_id = cs->pending_runs[i];
+    // the run might be removed after its status was changed
+    if (run_id >= rls->run_u) continue;
+    re = &rls->runs[run_id];
+    if (re->status == RUN_EMPTY) continue;
+
+    sp->status = re->status;
+    sp->test_num = re->test;
+    sp->score = re->score;
+    sp->judge_id = re->judge_id;
+    sp->passed_mode = !!re->passed_mode;
+    sp->is_marked = re->is_marked;
+    sp->is_saved = re->is_saved;
+    sp->saved_status = re->saved_status;
+    sp->saved_score = re->saved_score;
+    sp->saved_test = re->saved_test;
+    sp->run_id = run_id;
+    if (mysql_stmt_execute(cs->status_stmt)) {
+      err("database error: %s", mysql_stmt_error(cs->status_stmt));
+      close_statements(cs);
+      goto fail;
+    }
+  }
+  if (mi->simple_fquery(md, "COMMIT ;") < 0) goto fail;
+  // if the connection was lost, the server has rolled the transaction
+  // back, and the COMMIT reissued on the new connection commits nothing
+  if (md->reconnect_count != reconnect_count) {
+    err("database error: connection lost during the transaction");
+    goto fail;
+  }
+
+  for (i = 0; i < cs->pending_u; ++i)
+    cs->pending_map[cs->pending_runs[i]] = 0;
+  cs->pending_u = 0;
+  return 0;
+
+ fail:
+  // the pending changes are kept and retried on the next commit
+  mi->simple_fquery(md, "ROLLBACK ;");
+  return -1;
+}
+
+static void
+drop_pending(struct rldb_mysql_cnts *cs)
+{
+  int i;
+
+  for (i = 0; i < cs->pending_u; ++i)
+    cs->pending_map[cs->pending_runs[i]] = 0;
+  cs->pending_u = 0;
+}
+
+static void
+add_pending(struct rldb_mysql_cnts *cs, int run_id)
+{
+  if (run_id >= cs->pending_map_a) {
+    int new_a = cs->pending_map_a;
+    if (!new_a) new_a = 128;
+    while (run_id >= new_a) new_a *= 2;
+    XREALLOC(cs->pending_map, new_a);
+    memset(cs->pending_map + cs->pending_map_a, 0, new_a - cs->pending_map_a);
+    cs->pending_map_a = new_a;
+  }
+  if (!cs->pending_map[run_id]) {
+    if (cs->pending_u == cs->pending_a) {
+      if (!(cs->pending_a *= 2)) cs->pending_a = 64;
+      XREALLOC(cs->pending_runs, cs->pending_a);
+    }
+    cs->pending_runs[cs->pending_u++] = run_id;
+    cs->pending_map[run_id] = 1;
+  }
+}
+
+/* the runs starting from run_id are moved one forward */
+static void
+shift_pending(struct rldb_mysql_cnts *cs, int run_id)
+{
+  int i, u = cs->pending_u;
+
+  for (i = 0; i < u; ++i)
+    cs->pending_map[cs->pending_runs[i]] = 0;
+  cs->pending_u = 0;
+  for (i = 0; i < u; ++i)
+    add_pending(cs, cs->pending_runs[i] + (cs->pending_runs[i] >= run_id));
+}
+
+static int
+commit_func(struct rldb_plugin_cnts *cdata)
+{
+  return do_commit((struct rldb_mysql_cnts*) cdata);
+}
+
+static int
+do_change_status(
+        struct rldb_mysql_cnts *cs,
+        int run_id,
+        const struct run_entry *re,
+        int flags)
+{
+  struct runlog_state *rls = cs->rl_state;
+
+  ASSERT(run_id >= 0 && run_id < rls->run_u);
+  update_entry(&rls->runs[run_id], re, flags);
+  add_pending(cs, run_id);
+  return run_id;
+}
+
 static int
 add_entry_func(
         struct rldb_plugin_cnts *cdata,
@@ -1206,8 +1590,8 @@ change_status_func(
   te.score = new_score;
   te.judge_id = new_judge_id;
 
-  return do_update_entry(cs, run_id, &te,
-                         RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_PASSED_MODE);
+  return do_change_status(cs, run_id, &te,
+                          RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_PASSED_MODE);
 }
 
 static void
@@ -1418,7 +1802,7 @@ set_status_func(
   memset(&te, 0, sizeof(te));
   te.status = new_status;
 
-  return do_update_entry(cs, run_id, &te, RE_STATUS);
+  return do_change_status(cs, run_id, &te, RE_STATUS);
 }
 
 static int
@@ -1650,8 +2034,8 @@ change_status_2_func(
   te.judge_id = new_judge_id;
   te.is_marked = new_is_marked;
 
-  return do_update_entry(cs, run_id, &te,
-                         RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_IS_MARKED | RE_PASSED_MODE);
+  return do_change_status(cs, run_id, &te,
+                          RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_IS_MARKED | RE_PASSED_MODE);
 }
 
 static int
@@ -1702,9 +2086,9 @@ change_status_3_func(
   te.saved_test = user_tests_passed;
   te.saved_score = user_score;
 
-  return do_update_entry(cs, run_id, &te,
-                         RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_IS_MARKED
-                         | RE_IS_SAVED | RE_SAVED_STATUS | RE_SAVED_TEST | RE_SAVED_SCORE | RE_PASSED_MODE);
+  return do_change_status(cs, run_id, &te,
+                          RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID | RE_IS_MARKED
+                          | RE_IS_SAVED | RE_SAVED_STATUS | RE_SAVED_TEST | RE_SAVED_SCORE | RE_PASSED_MODE);
 }
 
 static int
@@ -1728,10 +2112,10 @@ change_status_4_func(
   te.saved_score = 0;
   te.passed_mode = 1;
 
-  return do_update_entry(cs, run_id, &te,
-                         RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID
-                         | RE_IS_MARKED | RE_IS_SAVED | RE_SAVED_STATUS
-                         | RE_SAVED_TEST | RE_SAVED_SCORE | RE_PASSED_MODE);
+  return do_change_status(cs, run_id, &te,
+                          RE_STATUS | RE_TEST | RE_SCORE | RE_JUDGE_ID
+                          | RE_IS_MARKED | RE_IS_SAVED | RE_SAVED_STATUS
+                          | RE_SAVED_TEST | RE_SAVED_SCORE | RE_PASSED_MODE);
 }
 
 /*
@@ -452,6 +452,7 @@ get_brief_list_iterator_2_func(
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count);
 static int
@@ -479,6 +480,7 @@ get_prev_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id);
 static int
 get_next_user_id_func(
@@ -487,6 +489,7 @@ get_next_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id);
 static int
 new_cookie_2_func(
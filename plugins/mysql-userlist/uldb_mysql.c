@@ -4973,12 +4973,205 @@ remove_group_member_func(void *data, int group_id, int user_id)
   return 0;
 }
 
+enum { USER_FILTER_MAX_TERMS = 16 };
+
+/* the terms of the user filter as the SQL expressions */
+struct user_filter
+{
+  int term_count;
+  int short_term[USER_FILTER_MAX_TERMS];
+  unsigned char *exact[USER_FILTER_MAX_TERMS];  /* the term */
+  unsigned char *prefix[USER_FILTER_MAX_TERMS]; /* the text starts with it */
+  unsigned char *other[USER_FILTER_MAX_TERMS];  /* a word starts with it, or
+                                                   a substring for 3+ chars */
+};
+
+static const char * const user_filter_member_fields[] =
+{
+  "firstname", "middlename", "surname",
+  "firstname_en", "middlename_en", "surname_en",
+  NULL,
+};
+
+/* makes the case-folded SQL string literal, the LIKE metacharacters
+   of the term are escaped, if the pattern is requested */
+static unsigned char *
+make_filter_literal(
+        struct uldb_mysql_state *state,
+        const unsigned char *term,
+        int len,
+        const unsigned char *pat_pfx,
+        const unsigned char *pat_sfx)
+{
+  unsigned char *raw, *q;
+  char *out_t = 0;
+  size_t out_z = 0;
+  FILE *out_f;
+  int i;
+
+  q = raw = (unsigned char*) alloca(2 * len + 8);
+  if (pat_pfx) q = stpcpy(q, pat_pfx);
+  for (i = 0; i < len; ++i) {
+    if (pat_pfx && (term[i] == '%' || term[i] == '_' || term[i] == '\\'))
+      *q++ = '\\';
+    *q++ = term[i];
+  }
+  *q = 0;
+  if (pat_sfx) strcpy(q, pat_sfx);
+
+  out_f = open_memstream(&out_t, &out_z);
+  fprintf(out_f, "LOWER(");
+  state->mi->write_escaped_string(state->md, out_f, 0, raw);
+  fprintf(out_f, ")");
+  close_memstream(out_f);
+  return out_t;
+}
+
+/* splits the filter into the terms, returns their count, the short
+   terms match the word prefixes like the XML database does */
+static int
+parse_user_filter(
+        struct uldb_mysql_state *state,
+        const unsigned char *filter,
+        struct user_filter *uf)
+{
+  const unsigned char *p, *q;
+  int n;
+
+  memset(uf, 0, sizeof(*uf));
+  if (!filter) return 0;
+  for (p = filter; *p && uf->term_count < USER_FILTER_MAX_TERMS; p = q) {
+    while (isspace(*p)) ++p;
+    if (!*p) break;
+    for (q = p; *q && !isspace(*q); ++q);
+    n = uf->term_count++;
+    uf->short_term[n] = (q - p < 3);
+    uf->exact[n] = make_filter_literal(state, p, q - p, 0, 0);
+    uf->prefix[n] = make_filter_literal(state, p, q - p, "", "%");
+    if (uf->short_term[n]) {
+      uf->other[n] = make_filter_literal(state, p, q - p, "% ", "%");
+    } else {
+      uf->other[n] = make_filter_literal(state, p, q - p, "%", "%");
+    }
+  }
+  return uf->term_count;
+}
+
+static void
+free_user_filter(struct user_filter *uf)
+{
+  int i;
+
+  for (i = 0; i < uf->term_count; ++i) {
+    xfree(uf->exact[i]);
+    xfree(uf->prefix[i]);
+    xfree(uf->other[i]);
+  }
+  memset(uf, 0, sizeof(*uf));
+}
+
+static void
+write_filter_term_match(
+        FILE *f,
+        const struct user_filter *uf,
+        int n,
+        const unsigned char *field)
+{
+  fprintf(f, "LOWER(%s) LIKE %s", field, uf->other[n]);
+  if (uf->short_term[n])
+    fprintf(f, " OR LOWER(%s) LIKE %s", field, uf->prefix[n]);
+}
+
+/* writes the FROM and WHERE clauses selecting the users of the list,
+   the logins table is aliased as l, all the terms must match
+   the login, the e-mail, a user name or a member name */
+static void
+write_user_list_query(
+        struct uldb_mysql_state *state,
+        FILE *f,
+        int contest_id,
+        int group_id,
+        const struct user_filter *uf)
+{
+  const unsigned char *pfx = state->md->table_prefix;
+  unsigned char field[64];
+  int n, i;
+
+  fprintf(f, " FROM %slogins AS l", pfx);
+  if (contest_id > 0) fprintf(f, ", %scntsregs AS c", pfx);
+  if (group_id > 0) fprintf(f, ", %sgroupmembers AS g", pfx);
+  fprintf(f, " WHERE 1");
+  if (contest_id > 0)
+    fprintf(f, " AND c.user_id = l.user_id AND c.contest_id = %d", contest_id);
+  if (group_id > 0)
+    fprintf(f, " AND g.user_id = l.user_id AND g.group_id = %d", group_id);
+
+  for (n = 0; n < uf->term_count; ++n) {
+    fprintf(f, " AND (");
+    write_filter_term_match(f, uf, n, "l.login");
+    fprintf(f, " OR ");
+    write_filter_term_match(f, uf, n, "l.email");
+    fprintf(f, " OR EXISTS (SELECT 1 FROM %susers AS fu WHERE fu.user_id = l.user_id AND (", pfx);
+    write_filter_term_match(f, uf, n, "fu.username");
+    fprintf(f, ")) OR EXISTS (SELECT 1 FROM %smembers AS fm WHERE fm.user_id = l.user_id AND (", pfx);
+    for (i = 0; user_filter_member_fields[i]; ++i) {
+      snprintf(field, sizeof(field), "fm.%s", user_filter_member_fields[i]);
+      if (i > 0) fprintf(f, " OR ");
+      fprintf(f, "(");
+      write_filter_term_match(f, uf, n, field);
+      fprintf(f, ")");
+    }
+    fprintf(f, ")))");
+  }
+}
+
+/* writes the ORDER BY clause, the relevance is approximated as
+   the exact login match first, then the logins and the e-mails
+   starting with the terms */
+static void
+write_user_list_order(
+        FILE *f,
+        const struct user_filter *uf,
+        int flags)
+{
+  int n;
+
+  if (!(flags & ULDB_LIST_BY_RELEVANCE) || uf->term_count <= 0) {
+    fprintf(f, " ORDER BY l.user_id");
+    return;
+  }
+  fprintf(f, " ORDER BY (");
+  for (n = 0; n < uf->term_count; ++n) {
+    if (n > 0) fprintf(f, " + ");
+    fprintf(f, "(LOWER(l.login) = %s) * 8 + (LOWER(l.login) LIKE %s OR LOWER(l.email) LIKE %s) * 2",
+            uf->exact[n], uf->prefix[n], uf->prefix[n]);
+  }
+  fprintf(f, ") DESC, l.user_id");
+}
+
+/* the rows of the other tables must follow the order of the logins */
+static unsigned char *
+make_user_row_order(const char *uid_t, int flags, const struct user_filter *uf)
+{
+  char *out_t = 0;
+  size_t out_z = 0;
+  FILE *out_f;
+
+  if (!(flags & ULDB_LIST_BY_RELEVANCE) || uf->term_count <= 0)
+    return xstrdup("user_id");
+  out_f = open_memstream(&out_t, &out_z);
+  fprintf(out_f, "FIELD(user_id, %s)", uid_t);
+  close_memstream(out_f);
+  return out_t;
+}
+
 static ptr_iterator_t
 get_brief_list_iterator_2_func(
         void *data,
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count)
 {
@@ -4988,10 +5181,18 @@ get_brief_list_iterator_2_func(
   FILE *uid_f = NULL;
   char *uid_t = NULL;
   size_t uid_z = 0;
+  FILE *cmd_f = NULL;
+  char *cmd_t = NULL;
+  size_t cmd_z = 0;
+  unsigned char *order_t = NULL;
+  struct user_filter uf;
 
   if (offset < 0) offset = 0;
   if (count < 0) count = 0;
   if (offset + count < 0) count = 0;
+  if (contest_id < 0) contest_id = 0;
+  if (group_id < 0) group_id = 0;
+  parse_user_filter(state, filter, &uf);
 
   XCALLOC(iter, 1);
   iter->b = brief_list_iterator_funcs;
@@ -4999,75 +5200,21 @@ get_brief_list_iterator_2_func(
   iter->contest_id = contest_id;
   iter->cur_ind = 0;
 
-  if (contest_id <= 0 && group_id > 0) {
-    if (state->mi->fquery(state->md, LOGIN_WIDTH,
-                  "SELECT l.* FROM %slogins AS l, %sgroupmembers AS m WHERE l.user_id = m.user_id AND m.group_id = %d ORDER BY l.user_id LIMIT %d, %d;",
-                          state->md->table_prefix,
-                          state->md->table_prefix,
-                          group_id, offset, count) < 0)
-      goto fail;
-    iter->total_ids = state->md->row_count;
-    if (!iter->total_ids) {
-      state->mi->free_res(state->md);
-      return (ptr_iterator_t) iter;
-    }
-
-    uid_f = open_memstream(&uid_t, &uid_z);
-    XCALLOC(iter->noreg_rows, iter->total_ids);
-    for (i = 0; i < iter->total_ids; i++) {
-      if (!(state->md->row = mysql_fetch_row(state->md->res)))
-        db_error_no_data_fail(state->md);
-      state->md->lengths = mysql_fetch_lengths(state->md->res);
-      if (!state->md->lengths[0])
-        db_error_inv_value_fail(state->md, "value");
-      if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0)
-        db_error_inv_value_fail(state->md, "value");
-      iter->noreg_rows[i].user_id = val;
-      copy_saved_row(state, &iter->noreg_rows[i].login_row);
-      if (i > 0) fprintf(uid_f, ", ");
-      fprintf(uid_f, "%d", val);
-    }
-    fclose(uid_f); uid_f = NULL;
-
-    if (!uid_t && !*uid_t) {
-      xfree(uid_t); uid_t = 0;
-      state->mi->free_res(state->md);
-      return (ptr_iterator_t) iter;
-    }
-
-    state->mi->free_res(state->md);
-    if (state->mi->fquery(state->md, USER_INFO_WIDTH,
-                  "SELECT * FROM %susers WHERE contest_id = 0 AND user_id IN (%s) ORDER BY user_id;",
-                          state->md->table_prefix, uid_t) < 0)
-      goto fail;
-    xfree(uid_t); uid_t = 0; uid_z = 0;
-    j = 0;
-    for (i = 0; i < state->md->row_count; i++) {
-      if (!(state->md->row = mysql_fetch_row(state->md->res)))
-        db_error_no_data_fail(state->md);
-      state->md->lengths = mysql_fetch_lengths(state->md->res);
-      if (!state->md->lengths[0])
-        db_error_inv_value_fail(state->md, "value");
-      if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0)
-        db_error_inv_value_fail(state->md, "value");
-      while (j < iter->total_ids && iter->noreg_rows[j].user_id < val) j++;
-      if (j < iter->total_ids && iter->noreg_rows[j].user_id == val) {
-        copy_saved_row(state, &iter->noreg_rows[j].user_info_row);
-      }
-    }
-
-    state->mi->free_res(state->md);
-    return (ptr_iterator_t) iter;
-  }
+  cmd_f = open_memstream(&cmd_t, &cmd_z);
+  fprintf(cmd_f, "SELECT l.*");
+  write_user_list_query(state, cmd_f, contest_id, group_id, &uf);
+  write_user_list_order(cmd_f, &uf, flags);
+  fprintf(cmd_f, " LIMIT %d, %d ;", offset, count);
+  close_memstream(cmd_f); cmd_f = NULL;
+  if (state->mi->query(state->md, cmd_t, cmd_z, LOGIN_WIDTH) < 0)
+    goto fail;
+  xfree(cmd_t); cmd_t = NULL; cmd_z = 0;
 
   if (!contest_id) {
-    if (state->mi->fquery(state->md, LOGIN_WIDTH,
-                  "SELECT * FROM %slogins WHERE 1 ORDER BY user_id LIMIT %d, %d;",
-                          state->md->table_prefix, offset, count) < 0)
-      goto fail;
     iter->total_ids = state->md->row_count;
     if (!iter->total_ids) {
       state->mi->free_res(state->md);
+      free_user_filter(&uf);
       return (ptr_iterator_t) iter;
     }
 
@@ -5087,16 +5234,12 @@ get_brief_list_iterator_2_func(
       fprintf(uid_f, "%d", val);
     }
     fclose(uid_f); uid_f = NULL;
-
-    if (!uid_t && !*uid_t) {
-      state->mi->free_res(state->md);
-      return (ptr_iterator_t) iter;
-    }
+    order_t = make_user_row_order(uid_t, flags, &uf);
 
     state->mi->free_res(state->md);
     if (state->mi->fquery(state->md, USER_INFO_WIDTH,
-                  "SELECT * FROM %susers WHERE contest_id = 0 AND user_id IN (%s) ORDER BY user_id ;",
-                          state->md->table_prefix, uid_t) < 0)
+                  "SELECT * FROM %susers WHERE contest_id = 0 AND user_id IN (%s) ORDER BY %s ;",
+                          state->md->table_prefix, uid_t, order_t) < 0)
       goto fail;
     xfree(uid_t); uid_t = 0; uid_z = 0;
     j = 0;
@@ -5108,26 +5251,22 @@ get_brief_list_iterator_2_func(
         db_error_inv_value_fail(state->md, "value");
       if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0)
         db_error_inv_value_fail(state->md, "value");
-      while (j < iter->total_ids && iter->noreg_rows[j].user_id < val) j++;
-      if (j < iter->total_ids && iter->noreg_rows[j].user_id == val) {
+      while (j < iter->total_ids && iter->noreg_rows[j].user_id != val) j++;
+      if (j < iter->total_ids) {
         copy_saved_row(state, &iter->noreg_rows[j].user_info_row);
       }
     }
 
     state->mi->free_res(state->md);
+    xfree(order_t);
+    free_user_filter(&uf);
     return (ptr_iterator_t) iter;
   }
 
-  if (state->mi->fquery(state->md, LOGIN_WIDTH,
-                        "SELECT %slogins.* FROM %slogins, %scntsregs WHERE %slogins.user_id = %scntsregs.user_id AND %scntsregs.contest_id = %d ORDER BY %slogins.user_id LIMIT %d, %d;",
-                        state->md->table_prefix, state->md->table_prefix, state->md->table_prefix,
-                        state->md->table_prefix, state->md->table_prefix, state->md->table_prefix,
-                        contest_id, state->md->table_prefix, offset, count) < 0)
-    goto fail;
-
   iter->total_ids = state->md->row_count;
   if (!iter->total_ids) {
     state->mi->free_res(state->md);
+    free_user_filter(&uf);
     return (ptr_iterator_t) iter;
   }
 
@@ -5148,15 +5287,11 @@ get_brief_list_iterator_2_func(
   }
   fclose(uid_f); uid_f = NULL;
   state->mi->free_res(state->md);
-
-  if (!uid_t && !*uid_t) {
-    state->mi->free_res(state->md);
-    return (ptr_iterator_t) iter;
-  }
+  order_t = make_user_row_order(uid_t, flags, &uf);
 
   if (state->mi->fquery(state->md, USER_INFO_WIDTH,
-                "SELECT * FROM %susers WHERE contest_id = %d AND user_id IN (%s) ORDER BY user_id ;",
-                        state->md->table_prefix, contest_id, uid_t) < 0)
+                "SELECT * FROM %susers WHERE contest_id = %d AND user_id IN (%s) ORDER BY %s ;",
+                        state->md->table_prefix, contest_id, uid_t, order_t) < 0)
     goto fail;
   j = 0;
   for (i = 0; i < state->md->row_count; i++) {
@@ -5167,16 +5302,16 @@ get_brief_list_iterator_2_func(
       db_error_inv_value_fail(state->md, "value");
     if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0)
       db_error_inv_value_fail(state->md, "value");
-    while (j < iter->total_ids && iter->full_rows[j].user_id < val) j++;
-    if (j < iter->total_ids && iter->full_rows[j].user_id == val) {
+    while (j < iter->total_ids && iter->full_rows[j].user_id != val) j++;
+    if (j < iter->total_ids) {
       copy_saved_row(state, &iter->full_rows[j].user_info_row);
     }
   }
   state->mi->free_res(state->md);
 
   if (state->mi->fquery(state->md, CNTSREG_WIDTH,
-                        "SELECT * FROM %scntsregs WHERE contest_id = %d AND user_id IN (%s) ORDER BY user_id ;",
-                        state->md->table_prefix, contest_id, uid_t) < 0)
+                        "SELECT * FROM %scntsregs WHERE contest_id = %d AND user_id IN (%s) ORDER BY %s ;",
+                        state->md->table_prefix, contest_id, uid_t, order_t) < 0)
     goto fail;
   xfree(uid_t); uid_t = 0; uid_z = 0;
   j = 0;
@@ -5188,12 +5323,14 @@ get_brief_list_iterator_2_func(
       db_error_inv_value_fail(state->md, "value");
     if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0)
       db_error_inv_value_fail(state->md, "value");
-    while (j < iter->total_ids && iter->full_rows[j].user_id < val) j++;
-    if (j < iter->total_ids && iter->full_rows[j].user_id == val) {
+    while (j < iter->total_ids && iter->full_rows[j].user_id != val) j++;
+    if (j < iter->total_ids) {
       copy_saved_row(state, &iter->full_rows[j].cntsreg_row);
     }
   }
   state->mi->free_res(state->md);
+  xfree(order_t);
+  free_user_filter(&uf);
 
   return (ptr_iterator_t) iter;
 
@@ -5202,7 +5339,11 @@ get_brief_list_iterator_2_func(
     fclose(uid_f);
     uid_f = 0;
   }
+  if (cmd_f) fclose(cmd_f);
+  xfree(cmd_t);
   xfree(uid_t); uid_t = 0;
+  xfree(order_t);
+  free_user_filter(&uf);
   state->mi->free_res(state->md);
   brief_list_iterator_destroy_func((ptr_iterator_t) iter);
   return 0;
@@ -5217,34 +5358,33 @@ get_user_count_func(
         long long *p_count)
 {
   struct uldb_mysql_state *state = (struct uldb_mysql_state*) data;
-  unsigned char cmdbuf[1024];
-  int cmdlen, count = 0;
+  FILE *cmd_f = NULL;
+  char *cmd_t = NULL;
+  size_t cmd_z = 0;
+  int count = 0;
+  struct user_filter uf;
 
-  if (contest_id > 0 && group_id > 0) {
-    // FIXME:
-    abort();
-  } else if (contest_id > 0) {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT COUNT(%slogins.user_id) FROM %slogins, %scntsregs WHERE %slogins.user_id = %scntsregs.user_id AND %scntsregs.contest_id = %d;",
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix, contest_id);
-  } else if (group_id > 0) {
-  } else {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT COUNT(user_id) FROM %slogins WHERE 1 ;", state->md->table_prefix);
-  }
+  parse_user_filter(state, filter, &uf);
+  cmd_f = open_memstream(&cmd_t, &cmd_z);
+  fprintf(cmd_f, "SELECT COUNT(l.user_id)");
+  write_user_list_query(state, cmd_f, contest_id, group_id, &uf);
+  fprintf(cmd_f, " ;");
+  close_memstream(cmd_f); cmd_f = NULL;
+  free_user_filter(&uf);
 
-  cmdlen = strlen(cmdbuf);
-  if (state->mi->query_one_row(state->md, cmdbuf, cmdlen, 1) < 0) goto fail;
+  if (state->mi->query_one_row(state->md, cmd_t, cmd_z, 1) < 0) goto fail;
   if (!state->md->lengths[0])
     db_error_inv_value_fail(state->md, "value");
-  if (state->mi->parse_int(state->md, state->md->row[0], &count) < 0 || count <= 0)
+  if (state->mi->parse_int(state->md, state->md->row[0], &count) < 0 || count < 0)
     db_error_inv_value_fail(state->md, "value");
   state->mi->free_res(state->md);
+  xfree(cmd_t);
   if (p_count) *p_count = count;
   return 0;
 
 fail:
   state->mi->free_res(state->md);
+  xfree(cmd_t);
   return 0;
 }
 
@@ -5328,96 +5468,101 @@ fail:
   return 0;
 }
 
+/* finds the neighbour of the user in the list, dir < 0 for
+   the previous user, dir > 0 for the next one */
 static int
-get_prev_user_id_func(
-        void *data,
+get_adjacent_user_id(
+        struct uldb_mysql_state *state,
         int contest_id,
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
+        int dir,
         int *p_user_id)
 {
-  struct uldb_mysql_state *state = (struct uldb_mysql_state*) data;
-  unsigned char cmdbuf[1024];
-  int cmdlen;
+  FILE *cmd_f = NULL;
+  char *cmd_t = NULL;
+  size_t cmd_z = 0;
+  struct user_filter uf;
+  int by_relevance, i, val, prev_id = 0;
 
-  if (contest_id > 0 && group_id > 0) group_id = 0; // FIXME
-  if (group_id > 0) group_id = 0;                   /* FIXME */
   if (p_user_id) *p_user_id = 0;
+  parse_user_filter(state, filter, &uf);
+  by_relevance = (flags & ULDB_LIST_BY_RELEVANCE) && uf.term_count > 0;
 
-  if (contest_id > 0 && group_id > 0) {
-    abort();
-  } else if (contest_id > 0) {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT %slogins.user_id FROM %slogins, %scntsregs WHERE %slogins.user_id = %scntsregs.user_id AND %scntsregs.contest_id = %d AND %slogins.user_id < %d ORDER BY %slogins.user_id DESC LIMIT 0, 1;",
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix, contest_id,
-             state->md->table_prefix, user_id,
-             state->md->table_prefix);
-  } else if (group_id > 0) {
-    abort();
+  cmd_f = open_memstream(&cmd_t, &cmd_z);
+  fprintf(cmd_f, "SELECT l.user_id");
+  write_user_list_query(state, cmd_f, contest_id, group_id, &uf);
+  if (by_relevance) {
+    // the position of the user is known only in the whole list
+    write_user_list_order(cmd_f, &uf, flags);
+    fprintf(cmd_f, " ;");
+  } else if (dir < 0) {
+    fprintf(cmd_f, " AND l.user_id < %d ORDER BY l.user_id DESC LIMIT 0, 1 ;", user_id);
   } else {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT user_id FROM %slogins WHERE user_id < %d ORDER BY user_id DESC LIMIT 0, 1;",
-             state->md->table_prefix, user_id);
+    fprintf(cmd_f, " AND l.user_id > %d ORDER BY l.user_id LIMIT 0, 1 ;", user_id);
+  }
+  close_memstream(cmd_f); cmd_f = NULL;
+  free_user_filter(&uf);
+
+  if (state->mi->query(state->md, cmd_t, cmd_z, 1) < 0) goto fail;
+  for (i = 0; i < state->md->row_count; ++i) {
+    if (!(state->md->row = mysql_fetch_row(state->md->res))) goto fail;
+    state->md->lengths = mysql_fetch_lengths(state->md->res);
+    if (!state->md->lengths[0]) goto fail;
+    if (state->mi->parse_int(state->md, state->md->row[0], &val) < 0 || val <= 0) goto fail;
+    if (!by_relevance) {
+      if (p_user_id) *p_user_id = val;
+      break;
+    }
+    if (dir < 0 && val == user_id) {
+      if (p_user_id) *p_user_id = prev_id;
+      break;
+    }
+    if (dir > 0 && prev_id == user_id) {
+      if (p_user_id) *p_user_id = val;
+      break;
+    }
+    prev_id = val;
   }
-  cmdlen = strlen(cmdbuf);
-  if (state->mi->query(state->md, cmdbuf, cmdlen, 1) < 0) goto fail;
-  if (state->md->row_count != 1) goto fail;
-  if (!(state->md->row = mysql_fetch_row(state->md->res))) goto fail;
-  state->md->lengths = mysql_fetch_lengths(state->md->res);
-  if (!state->md->lengths[0]) goto fail;
-  if (state->mi->parse_int(state->md, state->md->row[0], &user_id) < 0 || user_id <= 0) goto fail;
-  if (p_user_id) *p_user_id = user_id;
 
 fail:
   state->mi->free_res(state->md);
+  xfree(cmd_t);
   return 0;
 }
 
 static int
-get_next_user_id_func(
+get_prev_user_id_func(
         void *data,
         int contest_id,
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id)
 {
   struct uldb_mysql_state *state = (struct uldb_mysql_state*) data;
-  unsigned char cmdbuf[1024];
-  int cmdlen;
 
-  if (contest_id > 0 && group_id > 0) group_id = 0; // FIXME
-  if (group_id > 0) group_id = 0;                   /* FIXME */
-  if (p_user_id) *p_user_id = 0;
+  return get_adjacent_user_id(state, contest_id, group_id, user_id,
+                              filter, flags, -1, p_user_id);
+}
 
-  if (contest_id > 0 && group_id > 0) {
-    abort();
-  } else if (contest_id > 0) {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT %slogins.user_id FROM %slogins, %scntsregs WHERE %slogins.user_id = %scntsregs.user_id AND %scntsregs.contest_id = %d AND %slogins.user_id > %d ORDER BY %slogins.user_id LIMIT 0, 1;",
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix,
-             state->md->table_prefix, state->md->table_prefix, contest_id,
-             state->md->table_prefix, user_id,
-             state->md->table_prefix);
-  } else if (group_id > 0) {
-    abort();
-  } else {
-    snprintf(cmdbuf, sizeof(cmdbuf), "SELECT user_id FROM %slogins WHERE user_id > %d ORDER BY user_id DESC LIMIT 0, 1;",
-             state->md->table_prefix, user_id);
-  }
-  cmdlen = strlen(cmdbuf);
-  if (state->mi->query(state->md, cmdbuf, cmdlen, 1) < 0) goto fail;
-  if (state->md->row_count != 1) goto fail;
-  if (!(state->md->row = mysql_fetch_row(state->md->res))) goto fail;
-  state->md->lengths = mysql_fetch_lengths(state->md->res);
-  if (!state->md->lengths[0]) goto fail;
-  if (state->mi->parse_int(state->md, state->md->row[0], &user_id) < 0 || user_id <= 0) goto fail;
-  if (p_user_id) *p_user_id = user_id;
+static int
+get_next_user_id_func(
+        void *data,
+        int contest_id,
+        int group_id,
+        int user_id,
+        const unsigned char *filter,
+        int flags,
+        int *p_user_id)
+{
+  struct uldb_mysql_state *state = (struct uldb_mysql_state*) data;
 
-fail:
-  state->mi->free_res(state->md);
-  return 0;
+  return get_adjacent_user_id(state, contest_id, group_id, user_id,
+                              filter, flags, 1, p_user_id);
 }
 
 static int
@@ -302,6 +302,8 @@ static const struct config_parse_info section_global_params[] =
   GLOBAL_PARAM(html_report, "d"),
   GLOBAL_PARAM(xml_report, "d"),
   GLOBAL_PARAM(enable_full_archive, "d"),
+  GLOBAL_PARAM(audit_log_sync, "d"),
+  GLOBAL_PARAM(binary_run_packets, "d"),
   GLOBAL_PARAM(cpu_bogomips, "d"),
   GLOBAL_PARAM(skip_full_testing, "d"),
   GLOBAL_PARAM(skip_accept_testing, "d"),
@@ -774,6 +776,8 @@ global_init_func(struct generic_section_config *gp)
   p->printout_uses_login = -1;
   p->prune_empty_users = -1;
   p->enable_full_archive = -1;
+  p->audit_log_sync = -1;
+  p->binary_run_packets = -1;
   p->always_show_problems = -1;
   p->disable_user_standings = -1;
   p->disable_language = -1;
@@ -2614,6 +2618,10 @@ set_defaults(
     g->prune_empty_users = DFLT_G_PRUNE_EMPTY_USERS;
   if (g->enable_full_archive == -1)
     g->enable_full_archive = DFLT_G_ENABLE_FULL_ARCHIVE;
+  if (g->audit_log_sync < 0)
+    g->audit_log_sync = 0;
+  if (g->binary_run_packets < 0)
+    g->binary_run_packets = 0;
   if (g->always_show_problems == -1)
     g->always_show_problems = DFLT_G_ALWAYS_SHOW_PROBLEMS;
   if (g->disable_user_standings == -1)
@@ -5117,6 +5125,10 @@ prepare_set_global_defaults(struct section_global_data *g)
     g->enable_report_upload = DFLT_G_ENABLE_REPORT_UPLOAD;
   if (g->enable_full_archive < 0)
     g->enable_full_archive = DFLT_G_ENABLE_FULL_ARCHIVE;
+  if (g->audit_log_sync < 0)
+    g->audit_log_sync = 0;
+  if (g->binary_run_packets < 0)
+    g->binary_run_packets = 0;
   if (g->enable_printing < 0)
     g->enable_printing = DFLT_G_ENABLE_PRINTING;
   if (g->disable_banner_page < 0)
@@ -668,6 +668,11 @@ struct section_global_data
   ejintbool_t xml_report;
   /** store the full output of the program being tested */
   ejintbool_t enable_full_archive;
+  /** sync the audit log segments to the disk on every write */
+  ejintbool_t audit_log_sync;
+  /** send the run requests in the binary form, all the invokers
+      must be able to parse it */
+  ejintbool_t binary_run_packets;
   /** reference CPU speed (BogoMIPS) */
   int cpu_bogomips;
   ejintbool_t skip_full_testing;
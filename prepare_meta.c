@@ -262,6 +262,8 @@ static struct meta_info_item meta_info_section_global_data_data[] =
   [CNTSGLOB_html_report] = { CNTSGLOB_html_report, 'B', XSIZE(struct section_global_data, html_report), "html_report", XOFFSET(struct section_global_data, html_report) },
   [CNTSGLOB_xml_report] = { CNTSGLOB_xml_report, 'B', XSIZE(struct section_global_data, xml_report), "xml_report", XOFFSET(struct section_global_data, xml_report) },
   [CNTSGLOB_enable_full_archive] = { CNTSGLOB_enable_full_archive, 'B', XSIZE(struct section_global_data, enable_full_archive), "enable_full_archive", XOFFSET(struct section_global_data, enable_full_archive) },
+  [CNTSGLOB_audit_log_sync] = { CNTSGLOB_audit_log_sync, 'B', XSIZE(struct section_global_data, audit_log_sync), "audit_log_sync", XOFFSET(struct section_global_data, audit_log_sync) },
+  [CNTSGLOB_binary_run_packets] = { CNTSGLOB_binary_run_packets, 'B', XSIZE(struct section_global_data, binary_run_packets), "binary_run_packets", XOFFSET(struct section_global_data, binary_run_packets) },
   [CNTSGLOB_cpu_bogomips] = { CNTSGLOB_cpu_bogomips, 'i', XSIZE(struct section_global_data, cpu_bogomips), "cpu_bogomips", XOFFSET(struct section_global_data, cpu_bogomips) },
   [CNTSGLOB_skip_full_testing] = { CNTSGLOB_skip_full_testing, 'B', XSIZE(struct section_global_data, skip_full_testing), "skip_full_testing", XOFFSET(struct section_global_data, skip_full_testing) },
   [CNTSGLOB_skip_accept_testing] = { CNTSGLOB_skip_accept_testing, 'B', XSIZE(struct section_global_data, skip_accept_testing), "skip_accept_testing", XOFFSET(struct section_global_data, skip_accept_testing) },
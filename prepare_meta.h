@@ -257,6 +257,8 @@ enum
   CNTSGLOB_html_report,
   CNTSGLOB_xml_report,
   CNTSGLOB_enable_full_archive,
+  CNTSGLOB_audit_log_sync,
+  CNTSGLOB_binary_run_packets,
   CNTSGLOB_cpu_bogomips,
   CNTSGLOB_skip_full_testing,
   CNTSGLOB_skip_accept_testing,
@@ -246,6 +246,10 @@ prepare_unparse_global(FILE *f, struct section_global_data *global,
     unparse_bool(f, "prune_empty_users", global->prune_empty_users);
   if (global->enable_full_archive != DFLT_G_ENABLE_FULL_ARCHIVE)
     unparse_bool(f, "enable_full_archive", global->enable_full_archive);
+  if (global->audit_log_sync > 0)
+    unparse_bool(f, "audit_log_sync", global->audit_log_sync);
+  if (global->binary_run_packets > 0)
+    unparse_bool(f, "binary_run_packets", global->binary_run_packets);
   if (global->always_show_problems != DFLT_G_ALWAYS_SHOW_PROBLEMS)
     unparse_bool(f, "always_show_problems", global->always_show_problems);
   if (global->disable_user_standings != DFLT_G_DISABLE_USER_STANDINGS)
@@ -22,6 +22,10 @@
 #include "userlist_proto.h"
 #include "userlist.h"
 #include "xml_utils.h"
+#include "runlog_reader.h"
+
+#include <errno.h>
+#include <stddef.h>
 
 /* userlist_clnt implementation status
  *
@@ -1484,6 +1488,368 @@ static PyTypeObject UlType =
   Ul_new,                       /* tp_new */
 };
 
+/*
+ * Read-only access to the binary runlog files.
+ *
+ * The Runlog object supports the buffer protocol: the buffer is the
+ * array of the run entries (RUN_ENTRY_SIZE bytes each) mapped from the file,
+ * so it may be passed to numpy.frombuffer with RUN_ENTRY_DTYPE
+ * without creating any python objects for the individual runs.
+ * select() returns a bytearray of native ints (the indices of
+ * the matching runs) suitable for numpy.frombuffer(..., dtype='i4').
+ */
+
+typedef struct
+{
+  PyObject_HEAD /* ; */
+  struct runlog_reader rr;
+} RlObject;
+
+static PyObject *
+Rl_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+  RlObject *self = (RlObject *) type->tp_alloc(type, 0);
+
+  if (self) {
+    memset(&self->rr, 0, sizeof(self->rr));
+    self->rr.fd = -1;
+  }
+  return (PyObject*) self;
+}
+
+static int
+Rl_init(RlObject *self, PyObject *args, PyObject *kwds)
+{
+  const char *path = 0;
+  static char * kwlist[] = { "path", NULL };
+  int r;
+
+  // the buffers exported from the mapping may outlive any call,
+  // so the mapping is kept until the object is deallocated
+  if (self->rr.data) {
+    PyErr_SetString(PyExc_IOError, "runlog is already opened");
+    return -1;
+  }
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &path))
+    return -1;
+
+  if ((r = runlog_reader_open(&self->rr, path)) < 0) {
+    errno = -r;
+    PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char*) path);
+    return -1;
+  }
+  return 0;
+}
+
+static void
+Rl_dealloc(RlObject *self)
+{
+  runlog_reader_close(&self->rr);
+  self->ob_type->tp_free((PyObject*) self);
+}
+
+static int
+Rl_check_open(RlObject *self)
+{
+  if (!self->rr.data) {
+    PyErr_SetString(PyExc_IOError, "runlog is not opened");
+    return -1;
+  }
+  return 0;
+}
+
+static Py_ssize_t
+Rl_length(RlObject *self)
+{
+  if (Rl_check_open(self) < 0) return -1;
+  return self->rr.run_count;
+}
+
+static PyObject *
+Rl_header(RlObject *self)
+{
+  const struct run_header *h;
+
+  if (Rl_check_open(self) < 0) return 0;
+  h = self->rr.header;
+  return Py_BuildValue("{s:i,s:L,s:L,s:L,s:L,s:L,s:L,s:L,s:L}",
+                       "version", h->version,
+                       "start_time", h->start_time,
+                       "sched_time", h->sched_time,
+                       "duration", h->duration,
+                       "stop_time", h->stop_time,
+                       "finish_time", h->finish_time,
+                       "saved_duration", h->saved_duration,
+                       "saved_stop_time", h->saved_stop_time,
+                       "saved_finish_time", h->saved_finish_time);
+}
+
+static PyObject *
+Rl_entry(RlObject *self, PyObject *args)
+{
+  int i;
+  const struct run_entry *re;
+
+  if (!PyArg_ParseTuple(args, "i", &i)) return 0;
+  if (Rl_check_open(self) < 0) return 0;
+  if (i < 0 || i >= self->rr.run_count) {
+    PyErr_SetString(PyExc_IndexError, "run index out of range");
+    return 0;
+  }
+  re = &self->rr.runs[i];
+  return Py_BuildValue("{s:i,s:I,s:L,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i,s:i}",
+                       "run_id", re->run_id,
+                       "size", re->size,
+                       "time", re->time,
+                       "nsec", re->nsec,
+                       "user_id", re->user_id,
+                       "prob_id", re->prob_id,
+                       "lang_id", re->lang_id,
+                       "status", re->status,
+                       "score", re->score,
+                       "test", re->test,
+                       "score_adj", re->score_adj,
+                       "locale_id", re->locale_id,
+                       "variant", re->variant,
+                       "is_hidden", re->is_hidden,
+                       "is_imported", re->is_imported);
+}
+
+static PyObject *
+Rl_select(RlObject *self, PyObject *args, PyObject *kwds)
+{
+  static char * kwlist[] =
+  {
+    "user_id", "prob_id", "lang_id", "statuses", "from_time", "to_time",
+    "skip_empty", "skip_hidden", NULL
+  };
+  struct runlog_reader_filter flt;
+  long long from_time = 0, to_time = 0;
+  PyObject *statuses = 0, *it, *item, *res;
+  int count;
+  long st;
+
+  memset(&flt, 0, sizeof(flt));
+  flt.skip_empty = 1;
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|iiiOLLii", kwlist,
+                                   &flt.user_id, &flt.prob_id, &flt.lang_id,
+                                   &statuses, &from_time, &to_time,
+                                   &flt.skip_empty, &flt.skip_hidden))
+    return 0;
+  if (Rl_check_open(self) < 0) return 0;
+  flt.from_time = from_time;
+  flt.to_time = to_time;
+
+  if (statuses && statuses != Py_None) {
+    if (!(it = PyObject_GetIter(statuses))) return 0;
+    while ((item = PyIter_Next(it))) {
+      st = PyInt_AsLong(item);
+      Py_DECREF(item);
+      if (st == -1 && PyErr_Occurred()) break;
+      if (st < 0 || st >= 128) {
+        PyErr_SetString(PyExc_ValueError, "invalid run status");
+        break;
+      }
+      runlog_reader_filter_add_status(&flt, st);
+    }
+    Py_DECREF(it);
+    if (PyErr_Occurred()) return 0;
+    // an empty list of statuses matches nothing
+    if (!flt.status_mask[0] && !flt.status_mask[1])
+      return PyByteArray_FromStringAndSize(NULL, 0);
+  }
+
+  count = runlog_reader_select(&self->rr, &flt, NULL, 0);
+  if (!(res = PyByteArray_FromStringAndSize(NULL, count * sizeof(int))))
+    return 0;
+  runlog_reader_select(&self->rr, &flt, (int*) PyByteArray_AS_STRING(res),
+                       count);
+  return res;
+}
+
+static Py_ssize_t
+Rl_getreadbuffer(RlObject *self, Py_ssize_t segment, void **pptr)
+{
+  if (segment != 0) {
+    PyErr_SetString(PyExc_SystemError, "invalid buffer segment");
+    return -1;
+  }
+  if (Rl_check_open(self) < 0) return -1;
+  *pptr = (void*) self->rr.runs;
+  return (Py_ssize_t) self->rr.run_count * sizeof(struct run_entry);
+}
+
+static Py_ssize_t
+Rl_getsegcount(RlObject *self, Py_ssize_t *plen)
+{
+  if (plen) {
+    *plen = 0;
+    if (self->rr.data)
+      *plen = (Py_ssize_t) self->rr.run_count * sizeof(struct run_entry);
+  }
+  return 1;
+}
+
+#if defined Py_TPFLAGS_HAVE_NEWBUFFER
+static int
+Rl_getbuffer(RlObject *self, Py_buffer *view, int flags)
+{
+  if (Rl_check_open(self) < 0) return -1;
+  return PyBuffer_FillInfo(view, (PyObject*) self, (void*) self->rr.runs,
+                           (Py_ssize_t) self->rr.run_count
+                           * sizeof(struct run_entry),
+                           1, flags);
+}
+#define RL_TPFLAGS (Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER)
+#else
+#define RL_TPFLAGS Py_TPFLAGS_DEFAULT
+#endif
+
+static PyBufferProcs Rl_as_buffer =
+{
+  (readbufferproc) Rl_getreadbuffer,    /* bf_getreadbuffer */
+  0,                                    /* bf_getwritebuffer */
+  (segcountproc) Rl_getsegcount,        /* bf_getsegcount */
+  (charbufferproc) Rl_getreadbuffer,    /* bf_getcharbuffer */
+#if defined Py_TPFLAGS_HAVE_NEWBUFFER
+  (getbufferproc) Rl_getbuffer,         /* bf_getbuffer */
+  0,                                    /* bf_releasebuffer */
+#endif
+};
+
+static PySequenceMethods Rl_as_sequence =
+{
+  (lenfunc) Rl_length,          /* sq_length */
+};
+
+static PyMethodDef Rl_methods[] =
+{
+  { "header", (PyCFunction) Rl_header, METH_NOARGS,
+    "header() -> dict of the runlog header fields" },
+  { "entry", (PyCFunction) Rl_entry, METH_VARARGS,
+    "entry(index) -> dict of the run entry fields" },
+  { "select", (PyCFunction) Rl_select, METH_VARARGS | METH_KEYWORDS,
+    "select(user_id, prob_id, lang_id, statuses, from_time, to_time, "
+    "skip_empty, skip_hidden) -> bytearray of the matching run indices" },
+
+  { NULL }
+};
+
+static PyTypeObject RlType =
+{
+  PyObject_HEAD_INIT(NULL)
+  0,                            /* ob_size */
+  "ejudge.Runlog",              /* tp_name */
+  sizeof(RlObject),             /* tp_basicsize */
+  0,                            /* tp_itemsize */
+  (destructor) Rl_dealloc,      /* tp_dealloc */
+  0,                            /* tp_print */
+  0,                            /* tp_getattr */
+  0,                            /* tp_setattr */
+  0,                            /* tp_compare */
+  0,                            /* tp_repr */
+  0,                            /* tp_as_number */
+  &Rl_as_sequence,              /* tp_as_sequence */
+  0,                            /* tp_as_mapping */
+  0,                            /* tp_hash */
+  0,                            /* tp_call */
+  0,                            /* tp_str */
+  0,                            /* tp_getattro */
+  0,                            /* tp_setattro */
+  &Rl_as_buffer,                /* tp_as_buffer */
+  RL_TPFLAGS,                   /* tp_flags */
+  "Ejudge read-only runlog objects", /* tp_doc */
+  0,                            /* tp_traverse */
+  0,                            /* tp_clear */
+  0,                            /* tp_richcompare */
+  0,                            /* tp_weaklistoffset */
+  0,                            /* tp_iter */
+  0,                            /* tp_iternext */
+  Rl_methods,                   /* tp_methods */
+  0,                            /* tp_members */
+  0,                            /* tp_getset */
+  0,                            /* tp_base */
+  0,                            /* tp_dict */
+  0,                            /* tp_descr_get */
+  0,                            /* tp_descr_set */
+  0,                            /* tp_dictoffset */
+  (initproc)Rl_init,            /* tp_init */
+  0,                            /* tp_alloc */
+  Rl_new,                       /* tp_new */
+};
+
+/* the run entry layout in the numpy dtype notation */
+#define RE_FIELD(n, f) { #n, f, offsetof(struct run_entry, n) }
+static const struct
+{
+  const char *name;
+  const char *format;
+  int offset;
+} run_entry_fields[] =
+{
+  RE_FIELD(run_id, "<i4"),
+  RE_FIELD(size, "<u4"),
+  RE_FIELD(time, "<i8"),
+  RE_FIELD(nsec, "<i4"),
+  RE_FIELD(user_id, "<i4"),
+  RE_FIELD(prob_id, "<i4"),
+  RE_FIELD(lang_id, "<i4"),
+  { "ip", "<u4", offsetof(struct run_entry, a) },
+  { "ipv6", "(16,)u1", offsetof(struct run_entry, a) },
+  RE_FIELD(sha1, "(5,)<u4"),
+  RE_FIELD(score, "<i4"),
+  RE_FIELD(test, "<i2"),
+  RE_FIELD(passed_mode, "i1"),
+  RE_FIELD(store_flags, "u1"),
+  RE_FIELD(score_adj, "<i4"),
+  RE_FIELD(locale_id, "<i2"),
+  RE_FIELD(judge_id, "<u2"),
+  RE_FIELD(status, "u1"),
+  RE_FIELD(is_imported, "u1"),
+  RE_FIELD(variant, "u1"),
+  RE_FIELD(is_hidden, "u1"),
+  RE_FIELD(is_readonly, "u1"),
+  RE_FIELD(pages, "u1"),
+  RE_FIELD(ipv6_flag, "u1"),
+  RE_FIELD(ssl_flag, "u1"),
+  RE_FIELD(mime_type, "<i2"),
+  RE_FIELD(eoln_type, "u1"),
+  RE_FIELD(is_marked, "u1"),
+  RE_FIELD(run_uuid, "(4,)<u4"),
+  RE_FIELD(saved_score, "<i4"),
+  RE_FIELD(saved_test, "<i2"),
+  RE_FIELD(saved_status, "u1"),
+  RE_FIELD(is_saved, "u1"),
+};
+#undef RE_FIELD
+
+static PyObject *
+make_run_entry_dtype(void)
+{
+  int n = sizeof(run_entry_fields) / sizeof(run_entry_fields[0]), i;
+  PyObject *names = 0, *formats = 0, *offsets = 0, *res = 0;
+
+  if (!(names = PyList_New(n))) goto cleanup;
+  if (!(formats = PyList_New(n))) goto cleanup;
+  if (!(offsets = PyList_New(n))) goto cleanup;
+  for (i = 0; i < n; ++i) {
+    PyList_SET_ITEM(names, i, PyString_FromString(run_entry_fields[i].name));
+    PyList_SET_ITEM(formats, i,
+                    PyString_FromString(run_entry_fields[i].format));
+    PyList_SET_ITEM(offsets, i, PyInt_FromLong(run_entry_fields[i].offset));
+  }
+  res = Py_BuildValue("{s:O,s:O,s:O,s:i}", "names", names, "formats", formats,
+                      "offsets", offsets, "itemsize",
+                      (int) sizeof(struct run_entry));
+
+cleanup:
+  Py_XDECREF(names);
+  Py_XDECREF(formats);
+  Py_XDECREF(offsets);
+  return res;
+}
+
 static PyMethodDef ejudge_methods[] =
 {
   {NULL}  /* Sentinel */
@@ -1497,14 +1863,22 @@ initejudge(void)
 {
   PyObject *m;
   PyObject *t = (PyObject*) (void*) &UlType;
+  PyObject *rt = (PyObject*) (void*) &RlType;
 
   //UlType.tp_new = PyType_GenericNew;
   if (PyType_Ready(&UlType) < 0)
     return;
+  if (PyType_Ready(&RlType) < 0)
+    return;
 
   m = Py_InitModule3("ejudge", ejudge_methods,
                      "Ejudge interface module.");
 
   Py_INCREF(&UlType);
   PyModule_AddObject(m, "Userlist", t);
+  Py_INCREF(&RlType);
+  PyModule_AddObject(m, "Runlog", rt);
+  PyModule_AddIntConstant(m, "RUN_HEADER_SIZE", sizeof(struct run_header));
+  PyModule_AddIntConstant(m, "RUN_ENTRY_SIZE", sizeof(struct run_entry));
+  PyModule_AddObject(m, "RUN_ENTRY_DTYPE", make_run_entry_dtype());
 }
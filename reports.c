@@ -32,6 +32,7 @@
 #include "random.h"
 #include "testing_report_xml.h"
 #include "mime_type.h"
+#include "run_pack.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_osdeps.h"
@@ -336,8 +337,7 @@ user_report_generate(
   int total_runs, run_id, retval = -1, f_id, l_id, i, j, k;
   struct run_entry re;
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
-  path_t src_path;
-  int src_flags, answer, variant, passed_tests;
+  int answer, variant, passed_tests;
   char *src_txt = 0, *eptr, *num_txt = 0;
   size_t src_len = 0, num_len = 0;
   problem_xml_t px;
@@ -612,16 +612,13 @@ user_report_generate(
               run_status_str(re.status, 0, 0, 0, 0));
       fprintf(fout, "\\hline\n\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -667,16 +664,13 @@ user_report_generate(
         goto cleanup;
       }
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -731,16 +725,13 @@ user_report_generate(
           goto cleanup;
         }
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -805,16 +796,13 @@ user_report_generate(
           goto cleanup;
         }
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -822,7 +810,7 @@ user_report_generate(
         errno = 0;
         answer = strtol(src_txt, &eptr, 10);
         if (errno || *eptr) {
-          fprintf(log_f, "Source file %s is invalid\n", src_path);
+          fprintf(log_f, "Source for run %d is invalid\n", run_id);
           goto cleanup;
         }
         xfree(src_txt); src_txt = 0; src_len = 0;
@@ -936,8 +924,7 @@ full_user_report_generate(
   int total_runs, run_id, retval = -1, f_id, l_id, i, j, k;
   struct run_entry re;
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
-  path_t src_path;
-  int src_flags, answer, variant;
+  int answer, variant;
   char *src_txt = 0, *eptr, *num_txt = 0;
   size_t src_len = 0, num_len = 0;
   problem_xml_t px;
@@ -1280,16 +1267,13 @@ full_user_report_generate(
       fprintf(fout, "\\hline\n");
       fprintf(fout, "\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -1351,16 +1335,13 @@ full_user_report_generate(
       fprintf(fout, "\\hline\n");
       fprintf(fout, "\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -1415,17 +1396,13 @@ full_user_report_generate(
         if (run_get_entry(cs->runlog_state, run_ids[i], &re) < 0) abort();
         if (re.status == RUN_PARTIAL) re.status = RUN_WRONG_ANSWER_ERR;
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path,
-                              "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -1496,16 +1473,13 @@ full_user_report_generate(
         if (re.status == RUN_OK && !prob->variable_full_score)
           cur_score = prob->full_score;
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -1513,7 +1487,7 @@ full_user_report_generate(
         errno = 0;
         answer = strtol(src_txt, &eptr, 10);
         if (errno || *eptr) {
-          fprintf(log_f, "Source file %s is invalid\n", src_path);
+          fprintf(log_f, "Source for run %d is invalid\n", run_id);
           goto cleanup;
         }
         xfree(src_txt); src_txt = 0; src_len = 0;
@@ -2153,8 +2127,7 @@ ns_olympiad_final_user_report(
   int total_runs, run_id, retval = -1, f_id, l_id, i, j, k;
   struct run_entry re;
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
-  path_t src_path;
-  int src_flags, answer, variant, passed_tests;
+  int answer, variant, passed_tests;
   char *src_txt = 0, *eptr, *num_txt = 0;
   size_t src_len = 0, num_len = 0;
   problem_xml_t px;
@@ -2433,16 +2406,13 @@ ns_olympiad_final_user_report(
       fprintf(fout, "%s<i>%s</i></td></tr></table>\n", td1,
               run_status_str(re.status, 0, 0, 0, 0));
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -2489,14 +2459,11 @@ ns_olympiad_final_user_report(
         goto cleanup;
       }
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
         fprintf(fout, "%s<i>%s</i></td></tr></table>\n", td1,
                 _("Binary file is not shown"));
@@ -2559,16 +2526,13 @@ ns_olympiad_final_user_report(
           goto cleanup;
         }
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -2638,16 +2602,13 @@ ns_olympiad_final_user_report(
           goto cleanup;
         }
 
-        if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+        if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                    &src_txt, &src_len) < 0) {
           fprintf(log_f, "Source for run %d is not available\n", run_id);
           goto cleanup;
         }
-        if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-          fprintf(log_f, "Error reading from %s\n", src_path);
-          goto cleanup;
-        }
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -2655,7 +2616,7 @@ ns_olympiad_final_user_report(
         errno = 0;
         answer = strtol(src_txt, &eptr, 10);
         if (errno || *eptr) {
-          fprintf(log_f, "Source file %s is invalid\n", src_path);
+          fprintf(log_f, "Source for run %d is invalid\n", run_id);
           goto cleanup;
         }
         xfree(src_txt); src_txt = 0; src_len = 0;
@@ -2972,8 +2933,6 @@ problem_report_generate(
   struct run_entry re;
   unsigned char bigbuf[16384];
   struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
-  int src_flags;
-  path_t src_path;
   char *src_txt = 0, *num_txt = 0;
   size_t src_len = 0, num_len = 0;
   unsigned char probname[1024];
@@ -3262,16 +3221,13 @@ problem_report_generate(
       fprintf(fout, "\\hline\n");
       fprintf(fout, "\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -3335,16 +3291,13 @@ problem_report_generate(
       fprintf(fout, "\\hline\n");
       fprintf(fout, "\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -3406,18 +3359,15 @@ problem_report_generate(
       fprintf(fout, "\\hline\n");
       fprintf(fout, "\\end{tabular}\n\n");
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (re.mime_type == 0) {
         // plain text
         if (strlen(src_txt) != src_len) {
-          fprintf(log_f, "Source file %s is binary\n", src_path);
+          fprintf(log_f, "Source for run %d is binary\n", run_id);
           goto cleanup;
         }
         while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -3465,16 +3415,13 @@ problem_report_generate(
         }
       }
 
-      if ((src_flags = serve_make_source_read_path(cs, src_path, sizeof(src_path), &re)) < 0) {
+      if (serve_read_run_artifact(cs, &re, RUN_PACK_SOURCE,
+                                  &src_txt, &src_len) < 0) {
         fprintf(log_f, "Source for run %d is not available\n", run_id);
         goto cleanup;
       }
-      if (generic_read_file(&src_txt, 0, &src_len, src_flags, 0, src_path, "") < 0) {
-        fprintf(log_f, "Error reading from %s\n", src_path);
-        goto cleanup;
-      }
       if (strlen(src_txt) != src_len) {
-        fprintf(log_f, "Source file %s is binary\n", src_path);
+        fprintf(log_f, "Source for run %d is binary\n", run_id);
         goto cleanup;
       }
       while (src_len > 0 && isspace(src_txt[src_len - 1])) src_len--;
@@ -1,6 +1,6 @@
 /* $Id: reuse_mempage.c 6233 2011-04-08 17:43:06Z cher $ */
 
-/* Copyright (C) 1995-2011 Alexander Chernov <cher@ejudge.ru> */
+/* Copyright (C) 1995-2013 Alexander Chernov <cher@ejudge.ru> */
 
 /*
  * This library is free software; you can redistribute it and/or
@@ -29,6 +29,8 @@ struct tPageDesc
 struct tPageBlock  *Blocks;
 size_t             Size;       /* size of each memory chunk */
 size_t             Wasted;     /* wasted for alignment */
+size_t             Used;       /* total size of the allocated objects */
+size_t             Alloc_Count; /* number of pgMalloc calls */
 #ifdef KEEP_CALLER
 char               *File;
 line_t             Line;
@@ -62,6 +64,9 @@ pgCreate(size_t size)
 
   res->Size   = size;
   res->Blocks = NULL;
+  res->Wasted = 0;
+  res->Used = 0;
+  res->Alloc_Count = 0;
 
   return res;
 }
@@ -78,6 +83,8 @@ pgMalloc(tPageDesc *desc, size_t size)
 
   needed_size = ALIGN_SIZE(size);
   desc->Wasted += needed_size - size;
+  desc->Used += needed_size;
+  desc->Alloc_Count++;
   for (block_ptr = desc->Blocks;
        block_ptr != NULL;
        block_ptr = block_ptr->Next)
@@ -119,6 +126,35 @@ pgCalloc(tPageDesc *page, size_t nelem, size_t elem_size)
   return p;
 }
 
+void *
+pgMemdup(tPageDesc *page, const void *src, size_t size)
+{
+  char *p = (char*) pgMalloc(page, size + 1);
+
+  if (size > 0) memcpy(p, src, size);
+  p[size] = 0;
+  return p;
+}
+
+char *
+pgStrdup(tPageDesc *page, const char *str)
+{
+  if (!str) str = "";
+  return (char*) pgMemdup(page, str, strlen(str));
+}
+
+size_t
+pgUsedSize(const tPageDesc *desc)
+{
+  return desc->Used;
+}
+
+size_t
+pgAllocCount(const tPageDesc *desc)
+{
+  return desc->Alloc_Count;
+}
+
 void
 pgDestroy(tPageDesc *pchk)
 {
@@ -64,6 +64,9 @@ struct tTask;
 typedef struct tTask tTask, *tpTask;
 
 int      task_SetFlag(char *, int);
+int      task_SetCgroupRoot(const char *path);
+int      task_SetCgroupMemoryLimit(size_t size);
+int      task_SetForkMode(int fork_flag);
 
 tpTask   task_New(void);
 int      task_AddArg(tpTask, char const *arg);
@@ -97,6 +100,7 @@ int      task_EnableSecureExec(tpTask);
 int      task_EnableAllSignals(tpTask);
 int      task_EnableSecurityViolationError(tpTask);
 int      task_EnableProcessGroup(tpTask);
+int      task_EnableCgroup(tpTask);
 int      task_IgnoreSIGPIPE(tpTask);
 
 int      task_PrintArgs(tpTask);
@@ -127,6 +131,7 @@ int      task_GetPid(tpTask);
 
 #define task_GetMemoryUsed task_GetMemoryUsed
 long     task_GetMemoryUsed(tpTask);
+long long task_GetCgroupMemoryPeak(tpTask);
 
 /* setrlimit interface */
 // RLIMIT_CORE
@@ -3,7 +3,7 @@
 #ifndef __REUSE_MEMPAGE_H__
 #define __REUSE_MEMPAGE_H__
 
-/* Copyright (C) 1995-2011 Alexander Chernov <cher@ejudge.ru> */
+/* Copyright (C) 1995-2013 Alexander Chernov <cher@ejudge.ru> */
 
 /*
  * This library is free software; you can redistribute it and/or
@@ -37,6 +37,10 @@ extern "C" {
   void      *pgMalloc(tPageDesc *,size_t);
   void      *pgCalloc(tPageDesc *, size_t nelem, size_t elem_size);
   void       pgPageStatistics(tPageDesc *, FILE *);    
+  void      *pgMemdup(tPageDesc *, const void *src, size_t size);
+  char      *pgStrdup(tPageDesc *, const char *str);
+  size_t     pgUsedSize(const tPageDesc *);
+  size_t     pgAllocCount(const tPageDesc *);
 
 #if defined __cplusplus
 }
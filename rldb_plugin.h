@@ -157,6 +157,8 @@ struct rldb_plugin_iface
   int (*change_status_4)(struct rldb_plugin_cnts *,
                          int run_id,
                          int new_status);
+  // write the pending changes, called once per the main loop iteration
+  int (*commit)(struct rldb_plugin_cnts *);
 };
 
 /* default plugin: compiled into new-server */
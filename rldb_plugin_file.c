@@ -42,9 +42,40 @@
 #include <sys/stat.h>
 #include <errno.h>
 
+/*
+ * The changed run entries and the header are not written immediately,
+ * but are collected and written by commit_func, which is called once
+ * per main loop iteration, and when the runlog is closed. The adjacent
+ * entries are written by a single write. The new runs are committed
+ * immediately. If the process is killed in the middle of a commit,
+ * each entry is left either old or new ("ej-microbench runlogcrash"
+ * checks that).
+ *
+ * The durability is configured in the plugin configuration:
+ *   <sync_mode>none|always|batch|interval</sync_mode>
+ *   <sync_interval>seconds</sync_interval>
+ */
+enum
+{
+  SYNC_NONE,                    /* no fdatasync, as before */
+  SYNC_ALWAYS,                  /* each change is written and synced */
+  SYNC_BATCH,                   /* each batch is synced (group commit) */
+  SYNC_INTERVAL,                /* at most every sync_interval seconds */
+};
+
+static const char * const sync_mode_names[] =
+{
+  [SYNC_NONE] = "none",
+  [SYNC_ALWAYS] = "always",
+  [SYNC_BATCH] = "batch",
+  [SYNC_INTERVAL] = "interval",
+};
+
 struct rldb_file_state
 {
   int nref;
+  int sync_mode;
+  int sync_interval;
 };
 
 struct rldb_file_cnts
@@ -53,6 +84,16 @@ struct rldb_file_cnts
   struct runlog_state *rl_state;
   int run_fd;
   unsigned char *runlog_path;
+
+  // the entries changed since the last commit
+  int *dirty_runs;
+  int dirty_u, dirty_a;
+  unsigned char *dirty_map;
+  int dirty_map_a;
+  int header_dirty;
+  // the data is written, but not synced
+  int unsynced;
+  time_t last_sync_time;
 };
 
 static struct common_plugin_data *
@@ -204,6 +245,10 @@ change_status_4_func(
         struct rldb_plugin_cnts *cdata,
         int run_id,
         int new_status);
+static int
+commit_func(struct rldb_plugin_cnts *cdata);
+static int
+do_commit(struct rldb_file_cnts *cs);
 
 struct rldb_plugin_iface rldb_plugin_file =
 {
@@ -250,6 +295,7 @@ struct rldb_plugin_iface rldb_plugin_file =
   check_func,
   change_status_3_func,
   change_status_4_func,
+  commit_func,
 };
 
 static struct common_plugin_data *
@@ -274,6 +320,46 @@ prepare_func(
         const struct ejudge_cfg *config,
         struct xml_tree *plugin_config)
 {
+  struct rldb_file_state *state = (struct rldb_file_state*) data;
+  const struct xml_parse_spec *spec = ejudge_cfg_get_spec();
+  struct xml_tree *p;
+  unsigned char *mode = 0;
+  int i;
+
+  state->sync_mode = SYNC_NONE;
+  state->sync_interval = 1;
+  if (!plugin_config) return 0;
+
+  ASSERT(plugin_config->tag == spec->default_elem);
+  ASSERT(!strcmp(plugin_config->name[0], "config"));
+  if (xml_empty_text_c(plugin_config) < 0) return -1;
+  if (plugin_config->first) return xml_err_attrs(plugin_config);
+
+  for (p = plugin_config->first_down; p; p = p->right) {
+    ASSERT(p->tag == spec->default_elem);
+    if (!strcmp(p->name[0], "sync_mode")) {
+      if (xml_leaf_elem(p, &mode, 1, 0) < 0) return -1;
+      for (i = 0; i < sizeof(sync_mode_names) / sizeof(sync_mode_names[0]);
+           ++i) {
+        if (!strcmp(mode, sync_mode_names[i])) break;
+      }
+      if (i == sizeof(sync_mode_names) / sizeof(sync_mode_names[0])) {
+        xml_err_elem_invalid(p);
+        xfree(mode);
+        return -1;
+      }
+      state->sync_mode = i;
+      xfree(mode); mode = 0;
+    } else if (!strcmp(p->name[0], "sync_interval")) {
+      if (p->first) return xml_err_attrs(p);
+      if (p->first_down) return xml_err_nested_elems(p);
+      if (xml_parse_int(NULL, "", p->line, p->column, p->text,
+                        &state->sync_interval) < 0) return -1;
+      if (state->sync_interval <= 0) return xml_err_elem_invalid(p);
+    } else {
+      return xml_err_elem_not_allowed(p);
+    }
+  }
   return 0;
 }
 
@@ -880,6 +966,7 @@ close_func(struct rldb_plugin_cnts *cdata)
 
   if (!cs) return 0;
   rls = cs->rl_state;
+  if (rls && rls->runs) do_commit(cs);
   if (rls) {
     xfree(rls->runs); rls->runs = 0;
     rls->run_a = rls->run_u = 0;
@@ -887,6 +974,8 @@ close_func(struct rldb_plugin_cnts *cdata)
   if (cs->plugin_state) cs->plugin_state->nref--;
   if (cs->run_fd >= 0) close(cs->run_fd);
   xfree(cs->runlog_path);
+  xfree(cs->dirty_runs);
+  xfree(cs->dirty_map);
   xfree(cs);
   return 0;
 }
@@ -1114,6 +1203,104 @@ get_insert_run_id(
   return i;
 }
 
+static int
+do_pwrite(int fd, const void *buf, size_t size, off_t offset)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  ssize_t w;
+
+  while (size > 0) {
+    if ((w = pwrite(fd, p, size, offset)) <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      err("do_pwrite: write error: %s", os_ErrorMsg());
+      return -1;
+    }
+    p += w;
+    size -= w;
+    offset += w;
+  }
+  return 0;
+}
+
+static int
+do_sync(struct rldb_file_cnts *cs, time_t cur_time)
+{
+  if (fdatasync(cs->run_fd) < 0) {
+    err("fdatasync failed: %s", os_ErrorMsg());
+    return -1;
+  }
+  cs->unsynced = 0;
+  cs->last_sync_time = cur_time;
+  return 0;
+}
+
+static int
+int_sort_func(const void *p1, const void *p2)
+{
+  int v1 = *(const int*) p1, v2 = *(const int*) p2;
+  if (v1 < v2) return -1;
+  return v1 > v2;
+}
+
+/* writes the changed entries and the header */
+static int
+do_commit(struct rldb_file_cnts *cs)
+{
+  struct runlog_state *rls = cs->rl_state;
+  int i, j, first, retval = 0;
+  time_t cur_time;
+
+  if (cs->run_fd < 0) return 0;
+
+  if (cs->dirty_u > 0) {
+    qsort(cs->dirty_runs, cs->dirty_u, sizeof(cs->dirty_runs[0]),
+          int_sort_func);
+    for (i = 0; i < cs->dirty_u; i = j) {
+      first = cs->dirty_runs[i];
+      for (j = i + 1; j < cs->dirty_u && cs->dirty_runs[j] == first + j - i;
+           ++j);
+      // the runs might be removed after they were changed
+      if (first >= rls->run_u) break;
+      if (first + j - i > rls->run_u) j = i + rls->run_u - first;
+      if (do_pwrite(cs->run_fd, &rls->runs[first],
+                    (j - i) * sizeof(rls->runs[0]),
+                    sizeof(rls->head) + first * sizeof(rls->runs[0])) < 0)
+        retval = -1;
+    }
+    for (i = 0; i < cs->dirty_u; ++i)
+      cs->dirty_map[cs->dirty_runs[i]] = 0;
+    cs->dirty_u = 0;
+    cs->unsynced = 1;
+  }
+  if (cs->header_dirty) {
+    if (do_pwrite(cs->run_fd, &rls->head, sizeof(rls->head), 0) < 0)
+      retval = -1;
+    cs->header_dirty = 0;
+    cs->unsynced = 1;
+  }
+
+  if (!cs->unsynced) return retval;
+  switch (cs->plugin_state->sync_mode) {
+  case SYNC_ALWAYS:
+  case SYNC_BATCH:
+    if (do_sync(cs, 0) < 0) retval = -1;
+    break;
+  case SYNC_INTERVAL:
+    cur_time = time(0);
+    if (cur_time - cs->last_sync_time >= cs->plugin_state->sync_interval
+        && do_sync(cs, cur_time) < 0)
+      retval = -1;
+    break;
+  }
+  return retval;
+}
+
+static int
+commit_func(struct rldb_plugin_cnts *cdata)
+{
+  return do_commit((struct rldb_file_cnts*) cdata);
+}
+
 static int
 do_flush_entry(struct rldb_file_cnts *cs, int num)
 {
@@ -1123,13 +1310,36 @@ do_flush_entry(struct rldb_file_cnts *cs, int num)
 
   if (cs->run_fd < 0) ERR_R("invalid descriptor %d", cs->run_fd);
   if (num < 0 || num >= rls->run_u) ERR_R("invalid entry number %d", num);
-  if (sf_lseek(cs->run_fd, sizeof(rls->head) + sizeof(rls->runs[0]) * num,
-               SEEK_SET, "run") == (off_t) -1) return -1;
-  if (do_write(cs->run_fd, &rls->runs[num], sizeof(rls->runs[0])) < 0)
+
+  if (num >= cs->dirty_map_a) {
+    int new_a = cs->dirty_map_a;
+    if (!new_a) new_a = 128;
+    while (num >= new_a) new_a *= 2;
+    XREALLOC(cs->dirty_map, new_a);
+    memset(cs->dirty_map + cs->dirty_map_a, 0, new_a - cs->dirty_map_a);
+    cs->dirty_map_a = new_a;
+  }
+  if (!cs->dirty_map[num]) {
+    if (cs->dirty_u == cs->dirty_a) {
+      if (!(cs->dirty_a *= 2)) cs->dirty_a = 64;
+      XREALLOC(cs->dirty_runs, cs->dirty_a);
+    }
+    cs->dirty_runs[cs->dirty_u++] = num;
+    cs->dirty_map[num] = 1;
+  }
+  if (cs->plugin_state->sync_mode == SYNC_ALWAYS && do_commit(cs) < 0)
     return -1;
   return num;
 }
 
+static int
+mark_header_dirty(struct rldb_file_cnts *cs)
+{
+  cs->header_dirty = 1;
+  if (cs->plugin_state->sync_mode == SYNC_ALWAYS) return do_commit(cs);
+  return 0;
+}
+
 static int
 add_entry_func(
         struct rldb_plugin_cnts *cdata,
@@ -1239,7 +1449,9 @@ add_entry_func(
     de->store_flags = re->store_flags;
   }
 
-  return do_flush_entry(cs, run_id);
+  if (do_flush_entry(cs, run_id) < 0) return -1;
+  if (do_commit(cs) < 0) return -1;
+  return run_id;
 }
 
 static int
@@ -1299,7 +1511,7 @@ start_func(
 
   rls->head.start_time = start_time;
   rls->head.sched_time = 0;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
@@ -1311,7 +1523,7 @@ stop_func(
   struct runlog_state *rls = cs->rl_state;
 
   rls->head.stop_time = stop_time;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
@@ -1323,7 +1535,7 @@ set_duration_func(
   struct runlog_state *rls = cs->rl_state;
 
   rls->head.duration = duration;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
@@ -1335,7 +1547,7 @@ schedule_func(
   struct runlog_state *rls = cs->rl_state;
 
   rls->head.sched_time = sched_time;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
@@ -1347,7 +1559,7 @@ set_finish_time_func(
   struct runlog_state *rls = cs->rl_state;
 
   rls->head.finish_time = finish_time;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
@@ -1359,7 +1571,7 @@ save_times_func(struct rldb_plugin_cnts *cdata)
   rls->head.saved_duration = rls->head.duration;
   rls->head.saved_stop_time = rls->head.stop_time;
   rls->head.saved_finish_time = rls->head.finish_time;
-  return run_flush_header(cs);
+  return mark_header_dirty(cs);
 }
 
 static int
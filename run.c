@@ -193,7 +193,9 @@ do_loop(void)
       continue;
     }
 
-    fprintf(stderr, "packet: <<%.*s>>\n", (int) srp_z, srp_b);
+    if (!super_run_in_packet_is_bin(srp_b, srp_z)) {
+      fprintf(stderr, "packet: <<%.*s>>\n", (int) srp_z, srp_b);
+    }
 
     srp = super_run_in_packet_parse_cfg_str(pkt_name, srp_b, srp_z);
     //xfree(srp_b); srp_b = NULL; srp_z = 0;
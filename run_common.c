@@ -2299,6 +2299,8 @@ run_one_test(
   task_SetPathAsArg0(tsk);
   task_SetWorkingDir(tsk, working_dir);
   if (srpp->enable_process_group > 0) task_EnableProcessGroup(tsk);
+  // no effect, unless the cgroup root is configured for this host
+  task_EnableCgroup(tsk);
 
   if (interactor_cmd) {
     task_SetRedir(tsk, 0, TSR_DUP, pfd2[0]);
@@ -2547,6 +2549,10 @@ run_one_test(
   cur_info->real_time = task_GetRealTime(tsk);
   cur_info->max_memory_used = task_GetMemoryUsed(tsk);
   if (cur_info->max_memory_used > 0) *p_has_max_memory_used = 1;
+  // it is not the VM size, so it is not mixed with max_memory_used
+  if (task_GetCgroupMemoryPeak(tsk) > 0)
+    info("test %d: cgroup memory.peak %lld", cur_test,
+         task_GetCgroupMemoryPeak(tsk));
 
   // input file
   file_size = -1;
@@ -0,0 +1,881 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "run_pack.h"
+#include "errlog.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_logger.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define INDEX_NAME "index"
+#define INDEX_TMP_NAME "index.tmp"
+
+/* the copies are synced in parts, so no compaction step
+   has to sync a whole segment */
+#define COMPACT_SYNC_SIZE (4 * 1024 * 1024)
+
+struct run_pack_entry
+{
+  ruint32_t run_uuid[4];
+  int type;
+  int flags;
+  int segment;
+  ruint32_t size;
+  ruint32_t raw_size;
+  long long offset;
+  int next;                     /* the hash chain */
+};
+
+struct run_pack_state
+{
+  unsigned char *dir;
+  int write_flag;
+  long long max_segment_size;
+
+  int index_fd;
+
+  /* the file descriptors of the segments, indexed by the number */
+  int seg_a;
+  int *seg_fds;
+  int first_segment;            /* 0, if there are no segments */
+  int cur_segment;              /* the segment being appended to */
+  long long cur_offset;         /* the end of the current segment */
+
+  int entry_u, entry_a;
+  struct run_pack_entry *entries;
+  int hash_size;                /* a power of 2 */
+  int *hash;
+
+  int live_count;
+  long long live_size;
+
+  /* the incremental compaction, the segments up to compact_last
+     are cleaned, the entries before compact_pos are already checked
+     for the segment first_segment */
+  int compacting;
+  int compact_last;
+  int compact_pos;
+  long long compact_unsynced;   /* copied since the last sync */
+};
+
+static long long
+record_size(ruint32_t size)
+{
+  return sizeof(struct run_pack_record) + ((size + 7) & ~7U);
+}
+
+static unsigned
+hash_key(const ruint32_t run_uuid[4], int type)
+{
+  unsigned h = run_uuid[0] ^ (run_uuid[1] * 31U) ^ (run_uuid[2] * 131U)
+    ^ (run_uuid[3] * 1031U) ^ (type * 2654435761U);
+  return h ^ (h >> 16);
+}
+
+static int
+full_pwrite(int fd, const void *buf, size_t size, long long offset)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  ssize_t w;
+
+  while (size > 0) {
+    if ((w = pwrite(fd, p, size, offset)) <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += w; size -= w; offset += w;
+  }
+  return 0;
+}
+
+static int
+full_pread(int fd, void *buf, size_t size, long long offset)
+{
+  unsigned char *p = (unsigned char *) buf;
+  ssize_t r;
+
+  while (size > 0) {
+    if ((r = pread(fd, p, size, offset)) <= 0) {
+      if (r < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += r; size -= r; offset += r;
+  }
+  return 0;
+}
+
+static int
+full_write(int fd, const void *buf, size_t size)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  ssize_t w;
+
+  while (size > 0) {
+    if ((w = write(fd, p, size)) <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += w; size -= w;
+  }
+  return 0;
+}
+
+static void
+make_segment_path(
+        const struct run_pack_state *rp,
+        unsigned char *path,
+        size_t size,
+        int segment)
+{
+  snprintf(path, size, "%s/%06d.seg", rp->dir, segment);
+}
+
+static int
+get_segment_fd(struct run_pack_state *rp, int segment)
+{
+  unsigned char path[PATH_MAX];
+  int new_a, flags = O_RDONLY;
+
+  if (segment <= 0) return -1;
+  if (segment >= rp->seg_a) {
+    new_a = rp->seg_a;
+    if (!new_a) new_a = 16;
+    while (segment >= new_a) new_a *= 2;
+    XREALLOC(rp->seg_fds, new_a);
+    memset(rp->seg_fds + rp->seg_a, -1, (new_a - rp->seg_a) * sizeof(int));
+    rp->seg_a = new_a;
+  }
+  if (rp->seg_fds[segment] >= 0) return rp->seg_fds[segment];
+
+  make_segment_path(rp, path, sizeof(path), segment);
+  if (rp->write_flag && segment == rp->cur_segment)
+    flags = O_RDWR | O_CREAT;
+  if ((rp->seg_fds[segment] = open(path, flags, 0666)) < 0) {
+    int saved_errno = errno;
+    err("run_pack: cannot open %s: %s", path, os_ErrorMsg());
+    errno = saved_errno;
+    return -1;
+  }
+  return rp->seg_fds[segment];
+}
+
+static void
+close_segment(struct run_pack_state *rp, int segment)
+{
+  if (segment > 0 && segment < rp->seg_a && rp->seg_fds[segment] >= 0) {
+    close(rp->seg_fds[segment]);
+    rp->seg_fds[segment] = -1;
+  }
+}
+
+static int
+find_entry(
+        const struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type)
+{
+  int i;
+
+  if (!rp->hash_size) return -1;
+  i = rp->hash[hash_key(run_uuid, type) & (rp->hash_size - 1)];
+  for (; i >= 0; i = rp->entries[i].next) {
+    if (rp->entries[i].type == type
+        && !memcmp(rp->entries[i].run_uuid, run_uuid, 16))
+      return i;
+  }
+  return -1;
+}
+
+static void
+rehash(struct run_pack_state *rp, int new_size)
+{
+  int i, k;
+
+  xfree(rp->hash);
+  rp->hash_size = new_size;
+  XCALLOC(rp->hash, new_size);
+  memset(rp->hash, -1, new_size * sizeof(rp->hash[0]));
+  for (i = 0; i < rp->entry_u; ++i) {
+    k = hash_key(rp->entries[i].run_uuid, rp->entries[i].type) & (new_size-1);
+    rp->entries[i].next = rp->hash[k];
+    rp->hash[k] = i;
+  }
+}
+
+/* applies the index record to the in-memory index */
+static void
+apply_record(struct run_pack_state *rp, const struct run_pack_index_record *ir)
+{
+  int i, k;
+  struct run_pack_entry *e;
+
+  if ((i = find_entry(rp, ir->run_uuid, ir->type)) >= 0) {
+    e = &rp->entries[i];
+    if (!(e->flags & RUN_PACK_DELETED)) {
+      rp->live_count--;
+      rp->live_size -= record_size(e->size);
+    }
+  } else {
+    if ((ir->flags & RUN_PACK_DELETED)) return;
+    if (rp->entry_u == rp->entry_a) {
+      if (!(rp->entry_a *= 2)) rp->entry_a = 1024;
+      XREALLOC(rp->entries, rp->entry_a);
+    }
+    if (rp->entry_u >= rp->hash_size) {
+      rehash(rp, rp->hash_size?(rp->hash_size * 2):1024);
+    }
+    i = rp->entry_u++;
+    e = &rp->entries[i];
+    memset(e, 0, sizeof(*e));
+    memcpy(e->run_uuid, ir->run_uuid, 16);
+    e->type = ir->type;
+    k = hash_key(e->run_uuid, e->type) & (rp->hash_size - 1);
+    e->next = rp->hash[k];
+    rp->hash[k] = i;
+  }
+
+  e->flags = ir->flags;
+  e->segment = ir->segment;
+  e->size = ir->size;
+  e->raw_size = ir->raw_size;
+  e->offset = ir->offset;
+  if (!(e->flags & RUN_PACK_DELETED)) {
+    rp->live_count++;
+    rp->live_size += record_size(e->size);
+  }
+}
+
+/* scans the records of the segment starting from the offset, the
+   records not yet in the index are added to it, returns the end
+   of the valid data */
+static long long
+scan_segment(struct run_pack_state *rp, int segment, long long offset)
+{
+  int fd;
+  struct stat stb;
+  struct run_pack_record rec;
+  struct run_pack_index_record ir;
+  unsigned char *data = 0;
+  size_t data_a = 0;
+
+  if ((fd = get_segment_fd(rp, segment)) < 0) return -1;
+  if (fstat(fd, &stb) < 0) return -1;
+
+  while (offset + (long long) sizeof(rec) <= stb.st_size) {
+    if (full_pread(fd, &rec, sizeof(rec), offset) < 0) break;
+    if (memcmp(rec.magic, RUN_PACK_RECORD_MAGIC, 4) != 0) break;
+    if (rec.type <= 0 || rec.type >= RUN_PACK_LAST) break;
+    if (offset + record_size(rec.size) > stb.st_size) break;
+    if (rec.size + 1 > data_a) {
+      data_a = rec.size + 1;
+      xfree(data);
+      data = xmalloc(data_a);
+    }
+    if (full_pread(fd, data, rec.size, offset + sizeof(rec)) < 0) break;
+    if (crc32(0, data, rec.size) != rec.crc) break;
+
+    memset(&ir, 0, sizeof(ir));
+    memcpy(ir.run_uuid, rec.run_uuid, 16);
+    ir.type = rec.type;
+    ir.flags = rec.flags;
+    ir.segment = segment;
+    ir.size = rec.size;
+    ir.raw_size = rec.raw_size;
+    ir.offset = offset;
+    apply_record(rp, &ir);
+    if (rp->index_fd >= 0 && rp->write_flag)
+      full_write(rp->index_fd, &ir, sizeof(ir));
+    offset += record_size(rec.size);
+  }
+
+  if (offset < stb.st_size && rp->write_flag) {
+    info("run_pack: segment %d is truncated to %lld", segment, offset);
+    if (ftruncate(fd, offset) < 0) {
+      err("run_pack: ftruncate failed: %s", os_ErrorMsg());
+    }
+  }
+
+  xfree(data);
+  return offset;
+}
+
+static int
+scan_directory(struct run_pack_state *rp, int *p_min, int *p_max)
+{
+  DIR *d;
+  struct dirent *dd;
+  int n, len;
+
+  *p_min = 0; *p_max = 0;
+  if (!(d = opendir(rp->dir))) {
+    err("run_pack: cannot open directory %s: %s", rp->dir, os_ErrorMsg());
+    return -1;
+  }
+  while ((dd = readdir(d))) {
+    if (sscanf(dd->d_name, "%d%n", &n, &len) != 1 || n <= 0) continue;
+    if (strcmp(dd->d_name + len, ".seg") != 0) continue;
+    if (!*p_min || n < *p_min) *p_min = n;
+    if (n > *p_max) *p_max = n;
+  }
+  closedir(d);
+  return 0;
+}
+
+/* reads the index file, returns the end of the indexed data in the
+   last segment */
+static long long
+read_index(struct run_pack_state *rp, int last_segment)
+{
+  struct run_pack_index_record buf[256];
+  ssize_t r;
+  size_t have = 0;
+  long long total = 0, last_end = 0, end;
+  int i, count;
+
+  while (1) {
+    r = read(rp->index_fd, (unsigned char *) buf + have, sizeof(buf) - have);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) break;
+    have += r;
+    count = have / sizeof(buf[0]);
+    for (i = 0; i < count; ++i) {
+      if (buf[i].type <= 0 || buf[i].type >= RUN_PACK_LAST) continue;
+      apply_record(rp, &buf[i]);
+      if ((int) buf[i].segment == last_segment) {
+        end = buf[i].offset + record_size(buf[i].size);
+        if (end > last_end) last_end = end;
+      }
+    }
+    total += count * sizeof(buf[0]);
+    have -= count * sizeof(buf[0]);
+    memmove(buf, (unsigned char *) buf + count * sizeof(buf[0]), have);
+  }
+
+  // a partially written record is dropped
+  if (have > 0 && rp->write_flag) {
+    if (ftruncate(rp->index_fd, total) < 0) {
+      err("run_pack: ftruncate failed: %s", os_ErrorMsg());
+    }
+  }
+  return last_end;
+}
+
+struct run_pack_state *
+run_pack_open(const unsigned char *dir, int write_flag)
+{
+  struct run_pack_state *rp;
+  unsigned char path[PATH_MAX];
+  int min_seg, max_seg, seg, flags, retry_count = 0;
+  long long start;
+  struct stat stb;
+
+  if (write_flag && mkdir(dir, 0777) < 0 && errno != EEXIST) {
+    err("run_pack: cannot create %s: %s", dir, os_ErrorMsg());
+    return 0;
+  }
+
+ restart:
+  start = 0;
+  XCALLOC(rp, 1);
+  rp->dir = xstrdup(dir);
+  rp->write_flag = write_flag;
+  rp->max_segment_size = RUN_PACK_DEFAULT_SEGMENT_SIZE;
+  rp->index_fd = -1;
+
+  if (scan_directory(rp, &min_seg, &max_seg) < 0) goto fail;
+  rp->first_segment = min_seg;
+  rp->cur_segment = max_seg;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, INDEX_NAME);
+  flags = O_RDONLY;
+  if (write_flag) flags = O_RDWR | O_CREAT | O_APPEND;
+  if ((rp->index_fd = open(path, flags, 0666)) < 0 && errno != ENOENT) {
+    err("run_pack: cannot open %s: %s", path, os_ErrorMsg());
+    goto fail;
+  }
+
+  if (rp->index_fd >= 0 && fstat(rp->index_fd, &stb) >= 0 && stb.st_size > 0) {
+    start = read_index(rp, max_seg);
+  } else if (min_seg > 0) {
+    // no index, rebuild it from the segments
+    info("run_pack: rebuilding the index of %s", dir);
+    for (seg = min_seg; seg < max_seg; ++seg) {
+      scan_segment(rp, seg, 0);
+      close_segment(rp, seg);
+    }
+    start = 0;
+  }
+
+  // the records appended after the last index update
+  if (max_seg > 0) {
+    if ((rp->cur_offset = scan_segment(rp, max_seg, start)) < 0) goto fail;
+  } else {
+    rp->cur_segment = 1;
+    rp->cur_offset = 0;
+  }
+
+  // a reader keeps all the segments open, so the segments removed by
+  // the compaction of the writer remain readable for it
+  if (!write_flag && min_seg > 0) {
+    for (seg = min_seg; seg <= max_seg; ++seg) {
+      if (get_segment_fd(rp, seg) < 0) {
+        // the segment is removed after the directory scan
+        if (errno == ENOENT && retry_count < 3) {
+          rp = run_pack_close(rp);
+          ++retry_count;
+          goto restart;
+        }
+        goto fail;
+      }
+    }
+  }
+  return rp;
+
+ fail:
+  run_pack_close(rp);
+  return 0;
+}
+
+struct run_pack_state *
+run_pack_close(struct run_pack_state *rp)
+{
+  int i;
+
+  if (!rp) return 0;
+  for (i = 0; i < rp->seg_a; ++i)
+    if (rp->seg_fds[i] >= 0) close(rp->seg_fds[i]);
+  if (rp->index_fd >= 0) close(rp->index_fd);
+  xfree(rp->seg_fds);
+  xfree(rp->entries);
+  xfree(rp->hash);
+  xfree(rp->dir);
+  xfree(rp);
+  return 0;
+}
+
+int
+run_pack_get(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type,
+        char **p_data,
+        size_t *p_size)
+{
+  int i, fd;
+  const struct run_pack_entry *e;
+  struct run_pack_record rec;
+  unsigned char *data = 0, *out = 0;
+  uLongf out_size;
+
+  if (!rp) return 0;
+  if ((i = find_entry(rp, run_uuid, type)) < 0) return 0;
+  e = &rp->entries[i];
+  if ((e->flags & RUN_PACK_DELETED)) return 0;
+
+  if ((fd = get_segment_fd(rp, e->segment)) < 0) return -1;
+  if (full_pread(fd, &rec, sizeof(rec), e->offset) < 0
+      || memcmp(rec.magic, RUN_PACK_RECORD_MAGIC, 4) != 0
+      || (int) rec.type != type || memcmp(rec.run_uuid, run_uuid, 16) != 0
+      || rec.size != e->size) {
+    err("run_pack: invalid record at %d:%lld", e->segment, e->offset);
+    return -1;
+  }
+  data = xmalloc(rec.size + 1);
+  if (full_pread(fd, data, rec.size, e->offset + sizeof(rec)) < 0
+      || crc32(0, data, rec.size) != rec.crc) {
+    err("run_pack: corrupted data at %d:%lld", e->segment, e->offset);
+    xfree(data);
+    return -1;
+  }
+
+  if ((rec.flags & RUN_PACK_ZLIB)) {
+    out = xmalloc(rec.raw_size + 1);
+    out_size = rec.raw_size;
+    if (uncompress(out, &out_size, data, rec.size) != Z_OK
+        || out_size != rec.raw_size) {
+      err("run_pack: decompression failed at %d:%lld", e->segment, e->offset);
+      xfree(out);
+      xfree(data);
+      return -1;
+    }
+    xfree(data);
+    data = out;
+  }
+
+  data[rec.raw_size] = 0;
+  *p_data = (char *) data;
+  if (p_size) *p_size = rec.raw_size;
+  return 1;
+}
+
+int
+run_pack_exists(
+        const struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type)
+{
+  int i;
+
+  if (!rp || (i = find_entry(rp, run_uuid, type)) < 0) return 0;
+  return !(rp->entries[i].flags & RUN_PACK_DELETED);
+}
+
+static int
+append_record(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type,
+        int flags,
+        const unsigned char *data,
+        size_t size,
+        size_t raw_size)
+{
+  static const unsigned char zeros[8];
+  struct run_pack_record rec;
+  struct run_pack_index_record ir;
+  long long rsize = record_size(size);
+  int fd;
+
+  if (!rp->write_flag) return -1;
+
+  if (rp->cur_offset > 0 && rp->cur_offset + rsize > rp->max_segment_size) {
+    run_pack_sync(rp);
+    close_segment(rp, rp->cur_segment);
+    rp->cur_segment++;
+    rp->cur_offset = 0;
+  }
+  if ((fd = get_segment_fd(rp, rp->cur_segment)) < 0) return -1;
+  if (!rp->first_segment) rp->first_segment = rp->cur_segment;
+
+  memset(&rec, 0, sizeof(rec));
+  memcpy(rec.magic, RUN_PACK_RECORD_MAGIC, 4);
+  rec.type = type;
+  memcpy(rec.run_uuid, run_uuid, 16);
+  rec.flags = flags;
+  rec.size = size;
+  rec.raw_size = raw_size;
+  rec.crc = crc32(0, data, size);
+
+  if (full_pwrite(fd, &rec, sizeof(rec), rp->cur_offset) < 0
+      || full_pwrite(fd, data, size, rp->cur_offset + sizeof(rec)) < 0
+      || full_pwrite(fd, zeros, rsize - sizeof(rec) - size,
+                     rp->cur_offset + sizeof(rec) + size) < 0) {
+    err("run_pack: write to segment %d failed: %s", rp->cur_segment,
+        os_ErrorMsg());
+    return -1;
+  }
+
+  memset(&ir, 0, sizeof(ir));
+  memcpy(ir.run_uuid, run_uuid, 16);
+  ir.type = type;
+  ir.flags = flags;
+  ir.segment = rp->cur_segment;
+  ir.size = size;
+  ir.raw_size = raw_size;
+  ir.offset = rp->cur_offset;
+  // the segment is authoritative, a lost index record is recovered
+  // by scanning the segment tail on the next open
+  if (full_write(rp->index_fd, &ir, sizeof(ir)) < 0) {
+    err("run_pack: write to the index failed: %s", os_ErrorMsg());
+  }
+  apply_record(rp, &ir);
+  rp->cur_offset += rsize;
+  return 0;
+}
+
+int
+run_pack_put(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type,
+        const unsigned char *data,
+        size_t size,
+        int compress_flag)
+{
+  unsigned char *zdata = 0;
+  uLongf zsize;
+  int r, flags = 0;
+
+  if (!rp || type <= 0 || type >= RUN_PACK_LAST) return -1;
+  if (size > UINT_MAX / 2) return -1;
+
+  if (compress_flag && size > 0) {
+    zsize = compressBound(size);
+    zdata = xmalloc(zsize);
+    if (compress2(zdata, &zsize, data, size, 6) == Z_OK && zsize < size) {
+      flags |= RUN_PACK_ZLIB;
+    } else {
+      xfree(zdata); zdata = 0;
+    }
+  }
+
+  if (zdata) {
+    r = append_record(rp, run_uuid, type, flags, zdata, zsize, size);
+  } else {
+    r = append_record(rp, run_uuid, type, flags, data, size, size);
+  }
+  xfree(zdata);
+  return r;
+}
+
+int
+run_pack_remove(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type)
+{
+  int i;
+
+  if (!rp) return 0;
+  if (!type) {
+    for (type = 1; type < RUN_PACK_LAST; ++type)
+      if (run_pack_remove(rp, run_uuid, type) < 0)
+        return -1;
+    return 0;
+  }
+
+  if ((i = find_entry(rp, run_uuid, type)) < 0) return 0;
+  if ((rp->entries[i].flags & RUN_PACK_DELETED)) return 0;
+  return append_record(rp, run_uuid, type, RUN_PACK_DELETED, 0, 0, 0);
+}
+
+int
+run_pack_sync(struct run_pack_state *rp)
+{
+  int r = 0;
+
+  if (!rp || !rp->write_flag) return 0;
+  if (rp->cur_segment < rp->seg_a && rp->seg_fds[rp->cur_segment] >= 0
+      && fdatasync(rp->seg_fds[rp->cur_segment]) < 0)
+    r = -1;
+  if (rp->index_fd >= 0 && fdatasync(rp->index_fd) < 0)
+    r = -1;
+  if (r < 0) err("run_pack: sync failed: %s", os_ErrorMsg());
+  return r;
+}
+
+/* writes the index of the live entries and replaces the index file */
+static int
+rewrite_index(struct run_pack_state *rp)
+{
+  unsigned char path[PATH_MAX], tmp_path[PATH_MAX];
+  struct run_pack_index_record ir;
+  const struct run_pack_entry *e;
+  int i, j, tmp_fd;
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s/%s", rp->dir, INDEX_TMP_NAME);
+  if ((tmp_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+    err("run_pack: cannot create %s: %s", tmp_path, os_ErrorMsg());
+    return -1;
+  }
+  for (i = 0; i < rp->entry_u; ++i) {
+    e = &rp->entries[i];
+    if ((e->flags & RUN_PACK_DELETED)) continue;
+    memset(&ir, 0, sizeof(ir));
+    memcpy(ir.run_uuid, e->run_uuid, 16);
+    ir.type = e->type;
+    ir.flags = e->flags;
+    ir.segment = e->segment;
+    ir.size = e->size;
+    ir.raw_size = e->raw_size;
+    ir.offset = e->offset;
+    if (full_write(tmp_fd, &ir, sizeof(ir)) < 0) goto io_fail;
+  }
+  if (fdatasync(tmp_fd) < 0) goto io_fail;
+  close(tmp_fd); tmp_fd = -1;
+  snprintf(path, sizeof(path), "%s/%s", rp->dir, INDEX_NAME);
+  if (rename(tmp_path, path) < 0) goto io_fail;
+  close(rp->index_fd);
+  if ((rp->index_fd = open(path, O_RDWR | O_APPEND, 0666)) < 0) {
+    err("run_pack: cannot reopen %s: %s", path, os_ErrorMsg());
+  }
+
+  // the deleted entries are not in the index anymore
+  for (i = 0, j = 0; i < rp->entry_u; ++i) {
+    if ((rp->entries[i].flags & RUN_PACK_DELETED)) continue;
+    rp->entries[j++] = rp->entries[i];
+  }
+  rp->entry_u = j;
+  if (rp->hash_size > 0) rehash(rp, rp->hash_size);
+  return 0;
+
+ io_fail:
+  err("run_pack: index rewrite failed: %s", os_ErrorMsg());
+  if (tmp_fd >= 0) close(tmp_fd);
+  unlink(tmp_path);
+  return -1;
+}
+
+int
+run_pack_compact_start(struct run_pack_state *rp)
+{
+  if (!rp || !rp->write_flag) return -1;
+  if (rp->compacting) return 1;
+  if (!rp->first_segment) return 0;
+
+  // the current segment is closed, so it is compacted too
+  if (rp->cur_offset > 0) {
+    run_pack_sync(rp);
+    close_segment(rp, rp->cur_segment);
+    rp->cur_segment++;
+    rp->cur_offset = 0;
+  }
+  rp->compacting = 1;
+  rp->compact_last = rp->cur_segment - 1;
+  rp->compact_pos = 0;
+  rp->compact_unsynced = 0;
+  return 1;
+}
+
+int
+run_pack_is_compacting(const struct run_pack_state *rp)
+{
+  return rp && rp->compacting;
+}
+
+/* moves the live records of the oldest segment to the current one,
+   when the segment has no more live records, it is removed */
+int
+run_pack_compact_step(struct run_pack_state *rp, int *p_count, int max_count)
+{
+  unsigned char path[PATH_MAX];
+  struct run_pack_entry *e;
+  struct run_pack_record rec;
+  unsigned char *data = 0;
+  size_t data_a = 0;
+  int seg, fd, scanned = 0;
+
+  if (!rp || !rp->write_flag || !rp->compacting) return 0;
+
+  while (*p_count < max_count) {
+    seg = rp->first_segment;
+    if (seg <= 0 || seg > rp->compact_last) {
+      // all the old segments are removed
+      rp->compacting = 0;
+      if (run_pack_sync(rp) < 0 || rewrite_index(rp) < 0) goto fail;
+      xfree(data);
+      return 0;
+    }
+
+    for (; rp->compact_pos < rp->entry_u && *p_count < max_count;
+         ++rp->compact_pos) {
+      e = &rp->entries[rp->compact_pos];
+      // checking the entries of the other segments is cheap
+      if (++scanned >= 1024) {
+        ++(*p_count);
+        scanned = 0;
+      }
+      if (e->segment != seg || (e->flags & RUN_PACK_DELETED)) continue;
+
+      if ((fd = get_segment_fd(rp, seg)) < 0) goto fail;
+      if (e->size + 1 > data_a) {
+        data_a = e->size + 1;
+        xfree(data);
+        data = xmalloc(data_a);
+      }
+      if (full_pread(fd, &rec, sizeof(rec), e->offset) < 0
+          || memcmp(rec.magic, RUN_PACK_RECORD_MAGIC, 4) != 0
+          || rec.size != e->size
+          || full_pread(fd, data, e->size, e->offset + sizeof(rec)) < 0) {
+        err("run_pack: invalid record at %d:%lld", seg, e->offset);
+        goto fail;
+      }
+      // the entry is updated to the new location
+      if (append_record(rp, rec.run_uuid, rec.type, rec.flags, data,
+                        rec.size, rec.raw_size) < 0)
+        goto fail;
+      ++(*p_count);
+      rp->compact_unsynced += record_size(rec.size);
+      if (rp->compact_unsynced >= COMPACT_SYNC_SIZE) {
+        if (run_pack_sync(rp) < 0) goto fail;
+        rp->compact_unsynced = 0;
+      }
+    }
+    if (rp->compact_pos < rp->entry_u) break;
+
+    // the copies must be on the disk before the segment is removed
+    if (run_pack_sync(rp) < 0) goto fail;
+    close_segment(rp, seg);
+    make_segment_path(rp, path, sizeof(path), seg);
+    if (unlink(path) < 0 && errno != ENOENT) {
+      err("run_pack: cannot remove %s: %s", path, os_ErrorMsg());
+      goto fail;
+    }
+    rp->first_segment = seg + 1;
+    rp->compact_pos = 0;
+  }
+
+  xfree(data);
+  return 1;
+
+ fail:
+  rp->compacting = 0;
+  xfree(data);
+  return -1;
+}
+
+int
+run_pack_compact(struct run_pack_state *rp)
+{
+  int count, r;
+
+  if ((r = run_pack_compact_start(rp)) <= 0) return r;
+  do {
+    count = 0;
+  } while ((r = run_pack_compact_step(rp, &count, INT_MAX)) > 0);
+  return r;
+}
+
+void
+run_pack_get_stats(struct run_pack_state *rp, struct run_pack_stats *ps)
+{
+  unsigned char path[PATH_MAX];
+  struct stat stb;
+  int i;
+
+  memset(ps, 0, sizeof(*ps));
+  if (!rp) return;
+  ps->entry_count = rp->live_count;
+  ps->live_size = rp->live_size;
+  if (!rp->first_segment) return;
+  for (i = rp->first_segment; i <= rp->cur_segment; ++i) {
+    make_segment_path(rp, path, sizeof(path), i);
+    if (stat(path, &stb) < 0) continue;
+    ps->segment_count++;
+    ps->total_size += stb.st_size;
+  }
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
@@ -0,0 +1,155 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __RUN_PACK_H__
+#define __RUN_PACK_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "ej_types.h"
+
+#include <stdlib.h>
+
+/*
+ * The pack store keeps the per-run artifacts (sources, reports, audit
+ * logs) of the runs with the uuid storage in a few large append-only
+ * segment files instead of one file per artifact. The directory
+ * contains the segments NNNNNN.seg and the index file, which is the
+ * log of all the records added to the segments, so the store is
+ * opened without scanning the segments. A replaced or removed
+ * artifact leaves garbage in the segments, which is reclaimed by the
+ * compaction.
+ *
+ * The store assumes a single writing process (the contest server),
+ * other processes may open it for reading. A reader opens all the
+ * segments at once, so the segments removed by the compaction while
+ * the reader is open remain readable for it.
+ */
+
+/* artifact types */
+enum
+{
+  RUN_PACK_SOURCE = 1,
+  RUN_PACK_REPORT,
+  RUN_PACK_XML_REPORT,
+  RUN_PACK_AUDIT,
+
+  RUN_PACK_LAST
+};
+
+/* record flags */
+enum
+{
+  RUN_PACK_ZLIB = 1,            /* the data is compressed with zlib */
+  RUN_PACK_DELETED = 2,         /* the record removes the artifact */
+};
+
+#define RUN_PACK_RECORD_MAGIC "EjPR"
+
+/* the record header in a segment file, followed by the data padded
+   to the 8 byte boundary, the structure size is 40 bytes */
+struct run_pack_record
+{
+  unsigned char magic[4];
+  ruint32_t type;
+  ruint32_t run_uuid[4];
+  ruint32_t flags;
+  ruint32_t size;               /* the stored size */
+  ruint32_t raw_size;           /* the uncompressed size */
+  ruint32_t crc;                /* crc32 of the stored data */
+};
+
+/* the index file record, the structure size is 48 bytes */
+struct run_pack_index_record
+{
+  ruint32_t run_uuid[4];
+  ruint32_t type;
+  ruint32_t flags;
+  ruint32_t segment;
+  ruint32_t size;
+  ruint32_t raw_size;
+  ruint32_t _pad;
+  long long offset;             /* the offset of the record header */
+};
+
+struct run_pack_stats
+{
+  int segment_count;
+  int entry_count;              /* the live artifacts */
+  long long live_size;          /* the size of the live records */
+  long long total_size;         /* the size of all the segments */
+};
+
+struct run_pack_state;
+
+enum { RUN_PACK_DEFAULT_SEGMENT_SIZE = 256 * 1024 * 1024 };
+
+struct run_pack_state *
+run_pack_open(const unsigned char *dir, int write_flag);
+struct run_pack_state *run_pack_close(struct run_pack_state *rp);
+
+/* returns 1, if the artifact is found, 0, if not, -1 on error,
+   the data is allocated with xmalloc and \0-terminated */
+int
+run_pack_get(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type,
+        char **p_data,
+        size_t *p_size);
+
+/* checks that the artifact is present without reading it */
+int
+run_pack_exists(
+        const struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type);
+
+/* adds or replaces the artifact */
+int
+run_pack_put(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type,
+        const unsigned char *data,
+        size_t size,
+        int compress_flag);
+
+/* removes the artifact, or all the artifacts of the run, if type is 0 */
+int
+run_pack_remove(
+        struct run_pack_state *rp,
+        const ruint32_t run_uuid[4],
+        int type);
+
+/* flushes the segment and the index to the disk */
+int run_pack_sync(struct run_pack_state *rp);
+
+/* the compaction copies the live records of the old segments to the
+   current one and removes the old segments one by one, so it may be
+   done in small steps between the other operations on the store.
+   run_pack_compact_start returns 1, if the compaction is started,
+   run_pack_compact_step returns 1, if there is more work to do, 0,
+   if the compaction is complete, -1 on error */
+int run_pack_compact_start(struct run_pack_state *rp);
+int
+run_pack_compact_step(struct run_pack_state *rp, int *p_count, int max_count);
+int run_pack_is_compacting(const struct run_pack_state *rp);
+
+/* does the whole compaction at once */
+int run_pack_compact(struct run_pack_state *rp);
+
+void run_pack_get_stats(struct run_pack_state *rp, struct run_pack_stats *ps);
+
+#endif /* __RUN_PACK_H__ */
@@ -104,6 +104,15 @@ static void extend_run_extras(runlog_state_t state);
 static void run_drop_uuid_hash(runlog_state_t state);
 static int find_free_uuid_hash_index(runlog_state_t state, ruint32_t *uuid);
 
+/* records the modification of the run, run_id < 0 means that any run
+   may be changed */
+static void
+note_change(runlog_state_t state, int run_id)
+{
+  state->change_serial++;
+  state->change_log[state->change_serial % RUNLOG_CHANGE_LOG_SIZE] = run_id;
+}
+
 runlog_state_t
 run_init(teamdb_state_t ts)
 {
@@ -156,6 +165,7 @@ run_set_runlog(
   if (runlog_check(0, &state->head, total_entries, entries) < 0)
     return -1;
 
+  note_change(state, -1);
   if (state->iface->set_runlog(state->cnts, total_entries, entries) < 0)
     return -1;
 
@@ -300,6 +310,13 @@ runlog_flush(runlog_state_t state)
   return state->iface->flush(state->cnts);
 }
 
+int
+runlog_commit(runlog_state_t state)
+{
+  if (!state->iface || !state->iface->commit) return 0;
+  return state->iface->commit(state->cnts);
+}
+
 int
 run_add_record(
         runlog_state_t state,
@@ -467,6 +484,8 @@ run_add_record(
   }
   state->user_count = -1;
 
+  // the runs after the inserted one are shifted
+  note_change(state, i < state->run_u - 1 ? -1 : i);
   if (state->iface->add_entry(state->cnts, i, &re, flags) < 0) return -1;
 
   // updating user_id index
@@ -530,6 +549,7 @@ run_undo_add_record(runlog_state_t state, int run_id)
     state->uuid_hash_last_added_run_id = -1;
     state->uuid_hash_last_added_index = -1;
   }
+  note_change(state, run_id);
   return state->iface->undo_add_entry(state->cnts, run_id);
 }
 
@@ -563,6 +583,7 @@ run_change_status(
   if (state->runs[runid].is_readonly)
     ERR_R("this entry is read-only");
 
+  note_change(state, runid);
   return state->iface->change_status(state->cnts, runid, newstatus, newtest,
                                      newpassedmode, newscore, judge_id);
 }
@@ -598,6 +619,7 @@ run_change_status_2(
   if (state->runs[runid].is_readonly)
     ERR_R("this entry is read-only");
 
+  note_change(state, runid);
   return state->iface->change_status_2(state->cnts, runid, newstatus, newtest,
                                        newpassedmode, newscore, judge_id, is_marked);
 }
@@ -637,6 +659,7 @@ run_change_status_3(
   if (state->runs[runid].is_readonly)
     ERR_R("this entry is read-only");
 
+  note_change(state, runid);
   return state->iface->change_status_3(state->cnts, runid, newstatus, newtest,
                                        newpassedmode, newscore, judge_id, is_marked,
                                        has_user_score, user_status,
@@ -664,6 +687,7 @@ run_change_status_4(
   if (state->runs[runid].is_readonly)
     ERR_R("this entry is read-only");
 
+  note_change(state, runid);
   return state->iface->change_status_4(state->cnts, runid, newstatus);
 }
 
@@ -685,12 +709,14 @@ int
 run_start_contest(runlog_state_t state, time_t start_time)
 {
   if (state->head.start_time) ERR_R("Contest already started");
+  note_change(state, -1);
   return state->iface->start(state->cnts, start_time);
 }
 
 int
 run_stop_contest(runlog_state_t state, time_t stop_time)
 {
+  note_change(state, -1);
   return state->iface->stop(state->cnts, stop_time);
 }
 
@@ -1012,6 +1038,7 @@ run_reset(
 
   run_drop_uuid_hash(state);
 
+  note_change(state, -1);
   return state->iface->reset(state->cnts, init_duration, init_sched_time,
                              init_finish_time);
 }
@@ -1053,6 +1080,7 @@ run_check_duplicate(runlog_state_t state, int run_id)
   ASSERT(i >= -1);
 
   if (i < 0) return 0;
+  note_change(state, run_id);
   if (state->iface->set_status(state->cnts, run_id, RUN_IGNORED) < 0)
     return -1;
   return i + 1;
@@ -1432,6 +1460,7 @@ run_set_entry(
   if (!f) return 0;
 
   if (!te.is_hidden && !ue->status) ue->status = V_REAL_USER;
+  note_change(state, run_id);
   if (state->iface->set_entry(state->cnts, run_id, &te, mask) < 0) return -1;
   if (state->runs[run_id].user_id != old_user_id) {
     if ((ue = try_user_entry(state, old_user_id))) {
@@ -1649,6 +1678,8 @@ run_virtual_start(
   }
   state->user_count = -1;
 
+  // the runs after the inserted one are shifted
+  note_change(state, i < state->run_u - 1 ? -1 : i);
   if ((i = state->iface->add_entry(state->cnts, i, &re, RE_USER_ID | RE_IP | RE_SSL_FLAG | RE_STATUS)) < 0) return -1;
   struct user_entry *ue = try_user_entry(state, user_id);
   if (ue) ue->run_id_valid = 0;
@@ -1707,6 +1738,8 @@ run_virtual_stop(
   }
   state->user_count = -1;
 
+  // the runs after the inserted one are shifted
+  note_change(state, i < state->run_u - 1 ? -1 : i);
   if ((i = state->iface->add_entry(state->cnts, i, &re, RE_USER_ID | RE_IP | RE_SSL_FLAG | RE_STATUS)) < 0) return -1;
   struct user_entry *ue = try_user_entry(state, user_id);
   if (ue) ue->run_id_valid = 0;
@@ -1768,6 +1801,7 @@ run_clear_entry(runlog_state_t state, int run_id)
   state->max_user_id = -1;
   state->user_count = -1;
 
+  note_change(state, run_id);
   return state->iface->clear_entry(state->cnts, run_id);
 }
 
@@ -1783,6 +1817,7 @@ run_forced_clear_entry(runlog_state_t state, int run_id)
   state->max_user_id = -1;
   state->user_count = -1;
 
+  note_change(state, run_id);
   return state->iface->clear_entry(state->cnts, run_id);
 }
 
@@ -1790,6 +1825,7 @@ int
 run_set_hidden(runlog_state_t state, int run_id)
 {
   if (run_id < 0 || run_id >= state->run_u) ERR_R("bad runid: %d", run_id);
+  note_change(state, run_id);
   return state->iface->set_hidden(state->cnts, run_id, 1);
 }
 
@@ -1828,6 +1864,7 @@ run_has_transient_user_runs(runlog_state_t state, int user_id)
 int
 run_squeeze_log(runlog_state_t state)
 {
+  note_change(state, -1);
   return state->iface->squeeze(state->cnts);
 }
 
@@ -2622,6 +2659,7 @@ run_put_entry(
         runlog_state_t state,
         const struct run_entry *re)
 {
+  note_change(state, re->run_id);
   return state->iface->put_entry(state->cnts, re);
 }
 
@@ -2630,6 +2668,7 @@ run_put_header(
         runlog_state_t state,
         const struct run_header *rh)
 {
+  note_change(state, -1);
   return state->iface->put_header(state->cnts, rh);
 }
 
@@ -2797,6 +2836,31 @@ run_get_user_prev_run_id(runlog_state_t state, int run_id)
   return state->run_extras[run_id].prev_user_id;
 }
 
+int
+run_get_change_serial(runlog_state_t state)
+{
+  return state->change_serial;
+}
+
+int
+run_get_changes(
+        runlog_state_t state,
+        int serial,
+        int max_count,
+        int *run_ids)
+{
+  int count = 0;
+
+  if (serial > state->change_serial) return -1;
+  if (state->change_serial - serial > RUNLOG_CHANGE_LOG_SIZE) return -1;
+  for (++serial; serial <= state->change_serial; ++serial) {
+    if (count >= max_count) return -1;
+    if ((run_ids[count++] = state->change_log[serial % RUNLOG_CHANGE_LOG_SIZE]) < 0)
+      return -1;
+  }
+  return count;
+}
+
 int
 run_get_uuid_hash_state(runlog_state_t state)
 {
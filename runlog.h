@@ -174,6 +174,7 @@ char *run_status_str(int, char *, int, int, int);
 int run_get_fog_period(runlog_state_t, time_t, int, int);
 int run_reset(runlog_state_t, time_t, time_t, time_t);
 int runlog_flush(runlog_state_t);
+int runlog_commit(runlog_state_t);
 
 int run_check_duplicate(runlog_state_t, int run_id);
 int run_find_duplicate(runlog_state_t state,
@@ -422,4 +423,16 @@ int run_get_user_prev_run_id(runlog_state_t state, int run_id);
 int run_get_uuid_hash_state(runlog_state_t state);
 int run_find_run_id_by_uuid(runlog_state_t state, ruint32_t *uuid);
 
+/* the counter of the runlog modifications */
+int run_get_change_serial(runlog_state_t state);
+/* stores the run_ids changed after the modification `serial' to run_ids,
+   returns their number, or -1, if they are not known or there are more
+   than max_count of them */
+int
+run_get_changes(
+        runlog_state_t state,
+        int serial,
+        int max_count,
+        int *run_ids);
+
 #endif /* __RUNLOG_H__ */
@@ -33,7 +33,8 @@
 static void
 rename_archive_files(const serve_state_t state, FILE *flog, int num, int *map)
 {
-  int i;
+  int i, count;
+  int *from, *to;
 
   fprintf(flog, "Rename map:\n");
   for (i = 0; i < num; i++) {
@@ -81,6 +82,18 @@ rename_archive_files(const serve_state_t state, FILE *flog, int num, int *map)
     archive_rename(state, state->global->audit_log_dir, flog,
                    i, "_", map[i], "", 0);
   }
+
+  // the segment store renames all the runs at once
+  from = alloca(num * sizeof(from[0]));
+  to = alloca(num * sizeof(to[0]));
+  for (i = 0, count = 0; i < num; i++) {
+    if (map[i] < 0) continue;
+    if (map[i] == i) continue;
+    from[count] = i;
+    to[count] = map[i];
+    count++;
+  }
+  serve_renumber_audit_log(state, count, from, to);
 }
 
 static int
@@ -0,0 +1,150 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_limits.h"
+
+#include "runlog_reader.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+int
+runlog_reader_open(struct runlog_reader *rr, const unsigned char *path)
+{
+  struct stat stb;
+  void *data;
+  const struct run_header *hdr;
+  int fd, r;
+
+  memset(rr, 0, sizeof(*rr));
+  rr->fd = -1;
+
+  if ((fd = open(path, O_RDONLY, 0)) < 0) return -errno;
+  if (fstat(fd, &stb) < 0) {
+    r = -errno;
+    goto fail;
+  }
+  if (!S_ISREG(stb.st_mode)) {
+    r = -EINVAL;
+    goto fail;
+  }
+  // the text (version 0) runlogs are shorter than the binary header
+  if (stb.st_size < sizeof(struct run_header)
+      || (stb.st_size - sizeof(struct run_header)) % sizeof(struct run_entry)
+      || (off_t) (size_t) stb.st_size != stb.st_size
+      || (stb.st_size - sizeof(struct run_header)) / sizeof(struct run_entry)
+      > EJ_MAX_RUN_ID) {
+    r = -EINVAL;
+    goto fail;
+  }
+  data = mmap(NULL, stb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    r = -errno;
+    goto fail;
+  }
+  hdr = (const struct run_header *) data;
+  if (hdr->version != 2 || hdr->byte_order != 0) {
+    munmap(data, stb.st_size);
+    r = -EINVAL;
+    goto fail;
+  }
+  madvise(data, stb.st_size, MADV_SEQUENTIAL);
+
+  rr->fd = fd;
+  rr->data = (const unsigned char *) data;
+  rr->size = stb.st_size;
+  rr->header = hdr;
+  rr->runs = (const struct run_entry *) (rr->data + sizeof(*hdr));
+  rr->run_count = (stb.st_size - sizeof(*hdr)) / sizeof(struct run_entry);
+  return 0;
+
+fail:
+  close(fd);
+  return r;
+}
+
+void
+runlog_reader_close(struct runlog_reader *rr)
+{
+  if (!rr) return;
+  if (rr->data) munmap((void*) rr->data, rr->size);
+  if (rr->fd >= 0) close(rr->fd);
+  memset(rr, 0, sizeof(*rr));
+  rr->fd = -1;
+}
+
+void
+runlog_reader_filter_add_status(struct runlog_reader_filter *flt, int status)
+{
+  if (status < 0 || status >= 128) return;
+  flt->status_mask[status / 64] |= 1ULL << (status % 64);
+}
+
+int
+runlog_reader_match(
+        const struct runlog_reader_filter *flt,
+        const struct run_entry *re)
+{
+  if (!flt) return 1;
+  if (flt->skip_empty && re->status == RUN_EMPTY) return 0;
+  if (flt->skip_hidden && re->is_hidden) return 0;
+  if (flt->user_id > 0 && re->user_id != flt->user_id) return 0;
+  if (flt->prob_id > 0 && re->prob_id != flt->prob_id) return 0;
+  if (flt->lang_id > 0 && re->lang_id != flt->lang_id) return 0;
+  if ((flt->status_mask[0] || flt->status_mask[1])
+      && (re->status >= 128
+          || !(flt->status_mask[re->status / 64] & (1ULL << (re->status % 64)))))
+    return 0;
+  if (flt->from_time > 0 && re->time < flt->from_time) return 0;
+  if (flt->to_time > 0 && re->time >= flt->to_time) return 0;
+  return 1;
+}
+
+int
+runlog_reader_next(
+        const struct runlog_reader *rr,
+        const struct runlog_reader_filter *flt,
+        int pos)
+{
+  if (pos < 0) pos = 0;
+  for (; pos < rr->run_count; ++pos) {
+    if (runlog_reader_match(flt, &rr->runs[pos])) return pos;
+  }
+  return -1;
+}
+
+int
+runlog_reader_select(
+        const struct runlog_reader *rr,
+        const struct runlog_reader_filter *flt,
+        int *out,
+        int out_size)
+{
+  int i, count = 0;
+
+  for (i = 0; i < rr->run_count; ++i) {
+    if (!runlog_reader_match(flt, &rr->runs[i])) continue;
+    if (count < out_size) out[count] = i;
+    ++count;
+  }
+  return count;
+}
@@ -0,0 +1,86 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __RUNLOG_READER_H__
+#define __RUNLOG_READER_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "runlog.h"
+
+/*
+ * Read-only access to the binary (version 2) runlog file.
+ *
+ * The file is mapped into memory and the run entries are accessed
+ * in place, nothing is copied. The reader does not take any locks,
+ * so it is intended for archived contests and for the offline tools,
+ * which can tolerate the runs being updated in the meantime.
+ * The reader does not depend on the logging and memory allocation
+ * routines, so it may be linked into the python module as is.
+ */
+
+struct runlog_reader
+{
+  int fd;
+  const unsigned char *data;
+  size_t size;
+  const struct run_header *header;
+  const struct run_entry *runs;
+  int run_count;
+};
+
+/* optional filter, the zero fields match anything */
+struct runlog_reader_filter
+{
+  int user_id;
+  int prob_id;
+  int lang_id;
+  /* bit (status % 64) of status_mask[status / 64] is set for the
+     accepted statuses, if both words are 0, any status is accepted */
+  unsigned long long status_mask[2];
+  /* the run time is in [from_time, to_time), 0 - no bound */
+  time_t from_time;
+  time_t to_time;
+  int skip_empty;
+  int skip_hidden;
+};
+
+/* returns 0 on success, -errno on failure */
+int runlog_reader_open(struct runlog_reader *rr, const unsigned char *path);
+void runlog_reader_close(struct runlog_reader *rr);
+
+void
+runlog_reader_filter_add_status(struct runlog_reader_filter *flt, int status);
+int
+runlog_reader_match(
+        const struct runlog_reader_filter *flt,
+        const struct run_entry *re);
+
+/* returns the index of the first matching entry >= pos, or -1 */
+int
+runlog_reader_next(
+        const struct runlog_reader *rr,
+        const struct runlog_reader_filter *flt,
+        int pos);
+
+/* stores at most out_size indices of matching entries into out,
+   returns the total number of matching entries */
+int
+runlog_reader_select(
+        const struct runlog_reader *rr,
+        const struct runlog_reader_filter *flt,
+        int *out,
+        int out_size);
+
+#endif /* __RUNLOG_READER_H__ */
@@ -19,6 +19,7 @@
  */
 
 #define RUNLOG_MAX_SIZE    (2 * 1024 * 1024)
+#define RUNLOG_CHANGE_LOG_SIZE 4096
 
 enum
   {
@@ -90,6 +91,11 @@ struct runlog_state
   int uuid_hash_last_added_run_id;
   int uuid_hash_last_added_index;
 
+  // incremented on every modification of the entries, the changed
+  // run_ids of the last modifications are kept in change_log
+  int change_serial;
+  int change_log[RUNLOG_CHANGE_LOG_SIZE];
+
   // the managing plugin information
   struct rldb_plugin_iface *iface;
   struct rldb_plugin_data *data;
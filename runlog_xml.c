@@ -33,6 +33,7 @@
 #include "fileutl.h"
 #include "base64.h"
 #include "ej_uuid.h"
+#include "run_pack.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -737,7 +738,6 @@ unparse_runlog_xml(
   size_t alen1, alen2, asize1, asize2;
   unsigned char status_buf[32];
   const struct section_global_data *global = state->global;
-  path_t fpath;
   char *ftext = 0;
   size_t fsize = 0;
   struct html_armor_buffer b1 = HTML_ARMOR_INITIALIZER;
@@ -1007,14 +1007,12 @@ unparse_runlog_xml(
     fprintf(f, ">\n");
 
     // read source
-    if ((flags = serve_make_source_read_path(state, fpath, sizeof(fpath), pp)) >= 0) {
-      if (generic_read_file(&ftext, 0, &fsize, flags, 0, fpath, 0) >= 0) {
-        fprintf(f, "      <%s %s=\"%zu\">%s</%s>\n",
-                elem_map[RUNLOG_T_SOURCE], attr_map[RUNLOG_A_SIZE], fsize,
-                encode_file(&b1, &b2, ftext, fsize),
-                elem_map[RUNLOG_T_SOURCE]);
-        xfree(ftext); ftext = 0; fsize = 0;
-      }
+    if (serve_read_run_artifact(state, pp, RUN_PACK_SOURCE, &ftext, &fsize) >= 0) {
+      fprintf(f, "      <%s %s=\"%zu\">%s</%s>\n",
+              elem_map[RUNLOG_T_SOURCE], attr_map[RUNLOG_A_SIZE], fsize,
+              encode_file(&b1, &b2, ftext, fsize),
+              elem_map[RUNLOG_T_SOURCE]);
+      xfree(ftext); ftext = 0; fsize = 0;
     }
 
 #if 0
@@ -1044,14 +1042,12 @@ unparse_runlog_xml(
 #endif
 
     // read audit
-    if ((flags = serve_make_audit_read_path(state, fpath, sizeof(fpath), pp)) >= 0) {
-      if (generic_read_file(&ftext, 0, &fsize, flags, 0, fpath, 0) >= 0) {
-        fprintf(f, "      <%s %s=\"%zu\">%s</%s>\n",
-                elem_map[RUNLOG_T_AUDIT], attr_map[RUNLOG_A_SIZE], fsize,
-                encode_file(&b1, &b2, ftext, fsize),
-                elem_map[RUNLOG_T_AUDIT]);
-        xfree(ftext); ftext = 0; fsize = 0;
-      }
+    if (serve_read_audit_log(state, pp, &ftext, &fsize) >= 0) {
+      fprintf(f, "      <%s %s=\"%zu\">%s</%s>\n",
+              elem_map[RUNLOG_T_AUDIT], attr_map[RUNLOG_A_SIZE], fsize,
+              encode_file(&b1, &b2, ftext, fsize),
+              elem_map[RUNLOG_T_AUDIT]);
+      xfree(ftext); ftext = 0; fsize = 0;
     }
 
     fprintf(f, "    </%s>\n", elem_map[RUNLOG_T_RUN]);
@@ -0,0 +1,86 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __RUNS_COLUMNAR_H__
+#define __RUNS_COLUMNAR_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include "ej_types.h"
+
+/*
+ * The columnar runs export (dump-master-runs with format=columnar).
+ * All the numbers are little-endian, the structures below give
+ * the field offsets and may be read directly only on little-endian
+ * hosts. The data consists of:
+ *   struct runs_columnar_header
+ *   struct runs_columnar_column[column_count]
+ *   for each column: run_count values of the column width,
+ *     padded to the 8 byte boundary
+ *   for each of dict_count dictionaries:
+ *     struct runs_columnar_dict
+ *     struct runs_columnar_dict_entry[count]
+ *     size bytes of \0-terminated strings, padded to the 8 byte boundary
+ * The dictionaries map the user, problem and language ids stored
+ * in the columns to their logins and short names.
+ */
+
+#define RUNS_COLUMNAR_MAGIC "EjRunCol"
+enum { RUNS_COLUMNAR_VERSION = 1 };
+
+/* column types */
+enum
+{
+  RUNS_COLUMNAR_INT = 1,
+  RUNS_COLUMNAR_UINT = 2,
+};
+
+/* structure size is 64 bytes */
+struct runs_columnar_header
+{
+  unsigned char magic[8];
+  ruint32_t version;
+  ruint32_t header_size;        /* sizeof(struct runs_columnar_header) */
+  ruint32_t run_count;
+  ruint32_t column_count;
+  ruint32_t dict_count;
+  ruint32_t _pad1;
+  ej_time64_t start_time;       /* the contest start time */
+  ej_time64_t export_time;
+  unsigned char _pad2[16];
+};
+
+/* structure size is 32 bytes */
+struct runs_columnar_column
+{
+  unsigned char name[24];
+  ruint32_t type;
+  ruint32_t width;              /* 1, 2, 4 or 8 bytes */
+};
+
+/* structure size is 32 bytes */
+struct runs_columnar_dict
+{
+  unsigned char name[24];       /* user_login, prob_short_name, etc */
+  ruint32_t count;
+  ruint32_t size;               /* the size of the string data */
+};
+
+struct runs_columnar_dict_entry
+{
+  rint32_t id;
+  ruint32_t offset;             /* in the string data */
+};
+
+#endif /* __RUNS_COLUMNAR_H__ */
@@ -47,6 +47,10 @@
 #include "testing_report_xml.h"
 #include "server_framework.h"
 #include "ej_uuid.h"
+#include "run_pack.h"
+#include "team_extra.h"
+#include "audit_log.h"
+#include "diff.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -820,13 +824,15 @@ void
 serve_move_files_to_insert_run(serve_state_t state, int run_id)
 {
   int total = run_get_total(state->runlog_state);
-  int i, s;
+  int i, s, from_id, to_id;
   const struct section_global_data *global = state->global;
   struct run_entry re;
 
   ASSERT(run_id >= 0 && run_id < total);
   // the last run
   if (run_id == total - 1) return;
+  // the runs after run_id are renumbered
+  serve_invalidate_similarity_index(state, -1);
   for (i = total - 2; i >= run_id; i--) {
     if (run_get_entry(state->runlog_state, i, &re) < 0) continue;
     if (re.store_flags == 1) continue;
@@ -838,8 +844,11 @@ serve_move_files_to_insert_run(serve_state_t state, int run_id)
     archive_remove(state, global->team_report_archive_dir, i + 1, 0);
     archive_remove(state, global->full_archive_dir, i + 1, 0);
     archive_remove(state, global->audit_log_dir, i + 1, 0);
+    serve_remove_audit_log(state, i + 1);
 
     archive_rename(state, global->audit_log_dir, 0, i, 0, i + 1, 0, 0);
+    from_id = i; to_id = i + 1;
+    serve_renumber_audit_log(state, 1, &from_id, &to_id);
     serve_audit_log(state, i + 1, &re, 0, 0, 0,
                     "rename", "ok", -1,
                     "From-run-id: %d\n"
@@ -858,6 +867,28 @@ serve_move_files_to_insert_run(serve_state_t state, int run_id)
   }
 }
 
+static int
+unpack_run_artifact(
+        serve_state_t state,
+        unsigned char *path,
+        size_t size,
+        const struct run_entry *re,
+        int type);
+
+static struct audit_log_state *
+get_audit_log(serve_state_t state)
+{
+  path_t path;
+
+  if (state->audit_log) return state->audit_log;
+  if (state->audit_log_failed) return NULL;
+  if (!state->global || !state->global->audit_log_dir[0]) return NULL;
+  snprintf(path, sizeof(path), "%s/segments", state->global->audit_log_dir);
+  if (!(state->audit_log = audit_log_open(path, state->global->audit_log_sync > 0)))
+    state->audit_log_failed = 1;
+  return state->audit_log;
+}
+
 void
 serve_audit_log(
         serve_state_t state,
@@ -883,6 +914,9 @@ serve_audit_log(
   unsigned char status_buf[64];
   int flags;
   struct run_entry local_re;
+  char *entry_t = 0;
+  size_t entry_z = 0;
+  struct audit_log_state *al;
 
   buf[0] = 0;
   if (format && *format) {
@@ -903,17 +937,7 @@ serve_audit_log(
            ltm->tm_year + 1900, ltm->tm_mon + 1, ltm->tm_mday,
            ltm->tm_hour, ltm->tm_min, ltm->tm_sec);
 
-  if (re && re->store_flags == 1) {
-    flags = uuid_archive_prepare_write_path(state, audit_path, sizeof(audit_path),
-                                            re->run_uuid, 0, DFLT_R_UUID_AUDIT, 0, 1);
-  } else {
-    flags = archive_prepare_write_path(state, audit_path, sizeof(audit_path),
-                                       state->global->audit_log_dir, run_id, 0,
-                                       NULL, 0, 1);
-  }
-  if (flags < 0) return;
-  if (!(f = fopen(audit_path, "a"))) return;
-
+  f = open_memstream(&entry_t, &entry_z);
   fprintf(f, "Date: %s\n", tbuf);
   if (!user_id) {
     fprintf(f, "From: SYSTEM\n");
@@ -946,8 +970,34 @@ serve_audit_log(
   } else {
     fprintf(f, "\n");
   }
+  close_memstream(f); f = 0;
 
+  // the entry is written to the segment at the end of the loop iteration
+  if (run_id >= 0 && (al = get_audit_log(state))) {
+    audit_log_append(al, run_id, re?re->run_uuid:NULL, entry_t, entry_z);
+    xfree(entry_t);
+    return;
+  }
+
+  if (re && re->store_flags == 1) {
+    flags = uuid_archive_prepare_write_path(state, audit_path, sizeof(audit_path),
+                                            re->run_uuid, 0, DFLT_R_UUID_AUDIT, 0, 1);
+  } else {
+    flags = archive_prepare_write_path(state, audit_path, sizeof(audit_path),
+                                       state->global->audit_log_dir, run_id, 0,
+                                       NULL, 0, 1);
+  }
+  if (flags < 0) goto cleanup;
+  if (re && re->store_flags == 1 && access(audit_path, F_OK) < 0) {
+    unpack_run_artifact(state, audit_path, sizeof(audit_path), re,
+                        RUN_PACK_AUDIT);
+  }
+  if (!(f = fopen(audit_path, "a"))) goto cleanup;
+  fwrite(entry_t, 1, entry_z, f);
   fclose(f);
+
+ cleanup:
+  xfree(entry_t);
 }
 
 static const unsigned char b32_digits[]=
@@ -1077,8 +1127,7 @@ serve_compile_request(
   void *pkt_buf = 0;
   size_t pkt_len = 0;
   unsigned char pkt_name[EJ_SERVE_PACKET_NAME_SIZE];
-  int arch_flags;
-  path_t run_arch;
+  struct run_entry src_re;
   const struct section_global_data *global = state->global;
   path_t tmp_path, tmp_path_2;
   char *src_header_text = 0, *src_footer_text = 0, *src_text = 0;
@@ -1265,27 +1314,22 @@ serve_compile_request(
   if (!sfx) sfx = "";
   serve_packet_name(run_id, prio, pkt_name);
 
-  if (src_header_size > 0 || src_footer_size > 0) {
-    if (len < 0) {
-      if (store_flags == 1) {
-        arch_flags = uuid_archive_make_read_path(state, run_arch, sizeof(run_arch),
-                                                 uuid, DFLT_R_UUID_SOURCE, 0);
-      } else {
-        arch_flags = archive_make_read_path(state, run_arch, sizeof(run_arch),
-                                            global->run_archive_dir, run_id,0,0);
-      }
-      if (arch_flags < 0) {
-        errcode = -SERVE_ERR_SOURCE_READ;
-        goto failed;
-      }
-      if (generic_read_file(&src_text, 0, &src_size, arch_flags, 0,
-                            run_arch, "") < 0) {
-        errcode = -SERVE_ERR_SOURCE_READ;
-        goto failed;
-      }
-      str = src_text;
-      len = src_size;
+  if (len < 0) {
+    // the source is in the archive, it may be in the pack store
+    memset(&src_re, 0, sizeof(src_re));
+    src_re.run_id = run_id;
+    src_re.store_flags = store_flags;
+    if (uuid) memcpy(src_re.run_uuid, uuid, sizeof(src_re.run_uuid));
+    if (serve_read_run_artifact(state, &src_re, RUN_PACK_SOURCE,
+                                &src_text, &src_size) < 0) {
+      errcode = -SERVE_ERR_SOURCE_READ;
+      goto failed;
     }
+    str = src_text;
+    len = src_size;
+  }
+
+  if (src_header_size > 0 || src_footer_size > 0) {
     src_out_size = src_header_size + len + src_footer_size;
     src_out_text = (unsigned char*) xmalloc(src_out_size + 1);
     if (src_header_size > 0)
@@ -1300,24 +1344,6 @@ serve_compile_request(
       errcode = -SERVE_ERR_SOURCE_WRITE;
       goto failed;
     }
-  } else if (len < 0) {
-    // copy from archive
-    if (store_flags == 1) {
-      arch_flags = uuid_archive_make_read_path(state, run_arch, sizeof(run_arch),
-                                               uuid, DFLT_R_UUID_SOURCE, 0);
-    } else {
-      arch_flags = archive_make_read_path(state, run_arch, sizeof(run_arch),
-                                          global->run_archive_dir, run_id, 0,0);
-    }
-    if (arch_flags < 0) {
-      errcode = -SERVE_ERR_SOURCE_READ;
-      goto failed;
-    }
-    if (generic_copy_file(arch_flags, 0, run_arch, "",
-                          0, compile_src_dir, pkt_name, sfx) < 0) {
-      errcode = -SERVE_ERR_SOURCE_WRITE;
-      goto failed;
-    }
   } else {
     // write from memory
     if (generic_write_file(str, len, 0,
@@ -2000,9 +2026,16 @@ serve_run_request(
 
   super_run_in_packet_set_default(srp);
 
-  srp_f = open_memstream(&srp_t, &srp_z);
-  super_run_in_packet_unparse_cfg(srp_f, srp);
-  fclose(srp_f); srp_f = NULL;
+  if (global->binary_run_packets > 0) {
+    if (super_run_in_packet_write_bin(srp, &srp_z, (void**) &srp_t) < 0) {
+      fprintf(errf, "failed to encode run packet\n");
+      goto fail;
+    }
+  } else {
+    srp_f = open_memstream(&srp_t, &srp_z);
+    super_run_in_packet_unparse_cfg(srp_f, srp);
+    close_memstream(srp_f); srp_f = NULL;
+  }
 
   if (generic_write_file(srp_t, srp_z, SAFE, run_queue_dir, pkt_base, "") < 0) {
     fprintf(errf, "failed to write run packet\n");
@@ -4057,6 +4090,7 @@ serve_reset_contest(const struct contest_desc *cnts, serve_state_t state)
   }
   run_reset(state->runlog_state, global->contest_time,
             cnts->sched_time, contest_finish_time);
+  serve_invalidate_similarity_index(state, -1);
   run_set_duration(state->runlog_state,
                    global->contest_time);
   clar_reset(state->clarlog_state);
@@ -4072,10 +4106,19 @@ serve_reset_contest(const struct contest_desc *cnts, serve_state_t state)
     clear_directory(global->team_report_archive_dir);
   if (global->full_archive_dir[0])
     clear_directory(global->full_archive_dir);
-  if (global->audit_log_dir[0])
+  if (global->audit_log_dir[0]) {
+    // the segment store keeps the pending entries and the open files
+    state->audit_log = audit_log_close(state->audit_log);
+    state->audit_log_failed = 0;
     clear_directory(global->audit_log_dir);
-  if (global->team_extra_dir[0])
+  }
+  if (global->team_extra_dir[0]) {
     clear_directory(global->team_extra_dir);
+    // the store is loaded in the memory, start it anew
+    team_extra_destroy(state->team_extra_state);
+    state->team_extra_state = team_extra_init();
+    team_extra_set_dir(state->team_extra_state, global->team_extra_dir);
+  }
   if (global->uuid_archive_dir[0])
     clear_directory(global->uuid_archive_dir);
 
@@ -4117,6 +4160,7 @@ serve_squeeze_runs(serve_state_t state)
     archive_remove(state, global->audit_log_dir, j, 0);
   }
   run_squeeze_log(state->runlog_state);
+  serve_invalidate_similarity_index(state, -1);
 
   /* FIXME: add an audit record for each renumbered run */
 }
@@ -4482,6 +4526,7 @@ serve_clear_by_mask(serve_state_t state,
     if ((mask[r / BITS_PER_LONG] & (1L << (r % BITS_PER_LONG)))
         && !run_is_readonly(state->runlog_state, r)) {
       if (run_get_entry(state->runlog_state, r, &re) >= 0 && run_clear_entry(state->runlog_state, r) >= 0) {
+        serve_invalidate_similarity_index(state, r);
         if (re.store_flags == 1) {
           uuid_archive_remove(state, re.run_uuid);
         } else {
@@ -4703,18 +4748,6 @@ testing_queue_unlock_entry(
   return 0;
 }
 
-static int
-get_priority_value(int priority_code)
-{
-  int priority = 0;
-  if (priority_code >= '0' && priority_code <= '9') {
-    priority = -16 + (priority_code - '0');
-  } else if (priority_code >= 'A' && priority_code <= 'V') {
-    priority = -6 + (priority_code - 'A');
-  }
-  return priority;
-}
-
 static int
 get_priority_code(int priority)
 {
@@ -4824,7 +4857,7 @@ serve_testing_queue_change_priority(
   if (!exe_sfx) exe_sfx = "";
 
   snprintf(new_packet_name, sizeof(new_packet_name), "%s", packet_name);
-  new_packet_name[0] = get_priority_code(get_priority_value(new_packet_name[0]) + adjustment);
+  new_packet_name[0] = get_priority_code(scan_dir_get_priority(new_packet_name) + adjustment);
   if (!strcmp(packet_name, new_packet_name)) {
     // already hit min or max priority
     testing_queue_unlock_entry(run_queue_dir, out_path, packet_name);
@@ -5077,6 +5110,94 @@ serve_err_str(int serve_err)
   return str;
 }
 
+static const unsigned char * const run_pack_names[RUN_PACK_LAST] =
+{
+  [RUN_PACK_SOURCE] = DFLT_R_UUID_SOURCE,
+  [RUN_PACK_REPORT] = DFLT_R_UUID_REPORT,
+  [RUN_PACK_XML_REPORT] = DFLT_R_UUID_XML_REPORT,
+  [RUN_PACK_AUDIT] = DFLT_R_UUID_AUDIT,
+};
+static const int run_pack_gzip_preferred[RUN_PACK_LAST] =
+{
+  [RUN_PACK_SOURCE] = 1,
+  [RUN_PACK_REPORT] = 1,
+  [RUN_PACK_XML_REPORT] = 1,
+  [RUN_PACK_AUDIT] = 0,
+};
+
+struct run_pack_state *
+serve_get_run_pack(serve_state_t state, int write_flag)
+{
+  path_t path;
+  struct stat stb;
+
+  if (state->run_pack && (!write_flag || state->run_pack_write))
+    return state->run_pack;
+  if (!state->global || !state->global->uuid_archive_dir[0]) return NULL;
+  snprintf(path, sizeof(path), "%s/pack", state->global->uuid_archive_dir);
+  if (!write_flag && (stat(path, &stb) < 0 || !S_ISDIR(stb.st_mode)))
+    return NULL;
+  state->run_pack = run_pack_close(state->run_pack);
+  state->run_pack = run_pack_open(path, write_flag);
+  state->run_pack_write = write_flag;
+  return state->run_pack;
+}
+
+/* moves the packed artifact back to its file, the file is needed by
+   the code which works with the paths (compilation, printing),
+   or to append to the audit log */
+static int
+unpack_run_artifact(
+        serve_state_t state,
+        unsigned char *path,
+        size_t size,
+        const struct run_entry *re,
+        int type)
+{
+  struct run_pack_state *rp;
+  char *data = 0;
+  size_t data_size = 0;
+  int flags;
+
+  if (!(rp = serve_get_run_pack(state, 0))) return -1;
+  if (run_pack_get(rp, re->run_uuid, type, &data, &data_size) <= 0)
+    return -1;
+  if (!(rp = serve_get_run_pack(state, 1))) goto fail;
+  // the audit log is appended to, so it is never compressed
+  flags = uuid_archive_prepare_write_path(state, path, size, re->run_uuid,
+                                          (type == RUN_PACK_AUDIT)?0:data_size,
+                                          run_pack_names[type], 0, 1);
+  if (flags < 0) goto fail;
+  if (generic_write_file(data, data_size, flags, 0, path, "") < 0) goto fail;
+  run_pack_remove(rp, re->run_uuid, type);
+  xfree(data);
+  return flags;
+
+ fail:
+  xfree(data);
+  return -1;
+}
+
+static int
+make_uuid_read_path(
+        const serve_state_t state,
+        unsigned char *path,
+        size_t size,
+        const struct run_entry *re,
+        int type)
+{
+  int ret;
+
+  ret = uuid_archive_find_read_path(state, path, size, re->run_uuid,
+                                    run_pack_names[type],
+                                    run_pack_gzip_preferred[type]);
+  if (ret < 0) ret = unpack_run_artifact(state, path, size, re, type);
+  if (ret < 0)
+    err("make_uuid_read_path: no %s for run %d", run_pack_names[type],
+        re->run_id);
+  return ret;
+}
+
 int
 serve_make_source_read_path(
         const serve_state_t state,
@@ -5086,8 +5207,7 @@ serve_make_source_read_path(
 {
   int ret;
   if (re->store_flags == 1) {
-    ret = uuid_archive_make_read_path(state, path, size,
-                                      re->run_uuid, DFLT_R_UUID_SOURCE, 1);
+    ret = make_uuid_read_path(state, path, size, re, RUN_PACK_SOURCE);
   } else {
     ret = archive_make_read_path(state, path, size, state->global->run_archive_dir,
                                  re->run_id, NULL, 1);
@@ -5104,8 +5224,7 @@ serve_make_xml_report_read_path(
 {
   int ret;
   if (re->store_flags == 1) {
-    ret = uuid_archive_make_read_path(state, path, size,
-                                      re->run_uuid, DFLT_R_UUID_XML_REPORT, 1);
+    ret = make_uuid_read_path(state, path, size, re, RUN_PACK_XML_REPORT);
   } else {
     ret = archive_make_read_path(state, path, size, state->global->xml_report_archive_dir,
                                  re->run_id, NULL, 1);
@@ -5122,8 +5241,7 @@ serve_make_report_read_path(
 {
   int ret;
   if (re->store_flags == 1) {
-    ret = uuid_archive_make_read_path(state, path, size,
-                                      re->run_uuid, DFLT_R_UUID_REPORT, 1);
+    ret = make_uuid_read_path(state, path, size, re, RUN_PACK_REPORT);
   } else {
     ret = archive_make_read_path(state, path, size, state->global->report_archive_dir,
                                  re->run_id, NULL, 1);
@@ -5168,11 +5286,519 @@ serve_make_audit_read_path(
 {
   int ret;
   if (re->store_flags == 1) {
-    ret = uuid_archive_make_read_path(state, path, size,
-                                      re->run_uuid, DFLT_R_UUID_AUDIT, 0);
+    ret = make_uuid_read_path(state, path, size, re, RUN_PACK_AUDIT);
   } else {
     ret = archive_make_read_path(state, path, size, state->global->audit_log_dir,
                                  re->run_id, NULL, 0);
   }
   return ret;
 }
+
+int
+serve_read_run_artifact(
+        serve_state_t state,
+        const struct run_entry *re,
+        int type,
+        char **p_data,
+        size_t *p_size)
+{
+  path_t path;
+  int flags = -1;
+  struct run_pack_state *rp;
+
+  if (type <= 0 || type >= RUN_PACK_LAST) return -1;
+  if (re->store_flags == 1) {
+    flags = uuid_archive_find_read_path(state, path, sizeof(path),
+                                        re->run_uuid, run_pack_names[type],
+                                        run_pack_gzip_preferred[type]);
+    if (flags < 0) {
+      if ((rp = serve_get_run_pack(state, 0))
+          && run_pack_get(rp, re->run_uuid, type, p_data, p_size) > 0)
+        return 0;
+      err("serve_read_run_artifact: no %s for run %d", run_pack_names[type],
+          re->run_id);
+      return -1;
+    }
+  } else {
+    switch (type) {
+    case RUN_PACK_SOURCE:
+      flags = serve_make_source_read_path(state, path, sizeof(path), re);
+      break;
+    case RUN_PACK_REPORT:
+      flags = serve_make_report_read_path(state, path, sizeof(path), re);
+      break;
+    case RUN_PACK_XML_REPORT:
+      flags = serve_make_xml_report_read_path(state, path, sizeof(path), re);
+      break;
+    case RUN_PACK_AUDIT:
+      flags = serve_make_audit_read_path(state, path, sizeof(path), re);
+      break;
+    }
+    if (flags < 0) return -1;
+  }
+  if (generic_read_file(p_data, 0, p_size, flags, 0, path, "") < 0)
+    return -1;
+  return 0;
+}
+
+void
+serve_forget_packed_artifact(
+        serve_state_t state,
+        const ruint32_t run_uuid[4],
+        const unsigned char *name)
+{
+  struct run_pack_state *rp;
+  int type;
+
+  for (type = 1; type < RUN_PACK_LAST; ++type)
+    if (!strcmp(run_pack_names[type], name))
+      break;
+  if (type >= RUN_PACK_LAST) return;
+  if (!serve_get_run_pack(state, 0)) return;
+  if (!(rp = serve_get_run_pack(state, 1))) return;
+  run_pack_remove(rp, run_uuid, type);
+}
+
+/* removes the packed files, they are removed only after the pack
+   store is flushed to the disk */
+static int
+remove_packed_files(
+        struct run_pack_state *rp,
+        unsigned char **paths,
+        int path_u)
+{
+  int i;
+  unsigned char *s;
+
+  if (run_pack_sync(rp) < 0) return -1;
+  for (i = 0; i < path_u; ++i) {
+    unlink(paths[i]);
+    // remove the run directory, if it became empty
+    if ((s = strrchr(paths[i], '/'))) {
+      *s = 0;
+      rmdir(paths[i]);
+    }
+    xfree(paths[i]); paths[i] = 0;
+  }
+  return 0;
+}
+
+static int has_audit_log_file(serve_state_t state, const struct run_entry *re);
+
+/* removes the legacy audit log of the run, both the file and the
+   packed copy */
+static void
+remove_audit_log_file(serve_state_t state, const struct run_entry *re)
+{
+  path_t path;
+  unsigned char *s;
+
+  if (re->store_flags != 1) {
+    archive_remove(state, state->global->audit_log_dir, re->run_id, 0);
+    return;
+  }
+  if (uuid_archive_find_read_path(state, path, sizeof(path), re->run_uuid,
+                                  run_pack_names[RUN_PACK_AUDIT],
+                                  run_pack_gzip_preferred[RUN_PACK_AUDIT]) >= 0) {
+    unlink(path);
+    if ((s = strrchr(path, '/'))) {
+      *s = 0;
+      rmdir(path);
+    }
+  }
+  serve_forget_packed_artifact(state, re->run_uuid,
+                               run_pack_names[RUN_PACK_AUDIT]);
+}
+
+/* the legacy files are removed only after the imported copies are
+   synced, a crash in between leaves the files, which are ignored
+   by the readers and removed by the next import */
+static int
+remove_imported_files(
+        serve_state_t state,
+        struct audit_log_state *al,
+        const int *run_ids,
+        int run_u)
+{
+  struct run_entry re;
+  int i;
+
+  if (audit_log_sync(al) < 0) return -1;
+  for (i = 0; i < run_u; ++i) {
+    if (run_get_entry(state->runlog_state, run_ids[i], &re) >= 0)
+      remove_audit_log_file(state, &re);
+  }
+  return 0;
+}
+
+/*
+ * PACK_RUNS is done by a background job of the server framework:
+ * the audit logs are imported, then the artifacts are moved to the pack
+ * store, then both stores are compacted, if there is much garbage. Each
+ * step handles a few runs and syncs the stores before the files are
+ * removed, so nothing is pending between the iterations of the server
+ * loop, when the runs may be changed.
+ */
+enum
+{
+  PACK_STAGE_AUDIT,
+  PACK_STAGE_FILES,
+  PACK_STAGE_COMPACT,
+  PACK_STAGE_AUDIT_COMPACT,
+  PACK_STAGE_DONE,
+};
+
+struct pack_runs_job
+{
+  struct server_framework_job b;
+
+  serve_state_t state;
+  struct run_pack_state *rp;
+  struct audit_log_state *al;
+  int force_flag;
+  int stage;
+  int run_id;                   /* the next run of the stage */
+  int audit_count;
+  int run_count;
+  int file_count;
+  long long packed_size;
+  long long total_size;         /* the store size before the compaction */
+  long long live_size;
+
+  int run_u, run_a;             /* the imported audit logs of the step */
+  int *run_ids;
+  int path_u, path_a;           /* the packed files of the step */
+  unsigned char **paths;
+};
+
+static void
+pack_runs_destroy_func(struct server_framework_job *j)
+{
+  struct pack_runs_job *job = (struct pack_runs_job*) j;
+
+  job->state->pack_runs_job = 0;
+  for (; job->path_u > 0; --job->path_u)
+    xfree(job->paths[job->path_u - 1]);
+  xfree(job->paths);
+  xfree(job->run_ids);
+  xfree(job->b.title);
+  xfree(job);
+}
+
+/* moves the audit log written before the segment store (the per-run
+   file or its copy in the pack store) to the segment store */
+static void
+import_run_audit_log(struct pack_runs_job *job, const struct run_entry *re)
+{
+  char *data = 0;
+  size_t data_size = 0;
+
+  if (re->status > RUN_MAX_STATUS) return;
+  if (!has_audit_log_file(job->state, re)) return;
+  if (!audit_log_is_imported(job->al, re->run_id, re->run_uuid)) {
+    if (serve_read_run_artifact(job->state, re, RUN_PACK_AUDIT, &data,
+                                &data_size) < 0)
+      return;
+    if (audit_log_import(job->al, re->run_id, re->run_uuid, data,
+                         data_size) < 0) {
+      // the file is kept and is still read
+      err("audit log of run %d is too big", re->run_id);
+      xfree(data);
+      return;
+    }
+    xfree(data);
+    ++job->audit_count;
+  }
+  if (job->run_u == job->run_a) {
+    if (!(job->run_a *= 2)) job->run_a = 16;
+    XREALLOC(job->run_ids, job->run_a);
+  }
+  job->run_ids[job->run_u++] = re->run_id;
+}
+
+/* returns -1, if the pack store failed */
+static int
+pack_run_files(struct pack_runs_job *job, const struct run_entry *re)
+{
+  const struct section_global_data *global = job->state->global;
+  int type, flags, compress_flag, packed_flag = 0;
+  path_t path;
+  char *data = 0;
+  size_t data_size = 0;
+
+  if (re->store_flags != 1 || re->status > RUN_MAX_STATUS) return 0;
+  for (type = 1; type < RUN_PACK_LAST; ++type) {
+    if (type == RUN_PACK_AUDIT && job->al) continue;
+    flags = uuid_archive_find_read_path(job->state, path, sizeof(path),
+                                        re->run_uuid, run_pack_names[type],
+                                        run_pack_gzip_preferred[type]);
+    if (flags < 0) continue;
+    data = 0; data_size = 0;
+    if (generic_read_file(&data, 0, &data_size, flags, 0, path, "") < 0)
+      continue;
+    compress_flag = (flags == GZIP
+                     || (global->use_gzip > 0
+                         && data_size > global->min_gzip_size));
+    if (run_pack_put(job->rp, re->run_uuid, type, data, data_size,
+                     compress_flag) < 0) {
+      err("failed to pack %s", path);
+      xfree(data);
+      return -1;
+    }
+    xfree(data);
+    if (job->path_u == job->path_a) {
+      if (!(job->path_a *= 2)) job->path_a = 64;
+      XREALLOC(job->paths, job->path_a);
+    }
+    job->paths[job->path_u++] = xstrdup(path);
+    job->packed_size += data_size;
+    ++job->file_count;
+    packed_flag = 1;
+  }
+  job->run_count += packed_flag;
+  return 0;
+}
+
+static int
+pack_runs_run_func(
+        struct server_framework_job *j,
+        int *p_count,
+        int max_count)
+{
+  struct pack_runs_job *job = (struct pack_runs_job*) j;
+  serve_state_t state = job->state;
+  struct run_entry re;
+  struct run_pack_stats ps;
+  int total_runs, r;
+
+  // the store is reopened, the packing is abandoned
+  if (state->run_pack != job->rp || !state->run_pack_write) {
+    err("pack store is reopened, packing is abandoned");
+    return 1;
+  }
+
+  total_runs = run_get_total(state->runlog_state);
+  switch (job->stage) {
+  case PACK_STAGE_AUDIT:
+    for (; job->run_id < total_runs && *p_count < max_count; ++job->run_id) {
+      ++(*p_count);
+      if (run_get_entry(state->runlog_state, job->run_id, &re) < 0) continue;
+      import_run_audit_log(job, &re);
+    }
+    if (remove_imported_files(state, job->al, job->run_ids, job->run_u) < 0) {
+      err("failed to import the audit logs");
+      return 1;
+    }
+    job->run_u = 0;
+    if (job->run_id >= total_runs) {
+      info("audit logs imported: %d", job->audit_count);
+      job->stage = PACK_STAGE_FILES;
+      job->run_id = 0;
+    }
+    return 0;
+
+  case PACK_STAGE_FILES:
+    for (; job->run_id < total_runs && *p_count < max_count; ++job->run_id) {
+      ++(*p_count);
+      if (run_get_entry(state->runlog_state, job->run_id, &re) < 0) continue;
+      if (pack_run_files(job, &re) < 0) return 1;
+    }
+    if (remove_packed_files(job->rp, job->paths, job->path_u) < 0) {
+      // the files are kept, the pack copies are garbage
+      err("failed to sync the pack store");
+      return 1;
+    }
+    job->path_u = 0;
+    if (job->run_id < total_runs) return 0;
+
+    info("runs packed: %d, files packed: %d, bytes packed: %lld",
+         job->run_count, job->file_count, job->packed_size);
+    job->stage = PACK_STAGE_AUDIT_COMPACT;
+    if (!run_pack_is_compacting(job->rp)) {
+      run_pack_get_stats(job->rp, &ps);
+      if ((job->force_flag || ps.total_size > 2 * ps.live_size)
+          && run_pack_compact_start(job->rp) > 0) {
+        job->total_size = ps.total_size;
+        job->live_size = ps.live_size;
+        job->stage = PACK_STAGE_COMPACT;
+      }
+    }
+    return 0;
+
+  case PACK_STAGE_COMPACT:
+    if (run_pack_is_compacting(job->rp)) {
+      if ((r = run_pack_compact_step(job->rp, p_count, max_count)) < 0) {
+        err("compaction of the pack store failed");
+        return 1;
+      }
+      if (r > 0) return 0;
+      info("pack store compacted: %lld bytes reclaimed",
+           job->total_size - job->live_size);
+    }
+    job->stage = PACK_STAGE_AUDIT_COMPACT;
+    return 0;
+
+  case PACK_STAGE_AUDIT_COMPACT:
+    if (!job->al) break;
+    if (!audit_log_is_compacting(job->al)
+        && audit_log_compact_start(job->al, job->force_flag) <= 0)
+      break;
+    if ((r = audit_log_compact_step(job->al, p_count, max_count)) > 0)
+      return 0;
+    if (r < 0) err("compaction of the audit log failed");
+    break;
+  }
+
+  job->stage = PACK_STAGE_DONE;
+  return 1;
+}
+
+static unsigned char *
+pack_runs_get_status_func(struct server_framework_job *j)
+{
+  struct pack_runs_job *job = (struct pack_runs_job*) j;
+  struct run_pack_stats ps;
+  unsigned char buf[1024];
+  int total_runs = run_get_total(job->state->runlog_state);
+
+  switch (job->stage) {
+  case PACK_STAGE_AUDIT:
+    snprintf(buf, sizeof(buf), "audit logs: %d/%d", job->run_id, total_runs);
+    break;
+  case PACK_STAGE_FILES:
+    snprintf(buf, sizeof(buf), "runs: %d/%d, files packed: %d",
+             job->run_id, total_runs, job->file_count);
+    break;
+  case PACK_STAGE_COMPACT:
+    if (job->state->run_pack != job->rp) return xstrdup("done");
+    run_pack_get_stats(job->rp, &ps);
+    snprintf(buf, sizeof(buf), "compaction: %d segments left",
+             ps.segment_count);
+    break;
+  case PACK_STAGE_AUDIT_COMPACT:
+    return xstrdup("audit log compaction");
+  default:
+    return xstrdup("done");
+  }
+  return xstrdup(buf);
+}
+
+static const struct server_framework_job_funcs pack_runs_funcs =
+{
+  pack_runs_destroy_func,
+  pack_runs_run_func,
+  pack_runs_get_status_func,
+};
+
+/* returns NULL, if the pack store is not available or the packing
+   is already running, force_flag forces the compaction */
+struct server_framework_job *
+serve_pack_runs(
+        const struct contest_desc *cnts,
+        serve_state_t state,
+        int force_flag)
+{
+  struct run_pack_state *rp;
+  struct pack_runs_job *job;
+
+  if (state->pack_runs_job) return NULL;
+  if (!(rp = serve_get_run_pack(state, 1))) {
+    err("failed to open the pack store");
+    return NULL;
+  }
+
+  XCALLOC(job, 1);
+  job->b.vt = &pack_runs_funcs;
+  job->b.contest_id = cnts->id;
+  job->b.title = xstrdup("Packing of the runs");
+  job->state = state;
+  job->rp = rp;
+  job->force_flag = force_flag;
+  // the audit logs go to the segment store, if it is used
+  if ((job->al = get_audit_log(state))) {
+    job->stage = PACK_STAGE_AUDIT;
+  } else {
+    job->stage = PACK_STAGE_FILES;
+  }
+  state->pack_runs_job = (struct server_framework_job*) job;
+  return (struct server_framework_job*) job;
+}
+
+void
+serve_flush_audit_log(serve_state_t state)
+{
+  if (state->audit_log) audit_log_flush(state->audit_log);
+}
+
+/* checks the audit log file written before the segment store */
+static int
+has_audit_log_file(serve_state_t state, const struct run_entry *re)
+{
+  path_t path;
+  struct run_pack_state *rp;
+
+  if (re->store_flags == 1) {
+    if (uuid_archive_find_read_path(state, path, sizeof(path), re->run_uuid,
+                                    run_pack_names[RUN_PACK_AUDIT],
+                                    run_pack_gzip_preferred[RUN_PACK_AUDIT]) >= 0)
+      return 1;
+    return (rp = serve_get_run_pack(state, 0))
+      && run_pack_exists(rp, re->run_uuid, RUN_PACK_AUDIT);
+  }
+  return serve_make_audit_read_path(state, path, sizeof(path), re) >= 0;
+}
+
+int
+serve_read_audit_log(
+        serve_state_t state,
+        const struct run_entry *re,
+        char **p_data,
+        size_t *p_size)
+{
+  char *file_t = 0, *out_t = 0;
+  size_t file_z = 0, out_z = 0;
+  FILE *out_f;
+  struct audit_log_state *al;
+  int found = 0;
+
+  out_f = open_memstream(&out_t, &out_z);
+  al = get_audit_log(state);
+  // the imported copy of the file is read from the segment store
+  if (!(al && audit_log_is_imported(al, re->run_id, re->run_uuid))
+      && has_audit_log_file(state, re)
+      && serve_read_run_artifact(state, re, RUN_PACK_AUDIT, &file_t, &file_z) >= 0) {
+    fwrite(file_t, 1, file_z, out_f);
+    xfree(file_t);
+    found = 1;
+  }
+  if (al && audit_log_read(al, re->run_id, re->run_uuid, out_f) > 0)
+    found = 1;
+  close_memstream(out_f); out_f = 0;
+  if (!found) {
+    xfree(out_t);
+    return -1;
+  }
+  *p_data = out_t;
+  *p_size = out_z;
+  return 0;
+}
+
+void
+serve_remove_audit_log(serve_state_t state, int run_id)
+{
+  struct audit_log_state *al;
+
+  if ((al = get_audit_log(state))) audit_log_remove(al, run_id);
+}
+
+void
+serve_renumber_audit_log(
+        serve_state_t state,
+        int count,
+        const int *from,
+        const int *to)
+{
+  struct audit_log_state *al;
+
+  if ((al = get_audit_log(state))) audit_log_renumber(al, count, from, to);
+}
@@ -38,6 +38,12 @@
 #include "prepare.h"
 #include "prepare_serve.h"
 #include "userlist.h"
+#include "userlist_image.h"
+#include "similarity_index.h"
+#include "text_diff.h"
+#include "run_pack.h"
+#include "audit_log.h"
+#include "stand_timeline.h"
 #include "xml_utils.h"
 
 #include "reuse_xalloc.h"
@@ -212,6 +218,11 @@ serve_state_destroy(
   xfree(state->testers);
 
   xfree(state->user_results);
+  similarity_index_free(state->similarity_index);
+  text_diff_cache_free(state->diff_cache);
+  run_pack_close(state->run_pack);
+  audit_log_close(state->audit_log);
+  stand_timeline_free(state->stand_timeline);
 
   memset(state, 0, sizeof(*state));
   xfree(state);
@@ -704,6 +715,7 @@ serve_state_load_contest(
   struct stat stbuf;
   int i;
   const size_t *sza;
+  path_t image_dir;
   struct contest_plugin_iface *iface;
   const unsigned char *f = __FUNCTION__;
   const struct section_global_data *global = 0;
@@ -777,6 +789,8 @@ serve_state_load_contest(
     goto failure;
 
   if (ul_conn) {
+    if (userlist_image_get_dir(config, image_dir, sizeof(image_dir)) >= 0)
+      teamdb_set_image_dir(state->teamdb_state, image_dir);
     // ignore error code
     userlist_clnt_notify(ul_conn, ULS_ADD_NOTIFY, contest_id);
   }
@@ -40,6 +40,11 @@ struct user_filter_info;
 struct teamdb_db_callbacks;
 struct userlist_clnt;
 struct ejudge_cfg;
+struct similarity_index;
+struct text_diff_cache;
+struct run_pack_state;
+struct audit_log_state;
+struct stand_timeline;
 
 /* error codes */
 enum
@@ -305,6 +310,25 @@ struct serve_state
   // memoized user results
   int user_result_a; // allocated size
   struct serve_user_results *user_results;
+
+  // source similarity index, built on demand
+  struct similarity_index *similarity_index;
+
+  // the cache of the run and the test output comparisons
+  struct text_diff_cache *diff_cache;
+
+  // the pack store of the run artifacts, opened on demand
+  struct run_pack_state *run_pack;
+  int run_pack_write;
+  // the running PACK_RUNS job
+  struct server_framework_job *pack_runs_job;
+
+  // the audit log store, opened on the first entry
+  struct audit_log_state *audit_log;
+  int audit_log_failed;
+
+  // the time-indexed standings of a virtual contest, built on demand
+  struct stand_timeline *stand_timeline;
 };
 typedef struct serve_state *serve_state_t;
 
@@ -362,6 +386,7 @@ void serve_check_stat_generation(const struct ejudge_cfg *config,
                                  int force_flag, int utf8_mode);
 
 struct ejudge_cfg;
+struct similarity_index;
 int
 serve_state_load_contest_config(
         const struct ejudge_cfg *config,
@@ -748,4 +773,38 @@ serve_make_audit_read_path(
         size_t size,
         const struct run_entry *re);
 
+struct run_pack_state *serve_get_run_pack(serve_state_t state, int write_flag);
+int
+serve_read_run_artifact(
+        serve_state_t state,
+        const struct run_entry *re,
+        int type,
+        char **p_data,
+        size_t *p_size);
+void
+serve_forget_packed_artifact(
+        serve_state_t state,
+        const ruint32_t run_uuid[4],
+        const unsigned char *name);
+struct server_framework_job *
+serve_pack_runs(
+        const struct contest_desc *cnts,
+        serve_state_t state,
+        int force_flag);
+
+void serve_flush_audit_log(serve_state_t state);
+int
+serve_read_audit_log(
+        serve_state_t state,
+        const struct run_entry *re,
+        char **p_data,
+        size_t *p_size);
+void serve_remove_audit_log(serve_state_t state, int run_id);
+void
+serve_renumber_audit_log(
+        serve_state_t state,
+        int count,
+        const int *from,
+        const int *to);
+
 #endif /* __SERVE_STATE_H__ */
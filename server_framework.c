@@ -36,8 +36,9 @@
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/time.h>
 #include <errno.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -67,6 +68,7 @@ struct watchlist
 {
   struct watchlist *next, *prev;
   int pending_removal;
+  int poll_index;
   struct server_framework_watch w;
 };
 
@@ -84,6 +86,14 @@ struct server_framework_state
 
   struct watchlist *w_first, *w_last;
 
+  // the descriptors polled in the main loop, they are not limited by
+  // FD_SETSIZE, so the many descriptors kept by the idle requests do
+  // not matter
+  int poll_u, poll_a;
+  struct pollfd *poll_fds;
+
+  struct server_framework_loop_stats *loop_stats;
+
   void *user_data;
 };
 
@@ -102,6 +112,7 @@ client_state_new(struct server_framework_state *state, int fd)
 
   p->id = state->client_id++;
   p->fd = fd;
+  p->poll_index = -1;
   p->client_fds[0] = -1;
   p->client_fds[1] = -1;
   p->state = STATE_READ_CREDS;
@@ -120,6 +131,65 @@ void
 nsf_new_autoclose(struct server_framework_state *state,
                   struct client_state *p, void *write_buf,
                   size_t write_len)
+{
+  nsf_new_autoclose_fds(state, p->client_fds, write_buf, write_len);
+}
+
+void
+nsf_new_autoclose_fds(struct server_framework_state *state,
+                      int client_fds[2], void *write_buf,
+                      size_t write_len)
+{
+  struct client_state *q;
+
+  q = client_state_new(state, client_fds[0]);
+  q->client_fds[1] = client_fds[1];
+  q->write_buf = write_buf;
+  q->write_len = write_len;
+  q->state = STATE_WRITECLOSE;
+
+  client_fds[0] = -1;
+  client_fds[1] = -1;
+}
+
+/* takes the next non-empty chunk from the write source,
+   returns 0 if there is no more data */
+static int
+next_source_chunk(struct client_state *p)
+{
+  unsigned char *buf;
+  int len, r;
+
+  if (!p->write_source) return 0;
+  while (1) {
+    buf = 0;
+    len = 0;
+    if ((r = p->write_source->next_chunk(p->write_source, &buf, &len)) <= 0) {
+      if (r < 0) err("%d: failed to produce the output", p->id);
+      xfree(buf);
+      break;
+    }
+    if (len > 0) {
+      xfree(p->write_buf);
+      p->write_buf = buf;
+      p->write_len = len;
+      p->written = 0;
+      return 1;
+    }
+    xfree(buf);
+  }
+  p->write_source->destroy(p->write_source);
+  p->write_source = 0;
+  return 0;
+}
+
+/* like nsf_new_autoclose, but the data from src is written after
+   write_buf, so the large output is never kept in memory entirely */
+void
+nsf_new_autoclose_source(struct server_framework_state *state,
+                         struct client_state *p, void *write_buf,
+                         size_t write_len,
+                         struct nsf_write_source *src)
 {
   struct client_state *q;
 
@@ -127,7 +197,11 @@ nsf_new_autoclose(struct server_framework_state *state,
   q->client_fds[1] = p->client_fds[1];
   q->write_buf = write_buf;
   q->write_len = write_len;
+  q->write_source = src;
   q->state = STATE_WRITECLOSE;
+  if (!q->write_len && !next_source_chunk(q)) {
+    q->state = STATE_DISCONNECT;
+  }
 
   p->client_fds[0] = -1;
   p->client_fds[1] = -1;
@@ -190,6 +264,7 @@ client_state_delete(struct server_framework_state *state,
   if (p->client_fds[1] >= 0) close(p->client_fds[1]);
   xfree(p->read_buf);
   xfree(p->write_buf);
+  if (p->write_source) p->write_source->destroy(p->write_source);
 
   if (state->params->cleanup_client)
     state->params->cleanup_client(state, p);
@@ -213,6 +288,7 @@ nsf_add_watch(struct server_framework_state *state,
   }
 
   XCALLOC(p, 1);
+  p->poll_index = -1;
   p->w = *w;
   if (!state->w_last) {
     state->w_first = state->w_last = p;
@@ -363,6 +439,10 @@ write_to_control_connection(struct client_state *p)
       return;
     }
     p->written += r;
+    if (p->written == p->write_len && p->state == STATE_WRITECLOSE
+        && next_source_chunk(p)) {
+      break;
+    }
     if (p->written == p->write_len) {
       if (p->state == STATE_WRITE) {
         p->state = STATE_READ_LEN;
@@ -519,71 +599,123 @@ handle_control_command(struct server_framework_state *state,
   p->read_len = 0;
 }
 
+/* adds the descriptor to the poll set, returns its index */
+static int
+add_poll_fd(struct server_framework_state *state, int fd, int events)
+{
+  struct pollfd *pfd;
+
+  if (state->poll_u == state->poll_a) {
+    if (!(state->poll_a *= 2)) state->poll_a = 64;
+    XREALLOC(state->poll_fds, state->poll_a);
+  }
+  pfd = &state->poll_fds[state->poll_u];
+  pfd->fd = fd;
+  pfd->events = events;
+  pfd->revents = 0;
+  return state->poll_u++;
+}
+
+/* like FD_ISSET for the result of select, the errors make the
+   descriptor both readable and writable */
+static int
+is_poll_ready(const struct server_framework_state *state, int index, int events)
+{
+  if (index < 0) return 0;
+  return (state->poll_fds[index].revents & (events|POLLERR|POLLHUP|POLLNVAL)) != 0;
+}
+
+static long long
+get_phase_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/* accounts the phase started at start_time, returns the start time
+   of the next phase */
+static long long
+end_phase(struct server_framework_state *state, int phase, long long start_time)
+{
+  struct server_framework_loop_stats *st = state->loop_stats;
+  long long cur_time, usec;
+
+  if (!st) return 0;
+  cur_time = get_phase_time();
+  // the statistics may be enabled in the middle of the iteration
+  if (start_time <= 0) return cur_time;
+  usec = cur_time - start_time;
+  st->total_usec[phase] += usec;
+  if (usec > st->max_usec[phase]) st->max_usec[phase] = usec;
+  return cur_time;
+}
+
 void
 nsf_main_loop(struct server_framework_state *state)
 {
   struct client_state *cur_clnt;
-  struct timeval timeout;
-  int fd_max, n, errcode;
-  fd_set rset, wset;
+  int timeout, n, errcode;
+  int socket_index;
   struct watchlist *pw;
-  int mode;
+  int mode, events;
+  long long phase_start = 0;
 
   while (1) {
     int work_done = 1;
+    if (state->loop_stats) {
+      state->loop_stats->iterations++;
+      phase_start = get_phase_time();
+    }
     if (state->params->loop_start) work_done = state->params->loop_start(state);
+    phase_start = end_phase(state, NSF_PHASE_LOOP_START, phase_start);
 
-    fd_max = -1;
-    FD_ZERO(&rset);
-    FD_ZERO(&wset);
-
+    state->poll_u = 0;
+    socket_index = -1;
     if (state->socket_fd >= 0) {
-      FD_SET(state->socket_fd, &rset);
-      if (state->socket_fd > fd_max) fd_max = state->socket_fd;
+      socket_index = add_poll_fd(state, state->socket_fd, POLLIN);
     }
 
     for (cur_clnt = state->clients_first; cur_clnt; cur_clnt = cur_clnt->next) {
+      cur_clnt->poll_index = -1;
       if (cur_clnt->state==STATE_WRITE || cur_clnt->state==STATE_WRITECLOSE) {
-        FD_SET(cur_clnt->fd, &wset);
-        if (cur_clnt->fd > fd_max) fd_max = cur_clnt->fd;
+        cur_clnt->poll_index = add_poll_fd(state, cur_clnt->fd, POLLOUT);
       } else if (cur_clnt->state >= STATE_READ_CREDS
                  && cur_clnt->state <= STATE_READ_DATA) {
-        FD_SET(cur_clnt->fd, &rset);
-        if (cur_clnt->fd > fd_max) fd_max = cur_clnt->fd;
+        cur_clnt->poll_index = add_poll_fd(state, cur_clnt->fd, POLLIN);
       }
     }
 
     remove_pending_watches(state);
     for (pw = state->w_first; pw; pw = pw->next) {
+      pw->poll_index = -1;
       if (pw->pending_removal || pw->w.fd < 0) continue;
-      if ((pw->w.mode & NSF_READ)) {
-        FD_SET(pw->w.fd, &rset);
-        if (pw->w.fd > fd_max) fd_max = pw->w.fd;
-      }
-      if ((pw->w.mode & NSF_WRITE)) {
-        FD_SET(pw->w.fd, &wset);
-        if (pw->w.fd > fd_max) fd_max = pw->w.fd;
-      }
+      events = 0;
+      if ((pw->w.mode & NSF_READ)) events |= POLLIN;
+      if ((pw->w.mode & NSF_WRITE)) events |= POLLOUT;
+      if (events) pw->poll_index = add_poll_fd(state, pw->w.fd, events);
     }
 
-    timeout.tv_sec = state->params->select_timeout;
-    if (timeout.tv_sec <= 0) timeout.tv_sec = 10;
-    timeout.tv_usec = 0;
-    if (!work_done) timeout.tv_sec = 0;
+    timeout = state->params->select_timeout;
+    if (timeout <= 0) timeout = 10;
+    timeout *= 1000;
+    if (!work_done) timeout = 0;
 
     // here's a potential race condition :-(
     // it cannot be handled properly until Linux
     // has the proper pselect implementation
     sigprocmask(SIG_SETMASK, &state->work_mask, 0);
     errno = 0;
-    n = select(fd_max + 1, &rset, &wset, 0, &timeout);
+    n = poll(state->poll_fds, state->poll_u, timeout);
     errcode = errno;
     sigprocmask(SIG_SETMASK, &state->block_mask, 0);
     errno = errcode;
     // end of race condition prone code
+    phase_start = end_phase(state, NSF_PHASE_POLL, phase_start);
 
     if (n < 0 && errno != EINTR) {
-      err("unexpected select error: %s", os_ErrorMsg());
+      err("unexpected poll error: %s", os_ErrorMsg());
       continue;
     }
 
@@ -603,16 +735,17 @@ nsf_main_loop(struct server_framework_state *state)
     for (pw = state->w_first; pw; pw = pw->next) {
       if (pw->pending_removal || pw->w.fd < 0) continue;
       mode = 0;
-      if ((pw->w.mode & NSF_READ) && FD_ISSET(pw->w.fd, &rset))
+      if ((pw->w.mode & NSF_READ) && is_poll_ready(state, pw->poll_index, POLLIN))
         mode |= NSF_READ;
-      if ((pw->w.mode & NSF_WRITE) && FD_ISSET(pw->w.fd, &wset))
+      if ((pw->w.mode & NSF_WRITE) && is_poll_ready(state, pw->poll_index, POLLOUT))
         mode |= NSF_WRITE;
       if (mode) pw->w.callback(state, &pw->w, mode);
     }
     remove_pending_watches(state);
+    phase_start = end_phase(state, NSF_PHASE_WATCHES, phase_start);
 
     // check for new control connections
-    if (state->socket_fd >= 0 && FD_ISSET(state->socket_fd, &rset)) {
+    if (is_poll_ready(state, socket_index, POLLIN)) {
       accept_new_connection(state);
     }
 
@@ -623,16 +756,17 @@ nsf_main_loop(struct server_framework_state *state)
       case STATE_READ_FDS:
       case STATE_READ_LEN:
       case STATE_READ_DATA:
-        if (FD_ISSET(cur_clnt->fd, &rset))
+        if (is_poll_ready(state, cur_clnt->poll_index, POLLIN))
           read_from_control_connection(cur_clnt);
         break;
       case STATE_WRITE:
       case STATE_WRITECLOSE:
-        if (FD_ISSET(cur_clnt->fd, &wset))
+        if (is_poll_ready(state, cur_clnt->poll_index, POLLOUT))
           write_to_control_connection(cur_clnt);
         break;
       }
     }
+    phase_start = end_phase(state, NSF_PHASE_IO, phase_start);
 
     // execute ready commands from control connections
     for (cur_clnt = state->clients_first; cur_clnt; cur_clnt = cur_clnt->next) {
@@ -652,6 +786,7 @@ nsf_main_loop(struct server_framework_state *state)
         cur_clnt = cur_clnt->next;
       }
     }
+    phase_start = end_phase(state, NSF_PHASE_COMMANDS, phase_start);
   }
 }
 
@@ -762,6 +897,9 @@ nsf_cleanup(struct server_framework_state *state)
   if (state->socket_fd >= 0) close(state->socket_fd);
   state->socket_fd = -1;
   unlink(state->params->socket_path);
+
+  xfree(state->poll_fds); state->poll_fds = 0;
+  state->poll_u = state->poll_a = 0;
 }
 
 int
@@ -770,6 +908,14 @@ nsf_is_restart_requested(struct server_framework_state *state)
   return state->restart_requested;
 }
 
+void
+nsf_set_loop_stats(
+        struct server_framework_state *state,
+        struct server_framework_loop_stats *stats)
+{
+  state->loop_stats = stats;
+}
+
 struct server_framework_state *
 nsf_init(struct server_framework_params *params, void *data)
 {
@@ -33,6 +33,16 @@ enum
   STATE_DISCONNECT,
 };
 
+/* produces the output of an autoclose connection chunk by chunk */
+struct nsf_write_source
+{
+  /* stores the next chunk (allocated with xmalloc) to *p_buf, *p_len,
+     returns 1 if a chunk is stored, 0 at the end of the data, < 0 on error */
+  int (*next_chunk)(struct nsf_write_source *src,
+                    unsigned char **p_buf, int *p_len);
+  void (*destroy)(struct nsf_write_source *src);
+};
+
 struct client_state
 {
   struct client_state *next;
@@ -41,6 +51,7 @@ struct client_state
   int id;
   int fd;
   int state;
+  int poll_index;               /* in the poll set of the main loop */
   
   int peer_pid;
   int peer_uid;
@@ -55,6 +66,7 @@ struct client_state
   int write_len;
   int written;
   unsigned char *write_buf;
+  struct nsf_write_source *write_source;
 
   int contest_id;
   void (*destroy_callback)(struct client_state*);
@@ -88,6 +100,26 @@ struct server_framework_params
   void (*post_select)(struct server_framework_state *);
 };
 
+/* the phases of the main loop */
+enum
+{
+  NSF_PHASE_LOOP_START,         /* the loop_start callback */
+  NSF_PHASE_POLL,               /* waiting for the descriptors */
+  NSF_PHASE_WATCHES,            /* post_select and the watch callbacks */
+  NSF_PHASE_IO,                 /* reading and writing the connections */
+  NSF_PHASE_COMMANDS,           /* handling the received packets */
+
+  NSF_PHASE_LAST
+};
+
+/* the time spent in the phases of the main loop */
+struct server_framework_loop_stats
+{
+  long long iterations;
+  long long total_usec[NSF_PHASE_LAST];
+  long long max_usec[NSF_PHASE_LAST];
+};
+
 struct server_framework_state *nsf_init(struct server_framework_params *params, void *data);
 int  nsf_prepare(struct server_framework_state *state);
 void nsf_cleanup(struct server_framework_state *state);
@@ -101,6 +133,15 @@ void nsf_send_reply(struct server_framework_state *state,
 void nsf_new_autoclose(struct server_framework_state *state,
                        struct client_state *p, void *write_buf,
                        size_t write_len);
+/* like nsf_new_autoclose, but for the client descriptors taken from
+   a client_state earlier, so the reply may be written later */
+void nsf_new_autoclose_fds(struct server_framework_state *state,
+                           int client_fds[2], void *write_buf,
+                           size_t write_len);
+void nsf_new_autoclose_source(struct server_framework_state *state,
+                              struct client_state *p, void *write_buf,
+                              size_t write_len,
+                              struct nsf_write_source *src);
 void nsf_close_client_fds(struct client_state *p);
 struct client_state * nsf_get_client_by_id(struct server_framework_state *,
                                            int id);
@@ -123,6 +164,10 @@ int nsf_add_watch(struct server_framework_state *,
                   struct server_framework_watch*);
 int nsf_remove_watch(struct server_framework_state *, int);
 int nsf_is_restart_requested(struct server_framework_state *);
+/* the phases are timed only while the statistics are set, NULL stops
+   the timing */
+void nsf_set_loop_stats(struct server_framework_state *,
+                        struct server_framework_loop_stats *);
 
 void nsf_err_bad_packet_length(struct server_framework_state *,
                                struct client_state *, size_t, size_t);
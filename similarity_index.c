@@ -0,0 +1,573 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "similarity_index.h"
+
+#include "reuse_xalloc.h"
+
+#include <string.h>
+#include <ctype.h>
+
+struct similarity_run
+{
+  int run_id;                   /* -1 for a removed run */
+  int user_id;
+  int fp_count;
+  unsigned *fps;                /* sorted, unique */
+};
+
+/* the runs (indices in the problem run table) a fingerprint occurs in */
+struct similarity_posting
+{
+  unsigned fp;
+  int u, a;
+  int *items;                   /* NULL for a free slot */
+};
+
+struct similarity_problem
+{
+  int run_u, run_a;
+  struct similarity_run *runs;
+  int live_count;               /* the runs not removed */
+
+  /* open addressing hash table, the size is a power of 2 */
+  int post_size, post_used;
+  struct similarity_posting *posts;
+};
+
+enum
+{
+  TOK_IDENT = 256,
+  TOK_NUMBER,
+  TOK_STRING,
+  TOK_KEYWORD = 512,
+};
+
+/* keywords of the common languages, lowercase, must be sorted */
+static const char * const keywords[] =
+{
+  "and", "array", "auto", "begin", "bool", "boolean", "break", "case",
+  "catch", "char", "class", "const", "continue", "def", "default",
+  "define", "delete", "do", "double", "downto", "elif", "else", "end",
+  "except", "extern", "false", "float", "for", "foreach", "from",
+  "function", "goto", "if", "import", "in", "include", "int", "integer",
+  "lambda", "long", "map", "namespace", "new", "nil", "not", "null", "of",
+  "or", "pair", "private", "procedure", "program", "public", "queue",
+  "real", "record", "repeat", "return", "set", "short", "signed", "sizeof",
+  "stack", "static", "std", "string", "struct", "switch", "then", "this",
+  "throw", "to", "true", "try", "typedef", "uint", "unsigned", "until",
+  "uses", "using", "var", "vector", "void", "while", "with",
+};
+
+static int
+keyword_cmp(const void *p1, const void *p2)
+{
+  return strcmp((const char *) p1, *(const char * const *) p2);
+}
+
+static int
+ident_token(const unsigned char *s, size_t len)
+{
+  char buf[32];
+  const char * const *p;
+  size_t i;
+
+  if (len >= sizeof(buf)) return TOK_IDENT;
+  for (i = 0; i < len; ++i)
+    buf[i] = tolower(s[i]);
+  buf[len] = 0;
+  p = bsearch(buf, keywords, sizeof(keywords) / sizeof(keywords[0]),
+              sizeof(keywords[0]), keyword_cmp);
+  if (!p) return TOK_IDENT;
+  return TOK_KEYWORD + (p - keywords);
+}
+
+/* splits the text into the normalized tokens */
+static int
+tokenize(const unsigned char *s, size_t size, int **p_toks)
+{
+  int *toks = 0;
+  int tok_u = 0, tok_a = 0, tok;
+  size_t i = 0, j;
+  unsigned char q;
+
+  while (i < size) {
+    if (isspace(s[i])) {
+      ++i;
+      continue;
+    }
+    if (s[i] == '/' && i + 1 < size && s[i + 1] == '/') {
+      for (i += 2; i < size && s[i] != '\n'; ++i);
+      continue;
+    }
+    if (s[i] == '/' && i + 1 < size && s[i + 1] == '*') {
+      for (i += 2; i + 1 < size && (s[i] != '*' || s[i + 1] != '/'); ++i);
+      i += 2;
+      continue;
+    }
+    if (s[i] == '(' && i + 1 < size && s[i + 1] == '*') {
+      for (i += 2; i + 1 < size && (s[i] != '*' || s[i + 1] != ')'); ++i);
+      i += 2;
+      continue;
+    }
+    if (isalpha(s[i]) || s[i] == '_') {
+      for (j = i + 1; j < size && (isalnum(s[j]) || s[j] == '_'); ++j);
+      tok = ident_token(s + i, j - i);
+      i = j;
+    } else if (isdigit(s[i])) {
+      for (j = i + 1; j < size && (isalnum(s[j]) || s[j] == '.'); ++j);
+      tok = TOK_NUMBER;
+      i = j;
+    } else if (s[i] == '"' || s[i] == '\'') {
+      q = s[i];
+      for (j = i + 1; j < size && s[j] != q && s[j] != '\n'; ++j) {
+        if (s[j] == '\\' && j + 1 < size) ++j;
+      }
+      tok = TOK_STRING;
+      i = j + 1;
+    } else {
+      tok = s[i++];
+    }
+    if (tok_u == tok_a) {
+      if (!(tok_a *= 2)) tok_a = 256;
+      XREALLOC(toks, tok_a);
+    }
+    toks[tok_u++] = tok;
+  }
+  *p_toks = toks;
+  return tok_u;
+}
+
+static unsigned
+mix_hash(unsigned long long h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return (unsigned) (h ^ (h >> 32));
+}
+
+static int
+unsigned_sort_func(const void *p1, const void *p2)
+{
+  unsigned v1 = *(const unsigned *) p1, v2 = *(const unsigned *) p2;
+  if (v1 < v2) return -1;
+  return v1 > v2;
+}
+
+int
+similarity_fingerprint(
+        const unsigned char *text,
+        size_t size,
+        int kgram,
+        int window,
+        unsigned **p_fps)
+{
+  int *toks = 0;
+  unsigned *hashes = 0, *fps = 0;
+  unsigned long long h = 0, top = 1;
+  int tok_u, hash_u, fp_u = 0, i, j, m, last = -1;
+  const unsigned long long base = 1000003;
+
+  *p_fps = 0;
+  if (kgram <= 0) kgram = SIMILARITY_DEFAULT_KGRAM;
+  if (window <= 0) window = SIMILARITY_DEFAULT_WINDOW;
+
+  tok_u = tokenize(text, size, &toks);
+  if ((hash_u = tok_u - kgram + 1) <= 0) {
+    xfree(toks);
+    return 0;
+  }
+
+  // the rolling hashes of the k-grams
+  XCALLOC(hashes, hash_u);
+  for (i = 1; i < kgram; ++i) top *= base;
+  for (i = 0; i < tok_u; ++i) {
+    if (i >= kgram) h -= top * toks[i - kgram];
+    h = h * base + toks[i];
+    if (i >= kgram - 1) hashes[i - kgram + 1] = mix_hash(h);
+  }
+  xfree(toks);
+
+  // winnowing: the rightmost minimal hash in each window
+  if (window > hash_u) window = hash_u;
+  XCALLOC(fps, hash_u - window + 1);
+  for (i = 0; i + window <= hash_u; ++i) {
+    m = i;
+    for (j = i + 1; j < i + window; ++j) {
+      if (hashes[j] <= hashes[m]) m = j;
+    }
+    if (m != last) {
+      fps[fp_u++] = hashes[m];
+      last = m;
+    }
+  }
+  xfree(hashes);
+
+  qsort(fps, fp_u, sizeof(fps[0]), unsigned_sort_func);
+  for (i = 1, j = 1; i < fp_u; ++i) {
+    if (fps[i] != fps[j - 1]) fps[j++] = fps[i];
+  }
+  *p_fps = fps;
+  return j;
+}
+
+struct similarity_index *
+similarity_index_create(int kgram, int window)
+{
+  struct similarity_index *idx;
+
+  XCALLOC(idx, 1);
+  if (kgram <= 0) kgram = SIMILARITY_DEFAULT_KGRAM;
+  if (window <= 0) window = SIMILARITY_DEFAULT_WINDOW;
+  idx->kgram = kgram;
+  idx->window = window;
+  idx->common_min = 20;
+  idx->common_percent = 2;
+  return idx;
+}
+
+static void
+free_problem(struct similarity_problem *prob)
+{
+  int i;
+
+  if (!prob) return;
+  for (i = 0; i < prob->run_u; ++i)
+    xfree(prob->runs[i].fps);
+  xfree(prob->runs);
+  for (i = 0; i < prob->post_size; ++i)
+    xfree(prob->posts[i].items);
+  xfree(prob->posts);
+  xfree(prob);
+}
+
+struct similarity_index *
+similarity_index_free(struct similarity_index *idx)
+{
+  int i;
+
+  if (!idx) return 0;
+  for (i = 0; i < idx->prob_a; ++i)
+    free_problem(idx->probs[i]);
+  xfree(idx->probs);
+  xfree(idx->run_probs);
+  xfree(idx->run_idx);
+  xfree(idx->pending);
+  memset(idx, 0, sizeof(*idx));
+  xfree(idx);
+  return 0;
+}
+
+static struct similarity_posting *
+find_posting(struct similarity_problem *prob, unsigned fp)
+{
+  unsigned mask = prob->post_size - 1;
+  unsigned i = (fp * 2654435761U) & mask;
+
+  while (prob->posts[i].items) {
+    if (prob->posts[i].fp == fp) return &prob->posts[i];
+    i = (i + 1) & mask;
+  }
+  return &prob->posts[i];
+}
+
+static void
+grow_postings(struct similarity_problem *prob)
+{
+  struct similarity_posting *old = prob->posts, *p;
+  int old_size = prob->post_size, i;
+
+  if (!(prob->post_size *= 2)) prob->post_size = 1024;
+  XCALLOC(prob->posts, prob->post_size);
+  for (i = 0; i < old_size; ++i) {
+    if (!old[i].items) continue;
+    p = find_posting(prob, old[i].fp);
+    *p = old[i];
+  }
+  xfree(old);
+}
+
+int
+similarity_index_add(
+        struct similarity_index *idx,
+        int run_id,
+        int prob_id,
+        int user_id,
+        const unsigned char *text,
+        size_t size)
+{
+  struct similarity_problem *prob;
+  struct similarity_run *run;
+  struct similarity_posting *p;
+  int i, new_a, fp_count;
+  unsigned *fps = 0;
+
+  if (run_id < 0 || prob_id <= 0) return -1;
+  if (run_id < idx->run_a && idx->run_probs[run_id] > 0) return -1;
+
+  if (run_id >= idx->run_a) {
+    if (!(new_a = idx->run_a)) new_a = 1024;
+    while (run_id >= new_a) new_a *= 2;
+    XREALLOC(idx->run_probs, new_a);
+    XREALLOC(idx->run_idx, new_a);
+    for (i = idx->run_a; i < new_a; ++i) {
+      idx->run_probs[i] = 0;
+      idx->run_idx[i] = -1;
+    }
+    idx->run_a = new_a;
+  }
+  if (prob_id >= idx->prob_a) {
+    if (!(new_a = idx->prob_a)) new_a = 32;
+    while (prob_id >= new_a) new_a *= 2;
+    XREALLOC(idx->probs, new_a);
+    memset(idx->probs + idx->prob_a, 0,
+           (new_a - idx->prob_a) * sizeof(idx->probs[0]));
+    idx->prob_a = new_a;
+  }
+  if (!(prob = idx->probs[prob_id])) {
+    XCALLOC(prob, 1);
+    idx->probs[prob_id] = prob;
+  }
+
+  fp_count = similarity_fingerprint(text, size, idx->kgram, idx->window, &fps);
+
+  if (prob->run_u == prob->run_a) {
+    if (!(prob->run_a *= 2)) prob->run_a = 64;
+    XREALLOC(prob->runs, prob->run_a);
+  }
+  run = &prob->runs[prob->run_u];
+  memset(run, 0, sizeof(*run));
+  run->run_id = run_id;
+  run->user_id = user_id;
+  run->fp_count = fp_count;
+  run->fps = fps;
+
+  for (i = 0; i < fp_count; ++i) {
+    if ((prob->post_used + 1) * 2 > prob->post_size) grow_postings(prob);
+    p = find_posting(prob, fps[i]);
+    if (!p->items) {
+      p->fp = fps[i];
+      p->a = 4;
+      XCALLOC(p->items, p->a);
+      prob->post_used++;
+    } else if (p->u == p->a) {
+      p->a *= 2;
+      XREALLOC(p->items, p->a);
+    }
+    p->items[p->u++] = prob->run_u;
+  }
+
+  idx->run_probs[run_id] = prob_id;
+  idx->run_idx[run_id] = prob->run_u++;
+  prob->live_count++;
+  return fp_count;
+}
+
+int
+similarity_index_contains(const struct similarity_index *idx, int run_id)
+{
+  return run_id >= 0 && run_id < idx->run_a && idx->run_probs[run_id] > 0;
+}
+
+int
+similarity_index_remove(struct similarity_index *idx, int run_id)
+{
+  struct similarity_problem *prob;
+  struct similarity_run *run;
+  struct similarity_posting *p;
+  int a, i, j;
+
+  if (!similarity_index_contains(idx, run_id)) return -1;
+  prob = idx->probs[idx->run_probs[run_id]];
+  a = idx->run_idx[run_id];
+  run = &prob->runs[a];
+
+  // the slot of the run stays in the table, so the postings
+  // of the other runs are not renumbered
+  for (i = 0; i < run->fp_count; ++i) {
+    p = find_posting(prob, run->fps[i]);
+    if (!p->items) continue;
+    for (j = 0; j < p->u && p->items[j] != a; ++j);
+    if (j < p->u) p->items[j] = p->items[--p->u];
+  }
+  xfree(run->fps);
+  run->fps = 0;
+  run->fp_count = 0;
+  run->run_id = -1;
+  prob->live_count--;
+  idx->run_probs[run_id] = 0;
+  idx->run_idx[run_id] = -1;
+  return 0;
+}
+
+/* counts the fingerprints shared by the run a with the runs > min_b */
+static int
+count_shared(
+        const struct similarity_index *idx,
+        const struct similarity_problem *prob,
+        int a,
+        int min_b,
+        int *counts,
+        int *touched)
+{
+  const struct similarity_run *run = &prob->runs[a];
+  struct similarity_posting *p;
+  int limit, i, j, b, touched_u = 0;
+
+  limit = prob->live_count * idx->common_percent / 100;
+  if (limit < idx->common_min) limit = idx->common_min;
+
+  for (i = 0; i < run->fp_count; ++i) {
+    p = find_posting((struct similarity_problem *) prob, run->fps[i]);
+    if (!p->items || p->u > limit) continue;
+    for (j = 0; j < p->u; ++j) {
+      if ((b = p->items[j]) <= min_b || b == a) continue;
+      if (!counts[b]++) touched[touched_u++] = b;
+    }
+  }
+  return touched_u;
+}
+
+static int
+match_sort_func(const void *p1, const void *p2)
+{
+  const struct similarity_match *m1 = (const struct similarity_match *) p1;
+  const struct similarity_match *m2 = (const struct similarity_match *) p2;
+
+  if (m1->score != m2->score) return m2->score - m1->score;
+  if (m1->shared != m2->shared) return m2->shared - m1->shared;
+  if (m1->run_id1 != m2->run_id1) return m1->run_id1 - m2->run_id1;
+  return m1->run_id2 - m2->run_id2;
+}
+
+/* converts the counters to the matches and clears the counters */
+static int
+collect_matches(
+        const struct similarity_problem *prob,
+        int a,
+        int same_user,
+        int threshold,
+        int *counts,
+        const int *touched,
+        int touched_u,
+        struct similarity_match *out)
+{
+  const struct similarity_run *ra = &prob->runs[a], *rb;
+  int i, b, min_count, out_u = 0, score;
+
+  for (i = 0; i < touched_u; ++i) {
+    b = touched[i];
+    rb = &prob->runs[b];
+    if (same_user || ra->user_id != rb->user_id) {
+      min_count = ra->fp_count;
+      if (rb->fp_count < min_count) min_count = rb->fp_count;
+      score = counts[b] * 100 / min_count;
+      if (score >= threshold) {
+        out[out_u].run_id1 = ra->run_id;
+        out[out_u].run_id2 = rb->run_id;
+        out[out_u].shared = counts[b];
+        out[out_u].score = score;
+        ++out_u;
+      }
+    }
+    counts[b] = 0;
+  }
+  return out_u;
+}
+
+int
+similarity_index_top(
+        struct similarity_index *idx,
+        int run_id,
+        int same_user,
+        int count,
+        struct similarity_match *out)
+{
+  struct similarity_problem *prob;
+  struct similarity_match *matches;
+  int *counts, *touched;
+  int a, touched_u, match_u;
+
+  if (run_id < 0 || run_id >= idx->run_a || idx->run_probs[run_id] <= 0)
+    return -1;
+  prob = idx->probs[idx->run_probs[run_id]];
+  a = idx->run_idx[run_id];
+
+  XCALLOC(counts, prob->run_u);
+  XCALLOC(touched, prob->run_u);
+  touched_u = count_shared(idx, prob, a, -1, counts, touched);
+  XCALLOC(matches, touched_u + 1);
+  match_u = collect_matches(prob, a, same_user, 0, counts, touched, touched_u,
+                            matches);
+  qsort(matches, match_u, sizeof(matches[0]), match_sort_func);
+  if (count > match_u) count = match_u;
+  if (count > 0) memcpy(out, matches, count * sizeof(out[0]));
+
+  xfree(matches);
+  xfree(touched);
+  xfree(counts);
+  return count;
+}
+
+int
+similarity_index_pairs(
+        struct similarity_index *idx,
+        int prob_id,
+        int same_user,
+        int threshold,
+        struct similarity_match **p_out)
+{
+  struct similarity_problem *prob;
+  struct similarity_match *out = 0;
+  int out_u = 0, out_a = 0;
+  int *counts, *touched;
+  int a, touched_u;
+
+  *p_out = 0;
+  if (prob_id <= 0 || prob_id >= idx->prob_a || !(prob = idx->probs[prob_id]))
+    return 0;
+
+  XCALLOC(counts, prob->run_u);
+  XCALLOC(touched, prob->run_u);
+  for (a = 0; a < prob->run_u; ++a) {
+    // each pair is counted once, from its smaller index
+    touched_u = count_shared(idx, prob, a, a, counts, touched);
+    if (out_u + touched_u > out_a) {
+      if (!out_a) out_a = 64;
+      while (out_u + touched_u > out_a) out_a *= 2;
+      XREALLOC(out, out_a);
+    }
+    out_u += collect_matches(prob, a, same_user, threshold, counts, touched,
+                             touched_u, out + out_u);
+  }
+  xfree(touched);
+  xfree(counts);
+
+  if (out_u > 0) qsort(out, out_u, sizeof(out[0]), match_sort_func);
+  *p_out = out;
+  return out_u;
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
@@ -0,0 +1,132 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __SIMILARITY_INDEX_H__
+#define __SIMILARITY_INDEX_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdlib.h>
+
+/*
+ * Source similarity index.
+ *
+ * The source text is split into tokens, the identifiers, the numbers
+ * and the string literals are replaced with generic tokens, the
+ * comments and the whitespace are dropped, so the renaming of the
+ * variables and the reformatting do not affect the result. The k-grams
+ * of the tokens are hashed and the fingerprints are selected from the
+ * hashes by the winnowing algorithm (the minimal hash in each window
+ * of the given width).
+ *
+ * The index is kept separately for each problem, the runs are added
+ * one by one, and the index maps each fingerprint to the runs it
+ * occurs in. The fingerprints, which occur in too many runs (the
+ * common boilerplate), are ignored by the queries.
+ */
+
+enum
+{
+  SIMILARITY_DEFAULT_KGRAM = 12,
+  SIMILARITY_DEFAULT_WINDOW = 8,
+};
+
+struct similarity_problem;
+
+struct similarity_index
+{
+  int kgram;
+  int window;
+
+  /* the fingerprints occuring in more than max(common_min,
+     common_percent% of the runs of the problem) are ignored */
+  int common_min;
+  int common_percent;
+
+  /* indexed by prob_id */
+  int prob_a;
+  struct similarity_problem **probs;
+
+  /* indexed by run_id, the problem and the index in the problem */
+  int run_a;
+  int *run_probs;
+  int *run_idx;
+
+  /* the first run not yet looked at, maintained by the caller */
+  int next_run_id;
+  /* the runs before next_run_id to look at again (the source was not
+     available yet, or the run was changed), maintained by the caller */
+  int pending_u, pending_a;
+  int *pending;
+};
+
+struct similarity_match
+{
+  int run_id1;
+  int run_id2;
+  int shared;                   /* the number of the common fingerprints */
+  int score;                    /* shared, percent of the smaller run */
+};
+
+struct similarity_index *similarity_index_create(int kgram, int window);
+struct similarity_index *similarity_index_free(struct similarity_index *idx);
+
+/* returns the number of the fingerprints, or -1 */
+int
+similarity_fingerprint(
+        const unsigned char *text,
+        size_t size,
+        int kgram,
+        int window,
+        unsigned **p_fps);
+
+/* returns the number of the fingerprints of the run, or -1 if the run
+   is already indexed */
+int
+similarity_index_add(
+        struct similarity_index *idx,
+        int run_id,
+        int prob_id,
+        int user_id,
+        const unsigned char *text,
+        size_t size);
+
+/* checks that the run is in the index */
+int similarity_index_contains(const struct similarity_index *idx, int run_id);
+
+/* removes the run from the index, returns -1, if it is not indexed */
+int similarity_index_remove(struct similarity_index *idx, int run_id);
+
+/* stores at most count runs most similar to run_id into out,
+   returns the number of stored runs, or -1 if run_id is not indexed */
+int
+similarity_index_top(
+        struct similarity_index *idx,
+        int run_id,
+        int same_user,
+        int count,
+        struct similarity_match *out);
+
+/* finds all the pairs of runs of the problem with score >= threshold,
+   the result is sorted by score and allocated with xmalloc,
+   returns the number of pairs */
+int
+similarity_index_pairs(
+        struct similarity_index *idx,
+        int prob_id,
+        int same_user,
+        int threshold,
+        struct similarity_match **p_out);
+
+#endif /* __SIMILARITY_INDEX_H__ */
@@ -0,0 +1,622 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "stand_timeline.h"
+#include "runlog.h"
+#include "prepare.h"
+
+#include "reuse_xalloc.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+enum
+{
+  MIN_CHECKPOINT_STEP = 1024,
+  /* more changes at once are applied by rebuilding the stream */
+  MAX_CHANGE_COUNT = 256,
+};
+
+/* the position of a run in the stream */
+enum
+{
+  RUN_NOT_VISIBLE = -1,
+  RUN_VIRTUAL_MARK = -2,        /* a virtual start or stop */
+};
+
+struct stand_timeline_event
+{
+  int dur;                      /* the time since the virtual start */
+  int run_id;
+  int cell;
+  int status;
+  int score;
+};
+
+/* what is known about each run of the runlog */
+struct stand_timeline_run
+{
+  int dur;                      /* the key in the stream, or RUN_* */
+  int user_id;
+};
+
+/* the state of the cells before the event cp_index * step */
+struct stand_timeline_checkpoint
+{
+  int cell_count;
+  struct stand_timeline_cell *cells;
+};
+
+struct stand_timeline
+{
+  int change_serial;
+  int valid;
+
+  // the cells, user_cells[user_id][prob_id] is the cell index + 1
+  int key_u, key_a;
+  struct stand_timeline_key *keys;
+  int user_a;
+  int **user_cells;
+  int prob_count;
+
+  // the runs ordered by the duration, then by the run_id
+  int ev_u, ev_a;
+  struct stand_timeline_event *evs;
+
+  // indexed by run_id
+  int run_u, run_a;
+  struct stand_timeline_run *runs;
+
+  // the checkpoints of the cells of this kind
+  int kind;
+  int step;
+  int cp_u, cp_a;
+  struct stand_timeline_checkpoint *cps;
+  // the checkpoints after this event position are to be rebuilt
+  int cp_diverge;
+
+  // the result of the last request
+  int work_a;
+  struct stand_timeline_cell *work;
+  int run_ids_a;
+  int *run_ids;
+};
+
+struct stand_timeline *
+stand_timeline_free(struct stand_timeline *tl)
+{
+  int i;
+
+  if (!tl) return 0;
+  for (i = 0; i < tl->user_a; ++i)
+    xfree(tl->user_cells[i]);
+  xfree(tl->user_cells);
+  xfree(tl->keys);
+  xfree(tl->evs);
+  xfree(tl->runs);
+  for (i = 0; i < tl->cp_u; ++i)
+    xfree(tl->cps[i].cells);
+  xfree(tl->cps);
+  xfree(tl->work);
+  xfree(tl->run_ids);
+  memset(tl, 0, sizeof(*tl));
+  xfree(tl);
+  return 0;
+}
+
+int
+stand_timeline_is_supported(const serve_state_t state)
+{
+  int i;
+
+  if (!state->probs) return 0;
+  for (i = 1; i <= state->max_prob; ++i) {
+    if (state->probs[i] && state->probs[i]->stand_column[0]) return 0;
+  }
+  return 1;
+}
+
+static int
+get_cell(struct stand_timeline *tl, int user_id, int prob_id)
+{
+  int new_a;
+  int **new_uc;
+  struct stand_timeline_key *key;
+
+  if (user_id >= tl->user_a) {
+    if (!(new_a = tl->user_a)) new_a = 128;
+    while (user_id >= new_a) new_a *= 2;
+    XCALLOC(new_uc, new_a);
+    if (tl->user_a > 0)
+      memcpy(new_uc, tl->user_cells, tl->user_a * sizeof(new_uc[0]));
+    xfree(tl->user_cells);
+    tl->user_cells = new_uc;
+    tl->user_a = new_a;
+  }
+  if (!tl->user_cells[user_id])
+    XCALLOC(tl->user_cells[user_id], tl->prob_count);
+  if (tl->user_cells[user_id][prob_id] > 0)
+    return tl->user_cells[user_id][prob_id] - 1;
+
+  if (tl->key_u == tl->key_a) {
+    if (!(tl->key_a *= 2)) tl->key_a = 256;
+    XREALLOC(tl->keys, tl->key_a);
+  }
+  key = &tl->keys[tl->key_u];
+  key->user_id = user_id;
+  key->prob_id = prob_id;
+  tl->user_cells[user_id][prob_id] = ++tl->key_u;
+  return tl->key_u - 1;
+}
+
+static int
+event_sort_func(const void *v1, const void *v2)
+{
+  const struct stand_timeline_event *e1 = v1;
+  const struct stand_timeline_event *e2 = v2;
+
+  if (e1->dur != e2->dur) return e1->dur < e2->dur ? -1 : 1;
+  if (e1->run_id != e2->run_id) return e1->run_id < e2->run_id ? -1 : 1;
+  return 0;
+}
+
+/* makes the event for the run visible in the standings, as in
+   do_write_standings, returns the position of the run in the stream */
+static int
+make_event(
+        serve_state_t state,
+        struct stand_timeline *tl,
+        int run_id,
+        struct stand_timeline_event *ev)
+{
+  const struct run_entry *pe;
+  const struct section_problem_data *prob;
+  time_t tstart;
+
+  pe = &run_get_entries_ptr(state->runlog_state)[run_id];
+  if (pe->status == RUN_VIRTUAL_START || pe->status == RUN_VIRTUAL_STOP)
+    return RUN_VIRTUAL_MARK;
+  if (pe->status == RUN_EMPTY) return RUN_NOT_VISIBLE;
+  if (pe->user_id <= 0) return RUN_NOT_VISIBLE;
+  if (pe->prob_id <= 0 || pe->prob_id > state->max_prob)
+    return RUN_NOT_VISIBLE;
+  if (!(prob = state->probs[pe->prob_id]) || prob->hidden)
+    return RUN_NOT_VISIBLE;
+  if (pe->is_hidden) return RUN_NOT_VISIBLE;
+  tstart = run_get_virtual_start_time(state->runlog_state, pe->user_id);
+  if (tstart <= 0) return RUN_NOT_VISIBLE;
+
+  memset(ev, 0, sizeof(*ev));
+  ev->dur = 0;
+  if (pe->time > tstart) ev->dur = pe->time - tstart;
+  ev->run_id = run_id;
+  ev->cell = get_cell(tl, pe->user_id, pe->prob_id);
+  ev->status = pe->status;
+  ev->score = pe->score;
+  return ev->dur;
+}
+
+/* collects all the runs to the stream */
+static void
+rebuild_stream(serve_state_t state, struct stand_timeline *tl)
+{
+  int r_tot = run_get_total(state->runlog_state);
+  const struct run_entry *runs = run_get_entries_ptr(state->runlog_state);
+  int k;
+
+  if (r_tot > tl->ev_a) {
+    xfree(tl->evs);
+    tl->ev_a = r_tot;
+    XCALLOC(tl->evs, tl->ev_a);
+  }
+  if (r_tot > tl->run_a) {
+    xfree(tl->runs);
+    tl->run_a = r_tot;
+    XCALLOC(tl->runs, tl->run_a);
+  }
+  tl->ev_u = 0;
+  for (k = 0; k < r_tot; ++k) {
+    tl->runs[k].dur = make_event(state, tl, k, &tl->evs[tl->ev_u]);
+    tl->runs[k].user_id = runs[k].user_id;
+    if (tl->runs[k].dur >= 0) tl->ev_u++;
+  }
+  tl->run_u = r_tot;
+  if (tl->ev_u > 1)
+    qsort(tl->evs, tl->ev_u, sizeof(tl->evs[0]), event_sort_func);
+  tl->cp_diverge = 0;
+}
+
+/* the first event not less than (dur, run_id) */
+static int
+find_event(const struct stand_timeline *tl, int dur, int run_id)
+{
+  int l = 0, r = tl->ev_u, m;
+
+  while (l < r) {
+    m = (l + r) / 2;
+    if (tl->evs[m].dur < dur
+        || (tl->evs[m].dur == dur && tl->evs[m].run_id < run_id)) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+  return l;
+}
+
+/* moves the changed run in the stream, returns 1, if the run is a virtual
+   start or stop, so the other runs of its user (old_user_id and the
+   current one) may be moved as well */
+static int
+update_run(
+        serve_state_t state,
+        struct stand_timeline *tl,
+        int run_id,
+        int *p_old_user_id)
+{
+  struct stand_timeline_event ev;
+  struct stand_timeline_run *tr;
+  int pos, dur;
+
+  if (run_id >= tl->run_a) {
+    tl->run_a *= 2;
+    if (tl->run_a <= run_id) tl->run_a = run_id + 1;
+    XREALLOC(tl->runs, tl->run_a);
+  }
+  while (tl->run_u <= run_id) {
+    tl->runs[tl->run_u].dur = RUN_NOT_VISIBLE;
+    tl->runs[tl->run_u].user_id = 0;
+    tl->run_u++;
+  }
+  tr = &tl->runs[run_id];
+  *p_old_user_id = tr->user_id;
+
+  dur = make_event(state, tl, run_id, &ev);
+  if (tr->dur >= 0) {
+    pos = find_event(tl, tr->dur, run_id);
+    if (dur >= 0 && !memcmp(&ev, &tl->evs[pos], sizeof(ev))) return 0;
+    memmove(&tl->evs[pos], &tl->evs[pos + 1],
+            (tl->ev_u - pos - 1) * sizeof(tl->evs[0]));
+    tl->ev_u--;
+    if (pos < tl->cp_diverge) tl->cp_diverge = pos;
+  }
+  if (dur >= 0) {
+    if (tl->ev_u == tl->ev_a) {
+      if (!(tl->ev_a *= 2)) tl->ev_a = 256;
+      XREALLOC(tl->evs, tl->ev_a);
+    }
+    pos = find_event(tl, dur, run_id);
+    memmove(&tl->evs[pos + 1], &tl->evs[pos],
+            (tl->ev_u - pos) * sizeof(tl->evs[0]));
+    tl->evs[pos] = ev;
+    tl->ev_u++;
+    if (pos < tl->cp_diverge) tl->cp_diverge = pos;
+  }
+  tr->user_id = run_get_entries_ptr(state->runlog_state)[run_id].user_id;
+  if (dur == RUN_VIRTUAL_MARK || tr->dur == RUN_VIRTUAL_MARK) {
+    tr->dur = dur;
+    return 1;
+  }
+  tr->dur = dur;
+  return 0;
+}
+
+/* moves all the runs of the user after its virtual start is changed */
+static void
+update_user_runs(serve_state_t state, struct stand_timeline *tl, int user_id)
+{
+  int r_tot = run_get_total(state->runlog_state);
+  const struct run_entry *runs = run_get_entries_ptr(state->runlog_state);
+  int k, old_user_id;
+
+  if (user_id <= 0) return;
+  for (k = 0; k < r_tot; ++k) {
+    if (runs[k].user_id == user_id
+        || (k < tl->run_u && tl->runs[k].user_id == user_id))
+      update_run(state, tl, k, &old_user_id);
+  }
+}
+
+/* brings the stream up to date with the runlog */
+static void
+update_stream(serve_state_t state, struct stand_timeline *tl)
+{
+  int changes[MAX_CHANGE_COUNT];
+  int change_count = -1, i, old_user_id;
+  const struct run_entry *runs = run_get_entries_ptr(state->runlog_state);
+
+  if (tl->valid)
+    change_count = run_get_changes(state->runlog_state, tl->change_serial,
+                                   MAX_CHANGE_COUNT, changes);
+  if (change_count < 0 || tl->run_u > run_get_total(state->runlog_state)) {
+    rebuild_stream(state, tl);
+    return;
+  }
+  for (i = 0; i < change_count; ++i) {
+    if (changes[i] >= run_get_total(state->runlog_state)) {
+      rebuild_stream(state, tl);
+      return;
+    }
+    if (update_run(state, tl, changes[i], &old_user_id)) {
+      update_user_runs(state, tl, old_user_id);
+      if (runs[changes[i]].user_id != old_user_id)
+        update_user_runs(state, tl, runs[changes[i]].user_id);
+    }
+  }
+}
+
+static void
+apply_acm_event(
+        serve_state_t state,
+        const struct stand_timeline *tl,
+        struct stand_timeline_cell *cells,
+        const struct stand_timeline_event *ev)
+{
+  struct stand_timeline_cell *c = &cells[ev->cell];
+  const struct section_problem_data *prob;
+
+  prob = state->probs[tl->keys[ev->cell].prob_id];
+  if (ev->status == RUN_OK) {
+    if (c->calc > 0) return;
+    c->calc = 1 - c->calc;
+    c->ok_run = ev->run_id;
+    c->ok_dur = ev->dur;
+  } else if ((ev->status == RUN_COMPILE_ERR
+              || ev->status == RUN_STYLE_ERR
+              || ev->status == RUN_REJECTED)
+             && !prob->ignore_compile_errors) {
+    if (c->calc <= 0) c->calc--;
+  } else if (run_is_failed_attempt(ev->status)) {
+    if (c->calc <= 0) c->calc--;
+  } else if (ev->status == RUN_DISQUALIFIED) {
+    c->flags |= STAND_CELL_DISQ;
+  } else if (ev->status == RUN_PENDING_REVIEW) {
+    c->flags |= STAND_CELL_PR;
+  } else if (ev->status == RUN_PENDING || ev->status == RUN_ACCEPTED) {
+    c->flags |= STAND_CELL_TRANS;
+  } else if (ev->status >= RUN_TRANSIENT_FIRST
+             && ev->status <= RUN_TRANSIENT_LAST) {
+    c->flags |= STAND_CELL_TRANS;
+  } else if (ev->status == RUN_CHECK_FAILED) {
+    c->flags |= STAND_CELL_CF;
+  }
+}
+
+/* the same as in do_write_moscow_standings */
+static void
+apply_moscow_event(
+        serve_state_t state,
+        const struct stand_timeline *tl,
+        struct stand_timeline_cell *cells,
+        const struct stand_timeline_event *ev)
+{
+  struct stand_timeline_cell *c = &cells[ev->cell];
+  const struct section_problem_data *prob;
+
+  prob = state->probs[tl->keys[ev->cell].prob_id];
+  if (c->calc > 0) return;
+  if ((ev->status >= RUN_TRANSIENT_FIRST && ev->status <= RUN_TRANSIENT_LAST)
+      || ev->status == RUN_PENDING) {
+    c->flags |= STAND_CELL_TRANS;
+  } else if (ev->status == RUN_OK) {
+    c->calc = 1;
+    c->att = c->total_att;
+    c->ok_run = ev->run_id;
+    c->ok_dur = ev->dur;
+    c->total_att++;
+    c->score = prob->full_score;
+    if (prob->variable_full_score) c->score = ev->score;
+  } else if (run_is_failed_attempt(ev->status)) {
+    if (ev->score > c->score) {
+      c->att = c->total_att;
+      c->ok_run = ev->run_id;
+      c->ok_dur = ev->dur;
+      c->score = ev->score;
+    }
+    c->total_att++;
+  } else if ((ev->status == RUN_COMPILE_ERR
+              || ev->status == RUN_STYLE_ERR
+              || ev->status == RUN_REJECTED)
+             && !prob->ignore_compile_errors) {
+    c->total_att++;
+  } else if (ev->status == RUN_CHECK_FAILED) {
+    c->flags |= STAND_CELL_CF;
+  }
+}
+
+static void
+apply_event(
+        serve_state_t state,
+        const struct stand_timeline *tl,
+        struct stand_timeline_cell *cells,
+        const struct stand_timeline_event *ev)
+{
+  if (tl->kind == STAND_TIMELINE_MOSCOW)
+    apply_moscow_event(state, tl, cells, ev);
+  else
+    apply_acm_event(state, tl, cells, ev);
+}
+
+/* loads the checkpoint to the work array */
+static void
+load_checkpoint(struct stand_timeline *tl, int cp_index)
+{
+  const struct stand_timeline_checkpoint *cp = &tl->cps[cp_index];
+
+  if (tl->key_u > tl->work_a) {
+    xfree(tl->work);
+    tl->work_a = tl->key_a;
+    XCALLOC(tl->work, tl->work_a);
+  }
+  if (cp->cell_count > 0)
+    memcpy(tl->work, cp->cells, cp->cell_count * sizeof(tl->work[0]));
+  if (tl->key_u > cp->cell_count)
+    memset(tl->work + cp->cell_count, 0,
+           (tl->key_u - cp->cell_count) * sizeof(tl->work[0]));
+}
+
+static void
+add_checkpoint(struct stand_timeline *tl)
+{
+  struct stand_timeline_checkpoint *cp;
+
+  if (tl->cp_u == tl->cp_a) {
+    tl->cp_a *= 2;
+    XREALLOC(tl->cps, tl->cp_a);
+  }
+  cp = &tl->cps[tl->cp_u++];
+  cp->cell_count = tl->key_u;
+  cp->cells = 0;
+  if (tl->key_u > 0) {
+    XCALLOC(cp->cells, tl->key_u);
+    memcpy(cp->cells, tl->work, tl->key_u * sizeof(cp->cells[0]));
+  }
+}
+
+/* rebuilds the checkpoints after the first moved event */
+static void
+update_checkpoints(
+        serve_state_t state,
+        struct stand_timeline *tl,
+        int kind)
+{
+  int step, i, pos;
+
+  if (kind != tl->kind) {
+    tl->kind = kind;
+    tl->cp_diverge = 0;
+  }
+  for (step = MIN_CHECKPOINT_STEP; step < tl->key_u; step *= 2);
+  if (step != tl->step) {
+    // the checkpoint positions are changed
+    tl->step = step;
+    tl->cp_diverge = 0;
+  }
+
+  // the checkpoint i is valid, if i * step <= cp_diverge
+  while (tl->cp_u > 0 && (tl->cp_u - 1) * (long long) step > tl->cp_diverge) {
+    --tl->cp_u;
+    xfree(tl->cps[tl->cp_u].cells);
+  }
+  if (!tl->cp_u) {
+    // the initial checkpoint has all the cells empty
+    if (!tl->cp_a) {
+      tl->cp_a = 16;
+      XCALLOC(tl->cps, tl->cp_a);
+    }
+    memset(&tl->cps[0], 0, sizeof(tl->cps[0]));
+    tl->cp_u = 1;
+  }
+  tl->cp_diverge = tl->ev_u;
+
+  pos = (tl->cp_u - 1) * step;
+  if (pos + step > tl->ev_u) return;
+  load_checkpoint(tl, tl->cp_u - 1);
+  while (pos + step <= tl->ev_u) {
+    for (i = pos; i < pos + step; ++i)
+      apply_event(state, tl, tl->work, &tl->evs[i]);
+    pos += step;
+    add_checkpoint(tl);
+  }
+}
+
+static struct stand_timeline *
+get_timeline(serve_state_t state)
+{
+  struct stand_timeline *tl;
+  int serial;
+
+  if ((tl = state->stand_timeline) && tl->prob_count != state->max_prob + 1) {
+    // the problems are reconfigured
+    tl = state->stand_timeline = stand_timeline_free(tl);
+  }
+  if (!tl) {
+    XCALLOC(tl, 1);
+    tl->prob_count = state->max_prob + 1;
+    state->stand_timeline = tl;
+  }
+  serial = run_get_change_serial(state->runlog_state);
+  if (!tl->valid || tl->change_serial != serial) {
+    update_stream(state, tl);
+    tl->change_serial = serial;
+    tl->valid = 1;
+  }
+  return tl;
+}
+
+/* the number of the events with the duration <= dur */
+static int
+get_event_count(const struct stand_timeline *tl, time_t dur)
+{
+  int l = 0, r = tl->ev_u, m;
+
+  if (dur < 0) return tl->ev_u;
+  while (l < r) {
+    m = (l + r) / 2;
+    if (tl->evs[m].dur <= dur) l = m + 1;
+    else r = m;
+  }
+  return l;
+}
+
+int
+stand_timeline_get(
+        serve_state_t state,
+        int kind,
+        time_t dur,
+        const struct stand_timeline_key **p_keys,
+        const struct stand_timeline_cell **p_cells)
+{
+  struct stand_timeline *tl = get_timeline(state);
+  int end, cp_index, i;
+
+  update_checkpoints(state, tl, kind);
+  end = get_event_count(tl, dur);
+  cp_index = end / tl->step;
+  if (cp_index >= tl->cp_u) cp_index = tl->cp_u - 1;
+  load_checkpoint(tl, cp_index);
+  for (i = cp_index * tl->step; i < end; ++i)
+    apply_event(state, tl, tl->work, &tl->evs[i]);
+
+  *p_keys = tl->keys;
+  *p_cells = tl->work;
+  return tl->key_u;
+}
+
+int
+stand_timeline_get_runs(
+        serve_state_t state,
+        time_t dur,
+        const int **p_run_ids)
+{
+  struct stand_timeline *tl = get_timeline(state);
+  int end, i;
+
+  end = get_event_count(tl, dur);
+  if (end > tl->run_ids_a) {
+    xfree(tl->run_ids);
+    tl->run_ids_a = tl->ev_a;
+    XCALLOC(tl->run_ids, tl->run_ids_a);
+  }
+  for (i = 0; i < end; ++i)
+    tl->run_ids[i] = tl->evs[i].run_id;
+  *p_run_ids = tl->run_ids;
+  return end;
+}
@@ -0,0 +1,102 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __STAND_TIMELINE_H__
+#define __STAND_TIMELINE_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "serve_state.h"
+
+#include <time.h>
+
+/*
+ * The time-indexed standings of a virtual contest. The runs are
+ * ordered by the time elapsed since the virtual start of their users,
+ * and the state of every (user, problem) cell is saved at the regular
+ * checkpoints of this stream. The standings at the moment `dur' of the
+ * contest are the nearest checkpoint before `dur' with the following
+ * runs up to `dur' applied.
+ *
+ * The timeline follows the runlog changes: on the first request after
+ * a change only the changed runs are moved in the stream, and only the
+ * checkpoints after the first moved run are rebuilt.
+ */
+
+/* the kinds of the cells */
+enum
+{
+  STAND_TIMELINE_ACM = 1,       /* as in do_write_standings */
+  STAND_TIMELINE_MOSCOW,        /* as in do_write_moscow_standings */
+};
+
+/* the cell flags */
+enum
+{
+  STAND_CELL_TRANS = 1,         /* a run is being tested */
+  STAND_CELL_PR = 2,            /* a run is pending review */
+  STAND_CELL_DISQ = 4,          /* a run is disqualified */
+  STAND_CELL_CF = 8,            /* a run has check failed */
+};
+
+struct stand_timeline_key
+{
+  int user_id;
+  int prob_id;
+};
+
+/* the state of a cell */
+struct stand_timeline_cell
+{
+  int calc;                     /* ACM: > 0 - solved at calc-th attempt,
+                                   <= 0 - -calc failed attempts,
+                                   MOSCOW: 1 - solved */
+  int ok_run;                   /* ACM: the run accepted, if calc > 0,
+                                   MOSCOW: the run with the best score */
+  int ok_dur;                   /* the time of ok_run since the start */
+  int flags;
+  int score;                    /* MOSCOW: the best score */
+  int att;                      /* MOSCOW: the attempts before ok_run */
+  int total_att;                /* MOSCOW: all the attempts */
+};
+
+struct stand_timeline;
+
+struct stand_timeline *stand_timeline_free(struct stand_timeline *tl);
+
+/* the timeline does not support the standings columns shared by
+   several problems, returns 0 in this case */
+int stand_timeline_is_supported(const serve_state_t state);
+
+/* computes the cells of the given kind at the moment `dur' of the
+   contest (all the runs, if dur < 0), returns the number of the cells,
+   the keys and the cells stay valid until the next call */
+int
+stand_timeline_get(
+        serve_state_t state,
+        int kind,
+        time_t dur,
+        const struct stand_timeline_key **p_keys,
+        const struct stand_timeline_cell **p_cells);
+
+/* stores the visible runs up to the moment `dur' of the contest (all the
+   runs, if dur < 0) in the order of the time since the virtual start,
+   returns their number, the array stays valid until the next call */
+int
+stand_timeline_get_runs(
+        serve_state_t state,
+        time_t dur,
+        const int **p_run_ids);
+
+#endif /* __STAND_TIMELINE_H__ */
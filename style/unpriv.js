@@ -19,6 +19,10 @@ var pingTimer = null;
 var need_reload_check = 0;
 /* number of retry to relax */
 var reload_check_count = 0;
+/* the last seen runlog change and the number of clars, -1 if the
+   changes are not followed */
+var eventsRunSerial = -1;
+var eventsClarTotal = -1;
 
 function setStatusString(string, default_string)
 {
@@ -169,7 +173,8 @@ function updateTime()
             pingTimer = window.setInterval(updateTime, 60000);
           } else {
             setStatusString(testingInProgressMessage, "TESTING IN PROGRESS...");
-            pingTimer = window.setInterval(updateTime, 5000);
+            // the changes are pushed by waitEvents
+            pingTimer = window.setInterval(updateTime, eventsRunSerial >= 0 ? 60000 : 5000);
           }
         } else {
           need_reload_check = 0;
@@ -181,6 +186,37 @@ function updateTime()
   });
 }
 
+// waits for the changes of the user runs and clars on the server
+function waitEvents()
+{
+  dojo.xhrGet({
+      url: script_name,
+      content: {
+        "SID": SID,
+        "action": NEW_SRV_ACTION_JSON_USER_EVENTS,
+        "run_serial": eventsRunSerial,
+        "clar_total": eventsClarTotal
+      },
+      handleAs: "json",
+      error: function(type, errObj) {
+        // fall back to the periodic status checks
+        eventsRunSerial = -1;
+        eventsClarTotal = -1;
+      },
+      load: function(data, ioargs) {
+        var first = (eventsRunSerial < 0);
+        eventsRunSerial = data.run_serial;
+        eventsClarTotal = data.clar_total;
+        if (!first && (data.reset != null
+                       || (data.runs != null && data.runs.length > 0)
+                       || (data.clars != null && data.clars.length > 0))) {
+          updateTime();
+        }
+        waitEvents();
+      }
+  });
+}
+
 function startClock()
 {
   clockTimer = window.setInterval(updateLocalTime, 1000);
@@ -192,6 +228,7 @@ function startClock()
   } else {
     pingTimer = window.setInterval(updateTime, 60000);
   }
+  waitEvents();
 }
 
 function submitStatus(type, data, evt)
@@ -218,6 +218,7 @@ struct sid_state
   unsigned char *user_filter;
   int user_offset;
   int user_count;
+  ejintbool_t user_by_relevance;
 
   ejintbool_t group_filter_set;
   unsigned char *group_filter;
@@ -121,6 +121,7 @@ static struct meta_info_item meta_info_sid_state_data[] =
   [SSSS_user_filter] = { SSSS_user_filter, 's', XSIZE(struct sid_state, user_filter), "user_filter", XOFFSET(struct sid_state, user_filter) },
   [SSSS_user_offset] = { SSSS_user_offset, 'i', XSIZE(struct sid_state, user_offset), "user_offset", XOFFSET(struct sid_state, user_offset) },
   [SSSS_user_count] = { SSSS_user_count, 'i', XSIZE(struct sid_state, user_count), "user_count", XOFFSET(struct sid_state, user_count) },
+  [SSSS_user_by_relevance] = { SSSS_user_by_relevance, 'B', XSIZE(struct sid_state, user_by_relevance), "user_by_relevance", XOFFSET(struct sid_state, user_by_relevance) },
   [SSSS_group_filter_set] = { SSSS_group_filter_set, 'B', XSIZE(struct sid_state, group_filter_set), "group_filter_set", XOFFSET(struct sid_state, group_filter_set) },
   [SSSS_group_filter] = { SSSS_group_filter, 's', XSIZE(struct sid_state, group_filter), "group_filter", XOFFSET(struct sid_state, group_filter) },
   [SSSS_group_offset] = { SSSS_group_offset, 'i', XSIZE(struct sid_state, group_offset), "group_offset", XOFFSET(struct sid_state, group_offset) },
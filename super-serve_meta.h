@@ -116,6 +116,7 @@ enum
   SSSS_user_filter,
   SSSS_user_offset,
   SSSS_user_count,
+  SSSS_user_by_relevance,
   SSSS_group_filter_set,
   SSSS_group_filter,
   SSSS_group_offset,
@@ -525,6 +525,15 @@ static const unsigned char * const flag_op_legends[] =
   "Do nothing", "Clear", "Set", "Toggle", NULL,
 };
 
+/* the order of the filtered users selected in the user browser */
+static int
+user_list_flags(const struct super_http_request_info *phr)
+{
+  if (phr->ss->user_filter_set && phr->ss->user_by_relevance)
+    return ULS_LIST_BY_RELEVANCE;
+  return 0;
+}
+
 int
 super_serve_op_USER_BROWSE_PAGE(
         FILE *log_f,
@@ -536,9 +545,11 @@ super_serve_op_USER_BROWSE_PAGE(
   unsigned char hbuf[1024];
   unsigned char *xml_text = 0;
   const unsigned char *user_filter = 0;
+  int user_flags = 0;
   int user_offset = 0;
   int user_count = 20;
   const unsigned char *s;
+  struct xml_arena *users_arena = 0;
   struct userlist_list *users = 0;
   int user_id, serial;
   const struct userlist_user *u;
@@ -658,6 +669,7 @@ super_serve_op_USER_BROWSE_PAGE(
 
   if (phr->ss->user_filter_set) {
     user_filter = phr->ss->user_filter;
+    user_flags = user_list_flags(phr);
     user_offset = phr->ss->user_offset;
     user_count = phr->ss->user_count;
   }
@@ -677,8 +689,11 @@ super_serve_op_USER_BROWSE_PAGE(
   fprintf(out_f, "<table class=\"b0\">");
   s = user_filter;
   if (!s) s = "";
-  fprintf(out_f, "<!--<tr><td class=\"b0\">Filter:</td><td class=\"b0\">%s</td></tr>-->",
+  fprintf(out_f, "<tr><td class=\"b0\">Filter:</td><td class=\"b0\">%s</td></tr>",
           html_input_text(buf, sizeof(buf), "user_filter", 50, 0, "%s", ARMOR(s)));
+  s = "";
+  if ((user_flags & ULS_LIST_BY_RELEVANCE)) s = " checked=\"checked\"";
+  fprintf(out_f, "<tr><td class=\"b0\">Order by relevance:</td><td class=\"b0\"><input type=\"checkbox\" name=\"user_by_relevance\" value=\"1\"%s /></td></tr>", s);
   hbuf[0] = 0;
   if (phr->ss->user_filter_set) {
     snprintf(hbuf, sizeof(hbuf), "%d", user_offset);
@@ -725,7 +740,7 @@ super_serve_op_USER_BROWSE_PAGE(
   fprintf(out_f, "</table>\n");
 
   r = userlist_clnt_list_users_2(phr->userlist_clnt, ULS_LIST_ALL_USERS_2,
-                                 contest_id, group_id, user_filter, user_offset, user_count,
+                                 contest_id, group_id, user_filter, user_flags, user_offset, user_count,
                                  &xml_text);
   if (r < 0) {
     fprintf(out_f, "</form>\n");
@@ -734,7 +749,9 @@ super_serve_op_USER_BROWSE_PAGE(
             userlist_strerror(-r));
     goto do_footer;
   }
-  users = userlist_parse_str(xml_text);
+  // the page does not change the list, so it is built in an arena
+  users_arena = xml_arena_create();
+  users = userlist_parse_str_arena(xml_text, users_arena);
   if (!users) {
     fprintf(out_f, "</form>\n");
     fprintf(out_f, "<hr/><h2>Error</h2>\n");
@@ -780,8 +797,11 @@ super_serve_op_USER_BROWSE_PAGE(
   fprintf(out_f, "</tr>\n");
 
   serial = user_offset - 1;
-  for (user_id = 1; user_id < users->user_map_size; ++user_id) {
-    if (!(u = users->user_map[user_id])) continue;
+  // the users are listed in the order of the reply
+  for (u = (const struct userlist_user*) users->b.first_down; u;
+       u = (const struct userlist_user*) u->b.right) {
+    if (u->b.tag != USERLIST_T_USER) continue;
+    user_id = u->id;
     reg = 0;
     if (contest_id > 0) {
       reg = userlist_get_user_contest(u, contest_id);
@@ -1118,7 +1138,8 @@ do_footer:
   ss_write_html_footer(out_f);
 
 cleanup:
-  userlist_free(&users->b); users = 0;
+  users = 0;
+  users_arena = xml_arena_free(users_arena);
   xfree(xml_text); xml_text = 0;
   html_armor_free(&ab);
   bitset_free(&marked);
@@ -1186,6 +1207,9 @@ super_serve_op_USER_FILTER_CHANGE_ACTION(
   FILE *extra_f = 0;
   char *extra_t = 0;
   size_t extra_z = 0;
+  const unsigned char *s = 0;
+  unsigned char *user_filter = 0;
+  int user_by_relevance = 0;
 
   ss_cgi_param_int_opt(phr, "contest_id", &contest_id, 0);
   ss_cgi_param_int_opt(phr, "group_id", &group_id, 0);
@@ -1226,16 +1250,33 @@ super_serve_op_USER_FILTER_CHANGE_ACTION(
   if (!phr->userlist_clnt) {
     goto cleanup;
   }
-  if ((r = userlist_clnt_get_count(phr->userlist_clnt, ULS_GET_USER_COUNT,
-                                   contest_id, group_id, 0, &total_count)) < 0) {
-    err("set_user_filter: get_count failed: %d", -r);
-    goto cleanup;
-  }
-  if (total_count <= 0) goto cleanup;
   if (phr->ss->user_filter_set) {
     user_offset = phr->ss->user_offset;
     user_count = phr->ss->user_count;
+    if (phr->ss->user_filter) user_filter = xstrdup(phr->ss->user_filter);
+    user_by_relevance = phr->ss->user_by_relevance;
+  }
+  if (phr->opcode == SSERV_OP_USER_FILTER_CHANGE_ACTION
+      && ss_cgi_param(phr, "user_filter", &s) > 0 && s) {
+    while (isspace(*s)) ++s;
+    if (!user_filter || strcmp(user_filter, s) != 0) user_offset = 0;
+    xfree(user_filter); user_filter = 0;
+    if (*s) user_filter = xstrdup(s);
+  }
+  if (phr->opcode == SSERV_OP_USER_FILTER_CHANGE_ACTION) {
+    value = 0;
+    ss_cgi_param_int_opt(phr, "user_by_relevance", &value, 0);
+    value = (value == 1);
+    if (value != user_by_relevance) user_offset = 0;
+    user_by_relevance = value;
+  }
+  if ((r = userlist_clnt_get_count(phr->userlist_clnt, ULS_GET_USER_COUNT,
+                                   contest_id, group_id, user_filter,
+                                   &total_count)) < 0) {
+    err("set_user_filter: get_count failed: %d", -r);
+    goto cleanup;
   }
+  if (total_count <= 0 && !user_filter) goto cleanup;
   if (user_count <= 0) user_count = 20;
   if (user_count > 200) user_count = 200;
 
@@ -1272,9 +1313,13 @@ super_serve_op_USER_FILTER_CHANGE_ACTION(
   phr->ss->user_filter_set = 1;
   phr->ss->user_offset = user_offset;
   phr->ss->user_count = user_count;
+  phr->ss->user_by_relevance = user_by_relevance;
+  xfree(phr->ss->user_filter);
+  phr->ss->user_filter = user_filter; user_filter = 0;
 
 cleanup:
   ss_redirect(out_f, phr, SSERV_OP_USER_BROWSE_PAGE, extra_t);
+  xfree(user_filter);
   bitset_free(&marked);
   xfree(marked_str);
   if (extra_f) fclose(extra_f);
@@ -1635,7 +1680,7 @@ super_serve_op_USER_SEL_RANDOM_PASSWD_PAGE(
 
   if (!phr->userlist_clnt) FAIL(S_ERR_DB_ERROR);
   r = userlist_clnt_list_users_2(phr->userlist_clnt, ULS_LIST_ALL_USERS_3,
-                                 contest_id, group_id, marked_str, 0, 0,
+                                 contest_id, group_id, marked_str, 0, 0, 0,
                                  &xml_text);
   if (r < 0) FAIL(S_ERR_DB_ERROR);
   users = userlist_parse_str(xml_text);
@@ -2295,7 +2340,7 @@ super_serve_op_USER_SEL_RANDOM_PASSWD_ACTION(
 
   if (!phr->userlist_clnt) FAIL(S_ERR_DB_ERROR);
   r = userlist_clnt_list_users_2(phr->userlist_clnt, ULS_LIST_ALL_USERS_3,
-                                 contest_id, group_id, marked_str, 0, 0,
+                                 contest_id, group_id, marked_str, 0, 0, 0,
                                  &xml_text);
   if (r < 0) FAIL(S_ERR_DB_ERROR);
   users = userlist_parse_str(xml_text);
@@ -6512,10 +6557,10 @@ super_serve_op_USER_SAVE_ACTION(
   int next_op = SSERV_OP_USER_DETAIL_PAGE;
   if (phr->opcode == SSERV_OP_USER_SAVE_AND_PREV_ACTION) {
     userlist_clnt_get_prev_user_id(phr->userlist_clnt, ULS_PREV_USER, contest_id, group_id, other_user_id,
-                                   NULL, &next_user_id);
+                                   phr->ss->user_filter, user_list_flags(phr), &next_user_id);
   } else if (phr->opcode == SSERV_OP_USER_SAVE_AND_NEXT_ACTION) {
     userlist_clnt_get_prev_user_id(phr->userlist_clnt, ULS_NEXT_USER, contest_id, group_id, other_user_id,
-                                   NULL, &next_user_id);
+                                   phr->ss->user_filter, user_list_flags(phr), &next_user_id);
   } else {
     next_op = SSERV_OP_USER_BROWSE_PAGE;
   }
@@ -6560,10 +6605,10 @@ super_serve_op_USER_CANCEL_ACTION(
   int next_op = SSERV_OP_USER_DETAIL_PAGE;
   if (phr->opcode == SSERV_OP_USER_CANCEL_AND_PREV_ACTION) {
     userlist_clnt_get_prev_user_id(phr->userlist_clnt, ULS_PREV_USER, contest_id, group_id, other_user_id,
-                                   NULL, &next_user_id);
+                                   phr->ss->user_filter, user_list_flags(phr), &next_user_id);
   } else if (phr->opcode == SSERV_OP_USER_CANCEL_AND_NEXT_ACTION) {
     userlist_clnt_get_prev_user_id(phr->userlist_clnt, ULS_NEXT_USER, contest_id, group_id, other_user_id,
-                                   NULL, &next_user_id);
+                                   phr->ss->user_filter, user_list_flags(phr), &next_user_id);
   } else {
     next_op = SSERV_OP_USER_BROWSE_PAGE;
   }
@@ -7229,7 +7274,7 @@ super_serve_op_USER_SEL_VIEW_PASSWD_PAGE(
 
   if (!phr->userlist_clnt) FAIL(S_ERR_DB_ERROR);
   r = userlist_clnt_list_users_2(phr->userlist_clnt, ULS_LIST_ALL_USERS_4,
-                                 contest_id, group_id, marked_str, 0, 0,
+                                 contest_id, group_id, marked_str, 0, 0, 0,
                                  &xml_text);
 
   if (r < 0) FAIL(S_ERR_DB_ERROR);
@@ -7863,7 +7908,7 @@ super_serve_op_GROUP_BROWSE_PAGE(
   fprintf(out_f, "</tr></table>\n");
 
   r = userlist_clnt_list_users_2(phr->userlist_clnt, ULS_LIST_ALL_GROUPS_2,
-                                 0, 0, group_filter, group_offset, group_count,
+                                 0, 0, group_filter, 0, group_offset, group_count,
                                  &xml_text);
   if (r < 0) {
     fprintf(out_f, "</form>\n");
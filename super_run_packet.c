@@ -22,6 +22,9 @@
 #include "super_run_packet_meta.h"
 #include "prepare.h"
 #include "errlog.h"
+#include "ej_byteorder.h"
+
+#include "reuse_integral.h"
 
 #include <string.h>
 
@@ -354,9 +357,16 @@ super_run_in_packet_parse_cfg(const unsigned char *path, FILE *f)
   return pkt;
 }
 
+static struct super_run_in_packet *
+super_run_in_packet_parse_bin(const unsigned char *path, const char *buf, size_t size);
+
 struct super_run_in_packet *
 super_run_in_packet_parse_cfg_str(const unsigned char *path, char *buf, size_t size)
 {
+  if (super_run_in_packet_is_bin(buf, size)) {
+    return super_run_in_packet_parse_bin(path, buf, size);
+  }
+
   FILE *f = fmemopen(buf, size, "r");
   if (!f) return NULL;
   // FIXME: parse_param closes 'f'
@@ -364,3 +374,129 @@ super_run_in_packet_parse_cfg_str(const unsigned char *path, char *buf, size_t s
   //fclose(f); f = NULL;
   return pkg;
 }
+
+/*
+ * The binary packet: the header below, then the global, problem and
+ * tester sections encoded with meta_unparse_bin. The signature starts
+ * with \0, so it never matches the beginning of a text packet.
+ */
+static const unsigned char super_run_bin_signature[8] = "\0EjSrp\n";
+
+enum { SUPER_RUN_BIN_VERSION = 1 };
+enum
+{
+  SUPER_RUN_BIN_HAS_GLOBAL = 1,
+  SUPER_RUN_BIN_HAS_PROBLEM = 2,
+  SUPER_RUN_BIN_HAS_TESTER = 4,
+};
+
+struct super_run_bin_header
+{
+  unsigned char signature[8];
+  rint32_t version;
+  rint32_t packet_len;
+  rint32_t sections;
+  rint32_t pad;
+};
+
+int
+super_run_in_packet_is_bin(const char *buf, size_t size)
+{
+  return size >= sizeof(super_run_bin_signature)
+    && !memcmp(buf, super_run_bin_signature, sizeof(super_run_bin_signature));
+}
+
+int
+super_run_in_packet_write_bin(
+        const struct super_run_in_packet *p,
+        size_t *p_out_size,
+        void **p_out_data)
+{
+  struct super_run_bin_header hdr;
+  char *out_t = NULL;
+  size_t out_z = 0;
+  FILE *out_f;
+  int sections = SUPER_RUN_BIN_HAS_GLOBAL | SUPER_RUN_BIN_HAS_PROBLEM;
+
+  if (!p || !p->global || !p->problem) return -1;
+  if (p->tester) sections |= SUPER_RUN_BIN_HAS_TESTER;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.signature, super_run_bin_signature, sizeof(hdr.signature));
+  hdr.version = cvt_host_to_bin_32(SUPER_RUN_BIN_VERSION);
+  hdr.sections = cvt_host_to_bin_32(sections);
+
+  if (!(out_f = open_memstream(&out_t, &out_z))) return -1;
+  fwrite(&hdr, sizeof(hdr), 1, out_f);
+  meta_unparse_bin(out_f, &meta_super_run_in_global_packet_methods, p->global);
+  meta_unparse_bin(out_f, &meta_super_run_in_problem_packet_methods, p->problem);
+  if (p->tester) {
+    meta_unparse_bin(out_f, &meta_super_run_in_tester_packet_methods, p->tester);
+  }
+  fclose(out_f); out_f = NULL;
+
+  hdr.packet_len = cvt_host_to_bin_32(out_z);
+  memcpy(out_t, &hdr, sizeof(hdr));
+  *p_out_size = out_z;
+  *p_out_data = out_t;
+  return 0;
+}
+
+static struct super_run_in_packet *
+super_run_in_packet_parse_bin(const unsigned char *path, const char *buf, size_t size)
+{
+  struct super_run_bin_header hdr;
+  const unsigned char *data = (const unsigned char *) buf;
+  struct super_run_in_packet *pkt = NULL;
+  size_t pos, used;
+  int sections;
+
+  if (size < sizeof(hdr)) {
+    err("%s: binary packet is too short", path);
+    return NULL;
+  }
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (cvt_bin_to_host_32(hdr.version) != SUPER_RUN_BIN_VERSION) {
+    err("%s: unsupported binary packet version %d", path,
+        cvt_bin_to_host_32(hdr.version));
+    return NULL;
+  }
+  if (cvt_bin_to_host_32(hdr.packet_len) != size) {
+    err("%s: binary packet length mismatch", path);
+    return NULL;
+  }
+  sections = cvt_bin_to_host_32(hdr.sections);
+  if ((sections & (SUPER_RUN_BIN_HAS_GLOBAL | SUPER_RUN_BIN_HAS_PROBLEM))
+      != (SUPER_RUN_BIN_HAS_GLOBAL | SUPER_RUN_BIN_HAS_PROBLEM)) {
+    err("%s: binary packet has no global or problem section", path);
+    return NULL;
+  }
+
+  pkt = super_run_in_packet_alloc();
+  pos = sizeof(hdr);
+  if (meta_parse_bin(&meta_super_run_in_global_packet_methods, pkt->global,
+                     data + pos, size - pos, &used) < 0)
+    goto fail;
+  pos += used;
+  if (meta_parse_bin(&meta_super_run_in_problem_packet_methods, pkt->problem,
+                     data + pos, size - pos, &used) < 0)
+    goto fail;
+  pos += used;
+  if ((sections & SUPER_RUN_BIN_HAS_TESTER)) {
+    if (meta_parse_bin(&meta_super_run_in_tester_packet_methods, pkt->tester,
+                       data + pos, size - pos, &used) < 0)
+      goto fail;
+    pos += used;
+  } else {
+    super_run_in_packet_free_tester(pkt);
+  }
+  if (pos != size) goto fail;
+
+  super_run_in_packet_set_default(pkt);
+  return pkt;
+
+fail:
+  err("%s: invalid binary packet", path);
+  super_run_in_packet_free(pkt);
+  return NULL;
+}
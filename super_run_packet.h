@@ -208,7 +208,16 @@ super_run_in_packet_free_tester(struct super_run_in_packet *p);
 void
 super_run_in_packet_unparse_cfg(FILE *out_f, struct super_run_in_packet *p);
 
+/* parses both the text and the binary packets */
 struct super_run_in_packet *
 super_run_in_packet_parse_cfg_str(const unsigned char *path, char *buf, size_t size);
 
+int
+super_run_in_packet_is_bin(const char *buf, size_t size);
+int
+super_run_in_packet_write_bin(
+        const struct super_run_in_packet *p,
+        size_t *p_out_size,
+        void **p_out_data);
+
 #endif /* __SUPER_RUN_PACKET_H__ */
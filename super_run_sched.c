@@ -0,0 +1,817 @@
+/* -*- c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_limits.h"
+#include "super_run_sched.h"
+#include "super_run_packet.h"
+#include "ejudge_cfg.h"
+#include "prepare_dflt.h"
+#include "fileutl.h"
+#include "errlog.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* the virtual time increment for a contest with weight 1 */
+#define SCHED_VTIME_SCALE 1000000LL
+/* the number of recent dispatches for the rejudge share accounting */
+#define SCHED_WINDOW_SIZE 64
+/* the state shared by the schedulers of one host */
+#define SCHED_SHARED_SUFFIX ".state"
+#define SCHED_SHARED_MAGIC "EjSS"
+
+struct sched_entry
+{
+  unsigned char *name;
+  int contest_id;
+  int priority;
+  time_t mtime;
+  unsigned char rejudge;
+  unsigned char ignored;
+  unsigned char dispatched;
+  unsigned char seen;
+};
+
+struct sched_contest
+{
+  int contest_id;
+  int weight;
+  long long vtime;
+  int active;
+
+  int queued;
+  int queued_rejudge;
+  int oldest_wait;
+  int live_best;
+  int rejudge_best;
+
+  int max_wait;
+  long long dispatched;
+  long long dispatched_rejudge;
+  long long total_wait;
+};
+
+struct sched_weight
+{
+  int contest_id;
+  int weight;
+};
+
+/* the shared state file: the header, then contest_count records */
+struct sched_shared_header
+{
+  unsigned char magic[4];
+  int contest_count;
+  int window_pos;
+  int window_len;
+  unsigned char window[SCHED_WINDOW_SIZE];
+};
+
+struct sched_shared_contest
+{
+  int contest_id;
+  int pad;
+  long long vtime;
+};
+
+struct super_run_sched
+{
+  unsigned char *spool_dir;
+  unsigned char *stat_path;
+  unsigned char *host;
+
+  // the virtual times and the rejudge window are shared by all
+  // the schedulers of the host through this file
+  int shared_fd;
+
+  // the spool directory is not reread, while it is not modified
+  struct timespec dir_mtime;
+  time_t scan_time;
+  int rescan;
+  int got_quit;
+
+  int aging_interval;
+  int rejudge_priority;
+  int rejudge_share;
+
+  int weight_u;
+  struct sched_weight *weights;
+
+  int entry_a, entry_u;
+  struct sched_entry *entries;
+
+  int contest_a, contest_u;
+  struct sched_contest *contests;
+
+  unsigned char window[SCHED_WINDOW_SIZE];
+  int window_pos, window_len;
+
+  long long dispatched;
+  long long dispatched_rejudge;
+  time_t last_stat_time;
+};
+
+static int
+parse_weights(struct super_run_sched *sched, const unsigned char *str)
+{
+  const unsigned char *s = str;
+  int contest_id, weight, n, count = 0;
+
+  if (!str) return 0;
+  for (s = str; *s; ++s)
+    if (*s == ',') ++count;
+  XCALLOC(sched->weights, count + 1);
+
+  s = str;
+  while (1) {
+    while (isspace(*s) || *s == ',') ++s;
+    if (!*s) break;
+    if (sscanf(s, "%d :%d%n", &contest_id, &weight, &n) != 2
+        || contest_id <= 0 || weight <= 0 || weight > 1000) {
+      err("super_run_sched: invalid sched_weights option '%s'", str);
+      return -1;
+    }
+    sched->weights[sched->weight_u].contest_id = contest_id;
+    sched->weights[sched->weight_u].weight = weight;
+    ++sched->weight_u;
+    s += n;
+  }
+  return 0;
+}
+
+static int
+get_weight(const struct super_run_sched *sched, int contest_id)
+{
+  for (int i = 0; i < sched->weight_u; ++i) {
+    if (sched->weights[i].contest_id == contest_id)
+      return sched->weights[i].weight;
+  }
+  return 1;
+}
+
+/* removes the statistics of the schedulers of this host, which
+   have terminated without cleanup */
+static void
+remove_stale_stats(const unsigned char *stat_dir, const unsigned char *node)
+{
+  DIR *d;
+  struct dirent *dd;
+  size_t node_len = strlen(node);
+  unsigned char path[PATH_MAX];
+  int pid, n;
+
+  if (!(d = opendir(stat_dir))) return;
+  while ((dd = readdir(d))) {
+    if (strncmp(dd->d_name, node, node_len) || dd->d_name[node_len] != '_')
+      continue;
+    n = 0;
+    if (sscanf(dd->d_name + node_len + 1, "%d%n", &pid, &n) != 1 || pid <= 0)
+      continue;
+    if (dd->d_name[node_len + 1 + n] && strcmp(dd->d_name + node_len + 1 + n, ".tmp"))
+      continue;
+    if (pid == getpid() || kill(pid, 0) >= 0 || errno != ESRCH) continue;
+    snprintf(path, sizeof(path), "%s/%s", stat_dir, dd->d_name);
+    info("super_run_sched: removing stale '%s'", path);
+    unlink(path);
+  }
+  closedir(d);
+}
+
+struct super_run_sched *
+super_run_sched_create(
+        const struct ejudge_cfg *config,
+        unsigned char **host_names,
+        const unsigned char *spool_dir,
+        const unsigned char *stat_dir)
+{
+  struct super_run_sched *sched = NULL;
+  unsigned char path[PATH_MAX];
+
+  if (ejudge_cfg_get_host_option_int(config, host_names, "sched_fair_share", 1, 0) <= 0)
+    return NULL;
+
+  XCALLOC(sched, 1);
+  sched->shared_fd = -1;
+  sched->spool_dir = xstrdup(spool_dir);
+  sched->host = xstrdup(host_names[0]);
+  if (stat_dir) {
+    remove_stale_stats(stat_dir, os_NodeName());
+    snprintf(path, sizeof(path), "%s/%s_%d", stat_dir, os_NodeName(), getpid());
+    sched->stat_path = xstrdup(path);
+    snprintf(path, sizeof(path), "%s/%s%s", stat_dir, os_NodeName(),
+             SCHED_SHARED_SUFFIX);
+    if ((sched->shared_fd = open(path, O_RDWR | O_CREAT, 0666)) < 0) {
+      err("super_run_sched: cannot open '%s': %s", path, os_ErrorMsg());
+      goto fail;
+    }
+    fcntl(sched->shared_fd, F_SETFD, FD_CLOEXEC);
+  }
+  sched->aging_interval = ejudge_cfg_get_host_option_int(config, host_names, "sched_aging_interval", 60, -1);
+  sched->rejudge_priority = ejudge_cfg_get_host_option_int(config, host_names, "sched_rejudge_priority", DFLT_G_REJUDGE_PRIORITY_ADJUSTMENT, INT_MIN);
+  sched->rejudge_share = ejudge_cfg_get_host_option_int(config, host_names, "sched_rejudge_share", 25, -1);
+  if (sched->aging_interval < 0) {
+    err("super_run_sched: invalid sched_aging_interval option");
+    goto fail;
+  }
+  if (sched->rejudge_priority == INT_MIN) {
+    err("super_run_sched: invalid sched_rejudge_priority option");
+    goto fail;
+  }
+  if (sched->rejudge_share < 0 || sched->rejudge_share > 100) {
+    err("super_run_sched: invalid sched_rejudge_share option");
+    goto fail;
+  }
+  if (parse_weights(sched, ejudge_cfg_get_host_option(config, host_names, "sched_weights")) < 0)
+    goto fail;
+
+  info("super_run_sched: fair share scheduling enabled, aging %d, rejudge priority %d, rejudge share %d%%",
+       sched->aging_interval, sched->rejudge_priority, sched->rejudge_share);
+  return sched;
+
+fail:
+  super_run_sched_free(sched);
+  return NULL;
+}
+
+struct super_run_sched *
+super_run_sched_free(struct super_run_sched *sched)
+{
+  if (!sched) return NULL;
+
+  if (sched->stat_path) unlink(sched->stat_path);
+  if (sched->shared_fd >= 0) close(sched->shared_fd);
+  for (int i = 0; i < sched->entry_u; ++i)
+    xfree(sched->entries[i].name);
+  xfree(sched->entries);
+  xfree(sched->contests);
+  xfree(sched->weights);
+  xfree(sched->spool_dir);
+  xfree(sched->stat_path);
+  xfree(sched->host);
+  memset(sched, 0, sizeof(*sched));
+  xfree(sched);
+  return NULL;
+}
+
+static struct sched_contest *
+get_contest(struct super_run_sched *sched, int contest_id)
+{
+  int i;
+
+  for (i = 0; i < sched->contest_u; ++i) {
+    if (sched->contests[i].contest_id == contest_id)
+      return &sched->contests[i];
+  }
+  if (sched->contest_u == sched->contest_a) {
+    if (!(sched->contest_a *= 2)) sched->contest_a = 16;
+    XREALLOC(sched->contests, sched->contest_a);
+  }
+  struct sched_contest *c = &sched->contests[sched->contest_u++];
+  memset(c, 0, sizeof(*c));
+  c->contest_id = contest_id;
+  c->weight = get_weight(sched, contest_id);
+  c->live_best = -1;
+  c->rejudge_best = -1;
+  return c;
+}
+
+static void
+load_entry(
+        struct super_run_sched *sched,
+        const unsigned char *dir_path,
+        struct sched_entry *e)
+{
+  char *pkt_buf = NULL;
+  size_t pkt_size = 0;
+  struct super_run_in_packet *srp = NULL;
+  unsigned char path[PATH_MAX];
+  struct stat stb;
+
+  e->priority = scan_dir_get_priority(e->name);
+  snprintf(path, sizeof(path), "%s/%s", dir_path, e->name);
+  if (stat(path, &stb) >= 0) {
+    e->mtime = stb.st_mtime;
+  } else {
+    e->mtime = time(NULL);
+  }
+
+  // the packet which cannot be parsed is left to the handler to report
+  if (generic_read_file(&pkt_buf, 0, &pkt_size, 0, dir_path, e->name, "") <= 0)
+    return;
+  if ((srp = super_run_in_packet_parse_cfg_str(e->name, pkt_buf, pkt_size))
+      && srp->global) {
+    e->contest_id = srp->global->contest_id;
+    if (srp->global->priority >= sched->rejudge_priority) e->rejudge = 1;
+  }
+  super_run_in_packet_free(srp);
+  xfree(pkt_buf);
+}
+
+static int
+sort_name_func(const void *p1, const void *p2)
+{
+  return strcmp(*(const char * const *) p1, *(const char * const *) p2);
+}
+
+static int
+find_entry(const struct super_run_sched *sched, const unsigned char *name)
+{
+  int low = 0, high = sched->entry_u, mid, r;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (!(r = strcmp(sched->entries[mid].name, name))) return mid;
+    if (r < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return -1;
+}
+
+/* rescans the spool directory, if it is modified, and merges it with
+   the known entries, only the new packets are read and sorted */
+static int
+scan_spool(struct super_run_sched *sched, int *p_got_quit)
+{
+  unsigned char dir_path[PATH_MAX];
+  DIR *d = NULL;
+  struct dirent *dd;
+  int name_a = 0, name_u = 0, i, j, k;
+  unsigned char **names = NULL;
+  struct sched_entry *new_entries = NULL;
+  int saved_errno;
+  struct stat stb;
+  time_t scan_time = time(NULL);
+
+  snprintf(dir_path, sizeof(dir_path), "%s/dir", sched->spool_dir);
+  // the modifications within the second of the last scan may be
+  // indistinguishable by the directory mtime, so they are rescanned
+  if (!sched->rescan && stat(dir_path, &stb) >= 0
+      && stb.st_mtim.tv_sec == sched->dir_mtime.tv_sec
+      && stb.st_mtim.tv_nsec == sched->dir_mtime.tv_nsec
+      && stb.st_mtim.tv_sec < sched->scan_time) {
+    *p_got_quit = sched->got_quit;
+    return 0;
+  }
+
+  *p_got_quit = 0;
+  if (!(d = opendir(dir_path))) {
+    saved_errno = errno;
+    err("super_run_sched: opendir(\"%s\") failed: %s", dir_path, os_ErrorMsg());
+    return -saved_errno;
+  }
+  if (fstat(dirfd(d), &stb) >= 0) {
+    sched->dir_mtime = stb.st_mtim;
+  } else {
+    memset(&sched->dir_mtime, 0, sizeof(sched->dir_mtime));
+  }
+  for (i = 0; i < sched->entry_u; ++i)
+    sched->entries[i].seen = 0;
+  while ((dd = readdir(d))) {
+    if (!strcmp(dd->d_name, ".") || !strcmp(dd->d_name, "..")) continue;
+    if (!strcmp(dd->d_name, "QUIT")) {
+      *p_got_quit = 1;
+      continue;
+    }
+    if ((i = find_entry(sched, dd->d_name)) >= 0) {
+      sched->entries[i].seen = 1;
+      continue;
+    }
+    if (name_u == name_a) {
+      if (!(name_a *= 2)) name_a = 16;
+      XREALLOC(names, name_a);
+    }
+    names[name_u++] = xstrdup(dd->d_name);
+  }
+  closedir(d); d = NULL;
+  sched->scan_time = scan_time;
+  sched->got_quit = *p_got_quit;
+  sched->rescan = 0;
+
+  if (name_u > 1) qsort(names, name_u, sizeof(names[0]), sort_name_func);
+
+  // both the new names and the entries are sorted, merge them
+  XCALLOC(new_entries, sched->entry_u + name_u + 1);
+  i = 0; j = 0; k = 0;
+  while (i < name_u || j < sched->entry_u) {
+    if (j < sched->entry_u && !sched->entries[j].seen) {
+      xfree(sched->entries[j].name);
+      ++j;
+      continue;
+    }
+    if (j < sched->entry_u
+        && (i >= name_u || strcmp(sched->entries[j].name, names[i]) < 0)) {
+      new_entries[k] = sched->entries[j++];
+      // the packet has been taken by the handler, but reappeared
+      if (new_entries[k].dispatched && !new_entries[k].ignored) {
+        new_entries[k].dispatched = 0;
+      }
+      ++k;
+      continue;
+    }
+    new_entries[k].name = names[i++];
+    load_entry(sched, dir_path, &new_entries[k]);
+    ++k;
+  }
+
+  xfree(names);
+  xfree(sched->entries);
+  sched->entries = new_entries;
+  sched->entry_a = sched->entry_u + name_u + 1;
+  sched->entry_u = k;
+  return 0;
+}
+
+/* compares two packets of the same contest, the less is served first */
+static int
+entry_cmp(
+        const struct super_run_sched *sched,
+        const struct sched_entry *e1,
+        const struct sched_entry *e2,
+        time_t cur_time)
+{
+  int p1 = e1->priority, p2 = e2->priority;
+
+  if (sched->aging_interval > 0) {
+    if (cur_time > e1->mtime) p1 -= (cur_time - e1->mtime) / sched->aging_interval;
+    if (cur_time > e2->mtime) p2 -= (cur_time - e2->mtime) / sched->aging_interval;
+  }
+  if (p1 != p2) return p1 - p2;
+  if (e1->mtime != e2->mtime) return e1->mtime < e2->mtime ? -1 : 1;
+  return strcmp(e1->name, e2->name);
+}
+
+static void
+update_queues(struct super_run_sched *sched, time_t cur_time)
+{
+  struct sched_contest *c;
+  struct sched_entry *e;
+  long long min_vtime = -1;
+  int i, wait;
+
+  for (i = 0; i < sched->contest_u; ++i) {
+    c = &sched->contests[i];
+    if (c->active && (min_vtime < 0 || c->vtime < min_vtime))
+      min_vtime = c->vtime;
+    c->queued = 0;
+    c->queued_rejudge = 0;
+    c->oldest_wait = 0;
+    c->live_best = -1;
+    c->rejudge_best = -1;
+  }
+
+  for (i = 0; i < sched->entry_u; ++i) {
+    e = &sched->entries[i];
+    if (e->ignored || e->dispatched) continue;
+    c = get_contest(sched, e->contest_id);
+    ++c->queued;
+    wait = 0;
+    if (cur_time > e->mtime) wait = cur_time - e->mtime;
+    if (wait > c->oldest_wait) c->oldest_wait = wait;
+    if (e->rejudge) {
+      ++c->queued_rejudge;
+      if (c->rejudge_best < 0
+          || entry_cmp(sched, e, &sched->entries[c->rejudge_best], cur_time) < 0)
+        c->rejudge_best = i;
+    } else {
+      if (c->live_best < 0
+          || entry_cmp(sched, e, &sched->entries[c->live_best], cur_time) < 0)
+        c->live_best = i;
+    }
+  }
+
+  // a contest, which becomes active, does not get credit for its idle time
+  for (i = 0; i < sched->contest_u; ++i) {
+    c = &sched->contests[i];
+    if (c->queued > 0 && !c->active) {
+      if (min_vtime >= 0 && c->vtime < min_vtime) c->vtime = min_vtime;
+    }
+    c->active = (c->queued > 0);
+  }
+}
+
+static int
+lock_shared(struct super_run_sched *sched, int type)
+{
+  struct flock fl;
+
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  while (fcntl(sched->shared_fd, F_SETLKW, &fl) < 0) {
+    if (errno == EINTR) continue;
+    err("super_run_sched: cannot lock the shared state: %s", os_ErrorMsg());
+    return -1;
+  }
+  return 0;
+}
+
+/* takes the virtual times and the rejudge window of the other
+   schedulers of the host, the shared state is locked until
+   save_shared */
+static int
+load_shared(struct super_run_sched *sched)
+{
+  struct sched_shared_header hdr;
+  struct sched_shared_contest *recs = NULL;
+  size_t size;
+  int i;
+
+  if (sched->shared_fd < 0) return 0;
+  if (lock_shared(sched, F_WRLCK) < 0) return -1;
+  if (pread(sched->shared_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+      || memcmp(hdr.magic, SCHED_SHARED_MAGIC, sizeof(hdr.magic))
+      || hdr.contest_count < 0 || hdr.contest_count > EJ_MAX_CONTEST_ID
+      || hdr.window_len < 0 || hdr.window_len > SCHED_WINDOW_SIZE
+      || hdr.window_pos < 0 || hdr.window_pos >= SCHED_WINDOW_SIZE) {
+    // a new or a damaged file, our own state is written there
+    return 0;
+  }
+  size = hdr.contest_count * sizeof(recs[0]);
+  XCALLOC(recs, hdr.contest_count + 1);
+  if (pread(sched->shared_fd, recs, size, sizeof(hdr)) != size) {
+    xfree(recs);
+    return 0;
+  }
+  for (i = 0; i < hdr.contest_count; ++i) {
+    if (recs[i].contest_id <= 0) continue;
+    get_contest(sched, recs[i].contest_id)->vtime = recs[i].vtime;
+  }
+  memcpy(sched->window, hdr.window, sizeof(sched->window));
+  sched->window_pos = hdr.window_pos;
+  sched->window_len = hdr.window_len;
+  xfree(recs);
+  return 0;
+}
+
+static void
+save_shared(struct super_run_sched *sched)
+{
+  struct sched_shared_header hdr;
+  struct sched_shared_contest *recs = NULL;
+  size_t size;
+  int i;
+
+  if (sched->shared_fd < 0) return;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, SCHED_SHARED_MAGIC, sizeof(hdr.magic));
+  hdr.contest_count = sched->contest_u;
+  hdr.window_pos = sched->window_pos;
+  hdr.window_len = sched->window_len;
+  memcpy(hdr.window, sched->window, sizeof(hdr.window));
+  XCALLOC(recs, sched->contest_u + 1);
+  for (i = 0; i < sched->contest_u; ++i) {
+    recs[i].contest_id = sched->contests[i].contest_id;
+    recs[i].vtime = sched->contests[i].vtime;
+  }
+  size = sched->contest_u * sizeof(recs[0]);
+  if (pwrite(sched->shared_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+      || pwrite(sched->shared_fd, recs, size, sizeof(hdr)) != size
+      || ftruncate(sched->shared_fd, sizeof(hdr) + size) < 0) {
+    err("super_run_sched: cannot write the shared state: %s", os_ErrorMsg());
+  }
+  xfree(recs);
+  lock_shared(sched, F_UNLCK);
+}
+
+static int
+rejudge_allowed(const struct super_run_sched *sched)
+{
+  int count = 0;
+
+  if (sched->rejudge_share >= 100) return 1;
+  if (sched->window_len <= 0) return sched->rejudge_share > 0;
+  for (int i = 0; i < sched->window_len; ++i)
+    count += sched->window[i];
+  return count * 100 < sched->rejudge_share * sched->window_len;
+}
+
+static void
+dispatch_entry(
+        struct super_run_sched *sched,
+        struct sched_contest *c,
+        struct sched_entry *e,
+        time_t cur_time)
+{
+  int wait = 0;
+
+  if (cur_time > e->mtime) wait = cur_time - e->mtime;
+  e->dispatched = 1;
+  ++c->dispatched;
+  ++sched->dispatched;
+  --c->queued;
+  if (e->rejudge) {
+    ++c->dispatched_rejudge;
+    ++sched->dispatched_rejudge;
+    --c->queued_rejudge;
+  }
+  c->total_wait += wait;
+  if (wait > c->max_wait) c->max_wait = wait;
+  c->vtime += SCHED_VTIME_SCALE / c->weight;
+
+  sched->window[sched->window_pos] = e->rejudge;
+  sched->window_pos = (sched->window_pos + 1) % SCHED_WINDOW_SIZE;
+  if (sched->window_len < SCHED_WINDOW_SIZE) ++sched->window_len;
+  // the packet is expected to be taken, if not, it is served again
+  sched->rescan = 1;
+
+  info("super_run_sched: contest %d: dispatched '%s' (priority %d, %s, waited %d s)",
+       c->contest_id, e->name, e->priority, e->rejudge?"rejudge":"live", wait);
+}
+
+int
+super_run_sched_next(
+        struct super_run_sched *sched,
+        unsigned char *pkt_name,
+        size_t pkt_size)
+{
+  int got_quit = 0, r, i, live_pending = 0, allow_rejudge;
+  time_t cur_time = time(NULL);
+  struct sched_contest *c, *best_c = NULL;
+  int best_e = -1, cand;
+
+  if ((r = scan_spool(sched, &got_quit)) < 0) return r;
+  if (got_quit) {
+    snprintf(pkt_name, pkt_size, "%s", "QUIT");
+    info("super_run_sched: found QUIT packet");
+    return 1;
+  }
+
+  if (load_shared(sched) < 0) return -EIO;
+  update_queues(sched, cur_time);
+
+  for (i = 0; i < sched->contest_u; ++i) {
+    if (sched->contests[i].live_best >= 0) {
+      live_pending = 1;
+      break;
+    }
+  }
+  allow_rejudge = !live_pending || rejudge_allowed(sched);
+
+  for (i = 0; i < sched->contest_u; ++i) {
+    c = &sched->contests[i];
+    cand = c->live_best;
+    if (allow_rejudge && c->rejudge_best >= 0
+        && (cand < 0 || entry_cmp(sched, &sched->entries[c->rejudge_best],
+                                  &sched->entries[cand], cur_time) < 0)) {
+      cand = c->rejudge_best;
+    }
+    if (cand < 0) continue;
+    if (!best_c || c->vtime < best_c->vtime
+        || (c->vtime == best_c->vtime && c->contest_id < best_c->contest_id)) {
+      best_c = c;
+      best_e = cand;
+    }
+  }
+
+  if (!best_c) {
+    save_shared(sched);
+    super_run_sched_flush_stat(sched, 0);
+    return 0;
+  }
+
+  dispatch_entry(sched, best_c, &sched->entries[best_e], cur_time);
+  save_shared(sched);
+  snprintf(pkt_name, pkt_size, "%s", sched->entries[best_e].name);
+  super_run_sched_flush_stat(sched, 1);
+  return 1;
+}
+
+void
+super_run_sched_ignore(
+        struct super_run_sched *sched,
+        const unsigned char *pkt_name)
+{
+  int i;
+
+  if ((i = find_entry(sched, pkt_name)) >= 0)
+    sched->entries[i].ignored = 1;
+}
+
+void
+super_run_sched_flush_stat(struct super_run_sched *sched, int force_flag)
+{
+  time_t cur_time = time(NULL);
+  unsigned char tmp_path[PATH_MAX];
+  FILE *f = NULL;
+  int queued = 0, queued_rejudge = 0;
+  const struct sched_contest *c;
+
+  if (!sched || !sched->stat_path) return;
+  if (!force_flag && sched->last_stat_time == cur_time) return;
+  sched->last_stat_time = cur_time;
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", sched->stat_path);
+  if (!(f = fopen(tmp_path, "w"))) {
+    err("super_run_sched: cannot open '%s': %s", tmp_path, os_ErrorMsg());
+    return;
+  }
+  for (int i = 0; i < sched->contest_u; ++i) {
+    queued += sched->contests[i].queued;
+    queued_rejudge += sched->contests[i].queued_rejudge;
+  }
+  fprintf(f, "host %s\n", sched->host);
+  fprintf(f, "pid %d\n", getpid());
+  fprintf(f, "time %lld\n", (long long) cur_time);
+  fprintf(f, "rejudge_share %d\n", sched->rejudge_share);
+  fprintf(f, "total %d %d %lld %lld\n", queued, queued_rejudge,
+          sched->dispatched, sched->dispatched_rejudge);
+  for (int i = 0; i < sched->contest_u; ++i) {
+    c = &sched->contests[i];
+    fprintf(f, "contest %d %d %d %d %d %d %lld %lld %lld\n",
+            c->contest_id, c->weight, c->queued, c->queued_rejudge,
+            c->oldest_wait, c->max_wait, c->dispatched,
+            c->dispatched_rejudge, c->total_wait);
+  }
+  if (ferror(f)) {
+    err("super_run_sched: write error on '%s'", tmp_path);
+    fclose(f);
+    unlink(tmp_path);
+    return;
+  }
+  fclose(f); f = NULL;
+  if (rename(tmp_path, sched->stat_path) < 0) {
+    err("super_run_sched: rename '%s' failed: %s", tmp_path, os_ErrorMsg());
+    unlink(tmp_path);
+  }
+}
+
+struct super_run_sched_stat *
+super_run_sched_stat_read(const unsigned char *path)
+{
+  FILE *f = NULL;
+  struct super_run_sched_stat *stat = NULL;
+  struct super_run_sched_contest_stat cs;
+  unsigned char buf[1024];
+  unsigned char host[1024];
+  long long t;
+
+  if (!(f = fopen(path, "r"))) return NULL;
+  XCALLOC(stat, 1);
+  while (fgets(buf, sizeof(buf), f)) {
+    memset(&cs, 0, sizeof(cs));
+    if (sscanf(buf, "host %1023s", host) == 1) {
+      xfree(stat->host);
+      stat->host = xstrdup(host);
+    } else if (sscanf(buf, "pid %d", &stat->pid) == 1) {
+    } else if (sscanf(buf, "time %lld", &t) == 1) {
+      stat->update_time = t;
+    } else if (sscanf(buf, "rejudge_share %d", &stat->rejudge_share) == 1) {
+    } else if (sscanf(buf, "total %d %d %lld %lld", &stat->queued,
+                      &stat->queued_rejudge, &stat->dispatched,
+                      &stat->dispatched_rejudge) == 4) {
+    } else if (sscanf(buf, "contest %d %d %d %d %d %d %lld %lld %lld",
+                      &cs.contest_id, &cs.weight, &cs.queued,
+                      &cs.queued_rejudge, &cs.oldest_wait, &cs.max_wait,
+                      &cs.dispatched, &cs.dispatched_rejudge,
+                      &cs.total_wait) == 9) {
+      if (stat->contest_u == stat->contest_a) {
+        if (!(stat->contest_a *= 2)) stat->contest_a = 16;
+        XREALLOC(stat->contests, stat->contest_a);
+      }
+      stat->contests[stat->contest_u++] = cs;
+    }
+  }
+  fclose(f);
+  if (!stat->host) stat->host = xstrdup("");
+  return stat;
+}
+
+struct super_run_sched_stat *
+super_run_sched_stat_free(struct super_run_sched_stat *stat)
+{
+  if (!stat) return NULL;
+  xfree(stat->host);
+  xfree(stat->contests);
+  xfree(stat);
+  return NULL;
+}
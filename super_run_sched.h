@@ -0,0 +1,105 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __SUPER_RUN_SCHED_H__
+#define __SUPER_RUN_SCHED_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+/* subdirectory of super-run/var, where the schedulers publish statistics */
+#define SUPER_RUN_SCHED_STAT_DIR "sched"
+
+struct ejudge_cfg;
+struct super_run_sched;
+
+/*
+ * Fair-share scheduler for the super-run queue.
+ * Packets are split into per-contest queues, contests are served
+ * in the order of their virtual time (weighted fair sharing),
+ * packets within a contest are served by priority with aging.
+ * Rejudge-class packets are limited to the configured share of
+ * the dispatched packets while there are live packets waiting.
+ * The virtual times and the rejudge share window are shared by the
+ * schedulers of all the workers of a host through the file
+ * <stat_dir>/<host>.state, each scheduler publishes its statistics
+ * to <stat_dir>/<host>_<pid>.
+ *
+ * The following host options of ejudge.xml are recognized:
+ *   sched_fair_share      - 0 disables the scheduler (default 1)
+ *   sched_weights         - "CNTS:WEIGHT,CNTS:WEIGHT,..." (default 1)
+ *   sched_aging_interval  - seconds of waiting per priority step (60)
+ *   sched_rejudge_priority- priority, from which a packet is
+ *                           considered as rejudge (10)
+ *   sched_rejudge_share   - percentage of rejudge packets (25)
+ */
+struct super_run_sched *
+super_run_sched_create(
+        const struct ejudge_cfg *config,
+        unsigned char **host_names,
+        const unsigned char *spool_dir,
+        const unsigned char *stat_dir);
+struct super_run_sched *
+super_run_sched_free(struct super_run_sched *sched);
+
+/* same contract as scan_dir: -errno on error, 0 - empty, 1 - found */
+int
+super_run_sched_next(
+        struct super_run_sched *sched,
+        unsigned char *pkt_name,
+        size_t pkt_size);
+void
+super_run_sched_ignore(
+        struct super_run_sched *sched,
+        const unsigned char *pkt_name);
+void
+super_run_sched_flush_stat(struct super_run_sched *sched, int force_flag);
+
+/* statistics snapshot written by ej-super-run */
+struct super_run_sched_contest_stat
+{
+  int contest_id;
+  int weight;
+  int queued;
+  int queued_rejudge;
+  int oldest_wait;
+  int max_wait;
+  long long dispatched;
+  long long dispatched_rejudge;
+  long long total_wait;
+};
+
+struct super_run_sched_stat
+{
+  unsigned char *host;
+  int pid;
+  time_t update_time;
+  int rejudge_share;
+  int queued;
+  int queued_rejudge;
+  long long dispatched;
+  long long dispatched_rejudge;
+
+  int contest_a, contest_u;
+  struct super_run_sched_contest_stat *contests;
+};
+
+struct super_run_sched_stat *
+super_run_sched_stat_read(const unsigned char *path);
+struct super_run_sched_stat *
+super_run_sched_stat_free(struct super_run_sched_stat *stat);
+
+#endif /* __SUPER_RUN_SCHED_H__ */
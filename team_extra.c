@@ -19,6 +19,7 @@
 #include "team_extra.h"
 #include "pathutl.h"
 #include "errlog.h"
+#include "compat.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -26,43 +27,112 @@
 
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <zlib.h>
 
-#if defined __GNUC__ && defined __MINGW32__
-#include <malloc.h>
-#endif
-
-#define MAX_USER_ID_32DIGITS 4
 #define BPE (CHAR_BIT * sizeof(((struct team_extra*)0)->clar_map[0]))
 
+/*
+ * All the entries of the contest are kept in the snapshot file, which
+ * is read once when the directory is set. The changes are appended to
+ * the journal file by team_extra_flush, and the snapshot is rewritten
+ * when the journal grows larger than the snapshot. The snapshot and
+ * the journal carry the generation number, the journal is replayed
+ * only if its generation matches the snapshot, so a crash between the
+ * snapshot update and the journal reset does not apply the journal
+ * twice. The old per-user XML files are imported, if the snapshot
+ * does not exist.
+ */
+
+#define SNAPSHOT_NAME "team_extra.bin"
+#define SNAPSHOT_TMP_NAME "team_extra.bin.tmp"
+#define JOURNAL_NAME "team_extra.journal"
+#define JOURNAL_TMP_NAME "team_extra.journal.tmp"
+#define SNAPSHOT_MAGIC "EjTX"
+#define JOURNAL_MAGIC "EjTJ"
+
+enum { STORE_VERSION = 1 };
+enum { MIN_JOURNAL_SIZE = 256 * 1024 };
+
+struct store_header
+{
+  unsigned char magic[4];
+  ruint32_t version;
+  ruint32_t long_size;          /* the clar bitmaps are stored as is */
+  ruint32_t generation;
+  ruint32_t count;              /* the number of the user records */
+  ruint32_t crc;                /* crc32 of the data after the header */
+};
+
+/* the snapshot user record, followed by the clar bitmap, the
+   disqualification comment and the warnings */
+struct user_record
+{
+  int user_id;
+  int status;
+  int run_fields;
+  int clar_map_alloc;
+  ruint32_t disq_len;           /* strlen + 1, or 0 for NULL */
+  int warn_count;
+};
+
+/* the snapshot warning record, followed by the text and the comment */
+struct warning_record
+{
+  long long date;
+  int issuer_id;
+  ruint32_t text_len;           /* strlen + 1, or 0 for NULL */
+  ruint32_t comment_len;        /* strlen + 1, or 0 for NULL */
+  int pad;
+  ej_ip_t issuer_ip;
+};
+
+/* journal operations */
+enum
+{
+  JOP_SET_CLAR = 1,
+  JOP_SET_STATUS,
+  JOP_SET_RUN_FIELDS,
+  JOP_SET_DISQ_COMMENT,
+  JOP_APPEND_WARNING,
+
+  JOP_LAST
+};
+
+/* the journal record, followed by two strings */
+struct journal_record
+{
+  ruint32_t op;
+  ruint32_t crc;                /* crc32 of the record with crc == 0 */
+  int user_id;
+  int value;                    /* clar_id, status, run_fields, issuer_id */
+  ruint32_t len1, len2;         /* strlen + 1, or 0 for NULL */
+  long long date;
+  ej_ip_t ip;
+};
+
 struct team_extra_state
 {
   unsigned char *team_extra_dir;
   size_t team_map_size;
   struct team_extra **team_map;
-};
-
-static const unsigned char b32_digits[]=
-"0123456789ABCDEFGHIJKLMNOPQRSTUV";
-static void
-b32_number(unsigned num, size_t size, unsigned char buf[])
-{
-  int i;
 
-  ASSERT(size > 1);
+  // the store is not written after a load error
+  int read_only;
+  ruint32_t generation;
+  long long snapshot_size;
+  int journal_fd;
+  long long journal_size;
 
-  memset(buf, '0', size - 1);
-  buf[size - 1] = 0;
-  i = size - 2;
-  while (num > 0 && i >= 0) {
-    buf[i] = b32_digits[num & 0x1f];
-    i--;
-    num >>= 5;
-  }
-  ASSERT(!num);
-}
+  // the journal records not yet written
+  unsigned char *jbuf;
+  size_t jbuf_u, jbuf_a;
+};
 
 team_extra_state_t
 team_extra_init(void)
@@ -70,97 +140,46 @@ team_extra_init(void)
   team_extra_state_t p;
 
   XCALLOC(p, 1);
+  p->journal_fd = -1;
   return p;
 }
 
+static void
+free_entry(struct team_extra *te)
+{
+  int j;
+  struct team_warning *tw;
+
+  if (!te || te == (struct team_extra*) -1) return;
+  for (j = 0; j < te->warn_u; j++) {
+    if (!(tw = te->warns[j])) continue;
+    xfree(tw->text);
+    xfree(tw->comment);
+    xfree(tw);
+  }
+  xfree(te->warns);
+  xfree(te->clar_map);
+  xfree(te->disq_comment);
+  xfree(te);
+}
+
 team_extra_state_t
 team_extra_destroy(team_extra_state_t state)
 {
-  int i, j;
-  struct team_extra *te;
-  struct team_warning *tw;
+  int i;
 
   if (!state) return 0;
   xfree(state->team_extra_dir);
-  for (i = 0; i < state->team_map_size; i++) {
-    if (!(te = state->team_map[i])) continue;
-    for (j = 0; j < te->warn_u; j++) {
-      if (!(tw = te->warns[j])) continue;
-      xfree(tw->text);
-      xfree(tw->comment);
-      xfree(tw);
-    }
-    xfree(te->warns);
-    xfree(te->clar_map);
-    xfree(te->disq_comment);
-    xfree(te);
-  }
+  for (i = 0; i < state->team_map_size; i++)
+    free_entry(state->team_map[i]);
   xfree(state->team_map);
+  if (state->journal_fd >= 0) close(state->journal_fd);
+  xfree(state->jbuf);
   memset(state, 0, sizeof(*state));
   xfree(state);
   return 0;
 }
 
-int
-team_extra_set_dir(team_extra_state_t state, const unsigned char *dir)
-{
-  state->team_extra_dir = xstrdup(dir);
-  return 0;
-}
-
-static int
-make_read_path(team_extra_state_t state, unsigned char *path, size_t size,
-               int user_id)
-{
-  unsigned char b32[16];
-
-  ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
-  b32_number(user_id, MAX_USER_ID_32DIGITS + 1, b32);
-  return snprintf(path, size, "%s/%c/%c/%c/%06d.xml",
-                  state->team_extra_dir, b32[0], b32[1], b32[2], user_id);
-}
-
-static int
-make_write_path(team_extra_state_t state, unsigned char *path, size_t size,
-                int user_id)
-{
-  unsigned char b32[16];
-  unsigned char *mpath = 0, *p;
-  //struct stat sb;
-  int i;
-
-  ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
-  b32_number(user_id, MAX_USER_ID_32DIGITS + 1, b32);
-
-  mpath = alloca(strlen(state->team_extra_dir) + 32);
-  strcpy(mpath, state->team_extra_dir);
-  p = mpath + strlen(mpath);
-  for (i = 0; i < MAX_USER_ID_32DIGITS - 1; i++) {
-    *p++ = '/';
-    *p++ = b32[i];
-    *p = 0;
-    if (os_MakeDir(mpath, 0770) < 0) {
-      if (errno != EEXIST) {
-        err("team_extra: %s: mkdir failed: %s", mpath, os_ErrorMsg());
-        return -1;
-      }
-      /*
-      if (lstat(mpath, &sb) < 0) {
-        err("team_extra: %s: lstat failed: %s", mpath, os_ErrorMsg());
-        return -1;
-      }
-      if (!S_ISDIR(sb.st_mode)) {
-        err("team_extra: %s: is not a directory", mpath);
-        return -1;
-      }
-      */
-    }
-  }
-
-  return snprintf(path, size, "%s/%c/%c/%c/%06d.xml",
-                  state->team_extra_dir, b32[0], b32[1], b32[2], user_id);
-}
-
 static void
 extend_team_map(team_extra_state_t state, int user_id)
 {
@@ -181,60 +200,20 @@ extend_team_map(team_extra_state_t state, int user_id)
 static struct team_extra *
 get_entry(team_extra_state_t state, int user_id, int try_flag)
 {
-  struct team_extra *te = state->team_map[user_id];
-  path_t rpath;
-  //struct stat sb;
-
-  if (te) return te;
+  struct team_extra *te;
 
-  make_read_path(state, rpath, sizeof(rpath), user_id);
-  if (os_CheckAccess(rpath, REUSE_F_OK) < 0) {
+  if (user_id >= state->team_map_size) {
     if (try_flag) return NULL;
-    XCALLOC(te, 1);
-    te->user_id = user_id;
-    state->team_map[user_id] = te;
-    return te;
-  }
-  /*    
-  if (lstat(rpath, &sb) < 0) {
-    XCALLOC(te, 1);
-    te->user_id = user_id;
-    state->team_map[user_id] = te;
-    return te;
-  }
-  if (!S_ISREG(sb.st_mode)) {
-    err("team_extra: %s: not a regular file", rpath);
-    state->team_map[user_id] = (struct team_extra*) -1;
-    return (struct team_extra*) -1;
-  }
-  */
-  if (team_extra_parse_xml(rpath, &te) < 0) {
-    state->team_map[user_id] = (struct team_extra*) -1;
-    return (struct team_extra*) -1;
-  }
-  if (te->user_id != user_id) {
-    err("team_extra: %s: user_id mismatch: %d, %d",
-        rpath, te->user_id, user_id);
-    state->team_map[user_id] = (struct team_extra*) -1;
-    return (struct team_extra*) -1;
+    extend_team_map(state, user_id);
   }
+  if ((te = state->team_map[user_id])) return te;
+  if (try_flag) return NULL;
+  XCALLOC(te, 1);
+  te->user_id = user_id;
   state->team_map[user_id] = te;
   return te;
 }
 
-const struct team_extra*
-team_extra_get_entry(team_extra_state_t state, int user_id)
-{
-  struct team_extra *tmpval;
-
-  ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
-
-  tmpval = get_entry(state, user_id, 0);
-  if (tmpval == (struct team_extra*) -1) tmpval = 0;
-  return tmpval;
-}
-
 static void
 extend_clar_map(struct team_extra *te, int clar_id)
 {
@@ -255,6 +234,604 @@ extend_clar_map(struct team_extra *te, int clar_id)
   te->clar_map = new_map;
 }
 
+/* the changes of the entries, they are shared by the public functions
+   and the journal replay, return 1, if the entry is changed */
+static int
+do_set_clar(struct team_extra *te, int clar_id)
+{
+  if (clar_id >= te->clar_map_size) extend_clar_map(te, clar_id);
+  if ((te->clar_map[clar_id / BPE] & (1UL << clar_id % BPE)))
+    return 0;
+  te->clar_map[clar_id / BPE] |= (1UL << clar_id % BPE);
+  return 1;
+}
+
+static void
+do_append_warning(
+        struct team_extra *te,
+        int issuer_id,
+        const ej_ip_t *issuer_ip,
+        time_t issue_date,
+        const unsigned char *txt,
+        const unsigned char *cmt)
+{
+  struct team_warning *cur_warn;
+
+  if (te->warn_u == te->warn_a) {
+    te->warn_a *= 2;
+    if (!te->warn_a) te->warn_a = 8;
+    XREALLOC(te->warns, te->warn_a);
+  }
+  XCALLOC(cur_warn, 1);
+  te->warns[te->warn_u++] = cur_warn;
+
+  cur_warn->date = issue_date;
+  cur_warn->issuer_id = issuer_id;
+  cur_warn->issuer_ip = *issuer_ip;
+  cur_warn->text = xstrdup(txt);
+  cur_warn->comment = xstrdup(cmt);
+}
+
+static void
+do_set_disq_comment(struct team_extra *te, const unsigned char *disq_comment)
+{
+  xfree(te->disq_comment);
+  te->disq_comment = 0;
+  if (disq_comment) te->disq_comment = xstrdup(disq_comment);
+}
+
+static int
+full_write(int fd, const void *buf, size_t size)
+{
+  const unsigned char *p = (const unsigned char *) buf;
+  ssize_t w;
+
+  while (size > 0) {
+    if ((w = write(fd, p, size)) <= 0) {
+      if (w < 0 && errno == EINTR) continue;
+      return -1;
+    }
+    p += w; size -= w;
+  }
+  return 0;
+}
+
+static int
+read_whole_file(const unsigned char *path, unsigned char **p_buf, size_t *p_size)
+{
+  int fd;
+  struct stat stb;
+  unsigned char *buf = 0;
+  size_t size = 0;
+  ssize_t r;
+
+  *p_buf = 0; *p_size = 0;
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    if (errno == ENOENT) return 0;
+    err("team_extra: cannot open %s: %s", path, os_ErrorMsg());
+    return -1;
+  }
+  if (fstat(fd, &stb) < 0) {
+    err("team_extra: fstat %s failed: %s", path, os_ErrorMsg());
+    close(fd);
+    return -1;
+  }
+  buf = xmalloc(stb.st_size + 1);
+  while (size < stb.st_size) {
+    if ((r = read(fd, buf + size, stb.st_size - size)) < 0) {
+      if (errno == EINTR) continue;
+      err("team_extra: read %s failed: %s", path, os_ErrorMsg());
+      close(fd);
+      xfree(buf);
+      return -1;
+    }
+    if (!r) break;
+    size += r;
+  }
+  close(fd);
+  buf[size] = 0;
+  *p_buf = buf;
+  *p_size = size;
+  return 1;
+}
+
+static const unsigned char *
+get_string(const unsigned char **pp, const unsigned char *end, ruint32_t len)
+{
+  const unsigned char *s = *pp;
+
+  if (!len) return "";
+  if (len > end - s || s[len - 1]) return NULL;
+  *pp = s + len;
+  return s;
+}
+
+static int
+load_snapshot(team_extra_state_t state, const unsigned char *path)
+{
+  unsigned char *buf = 0;
+  size_t size = 0;
+  const unsigned char *p, *end, *txt, *cmt;
+  const struct store_header *hdr;
+  struct user_record ur;
+  struct warning_record wr;
+  struct team_extra *te;
+  int i, j, r;
+
+  if ((r = read_whole_file(path, &buf, &size)) <= 0) return r;
+  hdr = (const struct store_header *) buf;
+  if (size < sizeof(*hdr) || memcmp(hdr->magic, SNAPSHOT_MAGIC, 4) != 0
+      || hdr->version != STORE_VERSION
+      || hdr->long_size != sizeof(unsigned long)) {
+    err("team_extra: %s: invalid header", path);
+    goto fail;
+  }
+  if (crc32(0, buf + sizeof(*hdr), size - sizeof(*hdr)) != hdr->crc) {
+    err("team_extra: %s: checksum mismatch", path);
+    goto fail;
+  }
+  state->generation = hdr->generation;
+  state->snapshot_size = size;
+
+  p = buf + sizeof(*hdr);
+  end = buf + size;
+  for (i = 0; i < hdr->count; ++i) {
+    if (end - p < sizeof(ur)) goto invalid;
+    memcpy(&ur, p, sizeof(ur));
+    p += sizeof(ur);
+    if (ur.user_id <= 0 || ur.user_id > EJ_MAX_USER_ID) goto invalid;
+    if (ur.clar_map_alloc < 0 || ur.warn_count < 0) goto invalid;
+    if ((end - p) / sizeof(unsigned long) < ur.clar_map_alloc) goto invalid;
+    te = get_entry(state, ur.user_id, 0);
+    te->status = ur.status;
+    te->run_fields = ur.run_fields;
+    if (ur.clar_map_alloc > 0) {
+      te->clar_map_alloc = ur.clar_map_alloc;
+      te->clar_map_size = ur.clar_map_alloc * BPE;
+      XCALLOC(te->clar_map, te->clar_map_alloc);
+      memcpy(te->clar_map, p, ur.clar_map_alloc * sizeof(unsigned long));
+      p += ur.clar_map_alloc * sizeof(unsigned long);
+    }
+    if (!(txt = get_string(&p, end, ur.disq_len))) goto invalid;
+    if (ur.disq_len) te->disq_comment = xstrdup(txt);
+    for (j = 0; j < ur.warn_count; ++j) {
+      if (end - p < sizeof(wr)) goto invalid;
+      memcpy(&wr, p, sizeof(wr));
+      p += sizeof(wr);
+      if (!(txt = get_string(&p, end, wr.text_len))) goto invalid;
+      if (!(cmt = get_string(&p, end, wr.comment_len))) goto invalid;
+      do_append_warning(te, wr.issuer_id, &wr.issuer_ip, wr.date,
+                        wr.text_len?txt:NULL, wr.comment_len?cmt:NULL);
+    }
+  }
+  xfree(buf);
+  return 1;
+
+ invalid:
+  err("team_extra: %s: invalid record", path);
+ fail:
+  xfree(buf);
+  return -1;
+}
+
+/* the entries with the default values are not saved */
+static int
+is_empty_entry(const struct team_extra *te)
+{
+  int i;
+
+  if (te->status || te->run_fields || te->disq_comment || te->warn_u > 0)
+    return 0;
+  for (i = 0; i < te->clar_map_alloc; ++i)
+    if (te->clar_map[i]) return 0;
+  return 1;
+}
+
+static int
+write_snapshot(team_extra_state_t state)
+{
+  char *data = 0;
+  size_t size = 0;
+  FILE *f;
+  struct store_header hdr;
+  struct user_record ur;
+  struct warning_record wr;
+  struct team_extra *te;
+  struct team_warning *tw;
+  int i, j, fd = -1;
+  path_t tmp_path, path;
+
+  if (!(f = open_memstream(&data, &size))) return -1;
+  memset(&hdr, 0, sizeof(hdr));
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  for (i = 1; i < state->team_map_size; ++i) {
+    if (!(te = state->team_map[i]) || is_empty_entry(te)) continue;
+    memset(&ur, 0, sizeof(ur));
+    ur.user_id = i;
+    ur.status = te->status;
+    ur.run_fields = te->run_fields;
+    ur.clar_map_alloc = te->clar_map_alloc;
+    if (te->disq_comment) ur.disq_len = strlen(te->disq_comment) + 1;
+    ur.warn_count = te->warn_u;
+    fwrite(&ur, sizeof(ur), 1, f);
+    if (ur.clar_map_alloc > 0)
+      fwrite(te->clar_map, sizeof(te->clar_map[0]), te->clar_map_alloc, f);
+    if (ur.disq_len > 0) fwrite(te->disq_comment, 1, ur.disq_len, f);
+    for (j = 0; j < te->warn_u; ++j) {
+      tw = te->warns[j];
+      memset(&wr, 0, sizeof(wr));
+      wr.date = tw->date;
+      wr.issuer_id = tw->issuer_id;
+      wr.issuer_ip = tw->issuer_ip;
+      if (tw->text) wr.text_len = strlen(tw->text) + 1;
+      if (tw->comment) wr.comment_len = strlen(tw->comment) + 1;
+      fwrite(&wr, sizeof(wr), 1, f);
+      if (wr.text_len > 0) fwrite(tw->text, 1, wr.text_len, f);
+      if (wr.comment_len > 0) fwrite(tw->comment, 1, wr.comment_len, f);
+    }
+    ++hdr.count;
+  }
+  close_memstream(f); f = 0;
+
+  memcpy(hdr.magic, SNAPSHOT_MAGIC, 4);
+  hdr.version = STORE_VERSION;
+  hdr.long_size = sizeof(unsigned long);
+  hdr.generation = state->generation + 1;
+  hdr.crc = crc32(0, data + sizeof(hdr), size - sizeof(hdr));
+  memcpy(data, &hdr, sizeof(hdr));
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s/%s", state->team_extra_dir,
+           SNAPSHOT_TMP_NAME);
+  snprintf(path, sizeof(path), "%s/%s", state->team_extra_dir, SNAPSHOT_NAME);
+  if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0660)) < 0) {
+    err("team_extra: cannot create %s: %s", tmp_path, os_ErrorMsg());
+    goto fail;
+  }
+  if (full_write(fd, data, size) < 0 || fsync(fd) < 0) {
+    err("team_extra: write to %s failed: %s", tmp_path, os_ErrorMsg());
+    goto fail;
+  }
+  close(fd); fd = -1;
+  if (rename(tmp_path, path) < 0) {
+    err("team_extra: rename %s failed: %s", tmp_path, os_ErrorMsg());
+    goto fail;
+  }
+  state->generation = hdr.generation;
+  state->snapshot_size = size;
+  xfree(data);
+  return 0;
+
+ fail:
+  if (fd >= 0) close(fd);
+  unlink(tmp_path);
+  xfree(data);
+  return -1;
+}
+
+static void
+apply_journal_record(
+        team_extra_state_t state,
+        const struct journal_record *jr,
+        const unsigned char *s1,
+        const unsigned char *s2)
+{
+  struct team_extra *te = get_entry(state, jr->user_id, 0);
+
+  switch (jr->op) {
+  case JOP_SET_CLAR:
+    do_set_clar(te, jr->value);
+    break;
+  case JOP_SET_STATUS:
+    te->status = jr->value;
+    break;
+  case JOP_SET_RUN_FIELDS:
+    te->run_fields = jr->value;
+    break;
+  case JOP_SET_DISQ_COMMENT:
+    do_set_disq_comment(te, s1);
+    break;
+  case JOP_APPEND_WARNING:
+    do_append_warning(te, jr->value, &jr->ip, jr->date, s1, s2);
+    break;
+  }
+}
+
+/* replays the journal, returns 1, if the journal is valid for the
+   current snapshot, 0, if it should be reset */
+static int
+replay_journal(team_extra_state_t state, const unsigned char *path)
+{
+  unsigned char *buf = 0;
+  size_t size = 0;
+  unsigned char *p, *end;
+  const unsigned char *s1, *s2;
+  struct store_header hdr;
+  struct journal_record jr;
+  ruint32_t crc;
+  int r;
+
+  if ((r = read_whole_file(path, &buf, &size)) <= 0) return r;
+  if (size < sizeof(hdr)) goto reset;
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (memcmp(hdr.magic, JOURNAL_MAGIC, 4) != 0
+      || hdr.version != STORE_VERSION
+      || hdr.generation != state->generation)
+    goto reset;
+
+  p = buf + sizeof(hdr);
+  end = buf + size;
+  while (end - p >= sizeof(jr)) {
+    memcpy(&jr, p, sizeof(jr));
+    if (jr.op <= 0 || jr.op >= JOP_LAST) break;
+    if (jr.user_id <= 0 || jr.user_id > EJ_MAX_USER_ID) break;
+    if (jr.len1 > end - p - sizeof(jr)
+        || jr.len2 > end - p - sizeof(jr) - jr.len1)
+      break;
+    crc = jr.crc;
+    ((struct journal_record *) p)->crc = 0;
+    if (crc32(0, p, sizeof(jr) + jr.len1 + jr.len2) != crc) break;
+    s1 = s2 = NULL;
+    if (jr.len1 > 0) {
+      s1 = p + sizeof(jr);
+      if (s1[jr.len1 - 1]) break;
+    }
+    if (jr.len2 > 0) {
+      s2 = p + sizeof(jr) + jr.len1;
+      if (s2[jr.len2 - 1]) break;
+    }
+    if (jr.op == JOP_SET_CLAR && (jr.value < 0 || jr.value > EJ_MAX_CLAR_ID))
+      break;
+    apply_journal_record(state, &jr, s1, s2);
+    p += sizeof(jr) + jr.len1 + jr.len2;
+  }
+  if (p < end) {
+    info("team_extra: %s: %ld bytes of the journal are dropped", path,
+         (long) (end - p));
+  }
+  state->journal_size = p - buf;
+  xfree(buf);
+  return 1;
+
+ reset:
+  xfree(buf);
+  return 0;
+}
+
+/* creates the empty journal for the current generation */
+static int
+reset_journal(team_extra_state_t state)
+{
+  path_t tmp_path, path;
+  struct store_header hdr;
+  int fd;
+
+  if (state->journal_fd >= 0) {
+    close(state->journal_fd);
+    state->journal_fd = -1;
+  }
+  snprintf(tmp_path, sizeof(tmp_path), "%s/%s", state->team_extra_dir,
+           JOURNAL_TMP_NAME);
+  snprintf(path, sizeof(path), "%s/%s", state->team_extra_dir, JOURNAL_NAME);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, JOURNAL_MAGIC, 4);
+  hdr.version = STORE_VERSION;
+  hdr.long_size = sizeof(unsigned long);
+  hdr.generation = state->generation;
+  if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0660)) < 0) {
+    err("team_extra: cannot create %s: %s", tmp_path, os_ErrorMsg());
+    return -1;
+  }
+  if (full_write(fd, &hdr, sizeof(hdr)) < 0 || fsync(fd) < 0
+      || rename(tmp_path, path) < 0) {
+    err("team_extra: cannot create %s: %s", path, os_ErrorMsg());
+    close(fd);
+    unlink(tmp_path);
+    return -1;
+  }
+  close(fd);
+  state->journal_size = sizeof(hdr);
+  return 0;
+}
+
+static int
+open_journal(team_extra_state_t state)
+{
+  path_t path;
+
+  if (state->journal_fd >= 0) return 0;
+  snprintf(path, sizeof(path), "%s/%s", state->team_extra_dir, JOURNAL_NAME);
+  if ((state->journal_fd = open(path, O_WRONLY | O_APPEND)) < 0) {
+    err("team_extra: cannot open %s: %s", path, os_ErrorMsg());
+    return -1;
+  }
+  // drop the incomplete record at the end, if any
+  if (ftruncate(state->journal_fd, state->journal_size) < 0) {
+    err("team_extra: ftruncate %s failed: %s", path, os_ErrorMsg());
+  }
+  return 0;
+}
+
+/* imports the per-user XML files from the leaf directory */
+static int
+import_xml_dir(team_extra_state_t state, const unsigned char *dir)
+{
+  DIR *d;
+  struct dirent *dd;
+  path_t path;
+  struct team_extra *te;
+  int user_id, n, count = 0;
+
+  if (!(d = opendir(dir))) return 0;
+  while ((dd = readdir(d))) {
+    if (sscanf(dd->d_name, "%d%n", &user_id, &n) != 1
+        || strcmp(dd->d_name + n, ".xml") != 0
+        || user_id <= 0 || user_id > EJ_MAX_USER_ID)
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, dd->d_name);
+    te = 0;
+    if (team_extra_parse_xml(path, &te) < 0 || !te) {
+      err("team_extra: %s: skipped", path);
+      continue;
+    }
+    if (te->user_id != user_id) {
+      err("team_extra: %s: user_id mismatch: %d, %d",
+          path, te->user_id, user_id);
+      free_entry(te);
+      continue;
+    }
+    if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+    free_entry(state->team_map[user_id]);
+    state->team_map[user_id] = te;
+    te->is_dirty = 0;
+    ++count;
+  }
+  closedir(d);
+  return count;
+}
+
+/* imports the per-user XML files, which were used before, they are
+   stored in the three levels of the one-letter directories */
+static int
+import_xml_files(team_extra_state_t state, const unsigned char *dir, int level)
+{
+  DIR *d;
+  struct dirent *dd;
+  path_t path;
+  int count = 0;
+
+  if (level == 3) return import_xml_dir(state, dir);
+  if (!(d = opendir(dir))) return 0;
+  while ((dd = readdir(d))) {
+    if (strlen(dd->d_name) != 1 || dd->d_name[0] == '.') continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, dd->d_name);
+    count += import_xml_files(state, path, level + 1);
+  }
+  closedir(d);
+  return count;
+}
+
+int
+team_extra_set_dir(team_extra_state_t state, const unsigned char *dir)
+{
+  path_t path;
+  int r, count;
+
+  state->team_extra_dir = xstrdup(dir);
+  if (!dir || !*dir) {
+    state->read_only = 1;
+    return 0;
+  }
+  if (os_MakeDirPath(dir, 0770) < 0) {
+    err("team_extra: cannot create %s: %s", dir, os_ErrorMsg());
+    state->read_only = 1;
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", dir, SNAPSHOT_NAME);
+  if ((r = load_snapshot(state, path)) < 0) {
+    // keep the damaged store for inspection
+    state->read_only = 1;
+    return -1;
+  }
+  if (!r) {
+    if ((count = import_xml_files(state, dir, 0)) > 0)
+      info("team_extra: %d entries imported from %s", count, dir);
+  }
+
+  snprintf(path, sizeof(path), "%s/%s", dir, JOURNAL_NAME);
+  if ((r = replay_journal(state, path)) < 0) {
+    state->read_only = 1;
+    return -1;
+  }
+  if (!r) {
+    // a new store, or the journal is already in the snapshot
+    if (write_snapshot(state) < 0 || reset_journal(state) < 0) {
+      state->read_only = 1;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static void
+journal_append(
+        team_extra_state_t state,
+        int op,
+        int user_id,
+        int value,
+        time_t date,
+        const ej_ip_t *ip,
+        const unsigned char *s1,
+        const unsigned char *s2)
+{
+  struct journal_record jr;
+  size_t need;
+  unsigned char *p;
+
+  memset(&jr, 0, sizeof(jr));
+  jr.op = op;
+  jr.user_id = user_id;
+  jr.value = value;
+  jr.date = date;
+  if (ip) jr.ip = *ip;
+  if (s1) jr.len1 = strlen(s1) + 1;
+  if (s2) jr.len2 = strlen(s2) + 1;
+
+  need = sizeof(jr) + jr.len1 + jr.len2;
+  if (state->jbuf_u + need > state->jbuf_a) {
+    if (!state->jbuf_a) state->jbuf_a = 4096;
+    while (state->jbuf_u + need > state->jbuf_a) state->jbuf_a *= 2;
+    XREALLOC(state->jbuf, state->jbuf_a);
+  }
+  p = state->jbuf + state->jbuf_u;
+  memcpy(p, &jr, sizeof(jr));
+  if (jr.len1 > 0) memcpy(p + sizeof(jr), s1, jr.len1);
+  if (jr.len2 > 0) memcpy(p + sizeof(jr) + jr.len1, s2, jr.len2);
+  ((struct journal_record *) p)->crc = crc32(0, p, need);
+  state->jbuf_u += need;
+}
+
+/* the changes are rejected, if the store cannot be written */
+static int
+check_writable(team_extra_state_t state)
+{
+  if (!state->read_only) return 0;
+  err("team_extra: the store in %s is read-only, the change is rejected",
+      state->team_extra_dir);
+  return -1;
+}
+
+int
+team_extra_flush(team_extra_state_t state)
+{
+  if (!state->jbuf_u) return 0;
+
+  if (open_journal(state) < 0) return -1;
+  if (full_write(state->journal_fd, state->jbuf, state->jbuf_u) < 0) {
+    err("team_extra: journal write failed: %s", os_ErrorMsg());
+    // the records are in the memory, try to save them in the snapshot
+    state->jbuf_u = 0;
+    if (write_snapshot(state) < 0 || reset_journal(state) < 0) return -1;
+    return 0;
+  }
+  state->journal_size += state->jbuf_u;
+  state->jbuf_u = 0;
+
+  if (state->journal_size > MIN_JOURNAL_SIZE
+      && state->journal_size > state->snapshot_size) {
+    if (write_snapshot(state) >= 0) reset_journal(state);
+  }
+  return 0;
+}
+
+const struct team_extra*
+team_extra_get_entry(team_extra_state_t state, int user_id)
+{
+  ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
+  return get_entry(state, user_id, 1);
+}
+
 int
 team_extra_get_clar_status(team_extra_state_t state, int user_id, int clar_id)
 {
@@ -263,9 +840,7 @@ team_extra_get_clar_status(team_extra_state_t state, int user_id, int clar_id)
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
   ASSERT(clar_id >= 0 && clar_id <= EJ_MAX_CLAR_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
-  te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
+  if (!(te = get_entry(state, user_id, 1))) return 0;
   ASSERT(te->user_id == user_id);
 
   if (clar_id >= te->clar_map_size) return 0;
@@ -282,41 +857,17 @@ team_extra_set_clar_status(team_extra_state_t state, int user_id, int clar_id)
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
   ASSERT(clar_id >= 0 && clar_id <= EJ_MAX_CLAR_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+  if ((te = get_entry(state, user_id, 1)) && clar_id < te->clar_map_size
+      && (te->clar_map[clar_id / BPE] & (1UL << clar_id % BPE)))
+    return 1;
+  if (check_writable(state) < 0) return -1;
   te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
   ASSERT(te->user_id == user_id);
-  if (clar_id >= te->clar_map_size) extend_clar_map(te, clar_id);
-  if ((te->clar_map[clar_id / BPE] & (1UL << clar_id % BPE)))
-    return 1;
-  te->clar_map[clar_id / BPE] |= (1UL << clar_id % BPE);
-  te->is_dirty = 1;
+  if (!do_set_clar(te, clar_id)) return 1;
+  journal_append(state, JOP_SET_CLAR, user_id, clar_id, 0, NULL, NULL, NULL);
   return 0;
 }
 
-void
-team_extra_flush(team_extra_state_t state)
-{
-  int i;
-  path_t wpath;
-  FILE *f;
-
-  for (i = 1; i < state->team_map_size; i++) {
-    if (!state->team_map[i]) continue;
-    if (state->team_map[i] == (struct team_extra*) -1) continue;
-    ASSERT(state->team_map[i]->user_id == i);
-    if (!state->team_map[i]->is_dirty) continue;
-    if (make_write_path(state, wpath, sizeof(wpath), i) < 0) continue;
-    if (!(f = fopen(wpath, "w"))) {
-      unlink(wpath);
-      continue;
-    }
-    team_extra_unparse_xml(f, state->team_map[i]);
-    fclose(f);
-    state->team_map[i]->is_dirty = 0;
-  }
-}
-
 int
 team_extra_append_warning(
         team_extra_state_t state,
@@ -328,30 +879,16 @@ team_extra_append_warning(
         const unsigned char *cmt)
 {
   struct team_extra *te;
-  struct team_warning *cur_warn;
 
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+  if (check_writable(state) < 0) return -1;
   te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
   ASSERT(te->user_id == user_id);
 
-  if (te->warn_u == te->warn_a) {
-    te->warn_a *= 2;
-    if (!te->warn_a) te->warn_a = 8;
-    XREALLOC(te->warns, te->warn_a);
-  }
-  XCALLOC(cur_warn, 1);
-  te->warns[te->warn_u++] = cur_warn;
-
-  cur_warn->date = issue_date;
-  cur_warn->issuer_id = issuer_id;
-  cur_warn->issuer_ip = *issuer_ip;
-  cur_warn->text = xstrdup(txt);
-  cur_warn->comment = xstrdup(cmt);
-
-  te->is_dirty = 1;
+  do_append_warning(te, issuer_id, issuer_ip, issue_date, txt, cmt);
+  journal_append(state, JOP_APPEND_WARNING, user_id, issuer_id, issue_date,
+                 issuer_ip, txt, cmt);
   return 0;
 }
 
@@ -362,14 +899,13 @@ team_extra_set_status(team_extra_state_t state, int user_id, int status)
 
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+  if (check_writable(state) < 0) return -1;
   te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
   ASSERT(te->user_id == user_id);
 
   if (te->status == status) return 0;
   te->status = status;
-  te->is_dirty = 1;
+  journal_append(state, JOP_SET_STATUS, user_id, status, 0, NULL, NULL, NULL);
   return 1;
 }
 
@@ -381,14 +917,13 @@ team_extra_set_disq_comment(team_extra_state_t state, int user_id,
 
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+  if (check_writable(state) < 0) return -1;
   te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
   ASSERT(te->user_id == user_id);
 
-  xfree(te->disq_comment);
-  te->disq_comment = xstrdup(disq_comment);
-  te->is_dirty = 1;
+  do_set_disq_comment(te, disq_comment);
+  journal_append(state, JOP_SET_DISQ_COMMENT, user_id, 0, 0, NULL,
+                 disq_comment, NULL);
   return 1;
 }
 
@@ -399,9 +934,7 @@ team_extra_get_run_fields(team_extra_state_t state, int user_id)
 
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
-  te = get_entry(state, user_id, 1);
-  if (!te || te == (struct team_extra*) -1) return 0;
+  if (!(te = get_entry(state, user_id, 1))) return 0;
   ASSERT(te->user_id == user_id);
   return te->run_fields;
 }
@@ -413,13 +946,13 @@ team_extra_set_run_fields(team_extra_state_t state, int user_id, int run_fields)
 
   ASSERT(user_id > 0 && user_id <= EJ_MAX_USER_ID);
 
-  if (user_id >= state->team_map_size) extend_team_map(state, user_id);
+  if (check_writable(state) < 0) return -1;
   te = get_entry(state, user_id, 0);
-  if (te == (struct team_extra*) -1) return -1;
   ASSERT(te->user_id == user_id);
 
   if (te->run_fields == run_fields) return 0;
   te->run_fields = run_fields;
-  te->is_dirty = 1;
+  journal_append(state, JOP_SET_RUN_FIELDS, user_id, run_fields, 0, NULL,
+                 NULL, NULL);
   return 1;
 }
@@ -63,12 +63,13 @@ int team_extra_set_dir(team_extra_state_t, const unsigned char *);
 int team_extra_parse_xml(const unsigned char *path, struct team_extra **pte);
 int team_extra_unparse_xml(FILE *f, struct team_extra *te);
 
-void team_extra_flush(team_extra_state_t state);
+int team_extra_flush(team_extra_state_t state);
 
 int team_extra_get_clar_status(team_extra_state_t state,
                                int user_id, int clar_id);
 int team_extra_set_clar_status(team_extra_state_t, int user_id, int clar_id);
 
+/* returns NULL, if no extra data is stored for the user */
 const struct team_extra* team_extra_get_entry(team_extra_state_t state,
                                               int user_id);
 
@@ -289,11 +289,51 @@ teamdb_set_update_flag(teamdb_state_t state)
   state->need_update = 1;
 }
 
+void
+teamdb_set_image_dir(teamdb_state_t state, const unsigned char *dir)
+{
+  state->image = userlist_image_close(state->image);
+  xfree(state->image_dir); state->image_dir = 0;
+  if (dir && *dir) state->image_dir = xstrdup(dir);
+  state->image_retry_time = 0;
+}
+
+/*
+ * returns 1, if the current user table image is mapped, a check
+ * of the `superseded' flag is all we need on the fast path.
+ * If there is no image, the XML user list is used.
+ */
+static int
+use_image(teamdb_state_t state)
+{
+  struct userlist_image *img;
+  time_t cur_time;
+
+  if (!state->image_dir) return 0;
+  if (state->image) {
+    if (!userlist_image_is_stale(state->image)) return 1;
+  } else {
+    // do not hammer the file system, if nothing is published
+    cur_time = time(0);
+    if (cur_time == state->image_retry_time) return 0;
+    state->image_retry_time = cur_time;
+  }
+
+  img = userlist_image_open(state->image_dir, state->contest_id);
+  if (img && userlist_image_is_stale(img)) img = userlist_image_close(img);
+  state->image = userlist_image_close(state->image);
+  if (!(state->image = img)) return 0;
+  state->image_vintage++;
+  call_update_hooks(state);
+  return 1;
+}
+
 int
 teamdb_get_vintage(teamdb_state_t state)
 {
+  if (use_image(state)) return state->pseudo_vintage + state->image_vintage;
   if (teamdb_refresh(state) < 0) return 0;
-  if (state->callbacks) return state->pseudo_vintage;
+  if (state->callbacks) return state->pseudo_vintage + state->image_vintage;
   return state->old.local_users.vintage;
 }
 
@@ -337,6 +377,8 @@ teamdb_lookup_client(teamdb_state_t state, int teamno)
 int
 teamdb_lookup(teamdb_state_t state, int teamno)
 {
+  if (!state->disabled && use_image(state))
+    return userlist_image_get_user(state->image, teamno) != 0;
   if (teamdb_refresh(state) < 0) return 0;
   return teamdb_lookup_client(state, teamno);
 }
@@ -345,9 +387,14 @@ int
 teamdb_lookup_login(teamdb_state_t state, char const *login)
 {
   int i;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) return -1;
 
+  if (use_image(state)) {
+    if (!(iu = userlist_image_find_login(state->image, login))) return -1;
+    return iu->user_id;
+  }
   if (teamdb_refresh(state) < 0) return -1;
   if (!state->participants) return -1;
   for (i = 0; i < state->total_participants; i++) {
@@ -365,9 +412,19 @@ teamdb_lookup_name(teamdb_state_t state, char const *name)
   int i;
   const unsigned char *v;
   const struct userlist_user *u = 0;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) return -1;
 
+  if (use_image(state)) {
+    for (i = 0; i < state->image->hdr->user_count; ++i) {
+      iu = &state->image->users[i];
+      v = userlist_image_str(state->image, iu->name);
+      if (!*v) v = userlist_image_str(state->image, iu->login);
+      if (!strcmp(v, name)) return iu->user_id;
+    }
+    return -1;
+  }
   if (teamdb_refresh(state) < 0) return -1;
   if (!state->participants) return -1;
   for (i = 0; i < state->total_participants; i++) {
@@ -407,6 +464,7 @@ char *
 teamdb_get_login(teamdb_state_t state, int teamid)
 {
   unsigned char *login = 0;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) {
     static unsigned char login_buf[64];
@@ -414,6 +472,13 @@ teamdb_get_login(teamdb_state_t state, int teamid)
     return login_buf;
   }
 
+  if (use_image(state)) {
+    if (!(iu = userlist_image_get_user(state->image, teamid))) {
+      err("teamdb_get_login: bad id: %d", teamid);
+      return 0;
+    }
+    return (char*) userlist_image_str(state->image, iu->login);
+  }
   if (teamdb_refresh(state) < 0) return 0;
   if (!teamdb_lookup_client(state, teamid)) {
     err("teamdb_get_login: bad id: %d", teamid);
@@ -429,6 +494,7 @@ teamdb_get_name(teamdb_state_t state, int teamid)
 {
   unsigned char *name = 0;
   const struct userlist_user_info *ui = 0;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) {
     static unsigned char login_buf[64];
@@ -436,6 +502,13 @@ teamdb_get_name(teamdb_state_t state, int teamid)
     return login_buf;
   }
 
+  if (use_image(state)) {
+    if (!(iu = userlist_image_get_user(state->image, teamid))) {
+      err("teamdb_get_login: bad id: %d", teamid);
+      return 0;
+    }
+    return (char*) userlist_image_str(state->image, iu->name);
+  }
   if (teamdb_refresh(state) < 0) return 0;
   if (!teamdb_lookup_client(state, teamid)) {
     err("teamdb_get_login: bad id: %d", teamid);
@@ -452,6 +525,7 @@ teamdb_get_name_2(teamdb_state_t state, int teamid)
 {
   unsigned char *name = 0;
   const struct userlist_user_info *ui = 0;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) {
     static unsigned char login_buf[64];
@@ -459,6 +533,14 @@ teamdb_get_name_2(teamdb_state_t state, int teamid)
     return login_buf;
   }
 
+  if (use_image(state)) {
+    if (!(iu = userlist_image_get_user(state->image, teamid))) {
+      err("teamdb_get_login: bad id: %d", teamid);
+      return 0;
+    }
+    if (iu->name) return userlist_image_str(state->image, iu->name);
+    return userlist_image_str(state->image, iu->login);
+  }
   if (teamdb_refresh(state) < 0) return 0;
   if (!teamdb_lookup_client(state, teamid)) {
     err("teamdb_get_login: bad id: %d", teamid);
@@ -517,8 +599,18 @@ teamdb_convert_flags(int old_flags)
 int
 teamdb_get_flags(teamdb_state_t state, int id)
 {
+  const struct userlist_image_user *iu;
+
   if (state->disabled) return 0;
 
+  if (use_image(state)) {
+    if (!(iu = userlist_image_get_user(state->image, id))) {
+      err("teamdb_get_flags: bad team id %d (contest_id %d)", id,
+          state->contest_id);
+      return TEAM_BANNED;
+    }
+    return teamdb_convert_flags(iu->flags);
+  }
   if (teamdb_refresh(state) < 0) return TEAM_BANNED;
   if (!teamdb_lookup_client(state, id)) {
     err("teamdb_get_flags: bad team id %d (contest_id %d)", id,
@@ -547,6 +639,7 @@ teamdb_get_max_team_id(teamdb_state_t state)
 {
   if (state->disabled) return 0;
 
+  if (use_image(state)) return state->image->hdr->max_user_id;
   if (teamdb_refresh(state) < 0) return 0;
   return state->users->user_map_size - 1;
 }
@@ -556,6 +649,7 @@ teamdb_get_total_teams(teamdb_state_t state)
 {
   if (state->disabled) return 0;
 
+  if (use_image(state)) return state->image->hdr->user_count;
   if (teamdb_refresh(state) < 0) return 0;
   return state->total_participants;
 }
@@ -696,6 +790,7 @@ teamdb_get_user_status_map(teamdb_state_t state, int *p_size, int **p_map)
   int *map = 0;
   struct userlist_contest *uc;
   int old_flags, new_flags;
+  const struct userlist_image_user *iu;
 
   if (state->disabled) {
     *p_size = 0;
@@ -703,6 +798,26 @@ teamdb_get_user_status_map(teamdb_state_t state, int *p_size, int **p_map)
     return 0;
   }
 
+  if (use_image(state)) {
+    if (state->image->hdr->max_user_id <= 0) {
+      *p_size = 0;
+      *p_map = 0;
+      return 0;
+    }
+    map_size = state->image->hdr->max_user_id + 1;
+    XCALLOC(map, map_size);
+    for (i = 1; i < map_size; i++) {
+      if (!(iu = userlist_image_get_user(state->image, i))) {
+        map[i] = -1;
+        continue;
+      }
+      map[i] = teamdb_convert_flags(iu->flags);
+    }
+    *p_size = map_size;
+    *p_map = map;
+    return 1;
+  }
+
   if (teamdb_refresh(state) < 0) return -1;
 
   if (state->users->user_map_size <= 0) {
@@ -757,6 +872,8 @@ teamdb_destroy(teamdb_state_t state)
     xfree(state->old.server_path);
   }
   xfree(state->callbacks);
+  userlist_image_close(state->image);
+  xfree(state->image_dir);
 
   if (state->users) userlist_free((struct xml_tree*) state->users);
   xfree(state->participants);
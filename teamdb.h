@@ -51,6 +51,9 @@ int teamdb_open_client(teamdb_state_t state,
 int teamdb_set_callbacks(teamdb_state_t state,
                          const struct teamdb_db_callbacks *callbacks,
                          int contest_id);
+/* use the user table images published by userlist-server in 'dir'
+   for the lookups, which do not need the full user information */
+void teamdb_set_image_dir(teamdb_state_t state, const unsigned char *dir);
 int teamdb_refresh(teamdb_state_t);
 void teamdb_set_update_flag(teamdb_state_t state);
 
@@ -18,6 +18,7 @@
  */
 
 #include "userlist_proto.h"
+#include "userlist_image.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -72,6 +73,12 @@ struct teamdb_state
   struct teamdb_extra **extra_info;
 
   struct update_hook *first_update_hook;
+
+  /* the image of the users published by userlist-server */
+  unsigned char *image_dir;
+  struct userlist_image *image;
+  int image_vintage;
+  time_t image_retry_time;
 };
 
 #endif /* __TEAMDB_PRIV_H__ */
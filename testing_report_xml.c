@@ -246,6 +246,15 @@ static struct xml_parse_spec testing_report_parse_spec =
   .attr_free = NULL,
 };
 
+/* the tree is in an arena, so the texts are copied */
+static int
+leaf_elem_dup(struct xml_tree *t, unsigned char **p_value)
+{
+  if (xml_leaf_elem(t, p_value, 0, 1) < 0) return -1;
+  *p_value = xstrdup(*p_value);
+  return 0;
+}
+
 static int
 parse_scoring(const unsigned char *str, int *px)
 {
@@ -279,7 +288,7 @@ parse_test(struct xml_tree *t, testing_report_xml_t r)
     xml_err_elem_not_allowed(t);
     return -1;
   }
-  if (xml_empty_text(t) < 0) goto failure;
+  if (xml_empty_text_c(t) < 0) goto failure;
 
   XCALLOC(p, 1);
   p->num = -1;
@@ -372,23 +381,19 @@ parse_test(struct xml_tree *t, testing_report_xml_t r)
       p->visibility = x;
       break;
     case TR_A_COMMENT:
-      p->comment = a->text;
-      a->text = 0;
+      p->comment = xstrdup(a->text);
       break;
 
     case TR_A_TEAM_COMMENT:
-      p->team_comment = a->text;
-      a->text = 0;
+      p->team_comment = xstrdup(a->text);
       break;
 
     case TR_A_CHECKER_COMMENT:
-      p->checker_comment = a->text;
-      a->text = 0;
+      p->checker_comment = xstrdup(a->text);
       break;
 
     case TR_A_EXIT_COMMENT:
-      p->exit_comment = a->text;
-      a->text = 0;
+      p->exit_comment = xstrdup(a->text);
       break;
 
     case TR_A_OUTPUT_AVAILABLE:
@@ -453,22 +458,22 @@ parse_test(struct xml_tree *t, testing_report_xml_t r)
   for (t2 = t->first_down; t2; t2 = t2->right) {
     switch (t2->tag) {
     case TR_T_ARGS:
-      if (xml_leaf_elem(t2, &q->args, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->args) < 0) goto failure;
       break;
     case TR_T_INPUT:
-      if (xml_leaf_elem(t2, &q->input, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->input) < 0) goto failure;
       break;
     case TR_T_OUTPUT:
-      if (xml_leaf_elem(t2, &q->output, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->output) < 0) goto failure;
       break;
     case TR_T_CORRECT:
-      if (xml_leaf_elem(t2, &q->correct, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->correct) < 0) goto failure;
       break;
     case TR_T_STDERR:
-      if (xml_leaf_elem(t2, &q->error, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->error) < 0) goto failure;
       break;
     case TR_T_CHECKER:
-      if (xml_leaf_elem(t2, &q->checker, 1, 1) < 0) goto failure;
+      if (leaf_elem_dup(t2, &q->checker) < 0) goto failure;
       break;
 
     default:
@@ -496,7 +501,7 @@ parse_tests(struct xml_tree *t, testing_report_xml_t r)
     xml_err_attrs(t);
     return -1;
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
 
   for (p = t->first_down; p; p = p->right) {
     if (parse_test(p, r) < 0) return -1;
@@ -516,7 +521,7 @@ parse_ttrow(struct xml_tree *t, testing_report_xml_t r)
   if (t->tag != TR_T_TTROW) {
     return xml_err_elem_not_allowed(t);
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
   if (t->first_down) {
     return xml_err_nested_elems(t);
   }
@@ -528,8 +533,7 @@ parse_ttrow(struct xml_tree *t, testing_report_xml_t r)
       row = x;
       break;
     case TR_A_NAME:
-      name = a->text;
-      a->text = 0;
+      name = xstrdup(a->text);
       break;
     case TR_A_MUST_FAIL:
       if (xml_attr_bool(a, &x) < 0) return -1;
@@ -581,7 +585,7 @@ parse_ttrows(struct xml_tree *t, testing_report_xml_t r)
     xml_err_attrs(t);
     return -1;
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
 
   for (p = t->first_down; p; p = p->right) {
     if (parse_ttrow(p, r) < 0) return -1;
@@ -602,7 +606,7 @@ parse_ttcell(struct xml_tree *t, testing_report_xml_t r)
   if (t->tag != TR_T_TTCELL) {
     return xml_err_elem_not_allowed(t);
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
   if (t->first_down) {
     return xml_err_nested_elems(t);
   }
@@ -661,7 +665,7 @@ parse_ttcells(struct xml_tree *t, testing_report_xml_t r)
     xml_err_attrs(t);
     return -1;
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
 
   for (p = t->first_down; p; p = p->right) {
     if (parse_ttcell(p, r) < 0) return -1;
@@ -684,7 +688,7 @@ parse_testing_report(struct xml_tree *t, testing_report_xml_t r)
     xml_err_top_level(t, TR_T_TESTING_REPORT);
     return -1;
   }
-  if (xml_empty_text(t) < 0) return -1;
+  if (xml_empty_text_c(t) < 0) return -1;
 
   r->run_id = -1;
   r->judge_id = -1;
@@ -1045,31 +1049,31 @@ parse_testing_report(struct xml_tree *t, testing_report_xml_t r)
   for (t2 = t->first_down; t2; t2 = t2->right) {
     switch (t2->tag) {
     case TR_T_COMMENT:
-      if (xml_leaf_elem(t2, &r->comment, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->comment) < 0) return -1;
       break;
     case TR_T_VALUER_COMMENT:
-      if (xml_leaf_elem(t2, &r->valuer_comment, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->valuer_comment) < 0) return -1;
       break;
     case TR_T_VALUER_JUDGE_COMMENT:
-      if (xml_leaf_elem(t2, &r->valuer_judge_comment, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->valuer_judge_comment) < 0) return -1;
       break;
     case TR_T_VALUER_ERRORS:
-      if (xml_leaf_elem(t2, &r->valuer_errors, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->valuer_errors) < 0) return -1;
       break;
     case TR_T_HOST:
-      if (xml_leaf_elem(t2, &r->host, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->host) < 0) return -1;
       break;
     case TR_T_CPU_MODEL:
-      if (xml_leaf_elem(t2, &r->cpu_model, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->cpu_model) < 0) return -1;
       break;
     case TR_T_CPU_MHZ:
-      if (xml_leaf_elem(t2, &r->cpu_mhz, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->cpu_mhz) < 0) return -1;
       break;
     case TR_T_ERRORS:
-      if (xml_leaf_elem(t2, &r->errors, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->errors) < 0) return -1;
       break;
     case TR_T_COMPILER_OUTPUT:
-      if (xml_leaf_elem(t2, &r->compiler_output, 1, 1) < 0) return -1;
+      if (leaf_elem_dup(t2, &r->compiler_output) < 0) return -1;
       break;
     case TR_T_TESTS:
       if (was_tests) {
@@ -1108,8 +1112,9 @@ testing_report_parse_xml(const unsigned char *str)
 {
   struct xml_tree *t = 0;
   testing_report_xml_t r = 0;
+  struct xml_arena *arena = xml_arena_create();
 
-  t = xml_build_tree_str(NULL, str, &testing_report_parse_spec);
+  t = xml_build_tree_str_arena(NULL, str, &testing_report_parse_spec, arena);
   if (!t) goto failure;
 
   xml_err_path = "<string>";
@@ -1117,12 +1122,12 @@ testing_report_parse_xml(const unsigned char *str)
 
   XCALLOC(r, 1);
   if (parse_testing_report(t, r) < 0) goto failure;
-  xml_tree_free(t, &testing_report_parse_spec);
+  xml_arena_free(arena);
   return r;
 
  failure:
   testing_report_free(r);
-  if (t) xml_tree_free(t, &testing_report_parse_spec);
+  xml_arena_free(arena);
   return 0;
 }
 
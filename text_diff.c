@@ -0,0 +1,738 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "config.h"
+#include "ej_types.h"
+
+#include "text_diff.h"
+#include "misctext.h"
+
+#include "reuse_xalloc.h"
+
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+struct diff_line
+{
+  const unsigned char *text;    /* the original text */
+  int len;
+  const unsigned char *key;     /* the text being compared */
+  int key_len;
+  unsigned hash;
+  int no_eol;                   /* the unterminated last line */
+};
+
+struct diff_file
+{
+  int n;
+  struct diff_line *lines;
+  int *ids;                     /* the equivalence classes of the lines */
+  unsigned char *changed;
+  int no_eol;                   /* the last line is not terminated */
+  unsigned char *norm;          /* the normalized lines */
+};
+
+/* a region of the changed lines [i1, i2) of the first file replaced
+   with the lines [j1, j2) of the second file */
+struct diff_change
+{
+  int i1, i2;
+  int j1, j2;
+};
+
+static unsigned
+hash_line(const unsigned char *s, int len)
+{
+  unsigned h = 2166136261U;
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    h ^= s[i];
+    h *= 16777619U;
+  }
+  return h;
+}
+
+/* the trailing whitespace is dropped, the other whitespace runs
+   are replaced with a single space */
+static int
+normalize_space(unsigned char *out, const unsigned char *s, int len)
+{
+  int i = 0, j = 0;
+
+  while (len > 0 && isspace(s[len - 1])) --len;
+  while (i < len) {
+    if (isspace(s[i])) {
+      while (i < len && isspace(s[i])) ++i;
+      out[j++] = ' ';
+    } else {
+      out[j++] = s[i++];
+    }
+  }
+  return j;
+}
+
+static void
+split_lines(
+        struct diff_file *f,
+        const unsigned char *text,
+        size_t size,
+        int mode,
+        int flags)
+{
+  const unsigned char *p = text, *q, *end = text + size;
+  unsigned char *np = 0;
+  int a = 16;
+  struct diff_line *l;
+
+  memset(f, 0, sizeof(*f));
+  XCALLOC(f->lines, a);
+  if ((flags & TEXT_DIFF_IGNORE_SPACE)) {
+    np = f->norm = xmalloc(size + 1);
+  }
+  while (p < end) {
+    if (!(q = memchr(p, '\n', end - p))) {
+      q = end;
+      f->no_eol = 1;
+    }
+    if (f->n == a) {
+      a *= 2;
+      XREALLOC(f->lines, a);
+    }
+    l = &f->lines[f->n++];
+    memset(l, 0, sizeof(*l));
+    l->text = p;
+    l->len = q - p;
+    if (np) {
+      l->key = np;
+      l->key_len = normalize_space(np, p, l->len);
+      np += l->key_len;
+    } else {
+      l->key = l->text;
+      l->key_len = l->len;
+    }
+    l->hash = hash_line(l->key, l->key_len);
+    /* the missing newline is visible only in the plain text mode */
+    if (q == end && mode == TEXT_DIFF_UNIFIED) {
+      l->no_eol = 1;
+      l->hash ^= 1;
+    }
+    p = q + 1;
+  }
+  XCALLOC(f->ids, f->n + 1);
+  XCALLOC(f->changed, f->n + 1);
+}
+
+static void
+free_file(struct diff_file *f)
+{
+  xfree(f->lines);
+  xfree(f->ids);
+  xfree(f->changed);
+  xfree(f->norm);
+  memset(f, 0, sizeof(*f));
+}
+
+/* assign the same ids to the equal lines of both files, so the diff
+   algorithm compares integers */
+static void
+assign_ids(struct diff_file *f1, struct diff_file *f2)
+{
+  int size = 16, mask, i, k, id_count = 0;
+  struct diff_line **tab;
+  int *tab_ids;
+  struct diff_file *f;
+  struct diff_line *l;
+
+  while (size < 2 * (f1->n + f2->n)) size *= 2;
+  mask = size - 1;
+  XCALLOC(tab, size);
+  XCALLOC(tab_ids, size);
+
+  for (f = f1; f; f = (f == f1)?f2:0) {
+    for (i = 0; i < f->n; ++i) {
+      l = &f->lines[i];
+      k = l->hash & mask;
+      while (tab[k]) {
+        if (tab[k]->hash == l->hash && tab[k]->key_len == l->key_len
+            && tab[k]->no_eol == l->no_eol
+            && !memcmp(tab[k]->key, l->key, l->key_len))
+          break;
+        k = (k + 1) & mask;
+      }
+      if (!tab[k]) {
+        tab[k] = l;
+        tab_ids[k] = id_count++;
+      }
+      f->ids[i] = tab_ids[k];
+    }
+  }
+
+  xfree(tab);
+  xfree(tab_ids);
+}
+
+struct diff_ctx
+{
+  const int *a, *b;
+  unsigned char *del, *ins;
+  int *fd, *bd;                 /* the diagonal vectors */
+  int too_expensive;            /* the cost limit of one snake search */
+};
+
+/*
+ * Find the midpoint of the shortest edit script for a[xoff, xlim)
+ * and b[yoff, ylim), running the forward and the backward searches
+ * simultaneously until they overlap. When the search costs more than
+ * too_expensive steps, the furthest reaching point found so far is
+ * taken instead, so the script is not minimal, but the time is
+ * bounded (the same heuristic as in GNU diff).
+ */
+static void
+find_middle_snake(
+        struct diff_ctx *c,
+        int xoff,
+        int xlim,
+        int yoff,
+        int ylim,
+        int *px,
+        int *py)
+{
+  const int *a = c->a, *b = c->b;
+  int *fd = c->fd, *bd = c->bd;
+  int dmin = xoff - ylim, dmax = xlim - yoff;
+  int fmid = xoff - yoff, bmid = xlim - ylim;
+  int fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+  int odd = (fmid - bmid) & 1;
+  int d, x, y, tlo, thi, cost;
+  int fxybest, fxbest = 0, bxybest, bxbest = 0;
+
+  fd[fmid] = xoff;
+  bd[bmid] = xlim;
+
+  for (cost = 1;; ++cost) {
+    if (fmin > dmin) fd[--fmin - 1] = -1;
+    else ++fmin;
+    if (fmax < dmax) fd[++fmax + 1] = -1;
+    else --fmax;
+    for (d = fmax; d >= fmin; d -= 2) {
+      tlo = fd[d - 1];
+      thi = fd[d + 1];
+      x = (tlo >= thi)?(tlo + 1):thi;
+      y = x - d;
+      while (x < xlim && y < ylim && a[x] == b[y]) {
+        ++x; ++y;
+      }
+      fd[d] = x;
+      if (odd && bmin <= d && d <= bmax && bd[d] <= x) {
+        *px = x; *py = y;
+        return;
+      }
+    }
+
+    if (bmin > dmin) bd[--bmin - 1] = INT_MAX;
+    else ++bmin;
+    if (bmax < dmax) bd[++bmax + 1] = INT_MAX;
+    else --bmax;
+    for (d = bmax; d >= bmin; d -= 2) {
+      tlo = bd[d - 1];
+      thi = bd[d + 1];
+      x = (tlo < thi)?tlo:(thi - 1);
+      y = x - d;
+      while (x > xoff && y > yoff && a[x - 1] == b[y - 1]) {
+        --x; --y;
+      }
+      bd[d] = x;
+      if (!odd && fmin <= d && d <= fmax && x <= fd[d]) {
+        *px = x; *py = y;
+        return;
+      }
+    }
+
+    if (cost < c->too_expensive) continue;
+
+    // the forward diagonal which maximizes x + y
+    fxybest = -1;
+    for (d = fmax; d >= fmin; d -= 2) {
+      x = fd[d];
+      if (x > xlim) x = xlim;
+      y = x - d;
+      if (y > ylim) {
+        x = ylim + d;
+        y = ylim;
+      }
+      if (fxybest < x + y) {
+        fxybest = x + y;
+        fxbest = x;
+      }
+    }
+    // the backward diagonal which minimizes x + y
+    bxybest = INT_MAX;
+    for (d = bmax; d >= bmin; d -= 2) {
+      x = bd[d];
+      if (x < xoff) x = xoff;
+      y = x - d;
+      if (y < yoff) {
+        x = yoff + d;
+        y = yoff;
+      }
+      if (x + y < bxybest) {
+        bxybest = x + y;
+        bxbest = x;
+      }
+    }
+    // the direction which made more progress is taken
+    if ((xlim + ylim) - bxybest < fxybest - (xoff + yoff)) {
+      *px = fxbest;
+      *py = fxybest - fxbest;
+    } else {
+      *px = bxbest;
+      *py = bxybest - bxbest;
+    }
+    return;
+  }
+}
+
+static void
+compare_seq(struct diff_ctx *c, int xoff, int xlim, int yoff, int ylim)
+{
+  int xmid, ymid;
+
+  while (xoff < xlim && yoff < ylim && c->a[xoff] == c->b[yoff]) {
+    ++xoff; ++yoff;
+  }
+  while (xlim > xoff && ylim > yoff && c->a[xlim - 1] == c->b[ylim - 1]) {
+    --xlim; --ylim;
+  }
+
+  if (xoff == xlim) {
+    while (yoff < ylim) c->ins[yoff++] = 1;
+  } else if (yoff == ylim) {
+    while (xoff < xlim) c->del[xoff++] = 1;
+  } else {
+    find_middle_snake(c, xoff, xlim, yoff, ylim, &xmid, &ymid);
+    compare_seq(c, xoff, xmid, yoff, ymid);
+    compare_seq(c, xmid, xlim, ymid, ylim);
+  }
+}
+
+static int
+is_blank_line(const struct diff_line *l)
+{
+  int i;
+
+  for (i = 0; i < l->len; ++i)
+    if (!isspace(l->text[i]))
+      return 0;
+  return 1;
+}
+
+static int
+collect_changes(
+        struct diff_file *f1,
+        struct diff_file *f2,
+        int flags,
+        struct diff_change **p_changes)
+{
+  int i = 0, j = 0, i1, j1, k, u = 0, a = 0, blank;
+  struct diff_change *changes = 0;
+
+  while (i < f1->n || j < f2->n) {
+    if ((i < f1->n && f1->changed[i]) || (j < f2->n && f2->changed[j])) {
+      i1 = i; j1 = j;
+      while (i < f1->n && f1->changed[i]) ++i;
+      while (j < f2->n && f2->changed[j]) ++j;
+      if ((flags & TEXT_DIFF_IGNORE_BLANK_LINES)) {
+        blank = 1;
+        for (k = i1; k < i && blank; ++k)
+          blank = is_blank_line(&f1->lines[k]);
+        for (k = j1; k < j && blank; ++k)
+          blank = is_blank_line(&f2->lines[k]);
+        if (blank) continue;
+      }
+      if (u == a) {
+        if (!(a *= 2)) a = 16;
+        XREALLOC(changes, a);
+      }
+      changes[u].i1 = i1;
+      changes[u].i2 = i;
+      changes[u].j1 = j1;
+      changes[u].j2 = j;
+      ++u;
+    } else {
+      ++i; ++j;
+    }
+  }
+
+  *p_changes = changes;
+  return u;
+}
+
+static void
+write_armored(
+        FILE *out,
+        struct html_armor_buffer *ab,
+        const unsigned char *text,
+        int len)
+{
+  html_armor_reserve(ab, html_armored_memlen(text, len) + 1);
+  fwrite(ab->buf, 1, html_armor_text(text, len, ab->buf), out);
+}
+
+static void
+write_line(
+        FILE *out,
+        struct html_armor_buffer *ab,
+        int mode,
+        const struct diff_file *f,
+        int i,
+        int prefix,
+        const unsigned char *cls)
+{
+  const struct diff_line *l = &f->lines[i];
+
+  if (mode == TEXT_DIFF_UNIFIED) {
+    putc(prefix, out);
+    fwrite(l->text, 1, l->len, out);
+    putc('\n', out);
+    if (f->no_eol && i == f->n - 1)
+      fprintf(out, "\\ No newline at end of file\n");
+    return;
+  }
+
+  fprintf(out, "<span class=\"%s\">%c", cls, prefix);
+  write_armored(out, ab, l->text, l->len);
+  fprintf(out, "</span>\n");
+}
+
+static void
+write_cell(
+        FILE *out,
+        struct html_armor_buffer *ab,
+        const struct diff_file *f,
+        int i,
+        const unsigned char *cls)
+{
+  if (i < 0) {
+    fprintf(out, "<td class=\"diff_num\">&nbsp;</td><td class=\"diff_empty\">&nbsp;</td>");
+    return;
+  }
+  fprintf(out, "<td class=\"diff_num\">%d</td><td class=\"%s\">", i + 1, cls);
+  write_armored(out, ab, f->lines[i].text, f->lines[i].len);
+  fprintf(out, "</td>");
+}
+
+static void
+write_hunk_header(
+        FILE *out,
+        int mode,
+        int i1,
+        int i2,
+        int j1,
+        int j2)
+{
+  unsigned char b1[64], b2[64];
+
+  /* the empty range is denoted by the line before it */
+  if (i2 - i1 == 1) snprintf(b1, sizeof(b1), "%d", i1 + 1);
+  else snprintf(b1, sizeof(b1), "%d,%d", (i2 > i1)?(i1 + 1):i1, i2 - i1);
+  if (j2 - j1 == 1) snprintf(b2, sizeof(b2), "%d", j1 + 1);
+  else snprintf(b2, sizeof(b2), "%d,%d", (j2 > j1)?(j1 + 1):j1, j2 - j1);
+
+  switch (mode) {
+  case TEXT_DIFF_UNIFIED:
+    fprintf(out, "@@ -%s +%s @@\n", b1, b2);
+    break;
+  case TEXT_DIFF_UNIFIED_HTML:
+    fprintf(out, "<span class=\"diff_hunk\">@@ -%s +%s @@</span>\n", b1, b2);
+    break;
+  case TEXT_DIFF_SIDE_BY_SIDE_HTML:
+    fprintf(out, "<tr><td class=\"diff_hunk\" colspan=\"4\">@@ -%s +%s @@</td></tr>\n", b1, b2);
+    break;
+  }
+}
+
+/* the changes [c1, c2) form a single hunk */
+static void
+write_hunk(
+        FILE *out,
+        struct html_armor_buffer *ab,
+        int mode,
+        int context,
+        const struct diff_file *f1,
+        const struct diff_file *f2,
+        const struct diff_change *changes,
+        int c1,
+        int c2)
+{
+  int i1, i2, j1, j2, i, j, k, r, rows;
+  const struct diff_change *ch;
+  const unsigned char *cls1, *cls2;
+
+  i1 = changes[c1].i1 - context;
+  if (i1 < 0) i1 = 0;
+  j1 = changes[c1].j1 - (changes[c1].i1 - i1);
+  i2 = changes[c2 - 1].i2 + context;
+  if (i2 > f1->n) i2 = f1->n;
+  j2 = changes[c2 - 1].j2 + (i2 - changes[c2 - 1].i2);
+  write_hunk_header(out, mode, i1, i2, j1, j2);
+
+  i = i1; j = j1;
+  for (k = c1; k <= c2; ++k) {
+    // the common lines before the change, or the trailing context
+    r = (k < c2)?changes[k].i1:i2;
+    for (; i < r; ++i, ++j) {
+      if (mode == TEXT_DIFF_SIDE_BY_SIDE_HTML) {
+        fprintf(out, "<tr>");
+        write_cell(out, ab, f1, i, "diff_eq");
+        write_cell(out, ab, f2, j, "diff_eq");
+        fprintf(out, "</tr>\n");
+      } else {
+        write_line(out, ab, mode, f1, i, ' ', "diff_eq");
+      }
+    }
+    if (k == c2) break;
+
+    ch = &changes[k];
+    if (mode == TEXT_DIFF_SIDE_BY_SIDE_HTML) {
+      rows = ch->i2 - ch->i1;
+      if (ch->j2 - ch->j1 > rows) rows = ch->j2 - ch->j1;
+      for (r = 0; r < rows; ++r) {
+        cls1 = "diff_del"; cls2 = "diff_ins";
+        if (ch->i1 + r < ch->i2 && ch->j1 + r < ch->j2) {
+          cls1 = cls2 = "diff_chg";
+        }
+        fprintf(out, "<tr>");
+        write_cell(out, ab, f1, (ch->i1 + r < ch->i2)?(ch->i1 + r):-1, cls1);
+        write_cell(out, ab, f2, (ch->j1 + r < ch->j2)?(ch->j1 + r):-1, cls2);
+        fprintf(out, "</tr>\n");
+      }
+    } else {
+      for (i = ch->i1; i < ch->i2; ++i)
+        write_line(out, ab, mode, f1, i, '-', "diff_del");
+      for (j = ch->j1; j < ch->j2; ++j)
+        write_line(out, ab, mode, f2, j, '+', "diff_ins");
+    }
+    i = ch->i2; j = ch->j2;
+  }
+}
+
+int
+text_diff(
+        FILE *out,
+        const unsigned char *text1,
+        size_t size1,
+        const unsigned char *text2,
+        size_t size2,
+        int mode,
+        int flags,
+        int context)
+{
+  struct diff_file f1, f2;
+  struct diff_ctx c;
+  struct diff_change *changes = 0;
+  int change_count, diag_count, k, c1;
+  struct html_armor_buffer ab = HTML_ARMOR_INITIALIZER;
+
+  if (mode < 0 || mode >= TEXT_DIFF_MODE_LAST) return -1;
+  if (context < 0) context = TEXT_DIFF_DEFAULT_CONTEXT;
+
+  split_lines(&f1, text1, size1, mode, flags);
+  split_lines(&f2, text2, size2, mode, flags);
+  if (f1.n + f2.n > TEXT_DIFF_MAX_LINES) {
+    free_file(&f1);
+    free_file(&f2);
+    return TEXT_DIFF_TOO_LARGE;
+  }
+  assign_ids(&f1, &f2);
+
+  /* the diagonals range from -(f2.n + 1) to f1.n + 1 */
+  diag_count = f1.n + f2.n + 3;
+  memset(&c, 0, sizeof(c));
+  c.a = f1.ids;
+  c.b = f2.ids;
+  c.del = f1.changed;
+  c.ins = f2.changed;
+  // about the square root of the diagonal count, but at least 256
+  c.too_expensive = 1;
+  for (k = diag_count; k; k >>= 2) c.too_expensive <<= 1;
+  if (c.too_expensive < 256) c.too_expensive = 256;
+  XCALLOC(c.fd, 2 * diag_count);
+  c.bd = c.fd + diag_count;
+  c.fd += f2.n + 1;
+  c.bd += f2.n + 1;
+  compare_seq(&c, 0, f1.n, 0, f2.n);
+  xfree(c.fd - (f2.n + 1));
+
+  change_count = collect_changes(&f1, &f2, flags, &changes);
+
+  if (change_count > 0 && mode == TEXT_DIFF_UNIFIED_HTML)
+    fprintf(out, "<pre class=\"diff\">");
+  if (change_count > 0 && mode == TEXT_DIFF_SIDE_BY_SIDE_HTML)
+    fprintf(out, "<table class=\"diff\">\n");
+
+  /* the changes separated by at most 2*context common lines
+     are merged into one hunk */
+  for (k = 0, c1 = 0; k < change_count; ++k) {
+    if (k + 1 == change_count
+        || changes[k + 1].i1 - changes[k].i2 > 2 * context) {
+      write_hunk(out, &ab, mode, context, &f1, &f2, changes, c1, k + 1);
+      c1 = k + 1;
+    }
+  }
+
+  if (change_count > 0 && mode == TEXT_DIFF_UNIFIED_HTML)
+    fprintf(out, "</pre>\n");
+  if (change_count > 0 && mode == TEXT_DIFF_SIDE_BY_SIDE_HTML)
+    fprintf(out, "</table>\n");
+
+  html_armor_free(&ab);
+  xfree(changes);
+  free_file(&f1);
+  free_file(&f2);
+  return change_count;
+}
+
+struct text_diff_cache_entry
+{
+  unsigned char sha1_1[20];
+  unsigned char sha1_2[20];
+  int mode;
+  int flags;
+  unsigned char *text;          /* NULL for a free entry */
+  size_t size;
+  long long last_use;
+};
+
+struct text_diff_cache
+{
+  int max_entries;
+  size_t max_size;
+  size_t total_size;
+  long long tick;
+  struct text_diff_cache_entry *entries;
+};
+
+struct text_diff_cache *
+text_diff_cache_create(int max_entries, size_t max_size)
+{
+  struct text_diff_cache *cache;
+
+  if (max_entries <= 0) max_entries = 64;
+  if (!max_size) max_size = 16 * 1024 * 1024;
+  XCALLOC(cache, 1);
+  cache->max_entries = max_entries;
+  cache->max_size = max_size;
+  XCALLOC(cache->entries, max_entries);
+  return cache;
+}
+
+struct text_diff_cache *
+text_diff_cache_free(struct text_diff_cache *cache)
+{
+  int i;
+
+  if (!cache) return 0;
+  for (i = 0; i < cache->max_entries; ++i)
+    xfree(cache->entries[i].text);
+  xfree(cache->entries);
+  xfree(cache);
+  return 0;
+}
+
+const unsigned char *
+text_diff_cache_get(
+        struct text_diff_cache *cache,
+        const void *sha1_1,
+        const void *sha1_2,
+        int mode,
+        int flags,
+        size_t *p_size)
+{
+  int i;
+  struct text_diff_cache_entry *e;
+
+  if (!cache) return 0;
+  for (i = 0; i < cache->max_entries; ++i) {
+    e = &cache->entries[i];
+    if (e->text && e->mode == mode && e->flags == flags
+        && !memcmp(e->sha1_1, sha1_1, 20) && !memcmp(e->sha1_2, sha1_2, 20)) {
+      e->last_use = ++cache->tick;
+      if (p_size) *p_size = e->size;
+      return e->text;
+    }
+  }
+  return 0;
+}
+
+static void
+drop_entry(struct text_diff_cache *cache, struct text_diff_cache_entry *e)
+{
+  cache->total_size -= e->size;
+  xfree(e->text);
+  e->text = 0;
+  e->size = 0;
+}
+
+void
+text_diff_cache_put(
+        struct text_diff_cache *cache,
+        const void *sha1_1,
+        const void *sha1_2,
+        int mode,
+        int flags,
+        unsigned char *text,
+        size_t size)
+{
+  int i;
+  struct text_diff_cache_entry *e, *lru;
+
+  if (!cache || size > cache->max_size / 4) {
+    xfree(text);
+    return;
+  }
+
+  // evict the least recently used entries until the text fits
+  while (1) {
+    e = 0; lru = 0;
+    for (i = 0; i < cache->max_entries; ++i) {
+      if (!cache->entries[i].text) {
+        if (!e) e = &cache->entries[i];
+      } else if (!lru || cache->entries[i].last_use < lru->last_use) {
+        lru = &cache->entries[i];
+      }
+    }
+    if (e && cache->total_size + size <= cache->max_size) break;
+    drop_entry(cache, lru);
+  }
+
+  memcpy(e->sha1_1, sha1_1, 20);
+  memcpy(e->sha1_2, sha1_2, 20);
+  e->mode = mode;
+  e->flags = flags;
+  e->text = text;
+  e->size = size;
+  e->last_use = ++cache->tick;
+  cache->total_size += size;
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make"
+ * End:
+ */
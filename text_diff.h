@@ -0,0 +1,100 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __TEXT_DIFF_H__
+#define __TEXT_DIFF_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * In-process line diff of two memory buffers (the linear space
+ * variant of the Myers O(ND) algorithm). Only the hunks are written,
+ * the file headers and the page decoration are left to the caller,
+ * so the output depends only on the contents of the buffers and can
+ * be cached by their digests.
+ */
+
+/* output modes */
+enum
+{
+  TEXT_DIFF_UNIFIED = 0,        /* plain text, like `diff -u' */
+  TEXT_DIFF_UNIFIED_HTML,       /* the same in the <pre> element */
+  TEXT_DIFF_SIDE_BY_SIDE_HTML,  /* two column table */
+
+  TEXT_DIFF_MODE_LAST
+};
+
+/* comparison flags */
+enum
+{
+  TEXT_DIFF_IGNORE_SPACE = 1,       /* like `diff -b' */
+  TEXT_DIFF_IGNORE_BLANK_LINES = 2, /* like `diff -B' */
+};
+
+enum { TEXT_DIFF_DEFAULT_CONTEXT = 3 };
+
+/* the texts with more lines in total are not compared */
+enum { TEXT_DIFF_MAX_LINES = 200000 };
+
+/* the return code for the texts which are too large */
+enum { TEXT_DIFF_TOO_LARGE = -2 };
+
+/* writes the difference to out, returns the number of the changed
+   regions (0, if the texts are equal), TEXT_DIFF_TOO_LARGE, or -1 on
+   error, the search is cut off on the very different texts, so the
+   result may be longer than the shortest one */
+int
+text_diff(
+        FILE *out,
+        const unsigned char *text1,
+        size_t size1,
+        const unsigned char *text2,
+        size_t size2,
+        int mode,
+        int flags,
+        int context);
+
+/* the diff results cache, the key is the SHA1 digests of the texts,
+   the mode and the flags */
+struct text_diff_cache;
+
+struct text_diff_cache *text_diff_cache_create(int max_entries, size_t max_size);
+struct text_diff_cache *text_diff_cache_free(struct text_diff_cache *cache);
+
+/* returns the cached text or NULL, the text is valid until the next
+   text_diff_cache_put */
+const unsigned char *
+text_diff_cache_get(
+        struct text_diff_cache *cache,
+        const void *sha1_1,
+        const void *sha1_2,
+        int mode,
+        int flags,
+        size_t *p_size);
+
+/* the cache takes the ownership of text */
+void
+text_diff_cache_put(
+        struct text_diff_cache *cache,
+        const void *sha1_1,
+        const void *sha1_2,
+        int mode,
+        int flags,
+        unsigned char *text,
+        size_t size);
+
+#endif /* __TEXT_DIFF_H__ */
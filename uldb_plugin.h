@@ -36,7 +36,13 @@ struct contest_desc;
 struct userlist_members;
 
 /* version of the plugin interface structure */
-#define ULDB_PLUGIN_IFACE_VERSION 2
+#define ULDB_PLUGIN_IFACE_VERSION 3
+
+/* flags of the filtered user list methods */
+enum
+{
+  ULDB_LIST_BY_RELEVANCE = 1,   /* otherwise the users are ordered by id */
+};
 
 struct uldb_plugin_iface
 {
@@ -241,7 +247,7 @@ struct uldb_plugin_iface
   // remove a group member
   int (*remove_group_member)(void *, int group_id, int user_id);
   // list users
-  ptr_iterator_t (*get_brief_list_iterator_2)(void *, int contest_id, int group_id, const unsigned char *filter, int offset, int count);
+  ptr_iterator_t (*get_brief_list_iterator_2)(void *, int contest_id, int group_id, const unsigned char *filter, int flags, int offset, int count);
   // get the total count of users for the given filter
   int (*get_user_count)(void *, int contest_id, int group_id, const unsigned char *filter, long long *p_count);
   // get the group iterator
@@ -249,9 +255,9 @@ struct uldb_plugin_iface
   // get the total number of groups to display
   int (*get_group_count)(void *, const unsigned char *filter, long long *p_count);
   // get the previous user
-  int (*get_prev_user_id)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int *p_user_id);
+  int (*get_prev_user_id)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int flags, int *p_user_id);
   // get the next user
-  int (*get_next_user_id)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int *p_user_id);
+  int (*get_next_user_id)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int flags, int *p_user_id);
   // create a new 128-bit cookie
   int (*new_cookie_2)(
         void *,
@@ -24,6 +24,7 @@
 #include "misctext.h"
 #include "ej_limits.h"
 #include "compat.h"
+#include "user_search.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -32,13 +33,17 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <zlib.h>
 
 // default interval to flush changes, in seconds
 #define DEFAULT_FLUSH_INTERVAL 600
 #define DEFAULT_BACKUP_INTERVAL (24*60*60)
+// the journal is not compacted until it reaches this size
+#define JOURNAL_COMPACT_MIN_SIZE (4*1024*1024)
 
 static struct common_plugin_data *init_func(void);
 static int finish_func(struct common_plugin_data *);
@@ -191,6 +196,7 @@ get_brief_list_iterator_2_func(
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count);
 static int
@@ -218,6 +224,7 @@ get_prev_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id);
 static int
 get_next_user_id_func(
@@ -226,6 +233,7 @@ get_next_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id);
 static int
 new_cookie_2_func(
@@ -369,6 +377,23 @@ struct uldb_xml_state
   time_t last_backup_time;
   int backup_interval;
   struct userlist_list *userlist;
+
+  // the journal of changes made after the last snapshot
+  unsigned char *journal_path;
+  unsigned char *old_journal_path;
+  off_t journal_size;
+  off_t snapshot_size;
+  int snapshot_dirty;           // some changes cannot be journaled
+  pid_t compact_pid;            // the running background compaction
+
+  // users changed since the last flush
+  int pending_u, pending_a;
+  int *pending_ids;
+  int pending_map_size;
+  unsigned char *pending_map;
+
+  // the index for the user filter, built on the first search
+  struct user_search_index *search_index;
 };
 
 struct user_id_iterator
@@ -421,6 +446,11 @@ struct brief_list_2_iterator
   int offset;
   int count;
   int user_id;
+
+  // the users found by the filter
+  int *ids;
+  int id_count;
+  int id_ind;
 };
 
 static struct userlist_user_info *
@@ -436,6 +466,19 @@ userlist_clone_member(
         int *p_serial,
         time_t current_time);
 
+static void mark_user_dirty(struct uldb_xml_state *state, int user_id);
+static int
+search_users(
+        struct uldb_xml_state *state,
+        int contest_id,
+        int group_id,
+        const unsigned char *filter,
+        int flags,
+        int **p_ids);
+static void mark_snapshot_dirty(struct uldb_xml_state *state);
+static int
+replay_journal(struct uldb_xml_state *state, const unsigned char *path);
+
 static struct common_plugin_data *
 init_func(void)
 {
@@ -464,6 +507,10 @@ prepare_func(
     return -1;
   }
   state->db_path = xstrdup(ej_cfg->db_path);
+  state->journal_path = xmalloc(strlen(state->db_path) + 16);
+  sprintf(state->journal_path, "%s.journal", state->db_path);
+  state->old_journal_path = xmalloc(strlen(state->db_path) + 16);
+  sprintf(state->old_journal_path, "%s.journal.old", state->db_path);
 
   return 0;
 }
@@ -517,11 +564,20 @@ check_func(void *data)
   // load the XML
   if (!(state->userlist = userlist_parse(state->db_path)))
     return -1;
+  state->snapshot_size = stb.st_size;
 
   state->flush_interval = DEFAULT_FLUSH_INTERVAL;
   state->last_flush_time = time(0);
   state->dirty = 0;
 
+  // apply the changes made after the snapshot
+  state->journal_size = 0;
+  if (replay_journal(state, state->old_journal_path) > 0) {
+    // the last compaction has not completed
+    mark_snapshot_dirty(state);
+  }
+  replay_journal(state, state->journal_path);
+
   if (userlist_build_login_hash(state->userlist) < 0)
     return -1;
   if (userlist_build_cookie_hash(state->userlist) < 0)
@@ -538,20 +594,60 @@ create_func(void *data)
   state->userlist = userlist_new();
   state->flush_interval = 0;
   state->last_flush_time = 0;
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
 
   return 1;
 }
 
 static void
-flush_database(struct uldb_xml_state *state)
+mark_user_dirty(struct uldb_xml_state *state, int user_id)
+{
+  int new_size;
+  unsigned char *new_map;
+
+  state->dirty = 1;
+  if (user_id <= 0) {
+    state->snapshot_dirty = 1;
+    return;
+  }
+  if (state->search_index)
+    user_search_index_invalidate(state->search_index, user_id);
+  if (user_id >= state->pending_map_size) {
+    new_size = state->pending_map_size;
+    if (!new_size) new_size = 1024;
+    while (user_id >= new_size) new_size *= 2;
+    new_map = (unsigned char*) xcalloc(new_size, sizeof(new_map[0]));
+    if (state->pending_map_size > 0)
+      memcpy(new_map, state->pending_map, state->pending_map_size);
+    xfree(state->pending_map);
+    state->pending_map = new_map;
+    state->pending_map_size = new_size;
+  }
+  if (state->pending_map[user_id]) return;
+  state->pending_map[user_id] = 1;
+  if (state->pending_u >= state->pending_a) {
+    if (!(state->pending_a *= 2)) state->pending_a = 64;
+    XREALLOC(state->pending_ids, state->pending_a);
+  }
+  state->pending_ids[state->pending_u++] = user_id;
+}
+
+static void
+mark_snapshot_dirty(struct uldb_xml_state *state)
+{
+  state->dirty = 1;
+  state->snapshot_dirty = 1;
+}
+
+/* writes the whole database to a temporary file and renames it over
+   the database file */
+static int
+write_snapshot(struct uldb_xml_state *state)
 {
   path_t basedir, tempname;
   FILE *f = 0;
   int fd = -1;
 
-  if (!state->dirty) return;
-
   os_rDirName(state->db_path, basedir, sizeof(basedir));
   snprintf(tempname, sizeof(tempname), "%s/%u", basedir, random_u32());
 
@@ -580,6 +676,277 @@ flush_database(struct uldb_xml_state *state)
     err("bdflush: rename() failed: %s", os_ErrorMsg());
     goto failed;
   }
+  return 0;
+
+ failed:
+  if (f) fclose(f);
+  if (fd >= 0) close(fd);
+  unlink(tempname);
+  return -1;
+}
+
+/*
+ * The journal is a sequence of records, each record is either
+ *   "@@ U <user_id> <member_serial> <length>\n" followed by <length> bytes
+ *     of the complete XML of the user and "\n", or
+ *   "@@ D <user_id>\n" for a removed user.
+ * The records are applied to the snapshot in order, so the last record
+ * for each user wins. Since a record holds the whole user, replaying
+ * a record which is already in the snapshot does no harm.
+ */
+static int
+append_journal(struct uldb_xml_state *state)
+{
+  struct userlist_list *ul = state->userlist;
+  struct userlist_user *u;
+  char *rec_buf = 0, *xml_buf = 0;
+  size_t rec_len = 0, xml_len = 0;
+  FILE *f = 0, *uf = 0;
+  int fd = -1, i, user_id;
+  ssize_t w;
+  const char *p;
+  size_t rem;
+  off_t old_size = -1;
+
+  if (state->pending_u <= 0) return 0;
+
+  f = open_memstream(&rec_buf, &rec_len);
+  for (i = 0; i < state->pending_u; ++i) {
+    user_id = state->pending_ids[i];
+    if (user_id >= ul->user_map_size || !(u = ul->user_map[user_id])) {
+      fprintf(f, "@@ D %d\n", user_id);
+      continue;
+    }
+    uf = open_memstream(&xml_buf, &xml_len);
+    userlist_unparse_user(u, uf, USERLIST_MODE_ALL, -1,
+                          USERLIST_SHOW_REG_PASSWD | USERLIST_SHOW_CNTS_PASSWD);
+    close_memstream(uf);
+    fprintf(f, "@@ U %d %d %zu\n", user_id, ul->member_serial, xml_len);
+    fwrite(xml_buf, 1, xml_len, f);
+    putc('\n', f);
+    xfree(xml_buf); xml_buf = 0; xml_len = 0;
+  }
+  close_memstream(f); f = 0;
+
+  if ((fd = open(state->journal_path, O_WRONLY | O_APPEND | O_CREAT, 0600)) < 0) {
+    err("bdflush: open for `%s' failed: %s", state->journal_path,
+        os_ErrorMsg());
+    goto failed;
+  }
+  old_size = lseek(fd, 0, SEEK_END);
+  p = rec_buf; rem = rec_len;
+  while (rem > 0) {
+    if ((w = write(fd, p, rem)) <= 0) {
+      err("bdflush: write to `%s' failed: %s", state->journal_path,
+          os_ErrorMsg());
+      goto failed;
+    }
+    p += w; rem -= w;
+  }
+  if (fsync(fd) < 0) {
+    err("bdflush: fsync of `%s' failed: %s", state->journal_path,
+        os_ErrorMsg());
+    goto failed;
+  }
+  close(fd); fd = -1;
+
+  state->journal_size += rec_len;
+  for (i = 0; i < state->pending_u; ++i)
+    state->pending_map[state->pending_ids[i]] = 0;
+  state->pending_u = 0;
+  xfree(rec_buf);
+  return 0;
+
+ failed:
+  // drop the partially written records, so they are rewritten next time
+  if (fd >= 0 && old_size >= 0) ftruncate(fd, old_size);
+  if (fd >= 0) close(fd);
+  xfree(rec_buf);
+  return -1;
+}
+
+static void
+replace_user(struct userlist_list *ul, struct userlist_user *u)
+{
+  struct userlist_user *old = 0, **new_map;
+  int new_size;
+
+  if (u->id < ul->user_map_size) old = ul->user_map[u->id];
+  if (u->id >= ul->user_map_size) {
+    new_size = ul->user_map_size;
+    if (new_size <= 0) new_size = 16;
+    while (u->id >= new_size) new_size *= 2;
+    new_map = (struct userlist_user**) xcalloc(new_size, sizeof(new_map[0]));
+    if (ul->user_map_size > 0)
+      memcpy(new_map, ul->user_map, ul->user_map_size * sizeof(new_map[0]));
+    xfree(ul->user_map);
+    ul->user_map = new_map;
+    ul->user_map_size = new_size;
+  }
+  if (old) {
+    // group memberships are kept in the snapshot
+    u->group_first = old->group_first;
+    u->group_last = old->group_last;
+    old->group_first = old->group_last = 0;
+    userlist_remove_user(ul, old);
+  }
+  xml_link_node_last(&ul->b, &u->b);
+  ul->user_map[u->id] = u;
+}
+
+/* applies the journal 'path' to the loaded snapshot, returns the number
+   of applied records */
+static int
+replay_journal(struct uldb_xml_state *state, const unsigned char *path)
+{
+  struct userlist_list *ul = state->userlist;
+  struct userlist_user *u;
+  FILE *f = 0;
+  unsigned char hdr[128];
+  int user_id, member_serial, n, count = 0;
+  size_t xml_len;
+  char *xml_buf = 0;
+  struct stat stb;
+
+  if (!(f = fopen(path, "r"))) return 0;
+  if (fstat(fileno(f), &stb) >= 0) state->journal_size += stb.st_size;
+
+  while (fgets(hdr, sizeof(hdr), f)) {
+    if (sscanf(hdr, "@@ D %d %n", &user_id, &n) == 1 && !hdr[n]) {
+      if (user_id > 0 && user_id < ul->user_map_size
+          && (u = ul->user_map[user_id])) {
+        userlist_remove_user(ul, u);
+      }
+      ++count;
+      continue;
+    }
+    if (sscanf(hdr, "@@ U %d %d %zu %n", &user_id, &member_serial, &xml_len,
+               &n) != 3 || hdr[n] || user_id <= 0 || xml_len <= 0) {
+      err("%s: invalid journal record header", path);
+      break;
+    }
+    xml_buf = (char*) xmalloc(xml_len + 1);
+    if (fread(xml_buf, 1, xml_len, f) != xml_len || getc(f) != '\n') {
+      // the last record was not written completely
+      err("%s: truncated journal record for user %d", path, user_id);
+      break;
+    }
+    xml_buf[xml_len] = 0;
+    if (!(u = userlist_parse_user_str(xml_buf))) {
+      err("%s: failed to parse journal record for user %d", path, user_id);
+      break;
+    }
+    if (u->id != user_id) {
+      err("%s: user_id mismatch in journal record for user %d", path, user_id);
+      userlist_free(&u->b);
+      break;
+    }
+    replace_user(ul, u);
+    if (member_serial > ul->member_serial) ul->member_serial = member_serial;
+    xfree(xml_buf); xml_buf = 0;
+    ++count;
+  }
+
+  xfree(xml_buf);
+  fclose(f);
+  if (count > 0) info("%s: %d journal records applied", path, count);
+  return count;
+}
+
+static void
+update_snapshot_size(struct uldb_xml_state *state)
+{
+  struct stat stb;
+
+  if (stat(state->db_path, &stb) >= 0) state->snapshot_size = stb.st_size;
+}
+
+/* checks whether the background compaction has finished */
+static void
+reap_compaction(struct uldb_xml_state *state, int wait_flag)
+{
+  int status = 0;
+  pid_t pid;
+
+  if (state->compact_pid <= 0) return;
+  while ((pid = waitpid(state->compact_pid, &status,
+                        wait_flag?0:WNOHANG)) < 0 && errno == EINTR);
+  if (!pid) return;
+  if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    err("bdflush: compaction process %d failed", state->compact_pid);
+    // retry synchronously
+    mark_snapshot_dirty(state);
+  } else {
+    update_snapshot_size(state);
+  }
+  state->compact_pid = 0;
+}
+
+/*
+ * writes the new snapshot and drops the journal. Unless 'sync_flag' is
+ * set the snapshot is written by a child process working on the
+ * copy-on-write image of the database, while this process appends new
+ * changes to a fresh journal. Returns 1, if a compaction is already
+ * running.
+ */
+static int
+compact_database(struct uldb_xml_state *state, int sync_flag)
+{
+  struct stat stb;
+  pid_t pid;
+  int r;
+
+  if (state->compact_pid > 0) return 1;
+
+  // if the old journal is still there, the previous compaction failed
+  if (!sync_flag && stat(state->old_journal_path, &stb) < 0) {
+    if (rename(state->journal_path, state->old_journal_path) < 0
+        && errno != ENOENT) {
+      err("bdflush: rename() of `%s' failed: %s", state->journal_path,
+          os_ErrorMsg());
+    } else if ((pid = fork()) < 0) {
+      err("bdflush: fork() failed: %s", os_ErrorMsg());
+    } else if (!pid) {
+      r = write_snapshot(state);
+      if (r >= 0) unlink(state->old_journal_path);
+      _exit(r < 0);
+    } else {
+      state->compact_pid = pid;
+      state->journal_size = 0;
+      state->snapshot_dirty = 0;
+      return 0;
+    }
+  }
+
+  if (write_snapshot(state) < 0) return -1;
+  unlink(state->old_journal_path);
+  unlink(state->journal_path);
+  state->journal_size = 0;
+  state->snapshot_dirty = 0;
+  update_snapshot_size(state);
+  return 0;
+}
+
+static void
+flush_database(struct uldb_xml_state *state, int sync_flag)
+{
+  int r;
+
+  reap_compaction(state, sync_flag);
+  if (!state->dirty) return;
+
+  if (append_journal(state) < 0) goto failed;
+  if (state->snapshot_dirty
+      || (state->journal_size >= JOURNAL_COMPACT_MIN_SIZE
+          && state->journal_size >= state->snapshot_size / 2)) {
+    if ((r = compact_database(state, sync_flag)) < 0) goto failed;
+    if (r > 0) {
+      // wait for the running compaction to finish
+      state->last_flush_time = time(0);
+      state->flush_interval = 10;
+      return;
+    }
+  }
 
   state->last_flush_time = time(0);
   state->flush_interval = DEFAULT_FLUSH_INTERVAL;
@@ -587,9 +954,6 @@ flush_database(struct uldb_xml_state *state)
   return;
 
  failed:
-  if (f) fclose(f);
-  if (fd >= 0) close(fd);
-  unlink(tempname);
   state->last_flush_time = time(0);
   state->flush_interval = 10; // retry in 10 secs
 }
@@ -599,13 +963,19 @@ close_func(void *data)
 {
   struct uldb_xml_state *state = (struct uldb_xml_state*) data;
 
+  // leave the database without the journal
+  reap_compaction(state, 1);
+  if (state->journal_size > 0 || access(state->old_journal_path, F_OK) >= 0)
+    mark_snapshot_dirty(state);
+
   // ensure success on saving
   while (state->dirty) {
-    flush_database(state);
+    flush_database(state, 1);
     if (!state->dirty) break;
     sleep(10);
   }
 
+  state->search_index = user_search_index_free(state->search_index);
   return 0;
 }
 
@@ -727,7 +1097,7 @@ forced_sync_func(void *data)
 {
   struct uldb_xml_state *state = (struct uldb_xml_state*) data;
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval = 0;
 }
 
@@ -830,7 +1200,7 @@ new_user_func(
   }
 
   u->registration_time = time(0);
-  state->dirty = 1;
+  mark_user_dirty(state, u->id);
   state->flush_interval /= 2;
 
   return u->id;
@@ -854,7 +1224,7 @@ remove_user_func(void *data, int user_id)
     }
   }
   userlist_remove_user(ul, u);
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   return 0;
 }
 
@@ -965,7 +1335,7 @@ new_cookie_func(
 
   if (p_cookie) *p_cookie = c;
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   return 0;
 }
 
@@ -1037,7 +1407,7 @@ new_cookie_2_func(
 
   if (p_cookie) *p_cookie = c;
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   return 0;
 }
 
@@ -1062,6 +1432,7 @@ remove_cookie_func(void *data, const struct userlist_cookie *cookie)
     userlist_free(u->cookies);
     u->cookies = 0;
   }
+  mark_user_dirty(state, u->id);
   return 0;
 }
 
@@ -1088,6 +1459,7 @@ remove_user_cookies_func(void *data, int user_id)
   xml_unlink_node(u->cookies);
   userlist_free(u->cookies);
   u->cookies = 0;
+  mark_user_dirty(state, user_id);
   return count;
 }
 
@@ -1098,11 +1470,20 @@ remove_expired_cookies_func(void *data, time_t cur_time)
   struct userlist_list *ul = state->userlist;
   struct userlist_user *u;
   struct xml_tree *p, *q;
-  struct userlist_cookie *c;
-  int count = 0, user_id;
+  struct userlist_cookie *c, **expired = 0;
+  int count = 0, user_id, i;
 
   if (cur_time <= 0) cur_time = time(0);
 
+  // the expiration wheel is maintained together with the cookie hash
+  if ((count = userlist_get_expired_cookies(ul, cur_time, &expired)) >= 0) {
+    for (i = 0; i < count; ++i)
+      remove_cookie_func(data, expired[i]);
+    xfree(expired);
+    return count;
+  }
+
+  count = 0;
   for (user_id = 1; user_id < ul->user_map_size; user_id++) {
     if (!(u = ul->user_map[user_id])) continue;
     if (!u->cookies) continue;
@@ -1249,7 +1630,7 @@ touch_login_time_func(void *data, int user_id, int contest_id, time_t cur_time)
                                   0);
     if (ui) ui->last_login_time = cur_time;
   }
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   return 0;
 }
 
@@ -1297,7 +1678,7 @@ set_cookie_contest_func(void *data,
 
   if (cc->contest_id != contest_id) {
     cc->contest_id = contest_id;
-    state->dirty = 1;
+    mark_user_dirty(state, cc->user_id);
   }
   return 0;
 }
@@ -1312,7 +1693,7 @@ set_cookie_locale_func(void *data,
 
   if (cc->locale_id != locale_id) {
     cc->locale_id = locale_id;
-    state->dirty = 1;
+    mark_user_dirty(state, cc->user_id);
   }
   return 0;
 }
@@ -1327,7 +1708,7 @@ set_cookie_priv_level_func(void *data,
 
   if (cc->priv_level != priv_level) {
     cc->priv_level = priv_level;
-    state->dirty = 1;
+    mark_user_dirty(state, cc->user_id);
   }
   return 0;
 }
@@ -1343,7 +1724,7 @@ set_cookie_team_login_func(
 
   if (cc->team_login != team_login) {
     cc->team_login = team_login;
-    state->dirty = 1;
+    mark_user_dirty(state, cc->user_id);
   }
   return 0;
 }
@@ -1572,7 +1953,7 @@ set_reg_passwd_func(void *data, int user_id,
   u->passwd_method = method;
   if (cur_time <= 0) cur_time = time(0);
   u->last_pwdchange_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -1606,7 +1987,7 @@ set_team_passwd_func(void *data, int user_id, int contest_id,
   ui->team_passwd = xstrdup(password);
   ui->team_passwd_method = method;
   ui->last_pwdchange_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -1651,7 +2032,7 @@ register_contest_func(void *data,
   c->flags = flags;
   c->create_time = cur_time;
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   if (p_c) *p_c = c;
 
@@ -1734,7 +2115,7 @@ remove_member_func(void *data, int user_id, int contest_id,
   */
 
   ui->last_change_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -1862,7 +2243,7 @@ clear_team_passwd_func(void *data, int user_id, int contest_id,
 
   xfree(ui->team_passwd); ui->team_passwd = 0;
   ui->team_passwd_method = 0;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -1891,7 +2272,7 @@ remove_registration_func(void *data, int user_id, int contest_id)
   xml_unlink_node(t);
   userlist_free(t);
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -1914,7 +2295,7 @@ set_reg_status_func(void *data, int user_id, int contest_id, int status)
 
   if (status == c->status) return 0;
   c->status = status;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 1;
 }
@@ -1947,7 +2328,7 @@ set_reg_flags_func(void *data, int user_id, int contest_id, int cmd,
   if (new_value == c->flags) return 0;
 
   c->flags = new_value;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 1;
 }
@@ -1973,7 +2354,7 @@ remove_user_contest_info_func(void *data, int user_id, int contest_id)
   userlist_free(&uc->b);
   u->cntsinfo[contest_id] = 0;
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 1;
 }
@@ -1997,7 +2378,7 @@ clear_user_field_func(void *data, int user_id, int field_id, time_t cur_time)
   if ((r = userlist_delete_user_field(u, field_id)) == 1) {
     if (field_id == USERLIST_NN_PASSWD) u->last_pwdchange_time = cur_time;
     else u->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2033,7 +2414,7 @@ clear_user_info_field_func(void *data, int user_id, int contest_id,
   if ((r = userlist_delete_user_info_field(ui, field_id)) == 1) {
     if (field_id == USERLIST_NC_TEAM_PASSWD) ui->last_pwdchange_time = cur_time;
     else ui->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2071,7 +2452,7 @@ clear_user_member_field_func(void *data, int user_id, int contest_id,
 
   if ((r = userlist_delete_member_field(m, field_id)) == 1) {
     m->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2112,7 +2493,7 @@ set_user_field_func(void *data,
     if (field_id == USERLIST_NN_LOGIN) userlist_build_login_hash(ul);
     if (field_id == USERLIST_NN_PASSWD) u->last_pwdchange_time = cur_time;
     else u->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2153,7 +2534,7 @@ set_user_info_field_func(void *data,
   if ((r = userlist_set_user_info_field_str(ui, field_id, value)) == 1) {
     if (field_id == USERLIST_NC_TEAM_PASSWD) ui->last_pwdchange_time = cur_time;
     else ui->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2197,7 +2578,7 @@ set_user_member_field_func(void *data,
 
   if ((r = userlist_set_member_field_str(m, field_id, value)) == 1) {
     m->last_change_time = cur_time;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
   }
   return r;
@@ -2265,7 +2646,7 @@ new_member_func(void *data, int user_id, int contest_id, int role,
   }
   mm->m[mm->u++] = m;
 
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return m->serial;
 }
@@ -2354,7 +2735,7 @@ maintenance_func(void *data, time_t cur_time)
   }
 
   if (cur_time > state->last_flush_time + state->flush_interval) {
-    flush_database(state);
+    flush_database(state, 0);
   }
   return 0;
 }
@@ -2427,7 +2808,7 @@ set_user_xml_func(void *data,
   // update the user's fields
   new_ui = new_u->cnts0;
   if (!new_ui) {
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
     return 1;
   }
@@ -2690,7 +3071,7 @@ set_user_xml_func(void *data,
   }
 
   // FIXME: properly set the change flag?
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 1;
 }
@@ -2864,7 +3245,7 @@ copy_user_info_func(
   }
 
   ui_to->last_change_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -2899,14 +3280,14 @@ check_user_reg_data_func(void *data, int user_id, int contest_id)
   if (!nerr && (c->flags & USERLIST_UC_INCOMPLETE)) {
     cm = (struct userlist_contest*) c;
     cm->flags &= ~USERLIST_UC_INCOMPLETE;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
     return 1;
   } else if (nerr > 0 && !(c->flags & USERLIST_UC_INCOMPLETE)
              && (!ui || !ui->cnts_read_only)) {
     cm = (struct userlist_contest*) c;
     cm->flags |= USERLIST_UC_INCOMPLETE;
-    state->dirty = 1;
+    mark_user_dirty(state, user_id);
     state->flush_interval /= 2;
     return 1;
   }
@@ -2967,7 +3348,7 @@ move_member_func(
   m->team_role = new_role;
 
   ui->last_change_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -3261,7 +3642,7 @@ set_member_serial_func(void *data, int new_serial)
   if (ul->member_serial > new_serial) return -1;
   if (ul->member_serial == new_serial) return 0;
   ul->member_serial = new_serial;
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   return 1;
 }
 
@@ -3309,7 +3690,7 @@ set_simple_reg_func(
   u->simple_registration = value;
   if (cur_time <= 0) cur_time = time(0);
   u->last_change_time = cur_time;
-  state->dirty = 1;
+  mark_user_dirty(state, user_id);
   state->flush_interval /= 2;
   return 0;
 }
@@ -3481,7 +3862,7 @@ create_group_func(
   grp->group_name = xstrdup(group_name);
   ul->group_map[group_id] = grp;
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return group_id;
@@ -3503,7 +3884,7 @@ remove_group_func(
   userlist_free(&grp->b);
   ul->group_map[group_id] = 0;
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return 0;
@@ -3566,7 +3947,7 @@ edit_group_field_func(
     return -1;
   }
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return 0;
@@ -3601,7 +3982,7 @@ clear_group_field_func(
     return -1;
   }
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return 0;
@@ -3849,7 +4230,7 @@ create_group_member_func(void *data, int group_id, int user_id)
     gm2->group_prev = &gm->b;
   }
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return 0;
@@ -3933,7 +4314,7 @@ remove_group_member_func(void *data, int group_id, int user_id)
     userlist_free(t);
   }
 
-  state->dirty = 1;
+  mark_snapshot_dirty(state);
   state->flush_interval /= 2;
 
   return 0;
@@ -4002,6 +4383,7 @@ brief_list_2_iterator_has_next_func(ptr_iterator_t data)
   struct userlist_list *ul = iter->state->userlist;
 
   if (iter->count <= 0) return 0;
+  if (iter->id_count >= 0) return iter->id_ind < iter->id_count;
   brief_list_2_do_skip(iter, ul);
   return (iter->user_id < ul->user_map_size);
 }
@@ -4012,6 +4394,10 @@ brief_list_2_iterator_get_func(ptr_iterator_t data)
   struct userlist_list *ul = iter->state->userlist;
 
   if (iter->count <= 0) return 0;
+  if (iter->id_count >= 0) {
+    if (iter->id_ind >= iter->id_count) return 0;
+    return (const void *) ul->user_map[iter->ids[iter->id_ind]];
+  }
   brief_list_2_do_skip(iter, ul);
   if (iter->user_id >= ul->user_map_size) return 0;
   return (const void *) ul->user_map[iter->user_id];
@@ -4023,6 +4409,11 @@ brief_list_2_iterator_next_func(ptr_iterator_t data)
   struct userlist_list *ul = iter->state->userlist;
 
   if (iter->count <= 0) return;
+  if (iter->id_count >= 0) {
+    if (iter->id_ind < iter->id_count) iter->id_ind++;
+    --iter->count;
+    return;
+  }
   if (iter->user_id < ul->user_map_size) iter->user_id++;
   --iter->count;
   brief_list_2_do_skip(iter, ul);
@@ -4033,6 +4424,7 @@ brief_list_2_iterator_destroy_func(ptr_iterator_t data)
 {
   struct brief_list_2_iterator *iter = (struct brief_list_2_iterator*) data;
   xfree(iter->filter);
+  xfree(iter->ids);
   xfree(iter);
 }
 
@@ -4050,6 +4442,7 @@ get_brief_list_iterator_2_func(
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count)
 {
@@ -4069,6 +4462,12 @@ get_brief_list_iterator_2_func(
   iter->offset = offset;
   iter->count = count;
   iter->user_id = 0;
+  iter->id_count = search_users(state, contest_id, group_id, filter, flags,
+                                &iter->ids);
+  if (iter->id_count >= 0) {
+    iter->id_ind = offset;
+    if (iter->id_ind > iter->id_count) iter->id_ind = iter->id_count;
+  }
   return (ptr_iterator_t) iter;
 }
 
@@ -4081,9 +4480,16 @@ get_user_count_func(
         long long *p_count)
 {
   struct uldb_xml_state *state = (struct uldb_xml_state*) data;
-  int i;
+  int i, *ids = 0;
   long long count = 0;
 
+  if ((count = search_users(state, contest_id, group_id, filter, 0, &ids)) >= 0) {
+    xfree(ids);
+    if (p_count) *p_count = count;
+    return 0;
+  }
+
+  count = 0;
   for (i = 0; i < state->userlist->user_map_size; ++i) {
     if (state->userlist->user_map[i]) {
       ++count;
@@ -4245,6 +4651,127 @@ check_user_match(const struct userlist_user *u, int contest_id, int group_id, co
   return 1;
 }
 
+static void
+add_info_search_fields(
+        const struct userlist_user_info *ui,
+        const unsigned char **fields,
+        int *p_count,
+        int max_fields)
+{
+  const struct userlist_member *m;
+  int i;
+
+  if (!ui) return;
+  if (*p_count < max_fields) fields[(*p_count)++] = ui->name;
+  if (!ui->members) return;
+  for (i = 0; i < ui->members->u; ++i) {
+    if (!(m = ui->members->m[i])) continue;
+    if (*p_count + 6 > max_fields) return;
+    fields[(*p_count)++] = m->firstname;
+    fields[(*p_count)++] = m->middlename;
+    fields[(*p_count)++] = m->surname;
+    fields[(*p_count)++] = m->firstname_en;
+    fields[(*p_count)++] = m->middlename_en;
+    fields[(*p_count)++] = m->surname_en;
+  }
+}
+
+/* the fields of the search index: the login (must be the first),
+   the e-mail, the names of the user and the members */
+static int
+get_search_fields(
+        void *data,
+        int user_id,
+        const unsigned char **fields,
+        int max_fields)
+{
+  struct uldb_xml_state *state = (struct uldb_xml_state*) data;
+  struct userlist_list *ul = state->userlist;
+  const struct userlist_user *u;
+  int count = 0, i;
+
+  if (user_id <= 0 || user_id >= ul->user_map_size) return 0;
+  if (!(u = ul->user_map[user_id])) return 0;
+  fields[count++] = u->login;
+  fields[count++] = u->email;
+  add_info_search_fields(u->cnts0, fields, &count, max_fields);
+  for (i = 0; i < u->cntsinfo_a; ++i) {
+    if (u->cntsinfo[i] && u->cntsinfo[i] != u->cnts0)
+      add_info_search_fields(u->cntsinfo[i], fields, &count, max_fields);
+  }
+  return count;
+}
+
+/* returns the users matching the filter sorted by id or by relevance,
+   or -1, if the filter is empty */
+static int
+search_users(
+        struct uldb_xml_state *state,
+        int contest_id,
+        int group_id,
+        const unsigned char *filter,
+        int flags,
+        int **p_ids)
+{
+  struct userlist_list *ul = state->userlist;
+  int count, i, j, *ids = 0;
+
+  *p_ids = 0;
+  if (!filter || !*filter) return -1;
+  if (!state->search_index) {
+    state->search_index = user_search_index_create();
+    for (i = 1; i < ul->user_map_size; ++i) {
+      if (ul->user_map[i])
+        user_search_index_invalidate(state->search_index, i);
+    }
+  }
+  user_search_index_refresh(state->search_index, get_search_fields, state);
+  count = user_search_index_query(state->search_index, filter,
+                                  (flags & ULDB_LIST_BY_RELEVANCE)?USER_SEARCH_BY_RELEVANCE:0,
+                                  &ids);
+  if (count < 0) return -1;
+  if (contest_id > 0 || group_id > 0) {
+    for (i = 0, j = 0; i < count; ++i) {
+      if (check_user_match(ul->user_map[ids[i]], contest_id, group_id, filter))
+        ids[j++] = ids[i];
+    }
+    count = j;
+  }
+  *p_ids = ids;
+  return count;
+}
+
+/* returns the position of the first id >= user_id */
+static int
+lower_bound_id(const int *ids, int count, int user_id)
+{
+  int l = 0, r = count, m;
+
+  while (l < r) {
+    m = (l + r) / 2;
+    if (ids[m] < user_id) l = m + 1;
+    else r = m;
+  }
+  return l;
+}
+
+/* returns the position of user_id in the found users, or -1 */
+static int
+find_found_id(const int *ids, int count, int flags, int user_id)
+{
+  int i;
+
+  if (!(flags & ULDB_LIST_BY_RELEVANCE)) {
+    i = lower_bound_id(ids, count, user_id);
+    if (i < count && ids[i] == user_id) return i;
+    return -1;
+  }
+  for (i = 0; i < count; ++i)
+    if (ids[i] == user_id)
+      return i;
+  return -1;
+}
+
 static int
 get_prev_user_id_func(
         void *data,
@@ -4252,10 +4779,22 @@ get_prev_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id)
 {
   struct uldb_xml_state *state = (struct uldb_xml_state*) data;
   struct userlist_list *ul = state->userlist;
+  int *ids = 0, count, i;
+
+  if ((count = search_users(state, contest_id, group_id, filter, flags, &ids)) >= 0) {
+    if ((i = find_found_id(ids, count, flags, user_id)) < 0) {
+      // the user does not match the filter any more
+      i = (flags & ULDB_LIST_BY_RELEVANCE)?0:lower_bound_id(ids, count, user_id);
+    }
+    if (p_user_id) *p_user_id = (i > 0)?ids[i - 1]:0;
+    xfree(ids);
+    return 0;
+  }
 
   if (user_id > ul->user_map_size) user_id = ul->user_map_size;
   for (--user_id;
@@ -4274,10 +4813,24 @@ get_next_user_id_func(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id)
 {
   struct uldb_xml_state *state = (struct uldb_xml_state*) data;
   struct userlist_list *ul = state->userlist;
+  int *ids = 0, count, i;
+
+  if ((count = search_users(state, contest_id, group_id, filter, flags, &ids)) >= 0) {
+    if ((i = find_found_id(ids, count, flags, user_id)) >= 0) {
+      ++i;
+    } else {
+      // the user does not match the filter any more
+      i = (flags & ULDB_LIST_BY_RELEVANCE)?count:lower_bound_id(ids, count, user_id);
+    }
+    if (p_user_id) *p_user_id = (i < count)?ids[i]:0;
+    xfree(ids);
+    return 0;
+  }
 
   if (user_id < 0) user_id = 0;
   for (++user_id;
@@ -0,0 +1,286 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "cpu_slots.h"
+#include "errlog.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+
+static int
+slot_has_cpu(const struct cpu_slot *slot, int cpu)
+{
+  for (int i = 0; i < slot->cpu_count; ++i)
+    if (slot->cpus[i] == cpu)
+      return 1;
+  return 0;
+}
+
+static void
+slot_add_cpu(struct cpu_slot *slot, int cpu)
+{
+  if (slot_has_cpu(slot, cpu)) return;
+  XREALLOC(slot->cpus, slot->cpu_count + 1);
+  slot->cpus[slot->cpu_count++] = cpu;
+}
+
+/* parses "0-3,8,10-11" up to ';' or end of string */
+static int
+parse_cpu_list(const unsigned char **ps, struct cpu_slot *slot)
+{
+  const unsigned char *s = *ps;
+  int low, high, n;
+
+  while (1) {
+    while (isspace(*s)) ++s;
+    if (sscanf(s, "%d%n", &low, &n) != 1 || low < 0 || low >= CPU_SETSIZE)
+      return -1;
+    s += n;
+    high = low;
+    while (isspace(*s)) ++s;
+    if (*s == '-') {
+      ++s;
+      if (sscanf(s, "%d%n", &high, &n) != 1 || high < low
+          || high >= CPU_SETSIZE)
+        return -1;
+      s += n;
+    }
+    for (; low <= high; ++low)
+      slot_add_cpu(slot, low);
+    while (isspace(*s)) ++s;
+    if (*s != ',') break;
+    ++s;
+  }
+  *ps = s;
+  return 0;
+}
+
+static int
+get_available_cpus(struct cpu_slot *all)
+{
+  cpu_set_t mask;
+
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+    err("cpu_slots: sched_getaffinity failed: %s", os_ErrorMsg());
+    return -1;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &mask))
+      slot_add_cpu(all, cpu);
+  }
+  return 0;
+}
+
+static int
+bind_to_cpus(const struct cpu_slot *slot)
+{
+  cpu_set_t mask;
+
+  CPU_ZERO(&mask);
+  for (int i = 0; i < slot->cpu_count; ++i)
+    CPU_SET(slot->cpus[i], &mask);
+  if (sched_setaffinity(0, sizeof(mask), &mask) < 0) {
+    err("cpu_slots: sched_setaffinity failed: %s", os_ErrorMsg());
+    return -1;
+  }
+  return 0;
+}
+
+struct cpu_slot_table *
+cpu_slot_table_create(
+        const unsigned char *dir,
+        const unsigned char *host,
+        const unsigned char *spec,
+        int cpus_per_slot)
+{
+  struct cpu_slot_table *tab = NULL;
+  const unsigned char *s;
+  int i, j;
+
+  XCALLOC(tab, 1);
+  tab->dir = xstrdup(dir);
+  tab->host = xstrdup(host);
+  tab->cur_slot = -1;
+  tab->cur_fd = -1;
+  if (get_available_cpus(&tab->all) < 0) goto fail;
+
+  if (spec && *spec) {
+    s = spec;
+    while (1) {
+      while (isspace(*s) || *s == ';') ++s;
+      if (!*s) break;
+      XREALLOC(tab->slots, tab->slot_count + 1);
+      memset(&tab->slots[tab->slot_count], 0, sizeof(tab->slots[0]));
+      if (parse_cpu_list(&s, &tab->slots[tab->slot_count++]) < 0) {
+        err("cpu_slots: invalid slot specification '%s'", spec);
+        goto fail;
+      }
+      if (*s && *s != ';') {
+        err("cpu_slots: invalid slot specification '%s'", spec);
+        goto fail;
+      }
+    }
+  } else if (cpus_per_slot > 0 && tab->all.cpu_count >= cpus_per_slot) {
+    tab->slot_count = tab->all.cpu_count / cpus_per_slot;
+    XCALLOC(tab->slots, tab->slot_count);
+    for (i = 0; i < tab->slot_count; ++i) {
+      for (j = 0; j < cpus_per_slot; ++j)
+        slot_add_cpu(&tab->slots[i], tab->all.cpus[i * cpus_per_slot + j]);
+    }
+  }
+
+  if (tab->slot_count <= 0) {
+    err("cpu_slots: no CPU slots defined");
+    goto fail;
+  }
+  for (i = 0; i < tab->slot_count; ++i) {
+    for (j = 0; j < tab->slots[i].cpu_count; ++j) {
+      if (!slot_has_cpu(&tab->all, tab->slots[i].cpus[j])) {
+        err("cpu_slots: CPU %d of slot %d is not available",
+            tab->slots[i].cpus[j], i);
+        goto fail;
+      }
+    }
+  }
+  if (os_MakeDirPath(tab->dir, 0777) < 0) {
+    err("cpu_slots: cannot create directory '%s'", tab->dir);
+    goto fail;
+  }
+  return tab;
+
+fail:
+  cpu_slot_table_free(tab);
+  return NULL;
+}
+
+struct cpu_slot_table *
+cpu_slot_table_free(struct cpu_slot_table *tab)
+{
+  if (!tab) return NULL;
+  if (tab->cur_fd >= 0) close(tab->cur_fd);
+  for (int i = 0; i < tab->slot_count; ++i)
+    xfree(tab->slots[i].cpus);
+  xfree(tab->slots);
+  xfree(tab->all.cpus);
+  xfree(tab->dir);
+  xfree(tab->host);
+  memset(tab, 0, sizeof(*tab));
+  xfree(tab);
+  return NULL;
+}
+
+static int
+try_lock_slot(struct cpu_slot_table *tab, int slot)
+{
+  unsigned char path[PATH_MAX];
+  struct flock fl;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/%s-%03d", tab->dir, tab->host, slot);
+  if ((fd = open(path, O_RDWR | O_CREAT, 0666)) < 0) {
+    err("cpu_slots: cannot open '%s': %s", path, os_ErrorMsg());
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  if (fcntl(fd, F_SETLK, &fl) < 0) {
+    if (errno != EAGAIN && errno != EACCES) {
+      err("cpu_slots: cannot lock '%s': %s", path, os_ErrorMsg());
+    }
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int
+cpu_slot_acquire(struct cpu_slot_table *tab)
+{
+  int i, slot, fd;
+
+  if (!tab) return -1;
+  if (tab->cur_slot >= 0) return tab->cur_slot;
+
+  for (i = 0; i < tab->slot_count; ++i) {
+    slot = (tab->last_slot + i) % tab->slot_count;
+    if ((fd = try_lock_slot(tab, slot)) < 0) continue;
+    if (bind_to_cpus(&tab->slots[slot]) < 0) {
+      close(fd);
+      return -1;
+    }
+    tab->cur_slot = slot;
+    tab->cur_fd = fd;
+    tab->last_slot = slot;
+    return slot;
+  }
+  return -1;
+}
+
+void
+cpu_slot_release(struct cpu_slot_table *tab)
+{
+  if (!tab || tab->cur_slot < 0) return;
+
+  // let the idle process run on any CPU
+  bind_to_cpus(&tab->all);
+  close(tab->cur_fd);
+  tab->cur_fd = -1;
+  tab->cur_slot = -1;
+}
+
+const unsigned char *
+cpu_slot_unparse(
+        unsigned char *buf,
+        int size,
+        const struct cpu_slot_table *tab,
+        int slot)
+{
+  const struct cpu_slot *ps;
+  int len = 0, i, j;
+
+  buf[0] = 0;
+  if (!tab || slot < 0 || slot >= tab->slot_count) return buf;
+  ps = &tab->slots[slot];
+  for (i = 0; i < ps->cpu_count && len < size; i = j) {
+    for (j = i + 1; j < ps->cpu_count && ps->cpus[j] == ps->cpus[j - 1] + 1; ++j);
+    if (j - i > 1) {
+      len += snprintf(buf + len, size - len, "%s%d-%d", i?",":"",
+                      ps->cpus[i], ps->cpus[j - 1]);
+    } else {
+      len += snprintf(buf + len, size - len, "%s%d", i?",":"", ps->cpus[i]);
+    }
+  }
+  return buf;
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make -C .."
+ * End:
+ */
@@ -189,6 +189,15 @@ scan_dir_add_ignored(const unsigned char *dir, const unsigned char *filename)
   cur_ign->items[cur_ign->u++] = xstrdup(filename);
 }
 
+int
+scan_dir_get_priority(const unsigned char *name)
+{
+  if (strlen(name) != EJ_SERVE_PACKET_NAME_SIZE - 1) return 0;
+  if (name[0] >= '0' && name[0] <= '9') return -16 + (name[0] - '0');
+  if (name[0] >= 'A' && name[0] <= 'V') return -6 + (name[0] - 'A');
+  return 0;
+}
+
 struct q_dir_entry
 {
   unsigned char *name;
@@ -245,15 +254,7 @@ scan_dir(char const *partial_path, char *found_item, size_t fi_size)
       continue;
     }
 
-    if (strlen(de->d_name) != EJ_SERVE_PACKET_NAME_SIZE - 1) {
-      prio = 0;
-    } else if (de->d_name[0] >= '0' && de->d_name[0] <= '9') {
-      prio = -16 + (de->d_name[0] - '0');
-    } else if (de->d_name[0] >= 'A' && de->d_name[0] <= 'V') {
-      prio = -6 + (de->d_name[0] - 'A');
-    } else {
-      prio = 0;
-    }
+    prio = scan_dir_get_priority(de->d_name);
     if (prio < -16) prio = -16;
     if (prio > 15) prio = 15;
     prio += 16;
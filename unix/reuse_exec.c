@@ -43,6 +43,10 @@
 #ifdef __linux__
 #include <sys/ptrace.h>
 #include <sys/utsname.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sched.h>
 #endif
 
 #ifndef __GNUC__
@@ -102,6 +106,7 @@ struct tTask
   int    enable_all_signals;    /* unmask all signals after fork */
   int    ignore_sigpipe;        /* ignore SIGPIPE after fork */
   int    enable_process_group;  /* create a new process group */
+  int    enable_cgroup;         /* run in a separate cgroup */
   ssize_t max_core_size;        /* maximum size of core files */
   ssize_t max_file_size;        /* maximum size of created files */
   ssize_t max_locked_mem_size;  /* maximum size of locked memory */
@@ -130,6 +135,9 @@ struct tTask
 
   char *last_error_msg;         /* last error text */
   unsigned long used_vm_size;   /* maximum used VM size (if available) */
+  char *cgroup_dir;             /* the cgroup of the running task */
+  long long cgroup_cpu_usec;    /* CPU time from cpu.stat, -1 if unknown */
+  long long cgroup_memory_peak; /* memory.peak of the cgroup, -1 if unknown */
 };
 
 #define PIDARR_SIZE 32
@@ -155,6 +163,16 @@ static int linux_rlimit_code = -1;
 static void linux_set_fix_flag(void);
 static int linux_secure_exec_new_interface = 0;
 static void linux_set_secure_exec_supported_flag(void);
+static char *linux_cgroup_root = NULL; /* delegated cgroup v2 directory */
+static int linux_cgroup_serial = 0;
+static long long linux_cgroup_memory_max = 0; /* memory.max, 0 - no limit */
+static int spawn_disabled = 0;  /* fork() is used instead of clone() */
+static int linux_cgroup_write(const char *dir, const char *file,
+                              const char *value);
+static int linux_cgroup_create(tTask *tsk);
+static int linux_cgroup_supervise(tTask *tsk, long long max_time_ms);
+static void linux_cgroup_finish(tTask *tsk);
+static void linux_cgroup_remove(tTask *tsk);
 #endif
 
 /**
@@ -391,6 +409,8 @@ task_New(void)
   r->max_process_count = -1;
   r->max_prio_value = -1;
   r->max_pending_count = -1;
+  r->cgroup_cpu_usec = -1;
+  r->cgroup_memory_peak = -1;
 
   /* find an empty slot */
   for (i = 0; i < task_u; i++)
@@ -446,6 +466,9 @@ task_Delete(tTask *tsk)
   }
   for (i = 0; i < tsk->env.u; i++)
     xfree(tsk->env.v[i]);
+#ifdef __linux__
+  linux_cgroup_remove(tsk);
+#endif
   xfree(tsk->path);
   xfree(tsk->env.v);
   xfree(tsk->args.v);
@@ -1065,6 +1088,94 @@ task_EnableProcessGroup(tTask *tsk)
   return 0;
 }
 
+/**
+ * NAME:    task_EnableCgroup
+ * PURPOSE: run the task in its own cgroup under the directory set by
+ *          task_SetCgroupRoot, the cgroup is used for accounting
+ *          and for event-driven supervision in task_NewWait
+ * RETURN:  0 - ok, -1 - cgroups are not available
+ */
+int
+task_EnableCgroup(tTask *tsk)
+{
+  task_init_module();
+  ASSERT(tsk);
+#ifdef __linux__
+  if (!linux_cgroup_root) return -1;
+  tsk->enable_cgroup = 1;
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * NAME:    task_SetCgroupRoot
+ * PURPOSE: set the cgroup v2 directory delegated to this process,
+ *          where the task cgroups are created
+ * ARGS:    path - the directory, NULL or "" disables cgroups
+ * RETURN:  0 - ok, -1 - the directory is not usable
+ */
+int
+task_SetCgroupRoot(const char *path)
+{
+#ifdef __linux__
+  char procs_path[PATH_MAX];
+
+  xfree(linux_cgroup_root);
+  linux_cgroup_root = NULL;
+  if (!path || !*path) return 0;
+
+  snprintf(procs_path, sizeof(procs_path), "%s/cgroup.procs", path);
+  if (access(procs_path, W_OK) < 0) {
+    write_log(LOG_REUSE, LOG_ERROR, "%s: %s is not a writable cgroup: %s",
+              __FUNCTION__, path, os_ErrorMsg());
+    return -1;
+  }
+  // peak memory accounting requires the memory controller
+  linux_cgroup_write(path, "cgroup.subtree_control", "+memory");
+  linux_cgroup_root = xstrdup(path);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * NAME:    task_SetCgroupMemoryLimit
+ * PURPOSE: set the memory.max limit of the task cgroups, unlike
+ *          task_SetVMSize it limits the memory charged to the cgroup
+ *          (including the page cache), the task is OOM-killed on overrun
+ * ARGS:    size - the limit in bytes, 0 - no limit
+ * RETURN:  0 - ok, -1 - cgroups are not available
+ */
+int
+task_SetCgroupMemoryLimit(size_t size)
+{
+#ifdef __linux__
+  linux_cgroup_memory_max = size;
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/**
+ * NAME:    task_SetForkMode
+ * PURPOSE: start the tasks by fork() instead of clone(), which is
+ *          the default on Linux, for benchmarking and debugging
+ * ARGS:    fork_flag - 1 - use fork(), 0 - use clone()
+ * RETURN:  0
+ */
+int
+task_SetForkMode(int fork_flag)
+{
+#ifdef __linux__
+  spawn_disabled = !!fork_flag;
+#endif
+  return 0;
+}
+
 int
 task_SetMaxCoreSize(tTask *tsk, ssize_t max_core_size)
 {
@@ -1365,6 +1476,7 @@ task_fPrintArgs(tTask *tsk, FILE *fout)
 #define TASK_ERR_RLIMIT_FAILED     110
 #define TASK_ERR_PUTENV_FAILED     111
 #define TASK_ERR_LIMIT_CPU_FAILED  112
+#define TASK_ERR_CGROUP_FAILED     113
 
 static char *
 format_exitcode(tTask *tsk, char *buf, int size, int code, int err)
@@ -1385,6 +1497,7 @@ format_exitcode(tTask *tsk, char *buf, int size, int code, int err)
   case TASK_ERR_RLIMIT_FAILED:      s = "rlimit() failed"; break;
   case TASK_ERR_PUTENV_FAILED:      s = "putenv() failed"; break;
   case TASK_ERR_LIMIT_CPU_FAILED:   s = "rlimit() failed"; break;
+  case TASK_ERR_CGROUP_FAILED:      s = "cgroup attach failed"; break;
   default:                          s = "unknown";         break;
   }
   if (tsk->quiet_flag) {
@@ -1414,6 +1527,393 @@ set_limit(int fd, int resource, rlim_t value)
   }
 }
 
+/*
+ * the child side of task_Start, which runs either in a forked process,
+ * or in a clone sharing the address space with the parent (see
+ * linux_spawn), so it must not modify the memory of the parent,
+ * everything is prepared by the parent
+ */
+static void
+task_child(tTask *tsk, int comm_fd, char **envp)
+{
+  int i;
+  int tfd;
+  int code;
+  tRedir *rdr;
+  sigset_t ss;
+  struct rlimit lim;
+  int max_time = tsk->max_time;
+
+  if (tsk->enable_process_group > 0) {
+    setpgid(0, 0);
+  }
+
+#ifdef __linux__
+  if (tsk->cgroup_dir) {
+    char procs_path[PATH_MAX];
+    char pid_buf[64];
+    int pid_len;
+
+    snprintf(procs_path, sizeof(procs_path), "%s/cgroup.procs",
+             tsk->cgroup_dir);
+    pid_len = snprintf(pid_buf, sizeof(pid_buf), "%d\n", (int) getpid());
+    if ((tfd = open(procs_path, O_WRONLY, 0)) < 0
+        || write(tfd, pid_buf, pid_len) != pid_len) {
+      code = MAKECODE(TASK_ERR_CGROUP_FAILED, errno);
+      write(comm_fd + 1, &code, sizeof(code));
+      _exit(TASK_ERR_CGROUP_FAILED);
+    }
+    close(tfd);
+  }
+  if (tsk->enable_memory_limit_error && linux_ptrace_code > 0) {
+    code = ptrace(linux_ptrace_code, 0, 0, 0);
+    //fprintf(stderr, "reuse: ptrace returned %d\n", code);
+  }
+#endif
+
+  /* close the reading end of communication pipe */
+  close(comm_fd);
+
+  /* perform redirections */
+  for (i = 0, rdr = tsk->redirs.v; i < tsk->redirs.u; i++, rdr++)
+    {
+      switch (tsk->redirs.v[i].tag)
+        {
+        case TSR_FILE:
+          errno = 0;
+          if ((tfd = open(tsk->redirs.v[i].u.s.path,
+                          tsk->redirs.v[i].u.s.oflag,
+                          tsk->redirs.v[i].u.s.mode)) < 0)
+            {
+              /*
+              write_log(LOG_REUSE, LOG_CRIT,
+                        "task_Start: failed to open(%s, %d, %4.4o): %s",
+                        tsk->redirs.v[i].u.s.path,
+                        tsk->redirs.v[i].u.s.oflag,
+                        tsk->redirs.v[i].u.s.mode,
+                        os_GetErrorString(errno));
+              */
+              code = MAKECODE(TASK_ERR_REDIR_OPEN_FAILED, errno);
+              write(comm_fd + 1, &code, sizeof(code));
+              _exit(TASK_ERR_REDIR_OPEN_FAILED);
+            }
+          errno = 0;
+          if (dup2(tfd, tsk->redirs.v[i].fd) < 0)
+            {
+              /*
+              write_log(LOG_REUSE, LOG_CRIT,
+                        "task_Start: failed to dup2(%d, %d): %s",
+                        tfd, tsk->redirs.v[i].fd,
+                        os_GetErrorString(errno));
+              */
+              code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
+              write(comm_fd + 1, &code, sizeof(code));
+              _exit(TASK_ERR_REDIR_DUP_FAILED);
+            }
+          close(tfd);
+          break;
+          
+        case TSR_DUP:
+          errno = 0;
+          if (dup2(tsk->redirs.v[i].u.fd2, tsk->redirs.v[i].fd) < 0)
+            {
+              /*
+              write_log(LOG_REUSE, LOG_CRIT,
+                        "task_Start: failed to dup2(%d, %d): %s",
+                        tsk->redirs.v[i].u.fd2,
+                        tsk->redirs.v[i].fd,
+                        os_GetErrorString(errno));
+              */
+              code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
+              write(comm_fd + 1, &code, sizeof(code));
+              _exit(TASK_ERR_REDIR_DUP_FAILED);
+            }
+          break;
+        case TSR_CLOSE:
+          errno = 0;
+          close(tsk->redirs.v[i].fd);
+          /*
+          if (close(tsk->redirs.v[i].fd) < 0)
+            {
+              write_log(LOG_REUSE, LOG_ERR,
+                        "task_Start: failed to close(%d): %s",
+                        tsk->redirs.v[i].fd,
+                        os_GetErrorString(errno));
+            }
+          */
+          break;
+        case TSR_PIPE:
+          errno = 0;
+          if (rdr->u.p.pfd[rdr->u.p.idx] != rdr->fd) {
+            if (dup2(rdr->u.p.pfd[rdr->u.p.idx], rdr->fd) < 0) {
+              /*
+              write_log(LOG_REUSE, LOG_CRIT,
+                        "task_Start: failed to dup2(%d, %d): %s",
+                        rdr->u.p.pfd[rdr->u.p.idx], rdr->fd,
+                        os_ErrorString());
+              */
+              code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
+              write(comm_fd + 1, &code, sizeof(code));
+              _exit(TASK_ERR_REDIR_DUP_FAILED);
+            }
+            close(rdr->u.p.pfd[rdr->u.p.idx]);
+          }
+          close(rdr->u.p.pfd[1 - rdr->u.p.idx]);
+          break;
+        default:
+          /*
+          write_log(LOG_REUSE, LOG_CRIT, 
+                    "task_Start: child: invalid redirection %d",
+                    tsk->redirs.v[i].tag);
+          */
+          code = MAKECODE(TASK_ERR_REDIR_INVALID, 0);
+          write(comm_fd + 1, &code, sizeof(code));
+          _exit(TASK_ERR_REDIR_INVALID);
+        }
+    }
+
+  /* change the working directory */
+  if (tsk->working_dir) {
+    if (chdir(tsk->working_dir) < 0) {
+      code = MAKECODE(TASK_ERR_CHDIR_FAILED, errno);
+      write(comm_fd + 1, &code, sizeof(code));
+      _exit(TASK_ERR_CHDIR_FAILED);
+    }
+  }
+
+  if (tsk->max_stack_size > 0) {
+    set_limit(comm_fd + 1, RLIMIT_STACK, tsk->max_stack_size);
+  }
+  if (tsk->max_data_size > 0) {
+    set_limit(comm_fd + 1, RLIMIT_DATA, tsk->max_data_size);
+  }
+  if (tsk->max_vm_size > 0) {
+    set_limit(comm_fd + 1, RLIMIT_AS, tsk->max_vm_size);
+  }
+  if (tsk->max_core_size >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_CORE, tsk->max_core_size);
+  } else if (tsk->disable_core) {
+    set_limit(comm_fd + 1, RLIMIT_CORE, 0);
+  }
+  if (tsk->max_file_size >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_FSIZE, tsk->max_file_size);
+  }
+  if (tsk->max_locked_mem_size >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_MEMLOCK, tsk->max_locked_mem_size);
+  }
+  if (tsk->max_msg_queue_size >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_MSGQUEUE, tsk->max_msg_queue_size);
+  }
+  if (tsk->max_nice_value >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_NICE, tsk->max_nice_value);
+  }
+  if (tsk->max_open_file_count >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_NOFILE, tsk->max_open_file_count);
+  }
+  if (tsk->max_process_count >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_NPROC, tsk->max_process_count);
+  }
+  if (tsk->max_prio_value >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_RTPRIO, tsk->max_prio_value);
+  }
+  if (tsk->max_pending_count >= 0) {
+    set_limit(comm_fd + 1, RLIMIT_SIGPENDING, tsk->max_pending_count);
+  }
+
+  /* set millisecond time limit */
+#ifdef __linux__
+  if (linux_ms_time_limit > 0 && tsk->max_time_millis > 0) {
+    // the kernel supports millisecond-precise time-limits
+    memset(&lim, 0, sizeof(lim));
+    lim.rlim_cur = tsk->max_time_millis + 1000;
+    lim.rlim_max = tsk->max_time_millis + 1000;
+    if (setrlimit(linux_rlimit_code, &lim) < 0) {
+      code = MAKECODE(TASK_ERR_LIMIT_CPU_FAILED, errno);
+      write(comm_fd + 1, &code, sizeof(code));
+      _exit(TASK_ERR_LIMIT_CPU_FAILED);
+    }
+    /* enable kernel-based time-limit detection */
+    ptrace(0x4282, 0, 0, 0);
+  } else if (tsk->max_time_millis > 0) {
+    // the kernel does not support millisecond-precise time-limits
+    max_time = (tsk->max_time_millis + 999) / 1000;
+  }
+#else
+  if (tsk->max_time_millis > 0) {
+    // the kernel does not support millisecond-precise time-limits
+    max_time = (tsk->max_time_millis + 999) / 1000;
+  }
+#endif
+
+  if (max_time > 0) {
+    memset(&lim, 0, sizeof(lim));
+
+#ifdef __linux__
+    ASSERT(linux_fix_time_flag >= 0);
+    if (linux_fix_time_flag > 0) {
+      lim.rlim_cur = max_time;
+      lim.rlim_max = max_time;
+    } else {
+      lim.rlim_cur = max_time + 1;
+      lim.rlim_max = max_time + 1;
+    }
+#else
+    lim.rlim_cur = max_time + 1;
+    lim.rlim_max = max_time + 1;
+#endif
+
+    if (setrlimit(RLIMIT_CPU, &lim) < 0) {
+      code = MAKECODE(TASK_ERR_LIMIT_CPU_FAILED, errno);
+      write(comm_fd + 1, &code, sizeof(code));
+      _exit(TASK_ERR_LIMIT_CPU_FAILED);
+    }
+
+#ifdef __linux__
+    /* enable kernel-based time-limit detection */
+    ptrace(0x4282, 0, 0, 0);
+#endif
+  }
+
+#ifdef __linux__
+  if (tsk->enable_secure_exec && linux_secure_exec_supported > 0) {
+    if (linux_secure_exec_new_interface) {
+      ptrace(0x4281, 0, 0, 0);
+    } else {
+    }
+  }
+#endif
+
+  /* do exec */
+  //fprintf(stderr, "starting: %s\n", tsk->path);
+  if (tsk->enable_all_signals) {
+    sigemptyset(&ss);
+    sigprocmask(SIG_SETMASK, &ss, 0);
+  }
+
+  if (tsk->ignore_sigpipe) {
+    signal(SIGPIPE, SIG_IGN);
+  }
+
+  errno = 0;
+  execve(tsk->path, tsk->args.v, envp);
+  /*
+  write_log(LOG_REUSE, LOG_CRIT,
+            "task_Start: execv failed: %s",
+            os_GetErrorString(errno));
+  */
+  code = MAKECODE(TASK_ERR_EXECV_FAILED, errno);
+  write(comm_fd + 1, &code, sizeof(code));
+  _exit(TASK_ERR_EXECV_FAILED);
+}
+
+/*
+ * builds the environment of the task: the environment of this process
+ * (unless cleared) with the task variables applied in the same way,
+ * as putenv would do it, a variable without '=' is removed
+ */
+static char **
+make_envp(tTask *tsk)
+{
+  char **envp;
+  const char *eq;
+  size_t len;
+  int n = 0, i, j, k = 0;
+
+  if (!tsk->clear_env && environ) {
+    for (; environ[n]; ++n);
+  }
+  envp = xcalloc(n + tsk->env.u + 1, sizeof(envp[0]));
+  for (i = 0; i < n; ++i) {
+    if (!(eq = strchr(environ[i], '='))) continue;
+    len = eq - environ[i];
+    for (j = 0; j < tsk->env.u; ++j) {
+      if (!strncmp(tsk->env.v[j], environ[i], len)
+          && (tsk->env.v[j][len] == '=' || !tsk->env.v[j][len]))
+        break;
+    }
+    if (j < tsk->env.u) continue;
+    envp[k++] = environ[i];
+  }
+  for (i = 0; i < tsk->env.u; ++i) {
+    if (!(eq = strchr(tsk->env.v[i], '='))) continue;
+    // the last setting of a variable wins
+    len = eq - tsk->env.v[i] + 1;
+    for (j = i + 1; j < tsk->env.u; ++j) {
+      if (!strncmp(tsk->env.v[j], tsk->env.v[i], len - 1)
+          && (tsk->env.v[j][len - 1] == '=' || !tsk->env.v[j][len - 1]))
+        break;
+    }
+    if (j < tsk->env.u) continue;
+    envp[k++] = tsk->env.v[i];
+  }
+  envp[k] = NULL;
+  return envp;
+}
+
+#ifdef __linux__
+/*
+ * clone(CLONE_VM | CLONE_VFORK) does not copy the page tables of
+ * this (possibly large) process, the parent is suspended until
+ * the child calls exec or exits
+ */
+#define SPAWN_STACK_SIZE (256 * 1024)
+static char *spawn_stack = NULL;
+
+struct spawn_args
+{
+  tTask *tsk;
+  int comm_fd;
+  char **envp;
+  sigset_t mask;
+};
+
+static int
+linux_spawn_child(void *data)
+{
+  struct spawn_args *sa = (struct spawn_args*) data;
+  struct sigaction act, old;
+  int sig;
+
+  // the handlers of the parent must not run in the shared memory
+  memset(&act, 0, sizeof(act));
+  act.sa_handler = SIG_DFL;
+  for (sig = 1; sig < _NSIG; ++sig) {
+    if (sigaction(sig, NULL, &old) < 0) continue;
+    if (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)
+      sigaction(sig, &act, NULL);
+  }
+  sigprocmask(SIG_SETMASK, &sa->mask, NULL);
+  task_child(sa->tsk, sa->comm_fd, sa->envp);
+  _exit(TASK_ERR_EXECV_FAILED);
+}
+
+static int
+linux_spawn(tTask *tsk, int comm_fd, char **envp)
+{
+  struct spawn_args sa;
+  sigset_t all;
+  int pid;
+
+  if (spawn_disabled) return fork();
+  if (!spawn_stack) spawn_stack = xmalloc(SPAWN_STACK_SIZE);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.tsk = tsk;
+  sa.comm_fd = comm_fd;
+  sa.envp = envp;
+  sigfillset(&all);
+  sigprocmask(SIG_BLOCK, &all, &sa.mask);
+  pid = clone(linux_spawn_child, spawn_stack + SPAWN_STACK_SIZE,
+              CLONE_VM | CLONE_VFORK | SIGCHLD, &sa);
+  sigprocmask(SIG_SETMASK, &sa.mask, NULL);
+  if (pid < 0 && (errno == ENOSYS || errno == EINVAL)) {
+    spawn_disabled = 1;
+    return fork();
+  }
+  return pid;
+}
+#endif
+
 /**
  * NAME:    task_Start
  * PURPOSE: start a task
@@ -1428,8 +1928,8 @@ task_Start(tTask *tsk)
   int     comm_fd = -1;
   tRedir *rdr;
   char    errbuf[512];
-  sigset_t ss;
   struct rlimit lim;
+  char  **envp;
 
   task_init_module();
   ASSERT(tsk);
@@ -1538,11 +2038,28 @@ task_Start(tTask *tsk)
     }
   }
 
+#ifdef __linux__
+  if (tsk->enable_cgroup > 0 && linux_cgroup_create(tsk) < 0) {
+    write_log(LOG_REUSE, LOG_WARN, "%s: cgroup is not created, using /proc",
+              __FUNCTION__);
+  }
+#endif
+
+  envp = make_envp(tsk);
+
   // save the start real time
   gettimeofday(&tsk->start_time, 0);
 
   errno = 0;
+#ifdef __linux__
+  pid = linux_spawn(tsk, comm_fd, envp);
+#else
   pid = fork();
+#endif
+  if (pid != 0) {
+    // the cloned child has already called exec or has exited
+    xfree(envp);
+  }
   if (pid < 0)
     {
       tsk->state = TSK_ERROR;
@@ -1635,271 +2152,8 @@ task_Start(tTask *tsk)
     }
 
   /* now we're at child */
-  {
-    int i;
-    int tfd;
-    int code;
-
-    if (tsk->enable_process_group > 0) {
-      setpgid(0, 0);
-    }
-
-#ifdef __linux__
-    if (tsk->enable_memory_limit_error && linux_ptrace_code > 0) {
-      code = ptrace(linux_ptrace_code, 0, 0, 0);
-      //fprintf(stderr, "reuse: ptrace returned %d\n", code);
-    }
-#endif
-
-    /* close the reading end of communication pipe */
-    close(comm_fd);
-
-    /* perform redirections */
-    for (i = 0, rdr = tsk->redirs.v; i < tsk->redirs.u; i++, rdr++)
-      {
-        switch (tsk->redirs.v[i].tag)
-          {
-          case TSR_FILE:
-            errno = 0;
-            if ((tfd = open(tsk->redirs.v[i].u.s.path,
-                            tsk->redirs.v[i].u.s.oflag,
-                            tsk->redirs.v[i].u.s.mode)) < 0)
-              {
-                /*
-                write_log(LOG_REUSE, LOG_CRIT,
-                          "task_Start: failed to open(%s, %d, %4.4o): %s",
-                          tsk->redirs.v[i].u.s.path,
-                          tsk->redirs.v[i].u.s.oflag,
-                          tsk->redirs.v[i].u.s.mode,
-                          os_GetErrorString(errno));
-                */
-                code = MAKECODE(TASK_ERR_REDIR_OPEN_FAILED, errno);
-                write(comm_fd + 1, &code, sizeof(code));
-                _exit(TASK_ERR_REDIR_OPEN_FAILED);
-              }
-            errno = 0;
-            if (dup2(tfd, tsk->redirs.v[i].fd) < 0)
-              {
-                /*
-                write_log(LOG_REUSE, LOG_CRIT,
-                          "task_Start: failed to dup2(%d, %d): %s",
-                          tfd, tsk->redirs.v[i].fd,
-                          os_GetErrorString(errno));
-                */
-                code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
-                write(comm_fd + 1, &code, sizeof(code));
-                _exit(TASK_ERR_REDIR_DUP_FAILED);
-              }
-            close(tfd);
-            break;
-            
-          case TSR_DUP:
-            errno = 0;
-            if (dup2(tsk->redirs.v[i].u.fd2, tsk->redirs.v[i].fd) < 0)
-              {
-                /*
-                write_log(LOG_REUSE, LOG_CRIT,
-                          "task_Start: failed to dup2(%d, %d): %s",
-                          tsk->redirs.v[i].u.fd2,
-                          tsk->redirs.v[i].fd,
-                          os_GetErrorString(errno));
-                */
-                code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
-                write(comm_fd + 1, &code, sizeof(code));
-                _exit(TASK_ERR_REDIR_DUP_FAILED);
-              }
-            break;
-          case TSR_CLOSE:
-            errno = 0;
-            close(tsk->redirs.v[i].fd);
-            /*
-            if (close(tsk->redirs.v[i].fd) < 0)
-              {
-                write_log(LOG_REUSE, LOG_ERR,
-                          "task_Start: failed to close(%d): %s",
-                          tsk->redirs.v[i].fd,
-                          os_GetErrorString(errno));
-              }
-            */
-            break;
-          case TSR_PIPE:
-            errno = 0;
-            if (rdr->u.p.pfd[rdr->u.p.idx] != rdr->fd) {
-              if (dup2(rdr->u.p.pfd[rdr->u.p.idx], rdr->fd) < 0) {
-                /*
-                write_log(LOG_REUSE, LOG_CRIT,
-                          "task_Start: failed to dup2(%d, %d): %s",
-                          rdr->u.p.pfd[rdr->u.p.idx], rdr->fd,
-                          os_ErrorString());
-                */
-                code = MAKECODE(TASK_ERR_REDIR_DUP_FAILED, errno);
-                write(comm_fd + 1, &code, sizeof(code));
-                _exit(TASK_ERR_REDIR_DUP_FAILED);
-              }
-              close(rdr->u.p.pfd[rdr->u.p.idx]);
-            }
-            close(rdr->u.p.pfd[1 - rdr->u.p.idx]);
-            break;
-          default:
-            /*
-            write_log(LOG_REUSE, LOG_CRIT, 
-                      "task_Start: child: invalid redirection %d",
-                      tsk->redirs.v[i].tag);
-            */
-            code = MAKECODE(TASK_ERR_REDIR_INVALID, 0);
-            write(comm_fd + 1, &code, sizeof(code));
-            _exit(TASK_ERR_REDIR_INVALID);
-          }
-      }
-
-    /* clear the environment, if asked */
-    if (tsk->clear_env) {
-      clearenv();
-    }
-
-    /* set the environment */
-    for (i = 0; i < tsk->env.u; i++) {
-      if (putenv(tsk->env.v[i]) < 0) {
-        code = MAKECODE(TASK_ERR_PUTENV_FAILED, errno);
-        write(comm_fd + 1, &code, sizeof(code));
-        _exit(TASK_ERR_PUTENV_FAILED);
-      }
-    }
-    
-
-    /* change the working directory */
-    if (tsk->working_dir) {
-      if (chdir(tsk->working_dir) < 0) {
-        code = MAKECODE(TASK_ERR_CHDIR_FAILED, errno);
-        write(comm_fd + 1, &code, sizeof(code));
-        _exit(TASK_ERR_CHDIR_FAILED);
-      }
-    }
-
-    if (tsk->max_stack_size > 0) {
-      set_limit(comm_fd + 1, RLIMIT_STACK, tsk->max_stack_size);
-    }
-    if (tsk->max_data_size > 0) {
-      set_limit(comm_fd + 1, RLIMIT_DATA, tsk->max_data_size);
-    }
-    if (tsk->max_vm_size > 0) {
-      set_limit(comm_fd + 1, RLIMIT_AS, tsk->max_vm_size);
-    }
-    if (tsk->max_core_size >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_CORE, tsk->max_core_size);
-    } else if (tsk->disable_core) {
-      set_limit(comm_fd + 1, RLIMIT_CORE, 0);
-    }
-    if (tsk->max_file_size >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_FSIZE, tsk->max_file_size);
-    }
-    if (tsk->max_locked_mem_size >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_MEMLOCK, tsk->max_locked_mem_size);
-    }
-    if (tsk->max_msg_queue_size >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_MSGQUEUE, tsk->max_msg_queue_size);
-    }
-    if (tsk->max_nice_value >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_NICE, tsk->max_nice_value);
-    }
-    if (tsk->max_open_file_count >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_NOFILE, tsk->max_open_file_count);
-    }
-    if (tsk->max_process_count >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_NPROC, tsk->max_process_count);
-    }
-    if (tsk->max_prio_value >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_RTPRIO, tsk->max_prio_value);
-    }
-    if (tsk->max_pending_count >= 0) {
-      set_limit(comm_fd + 1, RLIMIT_SIGPENDING, tsk->max_pending_count);
-    }
-
-    /* set millisecond time limit */
-#ifdef __linux__
-    if (linux_ms_time_limit > 0 && tsk->max_time_millis > 0) {
-      // the kernel supports millisecond-precise time-limits
-      memset(&lim, 0, sizeof(lim));
-      lim.rlim_cur = tsk->max_time_millis + 1000;
-      lim.rlim_max = tsk->max_time_millis + 1000;
-      if (setrlimit(linux_rlimit_code, &lim) < 0) {
-        code = MAKECODE(TASK_ERR_LIMIT_CPU_FAILED, errno);
-        write(comm_fd + 1, &code, sizeof(code));
-        _exit(TASK_ERR_LIMIT_CPU_FAILED);
-      }
-      /* enable kernel-based time-limit detection */
-      ptrace(0x4282, 0, 0, 0);
-    } else if (tsk->max_time_millis > 0) {
-      // the kernel does not support millisecond-precise time-limits
-      tsk->max_time = (tsk->max_time_millis + 999) / 1000;
-    }
-#else
-    if (tsk->max_time_millis > 0) {
-      // the kernel does not support millisecond-precise time-limits
-      tsk->max_time = (tsk->max_time_millis + 999) / 1000;
-    }
-#endif
-
-    if (tsk->max_time > 0) {
-      memset(&lim, 0, sizeof(lim));
-
-#ifdef __linux__
-      ASSERT(linux_fix_time_flag >= 0);
-      if (linux_fix_time_flag > 0) {
-        lim.rlim_cur = tsk->max_time;
-        lim.rlim_max = tsk->max_time;
-      } else {
-        lim.rlim_cur = tsk->max_time + 1;
-        lim.rlim_max = tsk->max_time + 1;
-      }
-#else
-      lim.rlim_cur = tsk->max_time + 1;
-      lim.rlim_max = tsk->max_time + 1;
-#endif
-
-      if (setrlimit(RLIMIT_CPU, &lim) < 0) {
-        code = MAKECODE(TASK_ERR_LIMIT_CPU_FAILED, errno);
-        write(comm_fd + 1, &code, sizeof(code));
-        _exit(TASK_ERR_LIMIT_CPU_FAILED);
-      }
-
-#ifdef __linux__
-      /* enable kernel-based time-limit detection */
-      ptrace(0x4282, 0, 0, 0);
-#endif
-    }
-
-#ifdef __linux__
-    if (tsk->enable_secure_exec && linux_secure_exec_supported > 0) {
-      if (linux_secure_exec_new_interface) {
-        ptrace(0x4281, 0, 0, 0);
-      } else {
-      }
-    }
-#endif
-
-    /* do exec */
-    //fprintf(stderr, "starting: %s\n", tsk->path);
-    if (tsk->enable_all_signals) {
-      sigemptyset(&ss);
-      sigprocmask(SIG_SETMASK, &ss, 0);
-    }
-
-    if (tsk->ignore_sigpipe) {
-      signal(SIGPIPE, SIG_IGN);
-    }
-
-    errno = 0;
-    execv(tsk->path, tsk->args.v);
-    /*
-    write_log(LOG_REUSE, LOG_CRIT,
-              "task_Start: execv failed: %s",
-              os_GetErrorString(errno));
-    */
-    code = MAKECODE(TASK_ERR_EXECV_FAILED, errno);
-    write(comm_fd + 1, &code, sizeof(code));
-    _exit(TASK_ERR_EXECV_FAILED);
-  }
+  task_child(tsk, comm_fd, envp);
+  return -1;
 }
 
 /**
@@ -2168,14 +2422,21 @@ task_NewWait(tTask *tsk)
   int pid, stat = 0;
   struct rusage usage;
   unsigned long used_vm_size = 0;
+  int supervised = 0;
 
-  while (1) {
+#ifdef __linux__
+  // the process has terminated or has been killed, if supervised
+  if (tsk->cgroup_dir && linux_cgroup_supervise(tsk, max_time_ms) >= 0)
+    supervised = 1;
+#endif
+
+  while (!supervised) {
     memset(&usage, 0, sizeof(usage));
     pid = wait4(tsk->pid, &stat, WNOHANG, &usage);
     if (pid < 0) {
       write_log(LOG_REUSE, LOG_ERROR, "task_NewWait: wait4 failed: %s\n", os_ErrorMsg());
       // FIXME: recover?
-      return tsk;
+      goto done;
     }
     if (pid > 0 && pid != tsk->pid) {
       find_prc_in_list(pid, stat, &usage);
@@ -2184,7 +2445,7 @@ task_NewWait(tTask *tsk)
     if (pid > 0) {
       find_prc_in_list(pid, stat, &usage);
       tsk->used_vm_size = used_vm_size;
-      return tsk;
+      goto done;
     }
 
     if (tsk->max_real_time > 0) {
@@ -2252,7 +2513,7 @@ task_NewWait(tTask *tsk)
     if (pid < 0) {
       write_log(LOG_REUSE, LOG_ERROR, "task_NewWait: wait4 failed: %s\n", os_ErrorMsg());
       // FIXME: recover?
-      return tsk;
+      goto done;
     }
     if (pid > 0 && pid != tsk->pid) {
       find_prc_in_list(pid, stat, &usage);
@@ -2260,10 +2521,14 @@ task_NewWait(tTask *tsk)
     }
     if (pid > 0) {
       find_prc_in_list(pid, stat, &usage);
-      return tsk;
+      goto done;
     }
   }
 
+done:
+#ifdef __linux__
+  linux_cgroup_finish(tsk);
+#endif
   return tsk;
 }
 
@@ -2369,6 +2634,14 @@ task_GetMemoryUsed(tTask *tsk)
   return tsk->used_vm_size;
 }
 
+/* memory.peak of the task cgroup, -1, if the task has no cgroup */
+long long
+task_GetCgroupMemoryPeak(tTask *tsk)
+{
+  ASSERT(tsk);
+  return tsk->cgroup_memory_peak;
+}
+
 int
 task_IsMemoryLimit(tTask *tsk)
 {
@@ -2403,6 +2676,9 @@ task_GetRunningTime(tTask *tsk)
   ASSERT(tsk);
   if (tsk->state != TSK_SIGNALED && tsk->state != TSK_EXITED) return -1;
 
+  // the cgroup accounts all the processes of the task
+  if (tsk->cgroup_cpu_usec >= 0) return (tsk->cgroup_cpu_usec + 500) / 1000;
+
   millis += (tsk->usage.ru_utime.tv_usec + tsk->usage.ru_stime.tv_usec + 500) / 1000;
   millis += tsk->usage.ru_utime.tv_sec * 1000;
   millis += tsk->usage.ru_stime.tv_sec * 1000;
@@ -2667,6 +2943,298 @@ linux_set_secure_exec_supported_flag(void)
     return;
   }
 }
+/*
+ * cgroup v2 supervision: each task runs in its own leaf cgroup under
+ * linux_cgroup_root. task_NewWait sleeps in epoll on the pidfd of
+ * the process, on the memory.events file and on the timers of
+ * the real time limit and of the next CPU time check. The CPU time
+ * of the whole task is taken from cpu.stat. The peak VM size is still
+ * sampled from /proc/PID/stat like in the poller, so task_GetMemoryUsed
+ * keeps its meaning; memory.peak is reported separately, because it
+ * counts the resident memory and the page cache.
+ */
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+static int
+linux_cgroup_write(const char *dir, const char *file, const char *value)
+{
+  char path[PATH_MAX];
+  int fd, len = strlen(value);
+
+  snprintf(path, sizeof(path), "%s/%s", dir, file);
+  if ((fd = open(path, O_WRONLY | O_CLOEXEC, 0)) < 0) return -1;
+  if (write(fd, value, len) != len) {
+    close(fd);
+    return -1;
+  }
+  close(fd);
+  return 0;
+}
+
+/* reads the value of 'key' from a "key value" file, or the first value
+   if 'key' is NULL, returns -1 on error */
+static long long
+linux_cgroup_read(const char *dir, const char *file, const char *key)
+{
+  char path[PATH_MAX];
+  char buf[4096];
+  char *p, *q;
+  int fd, len, key_len;
+  long long value;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, file);
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC, 0)) < 0) return -1;
+  len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0) return -1;
+  buf[len] = 0;
+
+  p = buf;
+  if (key) {
+    key_len = strlen(key);
+    while (1) {
+      if (!strncmp(p, key, key_len) && p[key_len] == ' ') break;
+      if (!(p = strchr(p, '\n'))) return -1;
+      ++p;
+    }
+    p += key_len;
+  }
+  errno = 0;
+  value = strtoll(p, &q, 10);
+  if (errno || q == p || value < 0) return -1;
+  return value;
+}
+
+static int
+linux_cgroup_create(tTask *tsk)
+{
+  char path[PATH_MAX];
+  char buf[64];
+
+  if (!linux_cgroup_root) return -1;
+  snprintf(path, sizeof(path), "%s/task-%d-%d", linux_cgroup_root,
+           (int) getpid(), ++linux_cgroup_serial);
+  if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+    write_log(LOG_REUSE, LOG_ERROR, "%s: mkdir %s failed: %s", __FUNCTION__,
+              path, os_ErrorMsg());
+    return -1;
+  }
+  xfree(tsk->cgroup_dir);
+  tsk->cgroup_dir = xstrdup(path);
+  tsk->cgroup_cpu_usec = -1;
+  tsk->cgroup_memory_peak = -1;
+
+  if (linux_cgroup_memory_max > 0) {
+    // the limit for all processes of the task together
+    snprintf(buf, sizeof(buf), "%lld", linux_cgroup_memory_max);
+    linux_cgroup_write(tsk->cgroup_dir, "memory.max", buf);
+    linux_cgroup_write(tsk->cgroup_dir, "memory.swap.max", "0");
+  }
+  return 0;
+}
+
+static void
+linux_cgroup_kill_task(tTask *tsk)
+{
+  if (tsk->enable_process_group > 0) {
+    kill(-tsk->pid, tsk->termsig);
+  } else {
+    kill(tsk->pid, tsk->termsig);
+  }
+}
+
+static int
+linux_timerfd_arm(int fd, long long ms)
+{
+  struct itimerspec its;
+
+  if (ms < 1) ms = 1;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = ms / 1000;
+  its.it_value.tv_nsec = (ms % 1000) * 1000000;
+  return timerfd_settime(fd, 0, &its, NULL);
+}
+
+static int
+linux_epoll_add(int epfd, int fd, unsigned events)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.fd = fd;
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* returns 0, when the process is terminated (but not reaped yet),
+   -1, if the supervision is not possible and /proc polling is needed */
+static int
+linux_cgroup_supervise(tTask *tsk, long long max_time_ms)
+{
+  int pidfd = -1, epfd = -1, rt_fd = -1, cpu_fd = -1, ev_fd = -1, vm_fd = -1;
+  int retval = -1, done = 0, ncpu = 1, n, i, fd;
+  struct epoll_event evs[5];
+  struct timeval cur_time;
+  char path[PATH_MAX];
+  cpu_set_t cpus;
+  long long cpu_usec, elapsed_ms, cur_utime;
+  unsigned long long expirations;
+  unsigned long used_vm_size = 0;
+  struct process_info info;
+
+  if ((pidfd = syscall(__NR_pidfd_open, tsk->pid, 0)) < 0) goto cleanup;
+  if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) goto cleanup;
+  if (linux_epoll_add(epfd, pidfd, EPOLLIN) < 0) goto cleanup;
+
+  snprintf(path, sizeof(path), "%s/memory.events", tsk->cgroup_dir);
+  if ((ev_fd = open(path, O_RDONLY | O_CLOEXEC, 0)) >= 0
+      && linux_epoll_add(epfd, ev_fd, EPOLLPRI) < 0) {
+    close(ev_fd);
+    ev_fd = -1;
+  }
+
+  if (tsk->max_real_time > 0) {
+    gettimeofday(&cur_time, NULL);
+    elapsed_ms = (cur_time.tv_sec - tsk->start_time.tv_sec) * 1000LL
+      + (cur_time.tv_usec - tsk->start_time.tv_usec) / 1000;
+    if ((rt_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0
+        || linux_timerfd_arm(rt_fd, tsk->max_real_time * 1000LL - elapsed_ms) < 0
+        || linux_epoll_add(epfd, rt_fd, EPOLLIN) < 0)
+      goto cleanup;
+  }
+
+  if (max_time_ms > 0) {
+    // the task cannot consume the CPU time faster than with all its CPUs
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(tsk->pid, sizeof(cpus), &cpus) >= 0
+        && (ncpu = CPU_COUNT(&cpus)) <= 0)
+      ncpu = 1;
+    if ((cpu_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0
+        || linux_timerfd_arm(cpu_fd, max_time_ms / ncpu) < 0
+        || linux_epoll_add(epfd, cpu_fd, EPOLLIN) < 0)
+      goto cleanup;
+  }
+
+  if ((vm_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0
+      || linux_timerfd_arm(vm_fd, 2) < 0
+      || linux_epoll_add(epfd, vm_fd, EPOLLIN) < 0)
+    goto cleanup;
+
+  while (!done) {
+    n = epoll_wait(epfd, evs, sizeof(evs) / sizeof(evs[0]), -1);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      write_log(LOG_REUSE, LOG_ERROR, "%s: epoll_wait failed: %s",
+                __FUNCTION__, os_ErrorMsg());
+      goto cleanup;
+    }
+    for (i = 0; i < n && !done; ++i) {
+      fd = evs[i].data.fd;
+      if (fd == pidfd) {
+        done = 1;
+      } else if (fd == rt_fd) {
+        linux_cgroup_kill_task(tsk);
+        tsk->was_timeout = 1;
+        tsk->was_real_timeout = 1;
+        done = 1;
+      } else if (fd == cpu_fd) {
+        read(cpu_fd, &expirations, sizeof(expirations));
+        cpu_usec = linux_cgroup_read(tsk->cgroup_dir, "cpu.stat", "usage_usec");
+        if (cpu_usec < 0) goto cleanup;
+        if (cpu_usec >= max_time_ms * 1000) {
+          linux_cgroup_kill_task(tsk);
+          tsk->was_timeout = 1;
+          done = 1;
+        } else {
+          linux_timerfd_arm(cpu_fd,
+                            (max_time_ms - cpu_usec / 1000) / ncpu);
+        }
+      } else if (fd == ev_fd) {
+        if (linux_cgroup_read(tsk->cgroup_dir, "memory.events",
+                              "oom_kill") > 0) {
+          linux_cgroup_kill_task(tsk);
+          if (tsk->enable_memory_limit_error && linux_cgroup_memory_max > 0)
+            tsk->was_memory_limit = 1;
+          done = 1;
+        }
+      } else if (fd == vm_fd) {
+        // the same sampling schedule as in the /proc poller
+        read(vm_fd, &expirations, sizeof(expirations));
+        cur_utime = 1000;
+        if (parse_proc_pid_stat(tsk->pid, &info) >= 0) {
+          if (info.vsize > used_vm_size) used_vm_size = info.vsize;
+          cur_utime = info.utime + info.stime;
+          cur_utime = (cur_utime * 1000) / info.clock_ticks;
+        }
+        if (cur_utime >= 500) {
+          linux_timerfd_arm(vm_fd, 100);
+        } else if (cur_utime >= 10) {
+          linux_timerfd_arm(vm_fd, 10);
+        } else {
+          linux_timerfd_arm(vm_fd, 2);
+        }
+      }
+    }
+  }
+  tsk->used_vm_size = used_vm_size;
+  retval = 0;
+
+cleanup:
+  if (vm_fd >= 0) close(vm_fd);
+  if (cpu_fd >= 0) close(cpu_fd);
+  if (rt_fd >= 0) close(rt_fd);
+  if (ev_fd >= 0) close(ev_fd);
+  if (epfd >= 0) close(epfd);
+  if (pidfd >= 0) close(pidfd);
+  return retval;
+}
+
+static void
+linux_cgroup_finish(tTask *tsk)
+{
+  long long value;
+
+  if (!tsk->cgroup_dir) return;
+  if ((value = linux_cgroup_read(tsk->cgroup_dir, "memory.peak", NULL)) > 0)
+    tsk->cgroup_memory_peak = value;
+  tsk->cgroup_cpu_usec = linux_cgroup_read(tsk->cgroup_dir, "cpu.stat",
+                                           "usage_usec");
+}
+
+static void
+linux_cgroup_remove(tTask *tsk)
+{
+  char path[PATH_MAX];
+  FILE *f;
+  int pid, i;
+
+  if (!tsk->cgroup_dir) return;
+
+  // kill the processes left in the cgroup
+  if (linux_cgroup_write(tsk->cgroup_dir, "cgroup.kill", "1") < 0) {
+    snprintf(path, sizeof(path), "%s/cgroup.procs", tsk->cgroup_dir);
+    if ((f = fopen(path, "r"))) {
+      while (fscanf(f, "%d", &pid) == 1)
+        if (pid > 0) kill(pid, SIGKILL);
+      fclose(f);
+    }
+  }
+  // the killed processes may be not released yet
+  for (i = 0; i < 100; ++i) {
+    if (rmdir(tsk->cgroup_dir) >= 0 || errno == ENOENT) break;
+    if (errno != EBUSY || i == 99) {
+      write_log(LOG_REUSE, LOG_WARN, "%s: cannot remove %s: %s",
+                __FUNCTION__, tsk->cgroup_dir, os_ErrorMsg());
+      break;
+    }
+    usleep(1000);
+  }
+  xfree(tsk->cgroup_dir);
+  tsk->cgroup_dir = NULL;
+}
 #endif
 
 /*
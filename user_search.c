@@ -0,0 +1,550 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "user_search.h"
+#include "ej_types.h"
+
+#include "reuse_xalloc.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+/* the byte, which marks the beginning of a word in the prefix grams */
+#define WORD_MARK 1
+#define MAKE_GRAM(a, b, c) (((ruint32_t)(a) << 16) | ((ruint32_t)(b) << 8) | (ruint32_t)(c))
+
+enum { MAX_TERMS = 32 };
+
+/* the sorted list of the users, which have the gram */
+struct gram_posting
+{
+  ruint32_t key;                /* 0 for the free slot */
+  int u, a;
+  int *ids;
+};
+
+struct user_entry
+{
+  unsigned char *text;          /* the folded fields separated with \n */
+  int gram_count;
+  ruint32_t *grams;             /* sorted and unique */
+};
+
+struct user_search_index
+{
+  size_t hash_size;             /* power of 2 */
+  size_t hash_used;
+  struct gram_posting *hash;
+
+  int user_a;
+  struct user_entry **users;
+  unsigned char *stale_map;
+
+  int stale_u, stale_a;
+  int *stale_ids;
+};
+
+struct user_search_index *
+user_search_index_create(void)
+{
+  struct user_search_index *idx;
+
+  XCALLOC(idx, 1);
+  idx->hash_size = 4096;
+  XCALLOC(idx->hash, idx->hash_size);
+  return idx;
+}
+
+static void
+free_user_entry(struct user_entry *ue)
+{
+  if (!ue) return;
+  xfree(ue->text);
+  xfree(ue->grams);
+  xfree(ue);
+}
+
+struct user_search_index *
+user_search_index_free(struct user_search_index *idx)
+{
+  size_t i;
+  int j;
+
+  if (!idx) return 0;
+  for (i = 0; i < idx->hash_size; ++i)
+    xfree(idx->hash[i].ids);
+  xfree(idx->hash);
+  for (j = 0; j < idx->user_a; ++j)
+    free_user_entry(idx->users[j]);
+  xfree(idx->users);
+  xfree(idx->stale_map);
+  xfree(idx->stale_ids);
+  memset(idx, 0, sizeof(*idx));
+  xfree(idx);
+  return 0;
+}
+
+static inline size_t
+gram_hash(ruint32_t key, size_t size)
+{
+  return (key * 2654435761U) & (size - 1);
+}
+
+static void
+grow_hash(struct user_search_index *idx)
+{
+  size_t new_size = idx->hash_size * 2, i, h;
+  struct gram_posting *new_hash;
+
+  XCALLOC(new_hash, new_size);
+  for (i = 0; i < idx->hash_size; ++i) {
+    if (!idx->hash[i].key) continue;
+    h = gram_hash(idx->hash[i].key, new_size);
+    while (new_hash[h].key) h = (h + 1) & (new_size - 1);
+    new_hash[h] = idx->hash[i];
+  }
+  xfree(idx->hash);
+  idx->hash = new_hash;
+  idx->hash_size = new_size;
+}
+
+static struct gram_posting *
+find_posting(struct user_search_index *idx, ruint32_t key, int create_flag)
+{
+  size_t h;
+
+  if (create_flag && (idx->hash_used + 1) * 2 > idx->hash_size)
+    grow_hash(idx);
+  h = gram_hash(key, idx->hash_size);
+  while (idx->hash[h].key) {
+    if (idx->hash[h].key == key) return &idx->hash[h];
+    h = (h + 1) & (idx->hash_size - 1);
+  }
+  if (!create_flag) return NULL;
+  idx->hash[h].key = key;
+  ++idx->hash_used;
+  return &idx->hash[h];
+}
+
+/* returns the position of the first id >= user_id */
+static int
+lower_bound(const int *ids, int count, int user_id)
+{
+  int l = 0, r = count, m;
+
+  while (l < r) {
+    m = (l + r) / 2;
+    if (ids[m] < user_id) l = m + 1;
+    else r = m;
+  }
+  return l;
+}
+
+static void
+posting_add(struct gram_posting *gp, int user_id)
+{
+  int pos;
+
+  if (gp->u > 0 && gp->ids[gp->u - 1] < user_id) {
+    pos = gp->u;
+  } else {
+    pos = lower_bound(gp->ids, gp->u, user_id);
+    if (pos < gp->u && gp->ids[pos] == user_id) return;
+  }
+  if (gp->u == gp->a) {
+    if (!(gp->a *= 2)) gp->a = 4;
+    XREALLOC(gp->ids, gp->a);
+  }
+  if (pos < gp->u)
+    memmove(gp->ids + pos + 1, gp->ids + pos, (gp->u - pos) * sizeof(gp->ids[0]));
+  gp->ids[pos] = user_id;
+  ++gp->u;
+}
+
+static void
+posting_remove(struct gram_posting *gp, int user_id)
+{
+  int pos = lower_bound(gp->ids, gp->u, user_id);
+
+  if (pos >= gp->u || gp->ids[pos] != user_id) return;
+  --gp->u;
+  if (pos < gp->u)
+    memmove(gp->ids + pos, gp->ids + pos + 1, (gp->u - pos) * sizeof(gp->ids[0]));
+}
+
+/* copies the folded text to out (at least strlen(s) bytes): ASCII and
+   Cyrillic letters are lowercased, the whitespace and the control
+   characters are collapsed into a single space, returns the length */
+static int
+fold_text(unsigned char *out, const unsigned char *s)
+{
+  unsigned char *p = out;
+  int c;
+
+  while (*s) {
+    c = *s;
+    if (c <= ' ' || c == 0x7f) {
+      if (p > out && p[-1] != ' ') *p++ = ' ';
+      ++s;
+    } else if (c >= 'A' && c <= 'Z') {
+      *p++ = c + ('a' - 'A');
+      ++s;
+    } else if (c == 0xd0 && s[1] >= 0x90 && s[1] <= 0x9f) {
+      // U+0410 - U+041F
+      *p++ = 0xd0; *p++ = s[1] + 0x20;
+      s += 2;
+    } else if (c == 0xd0 && s[1] >= 0xa0 && s[1] <= 0xaf) {
+      // U+0420 - U+042F
+      *p++ = 0xd1; *p++ = s[1] - 0x20;
+      s += 2;
+    } else if (c == 0xd0 && s[1] == 0x81) {
+      // U+0401 -> U+0451
+      *p++ = 0xd1; *p++ = 0x91;
+      s += 2;
+    } else {
+      *p++ = c;
+      ++s;
+    }
+  }
+  if (p > out && p[-1] == ' ') --p;
+  *p = 0;
+  return p - out;
+}
+
+struct gram_buf
+{
+  int u, a;
+  ruint32_t *v;
+};
+
+static void
+gram_buf_add(struct gram_buf *gb, ruint32_t key)
+{
+  if (gb->u == gb->a) {
+    if (!(gb->a *= 2)) gb->a = 64;
+    XREALLOC(gb->v, gb->a);
+  }
+  gb->v[gb->u++] = key;
+}
+
+/* adds the grams of the folded field, the grams containing spaces are
+   not needed, as the query terms have no spaces */
+static void
+make_field_grams(struct gram_buf *gb, const unsigned char *f, int len)
+{
+  int i;
+
+  for (i = 0; i < len; ++i) {
+    if (f[i] == ' ') continue;
+    if (!i || f[i - 1] == ' ') {
+      gram_buf_add(gb, MAKE_GRAM(WORD_MARK, WORD_MARK, f[i]));
+      if (i + 1 < len && f[i + 1] != ' ')
+        gram_buf_add(gb, MAKE_GRAM(WORD_MARK, f[i], f[i + 1]));
+    }
+    if (i + 2 < len && f[i + 1] != ' ' && f[i + 2] != ' ')
+      gram_buf_add(gb, MAKE_GRAM(f[i], f[i + 1], f[i + 2]));
+  }
+}
+
+static int
+make_term_grams(struct gram_buf *gb, const unsigned char *t, int len)
+{
+  int i;
+
+  if (len == 1) {
+    gram_buf_add(gb, MAKE_GRAM(WORD_MARK, WORD_MARK, t[0]));
+  } else if (len == 2) {
+    gram_buf_add(gb, MAKE_GRAM(WORD_MARK, t[0], t[1]));
+  } else {
+    for (i = 0; i + 2 < len; ++i)
+      gram_buf_add(gb, MAKE_GRAM(t[i], t[i + 1], t[i + 2]));
+  }
+  return gb->u;
+}
+
+static int
+sort_gram_func(const void *p1, const void *p2)
+{
+  ruint32_t k1 = *(const ruint32_t*) p1;
+  ruint32_t k2 = *(const ruint32_t*) p2;
+  if (k1 < k2) return -1;
+  return k1 > k2;
+}
+
+static int
+unique_grams(ruint32_t *v, int count)
+{
+  int i, j;
+
+  if (count <= 1) return count;
+  qsort(v, count, sizeof(v[0]), sort_gram_func);
+  for (i = 1, j = 1; i < count; ++i) {
+    if (v[i] != v[j - 1]) v[j++] = v[i];
+  }
+  return j;
+}
+
+static void
+extend_users(struct user_search_index *idx, int user_id)
+{
+  int new_a = idx->user_a;
+  struct user_entry **new_users;
+  unsigned char *new_map;
+
+  if (user_id < idx->user_a) return;
+  if (!new_a) new_a = 1024;
+  while (user_id >= new_a) new_a *= 2;
+  XCALLOC(new_users, new_a);
+  new_map = (unsigned char*) xcalloc(new_a, sizeof(new_map[0]));
+  if (idx->user_a > 0) {
+    memcpy(new_users, idx->users, idx->user_a * sizeof(new_users[0]));
+    memcpy(new_map, idx->stale_map, idx->user_a * sizeof(new_map[0]));
+  }
+  xfree(idx->users);
+  xfree(idx->stale_map);
+  idx->users = new_users;
+  idx->stale_map = new_map;
+  idx->user_a = new_a;
+}
+
+static void
+remove_user(struct user_search_index *idx, int user_id)
+{
+  struct user_entry *ue;
+  struct gram_posting *gp;
+  int i;
+
+  if (user_id <= 0 || user_id >= idx->user_a) return;
+  if (!(ue = idx->users[user_id])) return;
+  for (i = 0; i < ue->gram_count; ++i) {
+    if ((gp = find_posting(idx, ue->grams[i], 0)))
+      posting_remove(gp, user_id);
+  }
+  free_user_entry(ue);
+  idx->users[user_id] = 0;
+}
+
+void
+user_search_index_update(
+        struct user_search_index *idx,
+        int user_id,
+        int field_count,
+        const unsigned char * const *fields)
+{
+  struct user_entry *ue;
+  struct gram_buf gb;
+  size_t total = 0;
+  unsigned char *p;
+  int i, len;
+
+  if (user_id <= 0) return;
+  remove_user(idx, user_id);
+  if (field_count <= 0) return;
+  extend_users(idx, user_id);
+
+  for (i = 0; i < field_count; ++i) {
+    if (fields[i]) total += strlen(fields[i]);
+    ++total;
+  }
+  XCALLOC(ue, 1);
+  ue->text = p = xmalloc(total + 1);
+  memset(&gb, 0, sizeof(gb));
+  for (i = 0; i < field_count; ++i) {
+    len = 0;
+    if (fields[i]) len = fold_text(p, fields[i]);
+    make_field_grams(&gb, p, len);
+    p += len;
+    *p++ = '\n';
+  }
+  *p = 0;
+  ue->gram_count = unique_grams(gb.v, gb.u);
+  ue->grams = gb.v;
+  for (i = 0; i < ue->gram_count; ++i)
+    posting_add(find_posting(idx, ue->grams[i], 1), user_id);
+  idx->users[user_id] = ue;
+}
+
+void
+user_search_index_invalidate(struct user_search_index *idx, int user_id)
+{
+  if (user_id <= 0) return;
+  extend_users(idx, user_id);
+  if (idx->stale_map[user_id]) return;
+  idx->stale_map[user_id] = 1;
+  if (idx->stale_u == idx->stale_a) {
+    if (!(idx->stale_a *= 2)) idx->stale_a = 64;
+    XREALLOC(idx->stale_ids, idx->stale_a);
+  }
+  idx->stale_ids[idx->stale_u++] = user_id;
+}
+
+int
+user_search_index_refresh(
+        struct user_search_index *idx,
+        user_search_get_fields_t get_fields,
+        void *data)
+{
+  const unsigned char *fields[USER_SEARCH_MAX_FIELDS];
+  int i, user_id, count, total = idx->stale_u;
+
+  for (i = 0; i < idx->stale_u; ++i) {
+    user_id = idx->stale_ids[i];
+    idx->stale_map[user_id] = 0;
+    count = get_fields(data, user_id, fields, USER_SEARCH_MAX_FIELDS);
+    user_search_index_update(idx, user_id, count, fields);
+  }
+  idx->stale_u = 0;
+  return total;
+}
+
+/* returns the relevance of the term for the user text, or 0, if the
+   term does not match, the short terms match only the word prefixes */
+static int
+match_term(const unsigned char *text, const unsigned char *term, int len)
+{
+  const unsigned char *f, *e, *s;
+  int score = 0, field_num = 0;
+
+  for (f = text; *f; f = e + 1, ++field_num) {
+    e = strchr(f, '\n');
+    if (e - f == len && !memcmp(f, term, len)) {
+      if (!field_num) return 8;
+      if (score < 4) score = 4;
+      continue;
+    }
+    for (s = f; s + len <= e; ++s) {
+      if (memcmp(s, term, len) != 0) continue;
+      if (s == f || s[-1] == ' ') {
+        if (score < 2) score = 2;
+        break;
+      }
+      if (len >= 3 && score < 1) score = 1;
+    }
+  }
+  return score;
+}
+
+struct search_result
+{
+  int user_id;
+  int score;
+};
+
+static int
+sort_result_func(const void *p1, const void *p2)
+{
+  const struct search_result *r1 = (const struct search_result*) p1;
+  const struct search_result *r2 = (const struct search_result*) p2;
+  if (r1->score != r2->score) return r2->score - r1->score;
+  return r1->user_id - r2->user_id;
+}
+
+static int
+sort_posting_func(const void *p1, const void *p2)
+{
+  const struct gram_posting *g1 = *(const struct gram_posting**) p1;
+  const struct gram_posting *g2 = *(const struct gram_posting**) p2;
+  return g1->u - g2->u;
+}
+
+int
+user_search_index_query(
+        struct user_search_index *idx,
+        const unsigned char *query,
+        int flags,
+        int **p_ids)
+{
+  unsigned char *qbuf, *p, *q;
+  const unsigned char *terms[MAX_TERMS];
+  int term_lens[MAX_TERMS];
+  int term_count = 0, i, j, k, cand_count = 0, res_count = 0, score, s;
+  struct gram_buf gb;
+  struct gram_posting **posts = 0;
+  int *cand = 0;
+  struct search_result *res = 0;
+
+  *p_ids = 0;
+  if (!query) return -1;
+  qbuf = (unsigned char*) xmalloc(strlen(query) + 1);
+  fold_text(qbuf, query);
+  for (p = qbuf; *p && term_count < MAX_TERMS; p = q) {
+    while (*p == ' ') ++p;
+    if (!*p) break;
+    for (q = p; *q && *q != ' '; ++q);
+    terms[term_count] = p;
+    term_lens[term_count++] = q - p;
+    if (*q) *q++ = 0;
+  }
+  if (!term_count) {
+    xfree(qbuf);
+    return -1;
+  }
+
+  memset(&gb, 0, sizeof(gb));
+  for (i = 0; i < term_count; ++i)
+    make_term_grams(&gb, terms[i], term_lens[i]);
+  gb.u = unique_grams(gb.v, gb.u);
+  XCALLOC(posts, gb.u);
+  for (i = 0; i < gb.u; ++i) {
+    if (!(posts[i] = find_posting(idx, gb.v[i], 0)) || !posts[i]->u)
+      goto done;
+  }
+  qsort(posts, gb.u, sizeof(posts[0]), sort_posting_func);
+
+  // intersect starting from the shortest list
+  cand_count = posts[0]->u;
+  XCALLOC(cand, cand_count);
+  memcpy(cand, posts[0]->ids, cand_count * sizeof(cand[0]));
+  for (i = 1; i < gb.u && cand_count > 0; ++i) {
+    for (j = 0, k = 0; j < cand_count; ++j) {
+      s = lower_bound(posts[i]->ids, posts[i]->u, cand[j]);
+      if (s < posts[i]->u && posts[i]->ids[s] == cand[j])
+        cand[k++] = cand[j];
+    }
+    cand_count = k;
+  }
+
+  // the grams are necessary, but not sufficient for the match
+  XCALLOC(res, cand_count + 1);
+  for (j = 0; j < cand_count; ++j) {
+    if (cand[j] >= idx->user_a || !idx->users[cand[j]]) continue;
+    score = 0;
+    for (i = 0; i < term_count; ++i) {
+      if (!(s = match_term(idx->users[cand[j]]->text, terms[i], term_lens[i])))
+        break;
+      score += s;
+    }
+    if (i < term_count) continue;
+    res[res_count].user_id = cand[j];
+    res[res_count].score = score;
+    ++res_count;
+  }
+  if ((flags & USER_SEARCH_BY_RELEVANCE) && res_count > 1)
+    qsort(res, res_count, sizeof(res[0]), sort_result_func);
+
+  XCALLOC(*p_ids, res_count + 1);
+  for (j = 0; j < res_count; ++j)
+    (*p_ids)[j] = res[j].user_id;
+
+done:
+  xfree(qbuf);
+  xfree(gb.v);
+  xfree(posts);
+  xfree(cand);
+  xfree(res);
+  return res_count;
+}
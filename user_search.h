@@ -0,0 +1,81 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __USER_SEARCH_H__
+#define __USER_SEARCH_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * In-memory search index over the text fields of the users (login,
+ * e-mail, names). The fields are case-folded (ASCII and Cyrillic) and
+ * split into trigrams, besides that the one and two letter prefixes of
+ * each word are indexed, so the short query terms are matched as the
+ * word prefixes and the longer ones as the substrings.
+ *
+ * A query is a list of the terms separated with spaces, a user matches
+ * if all the terms match. The first field of a user is considered the
+ * login, its exact match gives the highest relevance.
+ */
+
+/* query flags */
+enum
+{
+  USER_SEARCH_BY_RELEVANCE = 1, /* otherwise the result is sorted by id */
+};
+
+enum { USER_SEARCH_MAX_FIELDS = 256 };
+
+struct user_search_index;
+
+/* fills the fields of the user, returns the number of the fields,
+   or 0, if the user does not exist */
+typedef int (*user_search_get_fields_t)(
+        void *data,
+        int user_id,
+        const unsigned char **fields,
+        int max_fields);
+
+struct user_search_index *user_search_index_create(void);
+struct user_search_index *
+user_search_index_free(struct user_search_index *idx);
+
+/* sets the fields of the user, field_count == 0 removes the user */
+void
+user_search_index_update(
+        struct user_search_index *idx,
+        int user_id,
+        int field_count,
+        const unsigned char * const *fields);
+
+/* marks the user to be reindexed by the next refresh */
+void user_search_index_invalidate(struct user_search_index *idx, int user_id);
+
+/* reindexes the invalidated users, returns their count */
+int
+user_search_index_refresh(
+        struct user_search_index *idx,
+        user_search_get_fields_t get_fields,
+        void *data);
+
+/* returns the number of the found users, or -1, if the query has no
+   terms, the user ids are allocated with xmalloc */
+int
+user_search_index_query(
+        struct user_search_index *idx,
+        const unsigned char *query,
+        int flags,
+        int **p_ids);
+
+#endif /* __USER_SEARCH_H__ */
@@ -43,6 +43,7 @@
 #include "sock_op.h"
 #include "compat.h"
 #include "bitset.h"
+#include "userlist_image.h"
 
 #include "reuse_xalloc.h"
 #include "reuse_logger.h"
@@ -129,6 +130,10 @@ struct new_contest_extra
 {
   int id;
   struct observer_info *o_first, *o_last; /* list of observers */
+
+  /* the image of the contest users mapped by the observers */
+  struct userlist_image_pub *image;
+  int image_dirty;
 };
 
 struct client_state
@@ -404,6 +409,7 @@ add_observer(struct client_state *client, int contest_id)
       return;
 
   contest = new_contest_extra_get(contest_id);
+  contest->image_dirty = 1;
   XCALLOC(p, 1);
   p->client = client;
   p->contest = contest;
@@ -496,6 +502,7 @@ new_update_userlist_table(int cnts_id)
   struct observer_info *p;
 
   if (!(ne = new_contest_extra_try(cnts_id))) return;
+  ne->image_dirty = 1;
   for (p = ne->o_first; p; p = p->cnts_next) {
     if (!p->changed) {
       p->changed = 1;
@@ -608,7 +615,7 @@ link_client_state(struct client_state *p)
 #define default_get_contest_reg(a, b) dflt_iface->get_contest_reg(uldb_default->data, a, b)
 #define default_try_new_login(a, b, c, d, e) dflt_iface->try_new_login(uldb_default->data, a, b, c, d, e)
 #define default_set_simple_reg(a, b, c) dflt_iface->set_simple_reg(uldb_default->data, a, b, c)
-#define default_get_brief_list_iterator_2(a, b, c, d, e) dflt_iface->get_brief_list_iterator_2(uldb_default->data, a, b, c, d, e)
+#define default_get_brief_list_iterator_2(a, b, c, d, e, f) dflt_iface->get_brief_list_iterator_2(uldb_default->data, a, b, c, d, e, f)
 #define default_get_user_count(a, b, c, d) dflt_iface->get_user_count(uldb_default->data, a, b, c, d)
 #define default_get_group_iterator_2(a, b, c) dflt_iface->get_group_iterator_2(uldb_default->data, a, b, c)
 #define default_get_group_count(a, b) dflt_iface->get_group_count(uldb_default->data, a, b)
@@ -9648,6 +9655,16 @@ cleanup:
   xfree(xml_text);
 }
 
+/* maps the flags of the user list request to the database flags */
+static int
+get_list_flags(const struct userlist_pk_list_users_2 *data)
+{
+  int flags = 0;
+
+  if ((data->flags & ULS_LIST_BY_RELEVANCE)) flags |= ULDB_LIST_BY_RELEVANCE;
+  return flags;
+}
+
 static void
 cmd_list_all_users_2(
         struct client_state *p,
@@ -9675,7 +9692,7 @@ cmd_list_all_users_2(
 
   f = open_memstream(&xml_ptr, &xml_size);
   userlist_write_xml_header(f);
-  iter = default_get_brief_list_iterator_2(data->contest_id, data->group_id, data->data, data->offset, data->count);
+  iter = default_get_brief_list_iterator_2(data->contest_id, data->group_id, data->data, get_list_flags(data), data->offset, data->count);
   if (iter) {
     for (; iter->has_next(iter); iter->next(iter)) {
       if (!(u = (const struct userlist_user*) iter->get(iter))) continue;
@@ -10067,7 +10084,7 @@ cmd_next_user(
   }
   if (is_dbcnts_capable(p, cnts, OPCAP_LIST_USERS, logbuf) < 0) return;
 
-  int (*func)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int *p_user_id);
+  int (*func)(void *, int contest_id, int group_id, int user_id, const unsigned char *filter, int flags, int *p_user_id);
   switch (data->request_id) {
   case ULS_PREV_USER:
     func = plugin_func(get_prev_user_id);
@@ -10092,7 +10109,7 @@ cmd_next_user(
     return;
   }
 
-  if (func(uldb_default->data, data->contest_id, data->group_id, data->user_id, data->data, &user_id) < 0) {
+  if (func(uldb_default->data, data->contest_id, data->group_id, data->user_id, data->data, get_list_flags(data), &user_id) < 0) {
     err("%s -> database error", logbuf);
     send_reply(p, -ULS_ERR_DB_ERROR);
     return;
@@ -10491,6 +10508,78 @@ process_packet(struct client_state *p, int pkt_len, unsigned char *data)
   (*cmd_table[packet->id])(p, pkt_len, data);
 }
 
+static void
+publish_userlist_image(struct new_contest_extra *ne)
+{
+  const struct contest_desc *cnts = 0;
+  int user_contest_id = ne->id, count = 0;
+  unsigned char image_dir[PATH_MAX];
+  struct userlist_image_src *users = 0;
+  size_t users_a = 0;
+  ptr_iterator_t iter;
+  const struct userlist_user *u;
+  const struct userlist_user_info *ui;
+  const struct userlist_contest *c;
+
+  if (!ne->image) {
+    if (userlist_image_get_dir(config, image_dir, sizeof(image_dir)) < 0)
+      return;
+    if (!(ne->image = userlist_image_pub_create(image_dir, ne->id)))
+      return;
+  }
+  if (contests_get(ne->id, &cnts) >= 0 && cnts && cnts->user_contest_num > 0)
+    user_contest_id = cnts->user_contest_num;
+
+  // the strings are copied, as the users are unlocked immediately
+  for (iter = default_get_standings_list_iterator(user_contest_id);
+       iter->has_next(iter);
+       iter->next(iter)) {
+    if (!(u = (const struct userlist_user*) iter->get(iter))) continue;
+    if (!(c = userlist_get_user_contest(u, user_contest_id))) {
+      default_unlock_user(u);
+      continue;
+    }
+    if (count == users_a) {
+      if (!(users_a *= 2)) users_a = 64;
+      XREALLOC(users, users_a);
+    }
+    ui = userlist_get_user_info(u, user_contest_id);
+    users[count].user_id = u->id;
+    users[count].status = c->status;
+    users[count].flags = c->flags;
+    users[count].login = xstrdup(u->login);
+    users[count].name = 0;
+    if (ui && ui->name) users[count].name = xstrdup(ui->name);
+    ++count;
+    default_unlock_user(u);
+  }
+  iter->destroy(iter);
+
+  userlist_image_publish(ne->image, user_contest_id, count, users);
+
+  for (--count; count >= 0; --count) {
+    xfree((unsigned char*) users[count].login);
+    xfree((unsigned char*) users[count].name);
+  }
+  xfree(users);
+}
+
+/* the images are published before the observers are notified,
+   so the serve processes see the changes as soon as they are notified */
+static void
+publish_userlist_images(void)
+{
+  int i;
+  struct new_contest_extra *ne;
+
+  for (i = 1; i < new_contest_extras_size; ++i) {
+    if (!(ne = new_contest_extras[i]) || !ne->image_dirty) continue;
+    ne->image_dirty = 0;
+    if (!ne->o_first) continue;
+    publish_userlist_image(ne);
+  }
+}
+
 static void
 check_observers(void)
 {
@@ -10643,6 +10732,7 @@ do_work(void)
     }
     */
     /* check, that there exist outstanding observer events */
+    publish_userlist_images();
     check_observers();
 
     FD_ZERO(&rset);
@@ -1349,6 +1349,41 @@ userlist_build_login_hash(struct userlist_list *p)
   return -1;
 }
 
+/* cookies are placed to the wheel slots by expiration time */
+enum
+{
+  COOKIE_WHEEL_SIZE = 1024,
+  COOKIE_WHEEL_TICK = 128,      /* seconds per slot, ~36 hours per turn */
+};
+
+static void
+wheel_add(struct userlist_list *p, struct userlist_cookie *ck)
+{
+  int slot = (ck->expire / COOKIE_WHEEL_TICK) % COOKIE_WHEEL_SIZE;
+
+  if (ck->wheel_prev || p->cookie_wheel[slot] == ck) return;
+  ck->wheel_prev = 0;
+  ck->wheel_next = p->cookie_wheel[slot];
+  if (ck->wheel_next) ck->wheel_next->wheel_prev = ck;
+  p->cookie_wheel[slot] = ck;
+}
+
+static void
+wheel_del(struct userlist_list *p, struct userlist_cookie *ck)
+{
+  int slot = (ck->expire / COOKIE_WHEEL_TICK) % COOKIE_WHEEL_SIZE;
+
+  if (ck->wheel_prev) {
+    ck->wheel_prev->wheel_next = ck->wheel_next;
+  } else if (p->cookie_wheel[slot] == ck) {
+    p->cookie_wheel[slot] = ck->wheel_next;
+  } else {
+    return;
+  }
+  if (ck->wheel_next) ck->wheel_next->wheel_prev = ck->wheel_prev;
+  ck->wheel_prev = ck->wheel_next = 0;
+}
+
 int
 userlist_build_cookie_hash(struct userlist_list *p)
 {
@@ -1397,17 +1432,25 @@ userlist_build_cookie_hash(struct userlist_list *p)
     goto cleanup;
   }
   p->cookie_hash_size = primes[i];
-  p->cookie_hash_step = 37;
+  p->cookie_hash_step = 1;
   p->cookie_thresh = p->cookie_hash_size * 2 / 3;
   p->cookie_cur_fill = cookie_count;
   XCALLOC(p->cookie_hash_table, p->cookie_hash_size);
 
   p->client_key_hash_size = primes[i];
-  p->client_key_hash_step = 37;
+  p->client_key_hash_step = 1;
   p->client_key_thresh = p->client_key_hash_size * 2 / 3;
   p->client_key_cur_fill = 0;
   XCALLOC(p->client_key_hash_table, p->client_key_hash_size);
 
+  /* the wheel of the previous build is reused, its cookies are relinked */
+  if (p->cookie_wheel) {
+    memset(p->cookie_wheel, 0, COOKIE_WHEEL_SIZE * sizeof(p->cookie_wheel[0]));
+  } else {
+    XCALLOC(p->cookie_wheel, COOKIE_WHEEL_SIZE);
+  }
+  p->cookie_wheel_time = 0;
+
   /* insert cookies to hashtable */
   for (i = 1; i < p->user_map_size; i++) {
     if (!(u = p->user_map[i])) continue;
@@ -1425,6 +1468,8 @@ userlist_build_cookie_hash(struct userlist_list *p)
         j = (j + p->cookie_hash_step) % p->cookie_hash_size;
       }
       p->cookie_hash_table[j] = ck;
+      ck->wheel_prev = ck->wheel_next = 0;
+      wheel_add(p, ck);
       ck = (struct userlist_cookie*) ck->b.right;
     }
   }
@@ -1481,6 +1526,9 @@ userlist_build_cookie_hash(struct userlist_list *p)
   xfree(p->client_key_hash_table);
   p->client_key_hash_table = 0;
 
+  xfree(p->cookie_wheel);
+  p->cookie_wheel = 0;
+
   return -1;
 }
 
@@ -1526,104 +1574,48 @@ userlist_cookie_hash_add(
     ++p->client_key_cur_fill;
   }
 
+  wheel_add(p, (struct userlist_cookie *) ck);
+
   return 0;
 }
 
-static void
-delete_cookie(
-        struct userlist_list *p,
-        const struct userlist_cookie *ck)
+static ej_cookie_t
+cookie_key(const struct userlist_cookie *ck, int client_key_flag)
 {
-  int i = ck->cookie % p->cookie_hash_size;
-  int j = -1;
-  struct userlist_cookie **saves = NULL;
-  int rehash_count = 0;
-
-  while (p->cookie_hash_table[i]) {
-    if (p->cookie_hash_table[i] == ck) {
-      ASSERT(j == -1);
-      j = i;
-    } else {
-      rehash_count++;
-    }
-    i = (i + p->cookie_hash_step) % p->cookie_hash_size;
-  }
-  if (j == -1) return;
-  if (!rehash_count) {
-    i = ck->cookie % p->cookie_hash_size;
-    ASSERT(p->cookie_hash_table[i] == ck);
-    p->cookie_hash_table[i] = 0;
-    p->cookie_cur_fill--;
-    return;
-  }
-
-  saves = alloca(rehash_count * sizeof(saves[0]));
-  memset(saves, 0, rehash_count * sizeof(saves[0]));
-  i = ck->cookie % p->cookie_hash_size;
-  j = 0;
-  while (p->cookie_hash_table[i]) {
-    if (p->cookie_hash_table[i] != ck)
-      saves[j++] = p->cookie_hash_table[i];
-    p->cookie_hash_table[i] = 0;
-    i = (i + p->cookie_hash_step) % p->cookie_hash_size;
-  }
-  ASSERT(j == rehash_count);
-
-  for (j = 0; j < rehash_count; j++) {
-    i = saves[j]->cookie % p->cookie_hash_size;
-    while (p->cookie_hash_table[i])
-      i = (i + p->cookie_hash_step) % p->cookie_hash_size;
-    p->cookie_hash_table[i] = saves[j];
-  }
-
-  p->cookie_cur_fill--;
+  return client_key_flag?ck->client_key:ck->cookie;
 }
 
-static void
-delete_client_key(
-        struct userlist_list *p,
-        const struct userlist_cookie *ck)
-{
-  if (!ck->client_key) return;
-
-  int rehash_count = 0;
-  int i = ck->client_key % p->client_key_hash_size;
-  int j = -1;
-
-  while (p->client_key_hash_table[i]) {
-    if (p->client_key_hash_table[i] == ck) {
-      j = i;
-    } else {
-      ++rehash_count;
-    }
-    i = (i + p->client_key_hash_step) % p->client_key_hash_size;
-  }
-  if (j == -1) return;
-  if (!rehash_count) {
-    i = ck->client_key % p->client_key_hash_size;
-    p->client_key_hash_table[i] = NULL;
-    --p->client_key_cur_fill;
-    return;
-  }
-
-  struct userlist_cookie **saves = alloca(rehash_count * sizeof(saves[0]));
-  memset(saves, 0, rehash_count * sizeof(saves[0]));
-  i = ck->client_key % p->client_key_hash_size;
-  j = 0;
-  while (p->client_key_hash_table[i]) {
-    if (p->client_key_hash_table[i] != ck)
-      saves[j++] = p->client_key_hash_table[i];
-    p->client_key_hash_table[i] = 0;
-    i = (i + p->client_key_hash_step) % p->client_key_hash_size;
-  }
-
-  for (j = 0; j < rehash_count; ++j) {
-    i = saves[j]->client_key % p->client_key_hash_size;
-    while (p->client_key_hash_table[i])
-      i = (i + p->client_key_hash_step) % p->client_key_hash_size;
-    p->client_key_hash_table[i] = saves[j];
+/*
+ * removes the cookie from the linear probing hash table without
+ * tombstones: the following entries of the cluster, which cannot be
+ * reached after the removal, are shifted back to fill the gap
+ */
+static int
+hash_remove(
+        struct userlist_cookie **table,
+        size_t size,
+        const struct userlist_cookie *ck,
+        int client_key_flag)
+{
+  size_t i, j, k;
+
+  i = cookie_key(ck, client_key_flag) % size;
+  while (table[i] && table[i] != ck)
+    i = (i + 1) % size;
+  if (!table[i]) return 0;
+
+  j = i;
+  while (1) {
+    j = (j + 1) % size;
+    if (!table[j]) break;
+    k = cookie_key(table[j], client_key_flag) % size;
+    // leave the entry, if its home slot is in (i, j]
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+    table[i] = table[j];
+    i = j;
   }
-  --p->client_key_cur_fill;
+  table[i] = 0;
+  return 1;
 }
 
 int
@@ -1638,12 +1630,54 @@ userlist_cookie_hash_del(
   ASSERT(ck->cookie);
   ASSERT(ck->user_id > 0);
 
-  delete_cookie(p, ck);
-  delete_client_key(p, ck);
+  if (hash_remove(p->cookie_hash_table, p->cookie_hash_size, ck, 0))
+    p->cookie_cur_fill--;
+  if (ck->client_key
+      && hash_remove(p->client_key_hash_table, p->client_key_hash_size, ck, 1))
+    p->client_key_cur_fill--;
+  wheel_del(p, (struct userlist_cookie*) ck);
 
   return 0;
 }
 
+/*
+ * collects the cookies expired by 'cur_time', the caller removes them.
+ * Only the wheel slots passed since the previous call are scanned.
+ */
+int
+userlist_get_expired_cookies(
+        struct userlist_list *p,
+        time_t cur_time,
+        struct userlist_cookie ***p_cookies)
+{
+  time_t t0, t1, t;
+  struct userlist_cookie *ck, **arr = 0;
+  int count = 0, size = 0;
+
+  *p_cookies = 0;
+  if (!p->cookie_wheel) return -1;
+
+  t0 = p->cookie_wheel_time / COOKIE_WHEEL_TICK;
+  t1 = cur_time / COOKIE_WHEEL_TICK;
+  if (t0 > t1) t0 = t1;
+  if (t1 - t0 >= COOKIE_WHEEL_SIZE) t0 = t1 - COOKIE_WHEEL_SIZE + 1;
+
+  for (t = t0; t <= t1; ++t) {
+    for (ck = p->cookie_wheel[t % COOKIE_WHEEL_SIZE]; ck; ck = ck->wheel_next) {
+      if (ck->expire >= cur_time) continue;
+      if (count == size) {
+        if (!(size *= 2)) size = 16;
+        XREALLOC(arr, size);
+      }
+      arr[count++] = ck;
+    }
+  }
+  p->cookie_wheel_time = cur_time;
+
+  *p_cookies = arr;
+  return count;
+}
+
 void
 userlist_expand_cntsinfo(struct userlist_user *u, int contest_id)
 {
@@ -412,6 +412,10 @@ struct userlist_cookie
   int role;
   int recovery;
   int team_login;               /* used in case when team_passwd != reg_passwd*/
+
+  /* cookies in the same slot of the expiration wheel */
+  struct userlist_cookie *wheel_prev;
+  struct userlist_cookie *wheel_next;
 };
 
 struct userlist_contest
@@ -604,6 +608,10 @@ struct userlist_list
   size_t client_key_cur_fill;
   struct userlist_cookie **client_key_hash_table;
 
+  /* cookie expiration wheel, cookies are hashed by expiration time */
+  struct userlist_cookie **cookie_wheel;
+  time_t cookie_wheel_time;     /* the wheel is processed up to this time */
+
   /* user group information */
   struct xml_tree *groups_node;
   int group_map_size;
@@ -642,6 +650,10 @@ enum
 struct userlist_list *userlist_new(void);
 struct userlist_list *userlist_parse(char const *path);
 struct userlist_list *userlist_parse_str(unsigned char const *str);
+/* the list is built in the arena and released with it, it must not be
+   modified or freed with userlist_free */
+struct userlist_list *
+userlist_parse_str_arena(unsigned char const *str, struct xml_arena *arena);
 struct userlist_user *userlist_parse_user_str(char const *str);
 void userlist_unparse(struct userlist_list *p, FILE *f);
 void userlist_unparse_user(const struct userlist_user *p, FILE *f, int mode,
@@ -736,6 +748,10 @@ int userlist_build_cookie_hash(struct userlist_list *p);
 
 int userlist_cookie_hash_add(struct userlist_list *, const struct userlist_cookie *);
 int userlist_cookie_hash_del(struct userlist_list *, const struct userlist_cookie *);
+int userlist_get_expired_cookies(
+        struct userlist_list *p,
+        time_t cur_time,
+        struct userlist_cookie ***p_cookies);
 
 void userlist_expand_cntsinfo(struct userlist_user *u, int contest_id);
 
@@ -436,6 +436,7 @@ userlist_clnt_list_users_2(
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count,
         unsigned char **p_info);
@@ -469,6 +470,7 @@ userlist_clnt_get_prev_user_id(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id);
 
 #endif /* __USERLIST_CLNT_H__ */
@@ -27,6 +27,7 @@ userlist_clnt_get_prev_user_id(
         int group_id,
         int user_id,
         const unsigned char *filter,
+        int flags,
         int *p_user_id)
 {
   struct userlist_pk_list_users_2 *out = 0;
@@ -49,6 +50,7 @@ userlist_clnt_get_prev_user_id(
   out->group_id = group_id;
   out->user_id = user_id;
   out->filter_len = filter_len;
+  out->flags = flags;
   memcpy(out->data, filter, filter_len + 1);
 
   if ((r = userlist_clnt_send_packet(clnt, out_size, out)) < 0) return r;
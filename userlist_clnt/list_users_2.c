@@ -27,6 +27,7 @@ userlist_clnt_list_users_2(
         int contest_id,
         int group_id,
         const unsigned char *filter,
+        int flags,
         int offset,
         int count,
         unsigned char **p_info)
@@ -52,6 +53,7 @@ userlist_clnt_list_users_2(
   out->filter_len = filter_len;
   out->offset = offset;
   out->count = count;
+  out->flags = flags;
   memcpy(out->data, filter, filter_len + 1);
 
   if ((r = userlist_clnt_send_packet(clnt, out_size, out)) < 0) return r;
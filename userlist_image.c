@@ -0,0 +1,388 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "userlist_image.h"
+#include "ejudge_cfg.h"
+#include "errlog.h"
+
+#include "reuse_xalloc.h"
+#include "reuse_osdeps.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+static const unsigned char image_signature[8] = "EjUlImg";
+
+#define ALIGN8(x) (((x) + 7) & ~7)
+
+struct userlist_image_pub
+{
+  unsigned char *dir;
+  int contest_id;
+  long long generation;
+
+  /* the last published image, writable to set the `superseded' flag */
+  unsigned char *cur_data;
+  size_t cur_size;
+};
+
+static unsigned int
+login_hash(const unsigned char *s)
+{
+  unsigned int h = 2166136261U;
+
+  for (; *s; ++s)
+    h = (h ^ *s) * 16777619U;
+  return h;
+}
+
+int
+userlist_image_get_dir(
+        const struct ejudge_cfg *config,
+        unsigned char *buf,
+        size_t size)
+{
+  const unsigned char *var_dir;
+
+  buf[0] = 0;
+  if (!config) return -1;
+  if (config->var_dir && os_IsAbsolutePath(config->var_dir)) {
+    snprintf(buf, size, "%s/%s", config->var_dir, USERLIST_IMAGE_DIR);
+    return 0;
+  }
+  if (config->contests_home_dir
+      && os_IsAbsolutePath(config->contests_home_dir)) {
+    if (!(var_dir = config->var_dir)) var_dir = "var";
+    snprintf(buf, size, "%s/%s/%s", config->contests_home_dir, var_dir,
+             USERLIST_IMAGE_DIR);
+    return 0;
+  }
+  return -1;
+}
+
+static void
+make_path(
+        unsigned char *buf,
+        size_t size,
+        const unsigned char *dir,
+        int contest_id,
+        const unsigned char *suffix)
+{
+  snprintf(buf, size, "%s/%06d%s", dir, contest_id, suffix);
+}
+
+static int
+check_image(
+        const unsigned char *data,
+        size_t size,
+        int contest_id)
+{
+  const struct userlist_image_header *hdr;
+
+  if (size < sizeof(*hdr)) return -1;
+  hdr = (const struct userlist_image_header*) data;
+  if (memcmp(hdr->signature, image_signature, sizeof(image_signature)))
+    return -1;
+  if (hdr->version != USERLIST_IMAGE_VERSION
+      || hdr->header_size != sizeof(*hdr)
+      || hdr->contest_id != contest_id
+      || hdr->total_size != size
+      || hdr->user_count < 0 || hdr->max_user_id < 0
+      || hdr->login_hash_size <= 0
+      || (hdr->login_hash_size & (hdr->login_hash_size - 1))
+      || hdr->strings_size <= 0
+      || hdr->strings_offset + (long long) hdr->strings_size != size
+      || data[size - 1] != 0)
+    return -1;
+  return 0;
+}
+
+struct userlist_image *
+userlist_image_open(const unsigned char *dir, int contest_id)
+{
+  unsigned char path[PATH_MAX];
+  struct userlist_image *img = NULL;
+  struct stat stb;
+  void *data;
+  int fd;
+
+  make_path(path, sizeof(path), dir, contest_id, ".img");
+  if ((fd = open(path, O_RDONLY, 0)) < 0) return NULL;
+  if (fstat(fd, &stb) < 0 || !S_ISREG(stb.st_mode) || stb.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+  data = mmap(NULL, stb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    err("userlist_image_open: mmap of '%s' failed: %s", path, os_ErrorMsg());
+    return NULL;
+  }
+  if (check_image(data, stb.st_size, contest_id) < 0) {
+    err("userlist_image_open: '%s' is invalid", path);
+    munmap(data, stb.st_size);
+    return NULL;
+  }
+
+  XCALLOC(img, 1);
+  img->size = stb.st_size;
+  img->data = data;
+  img->hdr = data;
+  img->id_map = (const int*) (img->data + img->hdr->id_map_offset);
+  img->users = (const struct userlist_image_user*)
+    (img->data + img->hdr->users_offset);
+  img->login_hash = (const int*) (img->data + img->hdr->login_hash_offset);
+  img->strings = img->data + img->hdr->strings_offset;
+  return img;
+}
+
+struct userlist_image *
+userlist_image_close(struct userlist_image *img)
+{
+  if (!img) return NULL;
+  munmap((void*) img->data, img->size);
+  memset(img, 0, sizeof(*img));
+  xfree(img);
+  return NULL;
+}
+
+const struct userlist_image_user *
+userlist_image_get_user(const struct userlist_image *img, int user_id)
+{
+  int ind;
+
+  if (user_id <= 0 || user_id > img->hdr->max_user_id) return NULL;
+  if ((ind = img->id_map[user_id]) < 0) return NULL;
+  return &img->users[ind];
+}
+
+const struct userlist_image_user *
+userlist_image_find_login(
+        const struct userlist_image *img,
+        const unsigned char *login)
+{
+  unsigned int hash, mask = img->hdr->login_hash_size - 1, i;
+  const struct userlist_image_user *u;
+  int ind;
+
+  if (!login) return NULL;
+  hash = login_hash(login);
+  for (i = hash & mask; (ind = img->login_hash[i]) >= 0; i = (i + 1) & mask) {
+    u = &img->users[ind];
+    if (u->login_hash == hash && !strcmp(img->strings + u->login, login))
+      return u;
+  }
+  return NULL;
+}
+
+static void
+map_current(struct userlist_image_pub *pub)
+{
+  unsigned char path[PATH_MAX];
+  struct stat stb;
+  void *data;
+  int fd;
+
+  make_path(path, sizeof(path), pub->dir, pub->contest_id, ".img");
+  if ((fd = open(path, O_RDWR, 0)) < 0) return;
+  if (fstat(fd, &stb) < 0 || !S_ISREG(stb.st_mode) || stb.st_size <= 0) {
+    close(fd);
+    return;
+  }
+  data = mmap(NULL, stb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return;
+  if (check_image(data, stb.st_size, pub->contest_id) < 0) {
+    munmap(data, stb.st_size);
+    return;
+  }
+  pub->cur_data = data;
+  pub->cur_size = stb.st_size;
+  pub->generation =
+    ((const struct userlist_image_header*) data)->generation;
+}
+
+static void
+release_current(struct userlist_image_pub *pub)
+{
+  if (!pub->cur_data) return;
+  ((struct userlist_image_header*) pub->cur_data)->superseded = 1;
+  munmap(pub->cur_data, pub->cur_size);
+  pub->cur_data = NULL;
+  pub->cur_size = 0;
+}
+
+struct userlist_image_pub *
+userlist_image_pub_create(const unsigned char *dir, int contest_id)
+{
+  struct userlist_image_pub *pub;
+
+  if (os_MakeDirPath(dir, 0755) < 0) {
+    err("userlist_image_pub_create: cannot create directory '%s'", dir);
+    return NULL;
+  }
+
+  XCALLOC(pub, 1);
+  pub->dir = xstrdup(dir);
+  pub->contest_id = contest_id;
+  /* the image left from the previous run is superseded by the first
+     image we publish */
+  map_current(pub);
+  return pub;
+}
+
+struct userlist_image_pub *
+userlist_image_pub_free(struct userlist_image_pub *pub)
+{
+  if (!pub) return NULL;
+  if (pub->cur_data) munmap(pub->cur_data, pub->cur_size);
+  xfree(pub->dir);
+  memset(pub, 0, sizeof(*pub));
+  xfree(pub);
+  return NULL;
+}
+
+int
+userlist_image_publish(
+        struct userlist_image_pub *pub,
+        int user_contest_id,
+        int user_count,
+        const struct userlist_image_src *users)
+{
+  unsigned char tmp_path[PATH_MAX], path[PATH_MAX];
+  struct userlist_image_header *hdr;
+  struct userlist_image_user *iu;
+  int *id_map, *lhash;
+  unsigned char *data = NULL, *strs;
+  size_t total_size, strings_size = 1, len;
+  int max_user_id = 0, hash_size = 16, i, j, str_off, fd = -1;
+  unsigned int mask;
+  ssize_t w;
+  size_t off;
+
+  for (i = 0; i < user_count; ++i) {
+    if (users[i].user_id > max_user_id) max_user_id = users[i].user_id;
+    strings_size += strlen(users[i].login) + 1;
+    if (users[i].name && *users[i].name)
+      strings_size += strlen(users[i].name) + 1;
+  }
+  while (hash_size < user_count * 2) hash_size *= 2;
+
+  XCALLOC(hdr, 1);
+  memcpy(hdr->signature, image_signature, sizeof(image_signature));
+  hdr->version = USERLIST_IMAGE_VERSION;
+  hdr->header_size = sizeof(*hdr);
+  hdr->contest_id = pub->contest_id;
+  hdr->user_contest_id = user_contest_id;
+  hdr->generation = ++pub->generation;
+  hdr->publish_time = time(NULL);
+  hdr->user_count = user_count;
+  hdr->max_user_id = max_user_id;
+  hdr->id_map_offset = ALIGN8(sizeof(*hdr));
+  hdr->users_offset = ALIGN8(hdr->id_map_offset
+                             + (max_user_id + 1) * sizeof(int));
+  hdr->login_hash_offset = ALIGN8(hdr->users_offset
+                                  + user_count * sizeof(*iu));
+  hdr->login_hash_size = hash_size;
+  hdr->strings_offset = ALIGN8(hdr->login_hash_offset
+                               + hash_size * sizeof(int));
+  hdr->strings_size = strings_size;
+  total_size = hdr->strings_offset + strings_size;
+  hdr->total_size = total_size;
+
+  data = xcalloc(total_size, 1);
+  memcpy(data, hdr, sizeof(*hdr));
+  xfree(hdr);
+  hdr = (struct userlist_image_header*) data;
+  id_map = (int*) (data + hdr->id_map_offset);
+  iu = (struct userlist_image_user*) (data + hdr->users_offset);
+  lhash = (int*) (data + hdr->login_hash_offset);
+  strs = data + hdr->strings_offset;
+  memset(id_map, -1, (max_user_id + 1) * sizeof(int));
+  memset(lhash, -1, hash_size * sizeof(int));
+  mask = hash_size - 1;
+
+  str_off = 1;
+  for (i = 0; i < user_count; ++i) {
+    iu[i].user_id = users[i].user_id;
+    iu[i].status = users[i].status;
+    iu[i].flags = users[i].flags;
+    iu[i].login_hash = login_hash(users[i].login);
+    len = strlen(users[i].login) + 1;
+    memcpy(strs + str_off, users[i].login, len);
+    iu[i].login = str_off;
+    str_off += len;
+    if (users[i].name && *users[i].name) {
+      len = strlen(users[i].name) + 1;
+      memcpy(strs + str_off, users[i].name, len);
+      iu[i].name = str_off;
+      str_off += len;
+    }
+    if (users[i].user_id > 0) id_map[users[i].user_id] = i;
+    for (j = iu[i].login_hash & mask; lhash[j] >= 0; j = (j + 1) & mask);
+    lhash[j] = i;
+  }
+
+  make_path(tmp_path, sizeof(tmp_path), pub->dir, pub->contest_id, ".tmp");
+  make_path(path, sizeof(path), pub->dir, pub->contest_id, ".img");
+  if ((fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+    err("userlist_image_publish: cannot create '%s': %s", tmp_path,
+        os_ErrorMsg());
+    goto fail;
+  }
+  for (off = 0; off < total_size; off += w) {
+    if ((w = write(fd, data + off, total_size - off)) <= 0) {
+      err("userlist_image_publish: write to '%s' failed: %s", tmp_path,
+          os_ErrorMsg());
+      goto fail;
+    }
+  }
+  xfree(data);
+  data = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    data = NULL;
+    err("userlist_image_publish: mmap of '%s' failed: %s", tmp_path,
+        os_ErrorMsg());
+    goto fail;
+  }
+  close(fd); fd = -1;
+  if (rename(tmp_path, path) < 0) {
+    err("userlist_image_publish: rename to '%s' failed: %s", path,
+        os_ErrorMsg());
+    munmap(data, total_size);
+    data = NULL;
+    goto fail;
+  }
+
+  release_current(pub);
+  pub->cur_data = data;
+  pub->cur_size = total_size;
+  return 0;
+
+fail:
+  if (fd >= 0) close(fd);
+  unlink(tmp_path);
+  xfree(data);
+  return -1;
+}
@@ -0,0 +1,138 @@
+/* -*- c -*- */
+/* $Id$ */
+#ifndef __USERLIST_IMAGE_H__
+#define __USERLIST_IMAGE_H__
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdlib.h>
+
+/*
+ * Read-only images of the contest user tables, published by
+ * userlist-server and mapped by the serve processes.
+ *
+ * An image is a file <dir>/<contest_id>.img which is never modified
+ * after it is published except for the `superseded' flag. To publish
+ * a new version the writer renames a new file over the old one
+ * and then sets `superseded' in the old image, which is still mapped
+ * by the readers. So a reader checks a single flag in the shared
+ * memory to find out, that it must remap the image.
+ */
+
+#define USERLIST_IMAGE_DIR "userlist_images"
+#define USERLIST_IMAGE_VERSION 1
+
+struct userlist_image_header
+{
+  unsigned char signature[8];
+  int version;
+  int header_size;
+  int contest_id;
+  int user_contest_id;
+  volatile int superseded;
+  int pad1;
+  long long generation;
+  long long publish_time;
+  long long total_size;
+
+  int user_count;
+  int max_user_id;
+  int id_map_offset;            // int[max_user_id + 1]: user index or -1
+  int users_offset;             // struct userlist_image_user[user_count]
+  int login_hash_offset;        // int[login_hash_size]: user index or -1
+  int login_hash_size;          // power of 2
+  int strings_offset;
+  int strings_size;
+};
+
+struct userlist_image_user
+{
+  int user_id;
+  int status;                   // USERLIST_REG_*
+  unsigned int flags;           // USERLIST_UC_*
+  unsigned int login_hash;
+  int login;                    // offset in the string pool
+  int name;                     // offset in the string pool, 0 - no name
+};
+
+struct userlist_image
+{
+  size_t size;
+  const unsigned char *data;
+  const struct userlist_image_header *hdr;
+  const int *id_map;
+  const struct userlist_image_user *users;
+  const int *login_hash;
+  const unsigned char *strings;
+};
+
+struct ejudge_cfg;
+
+/* the directory of the images: <var_dir>/userlist_images */
+int
+userlist_image_get_dir(
+        const struct ejudge_cfg *config,
+        unsigned char *buf,
+        size_t size);
+
+/* maps the current image of the contest, NULL, if there is no image */
+struct userlist_image *
+userlist_image_open(const unsigned char *dir, int contest_id);
+struct userlist_image *
+userlist_image_close(struct userlist_image *img);
+
+static inline int
+userlist_image_is_stale(const struct userlist_image *img)
+{
+  return img->hdr->superseded;
+}
+
+const struct userlist_image_user *
+userlist_image_get_user(const struct userlist_image *img, int user_id);
+const struct userlist_image_user *
+userlist_image_find_login(
+        const struct userlist_image *img,
+        const unsigned char *login);
+
+static inline const unsigned char *
+userlist_image_str(const struct userlist_image *img, int offset)
+{
+  return img->strings + offset;
+}
+
+/* the writer side */
+struct userlist_image_src
+{
+  int user_id;
+  int status;
+  unsigned int flags;
+  const unsigned char *login;
+  const unsigned char *name;
+};
+
+struct userlist_image_pub;
+
+struct userlist_image_pub *
+userlist_image_pub_create(const unsigned char *dir, int contest_id);
+struct userlist_image_pub *
+userlist_image_pub_free(struct userlist_image_pub *pub);
+int
+userlist_image_publish(
+        struct userlist_image_pub *pub,
+        int user_contest_id,
+        int user_count,
+        const struct userlist_image_src *users);
+
+#endif /* __USERLIST_IMAGE_H__ */
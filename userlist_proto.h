@@ -403,9 +403,16 @@ struct userlist_pk_list_users_2
   int   filter_len;
   int   offset;
   int   count;
+  int   flags;
   unsigned char data[1];
 };
 
+/* flags of the user list requests */
+enum
+  {
+    ULS_LIST_BY_RELEVANCE = 1,  /* order the filtered users by relevance */
+  };
+
 struct userlist_pk_create_user_2
 {
   short request_id;
@@ -210,6 +210,7 @@ elem_free(struct xml_tree *t)
       xfree(p->login_hash_table);
       xfree(p->cookie_hash_table);
       xfree(p->client_key_hash_table);
+      xfree(p->cookie_wheel);
       xfree(p->group_map);
       xfree(p->group_hash_table);
     }
@@ -352,6 +353,118 @@ userlist_free_attrs(struct xml_tree *t)
   xml_tree_free_attrs(t, &userlist_parse_spec);
 }
 
+/*
+ * The userlist may be parsed into an xml_arena. Then the nodes and the
+ * strings, which the parser creates, are allocated in the arena too,
+ * and the nodes and the strings, which it drops, are not freed.
+ */
+static struct xml_arena *parse_arena;
+
+static struct xml_tree *
+node_alloc(int tag)
+{
+  struct xml_tree *p;
+  size_t size;
+
+  if (!parse_arena) return userlist_node_alloc(tag);
+  if (!(size = elem_sizes[tag])) size = sizeof(struct xml_tree);
+  p = (struct xml_tree*) xml_arena_alloc(parse_arena, size);
+  p->tag = tag;
+  return p;
+}
+
+static void
+free_node(struct xml_tree *t)
+{
+  if (!parse_arena) userlist_free(t);
+}
+
+static void
+free_attrs(struct xml_tree *t)
+{
+  if (!parse_arena) {
+    userlist_free_attrs(t);
+    return;
+  }
+  t->first = t->last = 0;
+}
+
+static void
+free_text(char **p_text)
+{
+  if (!parse_arena) xfree(*p_text);
+  *p_text = 0;
+}
+
+static void
+free_str(unsigned char **p_str)
+{
+  if (!parse_arena) xfree(*p_str);
+  *p_str = 0;
+}
+
+static unsigned char *
+empty_str(void)
+{
+  if (!parse_arena) return xstrdup("");
+  return (unsigned char*) xml_arena_strdup(parse_arena, "");
+}
+
+static int
+empty_text(struct xml_tree *t)
+{
+  if (!parse_arena) return xml_empty_text(t);
+  if (xml_empty_text_c(t) < 0) return -1;
+  t->text = 0;
+  return 0;
+}
+
+static void *
+alloc_array(size_t count, size_t size)
+{
+  if (!parse_arena) return xcalloc(count, size);
+  return xml_arena_alloc(parse_arena, count * size);
+}
+
+/* the new elements are zeroed */
+static void *
+grow_array(void *ptr, size_t old_count, size_t new_count, size_t size)
+{
+  void *new_ptr = alloc_array(new_count, size);
+
+  if (old_count > 0) memcpy(new_ptr, ptr, old_count * size);
+  if (!parse_arena) xfree(ptr);
+  return new_ptr;
+}
+
+static struct userlist_user_info *
+get_cnts0(struct userlist_user *u)
+{
+  if (!parse_arena) return userlist_get_cnts0(u);
+  if (u->cnts0) return u->cnts0;
+  u->cnts0 = (struct userlist_user_info*) node_alloc(USERLIST_T_CNTSINFO);
+  u->cnts0->instnum = -1;
+  xml_link_node_last(&u->b, &u->cnts0->b);
+  return u->cnts0;
+}
+
+static void
+expand_cntsinfo(struct userlist_user *u, int contest_id)
+{
+  int new_size;
+
+  if (!parse_arena) {
+    userlist_expand_cntsinfo(u, contest_id);
+    return;
+  }
+  if (contest_id < u->cntsinfo_a) return;
+  if (!(new_size = u->cntsinfo_a)) new_size = 32;
+  while (contest_id >= new_size) new_size *= 2;
+  u->cntsinfo = grow_array(u->cntsinfo, u->cntsinfo_a, new_size,
+                           sizeof(u->cntsinfo[0]));
+  u->cntsinfo_a = new_size;
+}
+
 struct string_to_int_tbl
 {
   const unsigned char *str;
@@ -486,7 +599,7 @@ parse_passwd(struct xml_tree *t, unsigned char **p_pwd, int *p_method)
     xml_err_nested_elems(t);
     return -1;
   }
-  if (!t->text) t->text = xstrdup("");
+  if (!t->text) t->text = empty_str();
 
   for (a = t->first; a; a = a->next) {
     if (a->tag != USERLIST_A_METHOD) {
@@ -495,7 +608,7 @@ parse_passwd(struct xml_tree *t, unsigned char **p_pwd, int *p_method)
     }
     if (parse_password_method_attr(a, p_method) < 0) return -1;
   }
-  userlist_free_attrs(t);
+  free_attrs(t);
   if (!*t->text) *p_method = USERLIST_PWD_PLAIN;
   *p_pwd = t->text; t->text = 0;
   return 0;
@@ -513,11 +626,11 @@ parse_cookies(
   int has_ip = 0;
 
   if (cookies->first) return xml_err_attrs(cookies);
-  if (xml_empty_text(cookies) < 0) return -1;
+  if (empty_text(cookies) < 0) return -1;
   for (t = cookies->first_down; t; t = t->right) {
     if (t->tag != USERLIST_T_COOKIE) return xml_err_elem_not_allowed(t);
     c = (struct userlist_cookie*) t;
-    if (xml_empty_text(t) < 0) return -1;
+    if (empty_text(t) < 0) return -1;
     if (t->first_down) return xml_err_nested_elems(t);
     c->contest_id = -1;
     c->locale_id = -1;
@@ -571,7 +684,7 @@ parse_cookies(
         return xml_err_attr_not_allowed(t, a);
       }
     }
-    userlist_free_attrs(t);
+    free_attrs(t);
     if (!has_ip) return xml_err_attr_undefined(t, USERLIST_A_IP);
     if (!c->cookie) return xml_err_attr_undefined(t, USERLIST_A_VALUE);
     if (!c->expire) return xml_err_attr_undefined(t, USERLIST_A_EXPIRE);
@@ -636,19 +749,19 @@ parse_members(
     return xml_err_elem_not_allowed(q);
   role = q->tag - USERLIST_T_CONTESTANTS;
   if (q->first) return xml_err_attrs(q);
-  xfree(q->text); q->text = 0;
+  free_text(&q->text);
 
   for (t = q->first_down; t; t = saved_next_2) {
     saved_next_2 = t->right;
 
     if (t->tag != USERLIST_T_MEMBER) return xml_err_elem_not_allowed(t);
     mb = (struct userlist_member*) t;
-    xfree(t->text); t->text = 0;
+    free_text(&t->text);
     mb->grade = -1;
     mb->team_role = role;
 
     if (!ui->members) {
-      mmm=(struct userlist_members*)userlist_node_alloc(USERLIST_T_MEMBERS);
+      mmm=(struct userlist_members*)node_alloc(USERLIST_T_MEMBERS);
       ui->members = mmm;
       xml_link_node_last(link_node, &mmm->b);
     }
@@ -657,7 +770,7 @@ parse_members(
     if (mmm->u == mmm->a) {
       if (!mmm->a) mmm->a = 4;
       else mmm->a *= 2;
-      XREALLOC(mmm->m, mmm->a);
+      mmm->m = grow_array(mmm->m, mmm->u, mmm->a, sizeof(mmm->m[0]));
     }
     mmm->m[mmm->u++] = mb;
     xml_unlink_node(t);
@@ -697,7 +810,7 @@ parse_members(
         return xml_err_attr_not_allowed(t, a);
       }
     }
-    userlist_free_attrs(t);
+    free_attrs(t);
 
     for (p = t->first_down; p; p = saved_next) {
       saved_next = p->right;
@@ -706,7 +819,7 @@ parse_members(
         p_str = XPDEREF(unsigned char *, mb, leaf_member_offsets[p->tag]);
         if (xml_leaf_elem(p, p_str, 1, 1) < 0) return -1;
         xml_unlink_node(p);
-        userlist_free(p);
+        free_node(p);
         continue;
       }
 
@@ -718,7 +831,7 @@ parse_members(
         if (userlist_parse_date_2(p->text, p_time) < 0)
           return xml_err_elem_invalid(p);
         xml_unlink_node(p);
-        userlist_free(p);
+        free_node(p);
         continue;
       }
 
@@ -729,7 +842,7 @@ parse_members(
         if (p->first_down) return xml_err_nested_elems(p);
         if (parse_contestant_status_elem(p, &mb->status) < 0) return -1;
         xml_unlink_node(p);
-        userlist_free(p);
+        free_node(p);
         break;
       case USERLIST_T_GENDER:
         if (mb->gender) return xml_err_elem_redefined(p);
@@ -737,7 +850,7 @@ parse_members(
         if (p->first_down) return xml_err_nested_elems(p);
         if (parse_contestant_gender_elem(p, &mb->gender) < 0) return -1;
         xml_unlink_node(p);
-        userlist_free(p);
+        free_node(p);
         break;
       case USERLIST_T_GRADE:
         if (mb->grade >= 0) return xml_err_elem_redefined(p);
@@ -749,7 +862,7 @@ parse_members(
         if (mb->grade < -1 || mb->grade >= 100000)
           return xml_err_elem_invalid(p);
         xml_unlink_node(p);
-        userlist_free(p);
+        free_node(p);
         break;
       default:
         return xml_err_elem_not_allowed(p);
@@ -773,14 +886,14 @@ parse_contest(char const *path, struct xml_tree *t,
     if (usr->contests) return xml_err_elem_redefined(t);
     usr->contests = t;
   }
-  xfree(t->text); t->text = 0;
+  free_text(&t->text);
   if (t->first) xml_err_attrs(t);
 
   for (p = t->first_down; p; p = p->right) {
     if (p->tag != USERLIST_T_CONTEST)
       return xml_err_elem_not_allowed(p);
     if (p->first_down) return xml_err_nested_elems(p);
-    if (xml_empty_text(p) < 0) return -1;
+    if (empty_text(p) < 0) return -1;
     reg = (struct userlist_contest*) p;
     
     reg->id = -1;
@@ -824,7 +937,7 @@ parse_contest(char const *path, struct xml_tree *t,
         return xml_err_attr_not_allowed(p, a);
       }
     }
-    userlist_free_attrs(p);
+    free_attrs(p);
     if (reg->id == -1)
       return xml_err_attr_undefined(p, USERLIST_A_ID);
     if (reg->status == -1)
@@ -889,7 +1002,7 @@ parse_cntsinfo(const char *path, struct xml_tree *node,
   ASSERT(node->tag == USERLIST_T_CNTSINFO);
   ui = (struct userlist_user_info*) node;
 
-  if (xml_empty_text(node) < 0) return -1;
+  if (empty_text(node) < 0) return -1;
 
   /* parse attributes */
   ui->contest_id = 0;
@@ -931,7 +1044,7 @@ parse_cntsinfo(const char *path, struct xml_tree *node,
       return xml_err_attr_not_allowed(node, a);
     }
   }
-  userlist_free_attrs(node);
+  free_attrs(node);
 
   if (ui->contest_id <= 0)
     return xml_err_attr_undefined(node, USERLIST_A_CONTEST_ID);
@@ -945,7 +1058,7 @@ parse_cntsinfo(const char *path, struct xml_tree *node,
       p_str = XPDEREF(unsigned char *, ui, leaf_info_offsets[p->tag]);
       if (xml_leaf_elem(p, p_str, 1, 1) < 0) return -1;
       xml_unlink_node(p);
-      userlist_free(p);
+      free_node(p);
       continue;
     }
 
@@ -974,9 +1087,9 @@ parse_cntsinfo(const char *path, struct xml_tree *node,
     }
   }
 
-  if (!ui->name) ui->name = xstrdup("");
+  if (!ui->name) ui->name = empty_str();
 
-  userlist_expand_cntsinfo(usr, ui->contest_id);
+  expand_cntsinfo(usr, ui->contest_id);
   usr->cntsinfo[ui->contest_id] = ui;
 
   return 0;
@@ -991,7 +1104,7 @@ parse_cntsinfos(const char *path, struct xml_tree *node,
   ASSERT(node);
   ASSERT(node->tag == USERLIST_T_CNTSINFOS);
 
-  if (xml_empty_text(node) < 0) return -1;
+  if (empty_text(node) < 0) return -1;
   if (node->first) return xml_err_attrs(node);
   if (usr->cntsinfo_a > 0) return xml_err_elem_redefined(node);
 
@@ -1011,7 +1124,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
   unsigned char **p_str;
   struct userlist_user_info *ui;
 
-  xfree(usr->b.text); usr->b.text = 0;
+  free_text(&usr->b.text);
 
   usr->id = -1;
   for (a = usr->b.first; a; a = a->next) {
@@ -1031,7 +1144,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
                      &usr->last_login_time) < 0) return -1;
       break;
     case USERLIST_A_CNTS_LAST_LOGIN:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_parse_date(NULL, path, a->line, a->column, a->text,
                      &ui->last_login_time) < 0) return -1;
       break;
@@ -1044,7 +1157,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
                      &usr->last_change_time) < 0) return -1;
       break;
     case USERLIST_A_LAST_INFO_CHANGE:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_parse_date(NULL, path, a->line, a->column, a->text,
                      &ui->last_change_time) < 0) return -1;
       break;
@@ -1053,7 +1166,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
                      &usr->last_pwdchange_time) < 0) return -1;
       break;
     case USERLIST_A_LAST_INFO_PWDCHANGE:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_parse_date(NULL, path, a->line, a->column, a->text,
                      &ui->last_pwdchange_time) < 0) return -1;
       break;
@@ -1062,7 +1175,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
                      &usr->last_minor_change_time) < 0) return -1;
       break;
     case USERLIST_A_INFO_CREATE:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_parse_date(NULL, path, a->line, a->column, a->text,
                          &ui->create_time) < 0) return -1;
       break;
@@ -1085,7 +1198,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
       if (xml_attr_bool(a, &usr->read_only) < 0) return -1;
       break;
     case USERLIST_A_CNTS_READ_ONLY:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_attr_bool(a, &ui->cnts_read_only) < 0) return -1;
       break;
     case USERLIST_A_NEVER_CLEAN:
@@ -1098,7 +1211,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
       return xml_err_attr_not_allowed(&usr->b, a);
     }
   }
-  userlist_free_attrs(&usr->b);
+  free_attrs(&usr->b);
   if (usr->id == -1)
     return xml_err_attr_undefined(&usr->b, USERLIST_A_ID);
   if (usr->cnts0) usr->cnts0->instnum = -1;
@@ -1107,11 +1220,11 @@ do_parse_user(char const *path, struct userlist_user *usr)
     saved_next = t->right;
 
     if (leaf_info_offsets[t->tag] > 0) {
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       p_str = XPDEREF(unsigned char *, ui, leaf_info_offsets[t->tag]);
       if (xml_leaf_elem(t, p_str, 1, 1) < 0) return -1;
       xml_unlink_node(t);
-      userlist_free(t);
+      free_node(t);
       continue;
     }
 
@@ -1127,7 +1240,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
       }
       usr->login = t->text; t->text = 0;
       xml_unlink_node(t);
-      userlist_free(t);
+      free_node(t);
       break;
     case USERLIST_T_PASSWORD:
       if (usr->passwd) return xml_err_elem_redefined(t);
@@ -1135,7 +1248,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
         return -1;
       break;
     case USERLIST_T_TEAM_PASSWORD:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (ui->team_passwd) return xml_err_elem_redefined(t);
       if (parse_passwd(t, &ui->team_passwd, &ui->team_passwd_method) < 0)
         return -1;
@@ -1149,9 +1262,9 @@ do_parse_user(char const *path, struct userlist_user *usr)
         if (xml_attr_bool(a, &usr->show_email) < 0) return -1;
       }
       usr->email = t->text; t->text = 0;
-      if (!usr->email) usr->email = xstrdup("");
+      if (!usr->email) usr->email = empty_str();
       xml_unlink_node(t);
-      userlist_free(t);
+      free_node(t);
       break;
     case USERLIST_T_COOKIES:
       if (usr->cookies) return xml_err_elem_redefined(t);
@@ -1161,7 +1274,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
     case USERLIST_T_EXTRA1:
       if (xml_leaf_elem(t, &usr->extra1, 1, 1) < 0) return -1;
       xml_unlink_node(t);
-      userlist_free(t);
+      free_node(t);
       break;
     case USERLIST_T_CONTESTS:
       if (parse_contest(path, t, usr) < 0) return -1;
@@ -1171,14 +1284,14 @@ do_parse_user(char const *path, struct userlist_user *usr)
     case USERLIST_T_COACHES:
     case USERLIST_T_ADVISORS:
     case USERLIST_T_GUESTS:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (parse_members(path, t, &usr->b, ui) < 0) return -1;
       break;
     case USERLIST_T_CNTSINFOS:
       if (parse_cntsinfos(path, t, usr) < 0) return -1;
       break;
     case USERLIST_T_INSTNUM:
-      ui = userlist_get_cnts0(usr);
+      ui = get_cnts0(usr);
       if (xml_parse_int(NULL, path,t->line,t->column,t->text,&ui->instnum) < 0)
         return -1;
       if (ui->instnum < 0) return xml_err_elem_invalid(t);
@@ -1198,7 +1311,7 @@ do_parse_user(char const *path, struct userlist_user *usr)
     return xml_err_elem_undefined(&usr->b, USERLIST_T_PASSWORD);
   */
   if (usr->cnts0 && !usr->cnts0->name)
-    usr->cnts0->name = xstrdup("");
+    usr->cnts0->name = empty_str();
   return 0;
 }
 
@@ -1233,18 +1346,18 @@ do_parse_usergroups(
       switch (a->tag) {
       case USERLIST_A_GROUP_ID:
         if (xml_attr_int(a, &group_id) < 0) {
-          xfree(group_name);
-          xfree(description);
+          free_str(&group_name);
+          free_str(&description);
           return -1;
         }
         break;
       case USERLIST_A_GROUP_NAME:
-        xfree(group_name);
+        free_str(&group_name);
         group_name = a->text;
         a->text = 0;
         break;
       case USERLIST_A_DESCRIPTION:
-        xfree(description);
+        free_str(&description);
         description = a->text;
         a->text = 0;
         break;
@@ -1255,18 +1368,18 @@ do_parse_usergroups(
 
     grp = (struct userlist_group*) t;
     if (group_id == -1) {
-      xfree(group_name);
-      xfree(description);
+      free_str(&group_name);
+      free_str(&description);
       return xml_err_attr_undefined(t, USERLIST_A_GROUP_ID);
     }
     if (group_id <= 0 || group_id >= 1000000) {
-      xfree(group_name);
-      xfree(description);
+      free_str(&group_name);
+      free_str(&description);
       return xml_err_elem_invalid(t);
     }
     if (!group_name) {
-      xfree(group_name);
-      xfree(description);
+      free_str(&group_name);
+      free_str(&description);
       return xml_err_attr_undefined(t, USERLIST_A_GROUP_ID);
     }
     grp->group_id = group_id;
@@ -1281,7 +1394,7 @@ do_parse_usergroups(
   /* collect groups, check unuqieness of group_id */
   while (group_size <= max_group_id) group_size *= 2;
   lst->group_map_size = group_size;
-  XCALLOC(lst->group_map, group_size);
+  lst->group_map = alloc_array(group_size, sizeof(lst->group_map[0]));
   for (t = groups->first_down; t; t = t->right) {
     grp = (struct userlist_group*) t;
     ASSERT(grp->group_id > 0 && grp->group_id < group_size);
@@ -1403,7 +1516,7 @@ do_parse_userlist(char const *path, struct userlist_list *lst)
   for (a = lst->b.first; a; a = a->next) {
     switch (a->tag) {
     case USERLIST_A_NAME:
-      xfree(lst->name);
+      free_str(&lst->name);
       lst->name = a->text; a->text = 0;
       break;
     case USERLIST_A_MEMBER_SERIAL:
@@ -1420,9 +1533,9 @@ do_parse_userlist(char const *path, struct userlist_list *lst)
       return xml_err_attr_not_allowed(&lst->b, a);
     }
   }
-  xfree(lst->b.text); lst->b.text = 0;
+  free_text(&lst->b.text);
   if (!lst->member_serial) lst->member_serial = 1;
-  userlist_free_attrs(&lst->b);
+  free_attrs(&lst->b);
 
   for (t = lst->b.first_down; t; t = t->right) {
     if (t->tag == USERLIST_T_USERGROUPS) {
@@ -1448,7 +1561,7 @@ do_parse_userlist(char const *path, struct userlist_list *lst)
     }
   }
   lst->user_map_size = map_size;
-  lst->user_map = (struct userlist_user**) xcalloc(map_size, sizeof(lst->user_map[0]));
+  lst->user_map = alloc_array(map_size, sizeof(lst->user_map[0]));
   for (u = (struct userlist_user*) lst->b.first_down; u;
        u = (struct userlist_user*) u->b.right) {
     if (u->b.tag == USERLIST_T_USER) {
@@ -1558,6 +1671,28 @@ userlist_parse_str(unsigned char const *str)
   return 0;
 }
 
+struct userlist_list *
+userlist_parse_str_arena(unsigned char const *str, struct xml_arena *arena)
+{
+  struct xml_tree *tree = 0;
+  struct userlist_list *lst = 0;
+
+  xml_err_path = 0;
+  xml_err_spec = &userlist_parse_spec;
+
+  tree = xml_build_tree_str_arena(NULL, str, &userlist_parse_spec, arena);
+  if (!tree) return 0;
+  if (tree->tag != USERLIST_T_USERLIST) {
+    xml_err_top_level(tree, USERLIST_T_USERLIST);
+    return 0;
+  }
+  lst = (struct userlist_list *) tree;
+  parse_arena = arena;
+  if (do_parse_userlist("", lst) < 0) lst = 0;
+  parse_arena = 0;
+  return lst;
+}
+
 void *
 userlist_free(struct xml_tree *p)
 {
@@ -0,0 +1,66 @@
+/* -*- mode: c -*- */
+/* $Id$ */
+
+/* Copyright (C) 2013 Alexander Chernov <cher@ejudge.ru> */
+
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "cpu_slots.h"
+#include "errlog.h"
+
+#include <stdlib.h>
+
+struct cpu_slot_table *
+cpu_slot_table_create(
+        const unsigned char *dir,
+        const unsigned char *host,
+        const unsigned char *spec,
+        int cpus_per_slot)
+{
+  err("cpu_slot_table_create: not implemented");
+  return NULL;
+}
+
+struct cpu_slot_table *
+cpu_slot_table_free(struct cpu_slot_table *tab)
+{
+  return NULL;
+}
+
+int
+cpu_slot_acquire(struct cpu_slot_table *tab)
+{
+  return -1;
+}
+
+void
+cpu_slot_release(struct cpu_slot_table *tab)
+{
+}
+
+const unsigned char *
+cpu_slot_unparse(
+        unsigned char *buf,
+        int size,
+        const struct cpu_slot_table *tab,
+        int slot)
+{
+  buf[0] = 0;
+  return buf;
+}
+
+/*
+ * Local variables:
+ *  compile-command: "make -C .."
+ * End:
+ */
@@ -84,6 +84,15 @@ struct q_dir_entry
   unsigned char  ign;
 };
 
+int
+scan_dir_get_priority(const unsigned char *name)
+{
+  if (strlen(name) != EJ_SERVE_PACKET_NAME_SIZE - 1) return 0;
+  if (name[0] >= '0' && name[0] <= '9') return -16 + (name[0] - '0');
+  if (name[0] >= 'A' && name[0] <= 'V') return -6 + (name[0] - 'A');
+  return 0;
+}
+
 /* scans 'dir' directory and returns the filename found */
 int
 scan_dir(char const *partial_path, char *found_item, size_t fi_size)
@@ -143,15 +152,7 @@ scan_dir(char const *partial_path, char *found_item, size_t fi_size)
       continue;
     }
 
-    if (strlen(result.cFileName) != EJ_SERVE_PACKET_NAME_SIZE - 1) {
-      prio = 0;
-    } else if (result.cFileName[0] >= '0' && result.cFileName[0] <= '9') {
-      prio = -16 + (result.cFileName[0] - '0');
-    } else if (result.cFileName[0] >= 'A' && result.cFileName[0] <= 'V') {
-      prio = -6 + (result.cFileName[0] - 'A');
-    } else {
-      prio = 0;
-    }
+    prio = scan_dir_get_priority(result.cFileName);
     if (prio < -16) prio = -16;
     if (prio > 15) prio = 15;
     prio += 16;
@@ -716,6 +716,24 @@ task_EnableProcessGroup(tTask *tsk)
   return 0;
 }
 
+int
+task_EnableCgroup(tTask *tsk)
+{
+  return -1;
+}
+
+int
+task_SetCgroupRoot(const char *path)
+{
+  return -1;
+}
+
+int
+task_SetCgroupMemoryLimit(size_t size)
+{
+  return -1;
+}
+
 int
 task_SetMaxCoreSize(tTask *tsk, ssize_t max_core_size)
 {
@@ -1428,6 +1446,12 @@ task_GetMemoryUsed(tTask *tsk)
   return tsk->used_vm_size;
 }
 
+long long
+task_GetCgroupMemoryPeak(tTask *tsk)
+{
+  return -1;
+}
+
 int
 task_IsAbnormal(tTask *tsk)
 {